@@ -0,0 +1,227 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkLabelmapDistanceTransform.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+// Squared distance of voxels that have no watched (or no unwatched) voxel in the processed directions yet
+static const float INFINITE_SQUARED_DISTANCE = 1e30f;
+
+vtkStandardNewMacro( vtkLabelmapDistanceTransform );
+
+//------------------------------------------------------------------------------
+// Replace each value of the line by min_p( ( ( q - p ) * spacing )^2 + value[ p ] ), the lower envelope of parabolas
+// rooted at the voxels. lineValues, parabolaIndices and boundaries are reused between lines to avoid reallocation.
+static void DistanceTransformLine( float* values, vtkIdType stride, int numberOfValues, double spacing,
+  std::vector< double >& lineValues, std::vector< int >& parabolaIndices, std::vector< double >& boundaries )
+{
+  lineValues.resize( numberOfValues );
+  parabolaIndices.resize( numberOfValues );
+  boundaries.resize( numberOfValues + 1 );
+
+  // Build the lower envelope. Parabola k is the lowest between boundaries[ k ] and boundaries[ k + 1 ].
+  int lastParabola = -1;
+  for ( int q = 0; q < numberOfValues; q++ )
+  {
+    lineValues[ q ] = values[ q * stride ];
+    if ( lineValues[ q ] >= INFINITE_SQUARED_DISTANCE )
+    {
+      continue;
+    }
+    double positionQ = q * spacing;
+    while ( lastParabola >= 0 )
+    {
+      int v = parabolaIndices[ lastParabola ];
+      double positionV = v * spacing;
+      double intersection = ( ( lineValues[ q ] + positionQ * positionQ ) - ( lineValues[ v ] + positionV * positionV ) )
+        / ( 2.0 * ( positionQ - positionV ) );
+      if ( intersection > boundaries[ lastParabola ] )
+      {
+        lastParabola++;
+        parabolaIndices[ lastParabola ] = q;
+        boundaries[ lastParabola ] = intersection;
+        boundaries[ lastParabola + 1 ] = VTK_DOUBLE_MAX;
+        break;
+      }
+      // the new parabola hides the last one
+      lastParabola--;
+    }
+    if ( lastParabola < 0 )
+    {
+      lastParabola = 0;
+      parabolaIndices[ 0 ] = q;
+      boundaries[ 0 ] = VTK_DOUBLE_MIN;
+      boundaries[ 1 ] = VTK_DOUBLE_MAX;
+    }
+  }
+  if ( lastParabola < 0 )
+  {
+    // no finite values in this line, nothing changes
+    return;
+  }
+
+  // Sample the envelope
+  int k = 0;
+  for ( int q = 0; q < numberOfValues; q++ )
+  {
+    double positionQ = q * spacing;
+    while ( boundaries[ k + 1 ] < positionQ )
+    {
+      k++;
+    }
+    double offset = positionQ - parabolaIndices[ k ] * spacing;
+    values[ q * stride ] = static_cast< float >( offset * offset + lineValues[ parabolaIndices[ k ] ] );
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkLabelmapDistanceTransform::vtkLabelmapDistanceTransform()
+{
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    this->Dimensions[ axis ] = 0;
+    this->Spacing[ axis ] = 1.0;
+  }
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+//------------------------------------------------------------------------------
+vtkLabelmapDistanceTransform::~vtkLabelmapDistanceTransform()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkLabelmapDistanceTransform::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+  os << indent << "Dimensions: " << this->Dimensions[ 0 ] << ", " << this->Dimensions[ 1 ] << ", " << this->Dimensions[ 2 ] << std::endl;
+  os << indent << "Spacing: " << this->Spacing[ 0 ] << ", " << this->Spacing[ 1 ] << ", " << this->Spacing[ 2 ] << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+}
+
+//------------------------------------------------------------------------------
+bool vtkLabelmapDistanceTransform::Compute( vtkImageData* labelmap, int labelValue, const double spacing[ 3 ] )
+{
+  if ( labelmap == NULL || labelmap->GetPointData()->GetScalars() == NULL )
+  {
+    vtkErrorMacro( "Compute: Invalid labelmap" );
+    return false;
+  }
+  labelmap->GetDimensions( this->Dimensions );
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    if ( this->Dimensions[ axis ] < 1 || spacing[ axis ] <= 0 )
+    {
+      vtkErrorMacro( "Compute: Invalid labelmap geometry" );
+      return false;
+    }
+    this->Spacing[ axis ] = spacing[ axis ];
+  }
+
+  // Initialize: zero distance from the set that the voxel belongs to, infinite from the other
+  vtkDataArray* labels = labelmap->GetPointData()->GetScalars();
+  vtkIdType numberOfVoxels = static_cast< vtkIdType >( this->Dimensions[ 0 ] ) * this->Dimensions[ 1 ] * this->Dimensions[ 2 ];
+  this->SquaredDistancesOutside.resize( numberOfVoxels );
+  this->SquaredDistancesInside.resize( numberOfVoxels );
+  vtkIdType numberOfWatchedVoxels = 0;
+  for ( vtkIdType voxelIndex = 0; voxelIndex < numberOfVoxels; voxelIndex++ )
+  {
+    double label = labels->GetComponent( voxelIndex, 0 );
+    bool watched = ( labelValue == 0 ) ? ( label != 0 ) : ( label == labelValue );
+    this->SquaredDistancesOutside[ voxelIndex ] = watched ? 0.0f : INFINITE_SQUARED_DISTANCE;
+    this->SquaredDistancesInside[ voxelIndex ] = watched ? INFINITE_SQUARED_DISTANCE : 0.0f;
+    if ( watched )
+    {
+      numberOfWatchedVoxels++;
+    }
+  }
+  if ( numberOfWatchedVoxels == 0 )
+  {
+    vtkErrorMacro( "Compute: Labelmap contains no voxels with label " << labelValue );
+    return false;
+  }
+
+  // One pass along each axis, the lines of a pass are processed in parallel
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    int numberOfLines = this->Dimensions[ ( axis + 1 ) % 3 ] * this->Dimensions[ ( axis + 2 ) % 3 ];
+    ThreadJob job;
+    job.Self = this;
+    job.Axis = axis;
+    vtkNew< vtkMultiThreader > threader;
+    threader->SetNumberOfThreads( std::max( 1, std::min( this->NumberOfThreads, numberOfLines ) ) );
+    threader->SetSingleMethod( vtkLabelmapDistanceTransform::TransformLinesThreadFunction, &job );
+    threader->SingleMethodExecute();
+  }
+
+  this->Output->SetDimensions( this->Dimensions );
+  this->Output->SetOrigin( 0.0, 0.0, 0.0 );
+  this->Output->SetSpacing( this->Spacing );
+  this->Output->AllocateScalars( VTK_FLOAT, 1 );
+  float* distances = static_cast< float* >( this->Output->GetScalarPointer() );
+  for ( vtkIdType voxelIndex = 0; voxelIndex < numberOfVoxels; voxelIndex++ )
+  {
+    distances[ voxelIndex ] = sqrt( this->SquaredDistancesOutside[ voxelIndex ] ) - sqrt( this->SquaredDistancesInside[ voxelIndex ] );
+  }
+  this->Output->Modified();
+
+  // Working buffers are not needed until the next computation
+  std::vector< float >().swap( this->SquaredDistancesOutside );
+  std::vector< float >().swap( this->SquaredDistancesInside );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkLabelmapDistanceTransform::TransformLinesThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  ThreadJob* job = static_cast< ThreadJob* >( threadInfo->UserData );
+  int axis = job->Axis;
+  int numberOfLines = job->Self->Dimensions[ ( axis + 1 ) % 3 ] * job->Self->Dimensions[ ( axis + 2 ) % 3 ];
+  int firstLine = numberOfLines * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int lastLine = numberOfLines * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  job->Self->TransformLines( axis, firstLine, lastLine );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+void vtkLabelmapDistanceTransform::TransformLines( int axis, int firstLine, int lastLine )
+{
+  vtkIdType strides[ 3 ] = { 1, this->Dimensions[ 0 ], static_cast< vtkIdType >( this->Dimensions[ 0 ] ) * this->Dimensions[ 1 ] };
+  int axis1 = ( axis + 1 ) % 3;
+  int axis2 = ( axis + 2 ) % 3;
+  std::vector< double > lineValues;
+  std::vector< int > parabolaIndices;
+  std::vector< double > boundaries;
+  for ( int line = firstLine; line < lastLine; line++ )
+  {
+    vtkIdType lineStart = ( line % this->Dimensions[ axis1 ] ) * strides[ axis1 ] + ( line / this->Dimensions[ axis1 ] ) * strides[ axis2 ];
+    DistanceTransformLine( &( this->SquaredDistancesOutside[ lineStart ] ), strides[ axis ], this->Dimensions[ axis ], this->Spacing[ axis ],
+      lineValues, parabolaIndices, boundaries );
+    DistanceTransformLine( &( this->SquaredDistancesInside[ lineStart ] ), strides[ axis ], this->Dimensions[ axis ], this->Spacing[ axis ],
+      lineValues, parabolaIndices, boundaries );
+  }
+}
@@ -0,0 +1,90 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkLabelmapDistanceTransform - signed Euclidean distance map of a labelmap
+// .SECTION Description
+// Computes the exact Euclidean distance of each voxel from the nearest voxel of the
+// watched area (voxels that have the watched label) and from the nearest voxel outside of it.
+// The output is the difference of the two: positive outside the area, negative inside,
+// and changes sign halfway between boundary voxels.
+// The transform is separable (1D lower envelope of parabolas along each axis, see
+// Felzenszwalb and Huttenlocher, Distance Transforms of Sampled Functions), so it takes
+// linear time in the number of voxels. Lines along an axis are independent, they are
+// distributed between threads. Voxel spacing is taken into account, directions are not:
+// the output is in the voxel coordinate system scaled by the spacing.
+
+#ifndef __vtkLabelmapDistanceTransform_h
+#define __vtkLabelmapDistanceTransform_h
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+// BreachWarning includes
+#include "vtkSlicerBreachWarningModuleLogicExport.h"
+
+class VTK_SLICER_BREACHWARNING_MODULE_LOGIC_EXPORT vtkLabelmapDistanceTransform : public vtkObject
+{
+public:
+  static vtkLabelmapDistanceTransform* New();
+  vtkTypeMacro( vtkLabelmapDistanceTransform, vtkObject );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  // Compute the distance map of the voxels that have the given label (any non-zero label if labelValue is 0).
+  // spacing is the voxel size along each axis (the spacing of the image data is ignored, as volume nodes store it separately).
+  // Returns false if the labelmap is empty or contains no watched voxels.
+  bool Compute( vtkImageData* labelmap, int labelValue, const double spacing[ 3 ] );
+
+  // Float volume with the same dimensions as the labelmap, zero origin and the spacing of the last computation.
+  // Distances are in the units of the spacing (typically mm).
+  vtkImageData* GetOutput() { return this->Output; };
+
+  vtkGetMacro( NumberOfThreads, int );
+  vtkSetMacro( NumberOfThreads, int );
+
+protected:
+  vtkLabelmapDistanceTransform();
+  ~vtkLabelmapDistanceTransform();
+
+private:
+  // Each thread transforms a range of the lines along Axis
+  struct ThreadJob
+  {
+    vtkLabelmapDistanceTransform* Self;
+    int Axis;
+  };
+  static VTK_THREAD_RETURN_TYPE TransformLinesThreadFunction( void* arg );
+  void TransformLines( int axis, int firstLine, int lastLine );
+
+  // Squared distances to the nearest watched voxel and to the nearest not watched voxel
+  std::vector< float > SquaredDistancesOutside;
+  std::vector< float > SquaredDistancesInside;
+  int Dimensions[ 3 ];
+  double Spacing[ 3 ];
+
+  vtkSmartPointer< vtkImageData > Output;
+  int NumberOfThreads;
+
+  vtkLabelmapDistanceTransform( const vtkLabelmapDistanceTransform& ); // Not implemented
+  void operator=( const vtkLabelmapDistanceTransform& ); // Not implemented
+};
+
+#endif
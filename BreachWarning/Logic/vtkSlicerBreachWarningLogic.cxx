@@ -17,6 +17,13 @@
 
 // BreachWarning includes
 #include "vtkSlicerBreachWarningLogic.h"
+#include "vtkLabelmapDistanceTransform.h"
+
+// IGTCommon includes
+#include "vtkLatencyInstrumentation.h"
+#include "vtkPerformanceCounters.h"
+#include "vtkSlicerTrackingTickLogic.h"
+#include "vtkTransformToWorldCache.h"
 
 // MRML includes
 #include "vtkMRMLAnnotationLineDisplayNode.h"
@@ -25,169 +32,1261 @@
 #include "vtkMRMLAnnotationTextDisplayNode.h"
 #include "vtkMRMLBreachWarningNode.h"
 #include "vtkMRMLDisplayNode.h"
+#include "vtkMRMLModelDisplayNode.h"
 #include "vtkMRMLModelNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLScene.h"
 #include "vtkMRMLTransformNode.h"
 
 // VTK includes
 #include <vtkCellData.h>
 #include <vtkCellLocator.h>
+#include <vtkConditionVariable.h>
+#include <vtkFloatArray.h>
 #include <vtkGeneralTransform.h>
 #include <vtkGenericCell.h>
+#include <vtkIdList.h>
+#include <vtkImageData.h>
 #include <vtkImplicitPolyDataDistance.h>
 #include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPointLocator.h>
 #include <vtkPolyData.h>
 #include <vtkPolygon.h>
 #include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
 #include <vtkTransformPolyDataFilter.h>
 
 // STD includes
+#include <algorithm>
+#include <vector>
+
+// Minimum distance between tool segment sample points, in the coordinate system of the model.
+// Surface features that are thinner than this may be missed.
+static const double TOOL_SEGMENT_MINIMUM_STEP_SIZE = 0.5;
+
+// Size of the blocks of distance field voxels (along each axis) that are evaluated if they may be within the band width from the model surface
+static const int DISTANCE_FIELD_BLOCK_SIZE = 8;
+// Value of the distance field voxels that are not evaluated
+static const float DISTANCE_FIELD_NOT_EVALUATED = VTK_FLOAT_MAX;
+
+// Name of the point scalar array that stores the distance of the model vertices from the tool tip
+static const char DISTANCE_COLORING_ARRAY_NAME[] = "DistanceToToolTip";
 
 // Slicer methods 
 
 vtkStandardNewMacro(vtkSlicerBreachWarningLogic);
 
+//------------------------------------------------------------------------------
+/// Closest point computation on a worker thread.
+/// The main thread submits requests that contain a snapshot of the model and the tool tip position,
+/// the worker thread builds its own locators from the snapshots (locators are not thread-safe)
+/// and stores the results, which are applied to the MRML nodes on the main thread.
+/// Only the most recent request is kept for each breach warning node, stale requests are dropped.
+class vtkSlicerBreachWarningLogic::vtkInternal
+{
+public:
+  vtkInternal();
+  ~vtkInternal();
+
+  void StartThread();
+  void StopThread();
+  bool IsThreadRunning() { return this->ThreadId >= 0; }
+
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void* ptr);
+  void ProcessRequests();
+
+  struct Request
+  {
+    std::string ModelNodeID;
+    vtkSmartPointer<vtkPolyData> ModelPolyData; // snapshot, it is not modified after the request is submitted
+    double ToolTipPosition_Ras[3];
+    double ToolTipPosition_Locator[3];
+    double LocatorToRasMatrix[16];
+    double ToolRadius;
+  };
+
+  struct Result
+  {
+    double ToolTipPosition_Ras[3];
+    double ClosestPointOnModel_Ras[3];
+    double ClosestDistance;
+  };
+
+  struct ModelSnapshot
+  {
+    vtkSmartPointer<vtkPolyData> PolyData;
+    vtkWeakPointer<vtkPolyData> SourcePolyData;
+    unsigned long SourcePolyDataMTime;
+    ModelSnapshot() : SourcePolyDataMTime(0) {}
+  };
+
+  struct WorkerDistanceFilter
+  {
+    vtkSmartPointer<vtkPolyData> PolyData;
+    vtkSmartPointer<vtkImplicitPolyDataDistance> DistanceFilter;
+  };
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  int ThreadId;
+
+  // Protects StopRequested, PendingRequests, and Results
+  vtkSmartPointer<vtkMutexLock> Mutex;
+  vtkSmartPointer<vtkConditionVariable> RequestAvailable;
+  bool StopRequested;
+  std::map< std::string, Request > PendingRequests; // key: breach warning node ID
+  std::map< std::string, Result > Results; // key: breach warning node ID
+
+  // Only accessed from the main thread
+  std::map< vtkMRMLModelNode*, ModelSnapshot > ModelSnapshots;
+
+  // Only accessed from the worker thread
+  std::map< std::string, WorkerDistanceFilter > WorkerDistanceFilters;  // key: model node ID
+};
+
+//------------------------------------------------------------------------------
+vtkSlicerBreachWarningLogic::vtkInternal::vtkInternal()
+: Threader(vtkSmartPointer<vtkMultiThreader>::New())
+, ThreadId(-1)
+, Mutex(vtkSmartPointer<vtkMutexLock>::New())
+, RequestAvailable(vtkSmartPointer<vtkConditionVariable>::New())
+, StopRequested(false)
+{
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerBreachWarningLogic::vtkInternal::~vtkInternal()
+{
+  this->StopThread();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::vtkInternal::StartThread()
+{
+  if ( this->IsThreadRunning() )
+  {
+    return;
+  }
+  this->StopRequested = false;
+  this->ThreadId = this->Threader->SpawnThread( (vtkThreadFunctionType)&vtkInternal::ThreadFunction, this );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::vtkInternal::StopThread()
+{
+  if ( !this->IsThreadRunning() )
+  {
+    return;
+  }
+  this->Mutex->Lock();
+  this->StopRequested = true;
+  this->RequestAvailable->Broadcast();
+  this->Mutex->Unlock();
+  this->Threader->TerminateThread( this->ThreadId ); // waits for the thread to finish
+  this->ThreadId = -1;
+
+  this->PendingRequests.clear();
+  this->Results.clear();
+  this->ModelSnapshots.clear();
+  this->WorkerDistanceFilters.clear();
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerBreachWarningLogic::vtkInternal::ThreadFunction( void* ptr )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+  vtkInternal* self = static_cast< vtkInternal* >( threadInfo->UserData );
+  self->ProcessRequests();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::vtkInternal::ProcessRequests()
+{
+  this->Mutex->Lock();
+  while ( true )
+  {
+    while ( this->PendingRequests.empty() && !this->StopRequested )
+    {
+      this->RequestAvailable->Wait( this->Mutex );
+    }
+    if ( this->StopRequested )
+    {
+      break;
+    }
+    std::map< std::string, Request > requests;
+    requests.swap( this->PendingRequests );
+    this->Mutex->Unlock();
+
+    std::map< std::string, Result > results;
+    for ( std::map< std::string, Request >::iterator requestIt = requests.begin(); requestIt != requests.end(); ++requestIt )
+    {
+      Request& request = requestIt->second;
+      WorkerDistanceFilter& workerFilter = this->WorkerDistanceFilters[request.ModelNodeID];
+      if ( workerFilter.DistanceFilter.GetPointer() == NULL || workerFilter.PolyData != request.ModelPolyData )
+      {
+        workerFilter.PolyData = request.ModelPolyData;
+        workerFilter.DistanceFilter = vtkSmartPointer< vtkImplicitPolyDataDistance >::New();
+        workerFilter.DistanceFilter->SetInput( request.ModelPolyData ); // expensive: builds a locator
+      }
+
+      double closestPointOnModel_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+      double closestDistance = workerFilter.DistanceFilter->EvaluateFunctionAndGetClosestPoint( request.ToolTipPosition_Locator, closestPointOnModel_Locator );
+      double closestPointOnModel_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+      vtkMatrix4x4::MultiplyPoint( request.LocatorToRasMatrix, closestPointOnModel_Locator, closestPointOnModel_Ras );
+
+      Result& result = results[requestIt->first];
+      double closestDistanceMagnitude_Ras = sqrt( vtkMath::Distance2BetweenPoints( request.ToolTipPosition_Ras, closestPointOnModel_Ras ) );
+      result.ClosestDistance = ( ( closestDistance < 0 ) ? -closestDistanceMagnitude_Ras : closestDistanceMagnitude_Ras ) - request.ToolRadius;
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        result.ToolTipPosition_Ras[axis] = request.ToolTipPosition_Ras[axis];
+        result.ClosestPointOnModel_Ras[axis] = closestPointOnModel_Ras[axis];
+      }
+    }
+
+    this->Mutex->Lock();
+    for ( std::map< std::string, Result >::iterator resultIt = results.begin(); resultIt != results.end(); ++resultIt )
+    {
+      this->Results[resultIt->first] = resultIt->second;
+    }
+  }
+  this->Mutex->Unlock();
+}
+
 //------------------------------------------------------------------------------
 vtkSlicerBreachWarningLogic::vtkSlicerBreachWarningLogic()
-: WarningSoundPlaying(false)
+: NumberOfDistanceQueries(0)
+, NumberOfReusedDistanceQueries(0)
+, AsynchronousUpdate(false)
+, DistanceColoringUpdateInProgress(false)
+, NumberOfWarningSoundPlayingNodes(0)
+, WarningSoundPlaying(false)
 , DefaultLineToClosestPointTextScale(2.0)
 , DefaultLineToClosestPointThickness(3.0)
 {
+  this->Internal = new vtkInternal;
+  this->ToolToRasMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  this->DistanceColoringPointIds = vtkSmartPointer<vtkIdList>::New();
+  this->PerformanceCounters = vtkSmartPointer<vtkPerformanceCounters>::New();
+  this->PerformanceCounters->SetName("BreachWarning");
   this->DefaultLineToClosestPointColor[0]=0;
   this->DefaultLineToClosestPointColor[1]=1;
   this->DefaultLineToClosestPointColor[2]=0;
+
+  vtkSlicerTrackingTickLogic::GetInstance()->AddObserver( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand(), vtkSlicerTrackingTickLogic::GetConsumerStagePriority() );
 }
 
 
 //------------------------------------------------------------------------------
 vtkSlicerBreachWarningLogic::~vtkSlicerBreachWarningLogic()
 {
+  vtkSlicerTrackingTickLogic::GetInstance()->RemoveObservers( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand() );
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::SetAsynchronousUpdate( bool asynchronous )
+{
+  if ( this->AsynchronousUpdate == asynchronous )
+  {
+    return;
+  }
+  this->AsynchronousUpdate = asynchronous;
+  if ( asynchronous )
+  {
+    this->Internal->StartThread();
+  }
+  else
+  {
+    this->Internal->StopThread();
+  }
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerBreachWarningLogic::RequestAsynchronousToolStateUpdate( vtkMRMLBreachWarningNode* bwNode )
+{
+  if ( !this->Internal->IsThreadRunning() || bwNode->GetID() == NULL )
+  {
+    return false;
+  }
+  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
+  vtkMRMLTransformNode* toolToRasNode = bwNode->GetToolTransformNode();
+  if ( modelNode == NULL || modelNode->GetID() == NULL || modelNode->GetPolyData() == NULL || toolToRasNode == NULL )
+  {
+    // invalid inputs are handled by the synchronous update
+    return false;
+  }
+  if ( bwNode->GetNumberOfToolGeometryPoints() > 0 || bwNode->GetDistanceFieldEnabled() || bwNode->GetDistanceColoringEnabled() )
+  {
+    // tool geometry, distance field, and distance coloring are only supported in synchronous update
+    return false;
+  }
+  vtkNew< vtkMatrix4x4 > locatorToRasMatrix;
+  vtkMRMLTransformNode* modelParentTransform = modelNode->GetParentTransformNode();
+  if ( modelParentTransform != NULL )
+  {
+    if ( !vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( modelParentTransform, locatorToRasMatrix.GetPointer() ) )
+    {
+      // non-linearly transformed models are only supported in synchronous update
+      return false;
+    }
+  }
+
+  // Take a snapshot of the model if it has been changed since the last snapshot.
+  // Copying is much faster than building a locator, which is done in the worker thread.
+  vtkPolyData* modelPolyData = modelNode->GetPolyData();
+  vtkInternal::ModelSnapshot& snapshot = this->Internal->ModelSnapshots[modelNode];
+  if ( snapshot.PolyData.GetPointer() == NULL || snapshot.SourcePolyData.GetPointer() != modelPolyData
+    || snapshot.SourcePolyDataMTime != modelPolyData->GetMTime() )
+  {
+    snapshot.PolyData = vtkSmartPointer< vtkPolyData >::New();
+    snapshot.PolyData->DeepCopy( modelPolyData );
+    snapshot.SourcePolyData = modelPolyData;
+    snapshot.SourcePolyDataMTime = modelPolyData->GetMTime();
+  }
+
+  vtkInternal::Request request;
+  request.ModelNodeID = modelNode->GetID();
+  request.ModelPolyData = snapshot.PolyData;
+  request.ToolRadius = bwNode->GetToolRadius();
+  this->GetToolTipPositionInRas( toolToRasNode, request.ToolTipPosition_Ras );
+  vtkNew< vtkMatrix4x4 > rasToLocatorMatrix;
+  vtkMatrix4x4::Invert( locatorToRasMatrix.GetPointer(), rasToLocatorMatrix.GetPointer() );
+  double toolTipPosition_Ras[4] = { request.ToolTipPosition_Ras[0], request.ToolTipPosition_Ras[1], request.ToolTipPosition_Ras[2], 1.0 };
+  double toolTipPosition_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+  rasToLocatorMatrix->MultiplyPoint( toolTipPosition_Ras, toolTipPosition_Locator );
+  for ( int i = 0; i < 3; i++ )
+  {
+    request.ToolTipPosition_Locator[i] = toolTipPosition_Locator[i];
+  }
+  for ( int i = 0; i < 16; i++ )
+  {
+    request.LocatorToRasMatrix[i] = locatorToRasMatrix->GetElement( i / 4, i % 4 );
+  }
+
+  this->Internal->Mutex->Lock();
+  this->Internal->PendingRequests[bwNode->GetID()] = request; // replaces the previous request if it is not processed yet
+  this->Internal->RequestAvailable->Signal();
+  this->Internal->Mutex->Unlock();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::ProcessAsynchronousResults()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if ( !this->Internal->IsThreadRunning() || scene == NULL )
+  {
+    return;
+  }
+  std::map< std::string, vtkInternal::Result > results;
+  this->Internal->Mutex->Lock();
+  results.swap( this->Internal->Results );
+  this->Internal->Mutex->Unlock();
+
+  for ( std::map< std::string, vtkInternal::Result >::iterator resultIt = results.begin(); resultIt != results.end(); ++resultIt )
+  {
+    vtkMRMLBreachWarningNode* bwNode = vtkMRMLBreachWarningNode::SafeDownCast( scene->GetNodeByID( resultIt->first ) );
+    if ( bwNode == NULL )
+    {
+      // the node has been removed since the request was submitted
+      continue;
+    }
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    vtkInternal::Result& result = resultIt->second;
+    int wasModified = bwNode->StartModify();
+    bwNode->SetClosestDistanceToModelFromToolTip( result.ClosestDistance );
+    bwNode->SetClosestPointOnModel( result.ClosestPointOnModel_Ras );
+    bwNode->SetToolSegmentClosestDistances( std::vector<double>() );
+    this->UpdateLineToClosestPoint( bwNode, result.ToolTipPosition_Ras, result.ClosestPointOnModel_Ras, result.ClosestDistance );
+    this->UpdateWarnings( bwNode );
+    bwNode->EndModify( wasModified );
+    vtkLatencyInstrumentation::GetInstance()->RecordStageLatency( "BreachWarning", bwNode->GetToolTransformNode() );
+    this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfDistanceQueries: " << this->NumberOfDistanceQueries << std::endl;
+  os << indent << "NumberOfReusedDistanceQueries: " << this->NumberOfReusedDistanceQueries << std::endl;
+}
+
+//------------------------------------------------------------------------------
+double vtkSlicerBreachWarningLogic::GetDistanceQueryReuseRate()
+{
+  if ( this->NumberOfDistanceQueries == 0 )
+  {
+    return 0.0;
+  }
+  return static_cast<double>( this->NumberOfReusedDistanceQueries ) / this->NumberOfDistanceQueries;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::ResetDistanceQueryStatistics()
+{
+  this->NumberOfDistanceQueries = 0;
+  this->NumberOfReusedDistanceQueries = 0;
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerBreachWarningLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::RegisterNodes()
+{
+  if( ! this->GetMRMLScene() )
+  {
+    vtkWarningMacro( "MRML scene not yet created" );
+    return;
+  }
+
+  this->GetMRMLScene()->RegisterNodeClass( vtkSmartPointer< vtkMRMLBreachWarningNode >::New() );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateToolState( vtkMRMLBreachWarningNode* bwNode )
+{
+  if ( bwNode == NULL )
+  {
+    return;
+  }
+
+  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
+  vtkMRMLTransformNode* toolToRasNode = bwNode->GetToolTransformNode();
+
+  if ( modelNode == NULL && bwNode->GetWatchedLabelmapVolumeNode() != NULL && toolToRasNode != NULL )
+  {
+    // The labelmap is only watched if there is no watched model
+    double toolTipPosition_Ras[3] = { 0.0, 0.0, 0.0 };
+    this->GetToolTipPositionInRas( toolToRasNode, toolTipPosition_Ras );
+    this->UpdateToolStateFromLabelmap( bwNode, toolTipPosition_Ras );
+    return;
+  }
+
+  if ( modelNode == NULL || toolToRasNode == NULL )
+  {
+    bwNode->SetClosestDistanceToModelFromToolTip(0);
+    return;
+  }
+
+  vtkPolyData* body = modelNode->GetPolyData();
+  if ( body == NULL )
+  {
+    vtkWarningMacro( "No surface model in node" );
+    return;
+  }
+  
+  double toolTipPosition_Ras[3] = { 0.0, 0.0, 0.0 };
+  this->GetToolTipPositionInRas( toolToRasNode, toolTipPosition_Ras );
+  this->UpdateToolStateFromToolTipPosition( bwNode, toolTipPosition_Ras );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::GetToolTipPositionInRas( vtkMRMLTransformNode* toolToRasNode, double toolTipPosition_Ras[3] )
+{
+  // The tool tip is the origin of the tool coordinate system, it is the translation of a linear transform
+  if ( vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( toolToRasNode, this->ToolToRasMatrix ) )
+  {
+    for ( int i = 0; i < 3; i++ )
+    {
+      toolTipPosition_Ras[i] = this->ToolToRasMatrix->GetElement( i, 3 );
+    }
+    return;
+  }
+  vtkSmartPointer<vtkGeneralTransform> toolToRasTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+  toolToRasNode->GetTransformToWorld( toolToRasTransform ); 
+  double toolTipPosition_Tool[3] = { 0.0, 0.0, 0.0 };
+  toolToRasTransform->TransformPoint( toolTipPosition_Tool, toolTipPosition_Ras );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateToolStateFromToolTipPosition( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Ras[3] )
+{
+  vtkNew< vtkMatrix4x4 > locatorToRasMatrix;
+  vtkImplicitPolyDataDistance* implicitDistanceFilter = this->GetDistanceFilter( bwNode->GetWatchedModelNode(), locatorToRasMatrix.GetPointer() );
+
+  // Transform only the tooltip into the coordinate system of the locator (instead of transforming the model)
+  vtkNew< vtkMatrix4x4 > rasToLocatorMatrix;
+  vtkMatrix4x4::Invert( locatorToRasMatrix.GetPointer(), rasToLocatorMatrix.GetPointer() );
+  double toolTipPosition_RasHomogeneous[4] = { toolTipPosition_Ras[0], toolTipPosition_Ras[1], toolTipPosition_Ras[2], 1.0 };
+  double toolTipPosition_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+  rasToLocatorMatrix->MultiplyPoint( toolTipPosition_RasHomogeneous, toolTipPosition_Locator );
+
+  double closestPointOnModel_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+  double closestPointDistance = 0.0;
+  bool closestPointFound = false;
+  bool closestPointReused = false;
+
+  // The previous closest point can be reused if the distance computed from it is guaranteed to be accurate enough.
+  // The previous closest point is on the surface, so the distance from it is an upper bound of the current distance.
+  // The distance changes at most as much as the tool tip moves, which gives a lower bound. The previous closest point
+  // is reused only if the bounds are within the tolerance and the inside/outside state is the same for both,
+  // otherwise the full search is performed.
+  this->NumberOfDistanceQueries++;
+  ToolStateCacheItem& toolState = this->ToolStateCache[bwNode];
+  if ( bwNode->GetToolTipMovementTolerance() > 0
+    && toolState.DistanceFilter.GetPointer() == implicitDistanceFilter )
+  {
+    double toolTipMovement = sqrt( vtkMath::Distance2BetweenPoints( toolTipPosition_Locator, toolState.ToolTipPosition_Locator ) );
+    double distanceUpperBound = sqrt( vtkMath::Distance2BetweenPoints( toolTipPosition_Locator, toolState.ClosestPointOnModel_Locator ) );
+    double distanceLowerBound = fabs( toolState.ClosestPointDistance ) - toolTipMovement;
+    double toolRadius = bwNode->GetToolRadius();
+    bool insideStateKnown = ( toolState.ClosestPointDistance < 0 // inside the model, the tool is inside for any tool radius
+      || distanceLowerBound > toolRadius || distanceUpperBound < toolRadius );
+    if ( distanceLowerBound > 0 && distanceUpperBound - distanceLowerBound <= bwNode->GetToolTipMovementTolerance() && insideStateKnown )
+    {
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        closestPointOnModel_Locator[axis] = toolState.ClosestPointOnModel_Locator[axis];
+      }
+      closestPointDistance = toolState.ClosestPointDistance; // only the sign is used, magnitude is computed below
+      closestPointFound = true;
+      closestPointReused = true;
+      this->NumberOfReusedDistanceQueries++;
+    }
+  }
+
+  if ( !closestPointFound && bwNode->GetDistanceFieldEnabled() )
+  {
+    vtkImageData* distanceField = this->GetDistanceField( bwNode->GetWatchedModelNode(), bwNode->GetDistanceFieldVoxelSize(), bwNode->GetDistanceFieldBandWidth() );
+    double gradient[3] = { 0.0, 0.0, 0.0 };
+    if ( distanceField != NULL && InterpolateDistanceField( distanceField, toolTipPosition_Locator, closestPointDistance, gradient ) )
+    {
+      // Interpolation is not accurate within a voxel from the surface, use exact search there
+      double exactSearchDistance = sqrt( 3.0 ) * bwNode->GetDistanceFieldVoxelSize();
+      double gradientNorm = vtkMath::Norm( gradient );
+      if ( fabs( closestPointDistance ) > exactSearchDistance && gradientNorm > 0 )
+      {
+        // Closest point is estimated by stepping from the tool tip along the negative gradient
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+          closestPointOnModel_Locator[axis] = toolTipPosition_Locator[axis] - closestPointDistance * gradient[axis] / gradientNorm;
+        }
+        closestPointFound = true;
+      }
+    }
+  }
+  if ( !closestPointFound )
+  {
+    closestPointDistance = implicitDistanceFilter->EvaluateFunctionAndGetClosestPoint( toolTipPosition_Locator, closestPointOnModel_Locator );
+  }
+  if ( !closestPointReused )
+  {
+    // Store the result of the search to allow reuse in the next update
+    toolState.DistanceFilter = implicitDistanceFilter;
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+      toolState.ToolTipPosition_Locator[axis] = toolTipPosition_Locator[axis];
+      toolState.ClosestPointOnModel_Locator[axis] = closestPointOnModel_Locator[axis];
+    }
+    toolState.ClosestPointDistance = closestPointDistance;
+  }
+
+  this->UpdateDistanceColoring( bwNode, toolTipPosition_Locator );
+
+  double closestPointOnModel_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+  locatorToRasMatrix->MultiplyPoint( closestPointOnModel_Locator, closestPointOnModel_Ras );
+  // The locator coordinate system may be scaled, so compute the magnitude of the distance in RAS
+  double closestPointDistanceMagnitude_Ras = sqrt( vtkMath::Distance2BetweenPoints( toolTipPosition_Ras, closestPointOnModel_Ras ) );
+  closestPointDistance = ( closestPointDistance < 0 ) ? -closestPointDistanceMagnitude_Ras : closestPointDistanceMagnitude_Ras;
+
+  // Check the tool segments
+  double closestToolPoint_Ras[3] = { toolTipPosition_Ras[0], toolTipPosition_Ras[1], toolTipPosition_Ras[2] };
+  std::vector<double> segmentClosestDistances;
+  int numberOfToolGeometryPoints = bwNode->GetNumberOfToolGeometryPoints();
+  if ( numberOfToolGeometryPoints > 0 )
+  {
+    vtkSmartPointer<vtkGeneralTransform> toolToRasTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+    bwNode->GetToolTransformNode()->GetTransformToWorld( toolToRasTransform );
+    double segmentStart_Locator[3] = { toolTipPosition_Locator[0], toolTipPosition_Locator[1], toolTipPosition_Locator[2] };
+    for ( int pointIndex = 0; pointIndex < numberOfToolGeometryPoints; pointIndex++ )
+    {
+      double segmentEnd_Tool[3] = { 0.0, 0.0, 0.0 };
+      bwNode->GetToolGeometryPoint( pointIndex, segmentEnd_Tool );
+      double segmentEnd_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+      toolToRasTransform->TransformPoint( segmentEnd_Tool, segmentEnd_Ras );
+      double segmentEnd_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+      rasToLocatorMatrix->MultiplyPoint( segmentEnd_Ras, segmentEnd_Locator );
+
+      double segmentClosestToolPoint_Ras[3] = { 0.0, 0.0, 0.0 };
+      double segmentClosestPointOnModel_Ras[3] = { 0.0, 0.0, 0.0 };
+      double segmentClosestDistance = this->ComputeToolSegmentDistance( implicitDistanceFilter, locatorToRasMatrix.GetPointer(),
+        segmentStart_Locator, segmentEnd_Locator, segmentClosestToolPoint_Ras, segmentClosestPointOnModel_Ras );
+      segmentClosestDistances.push_back( segmentClosestDistance - bwNode->GetToolRadius() );
+      if ( segmentClosestDistance < closestPointDistance )
+      {
+        closestPointDistance = segmentClosestDistance;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+          closestToolPoint_Ras[axis] = segmentClosestToolPoint_Ras[axis];
+          closestPointOnModel_Ras[axis] = segmentClosestPointOnModel_Ras[axis];
+        }
+      }
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        segmentStart_Locator[axis] = segmentEnd_Locator[axis];
+      }
+    }
+  }
+  closestPointDistance -= bwNode->GetToolRadius();
+
+  bwNode->SetClosestDistanceToModelFromToolTip(closestPointDistance);
+  bwNode->SetClosestPointOnModel(closestPointOnModel_Ras);
+  bwNode->SetToolSegmentClosestDistances(segmentClosestDistances);
+
+  this->UpdateLineToClosestPoint(bwNode, closestToolPoint_Ras, closestPointOnModel_Ras, closestPointDistance);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateToolStateFromLabelmap( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Ras[3] )
+{
+  vtkMRMLScalarVolumeNode* volumeNode = bwNode->GetWatchedLabelmapVolumeNode();
+  vtkImageData* distanceMap = this->GetLabelmapDistanceMap( volumeNode, bwNode->GetWatchedLabelValue() );
+  if ( distanceMap == NULL )
+  {
+    bwNode->SetClosestDistanceToModelFromToolTip(0);
+    return;
+  }
+
+  // The distance map is in the voxel coordinate system scaled by the spacing
+  vtkNew< vtkMatrix4x4 > ijkToVolumeMatrix;
+  volumeNode->GetIJKToRASMatrix( ijkToVolumeMatrix.GetPointer() );
+  vtkNew< vtkMatrix4x4 > mapToIjkMatrix;
+  double* spacing = volumeNode->GetSpacing();
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    mapToIjkMatrix->SetElement( axis, axis, 1.0 / spacing[axis] );
+  }
+  vtkNew< vtkMatrix4x4 > mapToVolumeMatrix;
+  vtkMatrix4x4::Multiply4x4( ijkToVolumeMatrix.GetPointer(), mapToIjkMatrix.GetPointer(), mapToVolumeMatrix.GetPointer() );
+  vtkNew< vtkMatrix4x4 > mapToRasMatrix;
+  mapToRasMatrix->DeepCopy( mapToVolumeMatrix.GetPointer() );
+  vtkMRMLTransformNode* volumeParentTransform = volumeNode->GetParentTransformNode();
+  if ( volumeParentTransform != NULL )
+  {
+    vtkNew< vtkMatrix4x4 > volumeToRasMatrix;
+    if ( !vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( volumeParentTransform, volumeToRasMatrix.GetPointer() ) )
+    {
+      vtkWarningMacro( "Non-linear transform of the watched labelmap volume is not supported" );
+      bwNode->SetClosestDistanceToModelFromToolTip(0);
+      return;
+    }
+    vtkMatrix4x4::Multiply4x4( volumeToRasMatrix.GetPointer(), mapToVolumeMatrix.GetPointer(), mapToRasMatrix.GetPointer() );
+  }
+  vtkNew< vtkMatrix4x4 > rasToMapMatrix;
+  vtkMatrix4x4::Invert( mapToRasMatrix.GetPointer(), rasToMapMatrix.GetPointer() );
+  double toolTipPosition_RasHomogeneous[4] = { toolTipPosition_Ras[0], toolTipPosition_Ras[1], toolTipPosition_Ras[2], 1.0 };
+  double toolTipPosition_Map[4] = { 0.0, 0.0, 0.0, 1.0 };
+  rasToMapMatrix->MultiplyPoint( toolTipPosition_RasHomogeneous, toolTipPosition_Map );
+
+  // Outside the volume the distance is looked up at the nearest position in the volume
+  // (slightly inside, so that rounding cannot put it outside). The tool tip is outside the watched area there.
+  int* dimensions = distanceMap->GetDimensions();
+  double* mapSpacing = distanceMap->GetSpacing();
+  double lookupPosition_Map[3] = { 0.0, 0.0, 0.0 };
+  bool toolTipOutsideMap = false;
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    double maximumPosition = ( dimensions[axis] - 1 ) * mapSpacing[axis] * ( 1.0 - 1e-9 );
+    lookupPosition_Map[axis] = std::max( 0.0, std::min( toolTipPosition_Map[axis], maximumPosition ) );
+    if ( lookupPosition_Map[axis] != toolTipPosition_Map[axis] )
+    {
+      toolTipOutsideMap = true;
+    }
+  }
+
+  this->NumberOfDistanceQueries++;
+  double distance = 0.0;
+  double gradient[3] = { 0.0, 0.0, 0.0 };
+  if ( !InterpolateDistanceField( distanceMap, lookupPosition_Map, distance, gradient ) )
+  {
+    vtkWarningMacro( "Distance cannot be computed in the watched labelmap volume (at least 2 voxels are needed along each axis)" );
+    bwNode->SetClosestDistanceToModelFromToolTip(0);
+    return;
+  }
+
+  // Closest point is estimated by stepping from the lookup position along the negative gradient
+  double closestPoint_Map[4] = { lookupPosition_Map[0], lookupPosition_Map[1], lookupPosition_Map[2], 1.0 };
+  double gradientNorm = vtkMath::Norm( gradient );
+  if ( gradientNorm > 0 )
+  {
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+      closestPoint_Map[axis] -= distance * gradient[axis] / gradientNorm;
+    }
+  }
+  double closestPointOnModel_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+  mapToRasMatrix->MultiplyPoint( closestPoint_Map, closestPointOnModel_Ras );
+
+  // The volume may be scaled by its parent transform, so compute the magnitude of the distance in RAS
+  double closestPointDistanceMagnitude_Ras = sqrt( vtkMath::Distance2BetweenPoints( toolTipPosition_Ras, closestPointOnModel_Ras ) );
+  double closestPointDistance = ( distance < 0 && !toolTipOutsideMap ) ? -closestPointDistanceMagnitude_Ras : closestPointDistanceMagnitude_Ras;
+  closestPointDistance -= bwNode->GetToolRadius();
+
+  bwNode->SetClosestDistanceToModelFromToolTip(closestPointDistance);
+  bwNode->SetClosestPointOnModel(closestPointOnModel_Ras);
+  bwNode->SetToolSegmentClosestDistances(std::vector<double>());
+
+  this->UpdateLineToClosestPoint(bwNode, toolTipPosition_Ras, closestPointOnModel_Ras, closestPointDistance);
+}
+
+//------------------------------------------------------------------------------
+double vtkSlicerBreachWarningLogic::ComputeToolSegmentDistance( vtkImplicitPolyDataDistance* implicitDistanceFilter, vtkMatrix4x4* locatorToRasMatrix,
+  double segmentStart_Locator[3], double segmentEnd_Locator[3], double closestToolPoint_Ras[3], double closestPointOnModel_Ras[3] )
+{
+  // Sphere tracing: distance to the surface is at least |d| everywhere within |d| from a point at distance d,
+  // therefore we can step forward along the segment by |d| without missing the surface. This requires only
+  // a few queries for segments that are far from the model and dense sampling only near the surface.
+  double segmentLength = sqrt( vtkMath::Distance2BetweenPoints( segmentStart_Locator, segmentEnd_Locator ) );
+  double closestDistance = VTK_DOUBLE_MAX;
+  double positionAlongSegment = 0.0;
+  while ( true )
+  {
+    double ratio = ( segmentLength > 0 ) ? positionAlongSegment / segmentLength : 0.0;
+    double samplePoint_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+      samplePoint_Locator[axis] = segmentStart_Locator[axis] + ratio * ( segmentEnd_Locator[axis] - segmentStart_Locator[axis] );
+    }
+    double samplePointOnModel_Locator[4] = { 0.0, 0.0, 0.0, 1.0 };
+    double sampleDistance = implicitDistanceFilter->EvaluateFunctionAndGetClosestPoint( samplePoint_Locator, samplePointOnModel_Locator );
+
+    // The locator coordinate system may be scaled, so compute the magnitude of the distance in RAS
+    double samplePoint_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+    locatorToRasMatrix->MultiplyPoint( samplePoint_Locator, samplePoint_Ras );
+    double samplePointOnModel_Ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+    locatorToRasMatrix->MultiplyPoint( samplePointOnModel_Locator, samplePointOnModel_Ras );
+    double sampleDistanceMagnitude_Ras = sqrt( vtkMath::Distance2BetweenPoints( samplePoint_Ras, samplePointOnModel_Ras ) );
+    double sampleDistance_Ras = ( sampleDistance < 0 ) ? -sampleDistanceMagnitude_Ras : sampleDistanceMagnitude_Ras;
+    if ( sampleDistance_Ras < closestDistance )
+    {
+      closestDistance = sampleDistance_Ras;
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        closestToolPoint_Ras[axis] = samplePoint_Ras[axis];
+        closestPointOnModel_Ras[axis] = samplePointOnModel_Ras[axis];
+      }
+    }
+    if ( positionAlongSegment >= segmentLength )
+    {
+      break;
+    }
+    positionAlongSegment = std::min( segmentLength, positionAlongSegment + std::max( fabs( sampleDistance ), TOOL_SEGMENT_MINIMUM_STEP_SIZE ) );
+  }
+  return closestDistance;
+}
+
+//------------------------------------------------------------------------------
+vtkImplicitPolyDataDistance* vtkSlicerBreachWarningLogic::GetDistanceFilter( vtkMRMLModelNode* modelNode, vtkMatrix4x4* locatorToRasMatrix )
+{
+  vtkPolyData* body = modelNode->GetPolyData();
+
+  // The locator is shared between all breach warning nodes that watch the same model
+  DistanceFilterCacheItem& cacheItem = this->DistanceFilterCache[modelNode];
+
+  // If the model transform is linear then the locator is built in model coordinates
+  // and only the tooltip is transformed. Non-linearly transformed models have to be
+  // transformed to RAS, as the closest point is not preserved by a non-linear transform.
+  locatorToRasMatrix->Identity();
+  vtkSmartPointer< vtkGeneralTransform > bodyToRasTransform;
+  vtkMRMLTransformNode* bodyParentTransform = modelNode->GetParentTransformNode();
+  if ( bodyParentTransform != NULL )
+  {
+    if ( !vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( bodyParentTransform, locatorToRasMatrix ) )
+    {
+      bodyToRasTransform = vtkSmartPointer< vtkGeneralTransform >::New();
+      bodyParentTransform->GetTransformToWorld( bodyToRasTransform );
+    }
+  }
+
+  // Check if the cached locator is still valid. We cannot tell if a non-linear transform has been changed,
+  // therefore the locator is always rebuilt in that case.
+  if ( cacheItem.DistanceFilter.GetPointer() != NULL
+    && cacheItem.ModelPolyData.GetPointer() == body
+    && cacheItem.ModelPolyDataMTime == body->GetMTime()
+    && !cacheItem.ModelTransformedToRas
+    && bodyToRasTransform.GetPointer() == NULL )
+  {
+    return cacheItem.DistanceFilter;
+  }
+
+  vtkSmartPointer< vtkImplicitPolyDataDistance > implicitDistanceFilter = vtkSmartPointer< vtkImplicitPolyDataDistance >::New();
+
+  if ( bodyToRasTransform.GetPointer() != NULL )
+  {
+    vtkSmartPointer< vtkTransformPolyDataFilter > bodyToRasFilter = vtkSmartPointer< vtkTransformPolyDataFilter >::New();
+#if (VTK_MAJOR_VERSION <= 5)
+    bodyToRasFilter->SetInput( body );
+#else
+    bodyToRasFilter->SetInputData( body );
+#endif
+    bodyToRasFilter->SetTransform( bodyToRasTransform );
+    bodyToRasFilter->Update(); // expensive: transforms all the points of the polydata
+
+    implicitDistanceFilter->SetInput( bodyToRasFilter->GetOutput() ); // expensive: builds a locator
+  }
+  else
+  {
+    implicitDistanceFilter->SetInput( body ); // expensive: builds a locator
+  }
+
+  cacheItem.DistanceFilter = implicitDistanceFilter;
+  cacheItem.ModelPolyData = body;
+  cacheItem.ModelPolyDataMTime = body->GetMTime();
+  cacheItem.ModelTransformedToRas = ( bodyToRasTransform.GetPointer() != NULL );
+  cacheItem.DistanceField = NULL;
+  cacheItem.PointLocator = NULL;
+
+  return implicitDistanceFilter;
+}
+
+//------------------------------------------------------------------------------
+vtkImageData* vtkSlicerBreachWarningLogic::GetDistanceField( vtkMRMLModelNode* modelNode, double voxelSize, double bandWidth )
+{
+  std::map< vtkMRMLModelNode*, DistanceFilterCacheItem >::iterator cacheItemIt = this->DistanceFilterCache.find( modelNode );
+  if ( cacheItemIt == this->DistanceFilterCache.end() || cacheItemIt->second.DistanceFilter.GetPointer() == NULL )
+  {
+    vtkErrorMacro( "vtkSlicerBreachWarningLogic::GetDistanceField failed: locator is not available" );
+    return NULL;
+  }
+  DistanceFilterCacheItem& cacheItem = cacheItemIt->second;
+  if ( cacheItem.ModelTransformedToRas )
+  {
+    // the locator is rebuilt at each update, it would not make sense to precompute a distance field
+    return NULL;
+  }
+  if ( cacheItem.DistanceField.GetPointer() != NULL
+    && cacheItem.DistanceFieldVoxelSize == voxelSize
+    && cacheItem.DistanceFieldBandWidth == bandWidth )
+  {
+    return cacheItem.DistanceField;
+  }
+
+  // The grid covers the model bounding box and the band around it
+  vtkPolyData* polyData = cacheItem.ModelPolyData;
+  double bounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  polyData->GetBounds( bounds );
+  int dimensions[3] = { 1, 1, 1 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  int blockDimensions[3] = { 1, 1, 1 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    origin[axis] = bounds[axis*2] - bandWidth;
+    double size = bounds[axis*2+1] - bounds[axis*2] + 2 * bandWidth;
+    dimensions[axis] = static_cast<int>( ceil( size / voxelSize ) ) + 1;
+    blockDimensions[axis] = ( dimensions[axis] + DISTANCE_FIELD_BLOCK_SIZE - 1 ) / DISTANCE_FIELD_BLOCK_SIZE;
+  }
+
+  // Only blocks of voxels that may be within the band width from the surface are evaluated:
+  // blocks that intersect the bounding box of a surface cell are dilated by the band width
+  std::vector< char > blockInBand( static_cast<size_t>( blockDimensions[0] ) * blockDimensions[1] * blockDimensions[2], 0 );
+  double blockSize = DISTANCE_FIELD_BLOCK_SIZE * voxelSize;
+  double cellBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  vtkIdType numberOfCells = polyData->GetNumberOfCells();
+  for ( vtkIdType cellId = 0; cellId < numberOfCells; cellId++ )
+  {
+    polyData->GetCellBounds( cellId, cellBounds );
+    int blockRange[6] = { 0, 0, 0, 0, 0, 0 };
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+      blockRange[axis*2] = std::max( 0, static_cast<int>( floor( ( cellBounds[axis*2] - origin[axis] ) / blockSize ) ) );
+      blockRange[axis*2+1] = std::min( blockDimensions[axis] - 1, static_cast<int>( floor( ( cellBounds[axis*2+1] - origin[axis] ) / blockSize ) ) );
+    }
+    for ( int bk = blockRange[4]; bk <= blockRange[5]; bk++ )
+    {
+      for ( int bj = blockRange[2]; bj <= blockRange[3]; bj++ )
+      {
+        for ( int bi = blockRange[0]; bi <= blockRange[1]; bi++ )
+        {
+          blockInBand[ bi + ( bj + bk * blockDimensions[1] ) * blockDimensions[0] ] = 1;
+        }
+      }
+    }
+  }
+  int dilationRadius = static_cast<int>( ceil( bandWidth / blockSize ) );
+  int blockIncrements[3] = { 1, blockDimensions[0], blockDimensions[0] * blockDimensions[1] };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    // box dilation is separable, it is done along each axis in turn
+    std::vector< char > dilatedBlockInBand( blockInBand.size(), 0 );
+    for ( size_t blockIndex = 0; blockIndex < blockInBand.size(); blockIndex++ )
+    {
+      if ( !blockInBand[blockIndex] )
+      {
+        continue;
+      }
+      int axisIndex = static_cast<int>( blockIndex / blockIncrements[axis] ) % blockDimensions[axis];
+      int firstIndex = std::max( 0, axisIndex - dilationRadius );
+      int lastIndex = std::min( blockDimensions[axis] - 1, axisIndex + dilationRadius );
+      for ( int dilatedIndex = firstIndex; dilatedIndex <= lastIndex; dilatedIndex++ )
+      {
+        dilatedBlockInBand[ blockIndex + static_cast<size_t>( dilatedIndex - axisIndex ) * blockIncrements[axis] ] = 1;
+      }
+    }
+    blockInBand.swap( dilatedBlockInBand );
+  }
+
+  vtkSmartPointer< vtkImageData > distanceField = vtkSmartPointer< vtkImageData >::New();
+  distanceField->SetOrigin( origin );
+  distanceField->SetSpacing( voxelSize, voxelSize, voxelSize );
+  distanceField->SetDimensions( dimensions );
+  vtkSmartPointer< vtkFloatArray > distances = vtkSmartPointer< vtkFloatArray >::New();
+  distances->SetNumberOfValues( static_cast<vtkIdType>( dimensions[0] ) * dimensions[1] * dimensions[2] );
+  // voxels outside the band are not evaluated, InterpolateDistanceField does not use them
+  distances->FillComponent( 0, DISTANCE_FIELD_NOT_EVALUATED );
+  vtkIdType sliceSize = static_cast<vtkIdType>( dimensions[0] ) * dimensions[1];
+  double position[3] = { 0.0, 0.0, 0.0 };
+  for ( int bk = 0; bk < blockDimensions[2]; bk++ )
+  {
+    for ( int bj = 0; bj < blockDimensions[1]; bj++ )
+    {
+      for ( int bi = 0; bi < blockDimensions[0]; bi++ )
+      {
+        if ( !blockInBand[ bi + ( bj + bk * blockDimensions[1] ) * blockDimensions[0] ] )
+        {
+          continue;
+        }
+        int kEnd = std::min( ( bk + 1 ) * DISTANCE_FIELD_BLOCK_SIZE, dimensions[2] );
+        int jEnd = std::min( ( bj + 1 ) * DISTANCE_FIELD_BLOCK_SIZE, dimensions[1] );
+        int iEnd = std::min( ( bi + 1 ) * DISTANCE_FIELD_BLOCK_SIZE, dimensions[0] );
+        for ( int k = bk * DISTANCE_FIELD_BLOCK_SIZE; k < kEnd; k++ )
+        {
+          position[2] = origin[2] + k * voxelSize;
+          for ( int j = bj * DISTANCE_FIELD_BLOCK_SIZE; j < jEnd; j++ )
+          {
+            position[1] = origin[1] + j * voxelSize;
+            vtkIdType voxelIndex = bi * DISTANCE_FIELD_BLOCK_SIZE + j * dimensions[0] + k * sliceSize;
+            for ( int i = bi * DISTANCE_FIELD_BLOCK_SIZE; i < iEnd; i++ )
+            {
+              position[0] = origin[0] + i * voxelSize;
+              distances->SetValue( voxelIndex++, cacheItem.DistanceFilter->EvaluateFunction( position ) ); // expensive, but only computed once
+            }
+          }
+        }
+      }
+    }
+  }
+  distanceField->GetPointData()->SetScalars( distances );
+
+  cacheItem.DistanceField = distanceField;
+  cacheItem.DistanceFieldVoxelSize = voxelSize;
+  cacheItem.DistanceFieldBandWidth = bandWidth;
+  return distanceField;
+}
+
+//------------------------------------------------------------------------------
+vtkImageData* vtkSlicerBreachWarningLogic::GetLabelmapDistanceMap( vtkMRMLScalarVolumeNode* volumeNode, int labelValue )
+{
+  vtkImageData* labelmap = volumeNode->GetImageData();
+  if ( labelmap == NULL )
+  {
+    vtkWarningMacro( "No image data in watched labelmap volume node" );
+    return NULL;
+  }
+  LabelmapDistanceMapCacheItem& cacheItem = this->LabelmapDistanceMapCache[ std::make_pair( volumeNode, labelValue ) ];
+  double* spacing = volumeNode->GetSpacing();
+  if ( cacheItem.DistanceTransform.GetPointer() != NULL
+    && cacheItem.Labelmap.GetPointer() == labelmap
+    && cacheItem.LabelmapMTime == labelmap->GetMTime()
+    && cacheItem.Spacing[0] == spacing[0] && cacheItem.Spacing[1] == spacing[1] && cacheItem.Spacing[2] == spacing[2] )
+  {
+    return cacheItem.DistanceMapValid ? cacheItem.DistanceTransform->GetOutput() : NULL;
+  }
+
+  if ( cacheItem.DistanceTransform.GetPointer() == NULL )
+  {
+    cacheItem.DistanceTransform = vtkSmartPointer< vtkLabelmapDistanceTransform >::New();
+  }
+  cacheItem.DistanceMapValid = cacheItem.DistanceTransform->Compute( labelmap, labelValue, spacing ); // expensive, but only computed once
+  cacheItem.Labelmap = labelmap;
+  cacheItem.LabelmapMTime = labelmap->GetMTime();
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    cacheItem.Spacing[axis] = spacing[axis];
+  }
+  return cacheItem.DistanceMapValid ? cacheItem.DistanceTransform->GetOutput() : NULL;
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerBreachWarningLogic::PrintSelf(ostream& os, vtkIndent indent)
+bool vtkSlicerBreachWarningLogic::InterpolateDistanceField( vtkImageData* distanceField, const double position[3], double& distance, double gradient[3] )
 {
-  this->Superclass::PrintSelf(os, indent);
-}
+  double* origin = distanceField->GetOrigin();
+  double* spacing = distanceField->GetSpacing();
+  int* dimensions = distanceField->GetDimensions();
+  int baseIndex[3] = { 0, 0, 0 };
+  double fraction[3] = { 0.0, 0.0, 0.0 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    double continuousIndex = ( position[axis] - origin[axis] ) / spacing[axis];
+    if ( continuousIndex < 0 || continuousIndex > dimensions[axis] - 1 || dimensions[axis] < 2 )
+    {
+      // outside the distance field
+      return false;
+    }
+    baseIndex[axis] = std::min( static_cast<int>( floor( continuousIndex ) ), dimensions[axis] - 2 );
+    fraction[axis] = continuousIndex - baseIndex[axis];
+  }
 
-//------------------------------------------------------------------------------
-void vtkSlicerBreachWarningLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
-{
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  // Values at the 8 corners of the cell
+  float* distances = static_cast< float* >( distanceField->GetScalarPointer() );
+  vtkIdType sliceSize = static_cast<vtkIdType>( dimensions[0] ) * dimensions[1];
+  vtkIdType baseOffset = baseIndex[0] + baseIndex[1] * dimensions[0] + baseIndex[2] * sliceSize;
+  double c[2][2][2];
+  for ( int dk = 0; dk < 2; dk++ )
+  {
+    for ( int dj = 0; dj < 2; dj++ )
+    {
+      for ( int di = 0; di < 2; di++ )
+      {
+        c[di][dj][dk] = distances[ baseOffset + di + dj * dimensions[0] + dk * sliceSize ];
+        if ( c[di][dj][dk] == DISTANCE_FIELD_NOT_EVALUATED )
+        {
+          // outside the band of the distance field
+          return false;
+        }
+      }
+    }
+  }
+
+  // Trilinear interpolation and its analytic gradient
+  double fx = fraction[0];
+  double fy = fraction[1];
+  double fz = fraction[2];
+  double c00 = c[0][0][0] * ( 1 - fx ) + c[1][0][0] * fx;
+  double c10 = c[0][1][0] * ( 1 - fx ) + c[1][1][0] * fx;
+  double c01 = c[0][0][1] * ( 1 - fx ) + c[1][0][1] * fx;
+  double c11 = c[0][1][1] * ( 1 - fx ) + c[1][1][1] * fx;
+  double c0 = c00 * ( 1 - fy ) + c10 * fy;
+  double c1 = c01 * ( 1 - fy ) + c11 * fy;
+  distance = c0 * ( 1 - fz ) + c1 * fz;
+
+  double dx00 = c[1][0][0] - c[0][0][0];
+  double dx10 = c[1][1][0] - c[0][1][0];
+  double dx01 = c[1][0][1] - c[0][0][1];
+  double dx11 = c[1][1][1] - c[0][1][1];
+  gradient[0] = ( ( dx00 * ( 1 - fy ) + dx10 * fy ) * ( 1 - fz ) + ( dx01 * ( 1 - fy ) + dx11 * fy ) * fz ) / spacing[0];
+  gradient[1] = ( ( c10 - c00 ) * ( 1 - fz ) + ( c11 - c01 ) * fz ) / spacing[1];
+  gradient[2] = ( c1 - c0 ) / spacing[2];
+  return true;
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerBreachWarningLogic::RegisterNodes()
+void vtkSlicerBreachWarningLogic::UpdateModelColor( vtkMRMLBreachWarningNode* bwNode )
 {
-  if( ! this->GetMRMLScene() )
+  if ( bwNode == NULL )
+  {
+    return;
+  }
+  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
+  if ( modelNode == NULL )
+  {
+    return;
+  }
+  if ( modelNode->GetDisplayNode() == NULL )
   {
-    vtkWarningMacro( "MRML scene not yet created" );
     return;
   }
 
-  this->GetMRMLScene()->RegisterNodeClass( vtkSmartPointer< vtkMRMLBreachWarningNode >::New() );
+  // Only set the color if it is changed to avoid unnecessary display node modified events and rendering
+  double* color = bwNode->IsToolTipInsideModel() ? bwNode->GetWarningColor() : bwNode->GetOriginalColor();
+  double* currentColor = modelNode->GetDisplayNode()->GetColor();
+  if ( currentColor[0] != color[0] || currentColor[1] != color[1] || currentColor[2] != color[2] )
+  {
+    modelNode->GetDisplayNode()->SetColor(color);
+  }
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerBreachWarningLogic::UpdateToolState( vtkMRMLBreachWarningNode* bwNode )
+void vtkSlicerBreachWarningLogic::UpdateDistanceColoring( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Locator[3] )
 {
-  if ( bwNode == NULL )
+  ToolStateCacheItem& toolState = this->ToolStateCache[bwNode];
+  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
+  std::map< vtkMRMLModelNode*, DistanceFilterCacheItem >::iterator cacheItemIt = this->DistanceFilterCache.find( modelNode );
+  if ( !bwNode->GetDistanceColoringEnabled() || modelNode == NULL || modelNode->GetDisplayNode() == NULL || this->GetMRMLScene() == NULL
+    || cacheItemIt == this->DistanceFilterCache.end() || cacheItemIt->second.ModelTransformedToRas )
   {
+    // the model has to be in the coordinate system of the locator, non-linearly transformed models are not colored
+    this->RemoveDistanceColoring( bwNode );
     return;
   }
-
-  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
-  vtkMRMLTransformNode* toolToRasNode = bwNode->GetToolTransformNode();
-
-  if ( modelNode == NULL || toolToRasNode == NULL )
+  if ( toolState.DistanceColoringModelNode.GetPointer() != modelNode )
   {
-    bwNode->SetClosestDistanceToModelFromToolTip(0);
-    return;
+    this->RemoveDistanceColoring( bwNode );
   }
-
-  vtkPolyData* body = modelNode->GetPolyData();
-  if ( body == NULL )
+  DistanceFilterCacheItem& cacheItem = cacheItemIt->second;
+  vtkPolyData* polyData = cacheItem.ModelPolyData;
+  if ( polyData == NULL || polyData->GetNumberOfPoints() == 0 )
   {
-    vtkWarningMacro( "No surface model in node" );
     return;
   }
-  
-  vtkSmartPointer< vtkImplicitPolyDataDistance > implicitDistanceFilter = vtkSmartPointer< vtkImplicitPolyDataDistance >::New();
-
-  // Transform the body poly data if there is a parent transform.
-  vtkMRMLTransformNode* bodyParentTransform = modelNode->GetParentTransformNode();
-  if ( bodyParentTransform != NULL )
+  if ( cacheItem.PointLocator == NULL )
   {
-    vtkSmartPointer< vtkGeneralTransform > bodyToRasTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-    bodyParentTransform->GetTransformToWorld( bodyToRasTransform );
+    // the locator is only rebuilt if the model points are changed
+    vtkNew<vtkPolyData> modelPoints;
+    modelPoints->SetPoints( polyData->GetPoints() );
+    cacheItem.PointLocator = vtkSmartPointer<vtkPointLocator>::New();
+    cacheItem.PointLocator->SetDataSet( modelPoints.GetPointer() );
+    cacheItem.PointLocator->BuildLocator();
+  }
 
-    vtkSmartPointer< vtkTransformPolyDataFilter > bodyToRasFilter = vtkSmartPointer< vtkTransformPolyDataFilter >::New();
-#if (VTK_MAJOR_VERSION <= 5)
-    bodyToRasFilter->SetInput( body );
-#else
-    bodyToRasFilter->SetInputData( body );
-#endif
-    bodyToRasFilter->SetTransform( bodyToRasTransform );
-    bodyToRasFilter->Update(); // expensive: transforms all the points of the polydata
+  this->DistanceColoringUpdateInProgress = true;
+  if ( toolState.DistanceColoringModelNode.GetPointer() == NULL )
+  {
+    // the colored surface is shown instead of the watched model
+    toolState.DistanceColoringModelNode = modelNode;
+    toolState.DistanceColoringModelVisibility = modelNode->GetDisplayNode()->GetVisibility();
+    modelNode->GetDisplayNode()->SetVisibility( false );
+  }
+  vtkMRMLModelNode* coloringModelNode = toolState.DistanceColoringDisplayModelNode;
+  if ( coloringModelNode == NULL || coloringModelNode->GetScene() != this->GetMRMLScene() )
+  {
+    coloringModelNode = this->CreateDistanceColoringModelNode( modelNode );
+    coloringModelNode->GetDisplayNode()->SetVisibility( toolState.DistanceColoringModelVisibility );
+    toolState.DistanceColoringDisplayModelNode = coloringModelNode;
+    toolState.DistanceColoringPolyData = NULL;
+  }
+  const char* modelTransformNodeID = modelNode->GetTransformNodeID();
+  const char* coloringTransformNodeID = coloringModelNode->GetTransformNodeID();
+  if ( ( modelTransformNodeID == NULL ) != ( coloringTransformNodeID == NULL )
+    || ( modelTransformNodeID != NULL && strcmp( modelTransformNodeID, coloringTransformNodeID ) != 0 ) )
+  {
+    coloringModelNode->SetAndObserveTransformNodeID( modelTransformNodeID );
+  }
 
-    implicitDistanceFilter->SetInput( bodyToRasFilter->GetOutput() ); // expensive: builds a locator
+  double radius = bwNode->GetDistanceColoringRadius();
+  bool fullUpdate = ( toolState.DistanceColoringPolyData.GetPointer() != polyData || toolState.DistanceColoringPolyDataMTime != polyData->GetMTime()
+    || toolState.DistanceColoringRadius != radius || coloringModelNode->GetPolyData() == NULL );
+  if ( fullUpdate )
+  {
+    // The colored surface shares the points, cells, and point data arrays of the model, only the distance array is its own
+    vtkSmartPointer<vtkPolyData> coloredPolyData = vtkSmartPointer<vtkPolyData>::New();
+    coloredPolyData->ShallowCopy( polyData );
+    vtkNew<vtkFloatArray> newDistances;
+    newDistances->SetName( DISTANCE_COLORING_ARRAY_NAME );
+    newDistances->SetNumberOfTuples( polyData->GetNumberOfPoints() );
+    // vertices farther than the radius are not updated, they all have the maximum value
+    newDistances->FillComponent( 0, radius );
+    coloredPolyData->GetPointData()->AddArray( newDistances.GetPointer() );
+    coloringModelNode->SetAndObservePolyData( coloredPolyData );
+    vtkMRMLDisplayNode* displayNode = coloringModelNode->GetDisplayNode();
+    int wasModified = displayNode->StartModify();
+    displayNode->SetActiveScalarName( DISTANCE_COLORING_ARRAY_NAME );
+    displayNode->SetScalarRange( 0.0, radius );
+    displayNode->SetScalarVisibility( true );
+    displayNode->EndModify( wasModified );
   }
-  else
+  vtkPolyData* coloredPolyData = coloringModelNode->GetPolyData();
+  vtkFloatArray* distances = vtkFloatArray::SafeDownCast( coloredPolyData->GetPointData()->GetArray( DISTANCE_COLORING_ARRAY_NAME ) );
+
+  // Only vertices within the radius of the previous or current tool tip position may have changed.
+  // The distance is computed in the locator coordinate system (the same as RAS, if the model is not scaled).
+  vtkPoints* points = polyData->GetPoints();
+  for ( int searchIndex = ( fullUpdate ? 1 : 0 ); searchIndex < 2; searchIndex++ )
   {
-    implicitDistanceFilter->SetInput( body ); // expensive: builds a locator
+    double* searchCenter = ( searchIndex == 0 ? toolState.DistanceColoringToolTipPosition_Locator : toolTipPosition_Locator );
+    cacheItem.PointLocator->FindPointsWithinRadius( radius, searchCenter, this->DistanceColoringPointIds );
+    vtkIdType numberOfPointIds = this->DistanceColoringPointIds->GetNumberOfIds();
+    for ( vtkIdType idIndex = 0; idIndex < numberOfPointIds; idIndex++ )
+    {
+      vtkIdType pointId = this->DistanceColoringPointIds->GetId( idIndex );
+      double distance = sqrt( vtkMath::Distance2BetweenPoints( points->GetPoint( pointId ), toolTipPosition_Locator ) );
+      distances->SetValue( pointId, static_cast<float>( std::min( distance, radius ) ) );
+    }
   }
-  
-  // Note: Performance could be improved by
-  // - keeping the filter in memory for all the observed nodes.
-  // - in case of linear transform of model and tooltip: transform only the tooltip (with the tooltip to model transform),
-  //   and not transform the model at all
+  // Only the colored copy is modified, the model polydata and the locators built from it remain unchanged
+  distances->Modified();
+  coloredPolyData->Modified();
+  this->DistanceColoringUpdateInProgress = false;
 
-  vtkSmartPointer<vtkGeneralTransform> toolToRasTransform = vtkSmartPointer<vtkGeneralTransform>::New();
-  toolToRasNode->GetTransformToWorld( toolToRasTransform ); 
-  double toolTipPosition_Tool[4] = { 0.0, 0.0, 0.0, 1.0 };
-  double* toolTipPosition_Ras = toolToRasTransform->TransformDoublePoint( toolTipPosition_Tool);
+  toolState.DistanceColoringPolyData = polyData;
+  toolState.DistanceColoringPolyDataMTime = polyData->GetMTime();
+  toolState.DistanceColoringRadius = radius;
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    toolState.DistanceColoringToolTipPosition_Locator[axis] = toolTipPosition_Locator[axis];
+  }
+}
 
-  double closestPointOnModel_Ras[3] = {0};
-  double closestPointDistance = implicitDistanceFilter->EvaluateFunctionAndGetClosestPoint( toolTipPosition_Ras, closestPointOnModel_Ras);
-  bwNode->SetClosestDistanceToModelFromToolTip(closestPointDistance);
-  bwNode->SetClosestPointOnModel(closestPointOnModel_Ras);
+//------------------------------------------------------------------------------
+vtkMRMLModelNode* vtkSlicerBreachWarningLogic::CreateDistanceColoringModelNode( vtkMRMLModelNode* modelNode )
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  vtkSmartPointer<vtkMRMLModelDisplayNode> coloringDisplayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+  // same appearance as the watched model, except the scalar coloring
+  coloringDisplayNode->Copy( modelNode->GetDisplayNode() );
+  coloringDisplayNode->SetSaveWithScene( false );
+  scene->AddNode( coloringDisplayNode );
 
-  this->UpdateLineToClosestPoint(bwNode, toolTipPosition_Ras, closestPointOnModel_Ras, closestPointDistance);
+  vtkSmartPointer<vtkMRMLModelNode> coloringModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
+  std::string coloringModelName = std::string( modelNode->GetName() ? modelNode->GetName() : "" ) + "_DistanceColoring";
+  coloringModelNode->SetName( coloringModelName.c_str() );
+  coloringModelNode->SetHideFromEditors( true );
+  coloringModelNode->SetSaveWithScene( false );
+  scene->AddNode( coloringModelNode );
+  coloringModelNode->SetAndObserveDisplayNodeID( coloringDisplayNode->GetID() );
+  coloringModelNode->SetAndObserveTransformNodeID( modelNode->GetTransformNodeID() );
+  return coloringModelNode;
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerBreachWarningLogic::UpdateModelColor( vtkMRMLBreachWarningNode* bwNode )
+void vtkSlicerBreachWarningLogic::RemoveDistanceColoring( vtkMRMLBreachWarningNode* bwNode )
 {
-  if ( bwNode == NULL )
-  {
-    return;
-  }
-  vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
-  if ( modelNode == NULL )
-  {
-    return;
-  }
-  if ( modelNode->GetDisplayNode() == NULL )
+  std::map< vtkMRMLBreachWarningNode*, ToolStateCacheItem >::iterator toolStateIt = this->ToolStateCache.find( bwNode );
+  if ( toolStateIt == this->ToolStateCache.end()
+    || ( toolStateIt->second.DistanceColoringModelNode.GetPointer() == NULL && toolStateIt->second.DistanceColoringDisplayModelNode.GetPointer() == NULL ) )
   {
+    // not colored
     return;
   }
+  ToolStateCacheItem& toolState = toolStateIt->second;
+  vtkMRMLModelNode* modelNode = toolState.DistanceColoringModelNode;
+  vtkMRMLModelNode* coloringModelNode = toolState.DistanceColoringDisplayModelNode;
+  toolState.DistanceColoringModelNode = NULL;
+  toolState.DistanceColoringDisplayModelNode = NULL;
+  toolState.DistanceColoringPolyData = NULL;
 
-  if ( bwNode->IsToolTipInsideModel())
+  this->DistanceColoringUpdateInProgress = true;
+  if ( modelNode != NULL && modelNode->GetDisplayNode() != NULL )
   {
-    double* color = bwNode->GetWarningColor();
-    modelNode->GetDisplayNode()->SetColor(color);
+    modelNode->GetDisplayNode()->SetVisibility( toolState.DistanceColoringModelVisibility );
   }
-  else
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if ( coloringModelNode != NULL && scene != NULL && coloringModelNode->GetScene() == scene )
   {
-    double* color = bwNode->GetOriginalColor();
-    modelNode->GetDisplayNode()->SetColor(color);
+    vtkMRMLDisplayNode* coloringDisplayNode = coloringModelNode->GetDisplayNode();
+    scene->RemoveNode( coloringModelNode );
+    if ( coloringDisplayNode != NULL && coloringDisplayNode->GetScene() == scene )
+    {
+      scene->RemoveNode( coloringDisplayNode );
+    }
   }
+  this->DistanceColoringUpdateInProgress = false;
 }
 
 //------------------------------------------------------------------------------
@@ -199,33 +1298,34 @@ void vtkSlicerBreachWarningLogic::OnMRMLSceneNodeAdded( vtkMRMLNode* node )
     return;
   }
 
+  if ( this->GetMRMLScene()->IsBatchProcessing() )
+  {
+    return; // set up in OnMRMLSceneEndBatchProcess
+  }
+
   vtkMRMLBreachWarningNode* bwNode = vtkMRMLBreachWarningNode::SafeDownCast(node);
   if ( bwNode )
   {
     vtkDebugMacro( "OnMRMLSceneNodeAdded: Module node added." );
-    vtkUnObserveMRMLNodeMacro( bwNode ); // Remove previous observers.
-    vtkNew<vtkIntArray> events;
-    events->InsertNextValue( vtkCommand::ModifiedEvent );
-    events->InsertNextValue( vtkMRMLBreachWarningNode::InputDataModifiedEvent );
-    vtkObserveMRMLNodeEventsMacro( bwNode, events.GetPointer() );
-    if(bwNode->GetPlayWarningSound() && bwNode->IsToolTipInsideModel())
-    {
-      // Add to list of playing nodes (if not there already)
-      std::deque< vtkWeakPointer< vtkMRMLBreachWarningNode > >::iterator foundPlayingNodeIt = this->WarningSoundPlayingNodes.begin();    
-      for (; foundPlayingNodeIt!=this->WarningSoundPlayingNodes.end(); ++foundPlayingNodeIt)
-      {
-        if (foundPlayingNodeIt->GetPointer()==bwNode)
-        {
-          // found, current bw node is already in the playing list
-          break;
-        }
-      }
-      if (foundPlayingNodeIt==this->WarningSoundPlayingNodes.end())
-      {
-        this->WarningSoundPlayingNodes.push_back(bwNode);
-      }
-      this->SetWarningSoundPlaying(true);
-    }
+    this->InitializeModuleNode( bwNode );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::InitializeModuleNode( vtkMRMLBreachWarningNode* bwNode )
+{
+  if ( bwNode == NULL )
+  {
+    return;
+  }
+  vtkUnObserveMRMLNodeMacro( bwNode ); // Remove previous observers.
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  events->InsertNextValue( vtkMRMLBreachWarningNode::InputDataModifiedEvent );
+  vtkObserveMRMLNodeEventsMacro( bwNode, events.GetPointer() );
+  if(bwNode->GetPlayWarningSound() && bwNode->IsToolTipInsideModel())
+  {
+    this->SetNodeWarningSoundPlaying(bwNode, true);
   }
 }
 
@@ -238,19 +1338,40 @@ void vtkSlicerBreachWarningLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
     return;
   }
 
+  if ( node->IsA( "vtkMRMLModelNode" ) )
+  {
+    this->DistanceFilterCache.erase( vtkMRMLModelNode::SafeDownCast( node ) );
+    this->Internal->ModelSnapshots.erase( vtkMRMLModelNode::SafeDownCast( node ) );
+  }
+
+  if ( node->IsA( "vtkMRMLScalarVolumeNode" ) )
+  {
+    std::map< std::pair< vtkMRMLScalarVolumeNode*, int >, LabelmapDistanceMapCacheItem >::iterator cacheItemIt = this->LabelmapDistanceMapCache.begin();
+    while ( cacheItemIt != this->LabelmapDistanceMapCache.end() )
+    {
+      if ( cacheItemIt->first.first == node )
+      {
+        this->LabelmapDistanceMapCache.erase( cacheItemIt++ );
+      }
+      else
+      {
+        ++cacheItemIt;
+      }
+    }
+  }
+
   if ( node->IsA( "vtkMRMLBreachWarningNode" ) )
   {
     vtkDebugMacro( "OnMRMLSceneNodeRemoved" );
     vtkUnObserveMRMLNodeMacro( node );
-    for (std::deque< vtkWeakPointer< vtkMRMLBreachWarningNode > >::iterator it=this->WarningSoundPlayingNodes.begin(); it!=this->WarningSoundPlayingNodes.end(); ++it)
+    this->SetNodeWarningSoundPlaying(vtkMRMLBreachWarningNode::SafeDownCast( node ), false);
+    this->RemoveDistanceColoring(vtkMRMLBreachWarningNode::SafeDownCast( node ));
+    this->ToolStateCache.erase( vtkMRMLBreachWarningNode::SafeDownCast( node ) );
+    if ( this->PendingToolStateUpdateNodes.erase( vtkMRMLBreachWarningNode::SafeDownCast( node ) ) > 0 && !this->HasPendingUpdates() )
     {
-      if (it->GetPointer()==node)
-      {
-        this->WarningSoundPlayingNodes.erase(it);
-        break;
-      }
+      this->InvokeEvent( PendingUpdatesModifiedEvent );
     }
-    this->SetWarningSoundPlaying(!this->WarningSoundPlayingNodes.empty());
+    this->RemovePendingLineToClosestPointUpdate( vtkMRMLBreachWarningNode::SafeDownCast( node ) );
 
     // Delete the line to closest point ruler
     vtkMRMLBreachWarningNode* moduleNode = vtkMRMLBreachWarningNode::SafeDownCast(node);
@@ -302,6 +1423,8 @@ void vtkSlicerBreachWarningLogic::SetWatchedModelNode( vtkMRMLModelNode* newMode
     moduleNode->SetOriginalColor(originalColor);
   }
 
+  this->RemoveDistanceColoring(moduleNode);
+
   // Switch to the new model node
   moduleNode->SetAndObserveWatchedModelNodeID( (newModel!=NULL) ? newModel->GetID() : NULL );
 
@@ -312,6 +1435,18 @@ void vtkSlicerBreachWarningLogic::SetWatchedModelNode( vtkMRMLModelNode* newMode
   }
 }
 
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( caller == vtkSlicerTrackingTickLogic::GetInstance() && event == vtkSlicerTrackingTickLogic::TrackingTickEvent )
+  {
+    this->ProcessPendingUpdates();
+    this->ProcessAsynchronousResults();
+    return;
+  }
+  this->Superclass::ProcessMRMLLogicsEvents( caller, event, callData );
+}
+
 //------------------------------------------------------------------------------
 void vtkSlicerBreachWarningLogic::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* vtkNotUsed(callData) )
 {
@@ -327,45 +1462,157 @@ void vtkSlicerBreachWarningLogic::ProcessMRMLNodesEvents( vtkObject* caller, uns
     return;
   }
   
-  if (event==vtkMRMLBreachWarningNode::InputDataModifiedEvent)
+  if (event==vtkMRMLBreachWarningNode::InputDataModifiedEvent && !this->DistanceColoringUpdateInProgress)
   {
     // only recompute output if the input is changed
     // (for example we do not recompute the distance if the computed distance is changed)
-    this->UpdateToolState(bwNode);
-    if (bwNode->GetDisplayWarningColor())
+    this->PerformanceCounters->EventReceived();
+    vtkLatencyInstrumentation::GetInstance()->SourceNodeModified(bwNode->GetToolTransformNode());
+    if (this->GetMRMLScene() && this->GetMRMLScene()->IsBatchProcessing())
     {
-      this->UpdateModelColor(bwNode);
+      // all nodes will be updated in one pass at the end of the batch processing
+      this->PerformanceCounters->UpdateSkipped();
+      return;
     }
-    std::deque< vtkWeakPointer< vtkMRMLBreachWarningNode > >::iterator foundPlayingNodeIt = this->WarningSoundPlayingNodes.begin();    
-    for (; foundPlayingNodeIt!=this->WarningSoundPlayingNodes.end(); ++foundPlayingNodeIt)
+    // All changes are coalesced until the next tick, where the pending nodes are updated in one pass
+    bool hadPendingUpdates = this->HasPendingUpdates();
+    if (!this->PendingToolStateUpdateNodes.insert(bwNode).second)
     {
-      if (foundPlayingNodeIt->GetPointer()==bwNode)
-      {
-        // found current bw node is already in the playing list
-        break;
-      }
+      this->PerformanceCounters->UpdateSkipped();
     }
-    if(bwNode->GetPlayWarningSound() && bwNode->IsToolTipInsideModel())
+    if (!hadPendingUpdates)
     {
-      // Add to list of playing nodes (if not there already)
-      if (foundPlayingNodeIt==this->WarningSoundPlayingNodes.end())
-      {
-        this->WarningSoundPlayingNodes.push_back(bwNode);
-      }
+      this->InvokeEvent(PendingUpdatesModifiedEvent);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateWarnings( vtkMRMLBreachWarningNode* bwNode )
+{
+  if (bwNode->GetDisplayWarningColor())
+  {
+    this->UpdateModelColor(bwNode);
+  }
+  this->SetNodeWarningSoundPlaying(bwNode, bwNode->GetPlayWarningSound() && bwNode->IsToolTipInsideModel());
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::SetNodeWarningSoundPlaying( vtkMRMLBreachWarningNode* bwNode, bool playing )
+{
+  if ( bwNode == NULL )
+  {
+    return;
+  }
+  std::map< vtkMRMLBreachWarningNode*, ToolStateCacheItem >::iterator toolStateIt = this->ToolStateCache.find( bwNode );
+  if ( toolStateIt == this->ToolStateCache.end() )
+  {
+    if ( !playing )
+    {
+      // not playing and not in the cache, nothing to do (avoid adding an entry for a node that is being removed)
+      return;
+    }
+    toolStateIt = this->ToolStateCache.insert( std::make_pair( bwNode, ToolStateCacheItem() ) ).first;
+  }
+  if ( toolStateIt->second.WarningSoundPlaying == playing )
+  {
+    return;
+  }
+  toolStateIt->second.WarningSoundPlaying = playing;
+  this->NumberOfWarningSoundPlayingNodes += ( playing ? 1 : -1 );
+  this->SetWarningSoundPlaying( this->NumberOfWarningSoundPlayingNodes > 0 );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateAllToolStates()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if ( scene == NULL )
+  {
+    return;
+  }
+  std::vector< vtkMRMLNode* > nodes;
+  scene->GetNodesByClass( "vtkMRMLBreachWarningNode", nodes );
+  std::vector< vtkMRMLBreachWarningNode* > bwNodes;
+  for ( std::vector< vtkMRMLNode* >::iterator nodeIt = nodes.begin(); nodeIt != nodes.end(); ++nodeIt )
+  {
+    vtkMRMLBreachWarningNode* bwNode = vtkMRMLBreachWarningNode::SafeDownCast( *nodeIt );
+    if ( bwNode != NULL )
+    {
+      bwNodes.push_back( bwNode );
+    }
+  }
+  // all nodes are updated, including the pending ones
+  bool hadPendingToolStateUpdates = !this->PendingToolStateUpdateNodes.empty();
+  this->PendingToolStateUpdateNodes.clear();
+  this->UpdateToolStates( bwNodes );
+  if ( hadPendingToolStateUpdates && !this->HasPendingUpdates() )
+  {
+    this->InvokeEvent( PendingUpdatesModifiedEvent );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::UpdateToolStates( const std::vector< vtkMRMLBreachWarningNode* >& bwNodes )
+{
+  // Tool tip positions are computed only once for each tool, even if the tool is watched by many nodes
+  std::map< vtkMRMLTransformNode*, std::vector<double> > toolTipPositions_Ras;
+
+  for ( std::vector< vtkMRMLBreachWarningNode* >::const_iterator nodeIt = bwNodes.begin(); nodeIt != bwNodes.end(); ++nodeIt )
+  {
+    vtkMRMLBreachWarningNode* bwNode = *nodeIt;
+    if ( this->AsynchronousUpdate && this->RequestAsynchronousToolStateUpdate( bwNode ) )
+    {
+      // results will be applied in ProcessAsynchronousResults
+      continue;
+    }
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    // Only invoke a single modified event per node
+    int wasModified = bwNode->StartModify();
+    vtkMRMLModelNode* modelNode = bwNode->GetWatchedModelNode();
+    vtkMRMLTransformNode* toolToRasNode = bwNode->GetToolTransformNode();
+    if ( modelNode == NULL || toolToRasNode == NULL || modelNode->GetPolyData() == NULL )
+    {
+      // invalid inputs are handled by the single node update
+      this->UpdateToolState( bwNode );
     }
     else
     {
-      // Remove from list of playing nodes (if still there)
-      if (foundPlayingNodeIt!=this->WarningSoundPlayingNodes.end())
+      std::vector<double>& toolTipPosition_Ras = toolTipPositions_Ras[toolToRasNode];
+      if ( toolTipPosition_Ras.empty() )
       {
-        this->WarningSoundPlayingNodes.erase(foundPlayingNodeIt);
+        toolTipPosition_Ras.resize( 3, 0.0 );
+        this->GetToolTipPositionInRas( toolToRasNode, &toolTipPosition_Ras[0] );
       }
+      this->UpdateToolStateFromToolTipPosition( bwNode, &toolTipPosition_Ras[0] );
+    }
+    this->UpdateWarnings( bwNode );
+    bwNode->EndModify( wasModified );
+    vtkLatencyInstrumentation::GetInstance()->RecordStageLatency( "BreachWarning", toolToRasNode );
+    this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::OnMRMLSceneEndBatchProcess()
+{
+  // Module nodes added during batch processing (e.g., scene import) are set up in a single pass
+  if ( this->GetMRMLScene() != NULL )
+  {
+    std::vector< vtkMRMLNode* > bwNodes;
+    this->GetMRMLScene()->GetNodesByClass( "vtkMRMLBreachWarningNode", bwNodes );
+    for ( std::vector< vtkMRMLNode* >::iterator nodeIt = bwNodes.begin(); nodeIt != bwNodes.end(); ++nodeIt )
+    {
+      this->InitializeModuleNode( vtkMRMLBreachWarningNode::SafeDownCast( *nodeIt ) );
     }
-    this->SetWarningSoundPlaying(!this->WarningSoundPlayingNodes.empty());
   }
+
+  // Individual node updates are skipped during batch processing, update all nodes now
+  this->UpdateAllToolStates();
 }
 
 
+
 //------------------------------------------------------------------------------
 void vtkSlicerBreachWarningLogic::UpdateLineToClosestPoint(vtkMRMLBreachWarningNode* bwNode, double* toolTipPosition_Ras, double* closestPointOnModel_Ras, double closestPointDistance)
 {
@@ -381,16 +1628,96 @@ void vtkSlicerBreachWarningLogic::UpdateLineToClosestPoint(vtkMRMLBreachWarningN
     return;
   }
 
+  // Only rename the ruler if the inside/outside state is changed to avoid unnecessary node and scene events
+  const char* rulerName = ( closestPointDistance < 0 ) ? "d (in)" : "d";
+  bool rulerNameChanged = ( ruler->GetName() == NULL || strcmp( ruler->GetName(), rulerName ) != 0 );
+
+  // Postpone position update if the last one was too recent. Only the latest positions are kept,
+  // they are shown by ProcessPendingUpdates() when the interval has elapsed.
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  ToolStateCacheItem& toolState = this->ToolStateCache[bwNode];
+  if ( !rulerNameChanged && currentTimeSec - toolState.LastLineToClosestPointUpdateTimeSec < bwNode->GetLineToClosestPointUpdateIntervalSec() )
+  {
+    std::copy( toolTipPosition_Ras, toolTipPosition_Ras + 3, toolState.PendingLineToolTipPosition_Ras );
+    std::copy( closestPointOnModel_Ras, closestPointOnModel_Ras + 3, toolState.PendingLineClosestPointOnModel_Ras );
+    bool hadPendingUpdates = this->HasPendingUpdates();
+    this->PendingLineToClosestPointNodes.insert( bwNode );
+    if ( !hadPendingUpdates )
+    {
+      this->InvokeEvent( PendingUpdatesModifiedEvent );
+    }
+    return;
+  }
+  toolState.LastLineToClosestPointUpdateTimeSec = currentTimeSec;
+  this->RemovePendingLineToClosestPointUpdate( bwNode );
+
+  int wasModified = ruler->StartModify();
   ruler->SetPosition1(toolTipPosition_Ras);
   ruler->SetPosition2(closestPointOnModel_Ras);
-  if (closestPointDistance<0)
-  {    
-    ruler->SetName("d (in)");
+  if ( rulerNameChanged )
+  {
+    ruler->SetName( rulerName );
   }
-  else
-  {   
-    ruler->SetName("d");
+  ruler->EndModify(wasModified);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::RemovePendingLineToClosestPointUpdate(vtkMRMLBreachWarningNode* bwNode)
+{
+  if ( this->PendingLineToClosestPointNodes.erase( bwNode ) > 0 && !this->HasPendingUpdates() )
+  {
+    this->InvokeEvent( PendingUpdatesModifiedEvent );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerBreachWarningLogic::ProcessPendingUpdates()
+{
+  if ( !this->HasPendingUpdates() )
+  {
+    return;
   }
+
+  // Nodes whose inputs changed since the last tick are updated in one pass
+  if ( !this->PendingToolStateUpdateNodes.empty() )
+  {
+    std::vector< vtkMRMLBreachWarningNode* > bwNodes( this->PendingToolStateUpdateNodes.begin(), this->PendingToolStateUpdateNodes.end() );
+    this->PendingToolStateUpdateNodes.clear();
+    this->UpdateToolStates( bwNodes );
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  for ( std::set< vtkMRMLBreachWarningNode* >::iterator nodeIt = this->PendingLineToClosestPointNodes.begin(); nodeIt != this->PendingLineToClosestPointNodes.end(); )
+  {
+    vtkMRMLBreachWarningNode* bwNode = *nodeIt;
+    ToolStateCacheItem& toolState = this->ToolStateCache[bwNode];
+    vtkMRMLAnnotationRulerNode* ruler = bwNode->GetLineToClosestPointNode();
+    if ( ruler != NULL && currentTimeSec - toolState.LastLineToClosestPointUpdateTimeSec < bwNode->GetLineToClosestPointUpdateIntervalSec() )
+    {
+      // not due yet
+      ++nodeIt;
+      continue;
+    }
+    if ( ruler != NULL )
+    {
+      toolState.LastLineToClosestPointUpdateTimeSec = currentTimeSec;
+      int wasModified = ruler->StartModify();
+      ruler->SetPosition1( toolState.PendingLineToolTipPosition_Ras );
+      ruler->SetPosition2( toolState.PendingLineClosestPointOnModel_Ras );
+      ruler->EndModify( wasModified );
+    }
+    this->PendingLineToClosestPointNodes.erase( nodeIt++ );
+  }
+  if ( !this->HasPendingUpdates() )
+  {
+    this->InvokeEvent( PendingUpdatesModifiedEvent );
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerBreachWarningLogic::HasPendingUpdates()
+{
+  return !this->PendingToolStateUpdateNodes.empty() || !this->PendingLineToClosestPointNodes.empty();
 }
 
 //------------------------------------------------------------------------------
@@ -25,7 +25,9 @@
 
 
 #include <string>
-#include <deque>
+#include <map>
+#include <set>
+#include <vector>
 
 // VTK includes
 #include "vtkWeakPointer.h"
@@ -45,8 +47,18 @@
 class vtkMRMLBreachWarningNode;
 
 class vtkMRMLModelNode;
+class vtkMRMLScalarVolumeNode;
 class vtkMRMLTransformNode;
 
+class vtkImageData;
+class vtkIdList;
+class vtkImplicitPolyDataDistance;
+class vtkLabelmapDistanceTransform;
+class vtkMatrix4x4;
+class vtkPointLocator;
+class vtkPerformanceCounters;
+class vtkPolyData;
+
 // STD includes
 #include <cstdlib>
 
@@ -60,6 +72,12 @@ public:
   vtkTypeMacro(vtkSlicerBreachWarningLogic,vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  enum Events
+  {
+    /// Invoked when HasPendingUpdates() changes
+    PendingUpdatesModifiedEvent = vtkCommand::UserEvent + 556
+  };
+
   /// Changes the watched model node, making sure the original color of the previously selected model node is restored
   void SetWatchedModelNode( vtkMRMLModelNode* newModel, vtkMRMLBreachWarningNode* moduleNode );
 
@@ -81,6 +99,48 @@ public:
   void SetLineToClosestPointThickness(double thickness, vtkMRMLBreachWarningNode* moduleNode);
 
   void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );
+  void ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData );
+
+  /// Update all breach warning nodes in the scene in a single pass (see UpdateToolStates).
+  /// Called automatically at the end of scene batch processing
+  /// (individual node updates are skipped while the scene is in batch processing state).
+  void UpdateAllToolStates();
+
+  /// Number of distance computations since the last ResetDistanceQueryStatistics() call
+  vtkGetMacro(NumberOfDistanceQueries, int);
+  /// Number of distance computations where the previous closest point was reused
+  /// because the tool tip moved less than the tool tip movement tolerance
+  vtkGetMacro(NumberOfReusedDistanceQueries, int);
+  /// Ratio of reused and all distance computations (0 if there were no computations)
+  double GetDistanceQueryReuseRate();
+  void ResetDistanceQueryStatistics();
+
+  /// Number of received input events, tool state updates computed and coalesced
+  /// (during scene batch processing), and the time spent in the updates
+  vtkPerformanceCounters* GetPerformanceCounters();
+
+  /// If enabled, closest point computation is performed on a background thread, so that
+  /// large models do not block rendering and data receiving. Results are applied to the
+  /// breach warning nodes when ProcessAsynchronousResults() is called. Nodes with tool geometry, distance field,
+  /// watched labelmap volume, or non-linearly transformed watched model are still updated synchronously.
+  /// False by default.
+  vtkGetMacro(AsynchronousUpdate, bool);
+  void SetAsynchronousUpdate(bool asynchronous);
+  vtkBooleanMacro(AsynchronousUpdate, bool);
+
+  /// Apply results computed on the background thread to the breach warning nodes.
+  /// Must be called from the main thread. Called in the consumer stage of the shared
+  /// tracking tick (see vtkSlicerTrackingTickLogic).
+  void ProcessAsynchronousResults();
+
+  /// Input changes of the breach warning nodes are not processed immediately: the nodes are marked as pending
+  /// and ProcessPendingUpdates() updates all of them in one pass, so that each node is updated once per tracker frame.
+  /// Line to closest point updates that come sooner than LineToClosestPointUpdateIntervalSec of the node
+  /// are postponed, not dropped: the latest positions are stored and the line is updated by
+  /// ProcessPendingUpdates() when the interval has elapsed. Must be called from the main thread.
+  /// Called in the consumer stage of the shared tracking tick (see vtkSlicerTrackingTickLogic).
+  void ProcessPendingUpdates();
+  bool HasPendingUpdates();
 
   /// Returns true if a warning sound has to be played
   vtkGetMacro(WarningSoundPlaying, bool);
@@ -96,10 +156,32 @@ protected:
   
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  virtual void OnMRMLSceneEndBatchProcess();
+  void InitializeModuleNode( vtkMRMLBreachWarningNode* bwNode );
 
   void UpdateToolState( vtkMRMLBreachWarningNode* bwNode );
+  /// Update the breach warning nodes in a single pass. Locators are shared between nodes that watch the same model
+  /// and tool tip positions are computed once for each tool. Each node invokes a single modified event.
+  void UpdateToolStates( const std::vector< vtkMRMLBreachWarningNode* >& bwNodes );
+  /// Compute distance from the tool tip position. Watched model and its polydata must be valid.
+  void UpdateToolStateFromToolTipPosition( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Ras[3] );
+  /// Compute distance from the tool tip position using the distance map of the watched labelmap volume.
+  /// Only the tool tip is checked, tool geometry is ignored.
+  void UpdateToolStateFromLabelmap( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Ras[3] );
+  /// Update model color and warning sound state based on the computed distance
+  void UpdateWarnings( vtkMRMLBreachWarningNode* bwNode );
   void UpdateModelColor( vtkMRMLBreachWarningNode* bwNode );
+  /// Update the distance scalars of the watched model vertices that are near the previous or current tool tip position.
+  /// The scalars are stored in a copy of the model surface that is displayed instead of the watched model,
+  /// the polydata of the watched model is not modified.
+  void UpdateDistanceColoring( vtkMRMLBreachWarningNode* bwNode, double toolTipPosition_Locator[3] );
+  /// Remove the distance colored copy of the model surface and show the watched model again
+  void RemoveDistanceColoring( vtkMRMLBreachWarningNode* bwNode );
+  /// Create the hidden model node that displays the distance colored copy of the watched model surface
+  vtkMRMLModelNode* CreateDistanceColoringModelNode( vtkMRMLModelNode* modelNode );
   void UpdateLineToClosestPoint(vtkMRMLBreachWarningNode* bwNode, double* toolTipPosition_Ras, double* closestPointOnModel_Ras, double closestPointDistance);
+  /// Remove the node from the nodes with postponed line to closest point update
+  void RemovePendingLineToClosestPointUpdate(vtkMRMLBreachWarningNode* bwNode);
   
 private:
   vtkSlicerBreachWarningLogic(const vtkSlicerBreachWarningLogic&); // Not implemented
@@ -107,7 +189,143 @@ private:
 
   void UpdateRuler(vtkMRMLBreachWarningNode* bwNode, double* toolTipPosition);
 
-  std::deque< vtkWeakPointer< vtkMRMLBreachWarningNode > > WarningSoundPlayingNodes;
+  /// Submit a closest point computation request to the background thread.
+  /// Returns false if the node cannot be updated asynchronously.
+  bool RequestAsynchronousToolStateUpdate(vtkMRMLBreachWarningNode* bwNode);
+
+  /// Set if the breach warning node requests playing the warning sound and update the overall warning sound state.
+  /// Constant time: the request state is stored in the tool state cache and only the number of requesting nodes is kept.
+  void SetNodeWarningSoundPlaying(vtkMRMLBreachWarningNode* bwNode, bool playing);
+
+  void GetToolTipPositionInRas(vtkMRMLTransformNode* toolToRasNode, double toolTipPosition_Ras[3]);
+
+  /// Returns the distance filter for the watched model. The filter is cached,
+  /// its locator is only rebuilt if the watched model is changed.
+  /// locatorToRasMatrix is set to the transform from the coordinate system of the locator to RAS.
+  vtkImplicitPolyDataDistance* GetDistanceFilter(vtkMRMLModelNode* modelNode, vtkMatrix4x4* locatorToRasMatrix);
+
+  /// Compute the closest signed distance between a straight tool segment and the model (in RAS).
+  /// Returns the distance and the corresponding points on the segment and on the model.
+  double ComputeToolSegmentDistance(vtkImplicitPolyDataDistance* implicitDistanceFilter, vtkMatrix4x4* locatorToRasMatrix,
+    double segmentStart_Locator[3], double segmentEnd_Locator[3], double closestToolPoint_Ras[3], double closestPointOnModel_Ras[3]);
+
+  /// Returns the precomputed signed distance field of the watched model (in the coordinate system of the locator).
+  /// The field is computed when first requested and cached with the locator. Only the blocks of voxels that may be
+  /// within bandWidth from the model surface are evaluated, the other voxels are marked as not evaluated.
+  /// Returns NULL if the field is not available (e.g., the model has a non-linear transform).
+  /// GetDistanceFilter must be called before this method to make sure the locator is up-to-date.
+  vtkImageData* GetDistanceField(vtkMRMLModelNode* modelNode, double voxelSize, double bandWidth);
+
+  /// Compute distance and its gradient at the given position from the distance field by trilinear interpolation.
+  /// Returns false if the position is outside the distance field or any of the interpolated voxels is not evaluated.
+  static bool InterpolateDistanceField(vtkImageData* distanceField, const double position[3], double& distance, double gradient[3]);
+
+  /// Returns the signed distance map of the watched label in the labelmap volume (in the voxel coordinate system
+  /// scaled by the volume spacing). The map is computed when first requested and recomputed only if the
+  /// image data or spacing of the volume is changed. Returns NULL if the map cannot be computed.
+  vtkImageData* GetLabelmapDistanceMap(vtkMRMLScalarVolumeNode* volumeNode, int labelValue);
+
+  /// Distance filter and the input it was built from
+  struct DistanceFilterCacheItem
+  {
+    vtkSmartPointer<vtkImplicitPolyDataDistance> DistanceFilter;
+    vtkWeakPointer<vtkPolyData> ModelPolyData;
+    unsigned long ModelPolyDataMTime;
+    /// True if the locator was built from the model transformed to RAS (non-linear model transform)
+    bool ModelTransformedToRas;
+    /// Precomputed signed distance field (NULL if not computed yet)
+    vtkSmartPointer<vtkImageData> DistanceField;
+    double DistanceFieldVoxelSize;
+    double DistanceFieldBandWidth;
+    /// Locator of the model vertices for distance coloring (NULL if not built yet).
+    /// It is built on a dataset that only contains the model points, so it is not invalidated by scalar updates.
+    vtkSmartPointer<vtkPointLocator> PointLocator;
+    DistanceFilterCacheItem() : ModelPolyDataMTime(0), ModelTransformedToRas(false), DistanceFieldVoxelSize(0), DistanceFieldBandWidth(0) {}
+  };
+  std::map< vtkMRMLModelNode*, DistanceFilterCacheItem > DistanceFilterCache;
+
+  /// Distance map of a label in a labelmap volume and the input it was computed from
+  struct LabelmapDistanceMapCacheItem
+  {
+    vtkSmartPointer<vtkLabelmapDistanceTransform> DistanceTransform;
+    vtkWeakPointer<vtkImageData> Labelmap;
+    unsigned long LabelmapMTime;
+    double Spacing[3];
+    /// False if the computation failed (e.g., no voxels with the label), to avoid retrying at every update
+    bool DistanceMapValid;
+    LabelmapDistanceMapCacheItem() : LabelmapMTime(0), DistanceMapValid(false)
+    {
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        this->Spacing[axis] = 0.0;
+      }
+    }
+  };
+  std::map< std::pair< vtkMRMLScalarVolumeNode*, int >, LabelmapDistanceMapCacheItem > LabelmapDistanceMapCache;
+
+  /// Result of the last closest point search and display update for a breach warning node
+  struct ToolStateCacheItem
+  {
+    /// Filter that was used for the search, reuse is not allowed if the locator has been rebuilt
+    vtkWeakPointer<vtkImplicitPolyDataDistance> DistanceFilter;
+    double ToolTipPosition_Locator[3];
+    double ClosestPointOnModel_Locator[3];
+    double ClosestPointDistance;
+    /// Time of the last line to closest point update (universal time, in seconds)
+    double LastLineToClosestPointUpdateTimeSec;
+    /// Latest line end points that have not been shown yet because of the update interval
+    double PendingLineToolTipPosition_Ras[3];
+    double PendingLineClosestPointOnModel_Ras[3];
+    /// True if the node is counted in NumberOfWarningSoundPlayingNodes
+    bool WarningSoundPlaying;
+    /// Distance coloring: the colored model, the model node that displays its colored surface instead of it,
+    /// the model polydata (and its modification time) that the colored surface was copied from,
+    /// the original visibility of the colored model, and the tool tip position and radius of the last update
+    vtkWeakPointer<vtkMRMLModelNode> DistanceColoringModelNode;
+    vtkWeakPointer<vtkMRMLModelNode> DistanceColoringDisplayModelNode;
+    vtkWeakPointer<vtkPolyData> DistanceColoringPolyData;
+    unsigned long DistanceColoringPolyDataMTime;
+    int DistanceColoringModelVisibility;
+    double DistanceColoringToolTipPosition_Locator[3];
+    double DistanceColoringRadius;
+    ToolStateCacheItem() : ClosestPointDistance(0), LastLineToClosestPointUpdateTimeSec(0), WarningSoundPlaying(false),
+      DistanceColoringPolyDataMTime(0), DistanceColoringModelVisibility(1), DistanceColoringRadius(0)
+    {
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        this->ToolTipPosition_Locator[axis] = 0.0;
+        this->ClosestPointOnModel_Locator[axis] = 0.0;
+        this->DistanceColoringToolTipPosition_Locator[axis] = 0.0;
+        this->PendingLineToolTipPosition_Ras[axis] = 0.0;
+        this->PendingLineClosestPointOnModel_Ras[axis] = 0.0;
+      }
+    }
+  };
+  std::map< vtkMRMLBreachWarningNode*, ToolStateCacheItem > ToolStateCache;
+  /// Nodes whose inputs changed since the last ProcessPendingUpdates() call
+  std::set< vtkMRMLBreachWarningNode* > PendingToolStateUpdateNodes;
+  /// Nodes with postponed line to closest point update
+  std::set< vtkMRMLBreachWarningNode* > PendingLineToClosestPointNodes;
+
+  int NumberOfDistanceQueries;
+  int NumberOfReusedDistanceQueries;
+
+  bool AsynchronousUpdate;
+
+  /// Reused for getting the tool tip position
+  vtkSmartPointer<vtkMatrix4x4> ToolToRasMatrix;
+  /// Reused for finding the vertices to update for distance coloring
+  vtkSmartPointer<vtkIdList> DistanceColoringPointIds;
+  /// Set while the display of the colored model is changed, to ignore the resulting model modified events
+  bool DistanceColoringUpdateInProgress;
+
+  vtkSmartPointer<vtkPerformanceCounters> PerformanceCounters;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+  /// Number of breach warning nodes that currently request playing the warning sound
+  int NumberOfWarningSoundPlayingNodes;
   bool WarningSoundPlaying;
   
   double DefaultLineToClosestPointColor[3];
@@ -7,6 +7,7 @@
 #include "vtkMRMLDisplayNode.h"
 #include "vtkMRMLModelNode.h"
 #include "vtkMRMLNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLTransformNode.h"
 
 // VTK includes
@@ -19,6 +20,7 @@
 
 // Constants
 static const char* MODEL_ROLE = "watchedModelNode";
+static const char* LABELMAP_ROLE = "watchedLabelmapVolumeNode";
 static const char* TOOL_ROLE = "toolTransformNode";
 static const char* LINE_TO_CLOSEST_POINT_ROLE = "lineToClosestPointNode";
 
@@ -39,6 +41,12 @@ vtkMRMLBreachWarningNode::vtkMRMLBreachWarningNode()
   this->AddNodeReferenceRole( TOOL_ROLE, NULL, events.GetPointer() );
   this->AddNodeReferenceRole( LINE_TO_CLOSEST_POINT_ROLE, NULL, events.GetPointer() );
 
+  vtkNew<vtkIntArray> labelmapEvents;
+  labelmapEvents->InsertNextValue( vtkCommand::ModifiedEvent );
+  labelmapEvents->InsertNextValue( vtkMRMLTransformableNode::TransformModifiedEvent );
+  labelmapEvents->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  this->AddNodeReferenceRole( LABELMAP_ROLE, NULL, labelmapEvents.GetPointer() );
+
   this->OriginalColor[0] = 0.5;
   this->OriginalColor[1] = 0.5;
   this->OriginalColor[2] = 0.5;
@@ -51,6 +59,16 @@ vtkMRMLBreachWarningNode::vtkMRMLBreachWarningNode()
   this->DisplayWarningColor = true;
   this->PlayWarningSound = false;
 
+  this->DistanceFieldEnabled = false;
+  this->DistanceFieldVoxelSize = 1.0;
+  this->DistanceFieldBandWidth = 20.0;
+  this->DistanceColoringEnabled = false;
+  this->DistanceColoringRadius = 20.0;
+  this->WatchedLabelValue = 0;
+  this->ToolTipMovementTolerance = 0.0;
+  this->LineToClosestPointUpdateIntervalSec = 0.0;
+  this->ToolRadius = 0.0;
+
   this->ClosestDistanceToModelFromToolTip = 0.0;
 
   this->ClosestPointOnModel[0] = 0.0;
@@ -74,6 +92,25 @@ void vtkMRMLBreachWarningNode::WriteXML( ostream& of, int nIndent )
   of << indent << " originalColor=\"" << this->OriginalColor[0] << " " << this->OriginalColor[1] << " " << this->OriginalColor[2] << "\"";
   of << indent << " displayWarningColor=\"" << ( this->DisplayWarningColor ? "true" : "false" ) << "\"";
   of << indent << " playWarningSound=\"" << ( this->PlayWarningSound ? "true" : "false" ) << "\"";
+  of << indent << " distanceFieldEnabled=\"" << ( this->DistanceFieldEnabled ? "true" : "false" ) << "\"";
+  of << indent << " distanceFieldVoxelSize=\"" << this->DistanceFieldVoxelSize << "\"";
+  of << indent << " distanceFieldBandWidth=\"" << this->DistanceFieldBandWidth << "\"";
+  of << indent << " distanceColoringEnabled=\"" << ( this->DistanceColoringEnabled ? "true" : "false" ) << "\"";
+  of << indent << " distanceColoringRadius=\"" << this->DistanceColoringRadius << "\"";
+  of << indent << " watchedLabelValue=\"" << this->WatchedLabelValue << "\"";
+  of << indent << " toolTipMovementTolerance=\"" << this->ToolTipMovementTolerance << "\"";
+  of << indent << " lineToClosestPointUpdateIntervalSec=\"" << this->LineToClosestPointUpdateIntervalSec << "\"";
+  of << indent << " toolGeometryPoints=\"";
+  for (std::vector<double>::iterator it = this->ToolGeometryPoints.begin(); it != this->ToolGeometryPoints.end(); ++it)
+  {
+    if (it != this->ToolGeometryPoints.begin())
+    {
+      of << " ";
+    }
+    of << (*it);
+  }
+  of << "\"";
+  of << indent << " toolRadius=\"" << this->ToolRadius << "\"";
   of << indent << " closestDistanceToModelFromToolTip=\"" << ClosestDistanceToModelFromToolTip << "\"";
   of << indent << " closestPointOnModel=\"" << this->ClosestPointOnModel[0] << " " << this->ClosestPointOnModel[1] << " " << this->ClosestPointOnModel[2] << "\"";
 }
@@ -138,6 +175,97 @@ void vtkMRMLBreachWarningNode::ReadXMLAttributes( const char** atts )
         this->PlayWarningSound = false;
       }
     }
+    else if ( ! strcmp( attName, "distanceFieldEnabled" ) )
+    {
+      if (!strcmp(attValue,"true"))
+      {
+        this->DistanceFieldEnabled = true;
+      }
+      else
+      {
+        this->DistanceFieldEnabled = false;
+      }
+    }
+    else if (!strcmp(attName, "distanceFieldVoxelSize"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=1.0;
+      ss >> val;
+      this->DistanceFieldVoxelSize = val;
+    }
+    else if (!strcmp(attName, "distanceFieldBandWidth"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=20.0;
+      ss >> val;
+      this->DistanceFieldBandWidth = val;
+    }
+    else if ( ! strcmp( attName, "distanceColoringEnabled" ) )
+    {
+      if (!strcmp(attValue,"true"))
+      {
+        this->DistanceColoringEnabled = true;
+      }
+      else
+      {
+        this->DistanceColoringEnabled = false;
+      }
+    }
+    else if (!strcmp(attName, "distanceColoringRadius"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=20.0;
+      ss >> val;
+      this->DistanceColoringRadius = val;
+    }
+    else if (!strcmp(attName, "toolTipMovementTolerance"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=0.0;
+      ss >> val;
+      this->ToolTipMovementTolerance = val;
+    }
+    else if (!strcmp(attName, "watchedLabelValue"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      int val=0;
+      ss >> val;
+      this->WatchedLabelValue = val;
+    }
+    else if (!strcmp(attName, "lineToClosestPointUpdateIntervalSec"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=0.0;
+      ss >> val;
+      this->LineToClosestPointUpdateIntervalSec = val;
+    }
+    else if (!strcmp(attName, "toolGeometryPoints"))
+    {
+      this->ToolGeometryPoints.clear();
+      std::stringstream ss;
+      ss << attValue;
+      double point[3] = { 0.0, 0.0, 0.0 };
+      while (ss >> point[0] >> point[1] >> point[2])
+      {
+        this->ToolGeometryPoints.push_back(point[0]);
+        this->ToolGeometryPoints.push_back(point[1]);
+        this->ToolGeometryPoints.push_back(point[2]);
+      }
+    }
+    else if (!strcmp(attName, "toolRadius"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double val=0.0;
+      ss >> val;
+      this->ToolRadius = val;
+    }
     else if (!strcmp(attName, "closestDistanceToModelFromToolTip"))
     {
       std::stringstream ss;
@@ -176,6 +304,16 @@ void vtkMRMLBreachWarningNode::Copy( vtkMRMLNode *anode )
 
   this->PlayWarningSound = node->PlayWarningSound;  
   this->DisplayWarningColor = node->DisplayWarningColor;
+  this->DistanceFieldEnabled = node->DistanceFieldEnabled;
+  this->DistanceFieldVoxelSize = node->DistanceFieldVoxelSize;
+  this->DistanceFieldBandWidth = node->DistanceFieldBandWidth;
+  this->DistanceColoringEnabled = node->DistanceColoringEnabled;
+  this->DistanceColoringRadius = node->DistanceColoringRadius;
+  this->WatchedLabelValue = node->WatchedLabelValue;
+  this->ToolTipMovementTolerance = node->ToolTipMovementTolerance;
+  this->LineToClosestPointUpdateIntervalSec = node->LineToClosestPointUpdateIntervalSec;
+  this->ToolGeometryPoints = node->ToolGeometryPoints;
+  this->ToolRadius = node->ToolRadius;
 
   this->Modified();
 }
@@ -187,12 +325,24 @@ void vtkMRMLBreachWarningNode::PrintSelf( ostream& os, vtkIndent indent )
 
   os << indent << "WatchedModelID: " << (this->GetWatchedModelNode() && this->GetWatchedModelNode()->GetID() ?
    this->GetWatchedModelNode()->GetID() : "(none)" ) << std::endl;
+  os << indent << "WatchedLabelmapVolumeID: " << (this->GetWatchedLabelmapVolumeNode() && this->GetWatchedLabelmapVolumeNode()->GetID() ?
+   this->GetWatchedLabelmapVolumeNode()->GetID() : "(none)" ) << std::endl;
+  os << indent << "WatchedLabelValue: " << this->WatchedLabelValue << std::endl;
   os << indent << "ToolTipTransformID: " << (this->GetToolTransformNode() && this->GetToolTransformNode()->GetID() ?
    this->GetToolTransformNode()->GetID() : "(none)" ) << std::endl;
   os << indent << "LineToClosestPointID: " << (this->GetLineToClosestPointNode() && this->GetLineToClosestPointNode()->GetID() ?
    this->GetLineToClosestPointNode()->GetID() : "(none)" ) << std::endl;
   os << indent << "DisplayWarningColor: " << this->DisplayWarningColor << std::endl;
   os << indent << "PlayWarningSound: " << this->PlayWarningSound << std::endl;
+  os << indent << "DistanceFieldEnabled: " << this->DistanceFieldEnabled << std::endl;
+  os << indent << "DistanceFieldVoxelSize: " << this->DistanceFieldVoxelSize << std::endl;
+  os << indent << "DistanceFieldBandWidth: " << this->DistanceFieldBandWidth << std::endl;
+  os << indent << "DistanceColoringEnabled: " << this->DistanceColoringEnabled << std::endl;
+  os << indent << "DistanceColoringRadius: " << this->DistanceColoringRadius << std::endl;
+  os << indent << "ToolTipMovementTolerance: " << this->ToolTipMovementTolerance << std::endl;
+  os << indent << "LineToClosestPointUpdateIntervalSec: " << this->LineToClosestPointUpdateIntervalSec << std::endl;
+  os << indent << "NumberOfToolGeometryPoints: " << this->GetNumberOfToolGeometryPoints() << std::endl;
+  os << indent << "ToolRadius: " << this->ToolRadius << std::endl;
   os << indent << "WarningColor: " << this->WarningColor[0] << ", " << this->WarningColor[1] << ", " << this->WarningColor[2] << std::endl;
   os << indent << "OriginalColor: " << this->OriginalColor[0] << ", " << this->OriginalColor[1] << ", " << this->OriginalColor[2] << std::endl;
 }
@@ -226,6 +376,48 @@ void vtkMRMLBreachWarningNode::SetAndObserveWatchedModelNodeID( const char* mode
   this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
 }
 
+//------------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkMRMLBreachWarningNode::GetWatchedLabelmapVolumeNode()
+{
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetNodeReference( LABELMAP_ROLE ) );
+  return volumeNode;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetAndObserveWatchedLabelmapVolumeNodeID( const char* volumeId )
+{
+  // SetAndObserveNodeReferenceID does not handle nicely setting of the same
+  // node (it should simply ignore the request, but it adds another observer instead)
+  // so check for node equality here.
+  const char* currentNodeId=this->GetNodeReferenceID(LABELMAP_ROLE);
+  if (volumeId!=NULL && currentNodeId!=NULL)
+  {
+    if (strcmp(volumeId,currentNodeId)==0)
+    {
+      // not changed
+      return;
+    }
+  }
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  events->InsertNextValue( vtkMRMLTransformableNode::TransformModifiedEvent );
+  events->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  this->SetAndObserveNodeReferenceID( LABELMAP_ROLE, volumeId, events.GetPointer() );
+  this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetWatchedLabelValue(int _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting WatchedLabelValue to " << _arg);
+  if (this->WatchedLabelValue != _arg)
+  {
+    this->WatchedLabelValue = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
 //------------------------------------------------------------------------------
 vtkMRMLAnnotationRulerNode* vtkMRMLBreachWarningNode::GetLineToClosestPointNode()
 {
@@ -296,6 +488,10 @@ void vtkMRMLBreachWarningNode::ProcessMRMLEvents( vtkObject *caller, unsigned lo
   {
     this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
   }
+  else if (this->GetWatchedLabelmapVolumeNode() && this->GetWatchedLabelmapVolumeNode()==caller)
+  {
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -304,6 +500,92 @@ bool vtkMRMLBreachWarningNode::IsToolTipInsideModel()
   return (this->ClosestDistanceToModelFromToolTip<0);
 }
 
+//------------------------------------------------------------------------------
+int vtkMRMLBreachWarningNode::GetNumberOfToolSegments()
+{
+  return static_cast<int>(this->ToolSegmentClosestDistances.size());
+}
+
+//------------------------------------------------------------------------------
+double vtkMRMLBreachWarningNode::GetToolSegmentClosestDistance(int segmentIndex)
+{
+  if (segmentIndex < 0 || segmentIndex >= this->GetNumberOfToolSegments())
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::GetToolSegmentClosestDistance failed: invalid index "<<segmentIndex);
+    return 0.0;
+  }
+  return this->ToolSegmentClosestDistances[segmentIndex];
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetToolSegmentClosestDistances(const std::vector<double>& distances)
+{
+  if (this->ToolSegmentClosestDistances == distances)
+  {
+    return;
+  }
+  this->ToolSegmentClosestDistances = distances;
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::AddToolGeometryPoint(double x, double y, double z)
+{
+  this->ToolGeometryPoints.push_back(x);
+  this->ToolGeometryPoints.push_back(y);
+  this->ToolGeometryPoints.push_back(z);
+  this->Modified();
+  this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::RemoveAllToolGeometryPoints()
+{
+  if (this->ToolGeometryPoints.empty())
+  {
+    return;
+  }
+  this->ToolGeometryPoints.clear();
+  this->Modified();
+  this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLBreachWarningNode::GetNumberOfToolGeometryPoints()
+{
+  return static_cast<int>(this->ToolGeometryPoints.size() / 3);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::GetToolGeometryPoint(int pointIndex, double point[3])
+{
+  if (pointIndex < 0 || pointIndex >= this->GetNumberOfToolGeometryPoints())
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::GetToolGeometryPoint failed: invalid index "<<pointIndex);
+    return;
+  }
+  point[0] = this->ToolGeometryPoints[pointIndex*3];
+  point[1] = this->ToolGeometryPoints[pointIndex*3+1];
+  point[2] = this->ToolGeometryPoints[pointIndex*3+2];
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetToolRadius(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting ToolRadius to " << _arg);
+  if (_arg < 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetToolRadius failed: radius must not be negative");
+    return;
+  }
+  if (this->ToolRadius != _arg)
+  {
+    this->ToolRadius = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLBreachWarningNode::SetDisplayWarningColor(bool _arg)
 {
@@ -328,6 +610,114 @@ void vtkMRMLBreachWarningNode::SetPlayWarningSound(bool _arg)
   }
 }
 
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetDistanceFieldEnabled(bool _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting DistanceFieldEnabled to " << _arg);
+  if (this->DistanceFieldEnabled != _arg)
+  {
+    this->DistanceFieldEnabled = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetDistanceFieldVoxelSize(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting DistanceFieldVoxelSize to " << _arg);
+  if (_arg <= 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetDistanceFieldVoxelSize failed: voxel size must be positive");
+    return;
+  }
+  if (this->DistanceFieldVoxelSize != _arg)
+  {
+    this->DistanceFieldVoxelSize = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetDistanceFieldBandWidth(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting DistanceFieldBandWidth to " << _arg);
+  if (_arg < 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetDistanceFieldBandWidth failed: band width must not be negative");
+    return;
+  }
+  if (this->DistanceFieldBandWidth != _arg)
+  {
+    this->DistanceFieldBandWidth = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetDistanceColoringEnabled(bool _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting DistanceColoringEnabled to " << _arg);
+  if (this->DistanceColoringEnabled != _arg)
+  {
+    this->DistanceColoringEnabled = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetDistanceColoringRadius(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting DistanceColoringRadius to " << _arg);
+  if (_arg <= 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetDistanceColoringRadius failed: radius must be positive");
+    return;
+  }
+  if (this->DistanceColoringRadius != _arg)
+  {
+    this->DistanceColoringRadius = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetToolTipMovementTolerance(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting ToolTipMovementTolerance to " << _arg);
+  if (_arg < 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetToolTipMovementTolerance failed: tolerance must not be negative");
+    return;
+  }
+  if (this->ToolTipMovementTolerance != _arg)
+  {
+    this->ToolTipMovementTolerance = _arg;
+    this->Modified();
+    this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLBreachWarningNode::SetLineToClosestPointUpdateIntervalSec(double _arg)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting LineToClosestPointUpdateIntervalSec to " << _arg);
+  if (_arg < 0)
+  {
+    vtkErrorMacro("vtkMRMLBreachWarningNode::SetLineToClosestPointUpdateIntervalSec failed: interval must not be negative");
+    return;
+  }
+  if (this->LineToClosestPointUpdateIntervalSec != _arg)
+  {
+    this->LineToClosestPointUpdateIntervalSec = _arg;
+    this->Modified();
+  }
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLBreachWarningNode::SetWarningColor(double _arg1, double _arg2, double _arg3)
 {
@@ -33,6 +33,7 @@
 class vtkMRMLAnnotationRulerNode;
 class vtkMRMLTransformNode;
 class vtkMRMLModelNode;
+class vtkMRMLScalarVolumeNode;
 
 
 class VTK_SLICER_BREACHWARNING_MODULE_MRML_EXPORT vtkMRMLBreachWarningNode: public vtkMRMLNode
@@ -84,6 +85,27 @@ public:
   /// Computed parameter
   bool IsToolTipInsideModel();
 
+  /// Closest distance to the model from each tool segment (see AddToolGeometryPoint). Computed parameter.
+  int GetNumberOfToolSegments();
+  double GetToolSegmentClosestDistance(int segmentIndex);
+  void SetToolSegmentClosestDistances(const std::vector<double>& distances);
+
+  /// Tool geometry is defined as a polyline in the tool coordinate system, starting at the
+  /// tool tip (origin of the tool coordinate system). Each added point defines a new segment.
+  /// If no points are added then only the tool tip is checked.
+  /// If tool geometry is defined, closest distance and closest point on model are computed
+  /// for the tool point that is closest to the model.
+  void AddToolGeometryPoint(double x, double y, double z);
+  void RemoveAllToolGeometryPoints();
+  int GetNumberOfToolGeometryPoints();
+  void GetToolGeometryPoint(int pointIndex, double point[3]);
+
+  /// Radius of the tool. Tool geometry is a capsule around the tool tip and polyline,
+  /// therefore the radius is subtracted from the computed distances.
+  /// 0 by default.
+  vtkGetMacro( ToolRadius, double );
+  virtual void SetToolRadius(double _arg);
+
   /// Indicates if the warning sound is to be played.
   /// False by default.
   /// \sa SetPlayWarningSound(), GetPlayWarningSound(), PlayWarningSoundOn(), PlayWarningSoundOff()
@@ -104,10 +126,74 @@ public:
   virtual void SetOriginalColor(double _arg1, double _arg2, double _arg3);
   virtual void SetOriginalColor(double _arg[3]);
 
+  /// If enabled, a signed distance field is precomputed in a band around the watched model surface and distances
+  /// are interpolated from it. Exact closest point search is only performed very near the model surface
+  /// and outside the band. Recommended for static models that are large.
+  /// False by default.
+  vtkGetMacro( DistanceFieldEnabled, bool );
+  virtual void SetDistanceFieldEnabled(bool _arg);
+  vtkBooleanMacro( DistanceFieldEnabled, bool );
+
+  /// Voxel size of the precomputed distance field (in model coordinate system units, typically mm).
+  /// 1.0 by default.
+  vtkGetMacro( DistanceFieldVoxelSize, double );
+  virtual void SetDistanceFieldVoxelSize(double _arg);
+
+  /// Distance from the model surface (inside and outside) that is covered by the precomputed distance field.
+  /// The field is only computed in this band, so the computation time depends on the surface area and not on the
+  /// volume of the model. 20.0 by default.
+  vtkGetMacro( DistanceFieldBandWidth, double );
+  virtual void SetDistanceFieldBandWidth(double _arg);
+
+  /// If enabled, the watched model is colored by the distance of its vertices from the tool tip.
+  /// The watched model is hidden and a hidden, not saved copy of it is shown instead, which stores the distances
+  /// in its DistanceToToolTip point scalar array, clamped to DistanceColoringRadius. The watched model is not modified.
+  /// Only the vertices within DistanceColoringRadius from the previous or current tool tip position are
+  /// updated, so the update time depends on the radius and not on the size of the model.
+  /// Only one breach warning node should color the same model.
+  /// False by default.
+  vtkGetMacro( DistanceColoringEnabled, bool );
+  virtual void SetDistanceColoringEnabled(bool _arg);
+  vtkBooleanMacro( DistanceColoringEnabled, bool );
+
+  /// Vertices farther from the tool tip than this distance have the same color.
+  /// 20.0 by default.
+  vtkGetMacro( DistanceColoringRadius, double );
+  virtual void SetDistanceColoringRadius(double _arg);
+
+  /// If the distance from the previous closest point is guaranteed to differ from the true distance
+  /// by at most this value (the error is bounded by the tool tip movement since the last closest point search)
+  /// and the movement cannot change the inside/outside state then the previous closest point
+  /// is reused and only the distance is updated. Otherwise the closest point is searched.
+  /// Reduces computation time for slowly moving tools, at the cost of the closest point position being less accurate.
+  /// 0 by default (closest point is searched at every update).
+  vtkGetMacro( ToolTipMovementTolerance, double );
+  virtual void SetToolTipMovementTolerance(double _arg);
+
+  /// Minimum time between updates of the line to closest point (in seconds).
+  /// Updates that would come sooner are postponed until the interval has elapsed (then the latest
+  /// positions are shown), unless the inside/outside state changes, which is shown immediately.
+  /// Reduces rendering load when the tool is tracked at high frame rate.
+  /// 0 by default (the line is updated at every tool state update).
+  vtkGetMacro( LineToClosestPointUpdateIntervalSec, double );
+  virtual void SetLineToClosestPointUpdateIntervalSec(double _arg);
+
   /// Watched model defines the area that may breached.
   vtkMRMLModelNode* GetWatchedModelNode();
   void SetAndObserveWatchedModelNodeID( const char* modelId );
 
+  /// Watched labelmap volume defines the area that may be breached, as an alternative to the watched model
+  /// (e.g., a segmentation exported to a labelmap). It is only used if no watched model is set.
+  /// A signed Euclidean distance map is computed once for the volume (and recomputed only if the volume changes),
+  /// then each tool update is an interpolated lookup in the map.
+  vtkMRMLScalarVolumeNode* GetWatchedLabelmapVolumeNode();
+  void SetAndObserveWatchedLabelmapVolumeNodeID( const char* volumeId );
+
+  /// Label of the watched area in the labelmap volume. If 0 then all non-zero voxels are watched.
+  /// 0 by default.
+  vtkGetMacro( WatchedLabelValue, int );
+  virtual void SetWatchedLabelValue(int _arg);
+
   // Tool transform is interpreted as ToolTipToRas. The origin of ToolTip 
   // coordinate system is the tip of the surgical tool that needs to avoid the
   // risk area.
@@ -127,6 +213,18 @@ private:
   double OriginalColor[3];
   bool DisplayWarningColor;
   bool PlayWarningSound;
+  bool DistanceFieldEnabled;
+  double DistanceFieldVoxelSize;
+  double DistanceFieldBandWidth;
+  bool DistanceColoringEnabled;
+  double DistanceColoringRadius;
+  int WatchedLabelValue;
+  double ToolTipMovementTolerance;
+  double LineToClosestPointUpdateIntervalSec;
+  // Tool polyline points in the tool coordinate system (x1, y1, z1, x2, y2, z2, ...)
+  std::vector<double> ToolGeometryPoints;
+  double ToolRadius;
+  std::vector<double> ToolSegmentClosestDistances;
   // It is the closest distance to the model from the tool transform. If the distance is negative
   // the transform is inside the model.
   double ClosestDistanceToModelFromToolTip;
@@ -0,0 +1,303 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Measures the latency of breach warning updates (triggered by tool transform changes)
+// for synthetic watched models of various size, with and without parent transform, and with
+// various number of breach warning nodes.
+//
+// Results are written as one JSON object per line (to the standard output or to the file
+// specified by the -o option), so that they can be collected and compared between builds.
+//
+// Usage: vtkSlicerBreachWarningLogicBenchmark [--quick] [-o outputFile] [-n numberOfSamples]
+//   --quick: run only a few small configurations (used when running as an automatic test)
+
+// BreachWarning includes
+#include "vtkMRMLBreachWarningNode.h"
+#include "vtkSlicerBreachWarningLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLModelDisplayNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double WATCHED_MODEL_RADIUS = 50.0;
+
+//----------------------------------------------------------------------------
+struct BenchmarkResult
+{
+  int NumberOfTriangles;
+  bool ParentTransform;
+  int NumberOfNodes;
+  int NumberOfSamples;
+  double LatencyP50Ms;
+  double LatencyP99Ms;
+  double LatencyMeanMs;
+  double UpdatesPerSec;
+};
+
+//----------------------------------------------------------------------------
+double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+{
+  if (sortedValues.empty())
+  {
+    return 0.0;
+  }
+  int index = static_cast<int>(std::ceil(percentile / 100.0 * sortedValues.size())) - 1;
+  index = std::max(0, std::min(static_cast<int>(sortedValues.size()) - 1, index));
+  return sortedValues[index];
+}
+
+//----------------------------------------------------------------------------
+/// Create a sphere model that has approximately the requested number of triangles
+vtkMRMLModelNode* AddSphereModel(vtkMRMLScene* scene, int requestedNumberOfTriangles, int& actualNumberOfTriangles)
+{
+  // A sphere with resolution R in both directions has 2*R*(R-1) triangles
+  int resolution = std::max(3, static_cast<int>(std::ceil(0.5 + std::sqrt(0.25 + requestedNumberOfTriangles / 2.0))));
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetRadius(WATCHED_MODEL_RADIUS);
+  sphere->SetThetaResolution(resolution);
+  sphere->SetPhiResolution(resolution);
+  sphere->Update();
+  actualNumberOfTriangles = sphere->GetOutput()->GetNumberOfPolys();
+
+  vtkNew<vtkMRMLModelDisplayNode> displayNode;
+  scene->AddNode(displayNode.GetPointer());
+  vtkNew<vtkMRMLModelNode> modelNode;
+  modelNode->SetName("WatchedModel");
+  modelNode->SetAndObservePolyData(sphere->GetOutput());
+  scene->AddNode(modelNode.GetPointer());
+  modelNode->SetAndObserveDisplayNodeID(displayNode->GetID());
+  return modelNode.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+bool RunBenchmark(int requestedNumberOfTriangles, bool parentTransform, int numberOfNodes, int numberOfSamples, BenchmarkResult& result)
+{
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerBreachWarningLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  int actualNumberOfTriangles = 0;
+  vtkMRMLModelNode* modelNode = AddSphereModel(scene.GetPointer(), requestedNumberOfTriangles, actualNumberOfTriangles);
+
+  if (parentTransform)
+  {
+    vtkNew<vtkMatrix4x4> modelToRas;
+    modelToRas->SetElement(0, 3, 20.0);
+    modelToRas->SetElement(1, 3, -10.0);
+    modelToRas->SetElement(2, 3, 5.0);
+    vtkNew<vtkMRMLLinearTransformNode> modelTransformNode;
+    modelTransformNode->SetName("ModelToRas");
+    modelTransformNode->SetMatrixTransformToParent(modelToRas.GetPointer());
+    scene->AddNode(modelTransformNode.GetPointer());
+    modelNode->SetAndObserveTransformNodeID(modelTransformNode->GetID());
+  }
+
+  std::vector< vtkSmartPointer<vtkMRMLLinearTransformNode> > toolTransformNodes;
+  for (int nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+  {
+    vtkSmartPointer<vtkMRMLLinearTransformNode> toolTransformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+    toolTransformNode->SetName("ToolToRas");
+    scene->AddNode(toolTransformNode);
+    toolTransformNodes.push_back(toolTransformNode);
+
+    vtkNew<vtkMRMLBreachWarningNode> bwNode;
+    scene->AddNode(bwNode.GetPointer());
+    bwNode->SetPlayWarningSound(false);
+    bwNode->SetAndObserveWatchedModelNodeID(modelNode->GetID());
+    bwNode->SetAndObserveToolTransformNodeId(toolTransformNode->GetID());
+  }
+
+  // Tool positions are generated in advance, so that only the update is measured
+  vtkMath::RandomSeed(42);
+  std::vector< vtkSmartPointer<vtkMatrix4x4> > toolToRasMatrices;
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++)
+  {
+    vtkSmartPointer<vtkMatrix4x4> toolToRas = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int axis = 0; axis < 3; axis++)
+    {
+      toolToRas->SetElement(axis, 3, vtkMath::Random(-1.5 * WATCHED_MODEL_RADIUS, 1.5 * WATCHED_MODEL_RADIUS));
+    }
+    toolToRasMatrices.push_back(toolToRas);
+  }
+
+  // Warm up: build locators and create all cache entries
+  logic->UpdateAllToolStates();
+
+  std::vector<double> latenciesMs;
+  latenciesMs.reserve(numberOfSamples);
+  vtkNew<vtkTimerLog> sampleTimer;
+  vtkNew<vtkTimerLog> totalTimer;
+  totalTimer->StartTimer();
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++)
+  {
+    vtkMRMLLinearTransformNode* toolTransformNode = toolTransformNodes[sampleIndex % numberOfNodes];
+    sampleTimer->StartTimer();
+    // Modifying the transform marks the breach warning nodes as pending, they are updated in the next tick
+    toolTransformNode->SetMatrixTransformToParent(toolToRasMatrices[sampleIndex]);
+    logic->ProcessPendingUpdates();
+    sampleTimer->StopTimer();
+    latenciesMs.push_back(sampleTimer->GetElapsedTime() * 1000.0);
+  }
+  totalTimer->StopTimer();
+
+  std::sort(latenciesMs.begin(), latenciesMs.end());
+  double latencySumMs = 0.0;
+  for (std::vector<double>::iterator latencyIt = latenciesMs.begin(); latencyIt != latenciesMs.end(); ++latencyIt)
+  {
+    latencySumMs += (*latencyIt);
+  }
+
+  result.NumberOfTriangles = actualNumberOfTriangles;
+  result.ParentTransform = parentTransform;
+  result.NumberOfNodes = numberOfNodes;
+  result.NumberOfSamples = numberOfSamples;
+  result.LatencyP50Ms = GetPercentile(latenciesMs, 50.0);
+  result.LatencyP99Ms = GetPercentile(latenciesMs, 99.0);
+  result.LatencyMeanMs = (numberOfSamples > 0 ? latencySumMs / numberOfSamples : 0.0);
+  double totalTimeSec = totalTimer->GetElapsedTime();
+  result.UpdatesPerSec = (totalTimeSec > 0 ? numberOfSamples / totalTimeSec : 0.0);
+
+  return (logic->GetNumberOfDistanceQueries() > 0);
+}
+
+//----------------------------------------------------------------------------
+void WriteResult(std::ostream& os, const BenchmarkResult& result)
+{
+  os << "{\"benchmark\": \"BreachWarningUpdateLatency\""
+    << ", \"triangles\": " << result.NumberOfTriangles
+    << ", \"parentTransform\": " << (result.ParentTransform ? "true" : "false")
+    << ", \"nodes\": " << result.NumberOfNodes
+    << ", \"samples\": " << result.NumberOfSamples
+    << ", \"latencyP50Ms\": " << result.LatencyP50Ms
+    << ", \"latencyP99Ms\": " << result.LatencyP99Ms
+    << ", \"latencyMeanMs\": " << result.LatencyMeanMs
+    << ", \"updatesPerSec\": " << result.UpdatesPerSec
+    << "}" << std::endl;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerBreachWarningLogicBenchmark(int argc, char* argv[])
+{
+  bool quick = false;
+  const char* outputFileName = NULL;
+  int numberOfSamples = 1000;
+  for (int argIndex = 1; argIndex < argc; argIndex++)
+  {
+    if (strcmp(argv[argIndex], "--quick") == 0)
+    {
+      quick = true;
+    }
+    else if (strcmp(argv[argIndex], "-o") == 0 && argIndex + 1 < argc)
+    {
+      outputFileName = argv[++argIndex];
+    }
+    else if (strcmp(argv[argIndex], "-n") == 0 && argIndex + 1 < argc)
+    {
+      numberOfSamples = atoi(argv[++argIndex]);
+    }
+    else
+    {
+      std::cerr << "Unknown argument: " << argv[argIndex] << std::endl;
+      std::cerr << "Usage: " << argv[0] << " [--quick] [-o outputFile] [-n numberOfSamples]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (numberOfSamples < 1)
+  {
+    std::cerr << "Number of samples must be positive" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<int> numberOfTrianglesList;
+  std::vector<int> numberOfNodesList;
+  if (quick)
+  {
+    numberOfSamples = std::min(numberOfSamples, 100);
+    numberOfTrianglesList.push_back(1000);
+    numberOfTrianglesList.push_back(10000);
+    numberOfNodesList.push_back(1);
+    numberOfNodesList.push_back(4);
+  }
+  else
+  {
+    numberOfTrianglesList.push_back(1000);
+    numberOfTrianglesList.push_back(10000);
+    numberOfTrianglesList.push_back(100000);
+    numberOfTrianglesList.push_back(1000000);
+    for (int numberOfNodes = 1; numberOfNodes <= 64; numberOfNodes *= 4)
+    {
+      numberOfNodesList.push_back(numberOfNodes);
+    }
+  }
+
+  std::ofstream outputFile;
+  if (outputFileName != NULL)
+  {
+    outputFile.open(outputFileName);
+    if (!outputFile.is_open())
+    {
+      std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream& os = (outputFileName != NULL ? static_cast<std::ostream&>(outputFile) : std::cout);
+
+  for (std::vector<int>::iterator trianglesIt = numberOfTrianglesList.begin(); trianglesIt != numberOfTrianglesList.end(); ++trianglesIt)
+  {
+    for (int parentTransform = 0; parentTransform < 2; parentTransform++)
+    {
+      for (std::vector<int>::iterator nodesIt = numberOfNodesList.begin(); nodesIt != numberOfNodesList.end(); ++nodesIt)
+      {
+        BenchmarkResult result;
+        if (!RunBenchmark(*trianglesIt, parentTransform != 0, *nodesIt, numberOfSamples, result))
+        {
+          std::cerr << "Benchmark failed: no distance computation was performed (triangles: " << (*trianglesIt)
+            << ", parent transform: " << parentTransform << ", nodes: " << (*nodesIt) << ")" << std::endl;
+          return EXIT_FAILURE;
+        }
+        WriteResult(os, result);
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
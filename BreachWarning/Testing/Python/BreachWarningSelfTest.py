@@ -144,20 +144,26 @@ class BreachWarningSelfTestTest(ScriptedLoadableModuleTest):
     transformMatrixInside.SetElement(1, 3, transformMatrixInside.GetElement(1,3) + sphereRadius*0.3)
     transformMatrixInside.SetElement(2, 3, transformMatrixInside.GetElement(2,3) + sphereRadius*0.2)
 
-    # Start breach warning checks
+    # Start breach warning checks.
+    # Node updates are processed in the next tracking tick, they are processed here immediately
+    # to check the results without waiting for the timer.
+    bwLogic = slicer.modules.breachwarning.logic()
 
     self.delayDisplay('Tool is outside the sphere')
     toolToWorldTransform.SetMatrixTransformToParent(transformMatrixOutside)
+    bwLogic.ProcessPendingUpdates()
     sphereColor = sphereModel.GetDisplayNode().GetColor()
     self.assertNotEqual(sphereColor, warningColor)
 
     self.delayDisplay('Tool is inside the sphere')
     toolToWorldTransform.SetMatrixTransformToParent(transformMatrixInside)
+    bwLogic.ProcessPendingUpdates()
     sphereColor = sphereModel.GetDisplayNode().GetColor()
     self.assertEqual(sphereColor, warningColor)
 
     self.delayDisplay('Tool is outside the sphere')
     toolToWorldTransform.SetMatrixTransformToParent(transformMatrixOutside)
+    bwLogic.ProcessPendingUpdates()
     sphereColor = sphereModel.GetDisplayNode().GetColor()
     self.assertNotEqual(sphereColor, warningColor)
 
@@ -27,6 +27,7 @@
 
 // BreachWarning Logic includes
 #include <vtkSlicerBreachWarningLogic.h>
+#include <vtkSlicerTrackingTickLogic.h>
 
 // BreachWarning includes
 #include "qSlicerBreachWarningModule.h"
@@ -47,6 +48,7 @@ public:
 
   vtkSlicerBreachWarningLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
   QTimer UpdateWarningSoundTimer;
+  QTimer ProcessAsynchronousResultsTimer;
   QPointer<QSound> WarningSound;
   double WarningSoundPeriodSec;
 };
@@ -93,7 +95,10 @@ qSlicerBreachWarningModule::~qSlicerBreachWarningModule()
     d->WarningSound->stop();
   }
   disconnect(&d->UpdateWarningSoundTimer, SIGNAL(timeout()), this, SLOT(updateWarningSound()));
+  disconnect(&d->ProcessAsynchronousResultsTimer, SIGNAL(timeout()), this, SLOT(processAsynchronousResults()));
   this->qvtkReconnect(d->ObservedLogic, NULL, vtkCommand::ModifiedEvent, this, SLOT(updateWarningSound()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkCommand::ModifiedEvent, this, SLOT(updateAsynchronousResultsProcessing()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkSlicerBreachWarningLogic::PendingUpdatesModifiedEvent, this, SLOT(updateAsynchronousResultsProcessing()));
   d->ObservedLogic = NULL;
 }
 
@@ -145,10 +150,16 @@ void qSlicerBreachWarningModule::setup()
   }
 
   this->qvtkReconnect(d->ObservedLogic, moduleLogic, vtkCommand::ModifiedEvent, this, SLOT(updateWarningSound()));
+  this->qvtkReconnect(d->ObservedLogic, moduleLogic, vtkCommand::ModifiedEvent, this, SLOT(updateAsynchronousResultsProcessing()));
+  this->qvtkReconnect(d->ObservedLogic, moduleLogic, vtkSlicerBreachWarningLogic::PendingUpdatesModifiedEvent, this, SLOT(updateAsynchronousResultsProcessing()));
   d->ObservedLogic = moduleLogic;
 
   d->UpdateWarningSoundTimer.setSingleShot(true);
   connect(&d->UpdateWarningSoundTimer, SIGNAL(timeout()), this, SLOT(updateWarningSound()));
+
+  // Results of asynchronous computation and postponed line updates are applied to the MRML nodes on the main thread
+  d->ProcessAsynchronousResultsTimer.setInterval(10);
+  connect(&d->ProcessAsynchronousResultsTimer, SIGNAL(timeout()), this, SLOT(processAsynchronousResults()));
 }
 
 //-----------------------------------------------------------------------------
@@ -191,6 +202,33 @@ void qSlicerBreachWarningModule::updateWarningSound()
 }
 
 
+//------------------------------------------------------------------------------
+void qSlicerBreachWarningModule::updateAsynchronousResultsProcessing()
+{
+  Q_D(qSlicerBreachWarningModule);
+  bool processingNeeded = (d->ObservedLogic!=NULL && (d->ObservedLogic->GetAsynchronousUpdate() || d->ObservedLogic->HasPendingUpdates()));
+  if (processingNeeded && !d->ProcessAsynchronousResultsTimer.isActive())
+  {
+    d->ProcessAsynchronousResultsTimer.start();
+  }
+  else if (!processingNeeded && d->ProcessAsynchronousResultsTimer.isActive())
+  {
+    d->ProcessAsynchronousResultsTimer.stop();
+  }
+}
+
+//------------------------------------------------------------------------------
+void qSlicerBreachWarningModule::processAsynchronousResults()
+{
+  Q_D(qSlicerBreachWarningModule);
+  if (d->ObservedLogic==NULL)
+  {
+    return;
+  }
+  // Results are applied in the same tick as the pending updates of the other tracking logics
+  vtkSlicerTrackingTickLogic::GetInstance()->ProcessTick();
+}
+
 //------------------------------------------------------------------------------
 void qSlicerBreachWarningModule::stopSound()
 {
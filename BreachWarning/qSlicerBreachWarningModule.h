@@ -80,6 +80,8 @@ public slots:
 */
   void updateWarningSound();
   void stopSound();
+  void updateAsynchronousResultsProcessing();
+  void processAsynchronousResults();
 
 protected:
 
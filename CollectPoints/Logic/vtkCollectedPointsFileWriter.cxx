@@ -0,0 +1,195 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkCollectedPointsFileWriter.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstring>
+
+// Size of a vertex record: 3 floats, a double and an int
+static const int RECORD_SIZE_BYTES = 3 * 4 + 8 + 4;
+// Number of digits of the vertex count in the header. The count is written with
+// leading zeros, so that it can be overwritten in place as points are added.
+static const int VERTEX_COUNT_DIGITS = 10;
+
+vtkStandardNewMacro( vtkCollectedPointsFileWriter );
+
+//------------------------------------------------------------------------------
+vtkCollectedPointsFileWriter::vtkCollectedPointsFileWriter()
+: File( NULL )
+, SourcesFile( NULL )
+, VertexCountPosition( 0 )
+, NumberOfPoints( 0 )
+, NumberOfWrittenPoints( 0 )
+, FlushIntervalSec( 1.0 )
+, LastFlushTimeSec( 0.0 )
+{
+}
+
+//------------------------------------------------------------------------------
+vtkCollectedPointsFileWriter::~vtkCollectedPointsFileWriter()
+{
+  this->Close();
+}
+
+//------------------------------------------------------------------------------
+void vtkCollectedPointsFileWriter::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "FlushIntervalSec: " << this->FlushIntervalSec << std::endl;
+  os << indent << "NumberOfPoints: " << this->NumberOfPoints << std::endl;
+  os << indent << "NumberOfWrittenPoints: " << this->NumberOfWrittenPoints << std::endl;
+}
+
+//------------------------------------------------------------------------------
+bool vtkCollectedPointsFileWriter::Open( const char* fileName )
+{
+  this->Close();
+  if ( fileName == NULL || strlen( fileName ) == 0 )
+  {
+    vtkErrorMacro( "Open: Invalid file name" );
+    return false;
+  }
+  this->File = fopen( fileName, "wb" );
+  if ( this->File == NULL )
+  {
+    vtkErrorMacro( "Open: Could not create file " << fileName );
+    return false;
+  }
+  std::string sourcesFileName = std::string( fileName ) + ".sources.txt";
+  this->SourcesFile = fopen( sourcesFileName.c_str(), "w" );
+  if ( this->SourcesFile == NULL )
+  {
+    vtkErrorMacro( "Open: Could not create file " << sourcesFileName );
+    fclose( this->File );
+    this->File = NULL;
+    return false;
+  }
+  this->FileName = fileName;
+  this->NumberOfPoints = 0;
+  this->NumberOfWrittenPoints = 0;
+  this->PendingRecords.clear();
+  this->SourceIndices.clear();
+
+  fprintf( this->File, "ply\nformat binary_little_endian 1.0\n" );
+  fprintf( this->File, "comment collected points, source transform IDs are listed in %s\n", sourcesFileName.c_str() );
+  fprintf( this->File, "element vertex " );
+  this->VertexCountPosition = ftell( this->File );
+  fprintf( this->File, "%0*d\n", VERTEX_COUNT_DIGITS, 0 );
+  fprintf( this->File, "property float x\nproperty float y\nproperty float z\n" );
+  fprintf( this->File, "property double timestamp\nproperty int source\nend_header\n" );
+  fflush( this->File );
+  this->LastFlushTimeSec = vtkTimerLog::GetUniversalTime();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkCollectedPointsFileWriter::Close()
+{
+  if ( this->File == NULL )
+  {
+    return;
+  }
+  this->Flush();
+  fclose( this->File );
+  this->File = NULL;
+  fclose( this->SourcesFile );
+  this->SourcesFile = NULL;
+  this->PendingRecords.clear();
+}
+
+//------------------------------------------------------------------------------
+void vtkCollectedPointsFileWriter::AddPoint( const double coordinates[ 3 ], double timeSec, const char* sourceTransformID )
+{
+  if ( this->File == NULL )
+  {
+    vtkErrorMacro( "AddPoint: File is not open" );
+    return;
+  }
+  char record[ RECORD_SIZE_BYTES ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    float coordinate = static_cast< float >( coordinates[ i ] );
+    vtkByteSwap::Swap4LE( &coordinate );
+    memcpy( record + 4 * i, &coordinate, 4 );
+  }
+  vtkByteSwap::Swap8LE( &timeSec );
+  memcpy( record + 12, &timeSec, 8 );
+  int sourceIndex = this->GetSourceIndex( sourceTransformID );
+  vtkByteSwap::Swap4LE( &sourceIndex );
+  memcpy( record + 20, &sourceIndex, 4 );
+  this->PendingRecords.insert( this->PendingRecords.end(), record, record + RECORD_SIZE_BYTES );
+  this->NumberOfPoints++;
+  this->FlushIfDue();
+}
+
+//------------------------------------------------------------------------------
+void vtkCollectedPointsFileWriter::FlushIfDue()
+{
+  if ( this->PendingRecords.empty() )
+  {
+    return;
+  }
+  if ( vtkTimerLog::GetUniversalTime() - this->LastFlushTimeSec < this->FlushIntervalSec )
+  {
+    return;
+  }
+  this->Flush();
+}
+
+//------------------------------------------------------------------------------
+void vtkCollectedPointsFileWriter::Flush()
+{
+  this->LastFlushTimeSec = vtkTimerLog::GetUniversalTime();
+  if ( this->File == NULL || this->PendingRecords.empty() )
+  {
+    return;
+  }
+  // records first, then the count, so that the header never refers to points that are not in the file
+  fseek( this->File, 0, SEEK_END );
+  fwrite( &( this->PendingRecords[ 0 ] ), 1, this->PendingRecords.size(), this->File );
+  this->PendingRecords.clear();
+  fflush( this->File );
+  this->NumberOfWrittenPoints = this->NumberOfPoints;
+  fseek( this->File, this->VertexCountPosition, SEEK_SET );
+  fprintf( this->File, "%0*d", VERTEX_COUNT_DIGITS, this->NumberOfWrittenPoints );
+  fflush( this->File );
+}
+
+//------------------------------------------------------------------------------
+int vtkCollectedPointsFileWriter::GetSourceIndex( const char* sourceTransformID )
+{
+  if ( sourceTransformID == NULL )
+  {
+    return -1;
+  }
+  std::map< std::string, int >::iterator sourceIt = this->SourceIndices.find( sourceTransformID );
+  if ( sourceIt != this->SourceIndices.end() )
+  {
+    return sourceIt->second;
+  }
+  int sourceIndex = static_cast< int >( this->SourceIndices.size() );
+  this->SourceIndices[ sourceTransformID ] = sourceIndex;
+  fprintf( this->SourcesFile, "%d %s\n", sourceIndex, sourceTransformID );
+  fflush( this->SourcesFile );
+  return sourceIndex;
+}
@@ -0,0 +1,98 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkCollectedPointsFileWriter - appends collected points to a binary PLY file
+// .SECTION Description
+// Writes points to a binary little endian PLY file while they are being collected,
+// so that a long collection session never has to be held in memory to be saved.
+// Each vertex has float x, y, z coordinates, a double timestamp (universal time in seconds)
+// and an int source index. The source is the ID of the transform node that the point
+// was sampled by, the IDs of the source indices are listed in a text file next to the
+// PLY file (file name + ".sources.txt"), one "index ID" line for each source.
+// Points are buffered and written in blocks, at least once per FlushIntervalSec.
+// The vertex count in the header is updated by each write, so the file is always a
+// valid PLY file that contains all points up to the last write, even if the
+// application is terminated unexpectedly.
+
+#ifndef __vtkCollectedPointsFileWriter_h
+#define __vtkCollectedPointsFileWriter_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// CollectPoints includes
+#include "vtkSlicerCollectPointsModuleLogicExport.h"
+
+class VTK_SLICER_COLLECTPOINTS_MODULE_LOGIC_EXPORT vtkCollectedPointsFileWriter : public vtkObject
+{
+public:
+  static vtkCollectedPointsFileWriter* New();
+  vtkTypeMacro( vtkCollectedPointsFileWriter, vtkObject );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  // Create the file (an existing file is overwritten) and write the header.
+  // Returns false if the file cannot be created.
+  bool Open( const char* fileName );
+  // Write the buffered points and close the file
+  void Close();
+  bool IsOpen() { return this->File != NULL; };
+  const char* GetFileName() { return this->FileName.c_str(); };
+
+  // Append a point. sourceTransformID may be NULL if the source is unknown (source index is -1).
+  void AddPoint( const double coordinates[ 3 ], double timeSec, const char* sourceTransformID );
+  // Write the buffered points if FlushIntervalSec has elapsed since the last write
+  void FlushIfDue();
+  // Write the buffered points and update the header now
+  void Flush();
+
+  // Maximum time that points are buffered before they are written (default 1 second)
+  vtkSetMacro( FlushIntervalSec, double );
+  vtkGetMacro( FlushIntervalSec, double );
+
+  // Number of points written or buffered since the file was opened
+  vtkGetMacro( NumberOfPoints, int );
+
+protected:
+  vtkCollectedPointsFileWriter();
+  ~vtkCollectedPointsFileWriter();
+
+private:
+  int GetSourceIndex( const char* sourceTransformID );
+
+  std::string FileName;
+  FILE* File;
+  FILE* SourcesFile;
+  long VertexCountPosition; // file position of the vertex count in the header
+  int NumberOfPoints;
+  int NumberOfWrittenPoints;
+  double FlushIntervalSec;
+  double LastFlushTimeSec;
+
+  // Records of the points that are not written yet, in file format
+  std::vector< char > PendingRecords;
+  std::map< std::string, int > SourceIndices;
+
+  vtkCollectedPointsFileWriter( const vtkCollectedPointsFileWriter& ); // Not implemented
+  void operator=( const vtkCollectedPointsFileWriter& ); // Not implemented
+};
+
+#endif
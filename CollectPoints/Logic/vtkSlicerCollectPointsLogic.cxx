@@ -16,7 +16,14 @@
 ==============================================================================*/
 
 // CollectPoints includes
+#include "vtkCollectedPointsFileWriter.h"
 #include "vtkSlicerCollectPointsLogic.h"
+#include "vtkStreamingSurfaceReconstruction.h"
+
+// IGTCommon includes
+#include "vtkPerformanceCounters.h"
+#include "vtkSlicerTrackingTickLogic.h"
+#include "vtkTransformToWorldCache.h"
 
 // MRML includes
 #include "vtkMRMLTransformNode.h"
@@ -24,28 +31,44 @@
 #include "vtkMRMLScene.h"
 
 // VTK includes
+#include <vtkCellArray.h>
 #include <vtkGeneralTransform.h>
+#include <vtkIdTypeArray.h>
 #include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPolyData.h>
 #include <vtkPoints.h>
+#include <vtkTimerLog.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <sstream>
 
+// Initial number of buckets in the spatial hash of collected points.
+// The number of buckets is doubled when there are more than two points per bucket on average.
+static const int COLLECTED_POINTS_GRID_INITIAL_NUMBER_OF_BUCKETS = 1024;
+
 
 vtkStandardNewMacro(vtkSlicerCollectPointsLogic);
 
 //------------------------------------------------------------------------------
 vtkSlicerCollectPointsLogic::vtkSlicerCollectPointsLogic()
 {
+  this->SamplingToAnchorMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PerformanceCounters = vtkSmartPointer< vtkPerformanceCounters >::New();
+  this->PerformanceCounters->SetName( "CollectPoints" );
+  vtkSlicerTrackingTickLogic::GetInstance()->AddObserver( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand(), vtkSlicerTrackingTickLogic::GetConsumerStagePriority() );
 }
 
 //------------------------------------------------------------------------------
 vtkSlicerCollectPointsLogic::~vtkSlicerCollectPointsLogic()
 {
+  vtkSlicerTrackingTickLogic::GetInstance()->RemoveObservers( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand() );
 }
 
 //------------------------------------------------------------------------------
@@ -64,13 +87,14 @@ void vtkSlicerCollectPointsLogic::AddPoint( vtkMRMLCollectPointsNode* collectPoi
     return;
   }
 
-  vtkMRMLNode* outputNode = collectPointsNode->GetOutputNode();
-  if ( outputNode == NULL )
+  if ( this->GetResolvedNodes( collectPointsNode ).OutputType == OutputNone )
   {
     vtkErrorMacro( "No output node set. Will not add any points." );
     return;
   }
 
+  double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+
   // find the point coordinates
   double pointCoordinates[ 3 ] = { 0.0, 0.0, 0.0 }; // temporary values
   bool success = this->ComputePointCoordinates( collectPointsNode, pointCoordinates );
@@ -80,17 +104,22 @@ void vtkSlicerCollectPointsLogic::AddPoint( vtkMRMLCollectPointsNode* collectPoi
     return;
   }
 
-  // try downcasting the output node to different types.
-  // If successfully downcasts, then call the relevant function to add the point.
-  // If it does not downcast, output an error.
-  vtkMRMLMarkupsFiducialNode* outputMarkupsNode = vtkMRMLMarkupsFiducialNode::SafeDownCast( outputNode );
-  vtkMRMLModelNode* outputModelNode = vtkMRMLModelNode::SafeDownCast( outputNode );
-  if ( outputMarkupsNode != NULL )
+  this->AddPointCoordinatesToOutput( collectPointsNode, pointCoordinates );
+  this->UpdateSurfaceModel( collectPointsNode );
+  this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::AddPointCoordinatesToOutput( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] )
+{
+  // the type of the output node is determined when the node references are resolved
+  OutputNodeType outputType = this->GetResolvedNodes( collectPointsNode ).OutputType;
+  if ( outputType == OutputMarkups )
   {
-    this->AddPointToMarkups( collectPointsNode, pointCoordinates );
+    this->AddPointsToMarkups( collectPointsNode, pointCoordinates, 1 );
 
   }
-  else if ( outputModelNode != NULL )
+  else if ( outputType == OutputModel )
   {
     this->AddPointToModel( collectPointsNode, pointCoordinates );
   }
@@ -111,18 +140,78 @@ bool vtkSlicerCollectPointsLogic::ComputePointCoordinates( vtkMRMLCollectPointsN
   }
 
   // find the point coordinates
-  vtkSmartPointer< vtkMRMLTransformNode > samplingNode = vtkMRMLTransformNode::SafeDownCast( collectPointsNode->GetSamplingTransformNode() );
-  vtkSmartPointer< vtkMRMLTransformNode > anchorNode = vtkMRMLTransformNode::SafeDownCast( collectPointsNode->GetAnchorTransformNode() );
-  vtkSmartPointer < vtkGeneralTransform > samplingToAnchorTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( samplingNode, anchorNode, samplingToAnchorTransform ); // parameters are: source, target, transform
+  ResolvedNodes& resolvedNodes = this->GetResolvedNodes( collectPointsNode );
+  vtkMRMLTransformNode* samplingNode = resolvedNodes.SamplingNode;
+  vtkMRMLTransformNode* anchorNode = resolvedNodes.AnchorNode;
+  if ( vtkTransformToWorldCache::GetInstance()->GetMatrixTransformBetweenNodes( samplingNode, anchorNode, this->SamplingToAnchorMatrix ) )
+  {
+    // the origin of the sampling coordinate system is the translation of the linear transform
+    for ( int i = 0; i < 3; i++ )
+    {
+      outputPointCoordinates[ i ] = this->SamplingToAnchorMatrix->GetElement( i, 3 );
+    }
+    return true;
+  }
+  if ( resolvedNodes.SamplingToAnchorTransform == NULL )
+  {
+    resolvedNodes.SamplingToAnchorTransform = vtkSmartPointer< vtkGeneralTransform >::New();
+  }
+  vtkMRMLTransformNode::GetTransformBetweenNodes( samplingNode, anchorNode, resolvedNodes.SamplingToAnchorTransform ); // parameters are: source, target, transform
   double samplingPoint[ 3 ] = { 0, 0, 0 }; // origin of coordinate system
-  samplingToAnchorTransform->TransformPoint( samplingPoint, outputPointCoordinates );
+  resolvedNodes.SamplingToAnchorTransform->TransformPoint( samplingPoint, outputPointCoordinates );
   return true;
 }
 
+//------------------------------------------------------------------------------
+vtkSlicerCollectPointsLogic::ResolvedNodes& vtkSlicerCollectPointsLogic::GetResolvedNodes( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  std::map< vtkMRMLCollectPointsNode*, ResolvedNodes >::iterator resolvedNodesIt = this->ResolvedNodesCache.find( collectPointsNode );
+  if ( resolvedNodesIt != this->ResolvedNodesCache.end() )
+  {
+    return resolvedNodesIt->second;
+  }
+
+  ResolvedNodes& resolvedNodes = this->ResolvedNodesCache[ collectPointsNode ];
+  resolvedNodes.SamplingNode = collectPointsNode->GetSamplingTransformNode();
+  resolvedNodes.AnchorNode = collectPointsNode->GetAnchorTransformNode();
+  vtkMRMLNode* outputNode = collectPointsNode->GetOutputNode();
+  resolvedNodes.OutputNode = outputNode;
+  if ( outputNode == NULL )
+  {
+    resolvedNodes.OutputType = OutputNone;
+  }
+  else if ( vtkMRMLMarkupsFiducialNode::SafeDownCast( outputNode ) != NULL )
+  {
+    resolvedNodes.OutputType = OutputMarkups;
+  }
+  else if ( vtkMRMLModelNode::SafeDownCast( outputNode ) != NULL )
+  {
+    resolvedNodes.OutputType = OutputModel;
+  }
+  else
+  {
+    resolvedNodes.OutputType = OutputUnknown;
+  }
+  return resolvedNodes;
+}
+
 //------------------------------------------------------------------------------
 void vtkSlicerCollectPointsLogic::RemoveLastPoint( vtkMRMLCollectPointsNode* collectPointsNode )
 {
+  this->RemoveLastPoints( collectPointsNode, 1 );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::RemoveLastPoints( vtkMRMLCollectPointsNode* collectPointsNode, int numberOfPointsToRemove )
+{
+  if ( numberOfPointsToRemove <= 0 )
+  {
+    return; // nothing to do
+  }
+
+  // the last points may still be in the buffer
+  this->FlushPendingPoints( collectPointsNode );
+
   vtkMRMLNode* outputNode = collectPointsNode->GetOutputNode();
   if ( outputNode == NULL )
   {
@@ -138,27 +227,37 @@ void vtkSlicerCollectPointsLogic::RemoveLastPoint( vtkMRMLCollectPointsNode* col
   if ( outputMarkupsNode != NULL )
   {
     int numberOfPoints = outputMarkupsNode->GetNumberOfFiducials();
-    if ( numberOfPoints == 0 )
+    int numberOfPointsToRetain = std::max( 0, numberOfPoints - numberOfPointsToRemove );
+    // removing from the end does not shift the remaining markups
+    int wasModified = outputMarkupsNode->StartModify();
+    for ( int pointIndex = numberOfPoints - 1; pointIndex >= numberOfPointsToRetain; pointIndex-- )
     {
-      return; // nothing to do
+      outputMarkupsNode->RemoveMarkup( pointIndex );
     }
-    vtkIdType lastPointId = numberOfPoints - 1;
-    outputMarkupsNode->RemoveMarkup( lastPointId );
+    outputMarkupsNode->EndModify( wasModified );
   }
   else if ( outputModelNode != NULL )
   {
-    this->RemoveLastPointFromModel( outputModelNode );
+    this->RemoveLastPointsFromModel( outputModelNode, numberOfPointsToRemove );
   }
   else
   {
     vtkErrorMacro( "Could not recognize the type of output node. Will not remove any points." );
     return;
   }
+
+  this->UpdateSurfaceModel( collectPointsNode );
 }
 
 //------------------------------------------------------------------------------
 void vtkSlicerCollectPointsLogic::RemoveAllPoints( vtkMRMLCollectPointsNode* collectPointsNode )
 {
+  // buffered points are discarded as well
+  if ( this->PendingPoints.erase( collectPointsNode ) > 0 && this->PendingPoints.empty() )
+  {
+    this->Modified();
+  }
+
   vtkMRMLNode* outputNode = collectPointsNode->GetOutputNode();
   if ( outputNode == NULL )
   {
@@ -184,6 +283,8 @@ void vtkSlicerCollectPointsLogic::RemoveAllPoints( vtkMRMLCollectPointsNode* col
     vtkErrorMacro( "Could not recognize the type of output node. Will not remove any points." );
     return;
   }
+
+  this->UpdateSurfaceModel( collectPointsNode );
 }
 
 //------------------------------------------------------------------------------
@@ -192,6 +293,7 @@ void vtkSlicerCollectPointsLogic::SetMRMLSceneInternal( vtkMRMLScene * newScene
   vtkNew<vtkIntArray> events;
   events->InsertNextValue( vtkMRMLScene::NodeAddedEvent );
   events->InsertNextValue( vtkMRMLScene::NodeRemovedEvent );
+  events->InsertNextValue( vtkMRMLScene::EndBatchProcessEvent );
   this->SetAndObserveMRMLSceneEventsInternal( newScene, events.GetPointer() );
 }
 
@@ -221,18 +323,55 @@ void vtkSlicerCollectPointsLogic::OnMRMLSceneNodeAdded( vtkMRMLNode* node )
     return;
   }
 
+  if ( this->GetMRMLScene()->IsBatchProcessing() )
+  {
+    return; // set up in OnMRMLSceneEndBatchProcess
+  }
+
+  // the new node may be the target of a reference that could not be resolved before
+  this->ResolvedNodesCache.clear();
+
   vtkMRMLCollectPointsNode* collectPointsNode = vtkMRMLCollectPointsNode::SafeDownCast( node );
   if ( collectPointsNode )
   {
     vtkDebugMacro( "OnMRMLSceneNodeAdded: Module node added." );
-    vtkUnObserveMRMLNodeMacro( collectPointsNode ); // Remove previous observers.
-    vtkNew<vtkIntArray> events;
-    events->InsertNextValue( vtkCommand::ModifiedEvent );
-    events->InsertNextValue( vtkMRMLCollectPointsNode::InputDataModifiedEvent );
-    vtkObserveMRMLNodeEventsMacro( collectPointsNode, events.GetPointer() );
+    this->InitializeModuleNode( collectPointsNode );
   }
 }
 
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::OnMRMLSceneEndBatchProcess()
+{
+  if ( this->GetMRMLScene() == NULL )
+  {
+    return;
+  }
+  this->ResolvedNodesCache.clear();
+  std::vector< vtkMRMLNode* > collectPointsNodes;
+  this->GetMRMLScene()->GetNodesByClass( "vtkMRMLCollectPointsNode", collectPointsNodes );
+  for ( std::vector< vtkMRMLNode* >::iterator nodeIt = collectPointsNodes.begin(); nodeIt != collectPointsNodes.end(); ++nodeIt )
+  {
+    this->InitializeModuleNode( vtkMRMLCollectPointsNode::SafeDownCast( *nodeIt ) );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::InitializeModuleNode( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  if ( collectPointsNode == NULL )
+  {
+    return;
+  }
+  vtkUnObserveMRMLNodeMacro( collectPointsNode ); // Remove previous observers.
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  events->InsertNextValue( vtkMRMLCollectPointsNode::InputDataModifiedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceAddedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceModifiedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceRemovedEvent );
+  vtkObserveMRMLNodeEventsMacro( collectPointsNode, events.GetPointer() );
+}
+
 //------------------------------------------------------------------------------
 void vtkSlicerCollectPointsLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
 {
@@ -246,6 +385,19 @@ void vtkSlicerCollectPointsLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
   {
     vtkDebugMacro( "OnMRMLSceneNodeRemoved" );
     vtkUnObserveMRMLNodeMacro( node );
+    if ( node->GetID() )
+    {
+      this->CollectedPointsGrids.erase( node->GetID() );
+      this->SurfaceReconstructions.erase( node->GetID() );
+      this->PointsFileWriters.erase( node->GetID() ); // the file is closed by the writer
+    }
+    vtkMRMLCollectPointsNode* collectPointsNode = vtkMRMLCollectPointsNode::SafeDownCast( node );
+    this->ResolvedNodesCache.erase( collectPointsNode );
+    this->LastOutputUpdateTimeSec.erase( collectPointsNode );
+    if ( this->PendingPoints.erase( collectPointsNode ) > 0 && this->PendingPoints.empty() )
+    {
+      this->Modified();
+    }
   }
 }
 
@@ -258,17 +410,32 @@ void vtkSlicerCollectPointsLogic::ProcessMRMLNodesEvents( vtkObject* caller, uns
     vtkErrorMacro( "No parameter node set. Aborting." );
     return;
   }
+
+  if ( event == vtkMRMLNode::ReferenceAddedEvent || event == vtkMRMLNode::ReferenceModifiedEvent || event == vtkMRMLNode::ReferenceRemovedEvent )
+  {
+    // nodes are resolved again when the next point is collected
+    this->ResolvedNodesCache.erase( collectPointsNode );
+    return;
+  }
   
   if ( event == vtkMRMLCollectPointsNode::InputDataModifiedEvent )
   {
+    this->PerformanceCounters->EventReceived();
     if ( collectPointsNode->GetCollectMode() == vtkMRMLCollectPointsNode::Automatic )
     {
-      if ( collectPointsNode->GetOutputNode() == NULL )
+      if ( this->GetResolvedNodes( collectPointsNode ).OutputType == OutputNone )
       {
         vtkWarningMacro( "Collect fiducials node is not fully set up, there needs to be an output node." );
         return;
       }
-      this->AddPoint( collectPointsNode ); // Will create modified event to update widget
+      if ( collectPointsNode->GetOutputUpdatesPerSecond() > 0 )
+      {
+        this->AddPointToPendingPoints( collectPointsNode );
+      }
+      else
+      {
+        this->AddPoint( collectPointsNode ); // Will create modified event to update widget
+      }
     }
   }
 }
@@ -276,7 +443,8 @@ void vtkSlicerCollectPointsLogic::ProcessMRMLNodesEvents( vtkObject* caller, uns
 //------------------------------------------------------------------------------
 void vtkSlicerCollectPointsLogic::AddPointToModel( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] )
 {
-  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast( collectPointsNode->GetOutputNode() );
+  ResolvedNodes& resolvedNodes = this->GetResolvedNodes( collectPointsNode );
+  vtkMRMLModelNode* modelNode = ( resolvedNodes.OutputType == OutputModel ? static_cast< vtkMRMLModelNode* >( resolvedNodes.OutputNode.GetPointer() ) : NULL );
   if ( modelNode == NULL )
   {
     vtkErrorMacro( "Output node is null. No points added." );
@@ -297,29 +465,19 @@ void vtkSlicerCollectPointsLogic::AddPointToModel( vtkMRMLCollectPointsNode* col
     polyData->SetPoints( points );
   }
 
-  int numberOfPoints = ( int )points->GetNumberOfPoints();
-  if ( numberOfPoints > 0 )
+  if ( this->IsPointTooCloseToCollectedPoints( collectPointsNode, pointCoordinates ) )
   {
-    double minimumDistanceFromPreviousPoint = collectPointsNode->GetMinimumDistance();
-    // minimum distance for adding point only applies if in auto-collect mode
-    if ( minimumDistanceFromPreviousPoint > 0.0 && collectPointsNode->GetCollectMode() == vtkMRMLCollectPointsNode::Automatic )
-    {
-      double previousCoordinates[ 3 ];
-      points->GetPoint( numberOfPoints - 1, previousCoordinates );
-      double distance = sqrt( vtkMath::Distance2BetweenPoints( pointCoordinates, previousCoordinates ) );
-      if ( distance < minimumDistanceFromPreviousPoint )
-      {
-        return;
-      }
-    }
+    return;
   }
-  points->InsertNextPoint( pointCoordinates );
+  vtkIdType pointId = points->InsertNextPoint( pointCoordinates );
+  points->Modified();
 
-  this->UpdateCellsForPolyData( polyData );
+  this->AppendVertexCellForPolyData( polyData, pointId );
+  this->OnPointCollected( collectPointsNode, pointCoordinates );
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerCollectPointsLogic::RemoveLastPointFromModel( vtkMRMLModelNode* modelNode )
+void vtkSlicerCollectPointsLogic::RemoveLastPointsFromModel( vtkMRMLModelNode* modelNode, int numberOfPointsToRemove )
 {
   if ( modelNode == NULL )
   {
@@ -334,24 +492,39 @@ void vtkSlicerCollectPointsLogic::RemoveLastPointFromModel( vtkMRMLModelNode* mo
     modelNode->SetAndObservePolyData( polyData );
   }
 
-  vtkSmartPointer< vtkPoints > oldPoints = polyData->GetPoints();
-  if ( oldPoints == NULL || oldPoints->GetNumberOfPoints() == 0 )
+  vtkPoints* points = polyData->GetPoints();
+  if ( points == NULL || points->GetNumberOfPoints() == 0 )
   {
     polyData->SetPoints( vtkSmartPointer< vtkPoints >::New() );
     return; // nothing to do
   }
 
-  vtkSmartPointer< vtkPoints > newPoints = vtkSmartPointer< vtkPoints >::New();
-  int numberOfPointsToRetain = ( int )oldPoints->GetNumberOfPoints() - 1;
-  newPoints->SetNumberOfPoints( numberOfPointsToRetain );
-  for ( vtkIdType ptId = 0; ptId < numberOfPointsToRetain; ptId++ )
+  // Truncate the point array in place. Shrinking the number of points keeps the allocated memory,
+  // so the cost does not depend on the number of retained points.
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  vtkIdType numberOfPointsToRetain = std::max< vtkIdType >( 0, numberOfPoints - numberOfPointsToRemove );
+  points->SetNumberOfPoints( numberOfPointsToRetain );
+  points->Modified();
+
+  // If there is exactly one vertex per point (as created by AppendVertexCellForPolyData) and nothing else,
+  // then the vertices of the removed points are at the end of the cell array and are truncated the same way.
+  vtkCellArray* verticesCellArray = polyData->GetVerts();
+  if ( verticesCellArray == NULL || verticesCellArray->GetNumberOfCells() != numberOfPoints
+    || verticesCellArray->GetNumberOfConnectivityEntries() != 2 * numberOfPoints
+    || polyData->GetNumberOfLines() > 0 || polyData->GetNumberOfPolys() > 0 || polyData->GetNumberOfStrips() > 0 )
   {
-    double* point = oldPoints->GetPoint( ptId );
-    newPoints->SetPoint( ptId, point );
+    this->UpdateCellsForPolyData( polyData );
+    return;
   }
-  polyData->SetPoints( newPoints );
+  vtkIdTypeArray* verticesData = verticesCellArray->GetData();
+  verticesData->SetNumberOfTuples( 2 * numberOfPointsToRetain ); // each vertex is stored as (1, pointId)
+  verticesCellArray->SetCells( numberOfPointsToRetain, verticesData ); // updates the number of cells and the insert location
+  verticesCellArray->Modified();
 
-  this->UpdateCellsForPolyData( polyData );
+  // The cell and link lookup structures refer to the removed cells, they are rebuilt when needed
+  polyData->DeleteCells();
+  polyData->DeleteLinks();
+  polyData->Modified();
 }
 
 //------------------------------------------------------------------------------
@@ -364,7 +537,8 @@ void vtkSlicerCollectPointsLogic::UpdateCellsForPolyData( vtkPolyData* polyData
   }
 
   // update vertices
-  // TODO: Allocate more intelligently...? Would be better to simply add/remove vertices as needed, but this causes a crash
+  // Points are appended using AppendVertexCellForPolyData and removed using RemoveLastPointsFromModel,
+  // this is used when the cells of the poly data are not only one vertex per point
   int numberOfPoints = ( int )polyData->GetNumberOfPoints();
   vtkSmartPointer< vtkCellArray > verticesCellArray = vtkSmartPointer< vtkCellArray >::New();
   verticesCellArray->Allocate( verticesCellArray->EstimateSize( numberOfPoints, 1 ) );
@@ -381,41 +555,517 @@ void vtkSlicerCollectPointsLogic::UpdateCellsForPolyData( vtkPolyData* polyData
 }
 
 //------------------------------------------------------------------------------
-void vtkSlicerCollectPointsLogic::AddPointToMarkups( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] )
+void vtkSlicerCollectPointsLogic::AppendVertexCellForPolyData( vtkPolyData* polyData, vtkIdType pointId )
 {
-  vtkMRMLMarkupsFiducialNode* markupsNode = vtkMRMLMarkupsFiducialNode::SafeDownCast( collectPointsNode->GetOutputNode() );
+  if ( polyData == NULL )
+  {
+    vtkErrorMacro( "Poly data is null. Will not update cells." );
+    return;
+  }
+
+  // Appending is only possible if there is a vertex for each previous point and nothing else,
+  // otherwise all cells are rebuilt. The first vertex is always added by rebuilding, as GetVerts()
+  // returns a shared placeholder array if the poly data has no vertices yet.
+  vtkCellArray* verticesCellArray = polyData->GetVerts();
+  if ( pointId == 0 || verticesCellArray == NULL || verticesCellArray->GetNumberOfCells() != pointId
+    || polyData->GetNumberOfLines() > 0 || polyData->GetNumberOfPolys() > 0 || polyData->GetNumberOfStrips() > 0 )
+  {
+    this->UpdateCellsForPolyData( polyData );
+    return;
+  }
+
+  // The cell array grows its storage geometrically, so appending has constant amortized cost
+  verticesCellArray->InsertNextCell( 1 );
+  verticesCellArray->InsertCellPoint( pointId );
+  verticesCellArray->Modified();
+
+  // The cell and link lookup structures do not know about the new cell, they are rebuilt when needed
+  polyData->DeleteCells();
+  polyData->DeleteLinks();
+  polyData->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::AddPointsToMarkups( vtkMRMLCollectPointsNode* collectPointsNode, double* pointsCoordinates, int numberOfPoints )
+{
+  ResolvedNodes& resolvedNodes = this->GetResolvedNodes( collectPointsNode );
+  vtkMRMLMarkupsFiducialNode* markupsNode = ( resolvedNodes.OutputType == OutputMarkups ? static_cast< vtkMRMLMarkupsFiducialNode* >( resolvedNodes.OutputNode.GetPointer() ) : NULL );
   if ( markupsNode == NULL )
   {
     vtkErrorMacro( "Output node is null. No points added." );
     return;
   }
 
-  // if in automatic collection mode, make sure sufficient there is sufficient distance from previous point
-  int numberOfPoints = markupsNode->GetNumberOfFiducials();
-  if ( numberOfPoints > 0 )
+  // Only every Nth point is shown, as displaying many fiducials slows down the views
+  int displayDownsamplingFactor = std::max( 1, collectPointsNode->GetMarkupsDisplayDownsamplingFactor() );
+  int nextLabelNumber = collectPointsNode->GetNextLabelNumber();
+
+  // Markups are added in a single modification, so the markups display is only updated once
+  int wasModified = markupsNode->StartModify();
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    double* pointCoordinates = pointsCoordinates + 3 * pointIndex;
+
+    // if in automatic collection mode, make sure sufficient there is sufficient distance from previous point
+    if ( this->IsPointTooCloseToCollectedPoints( collectPointsNode, pointCoordinates ) )
+    {
+      continue;
+    }
+
+    // add the label to the point
+    std::stringstream markupLabel;
+    markupLabel << collectPointsNode->GetLabelBase() << nextLabelNumber;
+
+    // Add point to the markups node
+    int pointIndexInMarkups = markupsNode->AddFiducialFromArray( pointCoordinates );
+    markupsNode->SetNthFiducialLabel( pointIndexInMarkups, markupLabel.str().c_str() );
+    if ( displayDownsamplingFactor > 1 )
+    {
+      markupsNode->SetNthFiducialVisibility( pointIndexInMarkups, pointIndexInMarkups % displayDownsamplingFactor == 0 );
+    }
+
+    this->OnPointCollected( collectPointsNode, pointCoordinates );
+
+    // always increase the label counter
+    nextLabelNumber++;
+  }
+  markupsNode->EndModify( wasModified );
+
+  collectPointsNode->SetNextLabelNumber( nextLabelNumber );
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerCollectPointsLogic::IsPointTooCloseToCollectedPoints( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] )
+{
+  double minimumDistance = collectPointsNode->GetMinimumDistance();
+  // minimum distance for adding point only applies if in auto-collect mode
+  if ( minimumDistance <= 0.0 || collectPointsNode->GetCollectMode() != vtkMRMLCollectPointsNode::Automatic )
+  {
+    return false;
+  }
+  ResolvedNodes& resolvedNodes = this->GetResolvedNodes( collectPointsNode );
+  vtkMRMLNode* outputNode = resolvedNodes.OutputNode;
+  vtkMRMLMarkupsFiducialNode* outputMarkupsNode = ( resolvedNodes.OutputType == OutputMarkups ? static_cast< vtkMRMLMarkupsFiducialNode* >( outputNode ) : NULL );
+  vtkMRMLModelNode* outputModelNode = ( resolvedNodes.OutputType == OutputModel ? static_cast< vtkMRMLModelNode* >( outputNode ) : NULL );
+  int numberOfPoints = collectPointsNode->GetNumberOfPointsInOutput();
+  if ( numberOfPoints == 0 || ( outputMarkupsNode == NULL && outputModelNode == NULL ) )
+  {
+    return false;
+  }
+
+  if ( !collectPointsNode->GetMinimumDistanceFromAllPoints() || collectPointsNode->GetID() == NULL )
   {
-    double minimumDistanceFromPreviousPoint = collectPointsNode->GetMinimumDistance();
-    // minimum distance for adding point only applies if in auto-collect mode
-    if ( minimumDistanceFromPreviousPoint > 0.0 && collectPointsNode->GetCollectMode() == vtkMRMLCollectPointsNode::Automatic )
+    double previousCoordinates[ 3 ] = { 0.0, 0.0, 0.0 };
+    if ( outputMarkupsNode != NULL )
     {
-      double previousCoordinates[ 3 ];
-      markupsNode->GetNthFiducialPosition( numberOfPoints - 1, previousCoordinates );
-      double distance = sqrt( vtkMath::Distance2BetweenPoints( pointCoordinates, previousCoordinates ) );
-      if ( distance < minimumDistanceFromPreviousPoint )
+      outputMarkupsNode->GetNthFiducialPosition( numberOfPoints - 1, previousCoordinates );
+    }
+    else
+    {
+      outputModelNode->GetPolyData()->GetPoint( numberOfPoints - 1, previousCoordinates );
+    }
+    double distance = sqrt( vtkMath::Distance2BetweenPoints( pointCoordinates, previousCoordinates ) );
+    return ( distance < minimumDistance );
+  }
+
+  // Rebuild the grid if the output has been changed other than by collecting points
+  CollectedPointsGrid& grid = this->CollectedPointsGrids[ collectPointsNode->GetID() ];
+  double lastPoint[ 3 ] = { 0.0, 0.0, 0.0 };
+  if ( outputMarkupsNode != NULL )
+  {
+    outputMarkupsNode->GetNthFiducialPosition( numberOfPoints - 1, lastPoint );
+  }
+  else
+  {
+    outputModelNode->GetPolyData()->GetPoint( numberOfPoints - 1, lastPoint );
+  }
+  if ( grid.OutputNode.GetPointer() != outputNode || grid.CellSize != minimumDistance
+    || grid.OutputMTime != GetOutputPointsMTime( outputNode ) || ( int )( grid.Points.size() / 3 ) != numberOfPoints
+    || !std::equal( lastPoint, lastPoint + 3, grid.Points.end() - 3 ) )
+  {
+    grid.OutputNode = outputNode;
+    grid.CellSize = minimumDistance;
+    grid.OutputMTime = GetOutputPointsMTime( outputNode );
+    grid.Points.clear();
+    grid.Buckets.assign( COLLECTED_POINTS_GRID_INITIAL_NUMBER_OF_BUCKETS, std::vector< int >() );
+    for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+    {
+      double collectedPoint[ 3 ] = { 0.0, 0.0, 0.0 };
+      if ( outputMarkupsNode != NULL )
       {
-        return;
+        outputMarkupsNode->GetNthFiducialPosition( pointIndex, collectedPoint );
+      }
+      else
+      {
+        outputModelNode->GetPolyData()->GetPoint( pointIndex, collectedPoint );
+      }
+      InsertPointIntoGrid( grid, collectedPoint );
+    }
+  }
+
+  // Any point closer than the cell size is in one of the 27 neighboring cells
+  int centerCellIndex[ 3 ] = { 0, 0, 0 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    centerCellIndex[ axis ] = ( int )floor( pointCoordinates[ axis ] / grid.CellSize );
+  }
+  double minimumDistance2 = minimumDistance * minimumDistance;
+  for ( int dz = -1; dz <= 1; dz++ )
+  {
+    for ( int dy = -1; dy <= 1; dy++ )
+    {
+      for ( int dx = -1; dx <= 1; dx++ )
+      {
+        int cellIndex[ 3 ] = { centerCellIndex[ 0 ] + dx, centerCellIndex[ 1 ] + dy, centerCellIndex[ 2 ] + dz };
+        std::vector< int >& bucket = grid.Buckets[ GetGridBucketIndex( grid, cellIndex ) ];
+        for ( std::vector< int >::iterator pointIndexIt = bucket.begin(); pointIndexIt != bucket.end(); ++pointIndexIt )
+        {
+          if ( vtkMath::Distance2BetweenPoints( pointCoordinates, &( grid.Points[ 3 * ( *pointIndexIt ) ] ) ) < minimumDistance2 )
+          {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::OnPointCollected( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] )
+{
+  if ( collectPointsNode->GetID() == NULL )
+  {
+    return;
+  }
+  std::map< std::string, vtkSmartPointer< vtkCollectedPointsFileWriter > >::iterator writerIt = this->PointsFileWriters.find( collectPointsNode->GetID() );
+  if ( writerIt != this->PointsFileWriters.end() )
+  {
+    vtkMRMLTransformNode* samplingNode = this->GetResolvedNodes( collectPointsNode ).SamplingNode;
+    writerIt->second->AddPoint( pointCoordinates, vtkTimerLog::GetUniversalTime(), samplingNode ? samplingNode->GetID() : NULL );
+  }
+  std::map< std::string, CollectedPointsGrid >::iterator gridIt = this->CollectedPointsGrids.find( collectPointsNode->GetID() );
+  if ( gridIt == this->CollectedPointsGrids.end() || gridIt->second.OutputNode.GetPointer() != this->GetResolvedNodes( collectPointsNode ).OutputNode.GetPointer() )
+  {
+    // the grid is built when it is needed
+    return;
+  }
+  CollectedPointsGrid& grid = gridIt->second;
+  InsertPointIntoGrid( grid, pointCoordinates );
+  grid.OutputMTime = GetOutputPointsMTime( grid.OutputNode );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::UpdateSurfaceModel( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  vtkMRMLModelNode* surfaceModelNode = collectPointsNode->GetSurfaceModelNode();
+  if ( surfaceModelNode == NULL || collectPointsNode->GetID() == NULL )
+  {
+    if ( collectPointsNode->GetID() != NULL )
+    {
+      this->SurfaceReconstructions.erase( collectPointsNode->GetID() );
+    }
+    return;
+  }
+  if ( collectPointsNode->GetSurfaceVoxelSize() <= 0.0 || collectPointsNode->GetSurfaceNeighborhoodRadius() <= 0.0 )
+  {
+    vtkWarningMacro( "Surface voxel size and neighborhood radius must be positive. Surface is not updated." );
+    return;
+  }
+
+  SurfaceReconstructionState& state = this->SurfaceReconstructions[ collectPointsNode->GetID() ];
+  if ( state.Reconstruction == NULL )
+  {
+    state.Reconstruction = vtkSmartPointer< vtkStreamingSurfaceReconstruction >::New();
+  }
+  vtkStreamingSurfaceReconstruction* reconstruction = state.Reconstruction;
+  // changing the parameters resets the reconstruction
+  reconstruction->SetVoxelSize( collectPointsNode->GetSurfaceVoxelSize() );
+  reconstruction->SetNeighborhoodRadius( collectPointsNode->GetSurfaceNeighborhoodRadius() );
+
+  // Start over if points were removed or replaced, otherwise only add the new points
+  vtkMRMLNode* outputNode = collectPointsNode->GetOutputNode();
+  int numberOfOutputPoints = collectPointsNode->GetNumberOfPointsInOutput();
+  int numberOfReconstructedPoints = reconstruction->GetNumberOfPoints();
+  bool outputChanged = ( state.OutputNode.GetPointer() != outputNode || numberOfReconstructedPoints > numberOfOutputPoints );
+  if ( !outputChanged && numberOfReconstructedPoints > 0 )
+  {
+    double lastReconstructedPoint[ 3 ] = { 0.0, 0.0, 0.0 };
+    double outputPoint[ 3 ] = { 0.0, 0.0, 0.0 };
+    reconstruction->GetPoint( numberOfReconstructedPoints - 1, lastReconstructedPoint );
+    GetOutputPoint( outputNode, numberOfReconstructedPoints - 1, outputPoint );
+    outputChanged = !std::equal( lastReconstructedPoint, lastReconstructedPoint + 3, outputPoint );
+  }
+  if ( outputChanged )
+  {
+    reconstruction->Reset();
+    state.OutputNode = outputNode;
+    numberOfReconstructedPoints = 0;
+  }
+  for ( int pointIndex = numberOfReconstructedPoints; pointIndex < numberOfOutputPoints; pointIndex++ )
+  {
+    double outputPoint[ 3 ] = { 0.0, 0.0, 0.0 };
+    GetOutputPoint( outputNode, pointIndex, outputPoint );
+    reconstruction->AddPoint( outputPoint );
+  }
+
+  reconstruction->Update();
+  if ( surfaceModelNode->GetPolyData() != reconstruction->GetOutput() )
+  {
+    surfaceModelNode->SetAndObservePolyData( reconstruction->GetOutput() );
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerCollectPointsLogic::GetOutputPoint( vtkMRMLNode* outputNode, int pointIndex, double pointCoordinates[ 3 ] )
+{
+  vtkMRMLMarkupsFiducialNode* outputMarkupsNode = vtkMRMLMarkupsFiducialNode::SafeDownCast( outputNode );
+  vtkMRMLModelNode* outputModelNode = vtkMRMLModelNode::SafeDownCast( outputNode );
+  if ( outputMarkupsNode != NULL )
+  {
+    outputMarkupsNode->GetNthFiducialPosition( pointIndex, pointCoordinates );
+    return true;
+  }
+  else if ( outputModelNode != NULL && outputModelNode->GetPolyData() != NULL )
+  {
+    outputModelNode->GetPolyData()->GetPoint( pointIndex, pointCoordinates );
+    return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+unsigned long vtkSlicerCollectPointsLogic::GetOutputPointsMTime( vtkMRMLNode* outputNode )
+{
+  vtkMRMLModelNode* outputModelNode = vtkMRMLModelNode::SafeDownCast( outputNode );
+  if ( outputModelNode != NULL )
+  {
+    vtkPolyData* polyData = outputModelNode->GetPolyData();
+    if ( polyData == NULL || polyData->GetPoints() == NULL )
+    {
+      return 0;
+    }
+    return polyData->GetPoints()->GetMTime();
+  }
+  // Markups do not have a separate modification time for the point positions, and the node
+  // modification time is not updated while the node is being modified. The number of points
+  // and the last point are checked instead.
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::InsertPointIntoGrid( CollectedPointsGrid& grid, const double pointCoordinates[ 3 ] )
+{
+  int pointIndex = ( int )( grid.Points.size() / 3 );
+  grid.Points.insert( grid.Points.end(), pointCoordinates, pointCoordinates + 3 );
+
+  if ( grid.Buckets.empty() || pointIndex + 1 > 2 * ( int )grid.Buckets.size() )
+  {
+    // Too many points per bucket, rehash all points into twice as many buckets (constant amortized cost)
+    int numberOfBuckets = std::max( COLLECTED_POINTS_GRID_INITIAL_NUMBER_OF_BUCKETS, 2 * ( int )grid.Buckets.size() );
+    grid.Buckets.assign( numberOfBuckets, std::vector< int >() );
+    for ( int index = 0; index < pointIndex; index++ )
+    {
+      int cellIndex[ 3 ] = { 0, 0, 0 };
+      for ( int axis = 0; axis < 3; axis++ )
+      {
+        cellIndex[ axis ] = ( int )floor( grid.Points[ 3 * index + axis ] / grid.CellSize );
+      }
+      grid.Buckets[ GetGridBucketIndex( grid, cellIndex ) ].push_back( index );
+    }
+  }
+
+  int cellIndex[ 3 ] = { 0, 0, 0 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    cellIndex[ axis ] = ( int )floor( pointCoordinates[ axis ] / grid.CellSize );
+  }
+  grid.Buckets[ GetGridBucketIndex( grid, cellIndex ) ].push_back( pointIndex );
+}
+
+//------------------------------------------------------------------------------
+unsigned int vtkSlicerCollectPointsLogic::GetGridBucketIndex( CollectedPointsGrid& grid, int cellIndex[ 3 ] )
+{
+  // Spatial hash function of Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+  unsigned int hash = ( ( unsigned int )cellIndex[ 0 ] * 73856093u ) ^ ( ( unsigned int )cellIndex[ 1 ] * 19349663u ) ^ ( ( unsigned int )cellIndex[ 2 ] * 83492791u );
+  return hash % ( unsigned int )grid.Buckets.size();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::AddPointToPendingPoints( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  double pointCoordinates[ 3 ] = { 0.0, 0.0, 0.0 };
+  if ( !this->ComputePointCoordinates( collectPointsNode, pointCoordinates ) )
+  {
+    vtkErrorMacro( "Could not compute point coordinates. Will not add any points." );
+    return;
+  }
+
+  bool hadPendingUpdates = this->HasPendingUpdates();
+  std::vector< double >& pendingPoints = this->PendingPoints[ collectPointsNode ];
+  pendingPoints.insert( pendingPoints.end(), pointCoordinates, pointCoordinates + 3 );
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  std::map< vtkMRMLCollectPointsNode*, double >::iterator lastUpdateIt = this->LastOutputUpdateTimeSec.find( collectPointsNode );
+  if ( lastUpdateIt == this->LastOutputUpdateTimeSec.end()
+    || currentTimeSec - lastUpdateIt->second >= 1.0 / collectPointsNode->GetOutputUpdatesPerSecond() )
+  {
+    this->FlushPendingPoints( collectPointsNode );
+    return;
+  }
+  // the point is added to the output with the next batch
+  this->PerformanceCounters->UpdateSkipped();
+  if ( !hadPendingUpdates )
+  {
+    this->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::FlushPendingPoints( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  std::map< vtkMRMLCollectPointsNode*, std::vector< double > >::iterator pendingPointsIt = this->PendingPoints.find( collectPointsNode );
+  if ( pendingPointsIt == this->PendingPoints.end() )
+  {
+    return;
+  }
+  double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+  std::vector< double > pendingPoints;
+  pendingPoints.swap( pendingPointsIt->second );
+  this->PendingPoints.erase( pendingPointsIt );
+  this->LastOutputUpdateTimeSec[ collectPointsNode ] = vtkTimerLog::GetUniversalTime();
+
+  ResolvedNodes& resolvedNodes = this->GetResolvedNodes( collectPointsNode );
+  vtkMRMLNode* outputNode = resolvedNodes.OutputNode;
+  if ( outputNode == NULL )
+  {
+    vtkWarningMacro( "Collect points node is not fully set up, there needs to be an output node. Buffered points are discarded." );
+  }
+  else
+  {
+    // Add all points within a single modification, so that observers of the output
+    // (and of the collect points node, which counts the labels) are only notified once
+    int wasOutputModified = outputNode->StartModify();
+    int wasCollectPointsModified = collectPointsNode->StartModify();
+    int numberOfPendingPoints = ( int )( pendingPoints.size() / 3 );
+    if ( resolvedNodes.OutputType == OutputMarkups )
+    {
+      this->AddPointsToMarkups( collectPointsNode, &( pendingPoints[ 0 ] ), numberOfPendingPoints );
+    }
+    else
+    {
+      for ( int pointIndex = 0; pointIndex < numberOfPendingPoints; pointIndex++ )
+      {
+        this->AddPointCoordinatesToOutput( collectPointsNode, &( pendingPoints[ 3 * pointIndex ] ) );
       }
     }
+    collectPointsNode->EndModify( wasCollectPointsModified );
+    outputNode->EndModify( wasOutputModified );
+
+    this->UpdateSurfaceModel( collectPointsNode );
+  }
+  this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+
+  if ( this->PendingPoints.empty() )
+  {
+    this->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::ProcessPendingUpdates()
+{
+  // points that were collected just before the collection stopped are written within the flush interval
+  for ( std::map< std::string, vtkSmartPointer< vtkCollectedPointsFileWriter > >::iterator writerIt = this->PointsFileWriters.begin();
+    writerIt != this->PointsFileWriters.end(); ++writerIt )
+  {
+    writerIt->second->FlushIfDue();
+  }
+
+  if ( this->PendingPoints.empty() )
+  {
+    return;
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  // copy, as the map is modified by the flushes
+  std::vector< vtkMRMLCollectPointsNode* > pendingNodes;
+  for ( std::map< vtkMRMLCollectPointsNode*, std::vector< double > >::iterator pendingPointsIt = this->PendingPoints.begin();
+    pendingPointsIt != this->PendingPoints.end(); ++pendingPointsIt )
+  {
+    pendingNodes.push_back( pendingPointsIt->first );
+  }
+  for ( std::vector< vtkMRMLCollectPointsNode* >::iterator nodeIt = pendingNodes.begin(); nodeIt != pendingNodes.end(); ++nodeIt )
+  {
+    vtkMRMLCollectPointsNode* collectPointsNode = *nodeIt;
+    int outputUpdatesPerSecond = collectPointsNode->GetOutputUpdatesPerSecond();
+    if ( outputUpdatesPerSecond > 0 && collectPointsNode->GetCollectMode() == vtkMRMLCollectPointsNode::Automatic
+      && currentTimeSec - this->LastOutputUpdateTimeSec[ collectPointsNode ] < 1.0 / outputUpdatesPerSecond )
+    {
+      // not due yet
+      continue;
+    }
+    this->FlushPendingPoints( collectPointsNode );
   }
+}
 
-  // add the label to the point
-  std::stringstream markupLabel;
-  markupLabel << collectPointsNode->GetLabelBase() << collectPointsNode->GetNextLabelNumber();
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( caller == vtkSlicerTrackingTickLogic::GetInstance() && event == vtkSlicerTrackingTickLogic::TrackingTickEvent )
+  {
+    this->ProcessPendingUpdates();
+    return;
+  }
+  this->Superclass::ProcessMRMLLogicsEvents( caller, event, callData );
+}
 
-  // Add point to the markups node
-  int pointIndexInMarkups = markupsNode->AddFiducialFromArray( pointCoordinates );
-  markupsNode->SetNthFiducialLabel( pointIndexInMarkups, markupLabel.str().c_str() );
+//------------------------------------------------------------------------------
+bool vtkSlicerCollectPointsLogic::HasPendingUpdates()
+{
+  return !this->PendingPoints.empty();
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerCollectPointsLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
 
-  // always increase the label counter
-  collectPointsNode->SetNextLabelNumber( collectPointsNode->GetNextLabelNumber() + 1 );
+//------------------------------------------------------------------------------
+bool vtkSlicerCollectPointsLogic::StartPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode, const char* fileName )
+{
+  if ( collectPointsNode == NULL || collectPointsNode->GetID() == NULL )
+  {
+    vtkErrorMacro( "StartPointsFileStreaming: Invalid collect points node" );
+    return false;
+  }
+  vtkSmartPointer< vtkCollectedPointsFileWriter > writer = vtkSmartPointer< vtkCollectedPointsFileWriter >::New();
+  if ( !writer->Open( fileName ) )
+  {
+    return false;
+  }
+  // replaces (and closes) the previous file of the node
+  this->PointsFileWriters[ collectPointsNode->GetID() ] = writer;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerCollectPointsLogic::StopPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  if ( collectPointsNode == NULL || collectPointsNode->GetID() == NULL )
+  {
+    return;
+  }
+  this->PointsFileWriters.erase( collectPointsNode->GetID() );
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerCollectPointsLogic::IsPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode )
+{
+  if ( collectPointsNode == NULL || collectPointsNode->GetID() == NULL )
+  {
+    return false;
+  }
+  return this->PointsFileWriters.find( collectPointsNode->GetID() ) != this->PointsFileWriters.end();
 }
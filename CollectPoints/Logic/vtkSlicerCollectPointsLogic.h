@@ -35,14 +35,26 @@
 #include "vtkMRMLMarkupsFiducialNode.h"
 #include "vtkMRMLModelNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
 // STD includes
+#include <map>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
 // includes related to CollectPoints
 #include "vtkMRMLCollectPointsNode.h"
 #include "vtkSlicerCollectPointsModuleLogicExport.h"
 
+class vtkCollectedPointsFileWriter;
+class vtkGeneralTransform;
+class vtkMatrix4x4;
+class vtkPerformanceCounters;
+class vtkStreamingSurfaceReconstruction;
+
 /// \ingroup Slicer_QtModules_CollectPoints
 class VTK_SLICER_COLLECTPOINTS_MODULE_LOGIC_EXPORT vtkSlicerCollectPointsLogic :
   public vtkSlicerModuleLogic
@@ -55,9 +67,34 @@ public:
   
   void AddPoint( vtkMRMLCollectPointsNode* collectPointsNode );
   void RemoveLastPoint( vtkMRMLCollectPointsNode* collectPointsNode );
+  /// Remove the last numberOfPointsToRemove points from the output (e.g., to undo a bad sweep).
+  /// The cost is proportional to the number of removed points, not the number of retained points.
+  void RemoveLastPoints( vtkMRMLCollectPointsNode* collectPointsNode, int numberOfPointsToRemove );
   void RemoveAllPoints( vtkMRMLCollectPointsNode* collectPointsNode );
+
+  /// Automatically collected points are buffered if OutputUpdatesPerSecond is set in the collect points node.
+  /// The buffered points are added to the output when ProcessPendingUpdates() is called
+  /// and their time has come.
+  /// The logic is modified when HasPendingUpdates() changes.
+  /// Called in the consumer stage of the shared tracking tick (see vtkSlicerTrackingTickLogic).
+  void ProcessPendingUpdates();
+  bool HasPendingUpdates();
+  /// Add all buffered points of the node to the output now
+  void FlushPendingPoints( vtkMRMLCollectPointsNode* collectPointsNode );
+
+  /// Append each point that is added to the output of the node to a binary PLY file as well, with the time
+  /// of adding and the ID of the sampling transform (see vtkCollectedPointsFileWriter). Points are written
+  /// within a second, so the file contains the points of a long session even if the application is terminated.
+  /// Streaming continues until it is stopped or the node is removed. Returns false if the file cannot be created.
+  bool StartPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode, const char* fileName );
+  void StopPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode );
+  bool IsPointsFileStreaming( vtkMRMLCollectPointsNode* collectPointsNode );
+
+  /// Number of received input events, output updates computed and buffered points, and the time spent in the updates
+  vtkPerformanceCounters* GetPerformanceCounters();
   
   void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );
+  void ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData );
 
 protected:
   vtkSlicerCollectPointsLogic();
@@ -69,16 +106,97 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  /// Module nodes added during batch processing (e.g., scene import) are set up here, in a single pass
+  virtual void OnMRMLSceneEndBatchProcess();
+  void InitializeModuleNode( vtkMRMLCollectPointsNode* collectPointsNode );
 private:
 
+  // Nodes referenced by a collect points node, resolved once and reused for each collected point.
+  // The entry is removed when the node references change (or any node is added to the scene,
+  // which may resolve a previously unresolved reference). Changes in the transform hierarchies
+  // are detected by the shared vtkTransformToWorldCache.
+  enum OutputNodeType
+  {
+    OutputNone,
+    OutputMarkups,
+    OutputModel,
+    OutputUnknown
+  };
+  struct ResolvedNodes
+  {
+    ResolvedNodes() : OutputType( OutputNone ) {}
+    vtkWeakPointer< vtkMRMLTransformNode > SamplingNode;
+    vtkWeakPointer< vtkMRMLTransformNode > AnchorNode;
+    vtkWeakPointer< vtkMRMLNode > OutputNode;
+    OutputNodeType OutputType;
+    // Only used if the sampling to anchor transform is not linear
+    vtkSmartPointer< vtkGeneralTransform > SamplingToAnchorTransform;
+  };
+  ResolvedNodes& GetResolvedNodes( vtkMRMLCollectPointsNode* collectPointsNode );
+  std::map< vtkMRMLCollectPointsNode*, ResolvedNodes > ResolvedNodesCache;
+
   // Computes the sampling coordinates in the anchor coordinate system
   // returns true if it was able to compute point coordinates. Returns false otherwise.
   bool ComputePointCoordinates( vtkMRMLCollectPointsNode* collectPointsNode, double outputPointCoordinates[ 3 ] );
 
+  void AddPointCoordinatesToOutput( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] );
+  // Add the current point to the buffer in automatic mode, flush the buffer if it is due
+  void AddPointToPendingPoints( vtkMRMLCollectPointsNode* collectPointsNode );
+
   void AddPointToModel( vtkMRMLCollectPointsNode* collectPointsNode,  double pointCoordinates[ 3 ] );
-  void RemoveLastPointFromModel( vtkMRMLModelNode* modelNode );
+  void RemoveLastPointsFromModel( vtkMRMLModelNode* modelNode, int numberOfPointsToRemove );
   void UpdateCellsForPolyData( vtkPolyData* polyData );
-  void AddPointToMarkups( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] );
+  // Adds a vertex cell for a newly added point. Falls back to UpdateCellsForPolyData if the cells are not only vertices.
+  void AppendVertexCellForPolyData( vtkPolyData* polyData, vtkIdType pointId );
+  // Adds a block of points (x, y, z of each point) to the markups output in a single modification
+  void AddPointsToMarkups( vtkMRMLCollectPointsNode* collectPointsNode, double* pointsCoordinates, int numberOfPoints );
+
+  // Returns true if the point is closer than the minimum distance to the previous point,
+  // or to any collected point if MinimumDistanceFromAllPoints is enabled
+  bool IsPointTooCloseToCollectedPoints( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] );
+  // Adds the point to the spatial hash of the collected points after it was added to the output
+  void OnPointCollected( vtkMRMLCollectPointsNode* collectPointsNode, double pointCoordinates[ 3 ] );
+
+  // Spatial hash of the collected points, with cells of the size of the minimum distance,
+  // so only the neighboring cells of a new point need to be checked.
+  struct CollectedPointsGrid
+  {
+    CollectedPointsGrid() : CellSize( 0.0 ), OutputMTime( 0 ) {}
+    double CellSize;
+    vtkWeakPointer< vtkMRMLNode > OutputNode;
+    unsigned long OutputMTime; // modification time of the output points when the grid was last updated
+    std::vector< double > Points; // x, y, z of each point
+    std::vector< std::vector< int > > Buckets; // point indices in each hash bucket
+  };
+  std::map< std::string, CollectedPointsGrid > CollectedPointsGrids; // key: collect points node ID
+
+  // Buffered points (x, y, z of each point) and the time of the last output update for batched collection
+  std::map< vtkMRMLCollectPointsNode*, std::vector< double > > PendingPoints;
+  std::map< vtkMRMLCollectPointsNode*, double > LastOutputUpdateTimeSec;
+
+  // Incremental surface reconstruction from the output points, for nodes that have a surface model node.
+  // Points that were added to the output since the last call are added to the reconstruction,
+  // if the output was changed in any other way then the reconstruction starts over.
+  void UpdateSurfaceModel( vtkMRMLCollectPointsNode* collectPointsNode );
+  struct SurfaceReconstructionState
+  {
+    vtkSmartPointer< vtkStreamingSurfaceReconstruction > Reconstruction;
+    vtkWeakPointer< vtkMRMLNode > OutputNode;
+  };
+  std::map< std::string, SurfaceReconstructionState > SurfaceReconstructions; // key: collect points node ID
+
+  // Files that the collected points are streamed to
+  std::map< std::string, vtkSmartPointer< vtkCollectedPointsFileWriter > > PointsFileWriters; // key: collect points node ID
+
+  // Reused for computing the point coordinates
+  vtkSmartPointer< vtkMatrix4x4 > SamplingToAnchorMatrix;
+
+  vtkSmartPointer< vtkPerformanceCounters > PerformanceCounters;
+
+  static bool GetOutputPoint( vtkMRMLNode* outputNode, int pointIndex, double pointCoordinates[ 3 ] );
+  static unsigned long GetOutputPointsMTime( vtkMRMLNode* outputNode );
+  static void InsertPointIntoGrid( CollectedPointsGrid& grid, const double pointCoordinates[ 3 ] );
+  static unsigned int GetGridBucketIndex( CollectedPointsGrid& grid, int cellIndex[ 3 ] );
   vtkSlicerCollectPointsLogic(const vtkSlicerCollectPointsLogic&); // Not implemented
   void operator=(const vtkSlicerCollectPointsLogic&);               // Not implemented
   
@@ -0,0 +1,543 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkStreamingSurfaceReconstruction.h"
+
+// VTK includes
+#include <vtkAppendPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkCleanPolyData.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkMarchingCubes.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+// Number of voxels along each side of a block. Neighboring blocks share one layer
+// of samples, so the extracted meshes of the blocks connect without gaps.
+static const int BLOCK_SIZE_VOXELS = 16;
+
+// Points of neighboring blocks on their shared face are merged if they are closer than this
+// (relative to the voxel size). They are computed from the same samples, but the sample positions
+// are computed from different block origins, so they may differ by rounding errors.
+static const double SEAM_MERGE_TOLERANCE_VOXELS = 1e-3;
+
+vtkStandardNewMacro( vtkStreamingSurfaceReconstruction );
+
+//------------------------------------------------------------------------------
+bool vtkStreamingSurfaceReconstruction::GridIndex::operator<( const GridIndex& other ) const
+{
+  if ( this->Index[ 0 ] != other.Index[ 0 ] )
+  {
+    return this->Index[ 0 ] < other.Index[ 0 ];
+  }
+  if ( this->Index[ 1 ] != other.Index[ 1 ] )
+  {
+    return this->Index[ 1 ] < other.Index[ 1 ];
+  }
+  return this->Index[ 2 ] < other.Index[ 2 ];
+}
+
+//------------------------------------------------------------------------------
+vtkStreamingSurfaceReconstruction::vtkStreamingSurfaceReconstruction()
+: VoxelSize( 2.0 )
+, NeighborhoodRadius( 6.0 )
+, OrientationReferenceValid( false )
+, Output( vtkSmartPointer< vtkPolyData >::New() )
+, NumberOfUpdatedBlocks( 0 )
+{
+  this->PointsSum[ 0 ] = 0.0;
+  this->PointsSum[ 1 ] = 0.0;
+  this->PointsSum[ 2 ] = 0.0;
+  this->OrientationReference[ 0 ] = 0.0;
+  this->OrientationReference[ 1 ] = 0.0;
+  this->OrientationReference[ 2 ] = 0.0;
+}
+
+//------------------------------------------------------------------------------
+vtkStreamingSurfaceReconstruction::~vtkStreamingSurfaceReconstruction()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+  os << indent << "VoxelSize: " << this->VoxelSize << std::endl;
+  os << indent << "NeighborhoodRadius: " << this->NeighborhoodRadius << std::endl;
+  os << indent << "NumberOfPoints: " << this->GetNumberOfPoints() << std::endl;
+  os << indent << "NumberOfBlocks: " << this->BlockMeshes.size() << std::endl;
+  os << indent << "NumberOfDirtyBlocks: " << this->DirtyBlocks.size() << std::endl;
+  os << indent << "NumberOfUpdatedBlocks: " << this->NumberOfUpdatedBlocks << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::SetVoxelSize( double voxelSize )
+{
+  if ( voxelSize <= 0.0 )
+  {
+    vtkErrorMacro( "SetVoxelSize: Voxel size must be positive. Ignoring " << voxelSize << "." );
+    return;
+  }
+  if ( voxelSize == this->VoxelSize )
+  {
+    return;
+  }
+  this->VoxelSize = voxelSize;
+  this->Reset();
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::SetNeighborhoodRadius( double radius )
+{
+  if ( radius <= 0.0 )
+  {
+    vtkErrorMacro( "SetNeighborhoodRadius: Radius must be positive. Ignoring " << radius << "." );
+    return;
+  }
+  if ( radius == this->NeighborhoodRadius )
+  {
+    return;
+  }
+  this->NeighborhoodRadius = radius;
+  this->Reset();
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::Reset()
+{
+  this->Points.clear();
+  this->PointsSum[ 0 ] = 0.0;
+  this->PointsSum[ 1 ] = 0.0;
+  this->PointsSum[ 2 ] = 0.0;
+  this->OrientationReferenceValid = false;
+  this->PointCells.clear();
+  this->TangentPlaneCenters.clear();
+  this->TangentPlaneNormals.clear();
+  this->TangentPlaneValid.clear();
+  this->BlockMeshes.clear();
+  this->DirtyBlocks.clear();
+  this->NumberOfUpdatedBlocks = 0;
+  this->Output->Initialize();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkStreamingSurfaceReconstruction::GridIndex vtkStreamingSurfaceReconstruction::GetPointCellIndex( const double position[ 3 ] )
+{
+  GridIndex cellIndex;
+  for ( int i = 0; i < 3; i++ )
+  {
+    cellIndex.Index[ i ] = ( int ) std::floor( position[ i ] / this->NeighborhoodRadius );
+  }
+  return cellIndex;
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::AddPoint( const double point[ 3 ] )
+{
+  int pointIndex = this->GetNumberOfPoints();
+
+  // The tangent planes of the points near the new one change
+  std::vector< int > neighborIndices;
+  this->FindPointsInNeighborhood( point, neighborIndices );
+  for ( std::vector< int >::iterator neighborIt = neighborIndices.begin(); neighborIt != neighborIndices.end(); ++neighborIt )
+  {
+    this->TangentPlaneValid[ *neighborIt ] = false;
+  }
+
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->Points.push_back( point[ i ] );
+    this->PointsSum[ i ] += point[ i ];
+    this->TangentPlaneCenters.push_back( 0.0 );
+    this->TangentPlaneNormals.push_back( 0.0 );
+  }
+  this->TangentPlaneValid.push_back( false );
+  this->PointCells[ this->GetPointCellIndex( point ) ].push_back( pointIndex );
+
+  this->AddDirtyBlocksAroundPoint( point );
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::AddDirtyBlocksAroundPoint( const double point[ 3 ] )
+{
+  // The signed distance changes within the radius of the new point and of the neighbors
+  // whose tangent plane changed, so the blocks within twice the radius are updated.
+  double blockSize = BLOCK_SIZE_VOXELS * this->VoxelSize;
+  GridIndex firstBlock;
+  GridIndex lastBlock;
+  for ( int i = 0; i < 3; i++ )
+  {
+    firstBlock.Index[ i ] = ( int ) std::floor( ( point[ i ] - 2.0 * this->NeighborhoodRadius ) / blockSize );
+    lastBlock.Index[ i ] = ( int ) std::floor( ( point[ i ] + 2.0 * this->NeighborhoodRadius ) / blockSize );
+  }
+  GridIndex blockIndex;
+  for ( blockIndex.Index[ 2 ] = firstBlock.Index[ 2 ]; blockIndex.Index[ 2 ] <= lastBlock.Index[ 2 ]; blockIndex.Index[ 2 ]++ )
+  {
+    for ( blockIndex.Index[ 1 ] = firstBlock.Index[ 1 ]; blockIndex.Index[ 1 ] <= lastBlock.Index[ 1 ]; blockIndex.Index[ 1 ]++ )
+    {
+      for ( blockIndex.Index[ 0 ] = firstBlock.Index[ 0 ]; blockIndex.Index[ 0 ] <= lastBlock.Index[ 0 ]; blockIndex.Index[ 0 ]++ )
+      {
+        this->DirtyBlocks.insert( blockIndex );
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::UpdateOrientationReference()
+{
+  double centroid[ 3 ] = { this->PointsSum[ 0 ], this->PointsSum[ 1 ], this->PointsSum[ 2 ] };
+  vtkMath::MultiplyScalar( centroid, 1.0 / this->GetNumberOfPoints() );
+  double blockSize = BLOCK_SIZE_VOXELS * this->VoxelSize;
+  if ( this->OrientationReferenceValid
+    && vtkMath::Distance2BetweenPoints( centroid, this->OrientationReference ) <= blockSize * blockSize )
+  {
+    return;
+  }
+  bool referenceMoved = this->OrientationReferenceValid;
+  this->OrientationReference[ 0 ] = centroid[ 0 ];
+  this->OrientationReference[ 1 ] = centroid[ 1 ];
+  this->OrientationReference[ 2 ] = centroid[ 2 ];
+  this->OrientationReferenceValid = true;
+  if ( !referenceMoved )
+  {
+    return;
+  }
+
+  // The orientation of all existing blocks (and the normals of the points without a tangent plane)
+  // may change, so everything is re-extracted. The centroid moves less and less as points are added,
+  // so this is rare.
+  std::fill( this->TangentPlaneValid.begin(), this->TangentPlaneValid.end(), false );
+  for ( int pointIndex = 0; pointIndex < this->GetNumberOfPoints(); pointIndex++ )
+  {
+    this->AddDirtyBlocksAroundPoint( &( this->Points[ 3 * pointIndex ] ) );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::GetPoint( int pointIndex, double point[ 3 ] )
+{
+  if ( pointIndex < 0 || pointIndex >= this->GetNumberOfPoints() )
+  {
+    vtkErrorMacro( "GetPoint: Invalid point index " << pointIndex << "." );
+    return;
+  }
+  point[ 0 ] = this->Points[ 3 * pointIndex ];
+  point[ 1 ] = this->Points[ 3 * pointIndex + 1 ];
+  point[ 2 ] = this->Points[ 3 * pointIndex + 2 ];
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::FindPointsInNeighborhood( const double position[ 3 ], std::vector< int >& pointIndices )
+{
+  pointIndices.clear();
+  double radius2 = this->NeighborhoodRadius * this->NeighborhoodRadius;
+  GridIndex centerCell = this->GetPointCellIndex( position );
+  GridIndex cellIndex;
+  for ( int dz = -1; dz <= 1; dz++ )
+  {
+    for ( int dy = -1; dy <= 1; dy++ )
+    {
+      for ( int dx = -1; dx <= 1; dx++ )
+      {
+        cellIndex.Index[ 0 ] = centerCell.Index[ 0 ] + dx;
+        cellIndex.Index[ 1 ] = centerCell.Index[ 1 ] + dy;
+        cellIndex.Index[ 2 ] = centerCell.Index[ 2 ] + dz;
+        std::map< GridIndex, std::vector< int > >::iterator cellIt = this->PointCells.find( cellIndex );
+        if ( cellIt == this->PointCells.end() )
+        {
+          continue;
+        }
+        for ( std::vector< int >::iterator pointIt = cellIt->second.begin(); pointIt != cellIt->second.end(); ++pointIt )
+        {
+          if ( vtkMath::Distance2BetweenPoints( position, &( this->Points[ 3 * ( *pointIt ) ] ) ) <= radius2 )
+          {
+            pointIndices.push_back( *pointIt );
+          }
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int vtkStreamingSurfaceReconstruction::FindClosestPoint( const double position[ 3 ], double& distance2 )
+{
+  int closestPointIndex = -1;
+  distance2 = this->NeighborhoodRadius * this->NeighborhoodRadius;
+  GridIndex centerCell = this->GetPointCellIndex( position );
+  GridIndex cellIndex;
+  for ( int dz = -1; dz <= 1; dz++ )
+  {
+    for ( int dy = -1; dy <= 1; dy++ )
+    {
+      for ( int dx = -1; dx <= 1; dx++ )
+      {
+        cellIndex.Index[ 0 ] = centerCell.Index[ 0 ] + dx;
+        cellIndex.Index[ 1 ] = centerCell.Index[ 1 ] + dy;
+        cellIndex.Index[ 2 ] = centerCell.Index[ 2 ] + dz;
+        std::map< GridIndex, std::vector< int > >::iterator cellIt = this->PointCells.find( cellIndex );
+        if ( cellIt == this->PointCells.end() )
+        {
+          continue;
+        }
+        for ( std::vector< int >::iterator pointIt = cellIt->second.begin(); pointIt != cellIt->second.end(); ++pointIt )
+        {
+          double pointDistance2 = vtkMath::Distance2BetweenPoints( position, &( this->Points[ 3 * ( *pointIt ) ] ) );
+          if ( pointDistance2 <= distance2 )
+          {
+            distance2 = pointDistance2;
+            closestPointIndex = *pointIt;
+          }
+        }
+      }
+    }
+  }
+  return closestPointIndex;
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::ComputeTangentPlane( int pointIndex )
+{
+  std::vector< int > neighborIndices;
+  this->FindPointsInNeighborhood( &( this->Points[ 3 * pointIndex ] ), neighborIndices );
+
+  double* center = &( this->TangentPlaneCenters[ 3 * pointIndex ] );
+  double* normal = &( this->TangentPlaneNormals[ 3 * pointIndex ] );
+  center[ 0 ] = center[ 1 ] = center[ 2 ] = 0.0;
+  for ( std::vector< int >::iterator neighborIt = neighborIndices.begin(); neighborIt != neighborIndices.end(); ++neighborIt )
+  {
+    vtkMath::Add( center, &( this->Points[ 3 * ( *neighborIt ) ] ), center );
+  }
+  vtkMath::MultiplyScalar( center, 1.0 / neighborIndices.size() ); // the point itself is always in its neighborhood
+
+  if ( neighborIndices.size() < 3 )
+  {
+    // The plane is undefined, use the direction from the orientation reference,
+    // which makes the point similar to a small sphere
+    vtkMath::Subtract( center, this->OrientationReference, normal );
+    if ( vtkMath::Normalize( normal ) == 0.0 )
+    {
+      normal[ 0 ] = 0.0;
+      normal[ 1 ] = 0.0;
+      normal[ 2 ] = 1.0;
+    }
+    this->TangentPlaneValid[ pointIndex ] = true;
+    return;
+  }
+
+  // The normal is the eigenvector of the covariance matrix with the smallest eigenvalue
+  double covariance[ 3 ][ 3 ] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+  for ( std::vector< int >::iterator neighborIt = neighborIndices.begin(); neighborIt != neighborIndices.end(); ++neighborIt )
+  {
+    double deviation[ 3 ];
+    vtkMath::Subtract( &( this->Points[ 3 * ( *neighborIt ) ] ), center, deviation );
+    for ( int row = 0; row < 3; row++ )
+    {
+      for ( int column = 0; column < 3; column++ )
+      {
+        covariance[ row ][ column ] += deviation[ row ] * deviation[ column ];
+      }
+    }
+  }
+  double* covarianceRows[ 3 ] = { covariance[ 0 ], covariance[ 1 ], covariance[ 2 ] };
+  double eigenvalues[ 3 ];
+  double eigenvectorsStorage[ 3 ][ 3 ];
+  double* eigenvectors[ 3 ] = { eigenvectorsStorage[ 0 ], eigenvectorsStorage[ 1 ], eigenvectorsStorage[ 2 ] };
+  vtkMath::Jacobi( covarianceRows, eigenvalues, eigenvectors );
+  // Eigenvalues are sorted in decreasing order, eigenvectors are the columns
+  for ( int i = 0; i < 3; i++ )
+  {
+    normal[ i ] = eigenvectors[ i ][ 2 ];
+  }
+  this->TangentPlaneValid[ pointIndex ] = true;
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::UpdateBlock( const GridIndex& blockIndex )
+{
+  const int samplesPerSide = BLOCK_SIZE_VOXELS + 1;
+  double blockSize = BLOCK_SIZE_VOXELS * this->VoxelSize;
+  double origin[ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    origin[ i ] = blockIndex.Index[ i ] * blockSize;
+  }
+
+  vtkNew< vtkImageData > distanceImage;
+  distanceImage->SetOrigin( origin );
+  distanceImage->SetSpacing( this->VoxelSize, this->VoxelSize, this->VoxelSize );
+  distanceImage->SetExtent( 0, samplesPerSide - 1, 0, samplesPerSide - 1, 0, samplesPerSide - 1 );
+  vtkNew< vtkFloatArray > distances;
+  distances->SetNumberOfTuples( samplesPerSide * samplesPerSide * samplesPerSide );
+  distanceImage->GetPointData()->SetScalars( distances.GetPointer() );
+
+  bool hasNegative = false;
+  bool hasPositive = false;
+  float* distancePtr = distances->GetPointer( 0 );
+  double position[ 3 ];
+  for ( int k = 0; k < samplesPerSide; k++ )
+  {
+    position[ 2 ] = origin[ 2 ] + k * this->VoxelSize;
+    for ( int j = 0; j < samplesPerSide; j++ )
+    {
+      position[ 1 ] = origin[ 1 ] + j * this->VoxelSize;
+      for ( int i = 0; i < samplesPerSide; i++, distancePtr++ )
+      {
+        position[ 0 ] = origin[ 0 ] + i * this->VoxelSize;
+        double closestDistance2 = 0.0;
+        int closestPointIndex = this->FindClosestPoint( position, closestDistance2 );
+        if ( closestPointIndex < 0 )
+        {
+          // Far from all points, the distance is undefined: mark it as outside
+          *distancePtr = this->NeighborhoodRadius;
+          hasPositive = true;
+          continue;
+        }
+        if ( !this->TangentPlaneValid[ closestPointIndex ] )
+        {
+          this->ComputeTangentPlane( closestPointIndex );
+        }
+        double* center = &( this->TangentPlaneCenters[ 3 * closestPointIndex ] );
+        double normal[ 3 ] = { this->TangentPlaneNormals[ 3 * closestPointIndex ],
+          this->TangentPlaneNormals[ 3 * closestPointIndex + 1 ],
+          this->TangentPlaneNormals[ 3 * closestPointIndex + 2 ] };
+        double referenceToCenter[ 3 ];
+        vtkMath::Subtract( center, this->OrientationReference, referenceToCenter );
+        if ( vtkMath::Dot( normal, referenceToCenter ) < 0.0 )
+        {
+          vtkMath::MultiplyScalar( normal, -1.0 );
+        }
+        double centerToPosition[ 3 ];
+        vtkMath::Subtract( position, center, centerToPosition );
+        float distance = ( float ) vtkMath::Dot( centerToPosition, normal );
+        *distancePtr = distance;
+        if ( distance < 0.0f )
+        {
+          hasNegative = true;
+        }
+        else
+        {
+          hasPositive = true;
+        }
+      }
+    }
+  }
+
+  if ( !hasNegative || !hasPositive )
+  {
+    // No zero crossing in this block
+    this->BlockMeshes.erase( blockIndex );
+    return;
+  }
+
+  vtkNew< vtkMarchingCubes > marchingCubes;
+  marchingCubes->SetInputData( distanceImage.GetPointer() );
+  marchingCubes->SetValue( 0, 0.0 );
+  marchingCubes->ComputeNormalsOff();
+  marchingCubes->ComputeGradientsOff();
+  marchingCubes->ComputeScalarsOff();
+  marchingCubes->Update();
+  vtkPolyData* contour = marchingCubes->GetOutput();
+
+  // The zero level continues beyond the border of the sampled surface (where the tangent planes
+  // of the outermost points are extrapolated), remove the triangles that are not near any point.
+  double maximumDistance = this->NeighborhoodRadius - this->VoxelSize;
+  double maximumDistance2 = maximumDistance * maximumDistance;
+  vtkNew< vtkCellArray > keptTriangles;
+  vtkCellArray* triangles = contour->GetPolys();
+  vtkPoints* contourPoints = contour->GetPoints();
+  vtkIdType numberOfTrianglePoints = 0;
+  vtkIdType* trianglePointIds = NULL;
+  for ( triangles->InitTraversal(); triangles->GetNextCell( numberOfTrianglePoints, trianglePointIds ); )
+  {
+    double triangleCenter[ 3 ] = { 0.0, 0.0, 0.0 };
+    for ( vtkIdType pointIndex = 0; pointIndex < numberOfTrianglePoints; pointIndex++ )
+    {
+      double trianglePoint[ 3 ];
+      contourPoints->GetPoint( trianglePointIds[ pointIndex ], trianglePoint );
+      vtkMath::Add( triangleCenter, trianglePoint, triangleCenter );
+    }
+    vtkMath::MultiplyScalar( triangleCenter, 1.0 / numberOfTrianglePoints );
+    double closestDistance2 = 0.0;
+    if ( this->FindClosestPoint( triangleCenter, closestDistance2 ) >= 0 && closestDistance2 <= maximumDistance2 )
+    {
+      keptTriangles->InsertNextCell( numberOfTrianglePoints, trianglePointIds );
+    }
+  }
+  if ( keptTriangles->GetNumberOfCells() == 0 )
+  {
+    this->BlockMeshes.erase( blockIndex );
+    return;
+  }
+
+  vtkSmartPointer< vtkPolyData > blockMesh = vtkSmartPointer< vtkPolyData >::New();
+  blockMesh->SetPoints( contourPoints ); // unused points are harmless, they are not referenced by any cell
+  blockMesh->SetPolys( keptTriangles.GetPointer() );
+  this->BlockMeshes[ blockIndex ] = blockMesh;
+}
+
+//------------------------------------------------------------------------------
+void vtkStreamingSurfaceReconstruction::Update()
+{
+  this->NumberOfUpdatedBlocks = 0;
+  if ( this->DirtyBlocks.empty() )
+  {
+    return;
+  }
+
+  this->UpdateOrientationReference();
+  for ( std::set< GridIndex >::iterator blockIt = this->DirtyBlocks.begin(); blockIt != this->DirtyBlocks.end(); ++blockIt )
+  {
+    this->UpdateBlock( *blockIt );
+    this->NumberOfUpdatedBlocks++;
+  }
+  this->DirtyBlocks.clear();
+
+  // Unchanged blocks are reused, only appending them and merging the seams is proportional to the surface size
+  vtkNew< vtkAppendPolyData > append;
+  for ( std::map< GridIndex, vtkSmartPointer< vtkPolyData > >::iterator blockIt = this->BlockMeshes.begin(); blockIt != this->BlockMeshes.end(); ++blockIt )
+  {
+    append->AddInputData( blockIt->second );
+  }
+  if ( this->BlockMeshes.empty() )
+  {
+    this->Output->Initialize();
+  }
+  else
+  {
+    // The unused points of the block meshes are removed too
+    vtkNew< vtkCleanPolyData > mergeSeams;
+    mergeSeams->SetInputConnection( append->GetOutputPort() );
+    mergeSeams->PointMergingOn();
+    mergeSeams->ToleranceIsAbsoluteOn();
+    mergeSeams->SetAbsoluteTolerance( SEAM_MERGE_TOLERANCE_VOXELS * this->VoxelSize );
+    mergeSeams->Update();
+    this->Output->ShallowCopy( mergeSeams->GetOutput() );
+  }
+  this->Output->Modified();
+  this->Modified();
+}
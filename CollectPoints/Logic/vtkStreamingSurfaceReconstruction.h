@@ -0,0 +1,142 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkStreamingSurfaceReconstruction - surface mesh from a growing point cloud
+// .SECTION Description
+// Reconstructs a surface from points sampled on it (e.g., by a tracked stylus) while
+// the points are being collected. The surface is the zero level of a signed distance
+// function that is defined by the local tangent planes of the points (Hoppe et al.,
+// "Surface reconstruction from unorganized points", SIGGRAPH 1992).
+// The distance function is only sampled in sparse blocks of voxels near the points.
+// Adding a point marks the blocks within its neighborhood dirty, and Update() only
+// re-extracts the mesh of the dirty blocks, so the cost of sampling and contouring depends
+// on the number of new points, not on the size of the point cloud. The output is then
+// reassembled from the meshes of all blocks and the points on the seams between blocks
+// are merged, which takes time proportional to the size of the surface (but it is much
+// cheaper than the extraction).
+// The tangent planes are oriented away from a reference point, which is the centroid of the
+// points when the reference was set. When the centroid moves farther than one block from
+// the reference, the reference is moved and all blocks are re-extracted, so the blocks are
+// always oriented consistently. This works best for surfaces that are seen from outside,
+// such as the skin or a bone surface.
+
+#ifndef __vtkStreamingSurfaceReconstruction_h
+#define __vtkStreamingSurfaceReconstruction_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <set>
+#include <vector>
+
+// CollectPoints includes
+#include "vtkSlicerCollectPointsModuleLogicExport.h"
+
+class VTK_SLICER_COLLECTPOINTS_MODULE_LOGIC_EXPORT vtkStreamingSurfaceReconstruction : public vtkObject
+{
+public:
+  static vtkStreamingSurfaceReconstruction* New();
+  vtkTypeMacro( vtkStreamingSurfaceReconstruction, vtkObject );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  // Size of the voxels of the signed distance function, in the coordinate system of the points.
+  // Changing it resets the reconstruction.
+  void SetVoxelSize( double voxelSize );
+  vtkGetMacro( VoxelSize, double );
+
+  // Radius of the neighborhood that defines the tangent plane at each point.
+  // It should be larger than the typical distance between neighboring points.
+  // Voxels that are farther than this from all points are not part of the surface.
+  // Changing it resets the reconstruction.
+  void SetNeighborhoodRadius( double radius );
+  vtkGetMacro( NeighborhoodRadius, double );
+
+  // Remove all points and the surface
+  void Reset();
+
+  void AddPoint( const double point[ 3 ] );
+  int GetNumberOfPoints() { return ( int )( this->Points.size() / 3 ); };
+  void GetPoint( int pointIndex, double point[ 3 ] );
+
+  // Re-extract the surface in the blocks that were affected by the points added since the last update
+  // (or in all blocks if the orientation reference moved) and reassemble the output
+  void Update();
+  // The surface mesh. The same object is updated by each Update() call.
+  vtkPolyData* GetOutput() { return this->Output; };
+
+  // Number of blocks that were re-extracted by the last Update() call
+  vtkGetMacro( NumberOfUpdatedBlocks, int );
+
+protected:
+  vtkStreamingSurfaceReconstruction();
+  ~vtkStreamingSurfaceReconstruction();
+
+private:
+  struct GridIndex
+  {
+    int Index[ 3 ];
+    bool operator<( const GridIndex& other ) const;
+  };
+
+  // Returns the index of the closest point within NeighborhoodRadius of the position, -1 if there is none
+  int FindClosestPoint( const double position[ 3 ], double& distance2 );
+  // Indices of the points within NeighborhoodRadius of the position
+  void FindPointsInNeighborhood( const double position[ 3 ], std::vector< int >& pointIndices );
+  // Compute the tangent plane center and normal (not oriented) of a point from its neighborhood
+  void ComputeTangentPlane( int pointIndex );
+  void UpdateBlock( const GridIndex& blockIndex );
+  // Mark the blocks dirty where the signed distance may change if the point or its neighbors change
+  void AddDirtyBlocksAroundPoint( const double point[ 3 ] );
+  // Move the orientation reference to the centroid if it is too far, and mark all blocks dirty then
+  void UpdateOrientationReference();
+  GridIndex GetPointCellIndex( const double position[ 3 ] );
+
+  double VoxelSize;
+  double NeighborhoodRadius;
+
+  // Points (x, y, z of each point) and their sum, for computing the centroid
+  std::vector< double > Points;
+  double PointsSum[ 3 ];
+
+  // The tangent planes of all blocks are oriented away from this point
+  double OrientationReference[ 3 ];
+  bool OrientationReferenceValid;
+
+  // Spatial hash of the points, the cell size is NeighborhoodRadius
+  std::map< GridIndex, std::vector< int > > PointCells;
+
+  // Tangent plane center and normal for each point (x, y, z of each point).
+  // They are computed when needed, and invalidated when a point is added to the neighborhood.
+  std::vector< double > TangentPlaneCenters;
+  std::vector< double > TangentPlaneNormals;
+  std::vector< bool > TangentPlaneValid;
+
+  // Surface mesh of each block that contains surface, and the blocks that need to be updated
+  std::map< GridIndex, vtkSmartPointer< vtkPolyData > > BlockMeshes;
+  std::set< GridIndex > DirtyBlocks;
+
+  vtkSmartPointer< vtkPolyData > Output;
+  int NumberOfUpdatedBlocks;
+
+  vtkStreamingSurfaceReconstruction( const vtkStreamingSurfaceReconstruction& ); // Not implemented
+  void operator=( const vtkStreamingSurfaceReconstruction& ); // Not implemented
+};
+
+#endif
@@ -35,6 +35,7 @@
 static const char* SAMPLING_TRANSFORM_REFERENCE_ROLE = "ProbeTransformNode";
 static const char* ANCHOR_TRANSFORM_REFERENCE_ROLE = "AnchorTransformNode";
 static const char* OUTPUT_REFERENCE_ROLE = "OutputNode";
+static const char* SURFACE_MODEL_REFERENCE_ROLE = "SurfaceModelNode";
 
 vtkMRMLNodeNewMacro( vtkMRMLCollectPointsNode );
 
@@ -50,9 +51,15 @@ vtkMRMLCollectPointsNode::vtkMRMLCollectPointsNode()
   this->AddNodeReferenceRole( SAMPLING_TRANSFORM_REFERENCE_ROLE, NULL, transformListEvents.GetPointer() );
   this->AddNodeReferenceRole( ANCHOR_TRANSFORM_REFERENCE_ROLE, NULL, transformListEvents.GetPointer() );
   this->AddNodeReferenceRole( OUTPUT_REFERENCE_ROLE );
+  this->AddNodeReferenceRole( SURFACE_MODEL_REFERENCE_ROLE );
   this->LabelBase = "P";
   this->NextLabelNumber = 0;
   this->MinimumDistance = 10.0;
+  this->MinimumDistanceFromAllPoints = false;
+  this->OutputUpdatesPerSecond = 0;
+  this->MarkupsDisplayDownsamplingFactor = 1;
+  this->SurfaceVoxelSize = 2.0;
+  this->SurfaceNeighborhoodRadius = 6.0;
   this->CollectMode = Manual;
 }
 
@@ -70,6 +77,9 @@ void vtkMRMLCollectPointsNode::WriteXML( ostream& of, int nIndent )
   of << indent << " LabelBase=\"" << this->LabelBase << "\"";
   of << indent << " NextLabelNumber=\"" << this->NextLabelNumber << "\"";
   of << indent << " MinimumDistance=\"" << this->MinimumDistance << "\"";
+  of << indent << " OutputUpdatesPerSecond=\"" << this->OutputUpdatesPerSecond << "\"";
+  of << indent << " MarkupsDisplayDownsamplingFactor=\"" << this->MarkupsDisplayDownsamplingFactor << "\"";
+  of << indent << " MinimumDistanceFromAllPoints=\"" << ( this->MinimumDistanceFromAllPoints ? "true" : "false" ) << "\"";
   of << indent << " CollectMode=\"" << this->GetCollectModeAsString( this->CollectMode ) << "\"";
 }
 
@@ -80,6 +90,9 @@ void vtkMRMLCollectPointsNode::PrintSelf( ostream& os, vtkIndent indent )
   os << indent << " LabelBase=\"" << this->LabelBase << "\"";
   os << indent << " NextLabelNumber=\"" << this->NextLabelNumber << "\"";
   os << indent << " MinimumDistance=\"" << this->MinimumDistance << "\"";
+  os << indent << " OutputUpdatesPerSecond=\"" << this->OutputUpdatesPerSecond << "\"";
+  os << indent << " MarkupsDisplayDownsamplingFactor=\"" << this->MarkupsDisplayDownsamplingFactor << "\"";
+  os << indent << " MinimumDistanceFromAllPoints=\"" << ( this->MinimumDistanceFromAllPoints ? "true" : "false" ) << "\"";
   os << indent << " CollectMode=\"" << this->GetCollectModeAsString(  this->CollectMode ) << "\"";
 }
 
@@ -115,6 +128,39 @@ void vtkMRMLCollectPointsNode::ReadXMLAttributes( const char** atts )
       ss >> this->MinimumDistance;
       continue;
     }
+    else if ( ! strcmp( attName, "OutputUpdatesPerSecond" ) )
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->OutputUpdatesPerSecond;
+      continue;
+    }
+    else if ( ! strcmp( attName, "MarkupsDisplayDownsamplingFactor" ) )
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->MarkupsDisplayDownsamplingFactor;
+      continue;
+    }
+    else if ( ! strcmp( attName, "SurfaceVoxelSize" ) )
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->SurfaceVoxelSize;
+      continue;
+    }
+    else if ( ! strcmp( attName, "SurfaceNeighborhoodRadius" ) )
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->SurfaceNeighborhoodRadius;
+      continue;
+    }
+    else if ( ! strcmp( attName, "MinimumDistanceFromAllPoints" ) )
+    {
+      this->MinimumDistanceFromAllPoints = ( strcmp( attValue, "true" ) ? false : true );
+      continue;
+    }
     else if ( ! strcmp( attName, "CollectMode" ) )
     {
       int modeAsInt = GetCollectModeFromString( attValue );
@@ -242,6 +288,19 @@ void vtkMRMLCollectPointsNode::SetOutputNodeID( const char* nodeID )
   this->SetAndObserveNodeReferenceID( OUTPUT_REFERENCE_ROLE, nodeID );
 }
 
+//------------------------------------------------------------------------------
+vtkMRMLModelNode* vtkMRMLCollectPointsNode::GetSurfaceModelNode()
+{
+  vtkMRMLModelNode* node = vtkMRMLModelNode::SafeDownCast( this->GetNodeReference( SURFACE_MODEL_REFERENCE_ROLE ) );
+  return node;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLCollectPointsNode::SetSurfaceModelNodeID( const char* nodeID )
+{
+  this->SetNodeReferenceID( SURFACE_MODEL_REFERENCE_ROLE, nodeID );
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLCollectPointsNode::ProcessMRMLEvents( vtkObject *caller, unsigned long event, void* callData )
 {
@@ -28,6 +28,7 @@
 #include "vtkMRMLScene.h"
 #include "vtkMRMLTransformNode.h"
 #include "vtkMRMLMarkupsFiducialNode.h"
+#include "vtkMRMLModelNode.h"
 
 // FiducialRegistrationWizard includes
 #include "vtkSlicerCollectPointsModuleMRMLExport.h"
@@ -87,6 +88,11 @@ public:
   void SetOutputNodeID( const char* nodeID );
   int GetNumberOfPointsInOutput();
 
+  // If set then a surface is reconstructed from the collected points while they are collected,
+  // and stored in this model node
+  vtkMRMLModelNode* GetSurfaceModelNode();
+  void SetSurfaceModelNodeID( const char* nodeID );
+
   vtkGetMacro(LabelBase, std::string);
   vtkSetMacro(LabelBase, std::string);
   vtkGetMacro(NextLabelNumber, int);
@@ -100,6 +106,21 @@ public:
   vtkGetMacro( MinimumDistance, double );
   vtkSetMacro( MinimumDistance, double );
 
+  vtkGetMacro( MinimumDistanceFromAllPoints, bool );
+  vtkSetMacro( MinimumDistanceFromAllPoints, bool );
+  vtkBooleanMacro( MinimumDistanceFromAllPoints, bool );
+
+  vtkGetMacro( OutputUpdatesPerSecond, int );
+  vtkSetMacro( OutputUpdatesPerSecond, int );
+
+  vtkGetMacro( MarkupsDisplayDownsamplingFactor, int );
+  vtkSetMacro( MarkupsDisplayDownsamplingFactor, int );
+
+  vtkGetMacro( SurfaceVoxelSize, double );
+  vtkSetMacro( SurfaceVoxelSize, double );
+  vtkGetMacro( SurfaceNeighborhoodRadius, double );
+  vtkSetMacro( SurfaceNeighborhoodRadius, double );
+
   void ProcessMRMLEvents( vtkObject *caller, unsigned long event, void *callData );
 
   static int GetCollectModeFromString( const char* name );
@@ -121,6 +142,32 @@ private:
   // at least this much from the previous point
   double MinimumDistance;
 
+  // For automatic CollectMode only:
+  // If true then a new point is only collected if it is at least MinimumDistance
+  // away from all previously collected points, not just from the previous point.
+  // This prevents redundant points when the probe returns to an already sampled area.
+  bool MinimumDistanceFromAllPoints;
+
+  // For automatic CollectMode only:
+  // If positive then collected points are buffered and added to the output node
+  // in batches, at most this many times per second. This avoids updating
+  // the output node and the views for each sample of a fast tracker.
+  // If 0 then each point is added to the output immediately.
+  int OutputUpdatesPerSecond;
+
+  // For markups output only:
+  // Only every Nth collected point is made visible, so that recording
+  // thousands of points does not slow down the views. All points are
+  // kept in the markups node. 1 means all points are visible.
+  int MarkupsDisplayDownsamplingFactor;
+
+  // For surface reconstruction only:
+  // Voxel size of the sampled distance function, determines the resolution of the surface.
+  // The neighborhood radius should be larger than the typical distance between neighboring
+  // points, gaps in the points that are larger than this are not closed.
+  double SurfaceVoxelSize;
+  double SurfaceNeighborhoodRadius;
+
   // Determine when new points are collected:
   // Manual - when the user clicks on "Collect"
   // Automatic - anytime the input probe transform or any of the parameters are changed
@@ -16,10 +16,12 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QTimer>
 #include <QtPlugin>
 
 // CollectPoints Logic includes
 #include <vtkSlicerCollectPointsLogic.h>
+#include <vtkSlicerTrackingTickLogic.h>
 
 // CollectPoints includes
 #include "qSlicerCollectPointsModule.h"
@@ -37,6 +39,9 @@ class qSlicerCollectPointsModulePrivate
 {
 public:
   qSlicerCollectPointsModulePrivate();
+
+  vtkSlicerCollectPointsLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
+  QTimer ProcessPendingUpdatesTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -44,6 +49,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerCollectPointsModulePrivate::qSlicerCollectPointsModulePrivate()
+: ObservedLogic(NULL)
 {
 }
 
@@ -66,6 +72,10 @@ QStringList qSlicerCollectPointsModule::categories()const
 //-----------------------------------------------------------------------------
 qSlicerCollectPointsModule::~qSlicerCollectPointsModule()
 {
+  Q_D(qSlicerCollectPointsModule);
+  disconnect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -101,7 +111,16 @@ QIcon qSlicerCollectPointsModule::icon()const
 //-----------------------------------------------------------------------------
 void qSlicerCollectPointsModule::setup()
 {
+  Q_D(qSlicerCollectPointsModule);
   this->Superclass::setup();
+
+  vtkSlicerCollectPointsLogic* collectPointsLogic = vtkSlicerCollectPointsLogic::SafeDownCast( this->logic() );
+  this->qvtkReconnect(d->ObservedLogic, collectPointsLogic, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = collectPointsLogic;
+
+  // Buffered points are added to the output on the main thread
+  d->ProcessPendingUpdatesTimer.setInterval(50);
+  connect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
 }
 
 //-----------------------------------------------------------------------------
@@ -115,3 +134,30 @@ vtkMRMLAbstractLogic* qSlicerCollectPointsModule::createLogic()
 {
   return vtkSlicerCollectPointsLogic::New();
 }
+
+//------------------------------------------------------------------------------
+void qSlicerCollectPointsModule::updatePendingUpdatesProcessing()
+{
+  Q_D(qSlicerCollectPointsModule);
+  bool pendingUpdates = (d->ObservedLogic!=NULL && d->ObservedLogic->HasPendingUpdates());
+  if (pendingUpdates && !d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.start();
+  }
+  else if (!pendingUpdates && d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.stop();
+  }
+}
+
+//------------------------------------------------------------------------------
+void qSlicerCollectPointsModule::processPendingUpdates()
+{
+  Q_D(qSlicerCollectPointsModule);
+  if (d->ObservedLogic==NULL)
+  {
+    return;
+  }
+  // Pending updates of all tracking logics are processed together, in dependency order
+  vtkSlicerTrackingTickLogic::GetInstance()->ProcessTick();
+}
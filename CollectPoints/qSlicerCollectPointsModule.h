@@ -21,6 +21,8 @@
 // SlicerQt includes
 #include "qSlicerLoadableModule.h"
 
+#include <ctkVTKObject.h>
+
 #include "qSlicerCollectPointsModuleExport.h"
 
 class qSlicerCollectPointsModulePrivate;
@@ -30,6 +32,7 @@ class Q_SLICER_QTMODULES_COLLECTPOINTS_EXPORT qSlicerCollectPointsModule :
   public qSlicerLoadableModule
 {
   Q_OBJECT
+  QVTK_OBJECT
 #ifdef Slicer_HAVE_QT5
   Q_PLUGIN_METADATA(IID "org.slicer.modules.loadable.qSlicerLoadableModule/1.0");
 #endif
@@ -58,6 +61,10 @@ public:
   /// Return the categories for the module
   virtual QStringList categories()const;
 
+public slots:
+  void updatePendingUpdatesProcessing();
+  void processPendingUpdates();
+
 protected:
 
   /// Initialize the module. Register the volumes reader/writer
@@ -0,0 +1,582 @@
+#include "vtkImageStreamRecorder.h"
+#include "vtkTransformToWorldCache.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+#include <vtkMRMLVolumeNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkPointData.h>
+#include <vtkTimerLog.h>
+#include <vtk_zlib.h>
+
+// vtksys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// Time the writer thread waits when the ring buffer is empty
+static const unsigned int WRITER_THREAD_IDLE_DELAY_MSEC = 5;
+
+// Size of the buffer that the compressed data is collected in before it is written to the file
+static const size_t COMPRESSED_BUFFER_SIZE_BYTES = 1 << 20;
+
+//----------------------------------------------------------------------------
+// zlib stream of the pixel data file. A single stream is used for all frames,
+// as MetaImage readers expect the compressed pixel data of all frames in one stream.
+class vtkImageStreamRecorder::vtkInternal
+{
+public:
+  vtkInternal()
+  : File( NULL )
+  , CompressedSizeBytes( 0 )
+  {
+    memset( &this->Stream, 0, sizeof( this->Stream ) );
+  }
+
+  // Compress the data into the file. Returns false on error.
+  bool Deflate( const unsigned char* data, size_t sizeBytes, int flush );
+
+  FILE* File;
+  z_stream Stream;
+  vtkTypeUInt64 CompressedSizeBytes;
+  std::vector< unsigned char > CompressedBuffer;
+};
+
+//----------------------------------------------------------------------------
+bool vtkImageStreamRecorder::vtkInternal::Deflate( const unsigned char* data, size_t sizeBytes, int flush )
+{
+  this->Stream.next_in = const_cast< Bytef* >( data );
+  this->Stream.avail_in = static_cast< uInt >( sizeBytes );
+  while ( true )
+  {
+    this->Stream.next_out = &( this->CompressedBuffer[ 0 ] );
+    this->Stream.avail_out = static_cast< uInt >( this->CompressedBuffer.size() );
+    int result = deflate( &this->Stream, flush );
+    if ( result == Z_STREAM_ERROR )
+    {
+      return false;
+    }
+    size_t compressedBytes = this->CompressedBuffer.size() - this->Stream.avail_out;
+    if ( compressedBytes > 0 && fwrite( &( this->CompressedBuffer[ 0 ] ), 1, compressedBytes, this->File ) != compressedBytes )
+    {
+      return false;
+    }
+    this->CompressedSizeBytes += compressedBytes;
+    // all input is consumed when the output buffer is not filled completely
+    bool done = ( flush == Z_FINISH ) ? ( result == Z_STREAM_END ) : ( this->Stream.avail_out != 0 );
+    if ( done )
+    {
+      return true;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// MetaImage element type of a VTK scalar type, NULL if the type cannot be recorded
+static const char* GetMetaElementType( int scalarType )
+{
+  switch ( scalarType )
+  {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR: return "MET_CHAR";
+    case VTK_UNSIGNED_CHAR: return "MET_UCHAR";
+    case VTK_SHORT: return "MET_SHORT";
+    case VTK_UNSIGNED_SHORT: return "MET_USHORT";
+    case VTK_INT: return "MET_INT";
+    case VTK_UNSIGNED_INT: return "MET_UINT";
+    case VTK_FLOAT: return "MET_FLOAT";
+    case VTK_DOUBLE: return "MET_DOUBLE";
+    default: return NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Field names in the header cannot contain spaces or '='
+static std::string GetFieldName( const std::string& name )
+{
+  std::string fieldName = name;
+  for ( size_t i = 0; i < fieldName.size(); i++ )
+  {
+    if ( !isalnum( static_cast< unsigned char >( fieldName[ i ] ) ) )
+    {
+      fieldName[ i ] = '_';
+    }
+  }
+  return fieldName;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkImageStreamRecorder );
+
+//------------------------------------------------------------------------------
+vtkImageStreamRecorder::vtkImageStreamRecorder()
+{
+  this->ImageModifiedCallbackCommand = vtkSmartPointer< vtkCallbackCommand >::New();
+  this->ImageModifiedCallbackCommand->SetClientData( this );
+  this->ImageModifiedCallbackCommand->SetCallback( vtkImageStreamRecorder::ImageModifiedCallback );
+  this->RingBufferSize = 64;
+  this->CompressionLevel = 1;
+  this->RingBufferWriteCount = 0;
+  this->RingBufferReadCount = 0;
+  this->NumberOfRecordedFrames = 0;
+  this->NumberOfDroppedFrames = 0;
+  this->StopRequested = 0;
+  this->WriteFailed = 0;
+  this->FrameFormatValid = false;
+  this->FrameDimensions[ 0 ] = this->FrameDimensions[ 1 ] = this->FrameDimensions[ 2 ] = 0;
+  this->ScalarType = VTK_UNSIGNED_CHAR;
+  this->NumberOfScalarComponents = 1;
+  this->StartTimeSec = 0.0;
+  this->Internal = new vtkInternal;
+  this->Threader = vtkSmartPointer< vtkMultiThreader >::New();
+  this->WriterThreadId = -1;
+  this->IJKToRASMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ToWorldMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PoseMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+}
+
+//------------------------------------------------------------------------------
+vtkImageStreamRecorder::~vtkImageStreamRecorder()
+{
+  this->StopRecording();
+  this->RemoveAllTransformStreams();
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "ImageNode: " << ( ( this->ImageNode.GetPointer() != NULL && this->ImageNode->GetID() != NULL ) ? this->ImageNode->GetID() : "(none)" ) << std::endl;
+  os << indent << "NumberOfTransformStreams: " << this->TransformStreamNodes.size() << std::endl;
+  for ( size_t streamIndex = 0; streamIndex < this->TransformStreamNames.size(); streamIndex++ )
+  {
+    os << indent << "TransformStream " << streamIndex << ": " << this->TransformStreamNames[ streamIndex ] << std::endl;
+  }
+  os << indent << "RingBufferSize: " << this->RingBufferSize << std::endl;
+  os << indent << "CompressionLevel: " << this->CompressionLevel << std::endl;
+  os << indent << "Recording: " << ( this->IsRecording() ? "yes" : "no" ) << std::endl;
+  os << indent << "FileName: " << this->HeaderFileName << std::endl;
+  os << indent << "NumberOfRecordedFrames: " << this->GetNumberOfRecordedFrames() << std::endl;
+  os << indent << "NumberOfDroppedFrames: " << this->GetNumberOfDroppedFrames() << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::SetImageNode( vtkMRMLVolumeNode* imageNode )
+{
+  if ( this->IsRecording() )
+  {
+    vtkErrorMacro( "SetImageNode failed: the image node cannot be changed while recording" );
+    return;
+  }
+  this->ImageNode = imageNode;
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLVolumeNode* vtkImageStreamRecorder::GetImageNode()
+{
+  return this->ImageNode;
+}
+
+//------------------------------------------------------------------------------
+int vtkImageStreamRecorder::AddTransformStream( vtkMRMLTransformNode* transformNode )
+{
+  if ( transformNode == NULL )
+  {
+    vtkErrorMacro( "AddTransformStream failed: invalid transform node" );
+    return -1;
+  }
+  if ( this->IsRecording() )
+  {
+    vtkErrorMacro( "AddTransformStream failed: streams cannot be added while recording" );
+    return -1;
+  }
+  this->TransformStreamNodes.push_back( transformNode );
+  this->TransformStreamNames.push_back( transformNode->GetName() ? transformNode->GetName() : "" );
+  return static_cast< int >( this->TransformStreamNodes.size() ) - 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkImageStreamRecorder::GetNumberOfTransformStreams()
+{
+  return static_cast< int >( this->TransformStreamNodes.size() );
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::RemoveAllTransformStreams()
+{
+  if ( this->IsRecording() )
+  {
+    vtkErrorMacro( "RemoveAllTransformStreams failed: streams cannot be removed while recording" );
+    return;
+  }
+  this->TransformStreamNodes.clear();
+  this->TransformStreamNames.clear();
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageStreamRecorder::SetFrameFormat( vtkImageData* image )
+{
+  int dimensions[ 3 ] = { 0, 0, 0 };
+  image->GetDimensions( dimensions );
+  if ( dimensions[ 2 ] != 1 || GetMetaElementType( image->GetScalarType() ) == NULL )
+  {
+    return false;
+  }
+  this->FrameDimensions[ 0 ] = dimensions[ 0 ];
+  this->FrameDimensions[ 1 ] = dimensions[ 1 ];
+  this->FrameDimensions[ 2 ] = dimensions[ 2 ];
+  this->ScalarType = image->GetScalarType();
+  this->NumberOfScalarComponents = image->GetNumberOfScalarComponents();
+  this->FrameFormatValid = true;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageStreamRecorder::StartRecording( const char* fileName )
+{
+  this->StopRecording();
+  if ( this->ImageNode.GetPointer() == NULL )
+  {
+    vtkErrorMacro( "StartRecording failed: no image node" );
+    return false;
+  }
+  if ( fileName == NULL || strlen( fileName ) == 0 )
+  {
+    vtkErrorMacro( "StartRecording failed: invalid file name" );
+    return false;
+  }
+  this->HeaderFileName = fileName;
+  std::string directory = vtksys::SystemTools::GetFilenamePath( this->HeaderFileName );
+  this->PixelDataFileName = ( directory.empty() ? std::string() : directory + "/" )
+    + vtksys::SystemTools::GetFilenameWithoutLastExtension( this->HeaderFileName ) + ".zraw";
+
+  this->FrameFormatValid = false;
+  vtkImageData* image = this->ImageNode->GetImageData();
+  if ( image != NULL && image->GetPointData()->GetScalars() != NULL && !this->SetFrameFormat( image ) )
+  {
+    vtkErrorMacro( "StartRecording failed: only single-slice images of basic scalar types can be recorded" );
+    return false;
+  }
+
+  this->Internal->File = fopen( this->PixelDataFileName.c_str(), "wb" );
+  if ( this->Internal->File == NULL )
+  {
+    vtkErrorMacro( "StartRecording failed: cannot create file " << this->PixelDataFileName );
+    return false;
+  }
+  memset( &this->Internal->Stream, 0, sizeof( this->Internal->Stream ) );
+  if ( deflateInit( &this->Internal->Stream, this->CompressionLevel ) != Z_OK )
+  {
+    vtkErrorMacro( "StartRecording failed: cannot initialize compression" );
+    fclose( this->Internal->File );
+    this->Internal->File = NULL;
+    return false;
+  }
+  this->Internal->CompressedSizeBytes = 0;
+  this->Internal->CompressedBuffer.resize( COMPRESSED_BUFFER_SIZE_BYTES );
+
+  // All memory used by the main thread while recording is allocated here (if the frame size is already known)
+  size_t numberOfStreams = this->TransformStreamNodes.size();
+  size_t frameSizeBytes = 0;
+  if ( this->FrameFormatValid )
+  {
+    frameSizeBytes = static_cast< size_t >( this->FrameDimensions[ 0 ] ) * this->FrameDimensions[ 1 ]
+      * this->NumberOfScalarComponents * image->GetScalarSize();
+  }
+  this->RingBuffer.resize( this->RingBufferSize );
+  for ( size_t frameIndex = 0; frameIndex < this->RingBuffer.size(); frameIndex++ )
+  {
+    this->RingBuffer[ frameIndex ].TransformToWorldMatrices.resize( 16 * numberOfStreams );
+    this->RingBuffer[ frameIndex ].TransformValid.resize( numberOfStreams );
+    this->RingBuffer[ frameIndex ].Pixels.resize( frameSizeBytes );
+  }
+  this->FrameRecords.clear();
+  this->RingBufferWriteCount = 0;
+  this->RingBufferReadCount = 0;
+  this->NumberOfRecordedFrames = 0;
+  this->NumberOfDroppedFrames = 0;
+  this->StopRequested = 0;
+  this->WriteFailed = 0;
+  this->StartTimeSec = vtkTimerLog::GetUniversalTime();
+
+  this->WriterThreadId = this->Threader->SpawnThread( ( vtkThreadFunctionType )&vtkImageStreamRecorder::WriterThreadFunction, this );
+  if ( this->WriterThreadId < 0 )
+  {
+    vtkErrorMacro( "StartRecording failed: cannot start the writer thread" );
+    deflateEnd( &this->Internal->Stream );
+    fclose( this->Internal->File );
+    this->Internal->File = NULL;
+    return false;
+  }
+
+  this->ImageNode->AddObserver( vtkMRMLVolumeNode::ImageDataModifiedEvent, this->ImageModifiedCallbackCommand );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageStreamRecorder::StopRecording()
+{
+  if ( !this->IsRecording() )
+  {
+    return false;
+  }
+  if ( this->ImageNode.GetPointer() != NULL )
+  {
+    this->ImageNode->RemoveObserver( this->ImageModifiedCallbackCommand );
+  }
+
+  // The writer thread compresses the remaining frames and finishes the compressed stream before it exits
+  this->StopRequested = 1;
+  this->Threader->TerminateThread( this->WriterThreadId ); // waits for the thread to finish
+  this->WriterThreadId = -1;
+
+  deflateEnd( &this->Internal->Stream );
+  bool success = ( fclose( this->Internal->File ) == 0 ) && !this->WriteFailed.load();
+  this->Internal->File = NULL;
+  std::vector< Frame >().swap( this->RingBuffer );
+  std::vector< unsigned char >().swap( this->Internal->CompressedBuffer );
+
+  if ( !success )
+  {
+    vtkErrorMacro( "StopRecording: failed to write " << this->PixelDataFileName );
+  }
+  if ( this->FrameRecords.empty() )
+  {
+    vtkWarningMacro( "StopRecording: no frames were recorded" );
+    std::remove( this->PixelDataFileName.c_str() );
+    return false;
+  }
+  if ( !this->WriteHeader() )
+  {
+    vtkErrorMacro( "StopRecording: failed to write " << this->HeaderFileName );
+    success = false;
+  }
+  std::vector< FrameRecord >().swap( this->FrameRecords );
+  return success;
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageStreamRecorder::IsRecording()
+{
+  return this->WriterThreadId >= 0;
+}
+
+//------------------------------------------------------------------------------
+vtkTypeInt64 vtkImageStreamRecorder::GetNumberOfRecordedFrames()
+{
+  return this->NumberOfRecordedFrames.load();
+}
+
+//------------------------------------------------------------------------------
+vtkTypeInt64 vtkImageStreamRecorder::GetNumberOfDroppedFrames()
+{
+  return this->NumberOfDroppedFrames.load();
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::ImageModifiedCallback( vtkObject* caller, unsigned long vtkNotUsed( eid ), void* clientData, void* vtkNotUsed( callData ) )
+{
+  vtkImageStreamRecorder* self = reinterpret_cast< vtkImageStreamRecorder* >( clientData );
+  if ( self == NULL || caller != self->ImageNode.GetPointer() )
+  {
+    return;
+  }
+  self->PushFrame();
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::PushFrame()
+{
+  vtkImageData* image = this->ImageNode->GetImageData();
+  if ( image == NULL || image->GetPointData()->GetScalars() == NULL )
+  {
+    return;
+  }
+  if ( !this->FrameFormatValid && !this->SetFrameFormat( image ) )
+  {
+    ++this->NumberOfDroppedFrames;
+    return;
+  }
+  int dimensions[ 3 ] = { 0, 0, 0 };
+  image->GetDimensions( dimensions );
+  if ( dimensions[ 0 ] != this->FrameDimensions[ 0 ] || dimensions[ 1 ] != this->FrameDimensions[ 1 ] || dimensions[ 2 ] != this->FrameDimensions[ 2 ]
+    || image->GetScalarType() != this->ScalarType || image->GetNumberOfScalarComponents() != this->NumberOfScalarComponents )
+  {
+    // the recording has a single frame format
+    ++this->NumberOfDroppedFrames;
+    return;
+  }
+
+  vtkTypeInt64 ringBufferSize = static_cast< vtkTypeInt64 >( this->RingBuffer.size() );
+  vtkTypeInt64 writeCount = this->RingBufferWriteCount.load();
+  if ( writeCount - this->RingBufferReadCount.load() >= ringBufferSize )
+  {
+    // the writer thread is behind, drop the frame instead of waiting
+    ++this->NumberOfDroppedFrames;
+    return;
+  }
+  Frame& frame = this->RingBuffer[ writeCount % ringBufferSize ];
+  frame.TimeSec = vtkTimerLog::GetUniversalTime();
+
+  // only allocates if the frame size was not known when the recording was started
+  size_t frameSizeBytes = static_cast< size_t >( dimensions[ 0 ] ) * dimensions[ 1 ] * this->NumberOfScalarComponents * image->GetScalarSize();
+  frame.Pixels.resize( frameSizeBytes );
+  memcpy( &( frame.Pixels[ 0 ] ), image->GetScalarPointer(), frameSizeBytes );
+
+  this->ImageNode->GetIJKToRASMatrix( this->IJKToRASMatrix );
+  frame.ImageToWorldValid = true;
+  if ( this->ImageNode->GetParentTransformNode() != NULL )
+  {
+    frame.ImageToWorldValid = vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( this->ImageNode->GetParentTransformNode(), this->ToWorldMatrix );
+    vtkMatrix4x4::Multiply4x4( this->ToWorldMatrix, this->IJKToRASMatrix, this->PoseMatrix );
+  }
+  else
+  {
+    this->PoseMatrix->DeepCopy( this->IJKToRASMatrix );
+  }
+  memcpy( frame.ImageToWorldMatrix, this->PoseMatrix->GetData(), sizeof( frame.ImageToWorldMatrix ) );
+
+  for ( size_t streamIndex = 0; streamIndex < this->TransformStreamNodes.size(); streamIndex++ )
+  {
+    vtkMRMLTransformNode* transformNode = this->TransformStreamNodes[ streamIndex ].GetPointer();
+    bool valid = ( transformNode != NULL && vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( transformNode, this->ToWorldMatrix ) );
+    frame.TransformValid[ streamIndex ] = valid;
+    if ( valid )
+    {
+      memcpy( &( frame.TransformToWorldMatrices[ 16 * streamIndex ] ), this->ToWorldMatrix->GetData(), 16 * sizeof( double ) );
+    }
+  }
+
+  // publish the frame to the writer thread (the atomic store orders the frame writes before it)
+  this->RingBufferWriteCount.store( writeCount + 1 );
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkImageStreamRecorder::WriterThreadFunction( void* ptr )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+  vtkImageStreamRecorder* self = static_cast< vtkImageStreamRecorder* >( threadInfo->UserData );
+  while ( !self->StopRequested.load() )
+  {
+    if ( self->RingBufferReadCount.load() == self->RingBufferWriteCount.load() )
+    {
+      vtksys::SystemTools::Delay( WRITER_THREAD_IDLE_DELAY_MSEC );
+      continue;
+    }
+    self->WriteFrames();
+  }
+  // the main thread does not add frames anymore
+  self->WriteFrames();
+  if ( !self->Internal->Deflate( NULL, 0, Z_FINISH ) )
+  {
+    self->WriteFailed = 1;
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+void vtkImageStreamRecorder::WriteFrames()
+{
+  vtkTypeInt64 ringBufferSize = static_cast< vtkTypeInt64 >( this->RingBuffer.size() );
+  vtkTypeInt64 readCount = this->RingBufferReadCount.load();
+  vtkTypeInt64 writeCount = this->RingBufferWriteCount.load();
+  for ( ; readCount < writeCount; ++readCount )
+  {
+    Frame& frame = this->RingBuffer[ readCount % ringBufferSize ];
+    if ( this->WriteFailed.load() || !this->Internal->Deflate( &( frame.Pixels[ 0 ] ), frame.Pixels.size(), Z_NO_FLUSH ) )
+    {
+      // the compressed stream is broken, the remaining frames cannot be recorded
+      this->WriteFailed = 1;
+      ++this->NumberOfDroppedFrames;
+    }
+    else
+    {
+      this->FrameRecords.push_back( frame );
+      ++this->NumberOfRecordedFrames;
+    }
+    // frames are large, each one is released to the main thread as soon as it is compressed
+    this->RingBufferReadCount.store( readCount + 1 );
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageStreamRecorder::WriteHeader()
+{
+  std::ofstream header( this->HeaderFileName.c_str(), std::ios::out | std::ios::trunc );
+  if ( !header )
+  {
+    return false;
+  }
+  header.precision( 12 );
+  header << "ObjectType = Image" << std::endl;
+  header << "NDims = 3" << std::endl;
+  header << "AnatomicalOrientation = RAI" << std::endl;
+  header << "BinaryData = True" << std::endl;
+#ifdef VTK_WORDS_BIGENDIAN
+  header << "BinaryDataByteOrderMSB = True" << std::endl;
+#else
+  header << "BinaryDataByteOrderMSB = False" << std::endl;
+#endif
+  header << "CenterOfRotation = 0 0 0" << std::endl;
+  header << "CompressedData = True" << std::endl;
+  header << "CompressedDataSize = " << this->Internal->CompressedSizeBytes << std::endl;
+  header << "DimSize = " << this->FrameDimensions[ 0 ] << " " << this->FrameDimensions[ 1 ] << " " << this->FrameRecords.size() << std::endl;
+  header << "ElementNumberOfChannels = " << this->NumberOfScalarComponents << std::endl;
+  header << "ElementSpacing = 1 1 1" << std::endl;
+  header << "ElementType = " << GetMetaElementType( this->ScalarType ) << std::endl;
+  header << "Kinds = domain domain list" << std::endl;
+  header << "Offset = 0 0 0" << std::endl;
+  header << "TransformMatrix = 1 0 0 0 1 0 0 0 1" << std::endl;
+
+  std::vector< std::string > streamFieldNames;
+  for ( size_t streamIndex = 0; streamIndex < this->TransformStreamNames.size(); streamIndex++ )
+  {
+    streamFieldNames.push_back( GetFieldName( this->TransformStreamNames[ streamIndex ] ) + "Transform" );
+  }
+  for ( size_t frameIndex = 0; frameIndex < this->FrameRecords.size(); frameIndex++ )
+  {
+    const FrameRecord& record = this->FrameRecords[ frameIndex ];
+    char prefix[ 32 ];
+    sprintf( prefix, "Seq_Frame%04d_", static_cast< int >( frameIndex ) );
+    header << prefix << "FrameNumber = " << frameIndex << std::endl;
+    header << prefix << "Timestamp = " << record.TimeSec - this->StartTimeSec << std::endl;
+    header << prefix << "ImageStatus = OK" << std::endl;
+    header << prefix << "ImageToReferenceTransform =";
+    for ( int i = 0; i < 16; i++ )
+    {
+      header << " " << record.ImageToWorldMatrix[ i ];
+    }
+    header << std::endl;
+    header << prefix << "ImageToReferenceTransformStatus = " << ( record.ImageToWorldValid ? "OK" : "INVALID" ) << std::endl;
+    for ( size_t streamIndex = 0; streamIndex < streamFieldNames.size(); streamIndex++ )
+    {
+      bool valid = ( record.TransformValid[ streamIndex ] != 0 );
+      header << prefix << streamFieldNames[ streamIndex ] << " =";
+      for ( int i = 0; i < 16; i++ )
+      {
+        // identity if the pose is not available
+        header << " " << ( valid ? record.TransformToWorldMatrices[ 16 * streamIndex + i ] : ( i % 5 == 0 ? 1.0 : 0.0 ) );
+      }
+      header << std::endl;
+      header << prefix << streamFieldNames[ streamIndex ] << "Status = " << ( valid ? "OK" : "INVALID" ) << std::endl;
+    }
+  }
+  // ElementDataFile must be the last field, the data file is in the same directory
+  header << "ElementDataFile = " << vtksys::SystemTools::GetFilenameName( this->PixelDataFileName ) << std::endl;
+  header.close();
+  return !header.fail();
+}
@@ -0,0 +1,160 @@
+#ifndef __vtkImageStreamRecorder_h
+#define __vtkImageStreamRecorder_h
+
+#include <vtkAtomic.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLTransformNode;
+class vtkMRMLVolumeNode;
+class vtkMultiThreader;
+
+// Records the frames of an image node (e.g., live ultrasound received through an OpenIGTLink
+// connector node) with their poses, in the Slicer process, independently of the image source.
+// Each modification of the image data is recorded as a frame, with the image-to-world transform
+// (IJK to RAS, including the parent transforms) and the to-world transforms of the added pose streams.
+// The main thread only copies the frame into a preallocated slot of a single-producer single-consumer
+// ring buffer (no locks, no allocations), a writer thread compresses the frames and writes them to the file.
+// If the ring buffer is full then frames are dropped (and counted), the main thread is never blocked.
+//
+// The recording is a sequence metafile, as written by Plus: a MetaImage header (.mhd) with the
+// per-frame fields (Seq_Frame0000_ImageToReferenceTransform, ..._Timestamp, ...), where the reference
+// coordinate system is RAS, and a zlib-compressed pixel data file (.zraw). The header is written
+// when the recording is stopped, the pixel data is streamed to the file during recording.
+// All frames must have the same size and pixel type as the first one, other frames are dropped.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkImageStreamRecorder : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkImageStreamRecorder, vtkObject );
+    static vtkImageStreamRecorder* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Image node to record. Can only be changed while not recording.
+    void SetImageNode( vtkMRMLVolumeNode* imageNode );
+    vtkMRMLVolumeNode* GetImageNode();
+
+    // Add a transform node, whose to-world transform is recorded with each frame (e.g., the tool poses).
+    // The field name in the header is the node name followed by "Transform". Returns the stream index, -1 on error.
+    // Streams can only be added while not recording.
+    int AddTransformStream( vtkMRMLTransformNode* transformNode );
+    int GetNumberOfTransformStreams();
+    void RemoveAllTransformStreams();
+
+    // Number of frames that the ring buffer between the main thread and the writer thread
+    // can hold (default: 64, i.e., about two seconds of 30 fps video).
+    // A new size is used from the next StartRecording.
+    vtkGetMacro( RingBufferSize, int );
+    vtkSetClampMacro( RingBufferSize, int, 2, 4096 );
+
+    // zlib compression level of the pixel data (default: 1, the fastest).
+    vtkGetMacro( CompressionLevel, int );
+    vtkSetClampMacro( CompressionLevel, int, 1, 9 );
+
+    // Start recording into the given header file (.mhd), the pixel data is written next to it with .zraw extension.
+    // If the image node has an image then the ring buffer is allocated for its frame size.
+    // Returns false if the files cannot be created.
+    bool StartRecording( const char* fileName );
+    // Write the remaining frames and the header, and close the files.
+    // Waits for the writer thread, which compresses at most RingBufferSize frames at this point.
+    // Returns false if the recording could not be written completely.
+    bool StopRecording();
+    bool IsRecording();
+
+    // Statistics of the current or last recording (can be called while recording)
+    // Frames written to the file
+    vtkTypeInt64 GetNumberOfRecordedFrames();
+    // Frames that did not fit in the ring buffer (writer thread too slow) or had a different size or type
+    vtkTypeInt64 GetNumberOfDroppedFrames();
+
+  protected:
+    vtkImageStreamRecorder();
+    ~vtkImageStreamRecorder();
+
+    static void ImageModifiedCallback( vtkObject* caller, unsigned long eid, void* clientData, void* callData );
+    static VTK_THREAD_RETURN_TYPE WriterThreadFunction( void* ptr );
+
+    // Called from the main thread: copy the current frame and poses into the ring buffer
+    void PushFrame();
+    // Called from the writer thread: compress the frames of the ring buffer into the file
+    void WriteFrames();
+    // Called from the main thread after the writer thread finished
+    bool WriteHeader();
+
+    // Frame properties, stored by the writer thread for the header
+    struct FrameRecord
+    {
+      double TimeSec; // universal time of the image modification
+      double ImageToWorldMatrix[ 16 ]; // row-major
+      bool ImageToWorldValid; // false if a parent transform was not linear
+      std::vector< double > TransformToWorldMatrices; // 16 values (row-major) for each transform stream
+      std::vector< char > TransformValid; // false if the transform was not linear or the node was deleted
+    };
+
+    // Ring buffer slot. The buffers are allocated when recording is started (or for the first frame).
+    struct Frame : public FrameRecord
+    {
+      std::vector< unsigned char > Pixels;
+    };
+
+  private:
+    // Set the frame format from an image. Returns false if the pixel type cannot be recorded.
+    bool SetFrameFormat( vtkImageData* image );
+
+    vtkWeakPointer< vtkMRMLVolumeNode > ImageNode;
+    std::vector< vtkWeakPointer< vtkMRMLTransformNode > > TransformStreamNodes;
+    std::vector< std::string > TransformStreamNames;
+    vtkSmartPointer< vtkCallbackCommand > ImageModifiedCallbackCommand;
+
+    int RingBufferSize;
+    int CompressionLevel;
+    std::vector< Frame > RingBuffer;
+    // Number of frames pushed by the main thread (only written by the main thread)
+    vtkAtomic< vtkTypeInt64 > RingBufferWriteCount;
+    // Number of frames taken by the writer thread (only written by the writer thread)
+    vtkAtomic< vtkTypeInt64 > RingBufferReadCount;
+    vtkAtomic< vtkTypeInt64 > NumberOfRecordedFrames;
+    vtkAtomic< vtkTypeInt64 > NumberOfDroppedFrames;
+    vtkAtomic< vtkTypeInt32 > StopRequested;
+    vtkAtomic< vtkTypeInt32 > WriteFailed;
+
+    // Format of the frames of the current recording, set from the first frame (only used by the main thread)
+    bool FrameFormatValid;
+    int FrameDimensions[ 3 ];
+    int ScalarType;
+    int NumberOfScalarComponents;
+    double StartTimeSec;
+
+    std::string HeaderFileName;
+    std::string PixelDataFileName;
+
+    // Only used by the writer thread while it is running
+    class vtkInternal;
+    vtkInternal* Internal;
+    std::vector< FrameRecord > FrameRecords;
+
+    vtkSmartPointer< vtkMultiThreader > Threader;
+    int WriterThreadId;
+
+    // Reused for getting the poses
+    vtkSmartPointer< vtkMatrix4x4 > IJKToRASMatrix;
+    vtkSmartPointer< vtkMatrix4x4 > ToWorldMatrix;
+    vtkSmartPointer< vtkMatrix4x4 > PoseMatrix;
+
+    // Not implemented:
+    vtkImageStreamRecorder( const vtkImageStreamRecorder& );
+    void operator=( const vtkImageStreamRecorder& );
+};
+
+#endif
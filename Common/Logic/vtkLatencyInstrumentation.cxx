@@ -0,0 +1,391 @@
+#include "vtkLatencyInstrumentation.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+#include <vtkMRMLVolumeNode.h>
+
+// VTK includes
+#include <vtkAbstractTransform.h>
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkStringArray.h>
+#include <vtkTable.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+// The instance is created on first use and deleted when the application exits
+static vtkSmartPointer< vtkLatencyInstrumentation > LatencyInstrumentationInstance;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkLatencyInstrumentation );
+
+//------------------------------------------------------------------------------
+vtkLatencyInstrumentation::vtkLatencyInstrumentation()
+{
+  this->Enabled = false;
+  this->SourceTimestampAttributeName = NULL;
+  this->SetSourceTimestampAttributeName( "SourceTimestamp" );
+  this->HistogramBinWidthSec = 0.005;
+  this->NumberOfHistogramBins = 40;
+  this->NodeDeletedCallbackCommand = vtkSmartPointer< vtkCallbackCommand >::New();
+  this->NodeDeletedCallbackCommand->SetClientData( this );
+  this->NodeDeletedCallbackCommand->SetCallback( vtkLatencyInstrumentation::NodeDeletedCallback );
+}
+
+//------------------------------------------------------------------------------
+vtkLatencyInstrumentation::~vtkLatencyInstrumentation()
+{
+  this->Reset();
+  this->SetSourceTimestampAttributeName( NULL );
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Enabled: " << this->Enabled << std::endl;
+  os << indent << "SourceTimestampAttributeName: " << ( this->SourceTimestampAttributeName ? this->SourceTimestampAttributeName : "(none)" ) << std::endl;
+  os << indent << "HistogramBinWidthSec: " << this->HistogramBinWidthSec << std::endl;
+  os << indent << "NumberOfHistogramBins: " << this->NumberOfHistogramBins << std::endl;
+  for ( std::vector< std::string >::iterator stageIt = this->StageNames.begin(); stageIt != this->StageNames.end(); ++stageIt )
+  {
+    os << indent << *stageIt << ": " << this->GetStageNumberOfSamples( stageIt->c_str() ) << " samples, mean "
+      << this->GetStageMeanLatencySec( stageIt->c_str() ) * 1000.0 << " ms, maximum "
+      << this->GetStageMaximumLatencySec( stageIt->c_str() ) * 1000.0 << " ms" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkLatencyInstrumentation* vtkLatencyInstrumentation::GetInstance()
+{
+  if ( LatencyInstrumentationInstance.GetPointer() == NULL )
+  {
+    LatencyInstrumentationInstance = vtkSmartPointer< vtkLatencyInstrumentation >::New();
+  }
+  return LatencyInstrumentationInstance.GetPointer();
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::SetHistogramBinWidthSec( double binWidthSec )
+{
+  if ( binWidthSec <= 0.0 || binWidthSec == this->HistogramBinWidthSec )
+  {
+    return;
+  }
+  this->HistogramBinWidthSec = binWidthSec;
+  this->Stages.clear();
+  this->StageNames.clear();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::SetNumberOfHistogramBins( int numberOfBins )
+{
+  if ( numberOfBins < 1 || numberOfBins == this->NumberOfHistogramBins )
+  {
+    return;
+  }
+  this->NumberOfHistogramBins = numberOfBins;
+  this->Stages.clear();
+  this->StageNames.clear();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::Reset()
+{
+  // deleted nodes are removed in the callback, so all nodes in the map are valid
+  for ( std::map< vtkMRMLNode*, SourceTimeInfo >::iterator sourceTimeIt = this->SourceTimes.begin(); sourceTimeIt != this->SourceTimes.end(); ++sourceTimeIt )
+  {
+    sourceTimeIt->first->RemoveObserver( this->NodeDeletedCallbackCommand );
+  }
+  this->SourceTimes.clear();
+  this->Stages.clear();
+  this->StageNames.clear();
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::NodeDeletedCallback( vtkObject* caller, unsigned long vtkNotUsed( event ), void* clientData, void* vtkNotUsed( callData ) )
+{
+  vtkLatencyInstrumentation* self = reinterpret_cast< vtkLatencyInstrumentation* >( clientData );
+  if ( self == NULL )
+  {
+    return;
+  }
+  self->SourceTimes.erase( reinterpret_cast< vtkMRMLNode* >( caller ) );
+}
+
+//------------------------------------------------------------------------------
+unsigned long vtkLatencyInstrumentation::GetContentMTime( vtkMRMLNode* node )
+{
+  unsigned long contentMTime = node->GetMTime();
+  vtkMRMLTransformNode* transformNode = vtkMRMLTransformNode::SafeDownCast( node );
+  if ( transformNode != NULL && transformNode->GetTransformToParent() != NULL )
+  {
+    contentMTime = std::max( contentMTime, transformNode->GetTransformToParent()->GetMTime() );
+  }
+  vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast( node );
+  if ( volumeNode != NULL && volumeNode->GetImageData() != NULL )
+  {
+    contentMTime = std::max( contentMTime, volumeNode->GetImageData()->GetMTime() );
+  }
+  return contentMTime;
+}
+
+//------------------------------------------------------------------------------
+bool vtkLatencyInstrumentation::GetDeviceTimestampSec( vtkMRMLNode* node, double& timestampSec )
+{
+  if ( this->SourceTimestampAttributeName == NULL )
+  {
+    return false;
+  }
+  const char* timestampString = node->GetAttribute( this->SourceTimestampAttributeName );
+  if ( timestampString == NULL || timestampString[ 0 ] == 0 )
+  {
+    return false;
+  }
+  char* end = NULL;
+  timestampSec = strtod( timestampString, &end );
+  return ( end != timestampString );
+}
+
+//------------------------------------------------------------------------------
+vtkLatencyInstrumentation::SourceTimeInfo& vtkLatencyInstrumentation::GetSourceTimeInfo( vtkMRMLNode* node )
+{
+  std::map< vtkMRMLNode*, SourceTimeInfo >::iterator sourceTimeIt = this->SourceTimes.find( node );
+  if ( sourceTimeIt != this->SourceTimes.end() )
+  {
+    return sourceTimeIt->second;
+  }
+  SourceTimeInfo& sourceTime = this->SourceTimes[ node ];
+  sourceTime.TimeSec = 0.0;
+  sourceTime.ContentMTime = 0;
+  sourceTime.AssignedToNextModification = false;
+  node->AddObserver( vtkCommand::DeleteEvent, this->NodeDeletedCallbackCommand );
+  return sourceTime;
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::SourceNodeModified( vtkMRMLNode* node )
+{
+  if ( !this->Enabled || node == NULL )
+  {
+    return;
+  }
+  double deviceTimestampSec = 0.0;
+  if ( this->GetDeviceTimestampSec( node, deviceTimestampSec ) )
+  {
+    // the device timestamp is read when the source time is requested
+    return;
+  }
+  SourceTimeInfo& sourceTime = this->GetSourceTimeInfo( node );
+  unsigned long contentMTime = vtkLatencyInstrumentation::GetContentMTime( node );
+  if ( sourceTime.AssignedToNextModification )
+  {
+    sourceTime.ContentMTime = contentMTime;
+    sourceTime.AssignedToNextModification = false;
+    return;
+  }
+  if ( sourceTime.ContentMTime == contentMTime )
+  {
+    // the same modification has been reported by another logic already
+    return;
+  }
+  sourceTime.TimeSec = vtkTimerLog::GetUniversalTime();
+  sourceTime.ContentMTime = contentMTime;
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::SetSourceTimeSec( vtkMRMLNode* node, double sourceTimeSec )
+{
+  if ( !this->Enabled || node == NULL )
+  {
+    return;
+  }
+  SourceTimeInfo& sourceTime = this->GetSourceTimeInfo( node );
+  sourceTime.TimeSec = sourceTimeSec;
+  sourceTime.AssignedToNextModification = true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkLatencyInstrumentation::GetSourceTimeSec( vtkMRMLNode* node, double& sourceTimeSec )
+{
+  if ( node == NULL )
+  {
+    return false;
+  }
+  if ( this->GetDeviceTimestampSec( node, sourceTimeSec ) )
+  {
+    return true;
+  }
+  std::map< vtkMRMLNode*, SourceTimeInfo >::iterator sourceTimeIt = this->SourceTimes.find( node );
+  if ( sourceTimeIt == this->SourceTimes.end() || sourceTimeIt->second.TimeSec <= 0.0 )
+  {
+    return false;
+  }
+  sourceTimeSec = sourceTimeIt->second.TimeSec;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::RecordStageLatency( const char* stageName, vtkMRMLNode* sourceNode )
+{
+  if ( !this->Enabled )
+  {
+    return;
+  }
+  double sourceTimeSec = 0.0;
+  if ( !this->GetSourceTimeSec( sourceNode, sourceTimeSec ) )
+  {
+    return;
+  }
+  this->RecordStageLatencySec( stageName, vtkTimerLog::GetUniversalTime() - sourceTimeSec );
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::RecordStageLatencySec( const char* stageName, double latencySec )
+{
+  if ( !this->Enabled || stageName == NULL )
+  {
+    return;
+  }
+  // clocks of the device and the computer may be slightly different
+  latencySec = std::max( 0.0, latencySec );
+
+  std::map< std::string, StageStatistics >::iterator stageIt = this->Stages.find( stageName );
+  if ( stageIt == this->Stages.end() )
+  {
+    StageStatistics newStage;
+    newStage.NumberOfSamples = 0;
+    newStage.SumSec = 0.0;
+    newStage.MaximumSec = 0.0;
+    newStage.HistogramCounts.resize( this->NumberOfHistogramBins, 0 );
+    stageIt = this->Stages.insert( std::make_pair( std::string( stageName ), newStage ) ).first;
+    this->StageNames.push_back( stageName );
+  }
+  StageStatistics& stage = stageIt->second;
+  stage.NumberOfSamples++;
+  stage.SumSec += latencySec;
+  stage.MaximumSec = std::max( stage.MaximumSec, latencySec );
+  int binIndex = std::min( static_cast< int >( latencySec / this->HistogramBinWidthSec ), this->NumberOfHistogramBins - 1 );
+  stage.HistogramCounts[ binIndex ]++;
+}
+
+//------------------------------------------------------------------------------
+int vtkLatencyInstrumentation::GetNumberOfStages()
+{
+  return static_cast< int >( this->StageNames.size() );
+}
+
+//------------------------------------------------------------------------------
+const char* vtkLatencyInstrumentation::GetNthStageName( int stageIndex )
+{
+  if ( stageIndex < 0 || stageIndex >= static_cast< int >( this->StageNames.size() ) )
+  {
+    vtkErrorMacro( "GetNthStageName: Invalid stage index " << stageIndex );
+    return NULL;
+  }
+  return this->StageNames[ stageIndex ].c_str();
+}
+
+//------------------------------------------------------------------------------
+int vtkLatencyInstrumentation::GetStageNumberOfSamples( const char* stageName )
+{
+  std::map< std::string, StageStatistics >::iterator stageIt = this->Stages.find( stageName ? stageName : "" );
+  return ( stageIt != this->Stages.end() ) ? stageIt->second.NumberOfSamples : 0;
+}
+
+//------------------------------------------------------------------------------
+double vtkLatencyInstrumentation::GetStageMeanLatencySec( const char* stageName )
+{
+  std::map< std::string, StageStatistics >::iterator stageIt = this->Stages.find( stageName ? stageName : "" );
+  if ( stageIt == this->Stages.end() || stageIt->second.NumberOfSamples == 0 )
+  {
+    return 0.0;
+  }
+  return stageIt->second.SumSec / stageIt->second.NumberOfSamples;
+}
+
+//------------------------------------------------------------------------------
+double vtkLatencyInstrumentation::GetStageMaximumLatencySec( const char* stageName )
+{
+  std::map< std::string, StageStatistics >::iterator stageIt = this->Stages.find( stageName ? stageName : "" );
+  return ( stageIt != this->Stages.end() ) ? stageIt->second.MaximumSec : 0.0;
+}
+
+//------------------------------------------------------------------------------
+int vtkLatencyInstrumentation::GetStageHistogramCount( const char* stageName, int binIndex )
+{
+  std::map< std::string, StageStatistics >::iterator stageIt = this->Stages.find( stageName ? stageName : "" );
+  if ( stageIt == this->Stages.end() || binIndex < 0 || binIndex >= static_cast< int >( stageIt->second.HistogramCounts.size() ) )
+  {
+    return 0;
+  }
+  return stageIt->second.HistogramCounts[ binIndex ];
+}
+
+//------------------------------------------------------------------------------
+void vtkLatencyInstrumentation::GetStatisticsTable( vtkTable* table )
+{
+  if ( table == NULL )
+  {
+    vtkErrorMacro( "GetStatisticsTable: Invalid table" );
+    return;
+  }
+  table->Initialize();
+
+  vtkNew< vtkStringArray > stageArray;
+  stageArray->SetName( "Stage" );
+  vtkNew< vtkIntArray > numberOfSamplesArray;
+  numberOfSamplesArray->SetName( "Samples" );
+  vtkNew< vtkDoubleArray > meanArray;
+  meanArray->SetName( "Mean (ms)" );
+  vtkNew< vtkDoubleArray > maximumArray;
+  maximumArray->SetName( "Maximum (ms)" );
+  table->AddColumn( stageArray.GetPointer() );
+  table->AddColumn( numberOfSamplesArray.GetPointer() );
+  table->AddColumn( meanArray.GetPointer() );
+  table->AddColumn( maximumArray.GetPointer() );
+
+  std::vector< vtkSmartPointer< vtkIntArray > > histogramArrays;
+  for ( int binIndex = 0; binIndex < this->NumberOfHistogramBins; binIndex++ )
+  {
+    // e.g., "5-10 ms", the last bin is ">=195 ms"
+    std::ostringstream binName;
+    if ( binIndex < this->NumberOfHistogramBins - 1 )
+    {
+      binName << binIndex * this->HistogramBinWidthSec * 1000.0 << "-" << ( binIndex + 1 ) * this->HistogramBinWidthSec * 1000.0 << " ms";
+    }
+    else
+    {
+      binName << ">=" << binIndex * this->HistogramBinWidthSec * 1000.0 << " ms";
+    }
+    vtkSmartPointer< vtkIntArray > histogramArray = vtkSmartPointer< vtkIntArray >::New();
+    histogramArray->SetName( binName.str().c_str() );
+    table->AddColumn( histogramArray );
+    histogramArrays.push_back( histogramArray );
+  }
+
+  for ( std::vector< std::string >::iterator stageIt = this->StageNames.begin(); stageIt != this->StageNames.end(); ++stageIt )
+  {
+    StageStatistics& stage = this->Stages[ *stageIt ];
+    stageArray->InsertNextValue( *stageIt );
+    numberOfSamplesArray->InsertNextValue( stage.NumberOfSamples );
+    meanArray->InsertNextValue( stage.NumberOfSamples > 0 ? stage.SumSec / stage.NumberOfSamples * 1000.0 : 0.0 );
+    maximumArray->InsertNextValue( stage.MaximumSec * 1000.0 );
+    for ( int binIndex = 0; binIndex < this->NumberOfHistogramBins; binIndex++ )
+    {
+      histogramArrays[ binIndex ]->InsertNextValue( stage.HistogramCounts[ binIndex ] );
+    }
+  }
+}
@@ -0,0 +1,131 @@
+#ifndef __vtkLatencyInstrumentation_h
+#define __vtkLatencyInstrumentation_h
+
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkMRMLNode;
+class vtkTable;
+
+// Measures the latency of the processing stages of the SlicerIGT logics.
+// Each data node that drives a computation (tracked transform, live image) has a source time:
+// the device timestamp stored in the node attribute SourceTimestampAttributeName, if it is available,
+// otherwise the time when a modification of the node was first seen by an instrumented logic.
+// Logics that compute outputs from inputs (e.g., TransformProcessor) pass the source time of their
+// inputs on to their outputs, so latencies of consumer logics are measured from the original data.
+// When a logic has processed a node it records the time elapsed since the source time for its
+// stage. The latencies are collected in a histogram for each stage.
+// Instrumentation is disabled by default, the logics skip all measurements then.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkLatencyInstrumentation : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkLatencyInstrumentation, vtkObject );
+    static vtkLatencyInstrumentation* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // The instance shared by all logics
+    static vtkLatencyInstrumentation* GetInstance();
+
+    vtkGetMacro( Enabled, bool );
+    vtkSetMacro( Enabled, bool );
+    vtkBooleanMacro( Enabled, bool );
+
+    // Name of the node attribute that contains the device timestamp of the node content
+    // (universal time, in seconds). Default is "SourceTimestamp".
+    vtkGetStringMacro( SourceTimestampAttributeName );
+    vtkSetStringMacro( SourceTimestampAttributeName );
+
+    // Width of the histogram bins (in seconds, default 0.005). The last bin contains all larger latencies.
+    // Changing the histogram settings removes all recorded latencies.
+    void SetHistogramBinWidthSec( double binWidthSec );
+    vtkGetMacro( HistogramBinWidthSec, double );
+    // Number of histogram bins (default 40)
+    void SetNumberOfHistogramBins( int numberOfBins );
+    vtkGetMacro( NumberOfHistogramBins, int );
+
+    // Call when a data node is modified. For nodes without device timestamp the current time becomes
+    // the source time of the modification, unless the same modification has been seen already.
+    void SourceNodeModified( vtkMRMLNode* node );
+    // Set the source time of the next modification of the node (e.g., an output computed from inputs)
+    void SetSourceTimeSec( vtkMRMLNode* node, double sourceTimeSec );
+    // Returns false if the source time of the node is not known
+    bool GetSourceTimeSec( vtkMRMLNode* node, double& sourceTimeSec );
+
+    // Record the latency of a stage: time elapsed since the source time of the node.
+    // Nothing is recorded if the source time of the node is not known.
+    void RecordStageLatency( const char* stageName, vtkMRMLNode* sourceNode );
+    void RecordStageLatencySec( const char* stageName, double latencySec );
+
+    // Statistics of the recorded latencies
+    int GetNumberOfStages();
+    const char* GetNthStageName( int stageIndex );
+    int GetStageNumberOfSamples( const char* stageName );
+    double GetStageMeanLatencySec( const char* stageName );
+    double GetStageMaximumLatencySec( const char* stageName );
+    // Returns the number of samples in the histogram bin
+    int GetStageHistogramCount( const char* stageName, int binIndex );
+
+    // Write the statistics of all stages to a table, one row per stage:
+    // stage name, number of samples, mean and maximum latency (ms), then the histogram bins.
+    // The table of a MRML table node can be used to display it.
+    void GetStatisticsTable( vtkTable* table );
+
+    // Remove all recorded latencies and source times
+    void Reset();
+
+  protected:
+    vtkLatencyInstrumentation();
+    ~vtkLatencyInstrumentation();
+
+    static void NodeDeletedCallback( vtkObject* caller, unsigned long event, void* clientData, void* callData );
+
+  private:
+    struct SourceTimeInfo
+    {
+      double TimeSec;
+      // Modification time of the node content that the source time belongs to
+      unsigned long ContentMTime;
+      // The source time is set for the next modification of the node
+      bool AssignedToNextModification;
+    };
+    struct StageStatistics
+    {
+      int NumberOfSamples;
+      double SumSec;
+      double MaximumSec;
+      std::vector< int > HistogramCounts;
+    };
+
+    // Modification time of the content: the transform for transform nodes, the image for volume nodes
+    static unsigned long GetContentMTime( vtkMRMLNode* node );
+    bool GetDeviceTimestampSec( vtkMRMLNode* node, double& timestampSec );
+    SourceTimeInfo& GetSourceTimeInfo( vtkMRMLNode* node );
+
+    bool Enabled;
+    char* SourceTimestampAttributeName;
+    double HistogramBinWidthSec;
+    int NumberOfHistogramBins;
+
+    std::map< vtkMRMLNode*, SourceTimeInfo > SourceTimes;
+    // Stages are listed in the order they were first recorded
+    std::vector< std::string > StageNames;
+    std::map< std::string, StageStatistics > Stages;
+
+    vtkSmartPointer< vtkCallbackCommand > NodeDeletedCallbackCommand;
+
+    // Not implemented:
+    vtkLatencyInstrumentation( const vtkLatencyInstrumentation& );
+    void operator=( const vtkLatencyInstrumentation& );
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "vtkMemoryMappedFile.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+//------------------------------------------------------------------------------
+vtkMemoryMappedFile::vtkMemoryMappedFile()
+{
+  this->Data = NULL;
+  this->SizeBytes = 0;
+  this->Writable = false;
+#ifdef _WIN32
+  this->FileHandle = INVALID_HANDLE_VALUE;
+  this->MappingHandle = NULL;
+#else
+  this->FileDescriptor = -1;
+#endif
+}
+
+//------------------------------------------------------------------------------
+vtkMemoryMappedFile::~vtkMemoryMappedFile()
+{
+  this->Close();
+}
+
+//------------------------------------------------------------------------------
+bool vtkMemoryMappedFile::Create( const char* fileName, vtkTypeUInt64 sizeBytes )
+{
+  this->Close();
+  if ( fileName == NULL || sizeBytes == 0 )
+  {
+    return false;
+  }
+#ifdef _WIN32
+  this->FileHandle = CreateFileA( fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+  if ( this->FileHandle == INVALID_HANDLE_VALUE )
+  {
+    return false;
+  }
+  this->MappingHandle = CreateFileMappingA( this->FileHandle, NULL, PAGE_READWRITE,
+    static_cast< DWORD >( sizeBytes >> 32 ), static_cast< DWORD >( sizeBytes & 0xFFFFFFFF ), NULL );
+  if ( this->MappingHandle != NULL )
+  {
+    this->Data = static_cast< char* >( MapViewOfFile( this->MappingHandle, FILE_MAP_WRITE, 0, 0, static_cast< SIZE_T >( sizeBytes ) ) );
+  }
+#else
+  this->FileDescriptor = open( fileName, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+  if ( this->FileDescriptor < 0 )
+  {
+    return false;
+  }
+  if ( ftruncate( this->FileDescriptor, static_cast< off_t >( sizeBytes ) ) == 0 )
+  {
+    void* data = mmap( NULL, static_cast< size_t >( sizeBytes ), PROT_READ | PROT_WRITE, MAP_SHARED, this->FileDescriptor, 0 );
+    if ( data != MAP_FAILED )
+    {
+      this->Data = static_cast< char* >( data );
+    }
+  }
+#endif
+  this->SizeBytes = sizeBytes;
+  this->Writable = true;
+  if ( this->Data == NULL )
+  {
+    this->Close();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkMemoryMappedFile::OpenReadOnly( const char* fileName )
+{
+  this->Close();
+  if ( fileName == NULL )
+  {
+    return false;
+  }
+#ifdef _WIN32
+  this->FileHandle = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  if ( this->FileHandle == INVALID_HANDLE_VALUE )
+  {
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if ( GetFileSizeEx( this->FileHandle, &fileSize ) && fileSize.QuadPart > 0 )
+  {
+    this->SizeBytes = static_cast< vtkTypeUInt64 >( fileSize.QuadPart );
+    this->MappingHandle = CreateFileMappingA( this->FileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( this->MappingHandle != NULL )
+    {
+      this->Data = static_cast< char* >( MapViewOfFile( this->MappingHandle, FILE_MAP_READ, 0, 0, 0 ) );
+    }
+  }
+#else
+  this->FileDescriptor = open( fileName, O_RDONLY );
+  if ( this->FileDescriptor < 0 )
+  {
+    return false;
+  }
+  struct stat fileStatus;
+  if ( fstat( this->FileDescriptor, &fileStatus ) == 0 && fileStatus.st_size > 0 )
+  {
+    this->SizeBytes = static_cast< vtkTypeUInt64 >( fileStatus.st_size );
+    void* data = mmap( NULL, static_cast< size_t >( this->SizeBytes ), PROT_READ, MAP_SHARED, this->FileDescriptor, 0 );
+    if ( data != MAP_FAILED )
+    {
+      this->Data = static_cast< char* >( data );
+    }
+  }
+#endif
+  this->Writable = false;
+  if ( this->Data == NULL )
+  {
+    this->Close();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkMemoryMappedFile::Flush()
+{
+  if ( this->Data == NULL || !this->Writable )
+  {
+    return;
+  }
+#ifdef _WIN32
+  FlushViewOfFile( this->Data, 0 );
+#else
+  msync( this->Data, static_cast< size_t >( this->SizeBytes ), MS_ASYNC );
+#endif
+}
+
+//------------------------------------------------------------------------------
+void vtkMemoryMappedFile::Close( vtkTypeUInt64 truncateSizeBytes )
+{
+  bool truncate = ( this->Writable && truncateSizeBytes < this->SizeBytes );
+#ifdef _WIN32
+  if ( this->Data != NULL )
+  {
+    UnmapViewOfFile( this->Data );
+  }
+  if ( this->MappingHandle != NULL )
+  {
+    CloseHandle( this->MappingHandle );
+  }
+  if ( this->FileHandle != INVALID_HANDLE_VALUE )
+  {
+    if ( truncate )
+    {
+      LARGE_INTEGER fileSize;
+      fileSize.QuadPart = static_cast< LONGLONG >( truncateSizeBytes );
+      if ( SetFilePointerEx( this->FileHandle, fileSize, NULL, FILE_BEGIN ) )
+      {
+        SetEndOfFile( this->FileHandle );
+      }
+    }
+    CloseHandle( this->FileHandle );
+  }
+  this->MappingHandle = NULL;
+  this->FileHandle = INVALID_HANDLE_VALUE;
+#else
+  if ( this->Data != NULL )
+  {
+    munmap( this->Data, static_cast< size_t >( this->SizeBytes ) );
+  }
+  if ( this->FileDescriptor >= 0 )
+  {
+    if ( truncate && ftruncate( this->FileDescriptor, static_cast< off_t >( truncateSizeBytes ) ) != 0 )
+    {
+      // the file keeps its preallocated size, readers use the number of records in the header
+    }
+    close( this->FileDescriptor );
+  }
+  this->FileDescriptor = -1;
+#endif
+  this->Data = NULL;
+  this->SizeBytes = 0;
+  this->Writable = false;
+}
@@ -0,0 +1,53 @@
+#ifndef __vtkMemoryMappedFile_h
+#define __vtkMemoryMappedFile_h
+
+#include <vtkType.h>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+// Maps a file into memory, for writing (the file is created with the requested size)
+// or read-only. Used by the recorders for writing from a background thread without
+// system calls, and by the readers for loading recordings without copying them.
+// This is a plain helper class of the IGTCommon library (not a vtkObject).
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkMemoryMappedFile
+{
+  public:
+    vtkMemoryMappedFile();
+    ~vtkMemoryMappedFile();
+
+    // Create (or overwrite) the file with the given size and map it for writing.
+    // Returns false on error.
+    bool Create( const char* fileName, vtkTypeUInt64 sizeBytes );
+
+    // Map an existing file read-only. Returns false on error.
+    bool OpenReadOnly( const char* fileName );
+
+    // Write the modified pages to the file. Does not wait for the write to complete.
+    void Flush();
+
+    // Unmap and close the file. If truncateSizeBytes is less than the mapped size
+    // then the file is truncated to that size (e.g., for removing the unused preallocated end of a recording).
+    void Close( vtkTypeUInt64 truncateSizeBytes = VTK_TYPE_UINT64_MAX );
+
+    bool IsOpen() { return this->Data != NULL; };
+    char* GetData() { return this->Data; };
+    vtkTypeUInt64 GetSizeBytes() { return this->SizeBytes; };
+
+  private:
+    char* Data;
+    vtkTypeUInt64 SizeBytes;
+    bool Writable;
+#ifdef _WIN32
+    void* FileHandle;
+    void* MappingHandle;
+#else
+    int FileDescriptor;
+#endif
+
+    // Not implemented:
+    vtkMemoryMappedFile( const vtkMemoryMappedFile& );
+    void operator=( const vtkMemoryMappedFile& );
+};
+
+#endif
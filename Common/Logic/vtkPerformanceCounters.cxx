@@ -0,0 +1,142 @@
+#include "vtkPerformanceCounters.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkStringArray.h>
+#include <vtkTable.h>
+
+// STD includes
+#include <algorithm>
+#include <vector>
+
+// All existing counters. Counters are created and deleted on the main thread.
+static std::vector< vtkPerformanceCounters* > PerformanceCountersInstances;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkPerformanceCounters );
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters::vtkPerformanceCounters()
+{
+  this->Name = NULL;
+  this->NumberOfEventsReceived = 0;
+  this->NumberOfUpdatesComputed = 0;
+  this->NumberOfUpdatesSkipped = 0;
+  this->TotalUpdateTimeSec = 0.0;
+  this->MaximumUpdateTimeSec = 0.0;
+  PerformanceCountersInstances.push_back( this );
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters::~vtkPerformanceCounters()
+{
+  PerformanceCountersInstances.erase( std::remove( PerformanceCountersInstances.begin(), PerformanceCountersInstances.end(), this ),
+    PerformanceCountersInstances.end() );
+  this->SetName( NULL );
+}
+
+//------------------------------------------------------------------------------
+void vtkPerformanceCounters::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Name: " << ( this->Name ? this->Name : "(none)" ) << std::endl;
+  os << indent << "NumberOfEventsReceived: " << this->NumberOfEventsReceived << std::endl;
+  os << indent << "NumberOfUpdatesComputed: " << this->NumberOfUpdatesComputed << std::endl;
+  os << indent << "NumberOfUpdatesSkipped: " << this->NumberOfUpdatesSkipped << std::endl;
+  os << indent << "TotalUpdateTimeSec: " << this->TotalUpdateTimeSec << std::endl;
+  os << indent << "MaximumUpdateTimeSec: " << this->MaximumUpdateTimeSec << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkPerformanceCounters::EndUpdate( double startTimeSec )
+{
+  double updateTimeSec = std::max( 0.0, vtkTimerLog::GetUniversalTime() - startTimeSec );
+  this->NumberOfUpdatesComputed++;
+  this->TotalUpdateTimeSec += updateTimeSec;
+  this->MaximumUpdateTimeSec = std::max( this->MaximumUpdateTimeSec, updateTimeSec );
+}
+
+//------------------------------------------------------------------------------
+double vtkPerformanceCounters::GetMeanUpdateTimeSec()
+{
+  if ( this->NumberOfUpdatesComputed == 0 )
+  {
+    return 0.0;
+  }
+  return this->TotalUpdateTimeSec / this->NumberOfUpdatesComputed;
+}
+
+//------------------------------------------------------------------------------
+void vtkPerformanceCounters::Reset()
+{
+  this->NumberOfEventsReceived = 0;
+  this->NumberOfUpdatesComputed = 0;
+  this->NumberOfUpdatesSkipped = 0;
+  this->TotalUpdateTimeSec = 0.0;
+  this->MaximumUpdateTimeSec = 0.0;
+}
+
+//------------------------------------------------------------------------------
+int vtkPerformanceCounters::GetNumberOfInstances()
+{
+  return static_cast< int >( PerformanceCountersInstances.size() );
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters* vtkPerformanceCounters::GetNthInstance( int index )
+{
+  if ( index < 0 || index >= static_cast< int >( PerformanceCountersInstances.size() ) )
+  {
+    return NULL;
+  }
+  return PerformanceCountersInstances[ index ];
+}
+
+//------------------------------------------------------------------------------
+void vtkPerformanceCounters::GetStatisticsTable( vtkTable* table )
+{
+  if ( table == NULL )
+  {
+    return;
+  }
+  table->Initialize();
+
+  vtkNew< vtkStringArray > nameArray;
+  nameArray->SetName( "Logic" );
+  vtkNew< vtkIntArray > eventsArray;
+  eventsArray->SetName( "Events received" );
+  vtkNew< vtkIntArray > computedArray;
+  computedArray->SetName( "Updates computed" );
+  vtkNew< vtkIntArray > skippedArray;
+  skippedArray->SetName( "Updates skipped" );
+  vtkNew< vtkDoubleArray > totalArray;
+  totalArray->SetName( "Total update time (ms)" );
+  vtkNew< vtkDoubleArray > meanArray;
+  meanArray->SetName( "Mean update time (ms)" );
+  vtkNew< vtkDoubleArray > maximumArray;
+  maximumArray->SetName( "Maximum update time (ms)" );
+
+  for ( std::vector< vtkPerformanceCounters* >::iterator countersIt = PerformanceCountersInstances.begin(); countersIt != PerformanceCountersInstances.end(); ++countersIt )
+  {
+    vtkPerformanceCounters* counters = *countersIt;
+    nameArray->InsertNextValue( counters->GetName() ? counters->GetName() : "" );
+    eventsArray->InsertNextValue( static_cast< int >( counters->GetNumberOfEventsReceived() ) );
+    computedArray->InsertNextValue( static_cast< int >( counters->GetNumberOfUpdatesComputed() ) );
+    skippedArray->InsertNextValue( static_cast< int >( counters->GetNumberOfUpdatesSkipped() ) );
+    totalArray->InsertNextValue( counters->GetTotalUpdateTimeSec() * 1000.0 );
+    meanArray->InsertNextValue( counters->GetMeanUpdateTimeSec() * 1000.0 );
+    maximumArray->InsertNextValue( counters->GetMaximumUpdateTimeSec() * 1000.0 );
+  }
+
+  table->AddColumn( nameArray.GetPointer() );
+  table->AddColumn( eventsArray.GetPointer() );
+  table->AddColumn( computedArray.GetPointer() );
+  table->AddColumn( skippedArray.GetPointer() );
+  table->AddColumn( totalArray.GetPointer() );
+  table->AddColumn( meanArray.GetPointer() );
+  table->AddColumn( maximumArray.GetPointer() );
+}
@@ -0,0 +1,69 @@
+#ifndef __vtkPerformanceCounters_h
+#define __vtkPerformanceCounters_h
+
+#include <vtkObject.h>
+#include <vtkTimerLog.h>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkTable;
+
+// Counters of the work done by a logic: number of received events, computed updates,
+// skipped or coalesced updates, and total and maximum time of the computed updates.
+// Counting is a few additions per update and does not invoke events, so the counters
+// are always on. The counters of all logics are listed by GetNthInstance and GetStatisticsTable,
+// e.g., to show them in a diagnostics table.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkPerformanceCounters : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkPerformanceCounters, vtkObject );
+    static vtkPerformanceCounters* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Name of the counted logic (e.g., "TransformProcessor")
+    vtkGetStringMacro( Name );
+    vtkSetStringMacro( Name );
+
+    // Counting, called by the logic
+    void EventReceived() { this->NumberOfEventsReceived++; };
+    void UpdateSkipped() { this->NumberOfUpdatesSkipped++; };
+    // Returns the start time that has to be passed to EndUpdate
+    double StartUpdate() { return vtkTimerLog::GetUniversalTime(); };
+    void EndUpdate( double startTimeSec );
+
+    vtkGetMacro( NumberOfEventsReceived, unsigned long );
+    vtkGetMacro( NumberOfUpdatesComputed, unsigned long );
+    vtkGetMacro( NumberOfUpdatesSkipped, unsigned long );
+    vtkGetMacro( TotalUpdateTimeSec, double );
+    vtkGetMacro( MaximumUpdateTimeSec, double );
+    double GetMeanUpdateTimeSec();
+
+    void Reset();
+
+    // All existing counters, in the order of creation
+    static int GetNumberOfInstances();
+    static vtkPerformanceCounters* GetNthInstance( int index );
+
+    // Write all existing counters to a table, one row per counter
+    static void GetStatisticsTable( vtkTable* table );
+
+  protected:
+    vtkPerformanceCounters();
+    ~vtkPerformanceCounters();
+
+  private:
+    char* Name;
+    unsigned long NumberOfEventsReceived;
+    unsigned long NumberOfUpdatesComputed;
+    unsigned long NumberOfUpdatesSkipped;
+    double TotalUpdateTimeSec;
+    double MaximumUpdateTimeSec;
+
+    // Not implemented:
+    vtkPerformanceCounters( const vtkPerformanceCounters& );
+    void operator=( const vtkPerformanceCounters& );
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "vtkSlicerTrackingTickLogic.h"
+
+// VTK includes
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkSmartPointer.h>
+
+// The instance is created on first use and deleted when the application exits
+static vtkSmartPointer< vtkSlicerTrackingTickLogic > TrackingTickLogicInstance;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkSlicerTrackingTickLogic );
+
+//------------------------------------------------------------------------------
+vtkSlicerTrackingTickLogic::vtkSlicerTrackingTickLogic()
+{
+  this->ProcessingTick = false;
+  this->NumberOfProcessedTicks = 0;
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerTrackingTickLogic::~vtkSlicerTrackingTickLogic()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTrackingTickLogic::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "ProcessingTick: " << this->ProcessingTick << std::endl;
+  os << indent << "NumberOfProcessedTicks: " << this->NumberOfProcessedTicks << std::endl;
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerTrackingTickLogic* vtkSlicerTrackingTickLogic::GetInstance()
+{
+  if ( TrackingTickLogicInstance.GetPointer() == NULL )
+  {
+    TrackingTickLogicInstance = vtkSmartPointer< vtkSlicerTrackingTickLogic >::New();
+  }
+  return TrackingTickLogicInstance.GetPointer();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTrackingTickLogic::ProcessTick()
+{
+  if ( this->ProcessingTick )
+  {
+    // A logic requested a tick while processing the current one (e.g., it spins the event loop).
+    // Its updates are processed by the current tick or by the next request.
+    return;
+  }
+  this->ProcessingTick = true;
+  // Observers are called in decreasing priority order: processors first, then consumers
+  this->InvokeEvent( vtkSlicerTrackingTickLogic::TrackingTickEvent );
+  this->NumberOfProcessedTicks++;
+  this->ProcessingTick = false;
+  this->InvokeEvent( vtkSlicerTrackingTickLogic::TrackingTickProcessedEvent );
+}
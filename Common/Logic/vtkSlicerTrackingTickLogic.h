@@ -0,0 +1,64 @@
+#ifndef __vtkSlicerTrackingTickLogic_h
+#define __vtkSlicerTrackingTickLogic_h
+
+#include <vtkCommand.h>
+#include <vtkMRMLAbstractLogic.h>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+// Shared "tracking tick" of the SlicerIGT logics.
+// A tracking frame (e.g., one OpenIGTLink message that updates several tools) modifies
+// many transforms at once. Logics that react to transform changes only record which of
+// their nodes became dirty and process them all together in the next tick:
+// the logics observe TrackingTickEvent of the single instance of this class, with the
+// priority of their stage, so that in each tick the processors that compute transforms
+// (e.g., TransformProcessor) run first, and the consumers of the transforms
+// (e.g., VolumeResliceDriver, CollectPoints, BreachWarning) run after them, in the same tick.
+// Modules call ProcessTick() from the event loop when their logic has pending updates.
+// If several modules request a tick at the same time, the first call processes all
+// logics and the others find nothing to do.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkSlicerTrackingTickLogic : public vtkMRMLAbstractLogic
+{
+  public:
+    vtkTypeMacro( vtkSlicerTrackingTickLogic, vtkMRMLAbstractLogic );
+    static vtkSlicerTrackingTickLogic* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // The instance shared by all logics
+    static vtkSlicerTrackingTickLogic* GetInstance();
+
+    enum Events
+    {
+      // Invoked for each tick; logics process their pending updates when they receive it
+      TrackingTickEvent = vtkCommand::UserEvent + 580,
+      // Invoked after all logics processed the tick
+      TrackingTickProcessedEvent
+    };
+
+    // Observer priorities of the processing stages (observers with higher priority are called first)
+    static float GetProcessorStagePriority() { return 1.0; };
+    static float GetConsumerStagePriority() { return 0.0; };
+
+    // Let all logics process their pending updates, processors first, then consumers.
+    // Calls made while a tick is being processed are ignored.
+    void ProcessTick();
+
+    // Number of ticks processed since the application was started
+    vtkGetMacro( NumberOfProcessedTicks, unsigned long );
+
+  protected:
+    vtkSlicerTrackingTickLogic();
+    ~vtkSlicerTrackingTickLogic();
+
+  private:
+    bool ProcessingTick;
+    unsigned long NumberOfProcessedTicks;
+
+    // Not implemented:
+    vtkSlicerTrackingTickLogic( const vtkSlicerTrackingTickLogic& );
+    void operator=( const vtkSlicerTrackingTickLogic& );
+};
+
+#endif
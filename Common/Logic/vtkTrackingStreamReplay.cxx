@@ -0,0 +1,418 @@
+#include "vtkTrackingStreamReplay.h"
+
+#include "vtkSlicerTrackingTickLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkPointData.h>
+#include <vtkTimerLog.h>
+#include <vtkTransform.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Number of different images that are generated for a synthetic image stream, samples reuse them cyclically
+static const int NUMBER_OF_SYNTHETIC_IMAGES = 8;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkTrackingStreamReplay );
+
+//------------------------------------------------------------------------------
+bool vtkTrackingStreamReplay::SampleReference::operator<( const SampleReference& other ) const
+{
+  if ( this->TimeSec != other.TimeSec )
+  {
+    return this->TimeSec < other.TimeSec;
+  }
+  if ( this->StreamIndex != other.StreamIndex )
+  {
+    return this->StreamIndex < other.StreamIndex;
+  }
+  return this->SampleIndex < other.SampleIndex;
+}
+
+//------------------------------------------------------------------------------
+vtkTrackingStreamReplay::vtkTrackingStreamReplay()
+{
+  this->RealTime = false;
+  this->SpeedFactor = 1.0;
+  this->NumberOfReplayedFrames = 0;
+  this->ReplayTimeSec = 0.0;
+  this->PoseMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+}
+
+//------------------------------------------------------------------------------
+vtkTrackingStreamReplay::~vtkTrackingStreamReplay()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfStreams: " << this->Streams.size() << std::endl;
+  os << indent << "RealTime: " << this->RealTime << std::endl;
+  os << indent << "SpeedFactor: " << this->SpeedFactor << std::endl;
+  os << indent << "NumberOfReplayedFrames: " << this->NumberOfReplayedFrames << std::endl;
+  os << indent << "ReplayTimeSec: " << this->ReplayTimeSec << std::endl;
+}
+
+//------------------------------------------------------------------------------
+int vtkTrackingStreamReplay::AddPoseStream( vtkMRMLLinearTransformNode* transformNode )
+{
+  if ( transformNode == NULL )
+  {
+    vtkErrorMacro( "AddPoseStream: Invalid transform node" );
+    return -1;
+  }
+  Stream stream;
+  stream.TransformNode = transformNode;
+  this->Streams.push_back( stream );
+  return static_cast< int >( this->Streams.size() ) - 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkTrackingStreamReplay::AddImageStream( vtkMRMLScalarVolumeNode* volumeNode )
+{
+  if ( volumeNode == NULL )
+  {
+    vtkErrorMacro( "AddImageStream: Invalid volume node" );
+    return -1;
+  }
+  Stream stream;
+  stream.VolumeNode = volumeNode;
+  this->Streams.push_back( stream );
+  return static_cast< int >( this->Streams.size() ) - 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkTrackingStreamReplay::GetNumberOfStreams()
+{
+  return static_cast< int >( this->Streams.size() );
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::RemoveAllStreams()
+{
+  this->Streams.clear();
+}
+
+//------------------------------------------------------------------------------
+bool vtkTrackingStreamReplay::IsValidStreamIndex( int streamIndex )
+{
+  return ( streamIndex >= 0 && streamIndex < static_cast< int >( this->Streams.size() ) );
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::AddPoseSample( int streamIndex, double timeSec, vtkMatrix4x4* pose )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) || this->Streams[ streamIndex ].TransformNode == NULL )
+  {
+    vtkErrorMacro( "AddPoseSample: Invalid pose stream index " << streamIndex );
+    return;
+  }
+  if ( pose == NULL )
+  {
+    vtkErrorMacro( "AddPoseSample: Invalid pose" );
+    return;
+  }
+  Stream& stream = this->Streams[ streamIndex ];
+  stream.SampleTimesSec.push_back( timeSec );
+  stream.Poses.insert( stream.Poses.end(), &( pose->Element[ 0 ][ 0 ] ), &( pose->Element[ 0 ][ 0 ] ) + 16 );
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::AddImageSample( int streamIndex, double timeSec, vtkImageData* image )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) || this->Streams[ streamIndex ].VolumeNode == NULL )
+  {
+    vtkErrorMacro( "AddImageSample: Invalid image stream index " << streamIndex );
+    return;
+  }
+  if ( image == NULL || image->GetPointData()->GetScalars() == NULL )
+  {
+    vtkErrorMacro( "AddImageSample: Invalid image" );
+    return;
+  }
+  vtkSmartPointer< vtkImageData > imageCopy = vtkSmartPointer< vtkImageData >::New();
+  imageCopy->DeepCopy( image );
+  Stream& stream = this->Streams[ streamIndex ];
+  stream.SampleTimesSec.push_back( timeSec );
+  stream.Images.push_back( imageCopy );
+}
+
+//------------------------------------------------------------------------------
+int vtkTrackingStreamReplay::GetNumberOfSamples( int streamIndex )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) )
+  {
+    return 0;
+  }
+  return static_cast< int >( this->Streams[ streamIndex ].SampleTimesSec.size() );
+}
+
+//------------------------------------------------------------------------------
+bool vtkTrackingStreamReplay::ReadPoseSamples( int streamIndex, const char* fileName )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) || this->Streams[ streamIndex ].TransformNode == NULL )
+  {
+    vtkErrorMacro( "ReadPoseSamples: Invalid pose stream index " << streamIndex );
+    return false;
+  }
+  if ( fileName == NULL )
+  {
+    vtkErrorMacro( "ReadPoseSamples: Invalid file name" );
+    return false;
+  }
+  std::ifstream file( fileName );
+  if ( !file.is_open() )
+  {
+    vtkErrorMacro( "ReadPoseSamples: Failed to open file " << fileName );
+    return false;
+  }
+  int lineNumber = 0;
+  std::string line;
+  while ( std::getline( file, line ) )
+  {
+    lineNumber++;
+    std::string::size_type firstCharacter = line.find_first_not_of( " \t\r" );
+    if ( firstCharacter == std::string::npos || line[ firstCharacter ] == '#' )
+    {
+      continue;
+    }
+    std::istringstream lineStream( line );
+    double timeSec = 0.0;
+    lineStream >> timeSec;
+    for ( int i = 0; i < 16; i++ )
+    {
+      lineStream >> this->PoseMatrix->Element[ i / 4 ][ i % 4 ];
+    }
+    if ( lineStream.fail() )
+    {
+      vtkErrorMacro( "ReadPoseSamples: Invalid sample in " << fileName << " line " << lineNumber
+        << ", expected time and 16 matrix elements" );
+      return false;
+    }
+    this->AddPoseSample( streamIndex, timeSec, this->PoseMatrix );
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::GenerateSyntheticPoseSamples( int streamIndex, double rateHz, double durationSec, double motionRadiusMm )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) || this->Streams[ streamIndex ].TransformNode == NULL )
+  {
+    vtkErrorMacro( "GenerateSyntheticPoseSamples: Invalid pose stream index " << streamIndex );
+    return;
+  }
+  if ( rateHz <= 0.0 )
+  {
+    vtkErrorMacro( "GenerateSyntheticPoseSamples: Invalid rate " << rateHz );
+    return;
+  }
+  vtkSmartPointer< vtkTransform > poseTransform = vtkSmartPointer< vtkTransform >::New();
+  int numberOfSamples = static_cast< int >( std::floor( durationSec * rateHz ) );
+  for ( int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++ )
+  {
+    double timeSec = sampleIndex / rateHz;
+    // one turn in 2 seconds, similar to a tool moved by hand
+    double angleRad = vtkMath::Pi() * timeSec;
+    poseTransform->Identity();
+    poseTransform->Translate( motionRadiusMm * cos( angleRad ), motionRadiusMm * sin( angleRad ), 0.2 * motionRadiusMm * sin( 2.0 * angleRad ) );
+    poseTransform->RotateZ( vtkMath::DegreesFromRadians( angleRad ) );
+    poseTransform->RotateX( 20.0 * sin( 3.0 * angleRad ) );
+    poseTransform->RotateY( 10.0 * cos( 5.0 * angleRad ) );
+    this->AddPoseSample( streamIndex, timeSec, poseTransform->GetMatrix() );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::GenerateSyntheticImageSamples( int streamIndex, double rateHz, double durationSec, int width, int height )
+{
+  if ( !this->IsValidStreamIndex( streamIndex ) || this->Streams[ streamIndex ].VolumeNode == NULL )
+  {
+    vtkErrorMacro( "GenerateSyntheticImageSamples: Invalid image stream index " << streamIndex );
+    return;
+  }
+  if ( rateHz <= 0.0 || width <= 0 || height <= 0 )
+  {
+    vtkErrorMacro( "GenerateSyntheticImageSamples: Invalid rate " << rateHz << " or image size " << width << "x" << height );
+    return;
+  }
+  std::vector< vtkSmartPointer< vtkImageData > > images;
+  for ( int imageIndex = 0; imageIndex < NUMBER_OF_SYNTHETIC_IMAGES; imageIndex++ )
+  {
+    vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+    image->SetDimensions( width, height, 1 );
+    image->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+    unsigned char* pixel = static_cast< unsigned char* >( image->GetScalarPointer() );
+    for ( int y = 0; y < height; y++ )
+    {
+      for ( int x = 0; x < width; x++ )
+      {
+        // diagonal stripes that move between the images
+        *( pixel++ ) = static_cast< unsigned char >( ( x + y + imageIndex * 16 ) & 0xff );
+      }
+    }
+    images.push_back( image );
+  }
+
+  Stream& stream = this->Streams[ streamIndex ];
+  int numberOfSamples = static_cast< int >( std::floor( durationSec * rateHz ) );
+  for ( int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++ )
+  {
+    stream.SampleTimesSec.push_back( sampleIndex / rateHz );
+    stream.Images.push_back( images[ sampleIndex % NUMBER_OF_SYNTHETIC_IMAGES ] );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkTrackingStreamReplay::ApplySample( const SampleReference& sample )
+{
+  Stream& stream = this->Streams[ sample.StreamIndex ];
+  if ( stream.TransformNode != NULL )
+  {
+    this->PoseMatrix->DeepCopy( &( stream.Poses[ 16 * sample.SampleIndex ] ) );
+    stream.TransformNode->SetMatrixTransformToParent( this->PoseMatrix );
+    return;
+  }
+
+  vtkImageData* sampleImage = stream.Images[ sample.SampleIndex ];
+  vtkImageData* nodeImage = stream.VolumeNode->GetImageData();
+  if ( nodeImage == NULL
+    || nodeImage->GetScalarType() != sampleImage->GetScalarType()
+    || nodeImage->GetNumberOfScalarComponents() != sampleImage->GetNumberOfScalarComponents()
+    || nodeImage->GetNumberOfPoints() != sampleImage->GetNumberOfPoints() )
+  {
+    // only the first frame of the stream allocates the image
+    vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+    image->DeepCopy( sampleImage );
+    stream.VolumeNode->SetAndObserveImageData( image );
+    return;
+  }
+  // copy the pixels into the existing image, as a live image source would do
+  memcpy( nodeImage->GetScalarPointer(), sampleImage->GetScalarPointer(),
+    static_cast< size_t >( sampleImage->GetNumberOfPoints() ) * sampleImage->GetNumberOfScalarComponents() * sampleImage->GetScalarSize() );
+  nodeImage->Modified();
+}
+
+//------------------------------------------------------------------------------
+bool vtkTrackingStreamReplay::Replay()
+{
+  this->NumberOfReplayedFrames = 0;
+  this->ReplayTimeSec = 0.0;
+  this->FrameProcessingTimesSec.clear();
+
+  std::vector< SampleReference > samples;
+  for ( int streamIndex = 0; streamIndex < static_cast< int >( this->Streams.size() ); streamIndex++ )
+  {
+    int numberOfSamples = static_cast< int >( this->Streams[ streamIndex ].SampleTimesSec.size() );
+    for ( int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++ )
+    {
+      SampleReference sample;
+      sample.TimeSec = this->Streams[ streamIndex ].SampleTimesSec[ sampleIndex ];
+      sample.StreamIndex = streamIndex;
+      sample.SampleIndex = sampleIndex;
+      samples.push_back( sample );
+    }
+  }
+  if ( samples.empty() )
+  {
+    vtkErrorMacro( "Replay: No samples to replay" );
+    return false;
+  }
+  std::sort( samples.begin(), samples.end() );
+  // so that storing the frame times does not allocate memory during the replay
+  this->FrameProcessingTimesSec.reserve( samples.size() );
+
+  vtkSlicerTrackingTickLogic* tickLogic = vtkSlicerTrackingTickLogic::GetInstance();
+  double firstSampleTimeSec = samples[ 0 ].TimeSec;
+  double replayStartTimeSec = vtkTimerLog::GetUniversalTime();
+  std::vector< SampleReference >::iterator sampleIt = samples.begin();
+  while ( sampleIt != samples.end() )
+  {
+    double frameTimeSec = sampleIt->TimeSec;
+    if ( this->RealTime )
+    {
+      double frameDueTimeSec = replayStartTimeSec + ( frameTimeSec - firstSampleTimeSec ) / this->SpeedFactor;
+      double waitTimeSec = frameDueTimeSec - vtkTimerLog::GetUniversalTime();
+      while ( waitTimeSec > 0.0 )
+      {
+        if ( waitTimeSec > 0.002 )
+        {
+          // sleep, but wake up in time to hit the due time accurately
+          vtksys::SystemTools::Delay( static_cast< unsigned int >( ( waitTimeSec - 0.001 ) * 1000.0 ) );
+        }
+        waitTimeSec = frameDueTimeSec - vtkTimerLog::GetUniversalTime();
+      }
+    }
+
+    double frameStartTimeSec = vtkTimerLog::GetUniversalTime();
+    for ( ; sampleIt != samples.end() && sampleIt->TimeSec == frameTimeSec; ++sampleIt )
+    {
+      this->ApplySample( *sampleIt );
+    }
+    tickLogic->ProcessTick();
+    this->FrameProcessingTimesSec.push_back( vtkTimerLog::GetUniversalTime() - frameStartTimeSec );
+
+    int frameIndex = this->NumberOfReplayedFrames;
+    this->NumberOfReplayedFrames++;
+    this->InvokeEvent( ReplayFrameEvent, &frameIndex );
+  }
+  this->ReplayTimeSec = vtkTimerLog::GetUniversalTime() - replayStartTimeSec;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+double vtkTrackingStreamReplay::GetFramesPerSec()
+{
+  if ( this->ReplayTimeSec <= 0.0 )
+  {
+    return 0.0;
+  }
+  return this->NumberOfReplayedFrames / this->ReplayTimeSec;
+}
+
+//------------------------------------------------------------------------------
+double vtkTrackingStreamReplay::GetMeanFrameProcessingTimeSec()
+{
+  if ( this->FrameProcessingTimesSec.empty() )
+  {
+    return 0.0;
+  }
+  double sumSec = 0.0;
+  for ( std::vector< double >::iterator timeIt = this->FrameProcessingTimesSec.begin(); timeIt != this->FrameProcessingTimesSec.end(); ++timeIt )
+  {
+    sumSec += ( *timeIt );
+  }
+  return sumSec / this->FrameProcessingTimesSec.size();
+}
+
+//------------------------------------------------------------------------------
+double vtkTrackingStreamReplay::GetFrameProcessingTimePercentileSec( double percentile )
+{
+  if ( this->FrameProcessingTimesSec.empty() )
+  {
+    return 0.0;
+  }
+  std::vector< double > sortedTimesSec = this->FrameProcessingTimesSec;
+  std::sort( sortedTimesSec.begin(), sortedTimesSec.end() );
+  int index = static_cast< int >( std::ceil( percentile / 100.0 * sortedTimesSec.size() ) ) - 1;
+  index = std::max( 0, std::min( static_cast< int >( sortedTimesSec.size() ) - 1, index ) );
+  return sortedTimesSec[ index ];
+}
@@ -0,0 +1,128 @@
+#ifndef __vtkTrackingStreamReplay_h
+#define __vtkTrackingStreamReplay_h
+
+#include <vtkCommand.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLLinearTransformNode;
+class vtkMRMLScalarVolumeNode;
+
+// Replays pose and image streams into the nodes of a MRML scene, for measuring the
+// performance of the logics on realistic load without tracking hardware.
+// Each stream updates one node (a linear transform node for poses, a scalar volume node
+// for images). Samples can be added one by one (e.g., from a recording), read from a file,
+// or generated (deterministic synthetic motion and images).
+// Samples of all streams are replayed in time order. Samples that have the same time are
+// one tracking frame: they are all applied, then the shared tracking tick is processed
+// (see vtkSlicerTrackingTickLogic), as the event loop of the application would do, and
+// ReplayFrameEvent is invoked.
+// Frames are replayed either in real time (optionally sped up) or as fast as possible.
+// Applying a sample does not allocate memory, so the measured allocations are those of the logics.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkTrackingStreamReplay : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkTrackingStreamReplay, vtkObject );
+    static vtkTrackingStreamReplay* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    enum Events
+    {
+      // Invoked after each frame is applied and the tracking tick is processed.
+      // Call data is a pointer to the frame index (int).
+      ReplayFrameEvent = vtkCommand::UserEvent + 590
+    };
+
+    // Add a stream. Returns the index of the stream.
+    int AddPoseStream( vtkMRMLLinearTransformNode* transformNode );
+    int AddImageStream( vtkMRMLScalarVolumeNode* volumeNode );
+    int GetNumberOfStreams();
+    void RemoveAllStreams();
+
+    // Add a sample to the stream. Time is in seconds, relative to the start of the replay.
+    // The pose or image is copied.
+    void AddPoseSample( int streamIndex, double timeSec, vtkMatrix4x4* pose );
+    void AddImageSample( int streamIndex, double timeSec, vtkImageData* image );
+    int GetNumberOfSamples( int streamIndex );
+
+    // Read pose samples from a text file. Each line contains a time (in seconds) and
+    // the 16 elements of the pose matrix in row-major order, separated by whitespace.
+    // Empty lines and lines starting with # are ignored. Returns false on error.
+    bool ReadPoseSamples( int streamIndex, const char* fileName );
+
+    // Generate samples at the given rate. Poses follow a smooth path (circular motion
+    // with radius motionRadiusMm and rotation around all axes); images are a pattern
+    // that changes in every frame. The same parameters always generate the same samples.
+    void GenerateSyntheticPoseSamples( int streamIndex, double rateHz, double durationSec, double motionRadiusMm = 50.0 );
+    void GenerateSyntheticImageSamples( int streamIndex, double rateHz, double durationSec, int width, int height );
+
+    // If enabled then the frames are replayed at the time of their samples (divided by the speed factor),
+    // otherwise as fast as possible (default).
+    vtkGetMacro( RealTime, bool );
+    vtkSetMacro( RealTime, bool );
+    vtkBooleanMacro( RealTime, bool );
+    vtkGetMacro( SpeedFactor, double );
+    vtkSetClampMacro( SpeedFactor, double, 0.01, 100.0 );
+
+    // Replay all samples. Returns false if there are no samples.
+    bool Replay();
+
+    // Statistics of the last replay
+    vtkGetMacro( NumberOfReplayedFrames, int );
+    vtkGetMacro( ReplayTimeSec, double );
+    double GetFramesPerSec();
+    // Time spent in applying a frame and processing the tracking tick
+    double GetMeanFrameProcessingTimeSec();
+    double GetFrameProcessingTimePercentileSec( double percentile );
+
+  protected:
+    vtkTrackingStreamReplay();
+    ~vtkTrackingStreamReplay();
+
+  private:
+    struct Stream
+    {
+      vtkSmartPointer< vtkMRMLLinearTransformNode > TransformNode;
+      vtkSmartPointer< vtkMRMLScalarVolumeNode > VolumeNode;
+      std::vector< double > SampleTimesSec;
+      std::vector< double > Poses; // 16 elements per pose sample
+      std::vector< vtkSmartPointer< vtkImageData > > Images; // one per image sample, may be shared between samples
+    };
+    struct SampleReference
+    {
+      double TimeSec;
+      int StreamIndex;
+      int SampleIndex;
+      bool operator<( const SampleReference& other ) const;
+    };
+
+    bool IsValidStreamIndex( int streamIndex );
+    void ApplySample( const SampleReference& sample );
+
+    std::vector< Stream > Streams;
+
+    bool RealTime;
+    double SpeedFactor;
+
+    int NumberOfReplayedFrames;
+    double ReplayTimeSec;
+    std::vector< double > FrameProcessingTimesSec;
+
+    // Reused for applying pose samples
+    vtkSmartPointer< vtkMatrix4x4 > PoseMatrix;
+
+    // Not implemented:
+    vtkTrackingStreamReplay( const vtkTrackingStreamReplay& );
+    void operator=( const vtkTrackingStreamReplay& );
+};
+
+#endif
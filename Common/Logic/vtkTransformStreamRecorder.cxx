@@ -0,0 +1,309 @@
+#include "vtkTransformStreamRecorder.h"
+#include "vtkLatencyInstrumentation.h"
+#include "vtkMemoryMappedFile.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkTimerLog.h>
+
+// vtksys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cstring>
+
+static const char RECORDING_MAGIC[ 8 ] = { 'I', 'G', 'T', 'P', 'O', 'S', 'E', 'S' };
+
+// Time the writer thread waits when the ring buffer is empty
+static const unsigned int WRITER_THREAD_IDLE_DELAY_MSEC = 5;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkTransformStreamRecorder );
+
+//------------------------------------------------------------------------------
+vtkTransformStreamRecorder::vtkTransformStreamRecorder()
+{
+  this->TransformModifiedCallbackCommand = vtkSmartPointer< vtkCallbackCommand >::New();
+  this->TransformModifiedCallbackCommand->SetClientData( this );
+  this->TransformModifiedCallbackCommand->SetCallback( vtkTransformStreamRecorder::TransformModifiedCallback );
+  this->RingBufferSize = 4096;
+  this->RingBufferWriteCount = 0;
+  this->RingBufferReadCount = 0;
+  this->NumberOfRecordedSamples = 0;
+  this->NumberOfDroppedSamples = 0;
+  this->StopRequested = 0;
+  this->File = new vtkMemoryMappedFile;
+  this->MaximumNumberOfRecords = 0;
+  this->Threader = vtkSmartPointer< vtkMultiThreader >::New();
+  this->WriterThreadId = -1;
+  this->PoseMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+}
+
+//------------------------------------------------------------------------------
+vtkTransformStreamRecorder::~vtkTransformStreamRecorder()
+{
+  this->StopRecording();
+  this->RemoveAllStreams();
+  delete this->File;
+  this->File = NULL;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfStreams: " << this->StreamNodes.size() << std::endl;
+  for ( size_t streamIndex = 0; streamIndex < this->StreamNames.size(); streamIndex++ )
+  {
+    os << indent << "Stream " << streamIndex << ": " << this->StreamNames[ streamIndex ] << std::endl;
+  }
+  os << indent << "RingBufferSize: " << this->RingBufferSize << std::endl;
+  os << indent << "Recording: " << ( this->IsRecording() ? "yes" : "no" ) << std::endl;
+  os << indent << "MaximumNumberOfRecords: " << this->MaximumNumberOfRecords << std::endl;
+  os << indent << "NumberOfRecordedSamples: " << this->GetNumberOfRecordedSamples() << std::endl;
+  os << indent << "NumberOfDroppedSamples: " << this->GetNumberOfDroppedSamples() << std::endl;
+}
+
+//------------------------------------------------------------------------------
+int vtkTransformStreamRecorder::AddStream( vtkMRMLTransformNode* transformNode )
+{
+  if ( transformNode == NULL )
+  {
+    vtkErrorMacro( "AddStream failed: invalid transform node" );
+    return -1;
+  }
+  if ( this->IsRecording() )
+  {
+    vtkErrorMacro( "AddStream failed: streams cannot be added while recording" );
+    return -1;
+  }
+  if ( this->StreamNodes.size() >= MAXIMUM_NUMBER_OF_STREAMS )
+  {
+    vtkErrorMacro( "AddStream failed: maximum number of streams (" << MAXIMUM_NUMBER_OF_STREAMS << ") reached" );
+    return -1;
+  }
+  this->StreamNodes.push_back( transformNode );
+  this->StreamNames.push_back( transformNode->GetName() ? transformNode->GetName() : "" );
+  return static_cast< int >( this->StreamNodes.size() ) - 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkTransformStreamRecorder::GetNumberOfStreams()
+{
+  return static_cast< int >( this->StreamNodes.size() );
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::RemoveAllStreams()
+{
+  if ( this->IsRecording() )
+  {
+    vtkErrorMacro( "RemoveAllStreams failed: streams cannot be removed while recording" );
+    return;
+  }
+  this->StreamNodes.clear();
+  this->StreamNames.clear();
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformStreamRecorder::StartRecording( const char* fileName, vtkTypeUInt64 maximumNumberOfRecords )
+{
+  this->StopRecording();
+  if ( maximumNumberOfRecords == 0 )
+  {
+    vtkErrorMacro( "StartRecording failed: maximum number of records must be positive" );
+    return false;
+  }
+  vtkTypeUInt64 fileSizeBytes = HEADER_SIZE_BYTES + maximumNumberOfRecords * sizeof( Record );
+  if ( !this->File->Create( fileName, fileSizeBytes ) )
+  {
+    vtkErrorMacro( "StartRecording failed: cannot create file " << ( fileName ? fileName : "(none)" ) << " of size " << fileSizeBytes << " bytes" );
+    return false;
+  }
+  this->MaximumNumberOfRecords = maximumNumberOfRecords;
+
+  FileHeader* header = reinterpret_cast< FileHeader* >( this->File->GetData() );
+  memset( header, 0, HEADER_SIZE_BYTES );
+  memcpy( header->Magic, RECORDING_MAGIC, sizeof( header->Magic ) );
+  header->Version = FILE_FORMAT_VERSION;
+  header->RecordSizeBytes = sizeof( Record );
+  header->NumberOfStreams = static_cast< vtkTypeUInt32 >( this->StreamNodes.size() );
+  header->MaximumNumberOfRecords = maximumNumberOfRecords;
+  header->NumberOfRecords = 0;
+  header->StartTimeSec = vtkTimerLog::GetUniversalTime();
+  for ( size_t streamIndex = 0; streamIndex < this->StreamNames.size(); streamIndex++ )
+  {
+    // the name is truncated if needed, the last character always remains 0
+    strncpy( header->StreamNames[ streamIndex ], this->StreamNames[ streamIndex ].c_str(), STREAM_NAME_LENGTH - 1 );
+  }
+
+  // All memory used by the main thread while recording is allocated here
+  this->RingBuffer.resize( this->RingBufferSize );
+  this->RingBufferWriteCount = 0;
+  this->RingBufferReadCount = 0;
+  this->NumberOfRecordedSamples = 0;
+  this->NumberOfDroppedSamples = 0;
+  this->StopRequested = 0;
+
+  this->WriterThreadId = this->Threader->SpawnThread( ( vtkThreadFunctionType )&vtkTransformStreamRecorder::WriterThreadFunction, this );
+  if ( this->WriterThreadId < 0 )
+  {
+    vtkErrorMacro( "StartRecording failed: cannot start the writer thread" );
+    this->File->Close();
+    return false;
+  }
+
+  for ( size_t streamIndex = 0; streamIndex < this->StreamNodes.size(); streamIndex++ )
+  {
+    if ( this->StreamNodes[ streamIndex ].GetPointer() != NULL )
+    {
+      this->StreamNodes[ streamIndex ]->AddObserver( vtkMRMLTransformableNode::TransformModifiedEvent, this->TransformModifiedCallbackCommand );
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::StopRecording()
+{
+  if ( !this->IsRecording() )
+  {
+    return;
+  }
+  for ( size_t streamIndex = 0; streamIndex < this->StreamNodes.size(); streamIndex++ )
+  {
+    if ( this->StreamNodes[ streamIndex ].GetPointer() != NULL )
+    {
+      this->StreamNodes[ streamIndex ]->RemoveObserver( this->TransformModifiedCallbackCommand );
+    }
+  }
+
+  // The writer thread writes the remaining records before it exits
+  this->StopRequested = 1;
+  this->Threader->TerminateThread( this->WriterThreadId ); // waits for the thread to finish
+  this->WriterThreadId = -1;
+
+  FileHeader* header = reinterpret_cast< FileHeader* >( this->File->GetData() );
+  vtkTypeUInt64 usedSizeBytes = HEADER_SIZE_BYTES + header->NumberOfRecords * sizeof( Record );
+  this->File->Close( usedSizeBytes );
+  std::vector< Record >().swap( this->RingBuffer );
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformStreamRecorder::IsRecording()
+{
+  return this->WriterThreadId >= 0;
+}
+
+//------------------------------------------------------------------------------
+vtkTypeInt64 vtkTransformStreamRecorder::GetNumberOfRecordedSamples()
+{
+  return this->NumberOfRecordedSamples.load();
+}
+
+//------------------------------------------------------------------------------
+vtkTypeInt64 vtkTransformStreamRecorder::GetNumberOfDroppedSamples()
+{
+  return this->NumberOfDroppedSamples.load();
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::TransformModifiedCallback( vtkObject* caller, unsigned long vtkNotUsed( eid ), void* clientData, void* vtkNotUsed( callData ) )
+{
+  vtkTransformStreamRecorder* self = reinterpret_cast< vtkTransformStreamRecorder* >( clientData );
+  if ( self == NULL )
+  {
+    return;
+  }
+  // There are only a few streams, a linear search is faster than a map lookup
+  for ( size_t streamIndex = 0; streamIndex < self->StreamNodes.size(); streamIndex++ )
+  {
+    if ( self->StreamNodes[ streamIndex ].GetPointer() == caller )
+    {
+      self->PushSample( static_cast< int >( streamIndex ) );
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::PushSample( int streamIndex )
+{
+  vtkMRMLTransformNode* transformNode = this->StreamNodes[ streamIndex ].GetPointer();
+  if ( transformNode == NULL || !transformNode->GetMatrixTransformToParent( this->PoseMatrix ) )
+  {
+    // deleted node or non-linear transform
+    return;
+  }
+  vtkTypeInt64 ringBufferSize = static_cast< vtkTypeInt64 >( this->RingBuffer.size() );
+  vtkTypeInt64 writeCount = this->RingBufferWriteCount.load();
+  if ( writeCount - this->RingBufferReadCount.load() >= ringBufferSize )
+  {
+    // the writer thread is behind, drop the sample instead of waiting
+    ++this->NumberOfDroppedSamples;
+    return;
+  }
+  Record& record = this->RingBuffer[ writeCount % ringBufferSize ];
+  record.TimeSec = vtkTimerLog::GetUniversalTime();
+  if ( !vtkLatencyInstrumentation::GetInstance()->GetSourceTimeSec( transformNode, record.SourceTimeSec ) )
+  {
+    record.SourceTimeSec = -1.0;
+  }
+  record.StreamIndex = streamIndex;
+  record.Reserved = 0;
+  memcpy( record.Matrix, this->PoseMatrix->GetData(), sizeof( record.Matrix ) );
+  // publish the record to the writer thread (the atomic store orders the record writes before it)
+  this->RingBufferWriteCount.store( writeCount + 1 );
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkTransformStreamRecorder::WriterThreadFunction( void* ptr )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+  vtkTransformStreamRecorder* self = static_cast< vtkTransformStreamRecorder* >( threadInfo->UserData );
+  while ( !self->StopRequested.load() )
+  {
+    if ( self->RingBufferReadCount.load() == self->RingBufferWriteCount.load() )
+    {
+      vtksys::SystemTools::Delay( WRITER_THREAD_IDLE_DELAY_MSEC );
+      continue;
+    }
+    self->WriteRecords();
+  }
+  // the main thread does not add samples anymore
+  self->WriteRecords();
+  self->File->Flush();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecorder::WriteRecords()
+{
+  FileHeader* header = reinterpret_cast< FileHeader* >( this->File->GetData() );
+  Record* fileRecords = reinterpret_cast< Record* >( this->File->GetData() + HEADER_SIZE_BYTES );
+  vtkTypeInt64 ringBufferSize = static_cast< vtkTypeInt64 >( this->RingBuffer.size() );
+  vtkTypeInt64 readCount = this->RingBufferReadCount.load();
+  vtkTypeInt64 writeCount = this->RingBufferWriteCount.load();
+  vtkTypeUInt64 numberOfRecords = header->NumberOfRecords;
+  for ( ; readCount < writeCount; ++readCount )
+  {
+    if ( numberOfRecords >= this->MaximumNumberOfRecords )
+    {
+      ++this->NumberOfDroppedSamples;
+      continue;
+    }
+    fileRecords[ numberOfRecords ] = this->RingBuffer[ readCount % ringBufferSize ];
+    ++numberOfRecords;
+  }
+  header->NumberOfRecords = numberOfRecords;
+  this->NumberOfRecordedSamples.store( static_cast< vtkTypeInt64 >( numberOfRecords ) );
+  // release the ring buffer entries to the main thread
+  this->RingBufferReadCount.store( readCount );
+}
@@ -0,0 +1,138 @@
+#ifndef __vtkTransformStreamRecorder_h
+#define __vtkTransformStreamRecorder_h
+
+#include <vtkAtomic.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkMatrix4x4;
+class vtkMemoryMappedFile;
+class vtkMRMLTransformNode;
+class vtkMultiThreader;
+
+// Records every modification of a set of transform nodes (e.g., the tracked tools of a
+// watchdog node) at full rate, for post-op analysis and for replay (see vtkTrackingStreamReplay
+// and vtkTransformStreamRecordingReader).
+// Each record is a timestamped 4x4 pose (transform to parent) of one stream (transform node).
+// The recording file is preallocated for the maximum number of records and memory-mapped.
+// The main thread only copies the pose into a fixed-size single-producer single-consumer
+// ring buffer (no locks, no allocations), a writer thread moves the records from the ring
+// buffer to the mapped file. If the ring buffer or the file is full then records are dropped
+// (and counted), the main thread is never blocked.
+//
+// File format (little-endian, as written by the recording computer): a FileHeader at offset 0,
+// then the records (Record structures) from offset HEADER_SIZE_BYTES.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkTransformStreamRecorder : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkTransformStreamRecorder, vtkObject );
+    static vtkTransformStreamRecorder* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    enum
+    {
+      MAXIMUM_NUMBER_OF_STREAMS = 32,
+      STREAM_NAME_LENGTH = 64,
+      HEADER_SIZE_BYTES = 4096,
+      FILE_FORMAT_VERSION = 1
+    };
+
+    struct FileHeader
+    {
+      char Magic[ 8 ]; // "IGTPOSES"
+      vtkTypeUInt32 Version;
+      vtkTypeUInt32 RecordSizeBytes;
+      vtkTypeUInt32 NumberOfStreams;
+      vtkTypeUInt32 Reserved;
+      vtkTypeUInt64 MaximumNumberOfRecords;
+      vtkTypeUInt64 NumberOfRecords; // updated by the writer thread as records are written
+      double StartTimeSec; // universal time of starting the recording
+      char StreamNames[ MAXIMUM_NUMBER_OF_STREAMS ][ STREAM_NAME_LENGTH ];
+    };
+
+    struct Record
+    {
+      double TimeSec; // universal time of the node modification
+      double SourceTimeSec; // device timestamp of the pose (see vtkLatencyInstrumentation), -1 if not available
+      vtkTypeInt32 StreamIndex;
+      vtkTypeInt32 Reserved;
+      double Matrix[ 16 ]; // row-major
+    };
+
+    // Add a transform node to record. Returns the stream index, -1 on error.
+    // Streams can only be added while not recording. The stream name is the node name.
+    int AddStream( vtkMRMLTransformNode* transformNode );
+    int GetNumberOfStreams();
+    void RemoveAllStreams();
+
+    // Number of records that the ring buffer between the main thread and the writer thread
+    // can hold (default: 4096, i.e., several seconds of ten tools tracked at 100Hz).
+    // A new size is used from the next StartRecording.
+    vtkGetMacro( RingBufferSize, int );
+    vtkSetClampMacro( RingBufferSize, int, 16, 1 << 24 );
+
+    // Preallocate and map the file for maximumNumberOfRecords records, and start recording.
+    // Returns false if the file cannot be created.
+    bool StartRecording( const char* fileName, vtkTypeUInt64 maximumNumberOfRecords );
+    // Write the remaining records, remove the unused end of the file, and close it.
+    void StopRecording();
+    bool IsRecording();
+
+    // Statistics of the current or last recording (can be called while recording)
+    // Samples written to the file
+    vtkTypeInt64 GetNumberOfRecordedSamples();
+    // Samples that did not fit in the ring buffer (writer thread too slow) or in the file
+    vtkTypeInt64 GetNumberOfDroppedSamples();
+
+  protected:
+    vtkTransformStreamRecorder();
+    ~vtkTransformStreamRecorder();
+
+    static void TransformModifiedCallback( vtkObject* caller, unsigned long eid, void* clientData, void* callData );
+    static VTK_THREAD_RETURN_TYPE WriterThreadFunction( void* ptr );
+
+    // Called from the main thread: copy the current pose of the stream into the ring buffer
+    void PushSample( int streamIndex );
+    // Called from the writer thread: move records from the ring buffer to the file
+    void WriteRecords();
+
+  private:
+    std::vector< vtkWeakPointer< vtkMRMLTransformNode > > StreamNodes;
+    std::vector< std::string > StreamNames;
+    vtkSmartPointer< vtkCallbackCommand > TransformModifiedCallbackCommand;
+
+    int RingBufferSize;
+    std::vector< Record > RingBuffer;
+    // Number of records pushed by the main thread (only written by the main thread)
+    vtkAtomic< vtkTypeInt64 > RingBufferWriteCount;
+    // Number of records taken by the writer thread (only written by the writer thread)
+    vtkAtomic< vtkTypeInt64 > RingBufferReadCount;
+    vtkAtomic< vtkTypeInt64 > NumberOfRecordedSamples;
+    vtkAtomic< vtkTypeInt64 > NumberOfDroppedSamples;
+    vtkAtomic< vtkTypeInt32 > StopRequested;
+
+    vtkMemoryMappedFile* File;
+    vtkTypeUInt64 MaximumNumberOfRecords;
+
+    vtkSmartPointer< vtkMultiThreader > Threader;
+    int WriterThreadId;
+
+    // Reused for getting the poses
+    vtkSmartPointer< vtkMatrix4x4 > PoseMatrix;
+
+    // Not implemented:
+    vtkTransformStreamRecorder( const vtkTransformStreamRecorder& );
+    void operator=( const vtkTransformStreamRecorder& );
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "vtkTransformStreamRecordingReader.h"
+#include "vtkMemoryMappedFile.h"
+#include "vtkTrackingStreamReplay.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkTransformStreamRecordingReader );
+
+//------------------------------------------------------------------------------
+vtkTransformStreamRecordingReader::vtkTransformStreamRecordingReader()
+{
+  this->File = new vtkMemoryMappedFile;
+  this->NumberOfRecordsInFile = 0;
+}
+
+//------------------------------------------------------------------------------
+vtkTransformStreamRecordingReader::~vtkTransformStreamRecordingReader()
+{
+  this->Close();
+  delete this->File;
+  this->File = NULL;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecordingReader::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Open: " << ( this->IsOpen() ? "yes" : "no" ) << std::endl;
+  if ( !this->IsOpen() )
+  {
+    return;
+  }
+  os << indent << "StartTimeSec: " << this->GetStartTimeSec() << std::endl;
+  os << indent << "NumberOfRecords: " << this->GetNumberOfRecords() << std::endl;
+  for ( int streamIndex = 0; streamIndex < this->GetNumberOfStreams(); streamIndex++ )
+  {
+    os << indent << "Stream " << streamIndex << ": " << this->GetStreamName( streamIndex ) << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformStreamRecordingReader::Open( const char* fileName )
+{
+  this->Close();
+  if ( !this->File->OpenReadOnly( fileName ) )
+  {
+    vtkErrorMacro( "Open failed: cannot map file " << ( fileName ? fileName : "(none)" ) );
+    return false;
+  }
+  const vtkTransformStreamRecorder::FileHeader* header = this->GetHeader();
+  if ( this->File->GetSizeBytes() < vtkTransformStreamRecorder::HEADER_SIZE_BYTES
+    || strncmp( header->Magic, "IGTPOSES", sizeof( header->Magic ) ) != 0
+    || header->Version != vtkTransformStreamRecorder::FILE_FORMAT_VERSION
+    || header->RecordSizeBytes != sizeof( vtkTransformStreamRecorder::Record )
+    || header->NumberOfStreams > vtkTransformStreamRecorder::MAXIMUM_NUMBER_OF_STREAMS )
+  {
+    vtkErrorMacro( "Open failed: " << fileName << " is not a valid transform stream recording" );
+    this->File->Close();
+    return false;
+  }
+  this->NumberOfRecordsInFile = ( this->File->GetSizeBytes() - vtkTransformStreamRecorder::HEADER_SIZE_BYTES ) / sizeof( vtkTransformStreamRecorder::Record );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformStreamRecordingReader::Close()
+{
+  this->File->Close();
+  this->NumberOfRecordsInFile = 0;
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformStreamRecordingReader::IsOpen()
+{
+  return this->File->IsOpen();
+}
+
+//------------------------------------------------------------------------------
+const vtkTransformStreamRecorder::FileHeader* vtkTransformStreamRecordingReader::GetHeader()
+{
+  return reinterpret_cast< const vtkTransformStreamRecorder::FileHeader* >( this->File->GetData() );
+}
+
+//------------------------------------------------------------------------------
+int vtkTransformStreamRecordingReader::GetNumberOfStreams()
+{
+  if ( !this->IsOpen() )
+  {
+    return 0;
+  }
+  return static_cast< int >( this->GetHeader()->NumberOfStreams );
+}
+
+//------------------------------------------------------------------------------
+const char* vtkTransformStreamRecordingReader::GetStreamName( int streamIndex )
+{
+  if ( streamIndex < 0 || streamIndex >= this->GetNumberOfStreams() )
+  {
+    vtkErrorMacro( "GetStreamName failed: invalid stream index " << streamIndex );
+    return NULL;
+  }
+  return this->GetHeader()->StreamNames[ streamIndex ];
+}
+
+//------------------------------------------------------------------------------
+double vtkTransformStreamRecordingReader::GetStartTimeSec()
+{
+  if ( !this->IsOpen() )
+  {
+    return 0.0;
+  }
+  return this->GetHeader()->StartTimeSec;
+}
+
+//------------------------------------------------------------------------------
+vtkTypeUInt64 vtkTransformStreamRecordingReader::GetNumberOfRecords()
+{
+  if ( !this->IsOpen() )
+  {
+    return 0;
+  }
+  // The header is read each time, as the recording may be still written
+  return std::min( this->GetHeader()->NumberOfRecords, this->NumberOfRecordsInFile );
+}
+
+//------------------------------------------------------------------------------
+const vtkTransformStreamRecorder::Record* vtkTransformStreamRecordingReader::GetRecords()
+{
+  if ( !this->IsOpen() )
+  {
+    return NULL;
+  }
+  return reinterpret_cast< const vtkTransformStreamRecorder::Record* >( this->File->GetData() + vtkTransformStreamRecorder::HEADER_SIZE_BYTES );
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformStreamRecordingReader::GetRecordPose( vtkTypeUInt64 recordIndex, vtkMatrix4x4* pose )
+{
+  if ( pose == NULL || recordIndex >= this->GetNumberOfRecords() )
+  {
+    return false;
+  }
+  pose->DeepCopy( this->GetRecords()[ recordIndex ].Matrix );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+int vtkTransformStreamRecordingReader::AddPoseSamplesToReplay( int recordedStreamIndex, vtkTrackingStreamReplay* replay, int replayStreamIndex )
+{
+  if ( replay == NULL || recordedStreamIndex < 0 || recordedStreamIndex >= this->GetNumberOfStreams() )
+  {
+    vtkErrorMacro( "AddPoseSamplesToReplay failed: invalid replay or stream index " << recordedStreamIndex );
+    return 0;
+  }
+  const vtkTransformStreamRecorder::Record* records = this->GetRecords();
+  vtkTypeUInt64 numberOfRecords = this->GetNumberOfRecords();
+  double startTimeSec = this->GetStartTimeSec();
+  vtkNew< vtkMatrix4x4 > pose;
+  int numberOfAddedSamples = 0;
+  for ( vtkTypeUInt64 recordIndex = 0; recordIndex < numberOfRecords; recordIndex++ )
+  {
+    if ( records[ recordIndex ].StreamIndex != recordedStreamIndex )
+    {
+      continue;
+    }
+    pose->DeepCopy( records[ recordIndex ].Matrix );
+    replay->AddPoseSample( replayStreamIndex, records[ recordIndex ].TimeSec - startTimeSec, pose.GetPointer() );
+    numberOfAddedSamples++;
+  }
+  return numberOfAddedSamples;
+}
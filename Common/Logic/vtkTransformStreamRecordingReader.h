@@ -0,0 +1,64 @@
+#ifndef __vtkTransformStreamRecordingReader_h
+#define __vtkTransformStreamRecordingReader_h
+
+#include <vtkObject.h>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+#include "vtkTransformStreamRecorder.h"
+
+class vtkMatrix4x4;
+class vtkMemoryMappedFile;
+class vtkTrackingStreamReplay;
+
+// Reads a recording of vtkTransformStreamRecorder. The file is memory-mapped read-only,
+// the records are accessed in place (not copied), so even recordings of several hours
+// are opened instantly. A recording that is still being written can be opened as well,
+// the records written so far are available.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkTransformStreamRecordingReader : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkTransformStreamRecordingReader, vtkObject );
+    static vtkTransformStreamRecordingReader* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Map the recording file. Returns false if the file cannot be opened or it is not a valid recording.
+    bool Open( const char* fileName );
+    void Close();
+    bool IsOpen();
+
+    int GetNumberOfStreams();
+    const char* GetStreamName( int streamIndex );
+    // Universal time of starting the recording
+    double GetStartTimeSec();
+
+    vtkTypeUInt64 GetNumberOfRecords();
+    // Pointer to the first record in the mapped file, valid until the file is closed.
+    // Records are in the order they were recorded.
+    const vtkTransformStreamRecorder::Record* GetRecords();
+    // Returns false if the record index is invalid
+    bool GetRecordPose( vtkTypeUInt64 recordIndex, vtkMatrix4x4* pose );
+
+    // Add the records of a recorded stream to a pose stream of a replay. Sample times are
+    // relative to the start of the recording. Returns the number of added samples.
+    int AddPoseSamplesToReplay( int recordedStreamIndex, vtkTrackingStreamReplay* replay, int replayStreamIndex );
+
+  protected:
+    vtkTransformStreamRecordingReader();
+    ~vtkTransformStreamRecordingReader();
+
+  private:
+    const vtkTransformStreamRecorder::FileHeader* GetHeader();
+
+    vtkMemoryMappedFile* File;
+    // Number of records that fit in the mapped file (the recording may be still written)
+    vtkTypeUInt64 NumberOfRecordsInFile;
+
+    // Not implemented:
+    vtkTransformStreamRecordingReader( const vtkTransformStreamRecordingReader& );
+    void operator=( const vtkTransformStreamRecordingReader& );
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "vtkTransformToWorldCache.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+
+// VTK includes
+#include <vtkAbstractTransform.h>
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+
+// STD includes
+#include <algorithm>
+
+// The instance is created on first use and deleted when the application exits
+static vtkSmartPointer< vtkTransformToWorldCache > TransformToWorldCacheInstance;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkTransformToWorldCache );
+
+//------------------------------------------------------------------------------
+vtkTransformToWorldCache::vtkTransformToWorldCache()
+{
+  this->NodeDeletedCallbackCommand = vtkSmartPointer< vtkCallbackCommand >::New();
+  this->NodeDeletedCallbackCommand->SetClientData( this );
+  this->NodeDeletedCallbackCommand->SetCallback( vtkTransformToWorldCache::NodeDeletedCallback );
+  this->NodeToParentMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->NumberOfCacheHits = 0;
+  this->NumberOfCacheMisses = 0;
+}
+
+//------------------------------------------------------------------------------
+vtkTransformToWorldCache::~vtkTransformToWorldCache()
+{
+  this->Clear();
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformToWorldCache::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfCachedNodes: " << this->Entries.size() << std::endl;
+  os << indent << "NumberOfCacheHits: " << this->NumberOfCacheHits << std::endl;
+  os << indent << "NumberOfCacheMisses: " << this->NumberOfCacheMisses << std::endl;
+}
+
+//------------------------------------------------------------------------------
+vtkTransformToWorldCache* vtkTransformToWorldCache::GetInstance()
+{
+  if ( TransformToWorldCacheInstance.GetPointer() == NULL )
+  {
+    TransformToWorldCacheInstance = vtkSmartPointer< vtkTransformToWorldCache >::New();
+  }
+  return TransformToWorldCacheInstance.GetPointer();
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformToWorldCache::Clear()
+{
+  // deleted nodes are removed from the cache in the callback, so all nodes in the cache are valid
+  for ( std::map< vtkMRMLTransformNode*, CacheEntry >::iterator entryIt = this->Entries.begin(); entryIt != this->Entries.end(); ++entryIt )
+  {
+    entryIt->first->RemoveObserver( this->NodeDeletedCallbackCommand );
+  }
+  this->Entries.clear();
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformToWorldCache::ResetStatistics()
+{
+  this->NumberOfCacheHits = 0;
+  this->NumberOfCacheMisses = 0;
+}
+
+//------------------------------------------------------------------------------
+void vtkTransformToWorldCache::NodeDeletedCallback( vtkObject* caller, unsigned long vtkNotUsed( event ), void* clientData, void* vtkNotUsed( callData ) )
+{
+  vtkTransformToWorldCache* self = reinterpret_cast< vtkTransformToWorldCache* >( clientData );
+  if ( self == NULL )
+  {
+    return;
+  }
+  self->Entries.erase( reinterpret_cast< vtkMRMLTransformNode* >( caller ) );
+}
+
+//------------------------------------------------------------------------------
+vtkTransformToWorldCache::CacheEntry* vtkTransformToWorldCache::GetUpToDateEntry( vtkMRMLTransformNode* node )
+{
+  std::map< vtkMRMLTransformNode*, CacheEntry >::iterator entryIt = this->Entries.find( node );
+  CacheEntry* entry = ( entryIt != this->Entries.end() ) ? &( entryIt->second ) : NULL;
+
+  // Walking up the hierarchy is cheap compared to computing the transform, so it is done on each call
+  // to detect changes in the transforms and in the parent nodes.
+  bool hierarchyChanged = ( entry == NULL );
+  unsigned long hierarchyMTime = 0;
+  std::size_t numberOfHierarchyNodes = 0;
+  for ( vtkMRMLTransformNode* transformNode = node; transformNode != NULL; transformNode = transformNode->GetParentTransformNode() )
+  {
+    vtkAbstractTransform* transformToParent = transformNode->GetTransformToParent();
+    if ( !transformNode->IsLinear() || transformToParent == NULL )
+    {
+      this->NumberOfCacheMisses++;
+      return NULL;
+    }
+    hierarchyMTime = std::max( hierarchyMTime, std::max( transformNode->GetMTime(), transformToParent->GetMTime() ) );
+    if ( !hierarchyChanged && ( numberOfHierarchyNodes >= entry->HierarchyNodes.size() || entry->HierarchyNodes[ numberOfHierarchyNodes ] != transformNode ) )
+    {
+      hierarchyChanged = true;
+    }
+    numberOfHierarchyNodes++;
+  }
+  if ( !hierarchyChanged && numberOfHierarchyNodes == entry->HierarchyNodes.size() && hierarchyMTime == entry->HierarchyMTime )
+  {
+    this->NumberOfCacheHits++;
+    return entry;
+  }
+
+  this->NumberOfCacheMisses++;
+  if ( entry == NULL )
+  {
+    entry = &( this->Entries[ node ] );
+    node->AddObserver( vtkCommand::DeleteEvent, this->NodeDeletedCallbackCommand );
+  }
+  entry->HierarchyNodes.clear();
+  entry->HierarchyMTime = hierarchyMTime;
+  entry->WorldToNodeValid = false;
+  vtkMatrix4x4::Identity( entry->NodeToWorld );
+  double productElements[ 16 ];
+  for ( vtkMRMLTransformNode* transformNode = node; transformNode != NULL; transformNode = transformNode->GetParentTransformNode() )
+  {
+    entry->HierarchyNodes.push_back( transformNode );
+    transformNode->GetMatrixTransformToParent( this->NodeToParentMatrix );
+    // nodes are ordered from child to parent, so each matrix is multiplied from the left
+    vtkMatrix4x4::Multiply4x4( &this->NodeToParentMatrix->Element[ 0 ][ 0 ], entry->NodeToWorld, productElements );
+    std::copy( productElements, productElements + 16, entry->NodeToWorld );
+  }
+  return entry;
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformToWorldCache::GetMatrixTransformToWorld( vtkMRMLTransformNode* node, vtkMatrix4x4* nodeToWorldMatrix )
+{
+  if ( nodeToWorldMatrix == NULL )
+  {
+    vtkErrorMacro( "GetMatrixTransformToWorld: Invalid output matrix" );
+    return false;
+  }
+  if ( node == NULL )
+  {
+    nodeToWorldMatrix->Identity();
+    return true;
+  }
+  CacheEntry* entry = this->GetUpToDateEntry( node );
+  if ( entry == NULL )
+  {
+    nodeToWorldMatrix->Identity();
+    return false;
+  }
+  nodeToWorldMatrix->DeepCopy( entry->NodeToWorld );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkTransformToWorldCache::GetMatrixTransformBetweenNodes( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, vtkMatrix4x4* sourceToTargetMatrix )
+{
+  if ( sourceToTargetMatrix == NULL )
+  {
+    vtkErrorMacro( "GetMatrixTransformBetweenNodes: Invalid output matrix" );
+    return false;
+  }
+  sourceToTargetMatrix->Identity();
+  if ( sourceNode == targetNode )
+  {
+    return true;
+  }
+
+  double identity[ 16 ];
+  vtkMatrix4x4::Identity( identity );
+  const double* sourceToWorld = identity;
+  if ( sourceNode != NULL )
+  {
+    CacheEntry* sourceEntry = this->GetUpToDateEntry( sourceNode );
+    if ( sourceEntry == NULL )
+    {
+      return false;
+    }
+    sourceToWorld = sourceEntry->NodeToWorld;
+  }
+  const double* worldToTarget = identity;
+  if ( targetNode != NULL )
+  {
+    CacheEntry* targetEntry = this->GetUpToDateEntry( targetNode );
+    if ( targetEntry == NULL )
+    {
+      return false;
+    }
+    if ( !targetEntry->WorldToNodeValid )
+    {
+      vtkMatrix4x4::Invert( targetEntry->NodeToWorld, targetEntry->WorldToNode );
+      targetEntry->WorldToNodeValid = true;
+    }
+    worldToTarget = targetEntry->WorldToNode;
+  }
+
+  // sourceToTarget = worldToTarget * sourceToWorld
+  vtkMatrix4x4::Multiply4x4( worldToTarget, sourceToWorld, &sourceToTargetMatrix->Element[ 0 ][ 0 ] );
+  sourceToTargetMatrix->Modified();
+  return true;
+}
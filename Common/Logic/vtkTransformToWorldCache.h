@@ -0,0 +1,90 @@
+#ifndef __vtkTransformToWorldCache_h
+#define __vtkTransformToWorldCache_h
+
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <vector>
+
+// export
+#include "vtkSlicerIGTCommonModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkMatrix4x4;
+class vtkMRMLTransformNode;
+
+// Cache of node to world matrices of linear transform hierarchies.
+// Getting the transform to world from a transform node walks the hierarchy and
+// (for vtkGeneralTransform outputs) allocates a new transform each time, while the
+// same transforms are queried by many logics in each tracking frame.
+// The cache stores the node to world matrix of each queried node, together with the
+// transform nodes of the hierarchy and their modification times. A cached matrix is returned
+// if none of the transforms and parent nodes in the hierarchy have changed since it was computed.
+// Only linear hierarchies are cached, callers have to fall back to the general transform
+// if the methods return false.
+class VTK_SLICER_IGTCOMMON_MODULE_LOGIC_EXPORT vtkTransformToWorldCache : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkTransformToWorldCache, vtkObject );
+    static vtkTransformToWorldCache* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // The instance shared by all logics
+    static vtkTransformToWorldCache* GetInstance();
+
+    // Get the node to world matrix. NULL node means world (identity matrix).
+    // Returns false (and sets identity) if the transform to world is not linear.
+    bool GetMatrixTransformToWorld( vtkMRMLTransformNode* node, vtkMatrix4x4* nodeToWorldMatrix );
+
+    // Get the source to target matrix. NULL node means world.
+    // Returns false (and sets identity) if any of the transforms to world is not linear.
+    bool GetMatrixTransformBetweenNodes( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, vtkMatrix4x4* sourceToTargetMatrix );
+
+    // Remove all cached matrices
+    void Clear();
+
+    // Statistics of the matrix requests
+    vtkGetMacro( NumberOfCacheHits, unsigned long );
+    vtkGetMacro( NumberOfCacheMisses, unsigned long );
+    void ResetStatistics();
+
+  protected:
+    vtkTransformToWorldCache();
+    ~vtkTransformToWorldCache();
+
+    static void NodeDeletedCallback( vtkObject* caller, unsigned long event, void* clientData, void* callData );
+
+  private:
+    struct CacheEntry
+    {
+      // Nodes from the cached node up to the root of the hierarchy
+      std::vector< vtkMRMLTransformNode* > HierarchyNodes;
+      // Latest modification time of the nodes and their transforms to parent
+      unsigned long HierarchyMTime;
+      double NodeToWorld[ 16 ];
+      // World to node matrix is only computed when needed
+      bool WorldToNodeValid;
+      double WorldToNode[ 16 ];
+    };
+
+    // Returns the up-to-date entry of the node or NULL if the transform to world is not linear
+    CacheEntry* GetUpToDateEntry( vtkMRMLTransformNode* node );
+
+    std::map< vtkMRMLTransformNode*, CacheEntry > Entries;
+    vtkSmartPointer< vtkCallbackCommand > NodeDeletedCallbackCommand;
+
+    // Reused for getting the transform to parent of the nodes
+    vtkSmartPointer< vtkMatrix4x4 > NodeToParentMatrix;
+
+    unsigned long NumberOfCacheHits;
+    unsigned long NumberOfCacheMisses;
+
+    // Not implemented:
+    vtkTransformToWorldCache( const vtkTransformToWorldCache& );
+    void operator=( const vtkTransformToWorldCache& );
+};
+
+#endif
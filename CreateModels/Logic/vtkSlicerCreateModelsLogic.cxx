@@ -25,256 +25,182 @@
 
 // VTK includes
 #include "vtkAppendPolyData.h"
+#include "vtkCellArray.h"
+#include "vtkCollection.h"
 #include "vtkCubeSource.h"
 #include "vtkConeSource.h"
 #include "vtkCylinderSource.h"
 #include "vtkDoubleArray.h"
+#include "vtkFloatArray.h"
+#include "vtkIntArray.h"
+#include "vtkMath.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 #include "vtkPointData.h"
+#include "vtkPoints.h"
 #include "vtkPolyData.h"
+#include "vtkPolyDataCollection.h"
 #include "vtkSphereSource.h"
+#include "vtkStringArray.h"
 #include "vtkTransform.h"
 #include "vtkTransformPolyDataFilter.h"
 
+// STD includes
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// If the cache grows larger than this then it is emptied. Typically only a few different
+// tool models are used in a scene, so this limit is only reached if sizes are changed interactively.
+static const unsigned int MAXIMUM_POLYDATA_CACHE_SIZE = 100;
+
+static const char NEEDLE_COLOR_SCALAR_NAME[] = "Color";
+
 //----------------------------------------------------------------------------
-vtkStandardNewMacro(vtkSlicerCreateModelsLogic);
+// Helper functions for writing the needle mesh. Positions are specified with the needle shaft
+// along the +Y axis and are written rotated to the final orientation (shaft along the -Z axis).
+// Points of a ring are placed at increasing angles, so that faces are oriented outwards.
 
 //----------------------------------------------------------------------------
-vtkSlicerCreateModelsLogic::vtkSlicerCreateModelsLogic()
+static void SetNeedlePoint( float* points, vtkIdType pointId, double x, double y, double z )
 {
+  float* point = points + 3 * pointId;
+  point[ 0 ] = static_cast< float >( x );
+  point[ 1 ] = static_cast< float >( z );
+  point[ 2 ] = static_cast< float >( -y );
 }
 
 //----------------------------------------------------------------------------
-vtkSlicerCreateModelsLogic::~vtkSlicerCreateModelsLogic()
+static void WriteNeedleRing( float* points, vtkIdType firstPointId, double y, double radius, int resolution )
 {
+  for ( int i = 0; i < resolution; i++ )
+  {
+    double angle = 2.0 * vtkMath::Pi() * i / resolution;
+    SetNeedlePoint( points, firstPointId + i, radius * cos( angle ), y, -radius * sin( angle ) );
+  }
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerCreateModelsLogic::PrintSelf(ostream& os, vtkIndent indent)
+// Quads between two rings, the top ring is at larger Y
+static void WriteNeedleRingBand( vtkCellArray* polys, vtkIdType topRingId, vtkIdType bottomRingId, int resolution )
 {
-  this->Superclass::PrintSelf(os, indent);
+  for ( int i = 0; i < resolution; i++ )
+  {
+    int next = ( i + 1 ) % resolution;
+    vtkIdType quad[ 4 ] = { topRingId + i, bottomRingId + i, bottomRingId + next, topRingId + next };
+    polys->InsertNextCell( 4, quad );
+  }
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerCreateModelsLogic::CreateCylinderData( vtkPolyData* polyData, double height, double radius )
+// Polygon that closes a ring. If facingUp then the face points to +Y.
+static void WriteNeedleRingCap( vtkCellArray* polys, vtkIdType ringId, int resolution, bool facingUp, vtkIdType* capPointIds )
 {
-  vtkNew<vtkCylinderSource> s;
-  s->SetHeight( height );
-  s->SetRadius( radius );
-  s->SetResolution( 24 );
-  s->Update();
-  polyData->ShallowCopy(s->GetOutput());
+  for ( int i = 0; i < resolution; i++ )
+  {
+    capPointIds[ i ] = ringId + ( facingUp ? i : resolution - 1 - i );
+  }
+  polys->InsertNextCell( resolution, capPointIds );
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerCreateModelsLogic::CreateConeData( vtkPolyData* polyData, double height, double radius )
+// Closed cylinder, 2*resolution points and resolution+2 cells. pointId is advanced by the number of written points.
+static void WriteNeedleCylinder( float* points, vtkCellArray* polys, vtkIdType& pointId, double centerY, double height, double radius, int resolution, vtkIdType* capPointIds )
 {
-  vtkNew<vtkConeSource> s;
-  s->SetHeight( height );
-  s->SetRadius( radius );
-  s->SetResolution( 24 );
-  s->Update();
-  polyData->ShallowCopy( s->GetOutput() );
+  vtkIdType topRingId = pointId;
+  WriteNeedleRing( points, topRingId, centerY + height / 2.0, radius, resolution );
+  vtkIdType bottomRingId = topRingId + resolution;
+  WriteNeedleRing( points, bottomRingId, centerY - height / 2.0, radius, resolution );
+  pointId += 2 * resolution;
+  WriteNeedleRingBand( polys, topRingId, bottomRingId, resolution );
+  WriteNeedleRingCap( polys, topRingId, resolution, true, capPointIds );
+  WriteNeedleRingCap( polys, bottomRingId, resolution, false, capPointIds );
 }
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerCreateModelsLogic);
 
 //----------------------------------------------------------------------------
-vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateNeedle( double length, double radius, double tipRadius, bool markers, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
+vtkSlicerCreateModelsLogic::vtkSlicerCreateModelsLogic()
+: Resolution( DEFAULT_RESOLUTION )
 {
-  double tip = radius * 2.0;
-  
-    // Create a PolyData append object to
-  vtkNew<vtkAppendPolyData> appendPolyData;
-  vtkNew<vtkAppendPolyData> appendShaftTip;
-  vtkNew<vtkAppendPolyData> appendMarkings;
-  
-    // Create a cylinder to represent the needle shaft
-  vtkNew<vtkPolyData> needleShaft;
-  this->CreateCylinderData( needleShaft.GetPointer(), ( length - tip ), radius );
-    
-    // Set the transform of the needle shaft
-  vtkNew<vtkTransform> needleShaftTransform;
-  needleShaftTransform->Translate( 0, ( tip + length ) / 2.0, 0 );
-    
-    // Transform the needle shaft
-  vtkNew<vtkTransformPolyDataFilter> needleShaftTransformFilter;
-  needleShaftTransformFilter->SetTransform( needleShaftTransform.GetPointer() );
-
-#if (VTK_MAJOR_VERSION <= 5)
-  needleShaftTransformFilter->SetInput( needleShaft );
-#else
-  needleShaftTransformFilter->SetInputData( needleShaft.GetPointer() );
-#endif
-
-  needleShaftTransformFilter->Update();
-    
-#if (VTK_MAJOR_VERSION <= 5)
-  appendShaftTip->AddInput( needleShaftTransformFilter->GetOutput() );
-#else
-  appendShaftTip->AddInputData( needleShaftTransformFilter->GetOutput() );
-#endif
-  appendShaftTip->Update();
+}
 
-    // Create a cone to represent the needle tip
-  vtkNew<vtkPolyData> needleTip;
-  CreateConeData( needleTip.GetPointer(), tip, radius );
-  
-    // Set the transform of the needle tip
-  vtkNew<vtkTransform> needleTipTransform;
-  needleTipTransform->Translate( 0, tip / 2.0, 0 );
-  needleTipTransform->RotateZ( -90 );
-    
-    // Transform the needle tip
-  vtkNew<vtkTransformPolyDataFilter> needleTipTransformFilter;
-  needleTipTransformFilter->SetTransform( needleTipTransform.GetPointer() );
-#if (VTK_MAJOR_VERSION <= 5)
-  needleTipTransformFilter->SetInput( needleTip );
-#else
-  needleTipTransformFilter->SetInputData( needleTip.GetPointer() );
-#endif
+//----------------------------------------------------------------------------
+vtkSlicerCreateModelsLogic::~vtkSlicerCreateModelsLogic()
+{
+}
 
-  needleTipTransformFilter->Update();
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Resolution: " << this->Resolution << std::endl;
+  os << indent << "NumberOfCachedPolyData: " << this->PolyDataCache.size() << std::endl;
+}
 
-#if (VTK_MAJOR_VERSION <= 5)
-  appendShaftTip->AddInput( needleTipTransformFilter->GetOutput() );
-#else
-  appendShaftTip->AddInputData( needleTipTransformFilter->GetOutput() );
-#endif
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::ClearPolyDataCache()
+{
+  this->PolyDataCache.clear();
+}
 
-  appendShaftTip->Update();
+//----------------------------------------------------------------------------
+std::string vtkSlicerCreateModelsLogic::GetPolyDataCacheKey( const char* shapeName, double p1, double p2/*=0*/, double p3/*=0*/, double p4/*=0*/ )
+{
+  std::ostringstream key;
+  key << std::setprecision( 17 ) << shapeName << " " << this->Resolution << " " << p1 << " " << p2 << " " << p3 << " " << p4;
+  return key.str();
+}
 
-  // Sphere for ball tip needle
-  if ( tipRadius > 0.0 )
+//----------------------------------------------------------------------------
+vtkPolyData* vtkSlicerCreateModelsLogic::GetCachedPolyData( const std::string& key )
+{
+  std::map< std::string, vtkSmartPointer< vtkPolyData > >::iterator polyDataIt = this->PolyDataCache.find( key );
+  if ( polyDataIt == this->PolyDataCache.end() )
   {
-    vtkNew<vtkSphereSource> needleBallSource;
-    needleBallSource->SetRadius( tipRadius );
-    needleBallSource->SetThetaResolution( 24 );
-    needleBallSource->SetPhiResolution( 24 );
-    needleBallSource->Update();
-
-#if (VTK_MAJOR_VERSION <= 5)
-    appendShaftTip->AddInput( needleBallSource->GetOutput() );
-#else
-    appendShaftTip->AddInputData( needleBallSource->GetOutput() );
-#endif
-
-    appendShaftTip->Update();
+    return NULL;
   }
-    
-    
-  // Add needle centimeter markings
-  
-  int markPositionYMm = 10; // Start at 1 cm (10 mm).
-  double markRadiusOffset = 0.01; // So the mark is always outside the shaft.
-  while( markPositionYMm < length )
-  {
-    int numberOfLines = ( markPositionYMm / 10 ) % 5; // # Check for a 5 centimeter mark
-    double markerHeight = 0.3;
-    if ( numberOfLines == 0 )
-    {
-      markerHeight = 3 * markerHeight;
-      numberOfLines = 1;
-    }
-        
-    double firstMarkPositionY = markPositionYMm - ( ( numberOfLines - 1 ) * markerHeight );
-      
-      // Iterate over all markings
-    int line = 0;
-    while( line < numberOfLines )
-    {
-      line = line + 1; // Increase mark count
-    
-      vtkNew<vtkPolyData> linePolyData;
-      this->CreateCylinderData( linePolyData.GetPointer(), markerHeight, ( radius + markRadiusOffset ) );
-        
-      vtkNew<vtkTransform> lineTransform;
-      lineTransform->Translate( 0, firstMarkPositionY + 2 * ( line - 1 ) * markerHeight, 0 );
-        
-      vtkNew<vtkTransformPolyDataFilter> lineTransformFilter;
-      lineTransformFilter->SetTransform( lineTransform.GetPointer() );
-#if (VTK_MAJOR_VERSION <= 5)
-      lineTransformFilter->SetInput( linePolyData );
-#else
-	  lineTransformFilter->SetInputData( linePolyData.GetPointer() );
-#endif
-
-	    lineTransformFilter->Update();
-
-#if (VTK_MAJOR_VERSION <= 5)
-      appendMarkings->AddInput( lineTransformFilter->GetOutput() );
-#else
-	    appendMarkings->AddInputData( lineTransformFilter->GetOutput() );
-#endif
+  return polyDataIt->second;
+}
 
-	    appendMarkings->Update();
-    }
-      
-      // Increment the centimeter marker
-    markPositionYMm = markPositionYMm + 10;
+//----------------------------------------------------------------------------
+vtkPolyData* vtkSlicerCreateModelsLogic::AddPolyDataToCache( const std::string& key, vtkPolyData* polyData )
+{
+  if ( this->PolyDataCache.size() >= MAXIMUM_POLYDATA_CACHE_SIZE )
+  {
+    this->PolyDataCache.clear();
   }
+  // the cache owns its copy, so the geometry cannot be changed through the filter output or the caller's polydata
+  vtkSmartPointer< vtkPolyData > cachedPolyData = vtkSmartPointer< vtkPolyData >::New();
+  cachedPolyData->DeepCopy( polyData );
+  this->PolyDataCache[ key ] = cachedPolyData;
+  return cachedPolyData;
+}
 
-  // Rotate to the proper needle orientation (Z shaft)
-  vtkNew<vtkTransform> zShaftTransform;
-  zShaftTransform->RotateX( -90 );
-
-  vtkNew<vtkTransformPolyDataFilter> zShaftNeedleTransformFilter;
-  zShaftNeedleTransformFilter->SetTransform( zShaftTransform.GetPointer() );
-
-#if (VTK_MAJOR_VERSION <= 5)
-  zShaftNeedleTransformFilter->SetInput( appendShaftTip->GetOutput() );
-#else
-  zShaftNeedleTransformFilter->SetInputData( appendShaftTip->GetOutput() );
-#endif
-
-  zShaftNeedleTransformFilter->Update();
-  vtkPolyData* needlePolyData = zShaftNeedleTransformFilter->GetOutput();
-
-  vtkNew<vtkTransformPolyDataFilter> zShaftMarkersTransformFilter;
-  zShaftMarkersTransformFilter->SetTransform( zShaftTransform.GetPointer() );
-
-#if (VTK_MAJOR_VERSION <= 5)
-  zShaftMarkersTransformFilter->SetInput( appendMarkings->GetOutput() );
-#else
-  zShaftMarkersTransformFilter->SetInputData( appendMarkings->GetOutput() );
-#endif
-
-  zShaftMarkersTransformFilter->Update();
-  vtkPolyData* needleMarkersPolyData = zShaftMarkersTransformFilter->GetOutput();  
-  
-  vtkNew<vtkAppendPolyData> finalAppend;
-#if (VTK_MAJOR_VERSION <= 5)
-  finalAppend->AddInput( needlePolyData );
-#else
-  finalAppend->AddInputData( needlePolyData );
-#endif  
-
-  const char colorScalarName[]="Color";
-  if ( markers )
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::SetSharedPolyData( vtkMRMLModelNode* modelNode, vtkPolyData* cachedPolyData )
+{
+  // Each model gets its own polydata object with its own points and point data (e.g., normals),
+  // so that moving the points of one model does not change the cache or other models.
+  // Only the cells are shared with the cached polydata.
+  vtkNew< vtkPolyData > polyData;
+  polyData->ShallowCopy( cachedPolyData );
+  if ( cachedPolyData->GetPoints() != NULL )
   {
-    int needleColorIndex=4;
-    int needleMarkersColorIndex=12;
-
-    vtkNew<vtkIntArray> colorArrayNeedle;
-    colorArrayNeedle->SetName(colorScalarName);
-    colorArrayNeedle->SetNumberOfComponents(1);
-    colorArrayNeedle->SetNumberOfTuples(needlePolyData->GetNumberOfPoints());
-    colorArrayNeedle->FillComponent(0, needleColorIndex);
-    needlePolyData->GetPointData()->SetScalars(colorArrayNeedle.GetPointer());
+    vtkNew< vtkPoints > points;
+    points->DeepCopy( cachedPolyData->GetPoints() );
+    polyData->SetPoints( points.GetPointer() );
+  }
+  polyData->GetPointData()->DeepCopy( cachedPolyData->GetPointData() );
+  modelNode->SetAndObservePolyData( polyData.GetPointer() );
+}
 
-    vtkNew<vtkIntArray> colorArrayNeedleMarkers;
-    colorArrayNeedleMarkers->SetName(colorScalarName);
-    colorArrayNeedleMarkers->SetNumberOfComponents(1);
-    colorArrayNeedleMarkers->SetNumberOfTuples(needleMarkersPolyData->GetNumberOfPoints());
-    colorArrayNeedleMarkers->FillComponent(0, needleMarkersColorIndex);
-    needleMarkersPolyData->GetPointData()->SetScalars(colorArrayNeedleMarkers.GetPointer());
+//----------------------------------------------------------------------------
+vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateNeedle( double length, double radius, double tipRadius, bool markers, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
+{
+  vtkPolyData* needleModelPolyData = this->GetNeedlePolyData( length, radius, tipRadius, markers );
 
-#if (VTK_MAJOR_VERSION <= 5)
-    finalAppend->AddInput( needleMarkersPolyData );
-#else
-	  finalAppend->AddInputData( needleMarkersPolyData );
-#endif
-  }
-   
   // Add the needle poly data to the scene as a model
 
   if (modelNodeToUpdate == NULL)
@@ -285,8 +211,7 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateNeedle( double length, doubl
     modelNodeToUpdate = needleModelNode.GetPointer();
   }
 
-  finalAppend->Update();
-  modelNodeToUpdate->SetAndObservePolyData( finalAppend->GetOutput() );
+  this->SetSharedPolyData( modelNodeToUpdate, needleModelPolyData );
 	
   if (modelNodeToUpdate->GetDisplayNode() == NULL)
   {
@@ -300,7 +225,7 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateNeedle( double length, doubl
     
     if (markers)
     {
-      needleDisplayNode->SetActiveScalarName(colorScalarName);
+      needleDisplayNode->SetActiveScalarName(NEEDLE_COLOR_SCALAR_NAME);
       needleDisplayNode->SetAndObserveColorNodeID("vtkMRMLColorTableNodeFileGenericColors.txt");
       needleDisplayNode->SetScalarVisibility(1);
       needleDisplayNode->SetScalarRangeFlag(vtkMRMLDisplayNode::UseColorNodeScalarRange);
@@ -311,13 +236,249 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateNeedle( double length, doubl
   return modelNodeToUpdate;
 }
 
+//----------------------------------------------------------------------------
+int vtkSlicerCreateModelsLogic::CreateModels( vtkStringArray* shapeNames, vtkDoubleArray* shapeParameters, vtkStringArray* modelNames /* = NULL */, vtkCollection* createdModelNodes /* = NULL */ )
+{
+  if ( this->GetMRMLScene() == NULL || shapeNames == NULL || shapeParameters == NULL )
+  {
+    vtkErrorMacro( "CreateModels failed: scene, shape names, or shape parameters are not set" );
+    return 0;
+  }
+  if ( shapeParameters->GetNumberOfTuples() != shapeNames->GetNumberOfValues() || shapeParameters->GetNumberOfComponents() < 1 )
+  {
+    vtkErrorMacro( "CreateModels failed: shape parameters must have one tuple for each shape name" );
+    return 0;
+  }
+
+  int numberOfCreatedModels = 0;
+  std::vector< double > parameters( std::max( 4, shapeParameters->GetNumberOfComponents() ), 0.0 );
+  this->GetMRMLScene()->StartState( vtkMRMLScene::BatchProcessState );
+  for ( vtkIdType modelIndex = 0; modelIndex < shapeNames->GetNumberOfValues(); modelIndex++ )
+  {
+    shapeParameters->GetTuple( modelIndex, &( parameters[ 0 ] ) );
+    const std::string& shapeName = shapeNames->GetValue( modelIndex );
+    vtkMRMLModelNode* modelNode = NULL;
+    if ( shapeName == "Needle" )
+    {
+      modelNode = this->CreateNeedle( parameters[ 0 ], parameters[ 1 ], parameters[ 2 ], parameters[ 3 ] != 0.0 );
+    }
+    else if ( shapeName == "Cube" )
+    {
+      modelNode = this->CreateCube( parameters[ 0 ], parameters[ 1 ], parameters[ 2 ] );
+    }
+    else if ( shapeName == "Cylinder" )
+    {
+      modelNode = this->CreateCylinder( parameters[ 0 ], parameters[ 1 ] );
+    }
+    else if ( shapeName == "Sphere" )
+    {
+      modelNode = this->CreateSphere( parameters[ 0 ] );
+    }
+    else if ( shapeName == "Coordinate" )
+    {
+      modelNode = this->CreateCoordinate( parameters[ 0 ], parameters[ 1 ] );
+    }
+    else
+    {
+      vtkErrorMacro( "CreateModels: unknown shape " << shapeName << ", model " << modelIndex << " is not created" );
+      continue;
+    }
+    if ( modelNames != NULL && modelIndex < modelNames->GetNumberOfValues() && !modelNames->GetValue( modelIndex ).empty() )
+    {
+      modelNode->SetName( modelNames->GetValue( modelIndex ).c_str() );
+    }
+    if ( createdModelNodes != NULL )
+    {
+      createdModelNodes->AddItem( modelNode );
+    }
+    numberOfCreatedModels++;
+  }
+  this->GetMRMLScene()->EndState( vtkMRMLScene::BatchProcessState );
+  return numberOfCreatedModels;
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkSlicerCreateModelsLogic::GetNeedlePolyData( double length, double radius, double tipRadius, bool markers )
+{
+  std::string key = this->GetPolyDataCacheKey( "Needle", length, radius, tipRadius, markers ? 1 : 0 );
+  vtkPolyData* cachedPolyData = this->GetCachedPolyData( key );
+  if ( cachedPolyData != NULL )
+  {
+    return cachedPolyData;
+  }
+  vtkNew< vtkPolyData > needlePolyData;
+  this->CreateNeedleData( needlePolyData.GetPointer(), length, radius, tipRadius, markers );
+  return this->AddPolyDataToCache( key, needlePolyData.GetPointer() );
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::CreateNeedleLevelsOfDetail( double length, double radius, double tipRadius, bool markers, int numberOfLevels, vtkPolyDataCollection* levels )
+{
+  if ( levels == NULL )
+  {
+    vtkErrorMacro( "CreateNeedleLevelsOfDetail: Invalid output collection" );
+    return;
+  }
+
+  // The levels are generated by temporarily changing the resolution, so that each level is cached separately
+  int originalResolution = this->Resolution;
+  int levelResolution = this->Resolution;
+  for ( int level = 0; level < numberOfLevels; level++ )
+  {
+    this->Resolution = levelResolution;
+    // Markings are thin, they are not visible anyway when the lower levels are used
+    bool levelMarkers = markers && ( level < ( numberOfLevels + 1 ) / 2 );
+    vtkNew< vtkPolyData > levelPolyData;
+    levelPolyData->ShallowCopy( this->GetNeedlePolyData( length, radius, tipRadius, levelMarkers ) );
+    levels->AddItem( levelPolyData.GetPointer() );
+    levelResolution = std::max( levelResolution / 2, static_cast< int >( MINIMUM_RESOLUTION ) );
+  }
+  this->Resolution = originalResolution;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::CreateNeedleData( vtkPolyData* polyData, double length, double radius, double tipRadius, bool markers )
+{
+  // The mesh is written in one pass into preallocated arrays, without intermediate sources and append filters,
+  // so that the needle can be regenerated quickly, e.g., when its length is changed interactively.
+  // Parts: cone tip (apex at the origin), shaft cylinder, optional ball at the tip, optional centimeter markings.
+  const int resolution = this->Resolution;
+  double tip = radius * 2.0;
+
+  // Compute center position and height of each marking cylinder
+  std::vector< double > markCentersY;
+  std::vector< double > markHeights;
+  if ( markers )
+  {
+    int markPositionYMm = 10; // Start at 1 cm (10 mm).
+    while( markPositionYMm < length )
+    {
+      int numberOfLines = ( markPositionYMm / 10 ) % 5; // # Check for a 5 centimeter mark
+      double markerHeight = 0.3;
+      if ( numberOfLines == 0 )
+      {
+        markerHeight = 3 * markerHeight;
+        numberOfLines = 1;
+      }
+      double firstMarkPositionY = markPositionYMm - ( ( numberOfLines - 1 ) * markerHeight );
+      for ( int line = 0; line < numberOfLines; line++ )
+      {
+        markCentersY.push_back( firstMarkPositionY + 2 * line * markerHeight );
+        markHeights.push_back( markerHeight );
+      }
+      markPositionYMm = markPositionYMm + 10; // Increment the centimeter marker
+    }
+  }
+  const int numberOfMarks = static_cast< int >( markCentersY.size() );
+  double markRadius = radius + 0.01; // So the mark is always outside the shaft.
+
+  // Preallocate points and cells
+  const int ballRings = resolution - 1; // rings between the two poles
+  vtkIdType numberOfNeedlePoints = ( 1 + resolution ) + 2 * resolution; // tip, shaft
+  vtkIdType numberOfCells = ( resolution + 1 ) + ( resolution + 2 ); // tip, shaft
+  if ( tipRadius > 0.0 )
+  {
+    numberOfNeedlePoints += 2 + ballRings * resolution;
+    numberOfCells += resolution * ( ballRings + 1 );
+  }
+  vtkIdType numberOfPoints = numberOfNeedlePoints + numberOfMarks * 2 * resolution;
+  numberOfCells += numberOfMarks * ( resolution + 2 );
+
+  vtkNew< vtkPoints > points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints( numberOfPoints );
+  float* pointsPtr = static_cast< vtkFloatArray* >( points->GetData() )->GetPointer( 0 );
+
+  vtkNew< vtkCellArray > polys;
+  polys->Allocate( polys->EstimateSize( numberOfCells, std::max( resolution, 4 ) ) );
+  std::vector< vtkIdType > capPointIds( resolution );
+
+  // Cone tip
+  vtkIdType pointId = 0;
+  vtkIdType apexId = pointId++;
+  SetNeedlePoint( pointsPtr, apexId, 0.0, 0.0, 0.0 );
+  vtkIdType tipBaseId = pointId;
+  WriteNeedleRing( pointsPtr, tipBaseId, tip, radius, resolution );
+  pointId += resolution;
+  for ( int i = 0; i < resolution; i++ )
+  {
+    vtkIdType triangle[ 3 ] = { apexId, tipBaseId + ( i + 1 ) % resolution, tipBaseId + i };
+    polys->InsertNextCell( 3, triangle );
+  }
+  WriteNeedleRingCap( polys.GetPointer(), tipBaseId, resolution, true, &capPointIds[ 0 ] );
+
+  // Shaft
+  WriteNeedleCylinder( pointsPtr, polys.GetPointer(), pointId, ( tip + length ) / 2.0, length - tip, radius, resolution, &capPointIds[ 0 ] );
+
+  // Sphere for ball tip needle
+  if ( tipRadius > 0.0 )
+  {
+    vtkIdType northPoleId = pointId++;
+    SetNeedlePoint( pointsPtr, northPoleId, 0.0, tipRadius, 0.0 );
+    vtkIdType firstRingId = pointId;
+    for ( int ring = 0; ring < ballRings; ring++ )
+    {
+      double phi = vtkMath::Pi() * ( ring + 1 ) / resolution;
+      WriteNeedleRing( pointsPtr, pointId, tipRadius * cos( phi ), tipRadius * sin( phi ), resolution );
+      pointId += resolution;
+    }
+    vtkIdType southPoleId = pointId++;
+    SetNeedlePoint( pointsPtr, southPoleId, 0.0, -tipRadius, 0.0 );
+
+    vtkIdType lastRingId = firstRingId + ( ballRings - 1 ) * resolution;
+    for ( int i = 0; i < resolution; i++ )
+    {
+      int next = ( i + 1 ) % resolution;
+      vtkIdType northTriangle[ 3 ] = { northPoleId, firstRingId + i, firstRingId + next };
+      polys->InsertNextCell( 3, northTriangle );
+      vtkIdType southTriangle[ 3 ] = { lastRingId + i, southPoleId, lastRingId + next };
+      polys->InsertNextCell( 3, southTriangle );
+    }
+    for ( int ring = 0; ring + 1 < ballRings; ring++ )
+    {
+      WriteNeedleRingBand( polys.GetPointer(), firstRingId + ring * resolution, firstRingId + ( ring + 1 ) * resolution, resolution );
+    }
+  }
+
+  // Add needle centimeter markings
+  for ( int mark = 0; mark < numberOfMarks; mark++ )
+  {
+    WriteNeedleCylinder( pointsPtr, polys.GetPointer(), pointId, markCentersY[ mark ], markHeights[ mark ], markRadius, resolution, &capPointIds[ 0 ] );
+  }
+
+  polyData->Initialize();
+  polyData->SetPoints( points.GetPointer() );
+  polyData->SetPolys( polys.GetPointer() );
+
+  if ( markers )
+  {
+    int needleColorIndex=4;
+    int needleMarkersColorIndex=12;
+    vtkNew< vtkIntArray > colorArray;
+    colorArray->SetName( NEEDLE_COLOR_SCALAR_NAME );
+    colorArray->SetNumberOfComponents( 1 );
+    colorArray->SetNumberOfTuples( numberOfPoints );
+    int* colorPtr = colorArray->GetPointer( 0 );
+    std::fill( colorPtr, colorPtr + numberOfNeedlePoints, needleColorIndex );
+    std::fill( colorPtr + numberOfNeedlePoints, colorPtr + numberOfPoints, needleMarkersColorIndex );
+    polyData->GetPointData()->SetScalars( colorArray.GetPointer() );
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCube( double x, double y, double z, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
 {
-  vtkNew< vtkCubeSource > cube;
-  cube->SetXLength( x );
-  cube->SetYLength( y );
-  cube->SetZLength( z );
+  std::string key = this->GetPolyDataCacheKey( "Cube", x, y, z );
+  vtkPolyData* cubePolyData = this->GetCachedPolyData( key );
+  if ( cubePolyData == NULL )
+  {
+    vtkNew< vtkCubeSource > cube;
+    cube->SetXLength( x );
+    cube->SetYLength( y );
+    cube->SetZLength( z );
+    cube->Update();
+    cubePolyData = this->AddPolyDataToCache( key, cube->GetOutput() );
+  }
   
   if (modelNodeToUpdate == NULL)
   {
@@ -326,8 +487,7 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCube( double x, double y, do
     modelNode->SetName( "CubeModel" );
     modelNodeToUpdate = modelNode.GetPointer();
   }
-  cube->Update();
-  modelNodeToUpdate->SetAndObservePolyData( cube->GetOutput() );
+  this->SetSharedPolyData( modelNodeToUpdate, cubePolyData );
 
   if (modelNodeToUpdate->GetDisplayNode() == NULL)
   {
@@ -343,24 +503,31 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCube( double x, double y, do
 //----------------------------------------------------------------------------
 vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCylinder( double h, double r, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
 {
-  vtkNew< vtkCylinderSource > cylinder;
-  cylinder->SetHeight( h );
-  cylinder->SetRadius( r );
-  cylinder->SetResolution( 24 );
+  std::string key = this->GetPolyDataCacheKey( "Cylinder", h, r );
+  vtkPolyData* cylinderPolyData = this->GetCachedPolyData( key );
+  if ( cylinderPolyData == NULL )
+  {
+    vtkNew< vtkCylinderSource > cylinder;
+    cylinder->SetHeight( h );
+    cylinder->SetRadius( r );
+    cylinder->SetResolution( this->Resolution );
   
-  // Set the transform of the needle tip
-  vtkNew< vtkTransform > rotateToLongAxisZ;
-  rotateToLongAxisZ->RotateX( -90 );
+    // Set the transform of the needle tip
+    vtkNew< vtkTransform > rotateToLongAxisZ;
+    rotateToLongAxisZ->RotateX( -90 );
     
-    // Transform the needle tip
-  vtkNew< vtkTransformPolyDataFilter > transformFilter;
-  transformFilter->SetTransform( rotateToLongAxisZ.GetPointer() );
+      // Transform the needle tip
+    vtkNew< vtkTransformPolyDataFilter > transformFilter;
+    transformFilter->SetTransform( rotateToLongAxisZ.GetPointer() );
 #if (VTK_MAJOR_VERSION <= 5)
-  cylinder->Update();
-  transformFilter->SetInput( cylinder->GetOutput() );
+    cylinder->Update();
+    transformFilter->SetInput( cylinder->GetOutput() );
 #else
-  transformFilter->SetInputConnection( cylinder->GetOutputPort() );
+    transformFilter->SetInputConnection( cylinder->GetOutputPort() );
 #endif
+    transformFilter->Update();
+    cylinderPolyData = this->AddPolyDataToCache( key, transformFilter->GetOutput() );
+  }
 
   if (modelNodeToUpdate == NULL)
   {  
@@ -369,8 +536,7 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCylinder( double h, double r
     modelNode->SetName( "CylinderModel" );
     modelNodeToUpdate = modelNode.GetPointer();
   }
-  transformFilter->Update();
-  modelNodeToUpdate->SetAndObservePolyData( transformFilter->GetOutput() );
+  this->SetSharedPolyData( modelNodeToUpdate, cylinderPolyData );
 
   if (modelNodeToUpdate->GetDisplayNode() == NULL)
   {
@@ -386,10 +552,17 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCylinder( double h, double r
 //----------------------------------------------------------------------------
 vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateSphere( double radius, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
 {
-  vtkNew< vtkSphereSource > sphere;
-  sphere->SetRadius( radius );
-  sphere->SetThetaResolution( 24 );
-  sphere->SetPhiResolution( 12 );
+  std::string key = this->GetPolyDataCacheKey( "Sphere", radius );
+  vtkPolyData* spherePolyData = this->GetCachedPolyData( key );
+  if ( spherePolyData == NULL )
+  {
+    vtkNew< vtkSphereSource > sphere;
+    sphere->SetRadius( radius );
+    sphere->SetThetaResolution( this->Resolution );
+    sphere->SetPhiResolution( std::max( this->Resolution / 2, 2 ) );
+    sphere->Update();
+    spherePolyData = this->AddPolyDataToCache( key, sphere->GetOutput() );
+  }
   
   if (modelNodeToUpdate == NULL)
   {
@@ -398,8 +571,7 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateSphere( double radius, vtkMR
     modelNode->SetName( "SphereModel" );
     modelNodeToUpdate = modelNode.GetPointer();
   }
-  sphere->Update();
-  modelNodeToUpdate->SetAndObservePolyData( sphere->GetOutput() );
+  this->SetSharedPolyData( modelNodeToUpdate, spherePolyData );
   
   if (modelNodeToUpdate->GetDisplayNode() == NULL)
   {
@@ -414,6 +586,38 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateSphere( double radius, vtkMR
 
 //----------------------------------------------------------------------------
 vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCoordinate( double axisLength, double axisDiameter, vtkMRMLModelNode* modelNodeToUpdate /* = NULL */ )
+{
+  std::string key = this->GetPolyDataCacheKey( "Coordinate", axisLength, axisDiameter );
+  vtkSmartPointer< vtkPolyData > coordinatePolyData = this->GetCachedPolyData( key );
+  if ( coordinatePolyData == NULL )
+  {
+    vtkNew< vtkPolyData > generatedPolyData;
+    this->CreateCoordinateData( generatedPolyData.GetPointer(), axisLength, axisDiameter );
+    coordinatePolyData = this->AddPolyDataToCache( key, generatedPolyData.GetPointer() );
+  }
+
+  if (modelNodeToUpdate == NULL)
+  {  
+    vtkNew< vtkMRMLModelNode > modelNode;
+    this->GetMRMLScene()->AddNode( modelNode.GetPointer() );
+    modelNode->SetName( "CoordinateModel" );
+    modelNodeToUpdate = modelNode.GetPointer();
+  }
+  this->SetSharedPolyData( modelNodeToUpdate, coordinatePolyData );
+  
+  if (modelNodeToUpdate->GetDisplayNode() == NULL)
+  {
+    vtkNew< vtkMRMLModelDisplayNode > displayNode;
+    this->GetMRMLScene()->AddNode( displayNode.GetPointer() );
+    displayNode->SetName( "CoordinateModelDisplay" );
+    modelNodeToUpdate->SetAndObserveDisplayNodeID( displayNode->GetID() );
+  }
+
+  return modelNodeToUpdate;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCreateModelsLogic::CreateCoordinateData( vtkPolyData* polyData, double axisLength, double axisDiameter )
 {
   vtkNew< vtkAppendPolyData > appendPolyData;
   
@@ -537,23 +741,6 @@ vtkMRMLModelNode* vtkSlicerCreateModelsLogic::CreateCoordinate( double axisLengt
   appendPolyData->AddInputData( zCylinderTransformFilter->GetOutput() );
 #endif
   
-  if (modelNodeToUpdate == NULL)
-  {  
-    vtkNew< vtkMRMLModelNode > modelNode;
-    this->GetMRMLScene()->AddNode( modelNode.GetPointer() );
-    modelNode->SetName( "CoordinateModel" );
-    modelNodeToUpdate = modelNode.GetPointer();
-  }
   appendPolyData->Update();
-  modelNodeToUpdate->SetAndObservePolyData( appendPolyData->GetOutput() );
-  
-  if (modelNodeToUpdate->GetDisplayNode() == NULL)
-  {
-    vtkNew< vtkMRMLModelDisplayNode > displayNode;
-    this->GetMRMLScene()->AddNode( displayNode.GetPointer() );
-    displayNode->SetName( "CoordinateModelDisplay" );
-    modelNodeToUpdate->SetAndObserveDisplayNodeID( displayNode->GetID() );
-  }
-
-  return modelNodeToUpdate;
+  polyData->ShallowCopy( appendPolyData->GetOutput() );
 }
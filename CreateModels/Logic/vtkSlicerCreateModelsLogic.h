@@ -19,6 +19,11 @@
 // .SECTION Description
 // This class contains methods that create model nodes useful for setting up IGT scenes.
 // These methods can be called from other modules.
+// Generated polydata is cached by shape and parameters, so creating many models of the same tool
+// only generates the geometry once. The cache keeps its own copy of the generated polydata,
+// each model gets a copy of the points and point data, only the cells are shared between models.
+// Round shapes are approximated by Resolution segments around their axis. Lower resolution
+// makes rendering of many tools or tools in many views faster.
 
 
 #ifndef __vtkSlicerCreateModelsLogic_h
@@ -29,8 +34,19 @@
 
 #include "vtkSlicerCreateModelsModuleLogicExport.h"
 
+// VTK includes
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <string>
+
+class vtkCollection;
+class vtkDoubleArray;
 class vtkMRMLModelNode;
-class vtkPolyData;
+class vtkPolyDataCollection;
+class vtkStringArray;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_CREATEMODELS_MODULE_LOGIC_EXPORT vtkSlicerCreateModelsLogic :
@@ -49,14 +65,53 @@ public:
   vtkMRMLModelNode* CreateSphere( double radius, vtkMRMLModelNode* modelNodeToUpdate = NULL );
   vtkMRMLModelNode* CreateCoordinate( double axisLength, double axisRadius, vtkMRMLModelNode* modelNodeToUpdate = NULL );  
 
+  // Create many models at once, in a single scene batch process, so the scene observers and views are only
+  // updated once. Shape names are Needle, Cube, Cylinder, Sphere, or Coordinate. Shape parameters have one tuple
+  // for each model, with the arguments of the corresponding Create... method in the same order (unused components are ignored,
+  // for Needle the fourth component is the markers flag). Model names are optional, empty names keep the default.
+  // The created model nodes are added to createdModelNodes if it is specified. Returns the number of created models.
+  int CreateModels( vtkStringArray* shapeNames, vtkDoubleArray* shapeParameters, vtkStringArray* modelNames = NULL, vtkCollection* createdModelNodes = NULL );
+
+  // Number of segments around the axis of cylinders, cones, and spheres (spheres have half as many
+  // segments from pole to pole). Only affects models that are created after it is changed.
+  vtkSetClampMacro( Resolution, int, MINIMUM_RESOLUTION, VTK_INT_MAX );
+  vtkGetMacro( Resolution, int );
+
+  // Create levels of detail of a needle model, for example for a vtkLODProp3D in a custom view.
+  // Level 0 is generated with the current Resolution, each further level with half the resolution
+  // of the previous one (but at least MINIMUM_RESOLUTION). Markings are only added to the first half of the levels.
+  // The polydata are appended to levels, the first is the most detailed.
+  void CreateNeedleLevelsOfDetail( double length, double radius, double tipRadius, bool markers, int numberOfLevels, vtkPolyDataCollection* levels );
+
+  // Remove all generated polydata from the cache. Existing models are not affected.
+  void ClearPolyDataCache();
+
+  static const int DEFAULT_RESOLUTION = 24;
+  static const int MINIMUM_RESOLUTION = 3;
+
 protected:
   vtkSlicerCreateModelsLogic();
   virtual ~vtkSlicerCreateModelsLogic();
 
 private:
 
-  void CreateCylinderData( vtkPolyData* polyData, double height, double radius );
-  void CreateConeData( vtkPolyData* polyData, double height, double radius );
+  void CreateNeedleData( vtkPolyData* polyData, double length, double radius, double tipRadius, bool markers );
+  void CreateCoordinateData( vtkPolyData* polyData, double axisLength, double axisDiameter );
+  // Returns the needle polydata for the current resolution, generates it if it is not in the cache yet
+  vtkPolyData* GetNeedlePolyData( double length, double radius, double tipRadius, bool markers );
+
+  // The key includes the current resolution
+  std::string GetPolyDataCacheKey( const char* shapeName, double p1, double p2 = 0, double p3 = 0, double p4 = 0 );
+  vtkPolyData* GetCachedPolyData( const std::string& key );
+  // Stores a copy of the polydata in the cache and returns the cached copy
+  vtkPolyData* AddPolyDataToCache( const std::string& key, vtkPolyData* polyData );
+  // Set a new polydata in the model node with its own points and point data and the cells of the cached polydata
+  void SetSharedPolyData( vtkMRMLModelNode* modelNode, vtkPolyData* cachedPolyData );
+
+  // Generated polydata, by shape and parameters
+  std::map< std::string, vtkSmartPointer< vtkPolyData > > PolyDataCache;
+
+  int Resolution;
 
   vtkSlicerCreateModelsLogic(const vtkSlicerCreateModelsLogic&); // Not implemented
   void operator=(const vtkSlicerCreateModelsLogic&);             // Not implemented
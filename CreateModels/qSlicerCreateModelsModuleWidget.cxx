@@ -135,6 +135,17 @@ qSlicerCreateModelsModuleWidget
 
 
 
+void
+qSlicerCreateModelsModuleWidget
+::OnResolutionChanged( int resolution )
+{
+  Q_D( qSlicerCreateModelsModuleWidget );
+  
+  d->logic()->SetResolution( resolution );
+}
+
+
+
 void qSlicerCreateModelsModuleWidget::setup()
 {
   Q_D(qSlicerCreateModelsModuleWidget);
@@ -146,5 +157,8 @@ void qSlicerCreateModelsModuleWidget::setup()
   connect( d->CreateCylinderButton, SIGNAL( clicked() ), this, SLOT( OnCreateCylinderClicked() ) );
   connect( d->CreateSphereButton, SIGNAL( clicked() ), this, SLOT( OnCreateSphereClicked() ) );
   connect( d->CreateCoordinateButton, SIGNAL( clicked() ), this, SLOT( OnCreateCoordinateClicked() ) );
+  
+  d->ResolutionSpinBox->setValue( d->logic()->GetResolution() );
+  connect( d->ResolutionSpinBox, SIGNAL( valueChanged( int ) ), this, SLOT( OnResolutionChanged( int ) ) );
 }
 
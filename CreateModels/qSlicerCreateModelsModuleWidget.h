@@ -45,6 +45,7 @@ public slots:
   void OnCreateCylinderClicked();
   void OnCreateSphereClicked();
   void OnCreateCoordinateClicked();
+  void OnResolutionChanged( int resolution );
   
   
 protected:
@@ -11,6 +11,7 @@ vtkCombinatoricGenerator::vtkCombinatoricGenerator()
 {
   this->Combinatoric = COMBINATORIC_COMBINATION;
   this->SubsetSize = 1;
+  this->TraversalState = TRAVERSAL_NOT_STARTED;
   this->InputChangedTime.Modified();
   this->OutputChangedTime.Modified();
 }
@@ -360,6 +361,190 @@ void vtkCombinatoricGenerator::Update()
   this->OutputChangedTime.Modified();
 }
 
+//------------------------------------------------------------------------------
+// TRAVERSAL (STREAMING OUTPUT)
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+void vtkCombinatoricGenerator::InitTraversal()
+{
+  this->TraversalState = TRAVERSAL_NOT_STARTED;
+  this->TraversalPositions.clear();
+  this->TraversalPositionUsed.clear();
+}
+
+//------------------------------------------------------------------------------
+unsigned int vtkCombinatoricGenerator::GetTraversalSetSize()
+{
+  if ( this->Combinatoric == COMBINATORIC_CARTESIAN_PRODUCT )
+  {
+    return this->InputSets.size();
+  }
+  return this->SubsetSize;
+}
+
+//------------------------------------------------------------------------------
+bool vtkCombinatoricGenerator::GetNextOutputSet( int* outputSet )
+{
+  if ( outputSet == NULL )
+  {
+    vtkErrorMacro( "Output set is NULL. Returning false." );
+    return false;
+  }
+
+  switch ( this->TraversalState )
+  {
+    case TRAVERSAL_NOT_STARTED:
+    {
+      this->TraversalState = ( this->InitializeTraversalPositions() ? TRAVERSAL_IN_PROGRESS : TRAVERSAL_DONE );
+      break;
+    }
+    case TRAVERSAL_IN_PROGRESS:
+    {
+      if ( !this->AdvanceTraversalPositions() )
+      {
+        this->TraversalState = TRAVERSAL_DONE;
+      }
+      break;
+    }
+    default:
+    {
+      break;
+    }
+  }
+
+  if ( this->TraversalState != TRAVERSAL_IN_PROGRESS )
+  {
+    return false;
+  }
+
+  for ( unsigned int elementIndex = 0; elementIndex < this->TraversalPositions.size(); elementIndex++ )
+  {
+    unsigned int setIndex = ( this->Combinatoric == COMBINATORIC_CARTESIAN_PRODUCT ) ? elementIndex : MAIN_SET_INDEX_FOR_PERMUTATION_AND_COMBINATION;
+    outputSet[ elementIndex ] = this->InputSets[ setIndex ][ this->TraversalPositions[ elementIndex ] ];
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Set the positions of the first output set. Returns false if there are no output sets.
+bool vtkCombinatoricGenerator::InitializeTraversalPositions()
+{
+  if ( this->InputSets.size() == 0 )
+  {
+    return false;
+  }
+
+  if ( this->Combinatoric == COMBINATORIC_CARTESIAN_PRODUCT )
+  {
+    for ( unsigned int setIndex = 0; setIndex < this->InputSets.size(); setIndex++ )
+    {
+      if ( this->InputSets[ setIndex ].empty() )
+      {
+        return false;
+      }
+    }
+    this->TraversalPositions.assign( this->InputSets.size(), 0 );
+    return true;
+  }
+
+  if ( this->Combinatoric != COMBINATORIC_COMBINATION && this->Combinatoric != COMBINATORIC_PERMUTATION )
+  {
+    vtkErrorMacro( "Unknown combinatoric. Cannot traverse." );
+    return false;
+  }
+
+  unsigned int setSize = this->GetInputSetSize( MAIN_SET_INDEX_FOR_PERMUTATION_AND_COMBINATION );
+  if ( this->SubsetSize == 0 || this->SubsetSize > setSize )
+  {
+    return false;
+  }
+
+  // first combination and first permutation are both the first SubsetSize elements, in order
+  this->TraversalPositions.resize( this->SubsetSize );
+  this->TraversalPositionUsed.assign( setSize, false );
+  for ( unsigned int elementIndex = 0; elementIndex < this->SubsetSize; elementIndex++ )
+  {
+    this->TraversalPositions[ elementIndex ] = elementIndex;
+    this->TraversalPositionUsed[ elementIndex ] = true;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Compute the positions of the next output set (lexicographic successor).
+// Returns false if the current set was the last one.
+bool vtkCombinatoricGenerator::AdvanceTraversalPositions()
+{
+  unsigned int numberOfPositions = this->TraversalPositions.size();
+
+  if ( this->Combinatoric == COMBINATORIC_CARTESIAN_PRODUCT )
+  {
+    // increment the last position, carry over to the previous ones
+    for ( int elementIndex = numberOfPositions - 1; elementIndex >= 0; elementIndex-- )
+    {
+      this->TraversalPositions[ elementIndex ]++;
+      if ( this->TraversalPositions[ elementIndex ] < this->InputSets[ elementIndex ].size() )
+      {
+        return true;
+      }
+      this->TraversalPositions[ elementIndex ] = 0;
+    }
+    return false;
+  }
+
+  unsigned int setSize = this->GetInputSetSize( MAIN_SET_INDEX_FOR_PERMUTATION_AND_COMBINATION );
+
+  if ( this->Combinatoric == COMBINATORIC_COMBINATION )
+  {
+    // find the last position that can still be incremented,
+    // then put the following positions right after it
+    for ( int elementIndex = numberOfPositions - 1; elementIndex >= 0; elementIndex-- )
+    {
+      unsigned int maximumPosition = setSize - numberOfPositions + elementIndex;
+      if ( this->TraversalPositions[ elementIndex ] < maximumPosition )
+      {
+        this->TraversalPositions[ elementIndex ]++;
+        for ( unsigned int followingIndex = elementIndex + 1; followingIndex < numberOfPositions; followingIndex++ )
+        {
+          this->TraversalPositions[ followingIndex ] = this->TraversalPositions[ followingIndex - 1 ] + 1;
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // permutation: find the last position that can be replaced by a larger unused position,
+  // then fill the following positions with the smallest unused positions in increasing order
+  for ( int elementIndex = numberOfPositions - 1; elementIndex >= 0; elementIndex-- )
+  {
+    unsigned int currentPosition = this->TraversalPositions[ elementIndex ];
+    this->TraversalPositionUsed[ currentPosition ] = false;
+    for ( unsigned int candidatePosition = currentPosition + 1; candidatePosition < setSize; candidatePosition++ )
+    {
+      if ( this->TraversalPositionUsed[ candidatePosition ] )
+      {
+        continue;
+      }
+      this->TraversalPositions[ elementIndex ] = candidatePosition;
+      this->TraversalPositionUsed[ candidatePosition ] = true;
+      unsigned int nextUnusedPosition = 0;
+      for ( unsigned int followingIndex = elementIndex + 1; followingIndex < numberOfPositions; followingIndex++ )
+      {
+        while ( this->TraversalPositionUsed[ nextUnusedPosition ] )
+        {
+          nextUnusedPosition++;
+        }
+        this->TraversalPositions[ followingIndex ] = nextUnusedPosition;
+        this->TraversalPositionUsed[ nextUnusedPosition ] = true;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 //------------------------------------------------------------------------------
 bool vtkCombinatoricGenerator::UpdateNeeded()
 {
@@ -111,6 +111,19 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkCombinatoricG
     // logic
     void Update();
 
+    // Streaming alternative to Update() and GetOutputSets(): output sets are generated
+    // one at a time in lexicographic order (of element positions in the input sets),
+    // without storing them. This needs memory only for a single set, and the caller
+    // can stop at any set. Cartesian products and combinations are generated in the
+    // same order as by Update(), permutations may be in a different order. E.g.:
+    //  std::vector< int > outputSet( generator->GetTraversalSetSize() );
+    //  generator->InitTraversal();
+    //  while ( generator->GetNextOutputSet( &outputSet[ 0 ] ) ) { ... }
+    // InitTraversal must be called again after the inputs are modified.
+    void InitTraversal();
+    unsigned int GetTraversalSetSize(); // number of elements written by GetNextOutputSet
+    bool GetNextOutputSet( int* outputSet ); // returns false if there are no more output sets
+
   protected:
     vtkCombinatoricGenerator();
     ~vtkCombinatoricGenerator();
@@ -150,6 +163,19 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkCombinatoricG
     
     unsigned int Factorial( unsigned int x );
 
+    // state of the traversal (streaming output), positions of the current elements in the input set(s)
+    enum TraversalStateType
+    {
+      TRAVERSAL_NOT_STARTED = 0,
+      TRAVERSAL_IN_PROGRESS,
+      TRAVERSAL_DONE
+    };
+    TraversalStateType TraversalState;
+    std::vector< unsigned int > TraversalPositions;
+    std::vector< bool > TraversalPositionUsed; // for permutations
+    bool InitializeTraversalPositions();
+    bool AdvanceTraversalPositions();
+
     vtkCombinatoricGenerator(const vtkCombinatoricGenerator&); // Not implemented.
     void operator=(const vtkCombinatoricGenerator&); // Not implemented.
 };
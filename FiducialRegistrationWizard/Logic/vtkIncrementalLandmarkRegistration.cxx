@@ -0,0 +1,423 @@
+#include "vtkIncrementalLandmarkRegistration.h"
+
+#include <vtkMath.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+
+#include <algorithm>
+
+// after this many incremental updates the sums are recomputed from the points
+#define MAXIMUM_NUMBER_OF_INCREMENTAL_UPDATES 100
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkIncrementalLandmarkRegistration );
+
+//------------------------------------------------------------------------------
+// Compare numberOfPairs consecutive point pairs of two pairs of coordinate lists
+static bool ArePairsEqual( const std::vector< double >& sourceCoordinates1, const std::vector< double >& targetCoordinates1, int index1,
+  const std::vector< double >& sourceCoordinates2, const std::vector< double >& targetCoordinates2, int index2, int numberOfPairs )
+{
+  if ( numberOfPairs <= 0 )
+  {
+    return true;
+  }
+  return std::equal( sourceCoordinates1.begin() + 3 * index1, sourceCoordinates1.begin() + 3 * ( index1 + numberOfPairs ), sourceCoordinates2.begin() + 3 * index2 )
+    && std::equal( targetCoordinates1.begin() + 3 * index1, targetCoordinates1.begin() + 3 * ( index1 + numberOfPairs ), targetCoordinates2.begin() + 3 * index2 );
+}
+
+//------------------------------------------------------------------------------
+vtkIncrementalLandmarkRegistration::vtkIncrementalLandmarkRegistration()
+{
+  this->Mode = VTK_LANDMARK_RIGIDBODY;
+  this->ResetSums();
+}
+
+//------------------------------------------------------------------------------
+vtkIncrementalLandmarkRegistration::~vtkIncrementalLandmarkRegistration()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkIncrementalLandmarkRegistration::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Mode: " << this->Mode << std::endl;
+  os << indent << "NumberOfPoints: " << this->NumberOfPoints << std::endl;
+  os << indent << "NumberOfIncrementalUpdates: " << this->NumberOfIncrementalUpdates << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkIncrementalLandmarkRegistration::SetLandmarks( vtkPoints* sourcePoints, vtkPoints* targetPoints )
+{
+  if ( sourcePoints == NULL || targetPoints == NULL )
+  {
+    vtkErrorMacro( "SetLandmarks: Invalid point list" );
+    return;
+  }
+  int numberOfPoints = sourcePoints->GetNumberOfPoints();
+  if ( targetPoints->GetNumberOfPoints() != numberOfPoints )
+  {
+    vtkErrorMacro( "SetLandmarks: Point lists have different numbers of points" );
+    return;
+  }
+
+  std::vector< double > sourceCoordinates( 3 * numberOfPoints );
+  std::vector< double > targetCoordinates( 3 * numberOfPoints );
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    sourcePoints->GetPoint( pointIndex, &sourceCoordinates[ 3 * pointIndex ] );
+    targetPoints->GetPoint( pointIndex, &targetCoordinates[ 3 * pointIndex ] );
+  }
+
+  // find the first pair that is different from the previous point lists
+  int previousNumberOfPoints = this->NumberOfPoints;
+  int numberOfCommonPoints = std::min( numberOfPoints, previousNumberOfPoints );
+  int firstDifferentIndex = 0;
+  while ( firstDifferentIndex < numberOfCommonPoints &&
+    ArePairsEqual( sourceCoordinates, targetCoordinates, firstDifferentIndex, this->SourceCoordinates, this->TargetCoordinates, firstDifferentIndex, 1 ) )
+  {
+    firstDifferentIndex++;
+  }
+  if ( numberOfPoints == previousNumberOfPoints && firstDifferentIndex == numberOfPoints )
+  {
+    // unchanged
+    return;
+  }
+
+  // the rest of the pairs must be the same for an incremental update
+  bool sumsUpdated = false;
+  if ( this->NumberOfIncrementalUpdates < MAXIMUM_NUMBER_OF_INCREMENTAL_UPDATES )
+  {
+    if ( numberOfPoints == previousNumberOfPoints )
+    {
+      if ( ArePairsEqual( sourceCoordinates, targetCoordinates, firstDifferentIndex + 1,
+        this->SourceCoordinates, this->TargetCoordinates, firstDifferentIndex + 1, numberOfPoints - firstDifferentIndex - 1 ) )
+      {
+        // moved
+        this->RemovePair( &this->SourceCoordinates[ 3 * firstDifferentIndex ], &this->TargetCoordinates[ 3 * firstDifferentIndex ] );
+        this->AddPair( &sourceCoordinates[ 3 * firstDifferentIndex ], &targetCoordinates[ 3 * firstDifferentIndex ] );
+        sumsUpdated = true;
+      }
+    }
+    else if ( numberOfPoints == previousNumberOfPoints + 1 )
+    {
+      if ( ArePairsEqual( sourceCoordinates, targetCoordinates, firstDifferentIndex + 1,
+        this->SourceCoordinates, this->TargetCoordinates, firstDifferentIndex, previousNumberOfPoints - firstDifferentIndex ) )
+      {
+        // added
+        this->AddPair( &sourceCoordinates[ 3 * firstDifferentIndex ], &targetCoordinates[ 3 * firstDifferentIndex ] );
+        sumsUpdated = true;
+      }
+    }
+    else if ( numberOfPoints == previousNumberOfPoints - 1 )
+    {
+      if ( ArePairsEqual( sourceCoordinates, targetCoordinates, firstDifferentIndex,
+        this->SourceCoordinates, this->TargetCoordinates, firstDifferentIndex + 1, numberOfPoints - firstDifferentIndex ) )
+      {
+        // removed
+        this->RemovePair( &this->SourceCoordinates[ 3 * firstDifferentIndex ], &this->TargetCoordinates[ 3 * firstDifferentIndex ] );
+        sumsUpdated = true;
+      }
+    }
+  }
+
+  this->SourceCoordinates.swap( sourceCoordinates );
+  this->TargetCoordinates.swap( targetCoordinates );
+  if ( sumsUpdated )
+  {
+    this->NumberOfIncrementalUpdates++;
+  }
+  else
+  {
+    this->RecomputeSums();
+  }
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkIncrementalLandmarkRegistration::GetMatrix( vtkMatrix4x4* matrix )
+{
+  if ( matrix == NULL )
+  {
+    vtkErrorMacro( "GetMatrix: Output matrix is null" );
+    return;
+  }
+
+  matrix->Identity();
+  if ( this->NumberOfPoints == 0 )
+  {
+    return;
+  }
+
+  double rotation[ 3 ][ 3 ];
+  double scale = 1.0;
+  this->ComputeRotationAndScale( rotation, scale );
+  for ( int i = 0; i < 3; i++ )
+  {
+    // the translation moves the transformed source centroid to the target centroid
+    double transformedSourceMean = 0.0;
+    for ( int j = 0; j < 3; j++ )
+    {
+      matrix->SetElement( i, j, scale * rotation[ i ][ j ] );
+      transformedSourceMean += scale * rotation[ i ][ j ] * this->SourceMean[ j ];
+    }
+    matrix->SetElement( i, 3, this->TargetMean[ i ] - transformedSourceMean );
+  }
+}
+
+//------------------------------------------------------------------------------
+double vtkIncrementalLandmarkRegistration::GetRootMeanSquareError()
+{
+  if ( this->NumberOfPoints == 0 )
+  {
+    return 0.0;
+  }
+
+  double rotation[ 3 ][ 3 ];
+  double scale = 1.0;
+  this->ComputeRotationAndScale( rotation, scale );
+
+  // sum of |scale * rotation * (source - SourceMean) - (target - TargetMean)|^2, expanded
+  double sourceSumOfSquares = this->SourceCoMoment[ 0 ][ 0 ] + this->SourceCoMoment[ 1 ][ 1 ] + this->SourceCoMoment[ 2 ][ 2 ];
+  double targetSumOfSquares = this->TargetCoMoment[ 0 ][ 0 ] + this->TargetCoMoment[ 1 ][ 1 ] + this->TargetCoMoment[ 2 ][ 2 ];
+  double sumOfDotProducts = 0.0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      sumOfDotProducts += rotation[ i ][ j ] * this->CrossCoMoment[ j ][ i ];
+    }
+  }
+  double sumOfSquaredErrors = scale * scale * sourceSumOfSquares - 2.0 * scale * sumOfDotProducts + targetSumOfSquares;
+  return sqrt( std::max( 0.0, sumOfSquaredErrors ) / this->NumberOfPoints );
+}
+
+//------------------------------------------------------------------------------
+bool vtkIncrementalLandmarkRegistration::IsSourceCollinear( double eigenvalueThreshold )
+{
+  return vtkIncrementalLandmarkRegistration::IsCollinear( this->SourceCoMoment, this->NumberOfPoints, eigenvalueThreshold );
+}
+
+//------------------------------------------------------------------------------
+bool vtkIncrementalLandmarkRegistration::IsTargetCollinear( double eigenvalueThreshold )
+{
+  return vtkIncrementalLandmarkRegistration::IsCollinear( this->TargetCoMoment, this->NumberOfPoints, eigenvalueThreshold );
+}
+
+//------------------------------------------------------------------------------
+bool vtkIncrementalLandmarkRegistration::IsCollinear( double coMoment[ 3 ][ 3 ], int numberOfPoints, double eigenvalueThreshold )
+{
+  if ( numberOfPoints < 2 )
+  {
+    return true;
+  }
+
+  // sample covariance, as in principal component analysis
+  double covariance[ 3 ][ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      covariance[ i ][ j ] = coMoment[ i ][ j ] / ( numberOfPoints - 1 );
+    }
+  }
+  double eigenvalues[ 3 ];
+  double eigenvectors[ 3 ][ 3 ];
+  vtkMath::Diagonalize3x3( covariance, eigenvalues, eigenvectors );
+
+  int goodEigenvalues = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    if ( fabs( eigenvalues[ i ] ) > eigenvalueThreshold )
+    {
+      goodEigenvalues++;
+    }
+  }
+  return ( goodEigenvalues <= 1 );
+}
+
+//------------------------------------------------------------------------------
+void vtkIncrementalLandmarkRegistration::ResetSums()
+{
+  this->NumberOfPoints = 0;
+  this->NumberOfIncrementalUpdates = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->SourceMean[ i ] = 0.0;
+    this->TargetMean[ i ] = 0.0;
+    for ( int j = 0; j < 3; j++ )
+    {
+      this->SourceCoMoment[ i ][ j ] = 0.0;
+      this->TargetCoMoment[ i ][ j ] = 0.0;
+      this->CrossCoMoment[ i ][ j ] = 0.0;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkIncrementalLandmarkRegistration::RecomputeSums()
+{
+  this->ResetSums();
+  this->NumberOfPoints = this->SourceCoordinates.size() / 3;
+  if ( this->NumberOfPoints == 0 )
+  {
+    return;
+  }
+
+  for ( int pointIndex = 0; pointIndex < this->NumberOfPoints; pointIndex++ )
+  {
+    for ( int i = 0; i < 3; i++ )
+    {
+      this->SourceMean[ i ] += this->SourceCoordinates[ 3 * pointIndex + i ];
+      this->TargetMean[ i ] += this->TargetCoordinates[ 3 * pointIndex + i ];
+    }
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->SourceMean[ i ] /= this->NumberOfPoints;
+    this->TargetMean[ i ] /= this->NumberOfPoints;
+  }
+
+  for ( int pointIndex = 0; pointIndex < this->NumberOfPoints; pointIndex++ )
+  {
+    double sourceDeviation[ 3 ];
+    double targetDeviation[ 3 ];
+    for ( int i = 0; i < 3; i++ )
+    {
+      sourceDeviation[ i ] = this->SourceCoordinates[ 3 * pointIndex + i ] - this->SourceMean[ i ];
+      targetDeviation[ i ] = this->TargetCoordinates[ 3 * pointIndex + i ] - this->TargetMean[ i ];
+    }
+    for ( int i = 0; i < 3; i++ )
+    {
+      for ( int j = 0; j < 3; j++ )
+      {
+        this->SourceCoMoment[ i ][ j ] += sourceDeviation[ i ] * sourceDeviation[ j ];
+        this->TargetCoMoment[ i ][ j ] += targetDeviation[ i ] * targetDeviation[ j ];
+        this->CrossCoMoment[ i ][ j ] += sourceDeviation[ i ] * targetDeviation[ j ];
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Welford update: the co-moments grow by the deviation from the old mean
+// times the deviation from the new mean
+void vtkIncrementalLandmarkRegistration::AddPair( const double* sourcePoint, const double* targetPoint )
+{
+  this->NumberOfPoints++;
+  double sourceDeviationFromOldMean[ 3 ];
+  double targetDeviationFromOldMean[ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    sourceDeviationFromOldMean[ i ] = sourcePoint[ i ] - this->SourceMean[ i ];
+    targetDeviationFromOldMean[ i ] = targetPoint[ i ] - this->TargetMean[ i ];
+    this->SourceMean[ i ] += sourceDeviationFromOldMean[ i ] / this->NumberOfPoints;
+    this->TargetMean[ i ] += targetDeviationFromOldMean[ i ] / this->NumberOfPoints;
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      this->SourceCoMoment[ i ][ j ] += sourceDeviationFromOldMean[ i ] * ( sourcePoint[ j ] - this->SourceMean[ j ] );
+      this->TargetCoMoment[ i ][ j ] += targetDeviationFromOldMean[ i ] * ( targetPoint[ j ] - this->TargetMean[ j ] );
+      this->CrossCoMoment[ i ][ j ] += sourceDeviationFromOldMean[ i ] * ( targetPoint[ j ] - this->TargetMean[ j ] );
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Inverse of AddPair
+void vtkIncrementalLandmarkRegistration::RemovePair( const double* sourcePoint, const double* targetPoint )
+{
+  if ( this->NumberOfPoints <= 1 )
+  {
+    this->ResetSums();
+    return;
+  }
+
+  double sourceDeviationFromMean[ 3 ];
+  double targetDeviationFromMean[ 3 ];
+  double sourceDeviationFromNewMean[ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    sourceDeviationFromMean[ i ] = sourcePoint[ i ] - this->SourceMean[ i ];
+    targetDeviationFromMean[ i ] = targetPoint[ i ] - this->TargetMean[ i ];
+    sourceDeviationFromNewMean[ i ] = sourceDeviationFromMean[ i ] * this->NumberOfPoints / ( this->NumberOfPoints - 1 );
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      this->SourceCoMoment[ i ][ j ] -= sourceDeviationFromNewMean[ i ] * sourceDeviationFromMean[ j ];
+      this->TargetCoMoment[ i ][ j ] -= targetDeviationFromMean[ i ] * targetDeviationFromMean[ j ] * this->NumberOfPoints / ( this->NumberOfPoints - 1 );
+      this->CrossCoMoment[ i ][ j ] -= sourceDeviationFromNewMean[ i ] * targetDeviationFromMean[ j ];
+    }
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->SourceMean[ i ] -= sourceDeviationFromMean[ i ] / ( this->NumberOfPoints - 1 );
+    this->TargetMean[ i ] -= targetDeviationFromMean[ i ] / ( this->NumberOfPoints - 1 );
+  }
+  this->NumberOfPoints--;
+}
+
+//------------------------------------------------------------------------------
+// Same method as vtkLandmarkTransform (Horn's quaternion method), from the stored sums
+void vtkIncrementalLandmarkRegistration::ComputeRotationAndScale( double rotation[ 3 ][ 3 ], double& scale )
+{
+  double (*M)[ 3 ] = this->CrossCoMoment;
+
+  scale = 1.0;
+  double sourceSumOfSquares = this->SourceCoMoment[ 0 ][ 0 ] + this->SourceCoMoment[ 1 ][ 1 ] + this->SourceCoMoment[ 2 ][ 2 ];
+  double targetSumOfSquares = this->TargetCoMoment[ 0 ][ 0 ] + this->TargetCoMoment[ 1 ][ 1 ] + this->TargetCoMoment[ 2 ][ 2 ];
+  if ( this->Mode == VTK_LANDMARK_SIMILARITY && sourceSumOfSquares > 0.0 )
+  {
+    scale = sqrt( targetSumOfSquares / sourceSumOfSquares );
+  }
+
+  double N[ 4 ][ 4 ];
+  // on-diagonal elements
+  N[ 0 ][ 0 ] = M[ 0 ][ 0 ] + M[ 1 ][ 1 ] + M[ 2 ][ 2 ];
+  N[ 1 ][ 1 ] = M[ 0 ][ 0 ] - M[ 1 ][ 1 ] - M[ 2 ][ 2 ];
+  N[ 2 ][ 2 ] = -M[ 0 ][ 0 ] + M[ 1 ][ 1 ] - M[ 2 ][ 2 ];
+  N[ 3 ][ 3 ] = -M[ 0 ][ 0 ] - M[ 1 ][ 1 ] + M[ 2 ][ 2 ];
+  // off-diagonal elements
+  N[ 0 ][ 1 ] = N[ 1 ][ 0 ] = M[ 1 ][ 2 ] - M[ 2 ][ 1 ];
+  N[ 0 ][ 2 ] = N[ 2 ][ 0 ] = M[ 2 ][ 0 ] - M[ 0 ][ 2 ];
+  N[ 0 ][ 3 ] = N[ 3 ][ 0 ] = M[ 0 ][ 1 ] - M[ 1 ][ 0 ];
+  N[ 1 ][ 2 ] = N[ 2 ][ 1 ] = M[ 0 ][ 1 ] + M[ 1 ][ 0 ];
+  N[ 1 ][ 3 ] = N[ 3 ][ 1 ] = M[ 2 ][ 0 ] + M[ 0 ][ 2 ];
+  N[ 2 ][ 3 ] = N[ 3 ][ 2 ] = M[ 1 ][ 2 ] + M[ 2 ][ 1 ];
+
+  // the eigenvector with the largest eigenvalue is the rotation quaternion
+  // (JacobiN sorts them in decreasing order)
+  double eigenvalues[ 4 ];
+  double eigenvectors[ 4 ][ 4 ];
+  double* NPtr[ 4 ] = { N[ 0 ], N[ 1 ], N[ 2 ], N[ 3 ] };
+  double* eigenvectorPtr[ 4 ] = { eigenvectors[ 0 ], eigenvectors[ 1 ], eigenvectors[ 2 ], eigenvectors[ 3 ] };
+  vtkMath::JacobiN( NPtr, 4, eigenvalues, eigenvectorPtr );
+  double w = eigenvectors[ 0 ][ 0 ];
+  double x = eigenvectors[ 1 ][ 0 ];
+  double y = eigenvectors[ 2 ][ 0 ];
+  double z = eigenvectors[ 3 ][ 0 ];
+
+  double ww = w * w;
+  double wx = w * x;
+  double wy = w * y;
+  double wz = w * z;
+  double xx = x * x;
+  double yy = y * y;
+  double zz = z * z;
+  double xy = x * y;
+  double xz = x * z;
+  double yz = y * z;
+  rotation[ 0 ][ 0 ] = ww + xx - yy - zz;
+  rotation[ 1 ][ 0 ] = 2.0 * ( wz + xy );
+  rotation[ 2 ][ 0 ] = 2.0 * ( -wy + xz );
+  rotation[ 0 ][ 1 ] = 2.0 * ( -wz + xy );
+  rotation[ 1 ][ 1 ] = ww - xx + yy - zz;
+  rotation[ 2 ][ 1 ] = 2.0 * ( wx + yz );
+  rotation[ 0 ][ 2 ] = 2.0 * ( wy + xz );
+  rotation[ 1 ][ 2 ] = 2.0 * ( -wx + yz );
+  rotation[ 2 ][ 2 ] = ww - xx - yy + zz;
+}
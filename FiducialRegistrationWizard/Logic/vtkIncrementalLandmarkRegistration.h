@@ -0,0 +1,87 @@
+#ifndef __vtkIncrementalLandmarkRegistration_h
+#define __vtkIncrementalLandmarkRegistration_h
+
+#include <vtkLandmarkTransform.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObject.h>
+#include <vtkPoints.h>
+
+#include <vector>
+
+// export
+#include "vtkSlicerFiducialRegistrationWizardModuleLogicExport.h"
+
+// This class computes the same rigid or similarity registration as vtkLandmarkTransform
+// from two ordered, corresponding point lists, but it keeps the centered cross-covariance
+// sums between calls. When only one pair of points was added, removed or moved since the
+// previous SetLandmarks call, the sums are updated with O(1) work and only the 3x3 problem
+// is solved again. This keeps interactive editing of fiducials responsive.
+// The registration error and the collinearity of the point lists are also computed from
+// the sums.
+class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkIncrementalLandmarkRegistration : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkIncrementalLandmarkRegistration, vtkObject );
+    static vtkIncrementalLandmarkRegistration* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Set the point lists. They must have the same number of points.
+    // The points are copied, so the lists can be modified afterwards.
+    void SetLandmarks( vtkPoints* sourcePoints, vtkPoints* targetPoints );
+
+    // VTK_LANDMARK_RIGIDBODY or VTK_LANDMARK_SIMILARITY
+    vtkSetMacro( Mode, int );
+    vtkGetMacro( Mode, int );
+    void SetModeToRigidBody() { this->SetMode( VTK_LANDMARK_RIGIDBODY ); };
+    void SetModeToSimilarity() { this->SetMode( VTK_LANDMARK_SIMILARITY ); };
+
+    // Source to target transform
+    void GetMatrix( vtkMatrix4x4* matrix );
+
+    // Root mean square distance between the transformed source points and the target points
+    double GetRootMeanSquareError();
+
+    // True if the point list has at most one principal axis with an eigenvalue
+    // of the covariance matrix above the threshold
+    bool IsSourceCollinear( double eigenvalueThreshold );
+    bool IsTargetCollinear( double eigenvalueThreshold );
+
+    int GetNumberOfPoints() { return this->NumberOfPoints; };
+
+  protected:
+    vtkIncrementalLandmarkRegistration();
+    ~vtkIncrementalLandmarkRegistration();
+
+  private:
+    int Mode;
+
+    // Coordinates of the point lists as of the last SetLandmarks call (x, y, z for each point)
+    std::vector< double > SourceCoordinates;
+    std::vector< double > TargetCoordinates;
+
+    // Means and sums of products of the deviations from the means
+    int NumberOfPoints;
+    double SourceMean[ 3 ];
+    double TargetMean[ 3 ];
+    double SourceCoMoment[ 3 ][ 3 ]; // sum of (source - SourceMean)(source - SourceMean)^T
+    double TargetCoMoment[ 3 ][ 3 ];
+    double CrossCoMoment[ 3 ][ 3 ]; // sum of (source - SourceMean)(target - TargetMean)^T
+
+    // Rounding errors accumulate with incremental updates, so the sums are
+    // recomputed from scratch after a number of them
+    int NumberOfIncrementalUpdates;
+
+    void ResetSums();
+    void RecomputeSums();
+    void AddPair( const double* sourcePoint, const double* targetPoint );
+    void RemovePair( const double* sourcePoint, const double* targetPoint );
+    void ComputeRotationAndScale( double rotation[ 3 ][ 3 ], double& scale );
+    static bool IsCollinear( double coMoment[ 3 ][ 3 ], int numberOfPoints, double eigenvalueThreshold );
+
+    // Not implemented:
+    vtkIncrementalLandmarkRegistration( const vtkIncrementalLandmarkRegistration& );
+    void operator=( const vtkIncrementalLandmarkRegistration& );
+};
+
+#endif
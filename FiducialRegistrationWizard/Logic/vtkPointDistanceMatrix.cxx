@@ -4,6 +4,8 @@
 #include <vtkMath.h>
 #include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
 
+#include <algorithm>
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro( vtkPointDistanceMatrix );
 
@@ -12,7 +14,6 @@ vtkPointDistanceMatrix::vtkPointDistanceMatrix()
 {
   this->PointList1 = NULL;
   this->PointList2 = NULL;
-  this->DistanceMatrix = vtkSmartPointer< vtkDoubleArray >::New();
 }
 
 //------------------------------------------------------------------------------
@@ -66,7 +67,23 @@ double vtkPointDistanceMatrix::GetDistance( int pointList1Index, int pointList2I
     return 0.0;
   }
 
-  return this->DistanceMatrix->GetComponent( pointList1Index, pointList2Index );
+  return this->Distances[ pointList1Index * pointList2Length + pointList2Index ];
+}
+
+//------------------------------------------------------------------------------
+const double* vtkPointDistanceMatrix::GetDistances()
+{
+  if ( UpdateNeeded()  )
+  {
+    Update();
+  }
+
+  if ( this->PointList1 == NULL || this->PointList2 == NULL || this->Distances.empty() )
+  {
+    return NULL;
+  }
+
+  return &this->Distances[ 0 ];
 }
 
 //------------------------------------------------------------------------------
@@ -82,60 +99,54 @@ double vtkPointDistanceMatrix::GetMinimumDistance()
     vtkWarningMacro( "Point list 1 is null. Returning 0." )
     return 0.0;
   }
-  int pointList1Length = this->PointList1->GetNumberOfPoints();
 
   if ( this->PointList2 == NULL )
   {
     vtkWarningMacro( "Point list 2 is null. Returning 0." )
     return 0.0;
   }
-  int pointList2Length = this->PointList2->GetNumberOfPoints();
-  
-  if ( this->DistanceMatrix->GetNumberOfTuples() == 0 )
+
+  if ( this->Distances.empty() )
   {
     vtkGenericWarningMacro( "Matrix has no contents. Returning 0." )
     return 0.0;
   }
 
-  double minDistance = GetDistance( 0, 0 );
-  for ( int pointList1Index = 0; pointList1Index < pointList1Length; pointList1Index++ )
-  {
-    for ( int pointList2Index = 0; pointList2Index < pointList2Length; pointList2Index++ )
-    {
-      double currentDistance = GetDistance( pointList1Index, pointList2Index );
-      if ( currentDistance < minDistance )
-      {
-        minDistance = currentDistance;
-      }
-    }
-  }
+  double minDistance = *std::min_element( this->Distances.begin(), this->Distances.end() );
   return minDistance;
 }
 
 //------------------------------------------------------------------------------
 void vtkPointDistanceMatrix::SetPointList1( vtkPoints* points )
 {
+  if ( this->PointList1 == points )
+  {
+    return;
+  }
   this->PointList1 = points;
+  this->Modified();
 }
 
 //------------------------------------------------------------------------------
 void vtkPointDistanceMatrix::SetPointList2( vtkPoints* points )
 {
-  this->PointList2 = points ;
+  if ( this->PointList2 == points )
+  {
+    return;
+  }
+  this->PointList2 = points;
+  this->Modified();
 }
 
 //------------------------------------------------------------------------------
 void vtkPointDistanceMatrix::Update()
 {
-  
   if ( this->PointList2 == NULL )
   {
     vtkWarningMacro( "Point list 2 is null. Cannot update." )
     return;
   }
   int pointList2Length = this->PointList2->GetNumberOfPoints();
-  this->DistanceMatrix->SetNumberOfComponents( pointList2Length );
-  // (number of components must be set before number of tuples)
 
   if ( this->PointList1 == NULL )
   {
@@ -143,19 +154,33 @@ void vtkPointDistanceMatrix::Update()
     return;
   }
   int pointList1Length = this->PointList1->GetNumberOfPoints();
-  this->DistanceMatrix->SetNumberOfTuples( pointList1Length );
+  this->Distances.resize( pointList1Length * pointList2Length );
+
+  // Coordinates of list 2 are copied to separate contiguous arrays once, so that the
+  // inner loop has no virtual calls and the compiler can vectorize it
+  std::vector< double > pointList2X( pointList2Length );
+  std::vector< double > pointList2Y( pointList2Length );
+  std::vector< double > pointList2Z( pointList2Length );
+  for ( int pointList2Index = 0; pointList2Index < pointList2Length; pointList2Index++ )
+  {
+    double pointInList2[ 3 ];
+    this->PointList2->GetPoint( pointList2Index, pointInList2 );
+    pointList2X[ pointList2Index ] = pointInList2[ 0 ];
+    pointList2Y[ pointList2Index ] = pointInList2[ 1 ];
+    pointList2Z[ pointList2Index ] = pointInList2[ 2 ];
+  }
 
   for ( int pointList1Index = 0; pointList1Index < pointList1Length; pointList1Index++ )
   {
+    double pointInList1[ 3 ];
+    this->PointList1->GetPoint( pointList1Index, pointInList1 );
+    int rowOffset = pointList1Index * pointList2Length;
     for ( int pointList2Index = 0; pointList2Index < pointList2Length; pointList2Index++ )
     {
-      double pointInList1[ 3 ];
-      this->PointList1->GetPoint( pointList1Index, pointInList1 );
-      double pointInList2[ 3 ];
-      this->PointList2->GetPoint( pointList2Index, pointInList2 );
-      double distanceSquared = vtkMath::Distance2BetweenPoints( pointInList1, pointInList2 );
-      double distance = sqrt( distanceSquared );
-      this->DistanceMatrix->SetComponent( pointList1Index, pointList2Index, distance );
+      double dx = pointList2X[ pointList2Index ] - pointInList1[ 0 ];
+      double dy = pointList2Y[ pointList2Index ] - pointInList1[ 1 ];
+      double dz = pointList2Z[ pointList2Index ] - pointInList1[ 2 ];
+      this->Distances[ rowOffset + pointList2Index ] = sqrt( dx * dx + dy * dy + dz * dz );
     }
   }
 
@@ -250,15 +275,17 @@ void vtkPointDistanceMatrix::ComputePairWiseDifferences( vtkPointDistanceMatrix*
   int pointList2Length = matrix1PointList2->GetNumberOfPoints();
   outputArray->SetNumberOfComponents( pointList2Length );
   outputArray->SetNumberOfTuples( pointList1Length );
-  for ( int pointList1Index = 0; pointList1Index < pointList1Length; pointList1Index++ )
+  const double* distancesFromMatrix1 = matrix1->GetDistances();
+  const double* distancesFromMatrix2 = matrix2->GetDistances();
+  if ( distancesFromMatrix1 == NULL || distancesFromMatrix2 == NULL )
   {
-    for ( int pointList2Index = 0; pointList2Index < pointList2Length; pointList2Index++ )
-    {
-      double distanceFromMatrix1 = matrix1->GetDistance( pointList1Index, pointList2Index );
-      double distanceFromMatrix2 = matrix2->GetDistance( pointList1Index, pointList2Index );
-      double differenceOfDistances = distanceFromMatrix2 - distanceFromMatrix1;
-      outputArray->SetComponent( pointList1Index, pointList2Index, differenceOfDistances );
-    }
+    return;
+  }
+  double* differencesOfDistances = outputArray->GetPointer( 0 );
+  int numberOfDistances = pointList1Length * pointList2Length;
+  for ( int distanceIndex = 0; distanceIndex < numberOfDistances; distanceIndex++ )
+  {
+    differencesOfDistances[ distanceIndex ] = distancesFromMatrix2[ distanceIndex ] - distancesFromMatrix1[ distanceIndex ];
   }
 }
 
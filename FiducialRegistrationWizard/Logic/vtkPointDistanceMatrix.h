@@ -6,11 +6,13 @@
 #include <vtkPoints.h>
 #include <vtkTimeStamp.h>
 
+#include <vector>
+
 // export
 #include "vtkSlicerFiducialRegistrationWizardModuleLogicExport.h"
 
 // At its most basic level, this is a Wrapper class for storing a matrix of
-// point to point distances in a vtkDoubleArray.
+// point to point distances in a contiguous row-major buffer.
 // The purpose is to improve the abstraction of storing distances, instead of
 // memorizing how distances are accessed etc... One can use this class to
 // encapsulate that functionality.
@@ -30,6 +32,11 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointDistance
     vtkPoints* GetPointList2();
     double GetDistance( int list1Index, int list2Index );
     double GetMinimumDistance();
+
+    // Row-major distances (list 1 points by list 2 points), updated if needed.
+    // Meant for inner loops that cannot afford a call per distance.
+    // The pointer is invalidated by the next update. Returns NULL if the matrix is empty.
+    const double* GetDistances();
     void Update();
 
     // compute pair-wise difference between two point distance matrices.
@@ -43,7 +50,7 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointDistance
   private:
     vtkPoints* PointList1;
     vtkPoints* PointList2;
-    vtkSmartPointer< vtkDoubleArray > DistanceMatrix;
+    std::vector< double > Distances;
 
     vtkTimeStamp MatrixUpdateTime;
     bool UpdateNeeded();
@@ -1,6 +1,8 @@
 #include "vtkPointMatcher.h"
-#include "vtkCombinatoricGenerator.h"
 #include <vtkMath.h>
+#include <vtkNew.h>
+
+#include <algorithm>
 
 #define RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR VTK_DOUBLE_MAX
 #define MINIMUM_NUMBER_OF_POINTS_NEEDED_TO_MATCH 3
@@ -8,6 +10,50 @@
 //----------------------------------------------------------------------------
 vtkStandardNewMacro( vtkPointMatcher );
 
+//------------------------------------------------------------------------------
+// Distances from each point to all points of the same list, sorted for each point.
+// Corresponding points of the two lists have similar signatures, whatever the order of the points.
+static void ComputeDistanceSignatures( const double* distances, int numberOfPoints, std::vector< double >& signatures )
+{
+  signatures.assign( distances, distances + numberOfPoints * numberOfPoints );
+  for ( int index = 0; index < numberOfPoints; index++ )
+  {
+    std::sort( signatures.begin() + index * numberOfPoints, signatures.begin() + ( index + 1 ) * numberOfPoints );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Number of points of the list if its first points are the given coordinates, -1 otherwise
+static int GetNumberOfPointsStartingWith( vtkPoints* points, const std::vector< double >& coordinates )
+{
+  int numberOfPoints = points->GetNumberOfPoints();
+  int numberOfKnownPoints = coordinates.size() / 3;
+  if ( numberOfPoints < numberOfKnownPoints )
+  {
+    return -1;
+  }
+  for ( int pointIndex = 0; pointIndex < numberOfKnownPoints; pointIndex++ )
+  {
+    double point[ 3 ];
+    points->GetPoint( pointIndex, point );
+    if ( point[ 0 ] != coordinates[ 3 * pointIndex ] || point[ 1 ] != coordinates[ 3 * pointIndex + 1 ] || point[ 2 ] != coordinates[ 3 * pointIndex + 2 ] )
+    {
+      return -1;
+    }
+  }
+  return numberOfPoints;
+}
+
+//------------------------------------------------------------------------------
+static double GetDistanceBetweenPoints( vtkPoints* points, int pointIndex1, int pointIndex2 )
+{
+  double point1[ 3 ];
+  double point2[ 3 ];
+  points->GetPoint( pointIndex1, point1 );
+  points->GetPoint( pointIndex2, point2 );
+  return sqrt( vtkMath::Distance2BetweenPoints( point1, point2 ) );
+}
+
 //------------------------------------------------------------------------------
 vtkPointMatcher::vtkPointMatcher()
 {
@@ -16,12 +62,19 @@ vtkPointMatcher::vtkPointMatcher()
   this->MaximumDifferenceInNumberOfPoints = 2;
   this->TolerableRootMeanSquareDistanceErrorMm = 10.0;
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
   this->AmbiguityThresholdDistanceMm = 5.0;
   this->MatchingAmbiguous = false;
+  this->UseMultithreading = false;
   // outputs are never null
   this->OutputPointList1 = vtkSmartPointer< vtkPoints >::New();
   this->OutputPointList2 = vtkSmartPointer< vtkPoints >::New();
 
+  this->PointList1DistanceMatrix = vtkSmartPointer< vtkPointDistanceMatrix >::New();
+  this->PointList2DistanceMatrix = vtkSmartPointer< vtkPointDistanceMatrix >::New();
+  this->PointList1Distances = NULL;
+  this->PointList2Distances = NULL;
+
   // timestamps for input and output are the same, initially
   this->Modified();
   this->OutputChangedTime.Modified();
@@ -42,6 +95,7 @@ void vtkPointMatcher::PrintSelf( std::ostream &os, vtkIndent indent )
   os << indent << "ComputedRootMeanSquareDistanceErrorMm: " << this->ComputedRootMeanSquareDistanceErrorMm << std::endl;
   os << indent << "IsMatchingWithinTolerance: " << this->IsMatchingWithinTolerance() << std::endl;
   os << indent << "IsMatchingAmbiguous" << this->IsMatchingAmbiguous() << std::endl;
+  os << indent << "UseMultithreading: " << this->UseMultithreading << std::endl;
   os << indent << "UpdateNeeded: " << this->UpdateNeeded() << std::endl;
 }
 
@@ -55,6 +109,7 @@ void vtkPointMatcher::SetInputPointList1( vtkPoints* points )
   vtkSetObjectBodyMacro( InputPointList1, vtkPoints, points );
   // mean distance error has not been computed yet. Set to maximum possible value for now
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
 }
 
 //------------------------------------------------------------------------------
@@ -63,33 +118,52 @@ void vtkPointMatcher::SetInputPointList2( vtkPoints* points )
   vtkSetObjectBodyMacro( InputPointList2, vtkPoints, points );
   // mean distance error has not been computed yet. Set to maximum possible value for now
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
 }
 
 //------------------------------------------------------------------------------
 void vtkPointMatcher::SetMaximumDifferenceInNumberOfPoints( unsigned int numberOfPoints )
 {
+  if ( this->MaximumDifferenceInNumberOfPoints == numberOfPoints )
+  {
+    return;
+  }
   this->MaximumDifferenceInNumberOfPoints = numberOfPoints;
   this->Modified();
+  this->ClearMatchedInputs(); // the previous matching may not be acceptable with the new parameter
   // mean distance error has not been computed yet. Set to maximum possible value for now
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
 }
 
 //------------------------------------------------------------------------------
 void vtkPointMatcher::SetTolerableRootMeanSquareDistanceErrorMm( double errorMm )
 {
+  if ( this->TolerableRootMeanSquareDistanceErrorMm == errorMm )
+  {
+    return;
+  }
   this->TolerableRootMeanSquareDistanceErrorMm = errorMm;
   this->Modified();
+  this->ClearMatchedInputs(); // the previous matching may not be acceptable with the new parameter
   // mean distance error has not been computed yet. Set to maximum possible value for now
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
 }
 
 //------------------------------------------------------------------------------
 void vtkPointMatcher::SetAmbiguityThresholdDistanceMm( double thresholdMm )
 {
+  if ( this->AmbiguityThresholdDistanceMm == thresholdMm )
+  {
+    return;
+  }
   this->AmbiguityThresholdDistanceMm = thresholdMm;
   this->Modified();
+  this->ClearMatchedInputs(); // the previous matching may not be acceptable with the new parameter
   // mean distance error has not been computed yet. Set to maximum possible value for now
   this->ComputedRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  this->SecondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
 }
 
 //------------------------------------------------------------------------------
@@ -151,6 +225,18 @@ bool vtkPointMatcher::IsMatchingAmbiguous()
   return this->MatchingAmbiguous;
 }
 
+//------------------------------------------------------------------------------
+bool vtkPointMatcher::GetLastMatchedPointIndices( std::vector< int >& pointList1Indices, std::vector< int >& pointList2Indices )
+{
+  if ( this->MatchedPointList1Indices.empty() )
+  {
+    return false;
+  }
+  pointList1Indices = this->MatchedPointList1Indices;
+  pointList2Indices = this->MatchedPointList2Indices;
+  return true;
+}
+
 //------------------------------------------------------------------------------
 // LOGIC
 //------------------------------------------------------------------------------
@@ -184,10 +270,18 @@ void vtkPointMatcher::Update()
     // no matching to do... though there should be a more elegant way to handle this
     // situation that produces at least some kind of matching, even if it is a bad one.
     // TODO: Copy inputs to outputs, then truncate the longer one.
+    this->ClearMatchedInputs();
     this->OutputChangedTime.Modified();
     return;
   }
 
+  if ( this->UpdateMatchingWithAddedPoint() )
+  {
+    this->OutputChangedTime.Modified();
+    return;
+  }
+  this->ClearMatchedInputs();
+
   // determine which list is larger, which list is smaller
   vtkPoints* largerPointsList = NULL; // temporary value
   vtkPoints* smallerPointsList = NULL; // temporary value
@@ -217,221 +311,498 @@ void vtkPointMatcher::Update()
     }
   }
 
+  // flag ambiguous if another matching is within some threshold of the best one
+  this->MatchingAmbiguous = ( this->SecondBestRootMeanSquareDistanceErrorMm != RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR &&
+    this->SecondBestRootMeanSquareDistanceErrorMm - this->ComputedRootMeanSquareDistanceErrorMm <= this->AmbiguityThresholdDistanceMm );
+
+  if ( this->ComputedRootMeanSquareDistanceErrorMm <= this->TolerableRootMeanSquareDistanceErrorMm && !this->MatchingAmbiguous )
+  {
+    this->StoreMatchedInputs();
+  }
+  else
+  {
+    this->ClearMatchedInputs();
+  }
+
   this->OutputChangedTime.Modified();
 }
 
 //------------------------------------------------------------------------------
-void vtkPointMatcher::UpdateBestMatchingForAllSubsetsOfPoints( int sizeOfSubset )
+void vtkPointMatcher::StoreMatchedInputs()
+{
+  vtkPoints* inputPointLists[ 2 ] = { this->InputPointList1, this->InputPointList2 };
+  std::vector< double >* coordinates[ 2 ] = { &this->MatchedInputPointList1Coordinates, &this->MatchedInputPointList2Coordinates };
+  for ( int listIndex = 0; listIndex < 2; listIndex++ )
+  {
+    int numberOfPoints = inputPointLists[ listIndex ]->GetNumberOfPoints();
+    coordinates[ listIndex ]->resize( 3 * numberOfPoints );
+    for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+    {
+      inputPointLists[ listIndex ]->GetPoint( pointIndex, &( *coordinates[ listIndex ] )[ 3 * pointIndex ] );
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPointMatcher::ClearMatchedInputs()
 {
-  // generate sets of indices for all possible combinations of both input sets
-  vtkSmartPointer< vtkCombinatoricGenerator > pointList1CombinationGenerator = vtkSmartPointer< vtkCombinatoricGenerator >::New();
-  pointList1CombinationGenerator->SetCombinatoricToCombination();
-  pointList1CombinationGenerator->SetSubsetSize( sizeOfSubset );
-  pointList1CombinationGenerator->SetNumberOfInputSets( 1 );
-  for ( int pointIndex = 0; pointIndex < this->InputPointList1->GetNumberOfPoints(); pointIndex++ )
+  this->MatchedPointList1Indices.clear();
+  this->MatchedPointList2Indices.clear();
+  this->MatchedInputPointList1Coordinates.clear();
+  this->MatchedInputPointList2Coordinates.clear();
+}
+
+//------------------------------------------------------------------------------
+// Extend the matching of the last update with a point that has been appended to one of the input lists,
+// by pairing it with the unmatched point of the other list that gives the smallest error.
+// The previous matching was within tolerance and not ambiguous, so the other pairs are trusted, and the
+// extension is only ambiguous if another pairing of the new point is within AmbiguityThresholdDistanceMm.
+// Returns false if the inputs changed otherwise or the extended matching is not acceptable,
+// in which case the full search has to be performed.
+bool vtkPointMatcher::UpdateMatchingWithAddedPoint()
+{
+  if ( this->MatchedPointList1Indices.empty() )
   {
-    pointList1CombinationGenerator->AddInputElement( 0, pointIndex );
+    return false;
+  }
+  int pointList1Size = GetNumberOfPointsStartingWith( this->InputPointList1, this->MatchedInputPointList1Coordinates );
+  int pointList2Size = GetNumberOfPointsStartingWith( this->InputPointList2, this->MatchedInputPointList2Coordinates );
+  int previousPointList1Size = this->MatchedInputPointList1Coordinates.size() / 3;
+  int previousPointList2Size = this->MatchedInputPointList2Coordinates.size() / 3;
+  bool pointAddedToList1 = ( pointList1Size == previousPointList1Size + 1 && pointList2Size == previousPointList2Size );
+  bool pointAddedToList2 = ( pointList2Size == previousPointList2Size + 1 && pointList1Size == previousPointList1Size );
+  if ( !pointAddedToList1 && !pointAddedToList2 )
+  {
+    return false;
   }
-  pointList1CombinationGenerator->Update();
-  std::vector< std::vector< int > > pointList1CombinationIndices = pointList1CombinationGenerator->GetOutputSets();
 
-  vtkSmartPointer< vtkCombinatoricGenerator > pointList2CombinationGenerator = vtkSmartPointer< vtkCombinatoricGenerator >::New();
-  pointList2CombinationGenerator->SetCombinatoricToCombination();
-  pointList2CombinationGenerator->SetSubsetSize( sizeOfSubset );
-  pointList2CombinationGenerator->SetNumberOfInputSets( 1 );
-  for ( int pointIndex = 0; pointIndex < this->InputPointList2->GetNumberOfPoints(); pointIndex++ )
+  // the full search would try this subset size first
+  int numberOfMatchedPoints = this->MatchedPointList1Indices.size();
+  int sizeOfSubset = numberOfMatchedPoints + 1;
+  if ( sizeOfSubset != std::min( pointList1Size, pointList2Size ) )
   {
-    pointList2CombinationGenerator->AddInputElement( 0, pointIndex );
+    return false;
   }
-  pointList2CombinationGenerator->Update();
-  std::vector< std::vector< int > > pointList2CombinationIndices = pointList2CombinationGenerator->GetOutputSets();
 
-  // these will store the actual combinations of points themselves (not indices)
-  vtkSmartPointer< vtkPoints > pointList1Combination = vtkSmartPointer< vtkPoints >::New();
-  pointList1Combination->SetNumberOfPoints( sizeOfSubset );
-  vtkSmartPointer< vtkPoints > pointList2Combination = vtkSmartPointer< vtkPoints >::New();
-  pointList2Combination->SetNumberOfPoints( sizeOfSubset );
+  // with the new point in list A (the list it was added to), candidates are the unmatched points of list B
+  vtkPoints* pointListA = ( pointAddedToList1 ? this->InputPointList1 : this->InputPointList2 );
+  vtkPoints* pointListB = ( pointAddedToList1 ? this->InputPointList2 : this->InputPointList1 );
+  const std::vector< int >& matchedIndicesA = ( pointAddedToList1 ? this->MatchedPointList1Indices : this->MatchedPointList2Indices );
+  const std::vector< int >& matchedIndicesB = ( pointAddedToList1 ? this->MatchedPointList2Indices : this->MatchedPointList1Indices );
+  int addedPointIndex = pointListA->GetNumberOfPoints() - 1;
 
-  // iterate over all combinations of both input point sets
-  for ( unsigned int pointList1CombinationIndex = 0; pointList1CombinationIndex < pointList1CombinationIndices.size(); pointList1CombinationIndex++ )
+  double sumOfSquaredDistanceErrors = 0.0;
+  for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
   {
-    for ( unsigned int pointList2CombinationIndex = 0; pointList2CombinationIndex < pointList2CombinationIndices.size(); pointList2CombinationIndex++ )
+    for ( int otherMatchedIndex = matchedIndex + 1; otherMatchedIndex < numberOfMatchedPoints; otherMatchedIndex++ )
     {
-      // store appropriate contents in the pointList1Combination and pointList2Combination variables
-      for ( vtkIdType pointIndex = 0; pointIndex < sizeOfSubset; pointIndex++ )
-      {
-        vtkIdType point1Index = ( vtkIdType ) pointList1CombinationIndices[ pointList1CombinationIndex ][ pointIndex ];
-        double* pointFromList1 = this->InputPointList1->GetPoint( point1Index );
-        pointList1Combination->SetPoint( pointIndex, pointFromList1 );
+      double distanceError = GetDistanceBetweenPoints( pointListA, matchedIndicesA[ matchedIndex ], matchedIndicesA[ otherMatchedIndex ] )
+        - GetDistanceBetweenPoints( pointListB, matchedIndicesB[ matchedIndex ], matchedIndicesB[ otherMatchedIndex ] );
+      sumOfSquaredDistanceErrors += 2.0 * distanceError * distanceError; // the distance matrix is symmetric
+    }
+  }
 
-        vtkIdType point2Index = ( vtkIdType ) pointList2CombinationIndices[ pointList2CombinationIndex ][ pointIndex ];
-        double* pointFromList2 = this->InputPointList2->GetPoint( point2Index );
-        pointList2Combination->SetPoint( pointIndex, pointFromList2 );
-      }
-      // finally see how good this particular combination is
-      this->UpdateBestMatchingForSubsetOfPoints( pointList1Combination, pointList2Combination );
+  std::vector< bool > pointListBIndexMatched( pointListB->GetNumberOfPoints(), false );
+  for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
+  {
+    pointListBIndexMatched[ matchedIndicesB[ matchedIndex ] ] = true;
+  }
+  int bestPointListBIndex = -1;
+  double bestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  double secondBestRootMeanSquareDistanceErrorMm = RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+  for ( int pointListBIndex = 0; pointListBIndex < pointListB->GetNumberOfPoints(); pointListBIndex++ )
+  {
+    if ( pointListBIndexMatched[ pointListBIndex ] )
+    {
+      continue;
+    }
+    double candidateSumOfSquaredDistanceErrors = sumOfSquaredDistanceErrors;
+    for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
+    {
+      double distanceError = GetDistanceBetweenPoints( pointListA, addedPointIndex, matchedIndicesA[ matchedIndex ] )
+        - GetDistanceBetweenPoints( pointListB, pointListBIndex, matchedIndicesB[ matchedIndex ] );
+      candidateSumOfSquaredDistanceErrors += 2.0 * distanceError * distanceError;
+    }
+    double rootMeanSquareDistanceErrorMm = sqrt( candidateSumOfSquaredDistanceErrors / ( sizeOfSubset * sizeOfSubset ) );
+    if ( rootMeanSquareDistanceErrorMm < bestRootMeanSquareDistanceErrorMm )
+    {
+      secondBestRootMeanSquareDistanceErrorMm = bestRootMeanSquareDistanceErrorMm;
+      bestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+      bestPointListBIndex = pointListBIndex;
     }
+    else if ( rootMeanSquareDistanceErrorMm < secondBestRootMeanSquareDistanceErrorMm )
+    {
+      secondBestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+    }
+  }
+
+  if ( bestPointListBIndex < 0 || bestRootMeanSquareDistanceErrorMm > this->TolerableRootMeanSquareDistanceErrorMm
+    || ( secondBestRootMeanSquareDistanceErrorMm != RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR &&
+         secondBestRootMeanSquareDistanceErrorMm - bestRootMeanSquareDistanceErrorMm <= this->AmbiguityThresholdDistanceMm ) )
+  {
+    return false;
   }
+
+  this->MatchedPointList1Indices.push_back( pointAddedToList1 ? addedPointIndex : bestPointListBIndex );
+  this->MatchedPointList2Indices.push_back( pointAddedToList1 ? bestPointListBIndex : addedPointIndex );
+  double point[ 3 ];
+  this->InputPointList1->GetPoint( this->MatchedPointList1Indices.back(), point );
+  this->OutputPointList1->InsertNextPoint( point );
+  this->InputPointList2->GetPoint( this->MatchedPointList2Indices.back(), point );
+  this->OutputPointList2->InsertNextPoint( point );
+  this->OutputPointList1->Modified();
+  this->OutputPointList2->Modified();
+  this->ComputedRootMeanSquareDistanceErrorMm = bestRootMeanSquareDistanceErrorMm;
+  this->SecondBestRootMeanSquareDistanceErrorMm = secondBestRootMeanSquareDistanceErrorMm;
+  this->MatchingAmbiguous = false;
+  this->StoreMatchedInputs();
+  return true;
 }
 
 //------------------------------------------------------------------------------
-// point pair matching will be based on the distances between each pair of ordered points.
-// we have an input reference point list and a compare point list. We want to reorder
-// the compare list such that the point-to-point distances are as close as possible to those 
-// in the reference list. We will permute over all possibilities (and only ever keep the best result.)
-void vtkPointMatcher::UpdateBestMatchingForSubsetOfPoints( vtkPoints* pointSubset1, vtkPoints* pointSubset2 )
+struct vtkPointMatcher::MatchingSearchJob
+{
+  vtkPointMatcher* Matcher;
+  int SizeOfSubset;
+  int NumberOfFirstPairs;
+  std::vector< MatchingSearchState > States; // one for each thread
+};
+
+//------------------------------------------------------------------------------
+// Find the best matching that pairs sizeOfSubset points of list 1 with sizeOfSubset points of list 2.
+// Instead of enumerating all combinations and permutations, the matching is grown one pair
+// at a time (points of list 1 in increasing index order, each either paired with an unused
+// point of list 2 or skipped). The sum of squared distance errors can only increase as pairs
+// are added, so a partial matching is abandoned as soon as its error cannot be within
+// AmbiguityThresholdDistanceMm of the best matching found so far. Such matchings can neither
+// become the best matching nor make it ambiguous, so the result is the same as the one of
+// the exhaustive search.
+// With multithreading, the first pair of the matching is chosen in the job and the threads
+// complete them independently. Each thread keeps its own best and second best matching, and
+// these are merged at the end. Matchings of equal error are ordered by their indices, so the
+// merged result does not depend on which thread found what.
+void vtkPointMatcher::UpdateBestMatchingForAllSubsetsOfPoints( int sizeOfSubset )
 {
-  // error checking
-  if ( pointSubset1 == NULL )
+  int pointList1Size = this->InputPointList1->GetNumberOfPoints();
+  int pointList2Size = this->InputPointList2->GetNumberOfPoints();
+  if ( sizeOfSubset <= 0 || sizeOfSubset > pointList1Size || sizeOfSubset > pointList2Size )
   {
-    vtkGenericWarningMacro( "Reference point set is NULL. This is a coding error. Please report." );
     return;
   }
 
-  if ( pointSubset2 == NULL )
+  // point to point distances within each list, only recomputed when the points change
+  this->PointList1DistanceMatrix->SetPointList1( this->InputPointList1 );
+  this->PointList1DistanceMatrix->SetPointList2( this->InputPointList1 );
+  this->PointList1Distances = this->PointList1DistanceMatrix->GetDistances();
+  this->PointList2DistanceMatrix->SetPointList1( this->InputPointList2 );
+  this->PointList2DistanceMatrix->SetPointList2( this->InputPointList2 );
+  this->PointList2Distances = this->PointList2DistanceMatrix->GetDistances();
+  ComputeDistanceSignatures( this->PointList1Distances, pointList1Size, this->PointList1DistanceSignatures );
+  ComputeDistanceSignatures( this->PointList2Distances, pointList2Size, this->PointList2DistanceSignatures );
+
+  MatchingSearchState initialState;
+  initialState.PointList2IndexUsed.assign( pointList2Size, false );
+  initialState.BestRootMeanSquareDistanceErrorMm = this->ComputedRootMeanSquareDistanceErrorMm;
+  initialState.SecondBestRootMeanSquareDistanceErrorMm = this->SecondBestRootMeanSquareDistanceErrorMm;
+  // a good matching to start from makes the bound tight before the search begins
+  this->UpdateBestMatchingFromDistanceSignatures( initialState, sizeOfSubset );
+
+  int numberOfPointList1PointsToSkip = pointList1Size - sizeOfSubset;
+  int numberOfFirstPairs = ( numberOfPointList1PointsToSkip + 1 ) * pointList2Size;
+  int numberOfThreads = 1;
+  if ( this->UseMultithreading )
   {
-    vtkGenericWarningMacro( "Compare point set is NULL. This is a coding error. Please report." );
-    return;
+    numberOfThreads = std::min( numberOfFirstPairs, vtkMultiThreader::GetGlobalDefaultNumberOfThreads() );
+  }
+
+  MatchingSearchState resultState;
+  if ( numberOfThreads > 1 )
+  {
+    MatchingSearchJob job;
+    job.Matcher = this;
+    job.SizeOfSubset = sizeOfSubset;
+    job.NumberOfFirstPairs = numberOfFirstPairs;
+    job.States.assign( numberOfThreads, initialState );
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads( numberOfThreads );
+    threader->SetSingleMethod( vtkPointMatcher::MatchingSearchThreadFunction, &job );
+    threader->SingleMethodExecute();
+
+    resultState = job.States[ 0 ];
+    for ( int threadIndex = 1; threadIndex < numberOfThreads; threadIndex++ )
+    {
+      vtkPointMatcher::MergeMatchingSearchStates( resultState, job.States[ threadIndex ] );
+    }
+  }
+  else
+  {
+    resultState = initialState;
+    this->UpdateBestMatchingFromPartialMatching( resultState, 0, numberOfPointList1PointsToSkip, 0.0, sizeOfSubset );
   }
 
-  int numberOfPoints = pointSubset1->GetNumberOfPoints(); // sizes of both lists should be identical
-  if ( numberOfPoints != pointSubset2->GetNumberOfPoints() )
+  this->ComputedRootMeanSquareDistanceErrorMm = resultState.BestRootMeanSquareDistanceErrorMm;
+  this->SecondBestRootMeanSquareDistanceErrorMm = resultState.SecondBestRootMeanSquareDistanceErrorMm;
+  if ( resultState.BestPointList1Indices.empty() )
   {
-    vtkGenericWarningMacro( "Point sets are of different sizes. This is a coding error. Please report." );
+    // the matching found for a larger subset size is still the best
     return;
   }
+  this->MatchedPointList1Indices = resultState.BestPointList1Indices;
+  this->MatchedPointList2Indices = resultState.BestPointList2Indices;
+  int numberOfMatchedPoints = resultState.BestPointList1Indices.size();
+  this->OutputPointList1->SetNumberOfPoints( numberOfMatchedPoints );
+  this->OutputPointList2->SetNumberOfPoints( numberOfMatchedPoints );
+  for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
+  {
+    double point[ 3 ];
+    this->InputPointList1->GetPoint( resultState.BestPointList1Indices[ matchedIndex ], point );
+    this->OutputPointList1->SetPoint( matchedIndex, point );
+    this->InputPointList2->GetPoint( resultState.BestPointList2Indices[ matchedIndex ], point );
+    this->OutputPointList2->SetPoint( matchedIndex, point );
+  }
+}
 
-  // Point distance matrix
-  vtkSmartPointer< vtkPointDistanceMatrix > pointSubset1DistanceMatrix = vtkSmartPointer< vtkPointDistanceMatrix >::New();
-  pointSubset1DistanceMatrix->SetPointList1( pointSubset1 );
-  pointSubset1DistanceMatrix->SetPointList2( pointSubset1 ); // distances to itself
-  pointSubset1DistanceMatrix->Update();
+//------------------------------------------------------------------------------
+// Propose a matching by pairing the points with the most similar distance signatures first.
+// This takes O(N^2 log N) time and usually finds the correct matching when the point lists
+// are similar; the search then only has to confirm it and check for ambiguity.
+void vtkPointMatcher::UpdateBestMatchingFromDistanceSignatures( MatchingSearchState& state, int sizeOfSubset )
+{
+  int pointList1Size = this->InputPointList1->GetNumberOfPoints();
+  int pointList2Size = this->InputPointList2->GetNumberOfPoints();
 
-  // compute the permutations, store them in a vtkIntArray.
-  vtkSmartPointer< vtkCombinatoricGenerator > combinatoricGenerator = vtkSmartPointer< vtkCombinatoricGenerator >::New();
-  combinatoricGenerator->SetCombinatoricToPermutation();
-  combinatoricGenerator->SetSubsetSize( numberOfPoints );
-  combinatoricGenerator->SetNumberOfInputSets( 1 );
-  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  // compare the shortest distances, these are the least affected by extra or missing points
+  int signatureLength = std::min( pointList1Size, pointList2Size );
+  std::vector< std::pair< double, std::pair< int, int > > > pairs;
+  pairs.reserve( pointList1Size * pointList2Size );
+  for ( int pointList1Index = 0; pointList1Index < pointList1Size; pointList1Index++ )
   {
-    combinatoricGenerator->AddInputElement( 0, pointIndex );
+    const double* signature1 = &this->PointList1DistanceSignatures[ pointList1Index * pointList1Size ];
+    for ( int pointList2Index = 0; pointList2Index < pointList2Size; pointList2Index++ )
+    {
+      const double* signature2 = &this->PointList2DistanceSignatures[ pointList2Index * pointList2Size ];
+      double signatureDifference = 0.0;
+      for ( int signatureIndex = 0; signatureIndex < signatureLength; signatureIndex++ )
+      {
+        signatureDifference += fabs( signature1[ signatureIndex ] - signature2[ signatureIndex ] );
+      }
+      pairs.push_back( std::make_pair( signatureDifference, std::make_pair( pointList1Index, pointList2Index ) ) );
+    }
   }
-  combinatoricGenerator->Update();
-  std::vector< std::vector< int > > pointSubset2IndexPermutations = combinatoricGenerator->GetOutputSets();
-
-  // iterate over all permutations - look for the most 'suitable'
-  // point matching that gives distances most similar to the reference
+  std::sort( pairs.begin(), pairs.end() );
 
-  // create + allocate the permuted compare list once outside
-  // the loop to avoid allocation/deallocation time costs.
-  vtkSmartPointer< vtkPoints > permutedPointSubset2 = vtkSmartPointer< vtkPoints >::New();
-  permutedPointSubset2->DeepCopy( pointSubset2 ); // fill it with placeholder data, same size as compareList
-  vtkSmartPointer< vtkPointDistanceMatrix > permutedPointSubset2DistanceMatrix = vtkSmartPointer< vtkPointDistanceMatrix >::New();
-  int numberOfPermutations = pointSubset2IndexPermutations.size();
-  for ( int permutationIndex = 0; permutationIndex < numberOfPermutations; permutationIndex++ )
+  std::vector< int > pairedPointList2Indices( pointList1Size, -1 );
+  std::vector< bool > pointList2IndexPaired( pointList2Size, false );
+  int numberOfPairs = 0;
+  for ( unsigned int pairIndex = 0; pairIndex < pairs.size() && numberOfPairs < sizeOfSubset; pairIndex++ )
   {
-    // fill permutedPointSubset2 with points from pointSubset2,
-    // in the order indicate by the permuted indices
-    for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+    int pointList1Index = pairs[ pairIndex ].second.first;
+    int pointList2Index = pairs[ pairIndex ].second.second;
+    if ( pairedPointList2Indices[ pointList1Index ] >= 0 || pointList2IndexPaired[ pointList2Index ] )
     {
-      int permutedPointIndex = pointSubset2IndexPermutations[ permutationIndex][ pointIndex ];
-      double* permutedPoint = pointSubset2->GetPoint( permutedPointIndex );
-      permutedPointSubset2->SetPoint( pointIndex, permutedPoint );
+      continue;
     }
-    permutedPointSubset2DistanceMatrix->SetPointList1( permutedPointSubset2 );
-    permutedPointSubset2DistanceMatrix->SetPointList2( permutedPointSubset2 );
-    permutedPointSubset2DistanceMatrix->Update();
-    double rootMeanSquareDistanceErrorMm = this->ComputeRootMeanSquareistanceErrors( pointSubset1DistanceMatrix, permutedPointSubset2DistanceMatrix );
-
-    // case analysis for setting MatchingAmbiguous:
-    // let ComputedRootMeanSquareDistanceErrorMm store the distance error for the *best* matching
-    // let rootMeanSquareDistanceErrorMm store the distance error for the *current* matching
-    // use AmbiguityThresholdDistanceMm and MatchingAmbiguous as described in the header file
-    // 1
-    // rootMeanSquareDistanceErrorMm is better (lower) than ComputedRootMeanSquareDistanceErrorMm,
-    // but by less than AmbiguityThresholdDistanceMm
-    // Result => MatchingAmbiguous should be set to true
-    //   - trivial justification
-    // 2
-    // rootMeanSquareDistanceErrorMm is worse (higher) than ComputedRootMeanSquareDistanceErrorMm,
-    // but by less than AmbiguityThresholdDistanceMm
-    // Result => MatchingAmbiguous should be set to true
-    //   - trivial justification
-    // 3
-    // rootMeanSquareDistanceErrorMm is better (lower) than ComputedRootMeanSquareDistanceErrorMm,
-    // but by more than AmbiguityThresholdDistanceMm
-    // Result => MatchingAmbiguous should be set to false.
-    //   - If there was a _previous_ rootMeanSquareDistanceErrorMm within AmbiguityThresholdDistanceMm,
-    //     that would have become ComputedRootMeanSquareDistanceErrorMm. Therefore there have not been
-    //     any _previous_ rootMeanSquareDistanceErrorMm within AmbiguityThresholdDistanceMm.
-    //   - If _later_ there is a rootMeanSquareDistanceErrorMm within AmbiguityThresholdDistanceMm,
-    //     then MatchingAmbiguous will be set to true by either case 1 or case 2.
-    //     Cases 1 and 2 will always catch an ambiguous matching, because the search is exhaustive.
-    // 4
-    // rootMeanSquareDistanceErrorMm is worse (higher) than ComputedRootMeanSquareDistanceErrorMm,
-    // but by more than AmbiguityThresholdDistanceMm
-    // Result => do nothing
-    //   - This result does not matter. It *cannot* be within AmbiguityThresholdDistanceMm
-    //     of the best (final) ComputedRootMeanSquareDistanceErrorMm
-
-    // flag ambiguous if suitability within some threshold of the best result so far
-    double differenceComparedToBestMm = this->ComputedRootMeanSquareDistanceErrorMm - rootMeanSquareDistanceErrorMm;
-    bool withinAmbiguityThresholdDistanceMm = ( fabs( differenceComparedToBestMm ) <= this->AmbiguityThresholdDistanceMm );
-
-    // is this the best matching?
-    if ( rootMeanSquareDistanceErrorMm < this->ComputedRootMeanSquareDistanceErrorMm )
+    pairedPointList2Indices[ pointList1Index ] = pointList2Index;
+    pointList2IndexPaired[ pointList2Index ] = true;
+    numberOfPairs++;
+  }
+
+  // the error is summed in the same order as in the search, so that it is exactly the same
+  // when the search visits this matching again
+  double sumOfSquaredDistanceErrors = 0.0;
+  for ( int pointList1Index = 0; pointList1Index < pointList1Size; pointList1Index++ )
+  {
+    int pointList2Index = pairedPointList2Indices[ pointList1Index ];
+    if ( pointList2Index < 0 )
     {
-      if ( withinAmbiguityThresholdDistanceMm )
-      {
-        // case 1, described above
-        this->MatchingAmbiguous = true;
-      }
-      else
-      {
-        // case 3, described above
-        this->MatchingAmbiguous = false;
-      }
-      this->ComputedRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
-      this->OutputPointList1->DeepCopy( pointSubset1 );
-      this->OutputPointList2->DeepCopy( permutedPointSubset2 );
+      continue;
     }
-    else if ( withinAmbiguityThresholdDistanceMm )
+    double addedSquaredDistanceErrors = 0.0;
+    int numberOfMatchedPoints = state.MatchedPointList1Indices.size();
+    for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
     {
-      // case 2, described above
-      this->MatchingAmbiguous = true;
+      double distance1 = this->PointList1Distances[ pointList1Index * pointList1Size + state.MatchedPointList1Indices[ matchedIndex ] ];
+      double distance2 = this->PointList2Distances[ pointList2Index * pointList2Size + state.MatchedPointList2Indices[ matchedIndex ] ];
+      double distanceError = distance1 - distance2;
+      addedSquaredDistanceErrors += 2.0 * distanceError * distanceError;
     }
+    sumOfSquaredDistanceErrors = sumOfSquaredDistanceErrors + addedSquaredDistanceErrors;
+    state.MatchedPointList1Indices.push_back( pointList1Index );
+    state.MatchedPointList2Indices.push_back( pointList2Index );
   }
+  vtkPointMatcher::UpdateBestMatching( state, sqrt( sumOfSquaredDistanceErrors / ( sizeOfSubset * sizeOfSubset ) ) );
+  state.MatchedPointList1Indices.clear();
+  state.MatchedPointList2Indices.clear();
 }
 
 //------------------------------------------------------------------------------
-double vtkPointMatcher::ComputeRootMeanSquareistanceErrors( vtkPointDistanceMatrix* distanceMatrix1, vtkPointDistanceMatrix* distanceMatrix2 )
+VTK_THREAD_RETURN_TYPE vtkPointMatcher::MatchingSearchThreadFunction( void* ptr )
 {
-  if ( distanceMatrix1 == NULL || distanceMatrix2 == NULL )
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+  MatchingSearchJob* job = static_cast< MatchingSearchJob* >( threadInfo->UserData );
+  MatchingSearchState& state = job->States[ threadInfo->ThreadID ];
+  // Each thread completes every NumberOfThreads-th first pair
+  for ( int firstPairIndex = threadInfo->ThreadID; firstPairIndex < job->NumberOfFirstPairs; firstPairIndex += threadInfo->NumberOfThreads )
   {
-    vtkGenericWarningMacro( "One of the input distance matrices is null. Cannot compute similarity. Returning default value " << RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR << "." );
-    return RESET_VALUE_COMPUTED_ROOT_MEAN_DISTANCE_ERROR;
+    job->Matcher->UpdateBestMatchingStartingWithPair( state, firstPairIndex, job->SizeOfSubset );
   }
+  return VTK_THREAD_RETURN_VALUE;
+}
 
-  vtkSmartPointer< vtkDoubleArray > distanceErrorMatrix = vtkSmartPointer< vtkDoubleArray >::New();
-  vtkPointDistanceMatrix::ComputePairWiseDifferences( distanceMatrix2, distanceMatrix1, distanceErrorMatrix );
+//------------------------------------------------------------------------------
+// The first pair pairs the point of list 1 at (firstPairIndex / pointList2Size), all points
+// before it being skipped, with the point of list 2 at (firstPairIndex % pointList2Size)
+void vtkPointMatcher::UpdateBestMatchingStartingWithPair( MatchingSearchState& state, int firstPairIndex, int sizeOfSubset )
+{
+  int pointList1Size = this->InputPointList1->GetNumberOfPoints();
+  int pointList2Size = this->InputPointList2->GetNumberOfPoints();
+  int pointList1Index = firstPairIndex / pointList2Size;
+  int pointList2Index = firstPairIndex % pointList2Size;
+  int numberOfPointList1PointsToSkip = pointList1Size - sizeOfSubset - pointList1Index;
+
+  state.PointList2IndexUsed[ pointList2Index ] = true;
+  state.MatchedPointList1Indices.push_back( pointList1Index );
+  state.MatchedPointList2Indices.push_back( pointList2Index );
+  this->UpdateBestMatchingFromPartialMatching( state, pointList1Index + 1, numberOfPointList1PointsToSkip, 0.0, sizeOfSubset );
+  state.MatchedPointList1Indices.pop_back();
+  state.MatchedPointList2Indices.pop_back();
+  state.PointList2IndexUsed[ pointList2Index ] = false;
+}
 
-  double sumOfSquaredDistanceErrors = 0;
-  int numberOfColumns = distanceErrorMatrix->GetNumberOfTuples();
-  int numberOfRows = distanceErrorMatrix->GetNumberOfComponents();
-  for ( int columnIndex = 0; columnIndex < numberOfColumns; columnIndex++ )
+//------------------------------------------------------------------------------
+void vtkPointMatcher::UpdateBestMatchingFromPartialMatching( MatchingSearchState& state, int pointList1Index, int numberOfPointList1PointsToSkip, double sumOfSquaredDistanceErrors, int sizeOfSubset )
+{
+  int numberOfMatchedPoints = state.MatchedPointList1Indices.size();
+  int numberOfDistances = sizeOfSubset * sizeOfSubset;
+  if ( numberOfMatchedPoints == sizeOfSubset )
   {
-    for ( int rowIndex = 0; rowIndex < numberOfRows; rowIndex++ )
+    double rootMeanSquareDistanceErrorMm = sqrt( sumOfSquaredDistanceErrors / numberOfDistances );
+    vtkPointMatcher::UpdateBestMatching( state, rootMeanSquareDistanceErrorMm );
+    return;
+  }
+
+  int pointList1Size = this->InputPointList1->GetNumberOfPoints();
+  int pointList2Size = this->InputPointList2->GetNumberOfPoints();
+
+  // partial matchings above this error are not relevant for the result
+  double errorBoundMm = state.BestRootMeanSquareDistanceErrorMm + this->AmbiguityThresholdDistanceMm;
+  double sumOfSquaredDistanceErrorsBound = VTK_DOUBLE_MAX;
+  if ( errorBoundMm < sqrt( VTK_DOUBLE_MAX / numberOfDistances ) )
+  {
+    sumOfSquaredDistanceErrorsBound = errorBoundMm * errorBoundMm * numberOfDistances;
+  }
+
+  // candidates are visited in order of increasing error, so that a good matching is found
+  // early and the bound becomes tight quickly
+  std::vector< std::pair< double, int > > candidates;
+  for ( int pointList2Index = 0; pointList2Index < pointList2Size; pointList2Index++ )
+  {
+    if ( state.PointList2IndexUsed[ pointList2Index ] )
+    {
+      continue;
+    }
+    double addedSquaredDistanceErrors = 0.0;
+    for ( int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++ )
+    {
+      double distance1 = this->PointList1Distances[ pointList1Index * pointList1Size + state.MatchedPointList1Indices[ matchedIndex ] ];
+      double distance2 = this->PointList2Distances[ pointList2Index * pointList2Size + state.MatchedPointList2Indices[ matchedIndex ] ];
+      double distanceError = distance1 - distance2;
+      addedSquaredDistanceErrors += 2.0 * distanceError * distanceError; // the distance matrix is symmetric
+    }
+    double candidateSumOfSquaredDistanceErrors = sumOfSquaredDistanceErrors + addedSquaredDistanceErrors;
+    if ( candidateSumOfSquaredDistanceErrors > sumOfSquaredDistanceErrorsBound )
+    {
+      continue;
+    }
+    candidates.push_back( std::make_pair( candidateSumOfSquaredDistanceErrors, pointList2Index ) );
+  }
+  std::sort( candidates.begin(), candidates.end() );
+
+  for ( unsigned int candidateIndex = 0; candidateIndex < candidates.size(); candidateIndex++ )
+  {
+    // the bound may have become tighter since the candidates were collected
+    errorBoundMm = state.BestRootMeanSquareDistanceErrorMm + this->AmbiguityThresholdDistanceMm;
+    if ( errorBoundMm < sqrt( VTK_DOUBLE_MAX / numberOfDistances ) &&
+         candidates[ candidateIndex ].first > errorBoundMm * errorBoundMm * numberOfDistances )
     {
-      double currentDistanceError = distanceErrorMatrix->GetComponent( columnIndex, rowIndex );
-      sumOfSquaredDistanceErrors += ( currentDistanceError * currentDistanceError );
+      break;
     }
+    int pointList2Index = candidates[ candidateIndex ].second;
+    state.PointList2IndexUsed[ pointList2Index ] = true;
+    state.MatchedPointList1Indices.push_back( pointList1Index );
+    state.MatchedPointList2Indices.push_back( pointList2Index );
+    this->UpdateBestMatchingFromPartialMatching( state, pointList1Index + 1, numberOfPointList1PointsToSkip, candidates[ candidateIndex ].first, sizeOfSubset );
+    state.MatchedPointList1Indices.pop_back();
+    state.MatchedPointList2Indices.pop_back();
+    state.PointList2IndexUsed[ pointList2Index ] = false;
   }
 
-  int numberOfDistances = numberOfColumns * numberOfRows;
-  double meanOfSquaredDistanceErrors = sumOfSquaredDistanceErrors / numberOfDistances;
-  double rootMeanSquareistanceErrors = sqrt( meanOfSquaredDistanceErrors );
+  // leave this point of list 1 unmatched
+  if ( numberOfPointList1PointsToSkip > 0 )
+  {
+    this->UpdateBestMatchingFromPartialMatching( state, pointList1Index + 1, numberOfPointList1PointsToSkip - 1, sumOfSquaredDistanceErrors, sizeOfSubset );
+  }
+}
 
-  return rootMeanSquareistanceErrors;
+//------------------------------------------------------------------------------
+// Compare a complete matching (stored in MatchedPointList1Indices and MatchedPointList2Indices)
+// to the best and second best matchings so far.
+// Matchings of equal error are ordered by their indices (the matching from a larger subset size,
+// which has no indices in the state, comes first), so that the best matching does not depend on
+// the order in which the matchings are visited.
+void vtkPointMatcher::UpdateBestMatching( MatchingSearchState& state, double rootMeanSquareDistanceErrorMm )
+{
+  if ( state.MatchedPointList1Indices == state.BestPointList1Indices && state.MatchedPointList2Indices == state.BestPointList2Indices )
+  {
+    // the matching proposed from the distance signatures is visited again by the search
+    return;
+  }
+
+  bool isBest = ( rootMeanSquareDistanceErrorMm < state.BestRootMeanSquareDistanceErrorMm );
+  if ( rootMeanSquareDistanceErrorMm == state.BestRootMeanSquareDistanceErrorMm && !state.BestPointList1Indices.empty() )
+  {
+    isBest = ( std::make_pair( state.MatchedPointList1Indices, state.MatchedPointList2Indices ) <
+               std::make_pair( state.BestPointList1Indices, state.BestPointList2Indices ) );
+  }
+
+  if ( isBest )
+  {
+    state.SecondBestRootMeanSquareDistanceErrorMm = state.BestRootMeanSquareDistanceErrorMm;
+    state.BestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+    state.BestPointList1Indices = state.MatchedPointList1Indices;
+    state.BestPointList2Indices = state.MatchedPointList2Indices;
+  }
+  else if ( rootMeanSquareDistanceErrorMm < state.SecondBestRootMeanSquareDistanceErrorMm )
+  {
+    state.SecondBestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Combine the results of two searches that started from the same state and visited
+// different matchings. The only matching both may know of is the one from a larger subset size.
+void vtkPointMatcher::MergeMatchingSearchStates( MatchingSearchState& state, const MatchingSearchState& otherState )
+{
+  bool otherIsBest = ( otherState.BestRootMeanSquareDistanceErrorMm < state.BestRootMeanSquareDistanceErrorMm );
+  if ( otherState.BestRootMeanSquareDistanceErrorMm == state.BestRootMeanSquareDistanceErrorMm )
+  {
+    otherIsBest = ( std::make_pair( otherState.BestPointList1Indices, otherState.BestPointList2Indices ) <
+                    std::make_pair( state.BestPointList1Indices, state.BestPointList2Indices ) );
+  }
+
+  double secondBestRootMeanSquareDistanceErrorMm = std::min( state.SecondBestRootMeanSquareDistanceErrorMm, otherState.SecondBestRootMeanSquareDistanceErrorMm );
+  if ( otherIsBest )
+  {
+    secondBestRootMeanSquareDistanceErrorMm = std::min( secondBestRootMeanSquareDistanceErrorMm, state.BestRootMeanSquareDistanceErrorMm );
+    state.BestRootMeanSquareDistanceErrorMm = otherState.BestRootMeanSquareDistanceErrorMm;
+    state.BestPointList1Indices = otherState.BestPointList1Indices;
+    state.BestPointList2Indices = otherState.BestPointList2Indices;
+  }
+  else if ( otherState.BestPointList1Indices != state.BestPointList1Indices || otherState.BestPointList2Indices != state.BestPointList2Indices )
+  {
+    secondBestRootMeanSquareDistanceErrorMm = std::min( secondBestRootMeanSquareDistanceErrorMm, otherState.BestRootMeanSquareDistanceErrorMm );
+  }
+  state.SecondBestRootMeanSquareDistanceErrorMm = secondBestRootMeanSquareDistanceErrorMm;
 }
 
 //------------------------------------------------------------------------------
@@ -1,11 +1,14 @@
 #ifndef __vtkPointMatcher_h
 #define __vtkPointMatcher_h
 
+#include <vtkMultiThreader.h>
 #include <vtkObject.h>
 #include <vtkPoints.h>
 #include <vtkTimeStamp.h>
 #include "vtkPointDistanceMatrix.h"
 
+#include <vector>
+
 // export
 #include "vtkSlicerFiducialRegistrationWizardModuleLogicExport.h"
 
@@ -31,6 +34,12 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointMatcher
     vtkGetMacro( TolerableRootMeanSquareDistanceErrorMm, double );
     vtkGetMacro( AmbiguityThresholdDistanceMm, double );
 
+    // Distribute the search for the best matching over multiple threads.
+    // The result is the same as that of the single-threaded search.
+    vtkSetMacro( UseMultithreading, bool );
+    vtkGetMacro( UseMultithreading, bool );
+    vtkBooleanMacro( UseMultithreading, bool );
+
     // Output Accessors
     vtkPoints* GetOutputPointList1();
     vtkPoints* GetOutputPointList2();
@@ -38,7 +47,15 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointMatcher
     bool IsMatchingAmbiguous();
     bool IsMatchingWithinTolerance();
 
+    // Indices of the matched points in the input lists (in the order of the output lists) found by the
+    // last update, if that matching was within tolerance and not ambiguous. Does not trigger an update.
+    // Returns false if there is no such matching.
+    bool GetLastMatchedPointIndices( std::vector< int >& pointList1Indices, std::vector< int >& pointList2Indices );
+
     // Logic
+    // If the only change since the last update is a point appended to one of the input lists,
+    // the previous matching is extended with the new point first, and the full search is only
+    // performed if the extended matching is not within tolerance or is ambiguous.
     void Update();
 
   protected:
@@ -79,6 +96,12 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointMatcher
     double AmbiguityThresholdDistanceMm;
     bool MatchingAmbiguous;
 
+    // The mean distance error of the second best matching. The matching is
+    // ambiguous if it is within AmbiguityThresholdDistanceMm of ComputedRootMeanSquareDistanceErrorMm.
+    double SecondBestRootMeanSquareDistanceErrorMm;
+
+    bool UseMultithreading;
+
     // these points will be ordered pairs
     // and the lists will be the same length as one another
     vtkSmartPointer< vtkPoints > OutputPointList1;
@@ -88,10 +111,47 @@ class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointMatcher
     vtkTimeStamp OutputChangedTime;
     bool UpdateNeeded();
 
+    // State of a branch-and-bound search in UpdateBestMatchingForAllSubsetsOfPoints.
+    // The multithreaded search uses one state per thread.
+    struct MatchingSearchState
+    {
+      std::vector< int > MatchedPointList1Indices; // current partial matching
+      std::vector< int > MatchedPointList2Indices;
+      std::vector< bool > PointList2IndexUsed;
+      double BestRootMeanSquareDistanceErrorMm; // best and second best complete matchings so far
+      double SecondBestRootMeanSquareDistanceErrorMm;
+      std::vector< int > BestPointList1Indices; // empty if the best matching is from a larger subset size
+      std::vector< int > BestPointList2Indices;
+    };
+    struct MatchingSearchJob;
+
+    // Result of the last update if it was within tolerance and not ambiguous, kept
+    // so that it can be extended when a point is added to one of the input lists.
+    // Indices refer to the input lists, in the order of the output lists.
+    std::vector< int > MatchedPointList1Indices;
+    std::vector< int > MatchedPointList2Indices;
+    std::vector< double > MatchedInputPointList1Coordinates; // input points at the last update
+    std::vector< double > MatchedInputPointList2Coordinates;
+    void StoreMatchedInputs();
+    void ClearMatchedInputs();
+    bool UpdateMatchingWithAddedPoint();
+
     // Logic helpers
     void UpdateBestMatchingForAllSubsetsOfPoints( int sizeOfSubset );
-    void UpdateBestMatchingForSubsetOfPoints( vtkPoints* list1, vtkPoints* list2 );
-    double ComputeRootMeanSquareistanceErrors( vtkPointDistanceMatrix*, vtkPointDistanceMatrix* );
+    void UpdateBestMatchingFromDistanceSignatures( MatchingSearchState& state, int sizeOfSubset );
+    void UpdateBestMatchingStartingWithPair( MatchingSearchState& state, int firstPairIndex, int sizeOfSubset );
+    void UpdateBestMatchingFromPartialMatching( MatchingSearchState& state, int pointList1Index, int numberOfPointList1PointsToSkip, double sumOfSquaredDistanceErrors, int sizeOfSubset );
+    static void UpdateBestMatching( MatchingSearchState& state, double rootMeanSquareDistanceErrorMm );
+    static void MergeMatchingSearchStates( MatchingSearchState& state, const MatchingSearchState& otherState );
+    static VTK_THREAD_RETURN_TYPE MatchingSearchThreadFunction( void* ptr );
+
+    // distances between all pairs of points in each list, read-only during the search
+    vtkSmartPointer< vtkPointDistanceMatrix > PointList1DistanceMatrix;
+    vtkSmartPointer< vtkPointDistanceMatrix > PointList2DistanceMatrix;
+    const double* PointList1Distances; // raw distances of the matrices above
+    const double* PointList2Distances;
+    std::vector< double > PointList1DistanceSignatures; // distances to all points of the same list, sorted per point
+    std::vector< double > PointList2DistanceSignatures;
 
     // Not implemented:
 		vtkPointMatcher(const vtkPointMatcher&);
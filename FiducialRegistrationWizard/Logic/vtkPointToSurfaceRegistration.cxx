@@ -0,0 +1,784 @@
+#include "vtkPointToSurfaceRegistration.h"
+
+#include <vtkCellLocator.h>
+#include <vtkGenericCell.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkMinimalStandardRandomSequence.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkTransform.h>
+#include <vtkTriangle.h>
+#include <vtkTriangleFilter.h>
+
+#include <algorithm>
+#include <cmath>
+
+// vtkCellLocator queries are not thread-safe, so each closest point search thread needs its own
+// locator, which is a full copy of the search structure of the target surface. Using more threads
+// than this would only multiply the memory usage and the build time of the locators.
+static const int MAXIMUM_NUMBER_OF_TARGET_LOCATORS = 4;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkPointToSurfaceRegistration );
+
+//------------------------------------------------------------------------------
+// Data shared by the closest point search threads. Each thread processes a contiguous
+// range of the source points, and writes the results of those points only.
+struct PointToSurfaceClosestPointJob
+{
+  double SourceToTarget[ 16 ];
+  int NumberOfPoints;
+  const double* SourceCoordinates;
+  const double* TriangleNormals;
+  double* TransformedSourceCoordinates;
+  double* ClosestPointCoordinates;
+  double* ClosestPointNormals;
+  double* ClosestPointDistances2;
+  vtkSmartPointer< vtkCellLocator >* Locators;
+  vtkSmartPointer< vtkGenericCell >* Cells;
+};
+
+//------------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE FindClosestPointsThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  PointToSurfaceClosestPointJob* job = static_cast< PointToSurfaceClosestPointJob* >( threadInfo->UserData );
+  int threadId = threadInfo->ThreadID;
+  int numberOfThreads = threadInfo->NumberOfThreads;
+  int firstPoint = static_cast< int >( static_cast< long long >( job->NumberOfPoints ) * threadId / numberOfThreads );
+  int lastPoint = static_cast< int >( static_cast< long long >( job->NumberOfPoints ) * ( threadId + 1 ) / numberOfThreads );
+
+  vtkCellLocator* locator = job->Locators[ threadId ];
+  vtkGenericCell* cell = job->Cells[ threadId ];
+  const double* m = job->SourceToTarget;
+  for ( int pointIndex = firstPoint; pointIndex < lastPoint; pointIndex++ )
+  {
+    const double* sourcePoint = job->SourceCoordinates + 3 * pointIndex;
+    double* transformedPoint = job->TransformedSourceCoordinates + 3 * pointIndex;
+    for ( int i = 0; i < 3; i++ )
+    {
+      transformedPoint[ i ] = m[ 4 * i ] * sourcePoint[ 0 ] + m[ 4 * i + 1 ] * sourcePoint[ 1 ] + m[ 4 * i + 2 ] * sourcePoint[ 2 ] + m[ 4 * i + 3 ];
+    }
+    vtkIdType cellId = -1;
+    int subId = 0;
+    double distance2 = 0.0;
+    locator->FindClosestPoint( transformedPoint, job->ClosestPointCoordinates + 3 * pointIndex, cell, cellId, subId, distance2 );
+    job->ClosestPointDistances2[ pointIndex ] = distance2;
+    double* normal = job->ClosestPointNormals + 3 * pointIndex;
+    for ( int i = 0; i < 3; i++ )
+    {
+      normal[ i ] = ( cellId >= 0 ) ? job->TriangleNormals[ 3 * cellId + i ] : 0.0;
+    }
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+// Data shared by the initial transform scoring threads. Each thread scores a contiguous
+// range of the candidates, using all scoring points for each.
+struct PointToSurfaceScoringJob
+{
+  int NumberOfCandidates;
+  const double* CandidateElements;
+  int NumberOfPoints;
+  const double* SourceCoordinates;
+  double* Scores;
+  vtkSmartPointer< vtkCellLocator >* Locators;
+  vtkSmartPointer< vtkGenericCell >* Cells;
+};
+
+//------------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE ScoreInitialTransformsThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  PointToSurfaceScoringJob* job = static_cast< PointToSurfaceScoringJob* >( threadInfo->UserData );
+  int threadId = threadInfo->ThreadID;
+  int numberOfThreads = threadInfo->NumberOfThreads;
+  int firstCandidate = job->NumberOfCandidates * threadId / numberOfThreads;
+  int lastCandidate = job->NumberOfCandidates * ( threadId + 1 ) / numberOfThreads;
+
+  vtkCellLocator* locator = job->Locators[ threadId ];
+  vtkGenericCell* cell = job->Cells[ threadId ];
+  for ( int candidateIndex = firstCandidate; candidateIndex < lastCandidate; candidateIndex++ )
+  {
+    const double* m = job->CandidateElements + 16 * candidateIndex;
+    double sumDistance2 = 0.0;
+    for ( int pointIndex = 0; pointIndex < job->NumberOfPoints; pointIndex++ )
+    {
+      const double* sourcePoint = job->SourceCoordinates + 3 * pointIndex;
+      double transformedPoint[ 3 ];
+      for ( int i = 0; i < 3; i++ )
+      {
+        transformedPoint[ i ] = m[ 4 * i ] * sourcePoint[ 0 ] + m[ 4 * i + 1 ] * sourcePoint[ 1 ] + m[ 4 * i + 2 ] * sourcePoint[ 2 ] + m[ 4 * i + 3 ];
+      }
+      double closestPoint[ 3 ];
+      vtkIdType cellId = -1;
+      int subId = 0;
+      double distance2 = 0.0;
+      locator->FindClosestPoint( transformedPoint, closestPoint, cell, cellId, subId, distance2 );
+      sumDistance2 += distance2;
+    }
+    job->Scores[ candidateIndex ] = ( job->NumberOfPoints > 0 ) ? sumDistance2 / job->NumberOfPoints : 0.0;
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+// Centroid and principal axes (columns of axes, in decreasing order of variance, right-handed) of points
+static void ComputePrincipalAxes( vtkPoints* points, double centroid[ 3 ], double axes[ 3 ][ 3 ] )
+{
+  int numberOfPoints = points->GetNumberOfPoints();
+  centroid[ 0 ] = centroid[ 1 ] = centroid[ 2 ] = 0.0;
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    double* point = points->GetPoint( pointIndex );
+    for ( int i = 0; i < 3; i++ )
+    {
+      centroid[ i ] += point[ i ];
+    }
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    centroid[ i ] /= std::max( 1, numberOfPoints );
+  }
+
+  double covariance[ 3 ][ 3 ] = { { 0.0 } };
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    double* point = points->GetPoint( pointIndex );
+    double offset[ 3 ] = { point[ 0 ] - centroid[ 0 ], point[ 1 ] - centroid[ 1 ], point[ 2 ] - centroid[ 2 ] };
+    for ( int row = 0; row < 3; row++ )
+    {
+      for ( int column = 0; column < 3; column++ )
+      {
+        covariance[ row ][ column ] += offset[ row ] * offset[ column ];
+      }
+    }
+  }
+  double* covarianceRows[ 3 ] = { covariance[ 0 ], covariance[ 1 ], covariance[ 2 ] };
+  double eigenvalues[ 3 ];
+  double* axesRows[ 3 ] = { axes[ 0 ], axes[ 1 ], axes[ 2 ] };
+  vtkMath::Jacobi( covarianceRows, eigenvalues, axesRows ); // eigenvectors are the columns, sorted by decreasing eigenvalue
+  if ( vtkMath::Determinant3x3( axes ) < 0.0 )
+  {
+    for ( int row = 0; row < 3; row++ )
+    {
+      axes[ row ][ 2 ] = -axes[ row ][ 2 ];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkPointToSurfaceRegistration::vtkPointToSurfaceRegistration()
+{
+  this->Mode = VTK_LANDMARK_RIGIDBODY;
+  this->UsePointToPlane = true;
+  this->MaximumNumberOfIterations = 100;
+  this->NumberOfResolutionLevels = 1;
+  this->MinimumNumberOfLevelPoints = 200;
+  this->ConvergenceTolerance = 0.001;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->TrimmedFraction = 0.0;
+  this->UseGlobalInitialization = false;
+  this->InitialRotationStepDegrees = 30.0;
+  this->NumberOfInitializationPoints = 200;
+  this->NumberOfRefinedInitializations = 3;
+  this->SourceToTargetMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PointDistances = vtkSmartPointer< vtkDoubleArray >::New();
+  this->PointDistances->SetName( "Distance" );
+  this->NumberOfIterations = 0;
+  this->MeanDistance = 0.0;
+  this->RootMeanSquareDistance = 0.0;
+  this->MaximumDistance = 0.0;
+  for ( int i = 0; i < 6; i++ )
+  {
+    this->SourceBounds[ i ] = 0.0;
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkPointToSurfaceRegistration::~vtkPointToSurfaceRegistration()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Mode: " << this->Mode << std::endl;
+  os << indent << "UsePointToPlane: " << this->UsePointToPlane << std::endl;
+  os << indent << "MaximumNumberOfIterations: " << this->MaximumNumberOfIterations << std::endl;
+  os << indent << "NumberOfResolutionLevels: " << this->NumberOfResolutionLevels << std::endl;
+  os << indent << "MinimumNumberOfLevelPoints: " << this->MinimumNumberOfLevelPoints << std::endl;
+  os << indent << "ConvergenceTolerance: " << this->ConvergenceTolerance << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "TrimmedFraction: " << this->TrimmedFraction << std::endl;
+  os << indent << "UseGlobalInitialization: " << this->UseGlobalInitialization << std::endl;
+  os << indent << "InitialRotationStepDegrees: " << this->InitialRotationStepDegrees << std::endl;
+  os << indent << "NumberOfInitializationPoints: " << this->NumberOfInitializationPoints << std::endl;
+  os << indent << "NumberOfRefinedInitializations: " << this->NumberOfRefinedInitializations << std::endl;
+  os << indent << "NumberOfIterations: " << this->NumberOfIterations << std::endl;
+  os << indent << "MeanDistance: " << this->MeanDistance << std::endl;
+  os << indent << "RootMeanSquareDistance: " << this->RootMeanSquareDistance << std::endl;
+  os << indent << "MaximumDistance: " << this->MaximumDistance << std::endl;
+  os << indent << "SourceToTargetMatrix:" << std::endl;
+  this->SourceToTargetMatrix->PrintSelf( os, indent.GetNextIndent() );
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::SetSourcePoints( vtkPoints* points )
+{
+  if ( this->SourcePoints == points )
+  {
+    return;
+  }
+  this->SourcePoints = points;
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkPoints* vtkPointToSurfaceRegistration::GetSourcePoints()
+{
+  return this->SourcePoints;
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::SetTargetSurface( vtkPolyData* surface )
+{
+  if ( this->TargetSurface == surface )
+  {
+    return;
+  }
+  this->TargetSurface = surface;
+  // locators are built for the new surface when they are needed
+  this->TargetTriangles = NULL;
+  this->TargetLocators.clear();
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkPolyData* vtkPointToSurfaceRegistration::GetTargetSurface()
+{
+  return this->TargetSurface;
+}
+
+//------------------------------------------------------------------------------
+bool vtkPointToSurfaceRegistration::PrepareInputs()
+{
+  if ( this->SourcePoints == NULL || this->SourcePoints->GetNumberOfPoints() == 0 )
+  {
+    vtkErrorMacro( "PrepareInputs: No source points" );
+    return false;
+  }
+  if ( this->TargetSurface == NULL || this->TargetSurface->GetNumberOfPoints() == 0 )
+  {
+    vtkErrorMacro( "PrepareInputs: No target surface" );
+    return false;
+  }
+
+  this->UpdateTargetLocators();
+  if ( this->TargetTriangles->GetNumberOfCells() == 0 )
+  {
+    vtkErrorMacro( "PrepareInputs: Target surface has no polygons" );
+    return false;
+  }
+
+  int numberOfPoints = this->SourcePoints->GetNumberOfPoints();
+  this->AllSourceCoordinates.resize( 3 * numberOfPoints );
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    this->SourcePoints->GetPoint( pointIndex, &this->AllSourceCoordinates[ 3 * pointIndex ] );
+  }
+  this->SourcePoints->GetBounds( this->SourceBounds );
+  this->AllSourcePointIds.resize( numberOfPoints );
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    this->AllSourcePointIds[ pointIndex ] = pointIndex;
+  }
+
+  if ( this->NumberOfResolutionLevels > 1 || this->UseGlobalInitialization )
+  {
+    // Shuffle the points (with a fixed seed, so that results are reproducible).
+    // Then the first points of the list are a random subset of any size.
+    vtkNew< vtkMinimalStandardRandomSequence > randomSequence;
+    randomSequence->SetSeed( 1 );
+    for ( int pointIndex = numberOfPoints - 1; pointIndex > 0; pointIndex-- )
+    {
+      randomSequence->Next();
+      int swapIndex = std::min( pointIndex, static_cast< int >( randomSequence->GetValue() * ( pointIndex + 1 ) ) );
+      std::swap_ranges( this->AllSourceCoordinates.begin() + 3 * pointIndex, this->AllSourceCoordinates.begin() + 3 * pointIndex + 3,
+        this->AllSourceCoordinates.begin() + 3 * swapIndex );
+      std::swap( this->AllSourcePointIds[ pointIndex ], this->AllSourcePointIds[ swapIndex ] );
+    }
+  }
+
+  this->SelectSourcePoints( numberOfPoints );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::SelectSourcePoints( int numberOfPoints )
+{
+  this->SourceCoordinates.assign( this->AllSourceCoordinates.begin(), this->AllSourceCoordinates.begin() + 3 * numberOfPoints );
+  this->TransformedSourceCoordinates.resize( 3 * numberOfPoints );
+  this->ClosestPointCoordinates.resize( 3 * numberOfPoints );
+  this->ClosestPointNormals.resize( 3 * numberOfPoints );
+  this->ClosestPointDistances2.resize( numberOfPoints );
+  this->CorrespondenceUsed.assign( numberOfPoints, 1 );
+}
+
+//------------------------------------------------------------------------------
+double vtkPointToSurfaceRegistration::GetMaximumSourceDisplacement( vtkMatrix4x4* transform )
+{
+  double maximumDisplacement2 = 0.0;
+  for ( int corner = 0; corner < 8; corner++ )
+  {
+    double point[ 4 ] = { this->SourceBounds[ corner & 1 ], this->SourceBounds[ 2 + ( ( corner >> 1 ) & 1 ) ], this->SourceBounds[ 4 + ( ( corner >> 2 ) & 1 ) ], 1.0 };
+    double transformedPoint[ 4 ] = { 0.0, 0.0, 0.0, 1.0 };
+    transform->MultiplyPoint( point, transformedPoint );
+    maximumDisplacement2 = std::max( maximumDisplacement2, vtkMath::Distance2BetweenPoints( point, transformedPoint ) );
+  }
+  return sqrt( maximumDisplacement2 );
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::UpdateTargetLocators()
+{
+  int numberOfLocators = std::max( 1, std::min( this->NumberOfThreads, MAXIMUM_NUMBER_OF_TARGET_LOCATORS ) );
+  if ( this->TargetTriangles != NULL
+    && static_cast< int >( this->TargetLocators.size() ) == numberOfLocators
+    && this->TargetLocatorsBuildTime > this->TargetSurface->GetMTime() )
+  {
+    // up-to-date
+    return;
+  }
+
+  // Only triangles are kept, so that cell IDs of the locator are triangle indices
+  vtkNew< vtkTriangleFilter > triangleFilter;
+  triangleFilter->SetInputData( this->TargetSurface );
+  triangleFilter->PassVertsOff();
+  triangleFilter->PassLinesOff();
+  triangleFilter->Update();
+  this->TargetTriangles = vtkSmartPointer< vtkPolyData >::New();
+  this->TargetTriangles->ShallowCopy( triangleFilter->GetOutput() );
+  // cells are built now, so that they are not built by the first query on one of the threads
+  this->TargetTriangles->BuildCells();
+
+  int numberOfTriangles = this->TargetTriangles->GetNumberOfCells();
+  this->TargetTriangleNormals.assign( 3 * numberOfTriangles, 0.0 );
+  vtkPoints* targetPoints = this->TargetTriangles->GetPoints();
+  vtkNew< vtkIdList > trianglePointIds;
+  for ( int triangleIndex = 0; triangleIndex < numberOfTriangles; triangleIndex++ )
+  {
+    this->TargetTriangles->GetCellPoints( triangleIndex, trianglePointIds.GetPointer() );
+    if ( trianglePointIds->GetNumberOfIds() != 3 )
+    {
+      continue;
+    }
+    double p0[ 3 ], p1[ 3 ], p2[ 3 ];
+    targetPoints->GetPoint( trianglePointIds->GetId( 0 ), p0 );
+    targetPoints->GetPoint( trianglePointIds->GetId( 1 ), p1 );
+    targetPoints->GetPoint( trianglePointIds->GetId( 2 ), p2 );
+    // ComputeNormal leaves zero normal for degenerate triangles, those are not used for point-to-plane distance
+    vtkTriangle::ComputeNormal( p0, p1, p2, &this->TargetTriangleNormals[ 3 * triangleIndex ] );
+  }
+
+  this->TargetLocators.clear();
+  for ( int locatorIndex = 0; locatorIndex < numberOfLocators; locatorIndex++ )
+  {
+    vtkSmartPointer< vtkCellLocator > locator = vtkSmartPointer< vtkCellLocator >::New();
+    locator->SetDataSet( this->TargetTriangles );
+    locator->BuildLocator();
+    this->TargetLocators.push_back( locator );
+  }
+  this->TargetLocatorsBuildTime.Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::FindClosestPoints( vtkMatrix4x4* sourceToTarget )
+{
+  int numberOfPoints = static_cast< int >( this->ClosestPointDistances2.size() );
+  int numberOfThreads = std::max( 1, std::min( static_cast< int >( this->TargetLocators.size() ), numberOfPoints ) );
+
+  std::vector< vtkSmartPointer< vtkGenericCell > > cells;
+  for ( int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++ )
+  {
+    cells.push_back( vtkSmartPointer< vtkGenericCell >::New() );
+  }
+
+  PointToSurfaceClosestPointJob job;
+  std::copy( &sourceToTarget->Element[ 0 ][ 0 ], &sourceToTarget->Element[ 0 ][ 0 ] + 16, job.SourceToTarget );
+  job.NumberOfPoints = numberOfPoints;
+  job.SourceCoordinates = &this->SourceCoordinates[ 0 ];
+  job.TriangleNormals = &this->TargetTriangleNormals[ 0 ];
+  job.TransformedSourceCoordinates = &this->TransformedSourceCoordinates[ 0 ];
+  job.ClosestPointCoordinates = &this->ClosestPointCoordinates[ 0 ];
+  job.ClosestPointNormals = &this->ClosestPointNormals[ 0 ];
+  job.ClosestPointDistances2 = &this->ClosestPointDistances2[ 0 ];
+  job.Locators = &this->TargetLocators[ 0 ];
+  job.Cells = &cells[ 0 ];
+
+  vtkNew< vtkMultiThreader > threader;
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( FindClosestPointsThreadFunction, &job );
+  threader->SingleMethodExecute();
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::UpdateDistanceStatistics()
+{
+  int numberOfPoints = static_cast< int >( this->ClosestPointDistances2.size() );
+  double sumDistance = 0.0;
+  double sumDistance2 = 0.0;
+  double maximumDistance2 = 0.0;
+  this->PointDistances->SetNumberOfValues( numberOfPoints );
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    double distance2 = this->ClosestPointDistances2[ pointIndex ];
+    this->PointDistances->SetValue( this->AllSourcePointIds[ pointIndex ], sqrt( distance2 ) );
+    sumDistance += sqrt( distance2 );
+    sumDistance2 += distance2;
+    maximumDistance2 = std::max( maximumDistance2, distance2 );
+  }
+  this->MeanDistance = ( numberOfPoints > 0 ) ? sumDistance / numberOfPoints : 0.0;
+  this->RootMeanSquareDistance = ( numberOfPoints > 0 ) ? sqrt( sumDistance2 / numberOfPoints ) : 0.0;
+  this->MaximumDistance = sqrt( maximumDistance2 );
+  this->PointDistances->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::TrimCorrespondences()
+{
+  int numberOfPoints = static_cast< int >( this->ClosestPointDistances2.size() );
+  this->CorrespondenceUsed.assign( numberOfPoints, 1 );
+  int numberOfTrimmedPoints = static_cast< int >( this->TrimmedFraction * numberOfPoints );
+  if ( numberOfTrimmedPoints <= 0 )
+  {
+    return;
+  }
+  // distances above the threshold are trimmed, points at the threshold distance are trimmed only as many as needed
+  std::vector< double > sortedDistances2( this->ClosestPointDistances2 );
+  int numberOfUsedPoints = numberOfPoints - numberOfTrimmedPoints;
+  std::nth_element( sortedDistances2.begin(), sortedDistances2.begin() + numberOfUsedPoints, sortedDistances2.end() );
+  double thresholdDistance2 = sortedDistances2[ numberOfUsedPoints ];
+  int numberOfUsedThresholdPoints = numberOfUsedPoints;
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    if ( this->ClosestPointDistances2[ pointIndex ] < thresholdDistance2 )
+    {
+      numberOfUsedThresholdPoints--;
+    }
+  }
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    double distance2 = this->ClosestPointDistances2[ pointIndex ];
+    if ( distance2 < thresholdDistance2 )
+    {
+      continue;
+    }
+    if ( distance2 == thresholdDistance2 && numberOfUsedThresholdPoints > 0 )
+    {
+      numberOfUsedThresholdPoints--;
+      continue;
+    }
+    this->CorrespondenceUsed[ pointIndex ] = 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkPointToSurfaceRegistration::ComputePointToPlaneStep( vtkMatrix4x4* step )
+{
+  // Linearized rotation: minimize sum( ( p + w x p + t - q ) . n )^2 for w (small rotation angles) and t (translation)
+  double ata[ 6 ][ 6 ] = { { 0.0 } };
+  double atb[ 6 ] = { 0.0 };
+  int numberOfPoints = static_cast< int >( this->ClosestPointDistances2.size() );
+  int numberOfUsedPoints = 0;
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    const double* p = &this->TransformedSourceCoordinates[ 3 * pointIndex ];
+    const double* q = &this->ClosestPointCoordinates[ 3 * pointIndex ];
+    const double* n = &this->ClosestPointNormals[ 3 * pointIndex ];
+    if ( !this->CorrespondenceUsed[ pointIndex ] || ( n[ 0 ] == 0.0 && n[ 1 ] == 0.0 && n[ 2 ] == 0.0 ) )
+    {
+      continue;
+    }
+    double a[ 6 ] = { p[ 1 ] * n[ 2 ] - p[ 2 ] * n[ 1 ], p[ 2 ] * n[ 0 ] - p[ 0 ] * n[ 2 ], p[ 0 ] * n[ 1 ] - p[ 1 ] * n[ 0 ], n[ 0 ], n[ 1 ], n[ 2 ] };
+    double b = ( q[ 0 ] - p[ 0 ] ) * n[ 0 ] + ( q[ 1 ] - p[ 1 ] ) * n[ 1 ] + ( q[ 2 ] - p[ 2 ] ) * n[ 2 ];
+    for ( int row = 0; row < 6; row++ )
+    {
+      for ( int column = row; column < 6; column++ )
+      {
+        ata[ row ][ column ] += a[ row ] * a[ column ];
+      }
+      atb[ row ] += a[ row ] * b;
+    }
+    numberOfUsedPoints++;
+  }
+  if ( numberOfUsedPoints < 6 )
+  {
+    return false;
+  }
+  for ( int row = 0; row < 6; row++ )
+  {
+    for ( int column = 0; column < row; column++ )
+    {
+      ata[ row ][ column ] = ata[ column ][ row ];
+    }
+  }
+
+  double* rows[ 6 ] = { ata[ 0 ], ata[ 1 ], ata[ 2 ], ata[ 3 ], ata[ 4 ], ata[ 5 ] };
+  if ( !vtkMath::SolveLinearSystem( rows, atb, 6 ) )
+  {
+    // degenerate surface (e.g., plane or sphere), rotation is not constrained by the normals
+    return false;
+  }
+
+  vtkNew< vtkTransform > stepTransform;
+  stepTransform->PostMultiply();
+  stepTransform->RotateX( vtkMath::DegreesFromRadians( atb[ 0 ] ) );
+  stepTransform->RotateY( vtkMath::DegreesFromRadians( atb[ 1 ] ) );
+  stepTransform->RotateZ( vtkMath::DegreesFromRadians( atb[ 2 ] ) );
+  stepTransform->Translate( atb[ 3 ], atb[ 4 ], atb[ 5 ] );
+  step->DeepCopy( stepTransform->GetMatrix() );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkPointToSurfaceRegistration::ComputePointToPointStep( vtkMatrix4x4* step )
+{
+  int numberOfPoints = static_cast< int >( this->ClosestPointDistances2.size() );
+  vtkNew< vtkPoints > sourceLandmarks;
+  vtkNew< vtkPoints > targetLandmarks;
+  for ( int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    if ( !this->CorrespondenceUsed[ pointIndex ] )
+    {
+      continue;
+    }
+    sourceLandmarks->InsertNextPoint( &this->TransformedSourceCoordinates[ 3 * pointIndex ] );
+    targetLandmarks->InsertNextPoint( &this->ClosestPointCoordinates[ 3 * pointIndex ] );
+  }
+  if ( sourceLandmarks->GetNumberOfPoints() == 0 )
+  {
+    return false;
+  }
+  vtkNew< vtkLandmarkTransform > landmarkTransform;
+  landmarkTransform->SetSourceLandmarks( sourceLandmarks.GetPointer() );
+  landmarkTransform->SetTargetLandmarks( targetLandmarks.GetPointer() );
+  landmarkTransform->SetMode( this->Mode );
+  landmarkTransform->Update();
+  step->DeepCopy( landmarkTransform->GetMatrix() );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkPointToSurfaceRegistration::Update()
+{
+  if ( !this->PrepareInputs() )
+  {
+    return false;
+  }
+
+  // Number of points at each resolution level, from coarse to fine
+  int numberOfSourcePoints = static_cast< int >( this->AllSourceCoordinates.size() / 3 );
+  std::vector< int > levelNumberOfPoints;
+  int numberOfLevelPoints = numberOfSourcePoints;
+  for ( int level = 0; level < this->NumberOfResolutionLevels; level++ )
+  {
+    levelNumberOfPoints.insert( levelNumberOfPoints.begin(), numberOfLevelPoints );
+    numberOfLevelPoints /= 4;
+    if ( numberOfLevelPoints < this->MinimumNumberOfLevelPoints )
+    {
+      break;
+    }
+  }
+
+  this->NumberOfIterations = 0;
+  vtkNew< vtkMatrix4x4 > sourceToTarget;
+  if ( !this->UseGlobalInitialization )
+  {
+    this->RunIterations( sourceToTarget.GetPointer(), levelNumberOfPoints );
+  }
+  else
+  {
+    std::vector< double > candidateElements;
+    this->ComputeInitialTransformCandidates( candidateElements );
+    int numberOfCandidates = static_cast< int >( candidateElements.size() / 16 );
+    int numberOfScoringPoints = std::max( 1, std::min( this->NumberOfInitializationPoints, numberOfSourcePoints ) );
+    std::vector< double > scores;
+    this->ScoreInitialTransformCandidates( candidateElements, numberOfScoringPoints, scores );
+    std::vector< std::pair< double, int > > rankedCandidates;
+    for ( int candidateIndex = 0; candidateIndex < numberOfCandidates; candidateIndex++ )
+    {
+      rankedCandidates.push_back( std::make_pair( scores[ candidateIndex ], candidateIndex ) );
+    }
+    std::sort( rankedCandidates.begin(), rankedCandidates.end() );
+
+    // refine the best candidates, keep the one that ends up closest to the surface
+    int numberOfRefinedCandidates = std::max( 1, std::min( this->NumberOfRefinedInitializations, numberOfCandidates ) );
+    double bestRootMeanSquareDistance = VTK_DOUBLE_MAX;
+    vtkNew< vtkMatrix4x4 > refinedSourceToTarget;
+    for ( int rank = 0; rank < numberOfRefinedCandidates; rank++ )
+    {
+      refinedSourceToTarget->DeepCopy( &candidateElements[ 16 * rankedCandidates[ rank ].second ] );
+      this->RunIterations( refinedSourceToTarget.GetPointer(), levelNumberOfPoints );
+      this->SelectSourcePoints( numberOfSourcePoints );
+      this->FindClosestPoints( refinedSourceToTarget.GetPointer() );
+      this->UpdateDistanceStatistics();
+      if ( this->RootMeanSquareDistance < bestRootMeanSquareDistance )
+      {
+        bestRootMeanSquareDistance = this->RootMeanSquareDistance;
+        sourceToTarget->DeepCopy( refinedSourceToTarget.GetPointer() );
+      }
+    }
+  }
+
+  // statistics of the final transform, for all points
+  this->SelectSourcePoints( numberOfSourcePoints );
+  this->FindClosestPoints( sourceToTarget.GetPointer() );
+  this->UpdateDistanceStatistics();
+
+  this->SourceToTargetMatrix->DeepCopy( sourceToTarget.GetPointer() );
+  this->Modified();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::RunIterations( vtkMatrix4x4* sourceToTarget, const std::vector< int >& levelNumberOfPoints )
+{
+  bool pointToPlane = this->UsePointToPlane && this->Mode == VTK_LANDMARK_RIGIDBODY;
+  vtkNew< vtkMatrix4x4 > step;
+  for ( std::vector< int >::const_iterator levelIt = levelNumberOfPoints.begin(); levelIt != levelNumberOfPoints.end(); ++levelIt )
+  {
+    this->SelectSourcePoints( *levelIt );
+    for ( int iteration = 0; iteration < this->MaximumNumberOfIterations; iteration++ )
+    {
+      this->FindClosestPoints( sourceToTarget );
+      this->TrimCorrespondences();
+      bool stepComputed = pointToPlane && this->ComputePointToPlaneStep( step.GetPointer() );
+      if ( !stepComputed )
+      {
+        stepComputed = this->ComputePointToPointStep( step.GetPointer() );
+      }
+      if ( !stepComputed )
+      {
+        break;
+      }
+      vtkMatrix4x4::Multiply4x4( step.GetPointer(), sourceToTarget, sourceToTarget );
+      this->NumberOfIterations++;
+      if ( this->GetMaximumSourceDisplacement( step.GetPointer() ) < this->ConvergenceTolerance )
+      {
+        // converged at this level
+        break;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::ComputeInitialTransformCandidates( std::vector< double >& candidateElements )
+{
+  candidateElements.clear();
+  double sourceCentroid[ 3 ];
+  double sourceAxes[ 3 ][ 3 ];
+  ComputePrincipalAxes( this->SourcePoints, sourceCentroid, sourceAxes );
+  double targetCentroid[ 3 ];
+  double targetAxes[ 3 ][ 3 ];
+  ComputePrincipalAxes( this->TargetTriangles->GetPoints(), targetCentroid, targetAxes );
+  double sourceAxesTransposed[ 3 ][ 3 ];
+  vtkMath::Transpose3x3( sourceAxes, sourceAxesTransposed );
+
+  // the 24 rotations that map coordinate axes to coordinate axes: signed permutation matrices with determinant +1
+  int permutations[ 6 ][ 3 ] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+  int numberOfAngleSteps = std::max( 1, static_cast< int >( ceil( 90.0 / this->InitialRotationStepDegrees - 1e-6 ) ) );
+  for ( int permutationIndex = 0; permutationIndex < 6; permutationIndex++ )
+  {
+    for ( int signs = 0; signs < 8; signs++ )
+    {
+      double axisRotation[ 3 ][ 3 ] = { { 0.0 } };
+      for ( int row = 0; row < 3; row++ )
+      {
+        axisRotation[ row ][ permutations[ permutationIndex ][ row ] ] = ( ( signs >> row ) & 1 ) ? -1.0 : 1.0;
+      }
+      if ( vtkMath::Determinant3x3( axisRotation ) < 0.0 )
+      {
+        continue;
+      }
+      for ( int angleStep = 0; angleStep < numberOfAngleSteps; angleStep++ )
+      {
+        // rotation about the first principal axis (x axis of the principal axes frame)
+        double angleRadians = vtkMath::RadiansFromDegrees( angleStep * this->InitialRotationStepDegrees );
+        double rotationAboutPrincipalAxis[ 3 ][ 3 ] = { { 1.0, 0.0, 0.0 }, { 0.0, cos( angleRadians ), -sin( angleRadians ) }, { 0.0, sin( angleRadians ), cos( angleRadians ) } };
+        // sourceToTarget rotation = targetAxes * axisRotation * rotationAboutPrincipalAxis * sourceAxes^T
+        double rotation[ 3 ][ 3 ];
+        vtkMath::Multiply3x3( rotationAboutPrincipalAxis, sourceAxesTransposed, rotation );
+        vtkMath::Multiply3x3( axisRotation, rotation, rotation );
+        vtkMath::Multiply3x3( targetAxes, rotation, rotation );
+        double rotatedSourceCentroid[ 3 ];
+        vtkMath::Multiply3x3( rotation, sourceCentroid, rotatedSourceCentroid );
+        for ( int row = 0; row < 3; row++ )
+        {
+          candidateElements.push_back( rotation[ row ][ 0 ] );
+          candidateElements.push_back( rotation[ row ][ 1 ] );
+          candidateElements.push_back( rotation[ row ][ 2 ] );
+          candidateElements.push_back( targetCentroid[ row ] - rotatedSourceCentroid[ row ] );
+        }
+        candidateElements.push_back( 0.0 );
+        candidateElements.push_back( 0.0 );
+        candidateElements.push_back( 0.0 );
+        candidateElements.push_back( 1.0 );
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPointToSurfaceRegistration::ScoreInitialTransformCandidates( const std::vector< double >& candidateElements, int numberOfPoints, std::vector< double >& scores )
+{
+  int numberOfCandidates = static_cast< int >( candidateElements.size() / 16 );
+  scores.assign( numberOfCandidates, 0.0 );
+  if ( numberOfCandidates == 0 )
+  {
+    return;
+  }
+  int numberOfThreads = std::max( 1, std::min( static_cast< int >( this->TargetLocators.size() ), numberOfCandidates ) );
+  std::vector< vtkSmartPointer< vtkGenericCell > > cells;
+  for ( int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++ )
+  {
+    cells.push_back( vtkSmartPointer< vtkGenericCell >::New() );
+  }
+
+  PointToSurfaceScoringJob job;
+  job.NumberOfCandidates = numberOfCandidates;
+  job.CandidateElements = &candidateElements[ 0 ];
+  job.NumberOfPoints = std::min( numberOfPoints, static_cast< int >( this->AllSourceCoordinates.size() / 3 ) );
+  job.SourceCoordinates = &this->AllSourceCoordinates[ 0 ]; // randomly ordered, so the first points are a random subset
+  job.Scores = &scores[ 0 ];
+  job.Locators = &this->TargetLocators[ 0 ];
+  job.Cells = &cells[ 0 ];
+
+  vtkNew< vtkMultiThreader > threader;
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( ScoreInitialTransformsThreadFunction, &job );
+  threader->SingleMethodExecute();
+}
+
+//------------------------------------------------------------------------------
+bool vtkPointToSurfaceRegistration::ComputeDistanceStatistics( vtkMatrix4x4* sourceToTarget )
+{
+  if ( sourceToTarget == NULL )
+  {
+    vtkErrorMacro( "ComputeDistanceStatistics: Invalid transform" );
+    return false;
+  }
+  if ( !this->PrepareInputs() )
+  {
+    return false;
+  }
+  this->FindClosestPoints( sourceToTarget );
+  this->UpdateDistanceStatistics();
+  return true;
+}
@@ -0,0 +1,222 @@
+#ifndef __vtkPointToSurfaceRegistration_h
+#define __vtkPointToSurfaceRegistration_h
+
+#include <vtkLandmarkTransform.h>
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObject.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimeStamp.h>
+
+#include <vector>
+
+// export
+#include "vtkSlicerFiducialRegistrationWizardModuleLogicExport.h"
+
+class vtkCellLocator;
+
+// Iterative closest point registration of a point set (points of a surface model
+// or a fiducial list) to a target surface.
+// Rigid registration minimizes the distance of the source points from the tangent
+// planes of the target surface at the closest points (point-to-plane ICP), which
+// needs much fewer iterations than point-to-point ICP on surfaces. Similarity and
+// affine registrations use point-to-point ICP, the same as vtkIterativeClosestPointTransform.
+// Closest points are searched on multiple threads. The target locators are kept
+// between registrations and only rebuilt when the target surface is changed, so
+// computing the distance statistics after the registration or registering another
+// point set to the same surface does not have to build them again.
+// Registration can be started on a random subset of the source points and refined
+// on larger subsets, up to all points (coarse-to-fine). Iterations at each level
+// stop when the transform changes less than the convergence tolerance.
+// Registration starts from the identity transform, or, with global initialization,
+// from the best of many candidate poses that align the principal axes of the inputs.
+// Outlier source points (e.g., misplaced fiducials) can be excluded from the transform
+// computation by trimming the farthest correspondences at each iteration.
+class VTK_SLICER_FIDUCIALREGISTRATIONWIZARD_MODULE_LOGIC_EXPORT vtkPointToSurfaceRegistration : public vtkObject
+{
+  public:
+    vtkTypeMacro( vtkPointToSurfaceRegistration, vtkObject );
+    static vtkPointToSurfaceRegistration* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Points that are transformed to the target surface. The points are copied when
+    // the registration or distance computation is started.
+    void SetSourcePoints( vtkPoints* points );
+    vtkPoints* GetSourcePoints();
+
+    // Surface that the source points are registered to. Polygons and triangle strips are triangulated.
+    void SetTargetSurface( vtkPolyData* surface );
+    vtkPolyData* GetTargetSurface();
+
+    // VTK_LANDMARK_RIGIDBODY, VTK_LANDMARK_SIMILARITY or VTK_LANDMARK_AFFINE
+    vtkSetMacro( Mode, int );
+    vtkGetMacro( Mode, int );
+    void SetModeToRigidBody() { this->SetMode( VTK_LANDMARK_RIGIDBODY ); };
+    void SetModeToSimilarity() { this->SetMode( VTK_LANDMARK_SIMILARITY ); };
+    void SetModeToAffine() { this->SetMode( VTK_LANDMARK_AFFINE ); };
+
+    // Use point-to-plane distance for rigid registration (default). Otherwise point-to-point distance is used.
+    vtkSetMacro( UsePointToPlane, bool );
+    vtkGetMacro( UsePointToPlane, bool );
+    vtkBooleanMacro( UsePointToPlane, bool );
+
+    // Maximum number of iterations at each resolution level
+    vtkSetMacro( MaximumNumberOfIterations, int );
+    vtkGetMacro( MaximumNumberOfIterations, int );
+
+    // Number of resolution levels. The last level uses all source points, each previous level
+    // uses a random quarter of the points of the next one (but at least MinimumNumberOfLevelPoints).
+    // Default is 1 (all points at all iterations).
+    vtkSetClampMacro( NumberOfResolutionLevels, int, 1, 10 );
+    vtkGetMacro( NumberOfResolutionLevels, int );
+
+    // Coarse resolution levels use at least this many points (default 200)
+    vtkSetMacro( MinimumNumberOfLevelPoints, int );
+    vtkGetMacro( MinimumNumberOfLevelPoints, int );
+
+    // Iterations at a resolution level stop when no corner of the source points bounding box
+    // is moved more than this distance by an iteration (in mm, default 0.001).
+    // If 0 then MaximumNumberOfIterations are performed at each level.
+    vtkSetMacro( ConvergenceTolerance, double );
+    vtkGetMacro( ConvergenceTolerance, double );
+
+    // Fraction of the correspondences (source points) with the largest distances that are ignored
+    // when the transform change is computed at each iteration (trimmed ICP). Default is 0 (all points are used).
+    // Distance statistics always include all points.
+    vtkSetClampMacro( TrimmedFraction, double, 0.0, 0.9 );
+    vtkGetMacro( TrimmedFraction, double );
+
+    // Start the registration from the best candidate initial poses instead of the identity transform (default off).
+    // Candidates move the source centroid to the target centroid and align the principal axes of the source points
+    // with the principal axes of the target surface points, in all 24 axis-aligned orientations (axis permutations
+    // and flips), each also rotated about the first source principal axis by multiples of InitialRotationStepDegrees
+    // below 90 degrees. The candidates are scored in parallel by the mean squared distance of a random subset of
+    // NumberOfInitializationPoints source points, then the registration is run from each of the
+    // NumberOfRefinedInitializations best candidates, and the result with the smallest RMS distance is kept.
+    vtkSetMacro( UseGlobalInitialization, bool );
+    vtkGetMacro( UseGlobalInitialization, bool );
+    vtkBooleanMacro( UseGlobalInitialization, bool );
+    vtkSetClampMacro( InitialRotationStepDegrees, double, 1.0, 90.0 );
+    vtkGetMacro( InitialRotationStepDegrees, double );
+    vtkSetMacro( NumberOfInitializationPoints, int );
+    vtkGetMacro( NumberOfInitializationPoints, int );
+    vtkSetMacro( NumberOfRefinedInitializations, int );
+    vtkGetMacro( NumberOfRefinedInitializations, int );
+
+    // Number of threads used for closest point search. Default is the number of processors.
+    // Each thread needs its own copy of the target surface locator, so at most 4 threads are used.
+    vtkSetMacro( NumberOfThreads, int );
+    vtkGetMacro( NumberOfThreads, int );
+
+    // Compute the source to target transform. Distance statistics are computed
+    // for the resulting transform. Returns false if the inputs are invalid.
+    bool Update();
+
+    // Source to target transform computed by Update
+    vtkMatrix4x4* GetSourceToTargetMatrix() { return this->SourceToTargetMatrix; };
+
+    // Total number of iterations performed by the last Update (at all resolution levels, for all refined initializations)
+    vtkGetMacro( NumberOfIterations, int );
+
+    // Compute distances between the source points transformed by sourceToTarget and the target surface.
+    // Returns false if the inputs are invalid.
+    bool ComputeDistanceStatistics( vtkMatrix4x4* sourceToTarget );
+
+    // Distance statistics computed by the last Update or ComputeDistanceStatistics
+    vtkGetMacro( MeanDistance, double );
+    vtkGetMacro( RootMeanSquareDistance, double );
+    vtkGetMacro( MaximumDistance, double );
+    // Distance of each source point (in the order of the source points) from the target surface
+    vtkDoubleArray* GetPointDistances() { return this->PointDistances; };
+
+  protected:
+    vtkPointToSurfaceRegistration();
+    ~vtkPointToSurfaceRegistration();
+
+  private:
+    // Copy source points and update the target locators if needed
+    bool PrepareInputs();
+    void UpdateTargetLocators();
+
+    // Use the first numberOfPoints points of the randomly ordered source points
+    void SelectSourcePoints( int numberOfPoints );
+    // Largest displacement of the source bounding box corners by the transform
+    double GetMaximumSourceDisplacement( vtkMatrix4x4* transform );
+
+    // Find the closest target surface point of each source point transformed by sourceToTarget
+    void FindClosestPoints( vtkMatrix4x4* sourceToTarget );
+
+    // Compute the distance statistics from the last closest point search
+    void UpdateDistanceStatistics();
+
+    // Mark the correspondences that are used for computing the transform change (all but the trimmed ones)
+    void TrimCorrespondences();
+
+    // Run the coarse-to-fine iterations, starting from and updating sourceToTarget
+    void RunIterations( vtkMatrix4x4* sourceToTarget, const std::vector< int >& levelNumberOfPoints );
+
+    // Initial transforms for global initialization (16 row-major elements for each candidate)
+    void ComputeInitialTransformCandidates( std::vector< double >& candidateElements );
+    // Mean squared distance of the first numberOfPoints (randomly ordered) source points for each candidate
+    void ScoreInitialTransformCandidates( const std::vector< double >& candidateElements, int numberOfPoints, std::vector< double >& scores );
+
+    // Compute the change of the source to target transform that reduces the distances most,
+    // from the last closest point search. Returns false if it cannot be computed.
+    bool ComputePointToPlaneStep( vtkMatrix4x4* step );
+    bool ComputePointToPointStep( vtkMatrix4x4* step );
+
+    vtkSmartPointer< vtkPoints > SourcePoints;
+    vtkSmartPointer< vtkPolyData > TargetSurface;
+    int Mode;
+    bool UsePointToPlane;
+    int MaximumNumberOfIterations;
+    int NumberOfResolutionLevels;
+    int MinimumNumberOfLevelPoints;
+    double ConvergenceTolerance;
+    int NumberOfThreads;
+    double TrimmedFraction;
+    bool UseGlobalInitialization;
+    double InitialRotationStepDegrees;
+    int NumberOfInitializationPoints;
+    int NumberOfRefinedInitializations;
+
+    vtkSmartPointer< vtkMatrix4x4 > SourceToTargetMatrix;
+    int NumberOfIterations;
+    double MeanDistance;
+    double RootMeanSquareDistance;
+    double MaximumDistance;
+    vtkSmartPointer< vtkDoubleArray > PointDistances;
+
+    // Triangulated target surface, the normal of each of its triangles,
+    // and one cell locator for each thread (vtkCellLocator queries are not thread-safe).
+    // The number of locators, and so the number of threads, is limited to bound their memory and build time.
+    vtkSmartPointer< vtkPolyData > TargetTriangles;
+    std::vector< double > TargetTriangleNormals;
+    std::vector< vtkSmartPointer< vtkCellLocator > > TargetLocators;
+    vtkTimeStamp TargetLocatorsBuildTime;
+
+    // All source point coordinates (x, y, z for each point) in random order, so that
+    // the points of each resolution level are the first points of the list
+    std::vector< double > AllSourceCoordinates;
+    std::vector< int > AllSourcePointIds; // index of each point in the source points
+    double SourceBounds[ 6 ];
+
+    // Coordinates of the source points used at the current resolution level, and the results of the last
+    // closest point search: transformed source point, closest target point, target normal
+    // and squared distance for each source point
+    std::vector< double > SourceCoordinates;
+    std::vector< double > TransformedSourceCoordinates;
+    std::vector< double > ClosestPointCoordinates;
+    std::vector< double > ClosestPointNormals;
+    std::vector< double > ClosestPointDistances2;
+    std::vector< char > CorrespondenceUsed;
+
+    // Not implemented:
+    vtkPointToSurfaceRegistration( const vtkPointToSurfaceRegistration& );
+    void operator=( const vtkPointToSurfaceRegistration& );
+};
+
+#endif
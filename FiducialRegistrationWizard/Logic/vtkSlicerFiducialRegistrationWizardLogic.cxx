@@ -23,24 +23,36 @@
 #include "vtkSlicerFiducialRegistrationWizardLogic.h"
 #include "vtkPointMatcher.h"
 
+// IGTCommon includes
+#include "vtkPerformanceCounters.h"
+
 // MRML includes
 #include "vtkMRMLLinearTransformNode.h"
 #include "vtkMRMLMarkupsFiducialNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLScene.h"
 
 // VTK includes
+#include <vtkConditionVariable.h>
 #include <vtkDoubleArray.h>
+#include <vtkGridTransform.h>
+#include <vtkImageData.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPCAStatistics.h>
 #include <vtkSmartPointer.h>
 #include <vtkTable.h>
 #include <vtkThinPlateSplineTransform.h>
+#include <vtkTimerLog.h>
 #include <vtkTransform.h>
+#include <vtkTransformToGrid.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -49,6 +61,21 @@
 
 double EIGENVALUE_THRESHOLD = 1e-4;
 
+// The displacement grid of the warping transform covers the bounding box of the fiducials,
+// extended on each side by this fraction of its largest size
+double WARPING_GRID_MARGIN_FACTOR = 0.5;
+// Limit the memory used by the displacement grid
+int WARPING_GRID_MAXIMUM_NUMBER_OF_POINTS = 10000000;
+
+// The error map covers the bounding box of the fiducials, extended on each side by this fraction of its largest size
+double ERROR_MAP_MARGIN_FACTOR = 0.5;
+// The error map is meant to be low-resolution
+int ERROR_MAP_MAXIMUM_NUMBER_OF_VOXELS = 1000000;
+
+// In buffered fiducial acquisition the probe is considered stable if at least this fraction of
+// the buffered positions are within the stability tolerance
+double ACQUISITION_MINIMUM_INLIER_FRACTION = 0.8;
+
 //------------------------------------------------------------------------------
 void MarkupsFiducialNodeToVTKPoints(vtkMRMLMarkupsFiducialNode* markupsFiducialNode, vtkPoints* points)
 {
@@ -61,26 +88,291 @@ void MarkupsFiducialNodeToVTKPoints(vtkMRMLMarkupsFiducialNode* markupsFiducialN
   }
 }
 
+//------------------------------------------------------------------------------
+bool ArePointsEqual(vtkPoints* points1, vtkPoints* points2)
+{
+  if (points1 == NULL || points2 == NULL)
+  {
+    return (points1 == points2);
+  }
+  int numberOfPoints = points1->GetNumberOfPoints();
+  if (points2->GetNumberOfPoints() != numberOfPoints)
+  {
+    return false;
+  }
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    double point1[3] = { 0, 0, 0 };
+    points1->GetPoint(i, point1);
+    double point2[3] = { 0, 0, 0 };
+    points2->GetPoint(i, point2);
+    if (point1[0] != point2[0] || point1[1] != point2[1] || point1[2] != point2[2])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void SetLinearTransformToTransformNode(vtkMRMLTransformNode* transformNode, vtkMatrix4x4* matrix)
+{
+  if (!transformNode->IsLinear())
+  {
+    // SetMatrix... only works on linear transforms, if we have a non-linear transform
+    // in the node then we have to manually place a linear transform into it
+    vtkNew< vtkTransform > newLinearTransform;
+    newLinearTransform->SetMatrix(matrix);
+    transformNode->SetAndObserveTransformToParent(newLinearTransform.GetPointer());
+  }
+  else
+  {
+    transformNode->SetMatrixTransformToParent(matrix);
+  }
+}
+
 
 // Slicer methods -------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkSlicerFiducialRegistrationWizardLogic);
 
+//------------------------------------------------------------------------------
+/// Target registration error map computation on a worker thread.
+/// The main thread submits requests that contain the fiducial configuration and the map geometry,
+/// the worker thread fills the map slice by slice, and the completed slices are copied into
+/// the volume node on the main thread, so the map is updated progressively.
+/// Only the most recent request is kept for each wizard node, a map that is being computed
+/// is abandoned when a new request arrives for the same node.
+class vtkSlicerFiducialRegistrationWizardLogic::vtkInternal
+{
+public:
+  vtkInternal();
+  ~vtkInternal();
+
+  void StartThread();
+  void StopThread();
+  bool IsThreadRunning() { return this->ThreadId >= 0; }
+
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void* ptr);
+  void ProcessRequests();
+
+  struct Request
+  {
+    int Dimensions[3];
+    double Origin[3];
+    double Spacing[3];
+    // Fiducial configuration: centroid, principal axes (rows), and mean squared distance of the fiducials from each axis
+    double Centroid[3];
+    double PrincipalAxes[3][3];
+    double MeanSquaredDistanceFromAxis[3];
+    // Expected squared fiducial localization error divided by the number of fiducials
+    double SquaredErrorAtCentroid;
+  };
+
+  struct Result
+  {
+    int Dimensions[3];
+    double Origin[3];
+    double Spacing[3];
+    std::vector< float > Voxels; // RMS target registration error, in x, y, z order
+    int NumberOfCompletedSlices;
+    int NumberOfCopiedSlices; // only accessed from the main thread
+  };
+
+  // Slices copied from a result on the main thread
+  struct CompletedSlices
+  {
+    std::string NodeID;
+    int Dimensions[3];
+    double Origin[3];
+    double Spacing[3];
+    int FirstSlice;
+    std::vector< float > Voxels;
+  };
+
+  // Expected squared target registration error at a position (Fitzpatrick et al., IEEE TMI 1998)
+  static double ComputeSquaredTargetRegistrationError(const Request& request, const double position[3]);
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  int ThreadId;
+
+  // Protects StopRequested, PendingRequests, and Results
+  vtkSmartPointer<vtkMutexLock> Mutex;
+  vtkSmartPointer<vtkConditionVariable> RequestAvailable;
+  bool StopRequested;
+  std::map< std::string, Request > PendingRequests; // key: wizard node ID
+  std::map< std::string, Result > Results; // key: wizard node ID
+};
+
+//------------------------------------------------------------------------------
+vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::vtkInternal()
+: Threader(vtkSmartPointer<vtkMultiThreader>::New())
+, ThreadId(-1)
+, Mutex(vtkSmartPointer<vtkMutexLock>::New())
+, RequestAvailable(vtkSmartPointer<vtkConditionVariable>::New())
+, StopRequested(false)
+{
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::~vtkInternal()
+{
+  this->StopThread();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::StartThread()
+{
+  if (this->IsThreadRunning())
+  {
+    return;
+  }
+  this->StopRequested = false;
+  this->ThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&vtkInternal::ThreadFunction, this);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::StopThread()
+{
+  if (!this->IsThreadRunning())
+  {
+    return;
+  }
+  this->Mutex->Lock();
+  this->StopRequested = true;
+  this->RequestAvailable->Broadcast();
+  this->Mutex->Unlock();
+  this->Threader->TerminateThread(this->ThreadId); // waits for the thread to finish
+  this->ThreadId = -1;
+
+  this->PendingRequests.clear();
+  this->Results.clear();
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::ThreadFunction(void* ptr)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >(ptr);
+  vtkInternal* self = static_cast< vtkInternal* >(threadInfo->UserData);
+  self->ProcessRequests();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+double vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::ComputeSquaredTargetRegistrationError(const Request& request, const double position[3])
+{
+  // TRE^2(r) = FLE^2 / N * (1 + 1/3 * sum_k( d_k^2 / f_k^2 ))
+  // d_k: distance of r from principal axis k, f_k: RMS distance of the fiducials from principal axis k
+  double offset[3] = { position[0] - request.Centroid[0], position[1] - request.Centroid[1], position[2] - request.Centroid[2] };
+  double squaredDistanceFromCentroid = vtkMath::Dot(offset, offset);
+  double sumOfRelativeSquaredDistances = 0.0;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    double projection = vtkMath::Dot(offset, request.PrincipalAxes[axis]);
+    double squaredDistanceFromAxis = squaredDistanceFromCentroid - projection * projection;
+    sumOfRelativeSquaredDistances += squaredDistanceFromAxis / request.MeanSquaredDistanceFromAxis[axis];
+  }
+  return request.SquaredErrorAtCentroid * (1.0 + sumOfRelativeSquaredDistances / 3.0);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::vtkInternal::ProcessRequests()
+{
+  this->Mutex->Lock();
+  while (true)
+  {
+    while (this->PendingRequests.empty() && !this->StopRequested)
+    {
+      this->RequestAvailable->Wait(this->Mutex);
+    }
+    if (this->StopRequested)
+    {
+      break;
+    }
+    std::string nodeID = this->PendingRequests.begin()->first;
+    Request request = this->PendingRequests.begin()->second;
+    this->PendingRequests.erase(this->PendingRequests.begin());
+    Result& result = this->Results[nodeID];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      result.Dimensions[axis] = request.Dimensions[axis];
+      result.Origin[axis] = request.Origin[axis];
+      result.Spacing[axis] = request.Spacing[axis];
+    }
+    int numberOfVoxelsPerSlice = request.Dimensions[0] * request.Dimensions[1];
+    result.Voxels.assign(numberOfVoxelsPerSlice * request.Dimensions[2], 0.0f);
+    result.NumberOfCompletedSlices = 0;
+    result.NumberOfCopiedSlices = 0;
+    this->Mutex->Unlock();
+
+    std::vector< float > slice(numberOfVoxelsPerSlice);
+    bool abandoned = false;
+    for (int k = 0; k < request.Dimensions[2]; k++)
+    {
+      double position[3] = { 0, 0, request.Origin[2] + k * request.Spacing[2] };
+      for (int j = 0; j < request.Dimensions[1]; j++)
+      {
+        position[1] = request.Origin[1] + j * request.Spacing[1];
+        for (int i = 0; i < request.Dimensions[0]; i++)
+        {
+          position[0] = request.Origin[0] + i * request.Spacing[0];
+          slice[j * request.Dimensions[0] + i] = static_cast<float>(sqrt(ComputeSquaredTargetRegistrationError(request, position)));
+        }
+      }
+
+      this->Mutex->Lock();
+      std::map< std::string, Result >::iterator resultIt = this->Results.find(nodeID);
+      if (this->StopRequested || resultIt == this->Results.end() || this->PendingRequests.find(nodeID) != this->PendingRequests.end())
+      {
+        // stopped, node removed, or superseded by a new request: the result is not needed anymore
+        if (resultIt != this->Results.end())
+        {
+          this->Results.erase(resultIt);
+        }
+        abandoned = true;
+        break; // the mutex remains locked
+      }
+      std::copy(slice.begin(), slice.end(), resultIt->second.Voxels.begin() + k * numberOfVoxelsPerSlice);
+      resultIt->second.NumberOfCompletedSlices = k + 1;
+      this->Mutex->Unlock();
+    }
+    if (!abandoned)
+    {
+      this->Mutex->Lock();
+    }
+  }
+  this->Mutex->Unlock();
+}
+
 //------------------------------------------------------------------------------
 vtkSlicerFiducialRegistrationWizardLogic::vtkSlicerFiducialRegistrationWizardLogic()
   : MarkupsLogic(NULL)
+  , FiducialAcquisitionMode(FIDUCIAL_ACQUISITION_SINGLE_SAMPLE)
+  , AcquisitionNumberOfSamples(10)
+  , AcquisitionStabilityToleranceMm(0.5)
 {
+  this->Internal = new vtkInternal;
+  this->PerformanceCounters = vtkSmartPointer<vtkPerformanceCounters>::New();
+  this->PerformanceCounters->SetName("FiducialRegistrationWizard");
+  this->ProbeToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
 }
 
 //------------------------------------------------------------------------------
 vtkSlicerFiducialRegistrationWizardLogic::~vtkSlicerFiducialRegistrationWizardLogic()
 {
+  this->CancelAllFiducialAcquisitions();
+  delete this->Internal;
+  this->Internal = NULL;
 }
 
 //------------------------------------------------------------------------------
 void vtkSlicerFiducialRegistrationWizardLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "FiducialAcquisitionMode: " << (this->FiducialAcquisitionMode == FIDUCIAL_ACQUISITION_BUFFERED ? "buffered" : "single sample") << std::endl;
+  os << indent << "AcquisitionNumberOfSamples: " << this->AcquisitionNumberOfSamples << std::endl;
+  os << indent << "AcquisitionStabilityToleranceMm: " << this->AcquisitionStabilityToleranceMm << std::endl;
+  os << indent << "NumberOfFiducialAcquisitionsInProgress: " << this->FiducialAcquisitions.size() << std::endl;
 }
 
 //------------------------------------------------------------------------------
@@ -118,20 +410,50 @@ void vtkSlicerFiducialRegistrationWizardLogic::OnMRMLSceneNodeAdded(vtkMRMLNode*
     return;
   }
 
+  if (this->GetMRMLScene()->IsBatchProcessing())
+  {
+    return; // set up in OnMRMLSceneEndBatchProcess, when the input nodes are in the scene as well
+  }
+
   vtkMRMLFiducialRegistrationWizardNode* frwNode = vtkMRMLFiducialRegistrationWizardNode::SafeDownCast(node);
   if (frwNode)
   {
     vtkDebugMacro("OnMRMLSceneNodeAdded: Module node added.");
-    vtkUnObserveMRMLNodeMacro(frwNode); // Remove previous observers.
-    vtkNew<vtkIntArray> events;
-    events->InsertNextValue(vtkCommand::ModifiedEvent);
-    events->InsertNextValue(vtkMRMLFiducialRegistrationWizardNode::InputDataModifiedEvent);
-    vtkObserveMRMLNodeEventsMacro(frwNode, events.GetPointer());
+    this->InitializeModuleNode(frwNode);
+  }
+}
 
-    if (frwNode->GetUpdateMode() == vtkMRMLFiducialRegistrationWizardNode::UPDATE_MODE_AUTOMATIC)
-    {
-      this->UpdateCalibration(frwNode); // Will create modified event to update widget
-    }
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::OnMRMLSceneEndBatchProcess()
+{
+  if (this->GetMRMLScene() == NULL)
+  {
+    return;
+  }
+  std::vector< vtkMRMLNode* > frwNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLFiducialRegistrationWizardNode", frwNodes);
+  for (std::vector< vtkMRMLNode* >::iterator nodeIt = frwNodes.begin(); nodeIt != frwNodes.end(); ++nodeIt)
+  {
+    this->InitializeModuleNode(vtkMRMLFiducialRegistrationWizardNode::SafeDownCast(*nodeIt));
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::InitializeModuleNode(vtkMRMLFiducialRegistrationWizardNode* frwNode)
+{
+  if (frwNode == NULL)
+  {
+    return;
+  }
+  vtkUnObserveMRMLNodeMacro(frwNode); // Remove previous observers.
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkCommand::ModifiedEvent);
+  events->InsertNextValue(vtkMRMLFiducialRegistrationWizardNode::InputDataModifiedEvent);
+  vtkObserveMRMLNodeEventsMacro(frwNode, events.GetPointer());
+
+  if (frwNode->GetUpdateMode() == vtkMRMLFiducialRegistrationWizardNode::UPDATE_MODE_AUTOMATIC)
+  {
+    this->UpdateCalibration(frwNode); // Will create modified event to update widget
   }
 }
 
@@ -144,10 +466,47 @@ void vtkSlicerFiducialRegistrationWizardLogic::OnMRMLSceneNodeRemoved(vtkMRMLNod
     return;
   }
 
+  // Cancel the acquisitions of removed probes or fiducial lists
+  std::vector< vtkMRMLMarkupsFiducialNode* > cancelledAcquisitions;
+  for (std::map< vtkMRMLMarkupsFiducialNode*, FiducialAcquisitionType >::iterator acquisitionIt = this->FiducialAcquisitions.begin();
+    acquisitionIt != this->FiducialAcquisitions.end(); ++acquisitionIt)
+  {
+    if (acquisitionIt->first == node || acquisitionIt->second.ProbeTransformNode.GetPointer() == node)
+    {
+      cancelledAcquisitions.push_back(acquisitionIt->first);
+    }
+  }
+  for (std::vector< vtkMRMLMarkupsFiducialNode* >::iterator cancelledIt = cancelledAcquisitions.begin(); cancelledIt != cancelledAcquisitions.end(); ++cancelledIt)
+  {
+    this->RemoveFiducialAcquisition(*cancelledIt);
+  }
+
   if (node->IsA("vtkMRMLFiducialRegistrationWizardNode"))
   {
     vtkDebugMacro("OnMRMLSceneNodeRemoved");
     vtkUnObserveMRMLNodeMacro(node);
+    if (node->GetID())
+    {
+      this->LandmarkRegistrations.erase(node->GetID());
+      this->PointMatchers.erase(node->GetID());
+      this->WarpingGrids.erase(node->GetID());
+      this->Internal->Mutex->Lock();
+      this->Internal->PendingRequests.erase(node->GetID());
+      this->Internal->Results.erase(node->GetID());
+      this->Internal->Mutex->Unlock();
+    }
+    bool hadPendingUpdates = this->HasPendingUpdates();
+    vtkMRMLFiducialRegistrationWizardNode* frwNode = vtkMRMLFiducialRegistrationWizardNode::SafeDownCast(node);
+    this->LastFullUpdateTimeSec.erase(frwNode);
+    this->PendingUpdateNodes.erase(frwNode);
+    if (node->GetID())
+    {
+      this->ErrorMapsInProgress.erase(node->GetID());
+    }
+    if (hadPendingUpdates && !this->HasPendingUpdates())
+    {
+      this->Modified();
+    }
   }
 }
 
@@ -196,6 +555,23 @@ void vtkSlicerFiducialRegistrationWizardLogic::AddFiducial(vtkMRMLLinearTransfor
     return;
   }
 
+  if (this->FiducialAcquisitionMode == FIDUCIAL_ACQUISITION_BUFFERED)
+  {
+    // The fiducial is added when enough stable positions are collected (see ProcessProbeTransformModified)
+    this->RemoveFiducialAcquisition(fiducialNode);
+    FiducialAcquisitionType& acquisition = this->FiducialAcquisitions[fiducialNode];
+    acquisition.ProbeTransformNode = probeTransformNode;
+    acquisition.FiducialNode = fiducialNode;
+    acquisition.Positions.assign(3 * this->AcquisitionNumberOfSamples, 0.0);
+    acquisition.NumberOfSamples = 0;
+    acquisition.NextSampleIndex = 0;
+    // several acquisitions may use the same probe, observing it again has no effect
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue(vtkMRMLTransformableNode::TransformModifiedEvent);
+    vtkObserveMRMLNodeEventsMacro(probeTransformNode, events.GetPointer());
+    return;
+  }
+
   vtkSmartPointer<vtkMatrix4x4> transformToWorld = vtkSmartPointer<vtkMatrix4x4>::New();
   probeTransformNode->GetMatrixTransformToWorld(transformToWorld);
 
@@ -203,6 +579,139 @@ void vtkSlicerFiducialRegistrationWizardLogic::AddFiducial(vtkMRMLLinearTransfor
   fiducialNode->AddFiducialFromArray(coord);
 }
 
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::IsFiducialAcquisitionInProgress(vtkMRMLMarkupsFiducialNode* fiducialNode)
+{
+  return this->FiducialAcquisitions.find(fiducialNode) != this->FiducialAcquisitions.end();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::CancelFiducialAcquisition(vtkMRMLMarkupsFiducialNode* fiducialNode)
+{
+  this->RemoveFiducialAcquisition(fiducialNode);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::CancelAllFiducialAcquisitions()
+{
+  while (!this->FiducialAcquisitions.empty())
+  {
+    this->RemoveFiducialAcquisition(this->FiducialAcquisitions.begin()->first);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::RemoveFiducialAcquisition(vtkMRMLMarkupsFiducialNode* fiducialNode)
+{
+  std::map< vtkMRMLMarkupsFiducialNode*, FiducialAcquisitionType >::iterator acquisitionIt = this->FiducialAcquisitions.find(fiducialNode);
+  if (acquisitionIt == this->FiducialAcquisitions.end())
+  {
+    return;
+  }
+  vtkMRMLLinearTransformNode* probeTransformNode = acquisitionIt->second.ProbeTransformNode;
+  this->FiducialAcquisitions.erase(acquisitionIt);
+  if (probeTransformNode == NULL)
+  {
+    return;
+  }
+  for (acquisitionIt = this->FiducialAcquisitions.begin(); acquisitionIt != this->FiducialAcquisitions.end(); ++acquisitionIt)
+  {
+    if (acquisitionIt->second.ProbeTransformNode.GetPointer() == probeTransformNode)
+    {
+      // the probe is still used by another acquisition
+      return;
+    }
+  }
+  vtkUnObserveMRMLNodeMacro(probeTransformNode);
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::ProcessProbeTransformModified(vtkMRMLTransformNode* probeTransformNode)
+{
+  probeTransformNode->GetMatrixTransformToWorld(this->ProbeToWorldMatrix);
+  std::vector< vtkMRMLMarkupsFiducialNode* > completedAcquisitions;
+  for (std::map< vtkMRMLMarkupsFiducialNode*, FiducialAcquisitionType >::iterator acquisitionIt = this->FiducialAcquisitions.begin();
+    acquisitionIt != this->FiducialAcquisitions.end(); ++acquisitionIt)
+  {
+    FiducialAcquisitionType& acquisition = acquisitionIt->second;
+    if (acquisition.ProbeTransformNode.GetPointer() != probeTransformNode)
+    {
+      continue;
+    }
+    int numberOfBufferSamples = static_cast<int>(acquisition.Positions.size() / 3);
+    for (int i = 0; i < 3; i++)
+    {
+      acquisition.Positions[3 * acquisition.NextSampleIndex + i] = this->ProbeToWorldMatrix->GetElement(i, 3);
+    }
+    acquisition.NextSampleIndex = (acquisition.NextSampleIndex + 1) % numberOfBufferSamples;
+    if (acquisition.NumberOfSamples < numberOfBufferSamples)
+    {
+      acquisition.NumberOfSamples++;
+    }
+    double position[3] = { 0.0, 0.0, 0.0 };
+    if (acquisition.FiducialNode.GetPointer() == NULL || !this->ComputeStableFiducialPosition(acquisition, position))
+    {
+      continue;
+    }
+    acquisition.FiducialNode->AddFiducialFromArray(position);
+    completedAcquisitions.push_back(acquisitionIt->first);
+  }
+  // Events are invoked after the acquisitions are updated, as observers may start new acquisitions
+  for (std::vector< vtkMRMLMarkupsFiducialNode* >::iterator completedIt = completedAcquisitions.begin(); completedIt != completedAcquisitions.end(); ++completedIt)
+  {
+    vtkMRMLMarkupsFiducialNode* fiducialNode = *completedIt;
+    this->RemoveFiducialAcquisition(fiducialNode);
+    this->InvokeEvent(FiducialAcquiredEvent, fiducialNode);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::ComputeStableFiducialPosition(const FiducialAcquisitionType& acquisition, double position[3])
+{
+  int numberOfSamples = acquisition.NumberOfSamples;
+  if (numberOfSamples < static_cast<int>(acquisition.Positions.size() / 3))
+  {
+    // buffer is not full yet
+    return false;
+  }
+  // The median is not affected by a few outliers (e.g., tracker glitches)
+  double median[3] = { 0.0, 0.0, 0.0 };
+  std::vector<double> coordinates(numberOfSamples);
+  for (int i = 0; i < 3; i++)
+  {
+    for (int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++)
+    {
+      coordinates[sampleIndex] = acquisition.Positions[3 * sampleIndex + i];
+    }
+    std::nth_element(coordinates.begin(), coordinates.begin() + numberOfSamples / 2, coordinates.end());
+    median[i] = coordinates[numberOfSamples / 2];
+  }
+  // Average the samples close to the median. The probe is held still if most of the samples are close.
+  double toleranceSquared = this->AcquisitionStabilityToleranceMm * this->AcquisitionStabilityToleranceMm;
+  int numberOfInliers = 0;
+  double sum[3] = { 0.0, 0.0, 0.0 };
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; sampleIndex++)
+  {
+    const double* sample = &(acquisition.Positions[3 * sampleIndex]);
+    if (vtkMath::Distance2BetweenPoints(sample, median) > toleranceSquared)
+    {
+      continue;
+    }
+    numberOfInliers++;
+    sum[0] += sample[0];
+    sum[1] += sample[1];
+    sum[2] += sample[2];
+  }
+  if (numberOfInliers < ACQUISITION_MINIMUM_INLIER_FRACTION * numberOfSamples)
+  {
+    return false;
+  }
+  position[0] = sum[0] / numberOfInliers;
+  position[1] = sum[1] / numberOfInliers;
+  position[2] = sum[2] / numberOfInliers;
+  return true;
+}
+
 //------------------------------------------------------------------------------
 bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* node)
 {
@@ -286,7 +795,9 @@ bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* no
         << " registration is being used." << std::endl << "Unexpected results may occur.";
       fiducialRegistrationWizardNode->AddToCalibrationStatusMessage(msg.str());
     }
-    const int MAX_NUMBER_OF_POINTS_FOR_POINT_MATCHING_AUTOMATIC = 8; // more than this and it tends to take a long time. Algorithm is at least N!
+    // The branch-and-bound search in vtkPointMatcher prunes most pairings early, so matching remains interactive
+    // up to this many points (see vtkFiducialRegistrationWizardMatchingBenchmark). The worst case is still exponential.
+    const int MAX_NUMBER_OF_POINTS_FOR_POINT_MATCHING_AUTOMATIC = 20;
     int fromNumberOfPoints = fromPointsUnordered->GetNumberOfPoints();
     int toNumberOfPoints = toPointsUnordered->GetNumberOfPoints();
     int numberOfPointsToMatch = std::max(fromNumberOfPoints, toNumberOfPoints);
@@ -299,12 +810,13 @@ bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* no
       fiducialRegistrationWizardNode->AddToCalibrationStatusMessage(msg.str());
       return false;
     }
-    vtkSmartPointer< vtkPointMatcher > pointMatcher = vtkSmartPointer< vtkPointMatcher >::New();
+    vtkPointMatcher* pointMatcher = this->GetPointMatcher(fiducialRegistrationWizardNode);
     pointMatcher->SetInputPointList1(fromPointsUnordered);
     pointMatcher->SetInputPointList2(toPointsUnordered);
     pointMatcher->SetMaximumDifferenceInNumberOfPoints(2);
     pointMatcher->SetTolerableRootMeanSquareDistanceErrorMm(10.0);
     pointMatcher->SetAmbiguityThresholdDistanceMm(5.0);
+    pointMatcher->UseMultithreadingOn();
     pointMatcher->Update();
     if (!pointMatcher->IsMatchingWithinTolerance())
     {
@@ -335,54 +847,50 @@ bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* no
     return false;
   }
 
+  // Rigid and similarity registrations are computed incrementally from the previous update
+  int registrationMode = fiducialRegistrationWizardNode->GetRegistrationMode();
+  vtkIncrementalLandmarkRegistration* landmarkRegistration = NULL;
+  if (registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_RIGID ||
+    registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_SIMILARITY)
+  {
+    landmarkRegistration = this->GetLandmarkRegistration(fiducialRegistrationWizardNode);
+    landmarkRegistration->SetLandmarks(fromPointsOrdered, toPointsOrdered);
+  }
+
   // error checking
-  if (this->CheckCollinear(fromPointsOrdered))
+  bool fromPointsCollinear = (landmarkRegistration != NULL ? landmarkRegistration->IsSourceCollinear(EIGENVALUE_THRESHOLD) : this->CheckCollinear(fromPointsOrdered));
+  if (fromPointsCollinear)
   {
     fiducialRegistrationWizardNode->SetCalibrationStatusMessage("'From' fiducial list has strictly collinear or singular points.");
     return false;
   }
 
-  if (this->CheckCollinear(toPointsOrdered))
+  bool toPointsCollinear = (landmarkRegistration != NULL ? landmarkRegistration->IsTargetCollinear(EIGENVALUE_THRESHOLD) : this->CheckCollinear(toPointsOrdered));
+  if (toPointsCollinear)
   {
     fiducialRegistrationWizardNode->SetCalibrationStatusMessage("'To' fiducial list has strictly collinear or singular points.");
     return false;
   }
 
   // compute registration
-  int registrationMode = fiducialRegistrationWizardNode->GetRegistrationMode();
   if (registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_RIGID ||
     registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_SIMILARITY)
   {
-    // Compute transformation matrix. We don't set the landmark transform in the node directly because
-    // vtkLandmarkTransform is not fully supported (e.g., it cannot be stored in file).
-    vtkNew<vtkLandmarkTransform> landmarkTransform;
-    landmarkTransform->SetSourceLandmarks(fromPointsOrdered);
-    landmarkTransform->SetTargetLandmarks(toPointsOrdered);
+    // Compute transformation matrix (same as what vtkLandmarkTransform computes). We don't set a landmark
+    // transform in the node directly because vtkLandmarkTransform is not fully supported (e.g., it cannot be stored in file).
     if (registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_RIGID)
     {
-      landmarkTransform->SetModeToRigidBody();
+      landmarkRegistration->SetModeToRigidBody();
     }
     else
     {
-      landmarkTransform->SetModeToSimilarity();
+      landmarkRegistration->SetModeToSimilarity();
     }
-    landmarkTransform->Update();
     vtkNew< vtkMatrix4x4 > calculatedTransform;
-    landmarkTransform->GetMatrix(calculatedTransform.GetPointer());
+    landmarkRegistration->GetMatrix(calculatedTransform.GetPointer());
 
     // Copy the resulting transform into the outputTransformNode
-    if (!outputTransformNode->IsLinear())
-    {
-      // SetMatrix... only works on linear transforms, if we have a non-linear transform
-      // in the node then we have to manually place a linear transform into it
-      vtkNew< vtkTransform > newLinearTransform;
-      newLinearTransform->SetMatrix(calculatedTransform.GetPointer());
-      outputTransformNode->SetAndObserveTransformToParent(newLinearTransform.GetPointer());
-    }
-    else
-    {
-      outputTransformNode->SetMatrixTransformToParent(calculatedTransform.GetPointer());
-    }
+    SetLinearTransformToTransformNode(outputTransformNode, calculatedTransform.GetPointer());
   }
   else if (registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_WARPING)
   {
@@ -393,48 +901,61 @@ bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* no
       return false;
     }
 
-    // Setup the transform
     // Warping transforms are usually defined using FromParent direction to make transformation of images faster and more accurate.
-    bool logErrorIfFails = false; // parameters from http://apidocs.slicer.org/master/classvtkMRMLTransformNode.html#a79e612958c341ea681ac84282df42261
-    bool modifiableOnly = true;
-    vtkThinPlateSplineTransform* tpsTransform = NULL;
+    vtkPoints* sourceLandmarks = fromPointsOrdered;
+    vtkPoints* targetLandmarks = toPointsOrdered;
     if (fiducialRegistrationWizardNode->GetWarpingTransformFromParent())
     {
-      tpsTransform = vtkThinPlateSplineTransform::SafeDownCast(
-        outputTransformNode->GetTransformFromParentAs("vtkThinPlateSplineTransform", logErrorIfFails, modifiableOnly));
+      sourceLandmarks = toPointsOrdered;
+      targetLandmarks = fromPointsOrdered;
     }
-    else
+
+    if (fiducialRegistrationWizardNode->GetWarpingGridSpacingMm() > 0.0)
     {
-      tpsTransform = vtkThinPlateSplineTransform::SafeDownCast(
-        outputTransformNode->GetTransformToParentAs("vtkThinPlateSplineTransform", logErrorIfFails, modifiableOnly));
+      if (!this->UpdateWarpingGridTransform(fiducialRegistrationWizardNode, sourceLandmarks, targetLandmarks))
+      {
+        return false;
+      }
     }
-    if (tpsTransform == NULL)
+    else
     {
-      // we cannot reuse the existing transform, create a new one
-      vtkNew< vtkThinPlateSplineTransform > newTpsTransform;
-      newTpsTransform->SetBasisToR();
-      tpsTransform = newTpsTransform.GetPointer();
+      // Setup the transform
+      bool logErrorIfFails = false; // parameters from http://apidocs.slicer.org/master/classvtkMRMLTransformNode.html#a79e612958c341ea681ac84282df42261
+      bool modifiableOnly = true;
+      vtkThinPlateSplineTransform* tpsTransform = NULL;
       if (fiducialRegistrationWizardNode->GetWarpingTransformFromParent())
       {
-        outputTransformNode->SetAndObserveTransformFromParent(tpsTransform);
+        tpsTransform = vtkThinPlateSplineTransform::SafeDownCast(
+          outputTransformNode->GetTransformFromParentAs("vtkThinPlateSplineTransform", logErrorIfFails, modifiableOnly));
       }
       else
       {
-        outputTransformNode->SetAndObserveTransformToParent(tpsTransform);
+        tpsTransform = vtkThinPlateSplineTransform::SafeDownCast(
+          outputTransformNode->GetTransformToParentAs("vtkThinPlateSplineTransform", logErrorIfFails, modifiableOnly));
       }
+      if (tpsTransform == NULL)
+      {
+        // we cannot reuse the existing transform, create a new one
+        vtkNew< vtkThinPlateSplineTransform > newTpsTransform;
+        newTpsTransform->SetBasisToR();
+        tpsTransform = newTpsTransform.GetPointer();
+        if (fiducialRegistrationWizardNode->GetWarpingTransformFromParent())
+        {
+          outputTransformNode->SetAndObserveTransformFromParent(tpsTransform);
+        }
+        else
+        {
+          outputTransformNode->SetAndObserveTransformToParent(tpsTransform);
+        }
+      }
+      // Set inputs. Solving the spline is expensive, so it is only done if the landmarks changed.
+      if (!ArePointsEqual(tpsTransform->GetSourceLandmarks(), sourceLandmarks) || !ArePointsEqual(tpsTransform->GetTargetLandmarks(), targetLandmarks))
+      {
+        tpsTransform->SetSourceLandmarks(sourceLandmarks);
+        tpsTransform->SetTargetLandmarks(targetLandmarks);
+      }
+      tpsTransform->Update();
     }
-    // Set inputs
-    if (fiducialRegistrationWizardNode->GetWarpingTransformFromParent())
-    {
-      tpsTransform->SetSourceLandmarks(toPointsOrdered);
-      tpsTransform->SetTargetLandmarks(fromPointsOrdered);
-    }
-    else
-    {
-      tpsTransform->SetSourceLandmarks(fromPointsOrdered);
-      tpsTransform->SetTargetLandmarks(toPointsOrdered);
-    }
-    tpsTransform->Update();
   }
   else
   {
@@ -453,9 +974,15 @@ bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibration(vtkMRMLNode* no
   }
 
   std::stringstream completeMessage;
-  double rmsError = this->CalculateRegistrationError(fromPointsOrdered, toPointsOrdered, outputTransform);
+  double rmsError = (landmarkRegistration != NULL ? landmarkRegistration->GetRootMeanSquareError()
+    : this->CalculateRegistrationError(fromPointsOrdered, toPointsOrdered, outputTransform));
   completeMessage << "Registration Complete. RMS Error: " << rmsError;
   fiducialRegistrationWizardNode->AddToCalibrationStatusMessage(completeMessage.str());
+
+  if (landmarkRegistration != NULL)
+  {
+    this->RequestErrorMapUpdate(fiducialRegistrationWizardNode, toPointsOrdered, rmsError);
+  }
   return true;
 }
 
@@ -543,6 +1070,13 @@ bool vtkSlicerFiducialRegistrationWizardLogic::CheckCollinear(vtkPoints* points)
 //------------------------------------------------------------------------------
 void vtkSlicerFiducialRegistrationWizardLogic::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* vtkNotUsed(callData))
 {
+  if (event == vtkMRMLTransformableNode::TransformModifiedEvent && vtkMRMLTransformNode::SafeDownCast(caller) != NULL)
+  {
+    // probe of a buffered fiducial acquisition moved
+    this->ProcessProbeTransformModified(vtkMRMLTransformNode::SafeDownCast(caller));
+    return;
+  }
+
   vtkMRMLFiducialRegistrationWizardNode* frwNode = vtkMRMLFiducialRegistrationWizardNode::SafeDownCast(caller);
   if (frwNode == NULL)
   {
@@ -553,9 +1087,518 @@ void vtkSlicerFiducialRegistrationWizardLogic::ProcessMRMLNodesEvents(vtkObject*
   // (for example we do not recompute the calibration output if the computed calibration transform or status message is changed)
   if (event == vtkMRMLFiducialRegistrationWizardNode::InputDataModifiedEvent)
   {
+    this->PerformanceCounters->EventReceived();
     if (frwNode->GetUpdateMode() == vtkMRMLFiducialRegistrationWizardNode::UPDATE_MODE_AUTOMATIC)
     {
-      this->UpdateCalibration(frwNode); // Will create modified event to update widget
+      this->RequestCalibrationUpdate(frwNode); // Will create modified event to update widget
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::RequestCalibrationUpdate(vtkMRMLFiducialRegistrationWizardNode* node)
+{
+  int fullUpdatesPerSecond = node->GetFullUpdatesPerSecond();
+  if (!node->GetLivePreview() || fullUpdatesPerSecond <= 0 || !IsFullUpdateExpensive(node))
+  {
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    this->UpdateCalibration(node);
+    this->PerformanceCounters->EndUpdate(updateStartTimeSec);
+    return;
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  std::map< vtkMRMLFiducialRegistrationWizardNode*, double >::iterator lastUpdateIt = this->LastFullUpdateTimeSec.find(node);
+  if (lastUpdateIt == this->LastFullUpdateTimeSec.end() || currentTimeSec - lastUpdateIt->second >= 1.0 / fullUpdatesPerSecond)
+  {
+    this->LastFullUpdateTimeSec[node] = currentTimeSec;
+    if (this->PendingUpdateNodes.erase(node) > 0 && this->PendingUpdateNodes.empty())
+    {
+      this->Modified();
+    }
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    this->UpdateCalibration(node);
+    this->PerformanceCounters->EndUpdate(updateStartTimeSec);
+    return;
+  }
+
+  // Too early for a full update. Show a quick preview now, the full update is performed
+  // when it is due (also after the fiducials stopped changing).
+  this->UpdateCalibrationPreview(node);
+  this->PerformanceCounters->UpdateSkipped();
+  bool hadPendingUpdates = !this->PendingUpdateNodes.empty();
+  this->PendingUpdateNodes.insert(node);
+  if (!hadPendingUpdates)
+  {
+    this->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::ProcessPendingUpdates()
+{
+  if (!this->HasPendingUpdates())
+  {
+    return;
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  // copy, as the set may be modified by the updates
+  std::set< vtkMRMLFiducialRegistrationWizardNode* > pendingUpdateNodes = this->PendingUpdateNodes;
+  for (std::set< vtkMRMLFiducialRegistrationWizardNode* >::iterator nodeIt = pendingUpdateNodes.begin(); nodeIt != pendingUpdateNodes.end(); ++nodeIt)
+  {
+    vtkMRMLFiducialRegistrationWizardNode* node = *nodeIt;
+    if (node->GetUpdateMode() != vtkMRMLFiducialRegistrationWizardNode::UPDATE_MODE_AUTOMATIC)
+    {
+      // auto-update was turned off in the meantime
+      this->PendingUpdateNodes.erase(node);
+      continue;
+    }
+    int fullUpdatesPerSecond = node->GetFullUpdatesPerSecond();
+    if (node->GetLivePreview() && fullUpdatesPerSecond > 0 && currentTimeSec - this->LastFullUpdateTimeSec[node] < 1.0 / fullUpdatesPerSecond)
+    {
+      // not due yet
+      continue;
+    }
+    this->LastFullUpdateTimeSec[node] = currentTimeSec;
+    this->PendingUpdateNodes.erase(node);
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    this->UpdateCalibration(node);
+    this->PerformanceCounters->EndUpdate(updateStartTimeSec);
+  }
+
+  this->ProcessErrorMapResults();
+
+  if (!this->HasPendingUpdates())
+  {
+    this->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::HasPendingUpdates()
+{
+  return !this->PendingUpdateNodes.empty() || !this->ErrorMapsInProgress.empty();
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerFiducialRegistrationWizardLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::IsFullUpdateExpensive(vtkMRMLFiducialRegistrationWizardNode* node)
+{
+  return (node->GetRegistrationMode() == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_WARPING
+    || node->GetPointMatching() == vtkMRMLFiducialRegistrationWizardNode::POINT_MATCHING_AUTOMATIC);
+}
+
+//------------------------------------------------------------------------------
+vtkPointMatcher* vtkSlicerFiducialRegistrationWizardLogic::GetPointMatcher(vtkMRMLFiducialRegistrationWizardNode* node)
+{
+  std::string nodeID = (node->GetID() ? node->GetID() : "");
+  vtkSmartPointer< vtkPointMatcher >& pointMatcher = this->PointMatchers[nodeID];
+  if (pointMatcher == NULL)
+  {
+    pointMatcher = vtkSmartPointer< vtkPointMatcher >::New();
+  }
+  return pointMatcher;
+}
+
+//------------------------------------------------------------------------------
+vtkIncrementalLandmarkRegistration* vtkSlicerFiducialRegistrationWizardLogic::GetLandmarkRegistration(vtkMRMLFiducialRegistrationWizardNode* node)
+{
+  std::string nodeID = (node->GetID() ? node->GetID() : "");
+  vtkSmartPointer< vtkIncrementalLandmarkRegistration >& registration = this->LandmarkRegistrations[nodeID];
+  if (registration == NULL)
+  {
+    registration = vtkSmartPointer< vtkIncrementalLandmarkRegistration >::New();
+  }
+  return registration;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::UpdateCalibrationPreview(vtkMRMLFiducialRegistrationWizardNode* node)
+{
+  // Errors are not reported here, the full update reports them
+  vtkMRMLMarkupsFiducialNode* fromMarkupsFiducialNode = node->GetFromFiducialListNode();
+  vtkMRMLMarkupsFiducialNode* toMarkupsFiducialNode = node->GetToFiducialListNode();
+  vtkMRMLTransformNode* outputTransformNode = node->GetOutputTransformNode();
+  if (fromMarkupsFiducialNode == NULL || toMarkupsFiducialNode == NULL || outputTransformNode == NULL)
+  {
+    return false;
+  }
+  int registrationMode = node->GetRegistrationMode();
+  if (registrationMode != vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_RIGID
+    && registrationMode != vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_SIMILARITY)
+  {
+    // a linear preview must not replace the warping transform in the output node
+    return false;
+  }
+
+  vtkNew< vtkPoints > fromPoints;
+  MarkupsFiducialNodeToVTKPoints(fromMarkupsFiducialNode, fromPoints.GetPointer());
+  vtkNew< vtkPoints > toPoints;
+  MarkupsFiducialNodeToVTKPoints(toMarkupsFiducialNode, toPoints.GetPointer());
+
+  if (node->GetPointMatching() == vtkMRMLFiducialRegistrationWizardNode::POINT_MATCHING_AUTOMATIC)
+  {
+    // Matching is too expensive to run for each preview. Pair the current fiducial positions
+    // in the order found by the last full update (fiducials added since then are ignored).
+    std::vector< int > fromPointIndices;
+    std::vector< int > toPointIndices;
+    if (!this->GetPointMatcher(node)->GetLastMatchedPointIndices(fromPointIndices, toPointIndices))
+    {
+      return false;
+    }
+    vtkNew< vtkPoints > fromPointsUnordered;
+    fromPointsUnordered->DeepCopy(fromPoints.GetPointer());
+    vtkNew< vtkPoints > toPointsUnordered;
+    toPointsUnordered->DeepCopy(toPoints.GetPointer());
+    int numberOfPairs = static_cast<int>(fromPointIndices.size());
+    fromPoints->SetNumberOfPoints(numberOfPairs);
+    toPoints->SetNumberOfPoints(numberOfPairs);
+    for (int pairIndex = 0; pairIndex < numberOfPairs; pairIndex++)
+    {
+      if (fromPointIndices[pairIndex] >= fromPointsUnordered->GetNumberOfPoints()
+        || toPointIndices[pairIndex] >= toPointsUnordered->GetNumberOfPoints())
+      {
+        // a matched fiducial has been removed
+        return false;
+      }
+      fromPoints->SetPoint(pairIndex, fromPointsUnordered->GetPoint(fromPointIndices[pairIndex]));
+      toPoints->SetPoint(pairIndex, toPointsUnordered->GetPoint(toPointIndices[pairIndex]));
+    }
+  }
+  else if (node->GetPointMatching() != vtkMRMLFiducialRegistrationWizardNode::POINT_MATCHING_MANUAL
+    || toPoints->GetNumberOfPoints() != fromPoints->GetNumberOfPoints())
+  {
+    return false;
+  }
+  if (fromPoints->GetNumberOfPoints() < 3)
+  {
+    return false;
+  }
+
+  vtkIncrementalLandmarkRegistration* landmarkRegistration = this->GetLandmarkRegistration(node);
+  landmarkRegistration->SetLandmarks(fromPoints.GetPointer(), toPoints.GetPointer());
+  if (landmarkRegistration->IsSourceCollinear(EIGENVALUE_THRESHOLD) || landmarkRegistration->IsTargetCollinear(EIGENVALUE_THRESHOLD))
+  {
+    return false;
+  }
+  if (registrationMode == vtkMRMLFiducialRegistrationWizardNode::REGISTRATION_MODE_RIGID)
+  {
+    landmarkRegistration->SetModeToRigidBody();
+  }
+  else
+  {
+    landmarkRegistration->SetModeToSimilarity();
+  }
+  vtkNew< vtkMatrix4x4 > calculatedTransform;
+  landmarkRegistration->GetMatrix(calculatedTransform.GetPointer());
+  SetLinearTransformToTransformNode(outputTransformNode, calculatedTransform.GetPointer());
+
+  node->SetCalibrationStatusMessage("Live preview. Full update is pending.");
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerFiducialRegistrationWizardLogic::UpdateWarpingGridTransform(vtkMRMLFiducialRegistrationWizardNode* node, vtkPoints* sourceLandmarks, vtkPoints* targetLandmarks)
+{
+  vtkMRMLTransformNode* outputTransformNode = node->GetOutputTransformNode();
+  std::string nodeID = (node->GetID() ? node->GetID() : "");
+  WarpingGridType& warpingGrid = this->WarpingGrids[nodeID];
+  if (warpingGrid.Spline == NULL)
+  {
+    warpingGrid.Spline = vtkSmartPointer< vtkThinPlateSplineTransform >::New();
+    warpingGrid.Spline->SetBasisToR();
+    warpingGrid.Grid = vtkSmartPointer< vtkGridTransform >::New();
+    warpingGrid.Grid->SetInterpolationModeToCubic();
+    warpingGrid.SpacingMm = 0.0;
+  }
+
+  bool fromParent = node->GetWarpingTransformFromParent();
+  vtkAbstractTransform* currentTransform = (fromParent ? outputTransformNode->GetTransformFromParent() : outputTransformNode->GetTransformToParent());
+  double spacingMm = node->GetWarpingGridSpacingMm();
+  if (ArePointsEqual(warpingGrid.Spline->GetSourceLandmarks(), sourceLandmarks)
+    && ArePointsEqual(warpingGrid.Spline->GetTargetLandmarks(), targetLandmarks)
+    && warpingGrid.SpacingMm == spacingMm && currentTransform == warpingGrid.Grid.GetPointer())
+  {
+    // the grid in the output transform node is up-to-date
+    return true;
+  }
+
+  // The ordered point lists are created for each update, so the spline can keep them
+  warpingGrid.Spline->SetSourceLandmarks(sourceLandmarks);
+  warpingGrid.Spline->SetTargetLandmarks(targetLandmarks);
+  warpingGrid.Spline->Update();
+
+  // Grid geometry
+  double bounds[6] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  vtkPoints* landmarks[2] = { sourceLandmarks, targetLandmarks };
+  for (int listIndex = 0; listIndex < 2; listIndex++)
+  {
+    for (int i = 0; i < landmarks[listIndex]->GetNumberOfPoints(); i++)
+    {
+      double point[3] = { 0, 0, 0 };
+      landmarks[listIndex]->GetPoint(i, point);
+      for (int axis = 0; axis < 3; axis++)
+      {
+        bounds[2 * axis] = std::min(bounds[2 * axis], point[axis]);
+        bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], point[axis]);
+      }
+    }
+  }
+  double marginMm = WARPING_GRID_MARGIN_FACTOR * std::max(bounds[1] - bounds[0], std::max(bounds[3] - bounds[2], bounds[5] - bounds[4]));
+  int gridExtent[6] = { 0, 0, 0, 0, 0, 0 };
+  double gridOrigin[3] = { 0, 0, 0 };
+  double numberOfGridPoints = 1.0;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    gridOrigin[axis] = bounds[2 * axis] - marginMm;
+    gridExtent[2 * axis + 1] = static_cast<int>(ceil((bounds[2 * axis + 1] - bounds[2 * axis] + 2.0 * marginMm) / spacingMm));
+    numberOfGridPoints *= gridExtent[2 * axis + 1] + 1;
+  }
+  if (numberOfGridPoints > WARPING_GRID_MAXIMUM_NUMBER_OF_POINTS)
+  {
+    std::stringstream msg;
+    msg << "Warping grid spacing of " << spacingMm << "mm is too small for the extent of the fiducials." << std::endl
+      << "Aborting registration.";
+    node->SetCalibrationStatusMessage(msg.str());
+    return false;
+  }
+
+  // Sample the displacements once, so that resampling does not evaluate the spline for each voxel
+  vtkNew< vtkTransformToGrid > transformToGrid;
+  transformToGrid->SetInput(warpingGrid.Spline);
+  transformToGrid->SetGridOrigin(gridOrigin);
+  transformToGrid->SetGridSpacing(spacingMm, spacingMm, spacingMm);
+  transformToGrid->SetGridExtent(gridExtent);
+  transformToGrid->Update();
+  vtkNew< vtkImageData > displacementGrid;
+  displacementGrid->ShallowCopy(transformToGrid->GetOutput());
+  warpingGrid.Grid->SetDisplacementGridData(displacementGrid.GetPointer());
+  warpingGrid.Grid->SetDisplacementShift(transformToGrid->GetDisplacementShift());
+  warpingGrid.Grid->SetDisplacementScale(transformToGrid->GetDisplacementScale());
+  warpingGrid.SpacingMm = spacingMm;
+
+  if (currentTransform != warpingGrid.Grid.GetPointer())
+  {
+    if (fromParent)
+    {
+      outputTransformNode->SetAndObserveTransformFromParent(warpingGrid.Grid);
+    }
+    else
+    {
+      outputTransformNode->SetAndObserveTransformToParent(warpingGrid.Grid);
+    }
+  }
+  else
+  {
+    // the node observes the transform and propagates the modification
+    warpingGrid.Grid->Modified();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::RequestErrorMapUpdate(vtkMRMLFiducialRegistrationWizardNode* node, vtkPoints* points, double rmsError)
+{
+  if (node->GetErrorMapVolumeNode() == NULL || node->GetID() == NULL)
+  {
+    return;
+  }
+  int numberOfPoints = points->GetNumberOfPoints();
+  if (numberOfPoints <= 2)
+  {
+    // the localization error cannot be estimated from the registration error
+    return;
+  }
+  double spacingMm = node->GetErrorMapSpacingMm();
+  if (spacingMm <= 0.0)
+  {
+    vtkWarningMacro("vtkSlicerFiducialRegistrationWizardLogic::RequestErrorMapUpdate failed: invalid error map spacing " << spacingMm);
+    return;
+  }
+
+  vtkInternal::Request request;
+
+  // Principal axes of the fiducial configuration
+  double covariance[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+  double bounds[6] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  for (int axis = 0; axis < 3; axis++)
+  {
+    request.Centroid[axis] = 0.0;
+  }
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    double point[3] = { 0, 0, 0 };
+    points->GetPoint(i, point);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      request.Centroid[axis] += point[axis] / numberOfPoints;
+      bounds[2 * axis] = std::min(bounds[2 * axis], point[axis]);
+      bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], point[axis]);
+    }
+  }
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    double point[3] = { 0, 0, 0 };
+    points->GetPoint(i, point);
+    vtkMath::Subtract(point, request.Centroid, point);
+    for (int row = 0; row < 3; row++)
+    {
+      for (int column = 0; column < 3; column++)
+      {
+        covariance[row][column] += point[row] * point[column] / numberOfPoints;
+      }
+    }
+  }
+  double eigenvalues[3] = { 0, 0, 0 };
+  double eigenvectors[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+  double* covarianceRows[3] = { covariance[0], covariance[1], covariance[2] };
+  double* eigenvectorRows[3] = { eigenvectors[0], eigenvectors[1], eigenvectors[2] };
+  vtkMath::Jacobi(covarianceRows, eigenvalues, eigenvectorRows); // eigenvectors are the columns
+  for (int axis = 0; axis < 3; axis++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      request.PrincipalAxes[axis][i] = eigenvectors[i][axis];
+    }
+    request.MeanSquaredDistanceFromAxis[axis] = eigenvalues[(axis + 1) % 3] + eigenvalues[(axis + 2) % 3];
+    if (request.MeanSquaredDistanceFromAxis[axis] < EIGENVALUE_THRESHOLD)
+    {
+      // collinear fiducials, the error is not bounded
+      return;
+    }
+  }
+  // Expected FRE^2 = (1 - 2/N) FLE^2
+  request.SquaredErrorAtCentroid = rmsError * rmsError / (numberOfPoints - 2);
+
+  // Map geometry
+  double marginMm = ERROR_MAP_MARGIN_FACTOR * std::max(bounds[1] - bounds[0], std::max(bounds[3] - bounds[2], bounds[5] - bounds[4]));
+  double numberOfVoxels = 1.0;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    request.Origin[axis] = bounds[2 * axis] - marginMm;
+    request.Spacing[axis] = spacingMm;
+    request.Dimensions[axis] = static_cast<int>(ceil((bounds[2 * axis + 1] - bounds[2 * axis] + 2.0 * marginMm) / spacingMm)) + 1;
+    numberOfVoxels *= request.Dimensions[axis];
+  }
+  if (numberOfVoxels > ERROR_MAP_MAXIMUM_NUMBER_OF_VOXELS)
+  {
+    vtkWarningMacro("vtkSlicerFiducialRegistrationWizardLogic::RequestErrorMapUpdate failed: error map spacing of " << spacingMm << "mm is too small for the extent of the fiducials");
+    return;
+  }
+
+  this->Internal->StartThread();
+  this->Internal->Mutex->Lock();
+  this->Internal->PendingRequests[node->GetID()] = request; // replaces the previous request if it is not processed yet
+  this->Internal->RequestAvailable->Signal();
+  this->Internal->Mutex->Unlock();
+
+  bool hadPendingUpdates = this->HasPendingUpdates();
+  this->ErrorMapsInProgress.insert(node->GetID());
+  if (!hadPendingUpdates)
+  {
+    this->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerFiducialRegistrationWizardLogic::ProcessErrorMapResults()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (this->ErrorMapsInProgress.empty() || scene == NULL)
+  {
+    return;
+  }
+
+  // Collect the newly completed slices. MRML nodes are not modified while the mutex is locked,
+  // as observers may submit new requests.
+  std::vector< vtkInternal::CompletedSlices > completedSlicesList;
+  this->Internal->Mutex->Lock();
+  for (std::set< std::string >::iterator nodeIdIt = this->ErrorMapsInProgress.begin(); nodeIdIt != this->ErrorMapsInProgress.end(); )
+  {
+    std::map< std::string, vtkInternal::Result >::iterator resultIt = this->Internal->Results.find(*nodeIdIt);
+    if (resultIt == this->Internal->Results.end() || resultIt->second.NumberOfCompletedSlices == resultIt->second.NumberOfCopiedSlices)
+    {
+      // not started yet or no new slices
+      ++nodeIdIt;
+      continue;
+    }
+    vtkInternal::Result& result = resultIt->second;
+    completedSlicesList.push_back(vtkInternal::CompletedSlices());
+    vtkInternal::CompletedSlices& completedSlices = completedSlicesList.back();
+    completedSlices.NodeID = *nodeIdIt;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      completedSlices.Dimensions[axis] = result.Dimensions[axis];
+      completedSlices.Origin[axis] = result.Origin[axis];
+      completedSlices.Spacing[axis] = result.Spacing[axis];
+    }
+    completedSlices.FirstSlice = result.NumberOfCopiedSlices;
+    int numberOfVoxelsPerSlice = result.Dimensions[0] * result.Dimensions[1];
+    completedSlices.Voxels.assign(result.Voxels.begin() + result.NumberOfCopiedSlices * numberOfVoxelsPerSlice,
+      result.Voxels.begin() + result.NumberOfCompletedSlices * numberOfVoxelsPerSlice);
+    result.NumberOfCopiedSlices = result.NumberOfCompletedSlices;
+    if (result.NumberOfCopiedSlices == result.Dimensions[2] && this->Internal->PendingRequests.find(*nodeIdIt) == this->Internal->PendingRequests.end())
+    {
+      // complete and no new request is waiting
+      this->Internal->Results.erase(resultIt);
+      this->ErrorMapsInProgress.erase(nodeIdIt++);
+    }
+    else
+    {
+      ++nodeIdIt;
+    }
+  }
+  this->Internal->Mutex->Unlock();
+
+  for (std::vector< vtkInternal::CompletedSlices >::iterator completedSlicesIt = completedSlicesList.begin(); completedSlicesIt != completedSlicesList.end(); ++completedSlicesIt)
+  {
+    vtkMRMLFiducialRegistrationWizardNode* node = vtkMRMLFiducialRegistrationWizardNode::SafeDownCast(scene->GetNodeByID(completedSlicesIt->NodeID));
+    vtkMRMLScalarVolumeNode* errorMapVolumeNode = (node != NULL ? node->GetErrorMapVolumeNode() : NULL);
+    if (errorMapVolumeNode == NULL)
+    {
+      // removed since the request was submitted
+      continue;
+    }
+    vtkImageData* errorMap = errorMapVolumeNode->GetImageData();
+    int* currentDimensions = (errorMap != NULL ? errorMap->GetDimensions() : NULL);
+    bool errorMapMatchesResult = (errorMap != NULL && errorMap->GetScalarType() == VTK_FLOAT && errorMap->GetNumberOfScalarComponents() == 1
+      && currentDimensions[0] == completedSlicesIt->Dimensions[0] && currentDimensions[1] == completedSlicesIt->Dimensions[1]
+      && currentDimensions[2] == completedSlicesIt->Dimensions[2]);
+    if (completedSlicesIt->FirstSlice == 0)
+    {
+      // New map: set up the geometry. Slices that are not computed yet are left at 0.
+      if (!errorMapMatchesResult)
+      {
+        vtkNew< vtkImageData > newErrorMap;
+        newErrorMap->SetDimensions(completedSlicesIt->Dimensions);
+        newErrorMap->AllocateScalars(VTK_FLOAT, 1);
+        errorMapVolumeNode->SetAndObserveImageData(newErrorMap.GetPointer());
+        errorMap = newErrorMap.GetPointer();
+      }
+      float* voxels = static_cast< float* >(errorMap->GetScalarPointer());
+      std::fill(voxels, voxels + completedSlicesIt->Dimensions[0] * completedSlicesIt->Dimensions[1] * completedSlicesIt->Dimensions[2], 0.0f);
+      vtkNew< vtkMatrix4x4 > ijkToRasDirections; // identity
+      int wasModified = errorMapVolumeNode->StartModify();
+      errorMapVolumeNode->SetIJKToRASDirectionMatrix(ijkToRasDirections.GetPointer());
+      errorMapVolumeNode->SetOrigin(completedSlicesIt->Origin);
+      errorMapVolumeNode->SetSpacing(completedSlicesIt->Spacing);
+      errorMapVolumeNode->EndModify(wasModified);
+    }
+    else if (!errorMapMatchesResult)
+    {
+      // The image has been replaced or reallocated since the first slices were copied, the remaining
+      // slices would not fit in it. The map is set up again when the next computed map arrives.
+      continue;
     }
+    float* voxels = static_cast< float* >(errorMap->GetScalarPointer());
+    int numberOfVoxelsPerSlice = completedSlicesIt->Dimensions[0] * completedSlicesIt->Dimensions[1];
+    std::copy(completedSlicesIt->Voxels.begin(), completedSlicesIt->Voxels.end(), voxels + completedSlicesIt->FirstSlice * numberOfVoxelsPerSlice);
+    errorMap->Modified();
   }
 }
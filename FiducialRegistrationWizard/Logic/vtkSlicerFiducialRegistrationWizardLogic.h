@@ -22,7 +22,10 @@
 #define __vtkSlicerFiducialRegistrationWizardLogic_h
 
 
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 // Slicer includes
 #include "vtkSlicerModuleLogic.h"
@@ -36,16 +39,22 @@
 #include <vtkLandmarkTransform.h>
 #include <vtkPoints.h>
 #include "vtkSmartPointer.h"
+#include "vtkWeakPointer.h"
 #include "vtkMRMLFiducialRegistrationWizardNode.h"
 
+class vtkGridTransform;
 class vtkMRMLMarkupsFiducialNode;
 class vtkMRMLLinearTransformNode;
+class vtkPerformanceCounters;
+class vtkPointMatcher;
+class vtkThinPlateSplineTransform;
 
 
 // STD includes
 #include <cstdlib>
 
 // helper classes
+#include "vtkIncrementalLandmarkRegistration.h"
 #include "vtkPointDistanceMatrix.h"
 
 #include "vtkSlicerFiducialRegistrationWizardModuleLogicExport.h"
@@ -59,14 +68,60 @@ public:
   static vtkSlicerFiducialRegistrationWizardLogic *New();
   vtkTypeMacro(vtkSlicerFiducialRegistrationWizardLogic,vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
-  
+
+  enum Events
+  {
+    /// Invoked when a buffered fiducial acquisition is completed. Call data is the fiducial node.
+    FiducialAcquiredEvent = vtkCommand::UserEvent + 556
+  };
+
+  enum FiducialAcquisitionModes
+  {
+    /// The fiducial is added at the current probe position
+    FIDUCIAL_ACQUISITION_SINGLE_SAMPLE,
+    /// The fiducial is added at the robust mean of the next probe positions, once they are stable
+    FIDUCIAL_ACQUISITION_BUFFERED
+  };
+
+  /// Add a fiducial at the probe tip position. In buffered mode the fiducial is added later,
+  /// when the probe is held still (a pending acquisition into the same fiducial node is replaced).
   void AddFiducial( vtkMRMLLinearTransformNode* probeTransformNode );
   void AddFiducial( vtkMRMLLinearTransformNode* probeTransformNode, vtkMRMLMarkupsFiducialNode* fiducialNode );
 
+  /// Acquisition mode used by AddFiducial (default: single sample)
+  vtkGetMacro(FiducialAcquisitionMode, int);
+  vtkSetMacro(FiducialAcquisitionMode, int);
+  void SetFiducialAcquisitionModeToSingleSample() { this->SetFiducialAcquisitionMode(FIDUCIAL_ACQUISITION_SINGLE_SAMPLE); };
+  void SetFiducialAcquisitionModeToBuffered() { this->SetFiducialAcquisitionMode(FIDUCIAL_ACQUISITION_BUFFERED); };
+
+  /// Number of most recent probe positions that a buffered fiducial is computed from (default: 10)
+  vtkGetMacro(AcquisitionNumberOfSamples, int);
+  vtkSetClampMacro(AcquisitionNumberOfSamples, int, 2, 200);
+  /// The probe positions are stable if most of them are within this distance from their median (default: 0.5mm).
+  /// Positions farther than this are excluded from the mean.
+  vtkGetMacro(AcquisitionStabilityToleranceMm, double);
+  vtkSetMacro(AcquisitionStabilityToleranceMm, double);
+
+  /// Returns true if a buffered acquisition into the fiducial node has not completed yet
+  bool IsFiducialAcquisitionInProgress( vtkMRMLMarkupsFiducialNode* fiducialNode );
+  void CancelFiducialAcquisition( vtkMRMLMarkupsFiducialNode* fiducialNode );
+  void CancelAllFiducialAcquisitions();
+
   void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );
 
   bool UpdateCalibration( vtkMRMLNode* node );
 
+  /// Automatic updates that are postponed in live preview mode are performed when
+  /// ProcessPendingUpdates() is called (the module calls it periodically using a timer).
+  /// Error map slices that are computed in the background are also copied into the error map volumes.
+  /// The logic is modified when HasPendingUpdates() changes.
+  void ProcessPendingUpdates();
+  bool HasPendingUpdates();
+
+  /// Number of received input events, automatic calibration updates computed and postponed
+  /// (only a preview is shown), and the time spent in the automatic updates
+  vtkPerformanceCounters* GetPerformanceCounters();
+
   vtkGetMacro(MarkupsLogic, vtkSlicerMarkupsLogic*);
   vtkSetMacro(MarkupsLogic, vtkSlicerMarkupsLogic*);
   
@@ -82,6 +137,9 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  /// Module nodes added during batch processing (e.g., scene import) are set up here, in a single pass
+  virtual void OnMRMLSceneEndBatchProcess();
+  void InitializeModuleNode(vtkMRMLFiducialRegistrationWizardNode* frwNode);
 
 private:
   vtkSlicerFiducialRegistrationWizardLogic(const vtkSlicerFiducialRegistrationWizardLogic&); // Not implemented
@@ -101,14 +159,84 @@ private:
   // In a 'good' mapping, there will be little difference seen in the reference and test distances
   static double ComputeSuitabilityOfDistancesMetric( vtkPointDistanceMatrix* referenceDistanceMatrix, vtkPointDistanceMatrix* testDistanceMatrix );
 
+  // Update in automatic update mode. Expensive updates are rate limited in live preview mode.
+  void RequestCalibrationUpdate( vtkMRMLFiducialRegistrationWizardNode* node );
+  // Quick rigid or similarity registration shown while a full update is postponed. The fiducials are paired
+  // in input order, or in the order found by the last successful automatic point matching. No preview is shown
+  // in warping mode, as the output transform is not linear.
+  bool UpdateCalibrationPreview( vtkMRMLFiducialRegistrationWizardNode* node );
+  static bool IsFullUpdateExpensive( vtkMRMLFiducialRegistrationWizardNode* node );
+  vtkIncrementalLandmarkRegistration* GetLandmarkRegistration( vtkMRMLFiducialRegistrationWizardNode* node );
+  vtkPointMatcher* GetPointMatcher( vtkMRMLFiducialRegistrationWizardNode* node );
+  // Warping registration stored as a displacement grid sampled from the thin-plate spline
+  bool UpdateWarpingGridTransform( vtkMRMLFiducialRegistrationWizardNode* node, vtkPoints* sourceLandmarks, vtkPoints* targetLandmarks );
+
+  // Start computing the target registration error map in the background for the given fiducial configuration
+  void RequestErrorMapUpdate( vtkMRMLFiducialRegistrationWizardNode* node, vtkPoints* points, double rmsError );
+  void ProcessErrorMapResults();
+
   double CalculateRegistrationError( vtkPoints* fromPoints, vtkPoints* toPoints, vtkAbstractTransform* transform );
   bool CheckCollinear( vtkPoints* points );
 
   std::map< std::string, std::string > OutputMessages;
 
+  // Rigid and similarity registrations keep their sums between updates, so that
+  // adding, removing or moving a single fiducial is cheap (key: wizard node ID)
+  std::map< std::string, vtkSmartPointer< vtkIncrementalLandmarkRegistration > > LandmarkRegistrations;
+
+  // Automatic point matchers keep their last matching, so that it is only extended
+  // when a fiducial is added to one of the lists (key: wizard node ID)
+  std::map< std::string, vtkSmartPointer< vtkPointMatcher > > PointMatchers;
+
+  // The spline and the grid sampled from it, kept so that the grid is only
+  // regenerated when the landmarks change (key: wizard node ID)
+  struct WarpingGridType
+  {
+    vtkSmartPointer< vtkThinPlateSplineTransform > Spline;
+    vtkSmartPointer< vtkGridTransform > Grid;
+    double SpacingMm;
+  };
+  std::map< std::string, WarpingGridType > WarpingGrids;
+
+  // Live preview rate limiting
+  std::map< vtkMRMLFiducialRegistrationWizardNode*, double > LastFullUpdateTimeSec;
+  std::set< vtkMRMLFiducialRegistrationWizardNode* > PendingUpdateNodes;
+
+  vtkSmartPointer< vtkPerformanceCounters > PerformanceCounters;
+
+  // Error maps that are not yet completely copied into their volume nodes (key: wizard node ID)
+  std::set< std::string > ErrorMapsInProgress;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
   void SetOutputMessage( std::string nodeID, std::string newOutputMessage ); // The modified event will tell the widget to   (only needs to update when transform is calculated)
 
   vtkSlicerMarkupsLogic* MarkupsLogic;
+
+  // Buffered fiducial acquisition
+  struct FiducialAcquisitionType
+  {
+    vtkWeakPointer< vtkMRMLLinearTransformNode > ProbeTransformNode;
+    vtkWeakPointer< vtkMRMLMarkupsFiducialNode > FiducialNode;
+    std::vector< double > Positions; // ring buffer of probe positions (3 values per sample)
+    int NumberOfSamples;
+    int NextSampleIndex;
+  };
+  // Add the current position of the probe to the acquisitions that use it, and commit the stable ones
+  void ProcessProbeTransformModified( vtkMRMLTransformNode* probeTransformNode );
+  // Returns false if the positions are not stable yet
+  bool ComputeStableFiducialPosition( const FiducialAcquisitionType& acquisition, double position[3] );
+  // Stop observing the probe if no other acquisition uses it
+  void RemoveFiducialAcquisition( vtkMRMLMarkupsFiducialNode* fiducialNode );
+
+  int FiducialAcquisitionMode;
+  int AcquisitionNumberOfSamples;
+  double AcquisitionStabilityToleranceMm;
+  // Key: fiducial node (a fiducial node has at most one pending acquisition)
+  std::map< vtkMRMLMarkupsFiducialNode*, FiducialAcquisitionType > FiducialAcquisitions;
+  // Reused for reading the probe position
+  vtkSmartPointer< vtkMatrix4x4 > ProbeToWorldMatrix;
 };
 
 #endif
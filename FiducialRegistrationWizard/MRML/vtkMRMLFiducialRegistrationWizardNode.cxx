@@ -23,6 +23,7 @@
 
 // slicer includes
 #include "vtkMRMLMarkupsFiducialNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLTransformNode.h"
 
 // vtk includes
@@ -37,6 +38,7 @@ static const char* PROBE_TRANSFORM_TO_REFERENCE_ROLE = "ProbeTransformTo";
 static const char* FROM_FIDUCIAL_LIST_REFERENCE_ROLE = "FromFiducialList";
 static const char* TO_FIDUCIAL_LIST_REFERENCE_ROLE = "ToFiducialList";
 static const char* OUTPUT_TRANSFORM_REFERENCE_ROLE = "OutputTransform";
+static const char* ERROR_MAP_VOLUME_REFERENCE_ROLE = "ErrorMapVolume";
 
 vtkMRMLNodeNewMacro(vtkMRMLFiducialRegistrationWizardNode);
 
@@ -56,10 +58,15 @@ vtkMRMLFiducialRegistrationWizardNode::vtkMRMLFiducialRegistrationWizardNode()
   this->AddNodeReferenceRole( FROM_FIDUCIAL_LIST_REFERENCE_ROLE, NULL, fiducialListEvents.GetPointer() );
   this->AddNodeReferenceRole( TO_FIDUCIAL_LIST_REFERENCE_ROLE, NULL, fiducialListEvents.GetPointer() );
   this->AddNodeReferenceRole( OUTPUT_TRANSFORM_REFERENCE_ROLE );
+  this->AddNodeReferenceRole( ERROR_MAP_VOLUME_REFERENCE_ROLE );
   this->RegistrationMode = REGISTRATION_MODE_RIGID;
   this->UpdateMode = UPDATE_MODE_AUTOMATIC;
   this->PointMatching = POINT_MATCHING_MANUAL;
   this->WarpingTransformFromParent = true;
+  this->WarpingGridSpacingMm = 0.0;
+  this->LivePreview = false;
+  this->FullUpdatesPerSecond = 2;
+  this->ErrorMapSpacingMm = 5.0;
 }
 
 //------------------------------------------------------------------------------
@@ -77,6 +84,10 @@ void vtkMRMLFiducialRegistrationWizardNode::WriteXML( ostream& of, int nIndent )
   of << indent << " RegistrationMode=\"" << RegistrationModeAsString( this->RegistrationMode ) << "\"";
   of << indent << " UpdateMode=\"" << UpdateModeAsString( this->UpdateMode ) << "\"";
   of << indent << " WarpingTransformFromParent=\"" << (this->WarpingTransformFromParent ? "true" : "false") << "\"";
+  of << indent << " WarpingGridSpacingMm=\"" << this->WarpingGridSpacingMm << "\"";
+  of << indent << " LivePreview=\"" << (this->LivePreview ? "true" : "false") << "\"";
+  of << indent << " FullUpdatesPerSecond=\"" << this->FullUpdatesPerSecond << "\"";
+  of << indent << " ErrorMapSpacingMm=\"" << this->ErrorMapSpacingMm << "\"";
 }
 
 //------------------------------------------------------------------------------
@@ -108,6 +119,28 @@ void vtkMRMLFiducialRegistrationWizardNode::ReadXMLAttributes( const char** atts
     {
       this->WarpingTransformFromParent = (strcmp(attValue,"true") ? false : true);
     }
+    else if (!strcmp(attName, "WarpingGridSpacingMm"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->WarpingGridSpacingMm;
+    }
+    else if (!strcmp(attName, "LivePreview"))
+    {
+      this->LivePreview = (strcmp(attValue,"true") ? false : true);
+    }
+    else if (!strcmp(attName, "FullUpdatesPerSecond"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->FullUpdatesPerSecond;
+    }
+    else if (!strcmp(attName, "ErrorMapSpacingMm"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->ErrorMapSpacingMm;
+    }
   }
 
   this->Modified();
@@ -123,6 +156,10 @@ void vtkMRMLFiducialRegistrationWizardNode::Copy( vtkMRMLNode *anode )
   this->UpdateMode = node->UpdateMode;
   this->PointMatching = node->PointMatching;
   this->WarpingTransformFromParent = node->WarpingTransformFromParent;
+  this->WarpingGridSpacingMm = node->WarpingGridSpacingMm;
+  this->LivePreview = node->LivePreview;
+  this->FullUpdatesPerSecond = node->FullUpdatesPerSecond;
+  this->ErrorMapSpacingMm = node->ErrorMapSpacingMm;
   this->Modified();
 }
 
@@ -134,6 +171,10 @@ void vtkMRMLFiducialRegistrationWizardNode::PrintSelf( ostream& os, vtkIndent in
   os << indent << "RegistrationMode: " << RegistrationModeAsString( this->RegistrationMode ) << "\n";
   os << indent << "UpdateMode: " << UpdateModeAsString( this->UpdateMode ) << "\n";
   os << indent << "WarpingTransformFromParent: " << (this->WarpingTransformFromParent ? "true" : "false") << "\n";
+  os << indent << "WarpingGridSpacingMm: " << this->WarpingGridSpacingMm << "\n";
+  os << indent << "LivePreview: " << (this->LivePreview ? "true" : "false") << "\n";
+  os << indent << "FullUpdatesPerSecond: " << this->FullUpdatesPerSecond << "\n";
+  os << indent << "ErrorMapSpacingMm: " << this->ErrorMapSpacingMm << "\n";
 }
 
 //------------------------------------------------------------------------------
@@ -235,6 +276,27 @@ vtkMRMLTransformNode* vtkMRMLFiducialRegistrationWizardNode::GetOutputTransformN
   return node;
 }
 
+//------------------------------------------------------------------------------
+void vtkMRMLFiducialRegistrationWizardNode::SetErrorMapVolumeNodeId( const char* nodeId )
+{
+  const char* currentNodeId=this->GetNodeReferenceID(ERROR_MAP_VOLUME_REFERENCE_ROLE);
+  if (nodeId!=NULL && currentNodeId!=NULL && strcmp(nodeId,currentNodeId)==0)
+  {
+    // not changed
+    return;
+  }
+  this->SetNodeReferenceID( ERROR_MAP_VOLUME_REFERENCE_ROLE, nodeId);
+  // the error map is computed after the calibration
+  this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkMRMLFiducialRegistrationWizardNode::GetErrorMapVolumeNode()
+{
+  vtkMRMLScalarVolumeNode* node = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetNodeReference( ERROR_MAP_VOLUME_REFERENCE_ROLE ) );
+  return node;
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLFiducialRegistrationWizardNode::SetRegistrationMode( int newRegistrationMode )
 {
@@ -440,3 +502,16 @@ void vtkMRMLFiducialRegistrationWizardNode::SetWarpingTransformFromParent(bool w
   this->Modified();
   this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
 }
+
+//------------------------------------------------------------------------------
+void vtkMRMLFiducialRegistrationWizardNode::SetWarpingGridSpacingMm(double warpingGridSpacingMm)
+{
+  if ( this->GetWarpingGridSpacingMm() == warpingGridSpacingMm )
+  {
+    // no change
+    return;
+  }
+  this->WarpingGridSpacingMm = warpingGridSpacingMm;
+  this->Modified();
+  this->InvokeCustomModifiedEvent(InputDataModifiedEvent);
+}
@@ -37,6 +37,7 @@
 #include "vtkSlicerFiducialRegistrationWizardModuleMRMLExport.h"
 
 class vtkMRMLMarkupsFiducialNode;
+class vtkMRMLScalarVolumeNode;
 class vtkMRMLTransformNode;
 
 class
@@ -109,6 +110,11 @@ public:
   vtkMRMLTransformNode* GetOutputTransformNode();
   void SetOutputTransformNodeId( const char* nodeId );
 
+  // Where to store the estimated target registration error map of rigid and similarity registrations.
+  // The map is in the coordinate system of the 'to' points.
+  vtkMRMLScalarVolumeNode* GetErrorMapVolumeNode();
+  void SetErrorMapVolumeNodeId( const char* nodeId );
+
   // Transform to record 'From' Points
   vtkMRMLTransformNode* GetProbeTransformFromNode();
   void SetProbeTransformFromNodeId( const char* nodeId );
@@ -153,6 +159,32 @@ public:
   vtkGetMacro(WarpingTransformFromParent, bool);
   vtkBooleanMacro(WarpingTransformFromParent, bool);
 
+  /// Get/Set spacing of the displacement grid used for storing the warping transform.
+  /// If set to 0 (this is the default) then the thin-plate spline transform is stored directly.
+  /// Otherwise the spline is sampled on a grid that covers the fiducials, which makes
+  /// transforming images and models much faster, at the cost of some accuracy between grid points.
+  /// The grid is only regenerated when the fiducials change.
+  void SetWarpingGridSpacingMm(double warpingGridSpacingMm);
+  vtkGetMacro(WarpingGridSpacingMm, double);
+
+  /// Get/Set live preview for automatic update mode.
+  /// If enabled, expensive updates (warping or automatic point matching) run at most
+  /// FullUpdatesPerSecond times per second, and once more after the fiducials stop changing.
+  /// In between, a quick linear registration of the fiducials is shown (not available in warping mode).
+  /// \sa LivePreview, FullUpdatesPerSecond
+  vtkSetMacro(LivePreview, bool);
+  vtkGetMacro(LivePreview, bool);
+  vtkBooleanMacro(LivePreview, bool);
+
+  /// Get/Set maximum rate of expensive updates in live preview. 0 means no limit.
+  vtkSetMacro(FullUpdatesPerSecond, int);
+  vtkGetMacro(FullUpdatesPerSecond, int);
+
+  /// Get/Set voxel size of the target registration error map. The map is low-resolution,
+  /// as the estimated error changes smoothly.
+  vtkSetMacro(ErrorMapSpacingMm, double);
+  vtkGetMacro(ErrorMapSpacingMm, double);
+
   void ProcessMRMLEvents( vtkObject *caller, unsigned long event, void *callData );
 
 private:
@@ -182,6 +214,15 @@ private:
   /// transformation speed is optimized for models and markups.
   bool WarpingTransformFromParent;
 
+  /// Spacing of the sampled warping transform, 0 if the spline is not sampled
+  double WarpingGridSpacingMm;
+
+  /// If true then expensive automatic updates are rate limited while fiducials are dragged
+  bool LivePreview;
+  int FullUpdatesPerSecond;
+
+  double ErrorMapSpacingMm;
+
   // The Calibration status message reports the RMS error,
   // as well as any warnings about how the registration
   // was set up.
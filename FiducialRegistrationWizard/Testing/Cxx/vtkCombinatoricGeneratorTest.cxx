@@ -0,0 +1,192 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks that the streaming traversal of vtkCombinatoricGenerator (InitTraversal, GetNextOutputSet)
+// generates the same sets as Update() and GetOutputSets(), for all subset sizes of small inputs:
+// - cartesian products and combinations in the same order
+// - permutations in lexicographic order of the element positions, each exactly once
+
+// FiducialRegistrationWizard includes
+#include "vtkCombinatoricGenerator.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+std::vector< std::vector<int> > GetTraversedSets(vtkCombinatoricGenerator* generator)
+{
+  std::vector< std::vector<int> > traversedSets;
+  std::vector<int> outputSet(generator->GetTraversalSetSize() + 1);
+  // the element after the set must not be written
+  const int guardValue = -12345;
+  outputSet.back() = guardValue;
+  generator->InitTraversal();
+  while (generator->GetNextOutputSet(&outputSet[0]))
+  {
+    if (outputSet.back() != guardValue)
+    {
+      std::cerr << "GetNextOutputSet wrote more than GetTraversalSetSize() elements" << std::endl;
+      return std::vector< std::vector<int> >();
+    }
+    traversedSets.push_back(std::vector<int>(outputSet.begin(), outputSet.end() - 1));
+  }
+  // no more sets after the traversal is done
+  if (generator->GetNextOutputSet(&outputSet[0]))
+  {
+    std::cerr << "GetNextOutputSet returned a set after the end of the traversal" << std::endl;
+    return std::vector< std::vector<int> >();
+  }
+  return traversedSets;
+}
+
+//----------------------------------------------------------------------------
+void PrintSet(std::ostream& os, const std::vector<int>& outputSet)
+{
+  for (std::vector<int>::const_iterator elementIt = outputSet.begin(); elementIt != outputSet.end(); ++elementIt)
+  {
+    os << " " << *elementIt;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool CheckTraversal(vtkCombinatoricGenerator* generator, bool sameOrder, const char* description)
+{
+  generator->Update();
+  std::vector< std::vector<int> > expectedSets = generator->GetOutputSets();
+  std::vector< std::vector<int> > traversedSets = GetTraversedSets(generator);
+
+  if (traversedSets.size() != expectedSets.size() || traversedSets.size() != generator->ComputeNumberOfOutputSets())
+  {
+    std::cerr << description << ": " << traversedSets.size() << " sets traversed, " << expectedSets.size()
+      << " sets computed by Update(), " << generator->ComputeNumberOfOutputSets() << " expected" << std::endl;
+    return false;
+  }
+  if (!sameOrder)
+  {
+    std::sort(expectedSets.begin(), expectedSets.end());
+    std::vector< std::vector<int> > sortedTraversedSets = traversedSets;
+    std::sort(sortedTraversedSets.begin(), sortedTraversedSets.end());
+    if (std::adjacent_find(sortedTraversedSets.begin(), sortedTraversedSets.end()) != sortedTraversedSets.end())
+    {
+      std::cerr << description << ": a set is traversed more than once" << std::endl;
+      return false;
+    }
+    traversedSets.swap(sortedTraversedSets);
+  }
+  for (size_t setIndex = 0; setIndex < expectedSets.size(); setIndex++)
+  {
+    if (traversedSets[setIndex] != expectedSets[setIndex])
+    {
+      std::cerr << description << ": set " << setIndex << " is";
+      PrintSet(std::cerr, traversedSets[setIndex]);
+      std::cerr << ", expected";
+      PrintSet(std::cerr, expectedSets[setIndex]);
+      std::cerr << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Input elements are distinct and increasing, so the lexicographic order of the element
+// positions is the same as the lexicographic order of the elements
+bool CheckPermutationOrder(vtkCombinatoricGenerator* generator, const char* description)
+{
+  std::vector< std::vector<int> > traversedSets = GetTraversedSets(generator);
+  for (size_t setIndex = 1; setIndex < traversedSets.size(); setIndex++)
+  {
+    if (!(traversedSets[setIndex - 1] < traversedSets[setIndex]))
+    {
+      std::cerr << description << ": set " << setIndex << " is not in lexicographic order" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkCombinatoricGeneratorTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  const int maximumInputSetSize = 6;
+  bool success = true;
+
+  for (int inputSetSize = 1; inputSetSize <= maximumInputSetSize; inputSetSize++)
+  {
+    std::vector<int> inputSet;
+    for (int elementIndex = 0; elementIndex < inputSetSize; elementIndex++)
+    {
+      inputSet.push_back(10 * elementIndex + 1);
+    }
+    for (int subsetSize = 1; subsetSize <= inputSetSize; subsetSize++)
+    {
+      vtkNew<vtkCombinatoricGenerator> combinationGenerator;
+      combinationGenerator->SetCombinatoricToCombination();
+      combinationGenerator->SetSubsetSize(subsetSize);
+      combinationGenerator->AddInputSet(inputSet);
+      success &= CheckTraversal(combinationGenerator.GetPointer(), true, "Combination");
+
+      vtkNew<vtkCombinatoricGenerator> permutationGenerator;
+      permutationGenerator->SetCombinatoricToPermutation();
+      permutationGenerator->SetSubsetSize(subsetSize);
+      permutationGenerator->AddInputSet(inputSet);
+      success &= CheckTraversal(permutationGenerator.GetPointer(), false, "Permutation");
+      success &= CheckPermutationOrder(permutationGenerator.GetPointer(), "Permutation");
+    }
+  }
+
+  // cartesian products of sets of different sizes, including one with repeated elements
+  vtkNew<vtkCombinatoricGenerator> cartesianProductGenerator;
+  cartesianProductGenerator->SetCombinatoricToCartesianProduct();
+  for (int setIndex = 0; setIndex < 4; setIndex++)
+  {
+    std::vector<int> inputSet;
+    for (int elementIndex = 0; elementIndex <= setIndex; elementIndex++)
+    {
+      inputSet.push_back(setIndex == 2 ? 7 : 10 * setIndex + elementIndex);
+    }
+    cartesianProductGenerator->AddInputSet(inputSet);
+    success &= CheckTraversal(cartesianProductGenerator.GetPointer(), true, "Cartesian product");
+  }
+
+  // the traversal has to be restarted after the inputs are modified
+  vtkNew<vtkCombinatoricGenerator> modifiedGenerator;
+  modifiedGenerator->SetCombinatoricToCombination();
+  modifiedGenerator->SetSubsetSize(2);
+  modifiedGenerator->AddInputSet(std::vector<int>(3, 0));
+  GetTraversedSets(modifiedGenerator.GetPointer());
+  modifiedGenerator->AddInputElement(0, 1);
+  success &= CheckTraversal(modifiedGenerator.GetPointer(), true, "Combination after input modification");
+
+  if (!success)
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "vtkCombinatoricGenerator traversal matches Update() output" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,353 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Measures how the building blocks of automatic point matching scale with the number of points:
+// - vtkCombinatoricGenerator: combinations of half of the points, computed all at once by Update()
+//   (time and memory of the OutputSets vector of vectors) and streamed by GetNextOutputSet()
+// - vtkPointDistanceMatrix: computation of the point to point distances within a point list
+// - vtkPointMatcher: matching of a point list to a moved, shuffled and noisy copy of itself, in which
+//   one point is replaced by an outlier (single- and multithreaded, success rate over random trials)
+//
+// Results are written as one JSON object per line (to the standard output or to the file
+// specified by the -o option), so that they can be collected and compared between builds.
+//
+// Usage: vtkFiducialRegistrationWizardMatchingBenchmark [--quick] [-o outputFile] [-n numberOfTrials]
+//   --quick: run every 4th point count with fewer trials (used when running as an automatic test)
+
+// FiducialRegistrationWizard includes
+#include "vtkCombinatoricGenerator.h"
+#include "vtkPointDistanceMatrix.h"
+#include "vtkPointMatcher.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double POINT_RANGE_MM = 100.0; // points are in a cube of this size
+const double NOISE_STANDARD_DEVIATION_MM = 0.5;
+
+//----------------------------------------------------------------------------
+// Memory used by the elements of a vector of vectors (the container overheads are included)
+size_t GetVectorOfVectorsSizeBytes(const std::vector< std::vector<int> >& vectorOfVectors)
+{
+  size_t sizeBytes = vectorOfVectors.capacity() * sizeof(std::vector<int>);
+  for (std::vector< std::vector<int> >::const_iterator setIt = vectorOfVectors.begin(); setIt != vectorOfVectors.end(); ++setIt)
+  {
+    sizeBytes += setIt->capacity() * sizeof(int);
+  }
+  return sizeBytes;
+}
+
+//----------------------------------------------------------------------------
+void RunCombinatoricGeneratorBenchmark(std::ostream& os, int numberOfPoints)
+{
+  vtkNew<vtkCombinatoricGenerator> generator;
+  generator->SetCombinatoricToCombination();
+  generator->SetSubsetSize(numberOfPoints / 2);
+  generator->SetNumberOfInputSets(1);
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    generator->AddInputElement(0, pointIndex);
+  }
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  generator->Update();
+  std::vector< std::vector<int> > outputSets = generator->GetOutputSets();
+  timer->StopTimer();
+  double updateTimeMs = timer->GetElapsedTime() * 1000.0;
+  size_t outputSetsSizeBytes = GetVectorOfVectorsSizeBytes(outputSets);
+
+  // Checksum prevents the compiler from optimizing the traversal away
+  std::vector<int> outputSet(std::max(1u, generator->GetTraversalSetSize()));
+  long long checksum = 0;
+  unsigned int numberOfTraversedSets = 0;
+  timer->StartTimer();
+  generator->InitTraversal();
+  while (generator->GetNextOutputSet(&outputSet[0]))
+  {
+    checksum += outputSet[0];
+    numberOfTraversedSets++;
+  }
+  timer->StopTimer();
+  double traversalTimeMs = timer->GetElapsedTime() * 1000.0;
+
+  os << "{\"benchmark\": \"CombinatoricGenerator\""
+    << ", \"points\": " << numberOfPoints
+    << ", \"subsetSize\": " << numberOfPoints / 2
+    << ", \"sets\": " << outputSets.size()
+    << ", \"updateTimeMs\": " << updateTimeMs
+    << ", \"outputSetsBytes\": " << outputSetsSizeBytes
+    << ", \"traversedSets\": " << numberOfTraversedSets
+    << ", \"traversalTimeMs\": " << traversalTimeMs
+    << ", \"traversalBytes\": " << outputSet.size() * sizeof(int)
+    << ", \"checksum\": " << checksum
+    << "}" << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void AddRandomPoints(vtkPoints* points, int numberOfPoints)
+{
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    points->InsertNextPoint(vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM));
+  }
+}
+
+//----------------------------------------------------------------------------
+void RunPointDistanceMatrixBenchmark(std::ostream& os, int numberOfPoints, int numberOfRepetitions)
+{
+  vtkNew<vtkPoints> points;
+  AddRandomPoints(points.GetPointer(), numberOfPoints);
+  vtkNew<vtkPointDistanceMatrix> distanceMatrix;
+  distanceMatrix->SetPointList1(points.GetPointer());
+  distanceMatrix->SetPointList2(points.GetPointer());
+
+  double checksum = 0.0;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  for (int repetitionIndex = 0; repetitionIndex < numberOfRepetitions; repetitionIndex++)
+  {
+    // the distances are recomputed when the points are modified
+    points->Modified();
+    checksum += distanceMatrix->GetDistances()[numberOfPoints - 1];
+  }
+  timer->StopTimer();
+
+  os << "{\"benchmark\": \"PointDistanceMatrix\""
+    << ", \"points\": " << numberOfPoints
+    << ", \"repetitions\": " << numberOfRepetitions
+    << ", \"timeMeanUs\": " << timer->GetElapsedTime() * 1.0e6 / numberOfRepetitions
+    << ", \"distancesBytes\": " << numberOfPoints * numberOfPoints * sizeof(double)
+    << ", \"checksum\": " << checksum
+    << "}" << std::endl;
+}
+
+//----------------------------------------------------------------------------
+// Returns true if the matching is within tolerance, not ambiguous, and all output pairs are
+// true correspondences: list 2 is a moved and shuffled copy of list 1, the true partner of
+// list 1 point i is list 2 point pointList2IndexOfPointList1Index[i] (-1 if it has no partner)
+bool IsMatchingCorrect(vtkPointMatcher* matcher, vtkPoints* pointList1, vtkPoints* pointList2, const std::vector<int>& pointList2IndexOfPointList1Index)
+{
+  if (!matcher->IsMatchingWithinTolerance() || matcher->IsMatchingAmbiguous())
+  {
+    return false;
+  }
+  vtkPoints* outputPointList1 = matcher->GetOutputPointList1();
+  vtkPoints* outputPointList2 = matcher->GetOutputPointList2();
+  if (outputPointList1->GetNumberOfPoints() == 0)
+  {
+    return false;
+  }
+  for (int outputIndex = 0; outputIndex < outputPointList1->GetNumberOfPoints(); outputIndex++)
+  {
+    double outputPoint1[3];
+    double outputPoint2[3];
+    outputPointList1->GetPoint(outputIndex, outputPoint1);
+    outputPointList2->GetPoint(outputIndex, outputPoint2);
+    bool correct = false;
+    for (int pointList1Index = 0; pointList1Index < pointList1->GetNumberOfPoints(); pointList1Index++)
+    {
+      double point1[3];
+      pointList1->GetPoint(pointList1Index, point1);
+      if (vtkMath::Distance2BetweenPoints(point1, outputPoint1) > 0.0)
+      {
+        continue;
+      }
+      int pointList2Index = pointList2IndexOfPointList1Index[pointList1Index];
+      if (pointList2Index >= 0)
+      {
+        double point2[3];
+        pointList2->GetPoint(pointList2Index, point2);
+        correct = (vtkMath::Distance2BetweenPoints(point2, outputPoint2) == 0.0);
+      }
+      break;
+    }
+    if (!correct)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void RunPointMatcherBenchmark(std::ostream& os, int numberOfPoints, int numberOfTrials, bool useMultithreading)
+{
+  vtkNew<vtkTimerLog> timer;
+  double totalTimeSec = 0.0;
+  double maximumTimeSec = 0.0;
+  int numberOfSuccessfulTrials = 0;
+  for (int trialIndex = 0; trialIndex < numberOfTrials; trialIndex++)
+  {
+    vtkNew<vtkPoints> pointList1;
+    AddRandomPoints(pointList1.GetPointer(), numberOfPoints);
+
+    // list 2: the points moved by a random rigid transform, with noise, in random order,
+    // and the last point of list 1 replaced by an outlier
+    vtkNew<vtkTransform> list1ToList2Transform;
+    list1ToList2Transform->RotateWXYZ(vtkMath::Random(0.0, 360.0), vtkMath::Random(-1.0, 1.0), vtkMath::Random(-1.0, 1.0), vtkMath::Random(-1.0, 1.0));
+    list1ToList2Transform->Translate(vtkMath::Random(-50.0, 50.0), vtkMath::Random(-50.0, 50.0), vtkMath::Random(-50.0, 50.0));
+    std::vector<int> pointList2Order(numberOfPoints);
+    for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+    {
+      pointList2Order[pointIndex] = pointIndex;
+    }
+    for (int pointIndex = numberOfPoints - 1; pointIndex > 0; pointIndex--)
+    {
+      std::swap(pointList2Order[pointIndex], pointList2Order[static_cast<int>(vtkMath::Random(0.0, pointIndex + 1.0)) % (pointIndex + 1)]);
+    }
+    std::vector<int> pointList2IndexOfPointList1Index(numberOfPoints, -1);
+    vtkNew<vtkPoints> pointList2;
+    pointList2->SetNumberOfPoints(numberOfPoints);
+    for (int pointList2Index = 0; pointList2Index < numberOfPoints; pointList2Index++)
+    {
+      int pointList1Index = pointList2Order[pointList2Index];
+      double point[3];
+      if (pointList1Index == numberOfPoints - 1)
+      {
+        point[0] = vtkMath::Random(0.0, POINT_RANGE_MM);
+        point[1] = vtkMath::Random(0.0, POINT_RANGE_MM);
+        point[2] = vtkMath::Random(0.0, POINT_RANGE_MM);
+      }
+      else
+      {
+        list1ToList2Transform->TransformPoint(pointList1->GetPoint(pointList1Index), point);
+        for (int axis = 0; axis < 3; axis++)
+        {
+          point[axis] += vtkMath::Gaussian(0.0, NOISE_STANDARD_DEVIATION_MM);
+        }
+        pointList2IndexOfPointList1Index[pointList1Index] = pointList2Index;
+      }
+      pointList2->SetPoint(pointList2Index, point);
+    }
+
+    // same parameters as in the fiducial registration wizard logic
+    vtkNew<vtkPointMatcher> matcher;
+    matcher->SetInputPointList1(pointList1.GetPointer());
+    matcher->SetInputPointList2(pointList2.GetPointer());
+    matcher->SetMaximumDifferenceInNumberOfPoints(2);
+    matcher->SetTolerableRootMeanSquareDistanceErrorMm(10.0);
+    matcher->SetAmbiguityThresholdDistanceMm(5.0);
+    matcher->SetUseMultithreading(useMultithreading);
+    timer->StartTimer();
+    matcher->Update();
+    timer->StopTimer();
+    totalTimeSec += timer->GetElapsedTime();
+    maximumTimeSec = std::max(maximumTimeSec, timer->GetElapsedTime());
+
+    if (IsMatchingCorrect(matcher.GetPointer(), pointList1.GetPointer(), pointList2.GetPointer(), pointList2IndexOfPointList1Index))
+    {
+      numberOfSuccessfulTrials++;
+    }
+  }
+
+  os << "{\"benchmark\": \"PointMatcher\""
+    << ", \"points\": " << numberOfPoints
+    << ", \"outliers\": 1"
+    << ", \"noiseMm\": " << NOISE_STANDARD_DEVIATION_MM
+    << ", \"multithreading\": " << (useMultithreading ? "true" : "false")
+    << ", \"trials\": " << numberOfTrials
+    << ", \"timeMeanMs\": " << totalTimeSec * 1000.0 / numberOfTrials
+    << ", \"timeMaxMs\": " << maximumTimeSec * 1000.0
+    << ", \"successRate\": " << static_cast<double>(numberOfSuccessfulTrials) / numberOfTrials
+    << "}" << std::endl;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkFiducialRegistrationWizardMatchingBenchmark(int argc, char* argv[])
+{
+  bool quick = false;
+  const char* outputFileName = NULL;
+  int numberOfTrials = 20;
+  for (int argIndex = 1; argIndex < argc; argIndex++)
+  {
+    if (strcmp(argv[argIndex], "--quick") == 0)
+    {
+      quick = true;
+    }
+    else if (strcmp(argv[argIndex], "-o") == 0 && argIndex + 1 < argc)
+    {
+      outputFileName = argv[++argIndex];
+    }
+    else if (strcmp(argv[argIndex], "-n") == 0 && argIndex + 1 < argc)
+    {
+      numberOfTrials = atoi(argv[++argIndex]);
+    }
+    else
+    {
+      std::cerr << "Unknown argument: " << argv[argIndex] << std::endl;
+      std::cerr << "Usage: " << argv[0] << " [--quick] [-o outputFile] [-n numberOfTrials]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (numberOfTrials < 1)
+  {
+    std::cerr << "Number of trials must be positive" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Same as the maximum number of points allowed for automatic point matching in the logic
+  const int maximumNumberOfPoints = 20;
+  int numberOfPointsStep = 1;
+  if (quick)
+  {
+    // sample the whole range of point counts that the logic allows, with fewer trials
+    numberOfTrials = std::min(numberOfTrials, 2);
+    numberOfPointsStep = 4;
+  }
+
+  std::ofstream outputFile;
+  if (outputFileName != NULL)
+  {
+    outputFile.open(outputFileName);
+    if (!outputFile.is_open())
+    {
+      std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream& os = (outputFileName != NULL ? static_cast<std::ostream&>(outputFile) : std::cout);
+
+  vtkMath::RandomSeed(42);
+  for (int numberOfPoints = 4; numberOfPoints <= maximumNumberOfPoints; numberOfPoints += numberOfPointsStep)
+  {
+    RunCombinatoricGeneratorBenchmark(os, numberOfPoints);
+    RunPointDistanceMatrixBenchmark(os, numberOfPoints, 1000);
+    RunPointMatcherBenchmark(os, numberOfPoints, numberOfTrials, false);
+    RunPointMatcherBenchmark(os, numberOfPoints, numberOfTrials, true);
+  }
+
+  return EXIT_SUCCESS;
+}
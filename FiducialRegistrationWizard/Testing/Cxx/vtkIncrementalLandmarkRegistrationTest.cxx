@@ -0,0 +1,262 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks that vtkIncrementalLandmarkRegistration computes the same transform as vtkLandmarkTransform
+// (rigid and similarity) and the same RMS error as transforming the points, through a long sequence of
+// point edits: added, removed and moved point pairs (incremental updates, more than the number after which
+// the sums are recomputed), unchanged and completely replaced point lists (full recomputation).
+// The collinearity check is compared with lists of points along a line.
+
+// FiducialRegistrationWizard includes
+#include "vtkIncrementalLandmarkRegistration.h"
+
+// VTK includes
+#include <vtkLandmarkTransform.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double POINT_RANGE_MM = 100.0;
+const double NOISE_MM = 1.0;
+const double SCALE = 1.2;
+const int MINIMUM_NUMBER_OF_POINTS = 4;
+const int MAXIMUM_NUMBER_OF_POINTS = 12;
+const int NUMBER_OF_EDITS = 250;
+// same threshold as in the registration wizard logic
+const double EIGENVALUE_THRESHOLD = 1e-4;
+// vtkLandmarkTransform computes the sums in a different order
+const double MATRIX_ELEMENT_TOLERANCE = 1e-8;
+const double ERROR_TOLERANCE_MM = 1e-6;
+
+//----------------------------------------------------------------------------
+// Point lists as flat coordinate arrays (x, y, z for each point), so that pairs can be inserted and removed
+struct PointPairs
+{
+  std::vector<double> Source;
+  std::vector<double> Target;
+};
+
+//----------------------------------------------------------------------------
+void CreatePointPair(vtkTransform* sourceToTargetTransform, double sourcePoint[3], double targetPoint[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    sourcePoint[i] = vtkMath::Random(0.0, POINT_RANGE_MM);
+  }
+  sourceToTargetTransform->TransformPoint(sourcePoint, targetPoint);
+  for (int i = 0; i < 3; i++)
+  {
+    targetPoint[i] += vtkMath::Gaussian(0.0, NOISE_MM);
+  }
+}
+
+//----------------------------------------------------------------------------
+void InsertPointPair(PointPairs& pointPairs, int pairIndex, vtkTransform* sourceToTargetTransform)
+{
+  double sourcePoint[3];
+  double targetPoint[3];
+  CreatePointPair(sourceToTargetTransform, sourcePoint, targetPoint);
+  pointPairs.Source.insert(pointPairs.Source.begin() + 3 * pairIndex, sourcePoint, sourcePoint + 3);
+  pointPairs.Target.insert(pointPairs.Target.begin() + 3 * pairIndex, targetPoint, targetPoint + 3);
+}
+
+//----------------------------------------------------------------------------
+void SetPoints(const std::vector<double>& coordinates, vtkPoints* points)
+{
+  int numberOfPoints = static_cast<int>(coordinates.size() / 3);
+  points->SetNumberOfPoints(numberOfPoints);
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    points->SetPoint(pointIndex, &coordinates[3 * pointIndex]);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool CheckRegistration(vtkIncrementalLandmarkRegistration* registration, vtkPoints* sourcePoints, vtkPoints* targetPoints,
+  int mode, const char* description)
+{
+  vtkNew<vtkLandmarkTransform> landmarkTransform;
+  landmarkTransform->SetSourceLandmarks(sourcePoints);
+  landmarkTransform->SetTargetLandmarks(targetPoints);
+  landmarkTransform->SetMode(mode);
+  landmarkTransform->Update();
+  vtkMatrix4x4* expectedMatrix = landmarkTransform->GetMatrix();
+
+  registration->SetMode(mode);
+  vtkNew<vtkMatrix4x4> matrix;
+  registration->GetMatrix(matrix.GetPointer());
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      // translation is scaled with the point coordinates
+      double tolerance = (j < 3 ? MATRIX_ELEMENT_TOLERANCE : MATRIX_ELEMENT_TOLERANCE * POINT_RANGE_MM);
+      if (fabs(matrix->GetElement(i, j) - expectedMatrix->GetElement(i, j)) > tolerance)
+      {
+        std::cerr << description << ": matrix element (" << i << ", " << j << ") is " << matrix->GetElement(i, j)
+          << ", vtkLandmarkTransform computed " << expectedMatrix->GetElement(i, j) << std::endl;
+        return false;
+      }
+    }
+  }
+
+  double sumOfSquaredErrors = 0.0;
+  for (int pointIndex = 0; pointIndex < sourcePoints->GetNumberOfPoints(); pointIndex++)
+  {
+    double transformedSourcePoint[3];
+    double targetPoint[3];
+    landmarkTransform->TransformPoint(sourcePoints->GetPoint(pointIndex), transformedSourcePoint);
+    targetPoints->GetPoint(pointIndex, targetPoint);
+    sumOfSquaredErrors += vtkMath::Distance2BetweenPoints(transformedSourcePoint, targetPoint);
+  }
+  double expectedErrorMm = sqrt(sumOfSquaredErrors / sourcePoints->GetNumberOfPoints());
+  if (fabs(registration->GetRootMeanSquareError() - expectedErrorMm) > ERROR_TOLERANCE_MM)
+  {
+    std::cerr << description << ": RMS error is " << registration->GetRootMeanSquareError() << "mm, expected " << expectedErrorMm << "mm" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool CheckRegistrations(vtkIncrementalLandmarkRegistration* registration, const PointPairs& pointPairs, const char* description)
+{
+  vtkNew<vtkPoints> sourcePoints;
+  vtkNew<vtkPoints> targetPoints;
+  SetPoints(pointPairs.Source, sourcePoints.GetPointer());
+  SetPoints(pointPairs.Target, targetPoints.GetPointer());
+  registration->SetLandmarks(sourcePoints.GetPointer(), targetPoints.GetPointer());
+  if (registration->GetNumberOfPoints() != sourcePoints->GetNumberOfPoints())
+  {
+    std::cerr << description << ": number of points is " << registration->GetNumberOfPoints() << ", expected " << sourcePoints->GetNumberOfPoints() << std::endl;
+    return false;
+  }
+  if (registration->IsSourceCollinear(EIGENVALUE_THRESHOLD) || registration->IsTargetCollinear(EIGENVALUE_THRESHOLD))
+  {
+    std::cerr << description << ": random point lists are reported to be collinear" << std::endl;
+    return false;
+  }
+  return CheckRegistration(registration, sourcePoints.GetPointer(), targetPoints.GetPointer(), VTK_LANDMARK_RIGIDBODY, description)
+    && CheckRegistration(registration, sourcePoints.GetPointer(), targetPoints.GetPointer(), VTK_LANDMARK_SIMILARITY, description);
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkIncrementalLandmarkRegistrationTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool success = true;
+  vtkMath::RandomSeed(42);
+
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->Translate(20.0, -30.0, 40.0);
+  sourceToTargetTransform->RotateWXYZ(35.0, 1.0, 2.0, -1.0);
+  sourceToTargetTransform->Scale(SCALE, SCALE, SCALE);
+
+  PointPairs pointPairs;
+  for (int pairIndex = 0; pairIndex < MINIMUM_NUMBER_OF_POINTS; pairIndex++)
+  {
+    InsertPointPair(pointPairs, pairIndex, sourceToTargetTransform.GetPointer());
+  }
+  vtkNew<vtkIncrementalLandmarkRegistration> registration;
+  success &= CheckRegistrations(registration.GetPointer(), pointPairs, "Initial points");
+
+  for (int editIndex = 0; editIndex < NUMBER_OF_EDITS && success; editIndex++)
+  {
+    int numberOfPoints = static_cast<int>(pointPairs.Source.size() / 3);
+    int pairIndex = static_cast<int>(vtkMath::Random(0.0, numberOfPoints)) % numberOfPoints;
+    // 0: add, 1: remove, 2: move source, 3: move target, 4: no change
+    int edit = static_cast<int>(vtkMath::Random(0.0, 5.0));
+    const char* description = "";
+    if (editIndex % 50 == 49)
+    {
+      description = "Replaced points";
+      pointPairs = PointPairs();
+      for (int newPairIndex = 0; newPairIndex < numberOfPoints; newPairIndex++)
+      {
+        InsertPointPair(pointPairs, newPairIndex, sourceToTargetTransform.GetPointer());
+      }
+    }
+    else if (edit == 0 && numberOfPoints < MAXIMUM_NUMBER_OF_POINTS)
+    {
+      description = "Added point";
+      InsertPointPair(pointPairs, static_cast<int>(vtkMath::Random(0.0, numberOfPoints + 1.0)) % (numberOfPoints + 1), sourceToTargetTransform.GetPointer());
+    }
+    else if (edit == 1 && numberOfPoints > MINIMUM_NUMBER_OF_POINTS)
+    {
+      description = "Removed point";
+      pointPairs.Source.erase(pointPairs.Source.begin() + 3 * pairIndex, pointPairs.Source.begin() + 3 * (pairIndex + 1));
+      pointPairs.Target.erase(pointPairs.Target.begin() + 3 * pairIndex, pointPairs.Target.begin() + 3 * (pairIndex + 1));
+    }
+    else if (edit == 2)
+    {
+      description = "Moved source point";
+      pointPairs.Source[3 * pairIndex + static_cast<int>(vtkMath::Random(0.0, 3.0)) % 3] += vtkMath::Gaussian(0.0, 10.0);
+    }
+    else if (edit == 3)
+    {
+      description = "Moved target point";
+      pointPairs.Target[3 * pairIndex + static_cast<int>(vtkMath::Random(0.0, 3.0)) % 3] += vtkMath::Gaussian(0.0, 10.0);
+    }
+    else
+    {
+      description = "Unchanged points";
+    }
+    success &= CheckRegistrations(registration.GetPointer(), pointPairs, description);
+  }
+
+  // Points along a line (with deviation below the threshold) are collinear
+  vtkNew<vtkPoints> sourcePoints;
+  vtkNew<vtkPoints> collinearPoints;
+  for (int pointIndex = 0; pointIndex < MINIMUM_NUMBER_OF_POINTS; pointIndex++)
+  {
+    double position = 10.0 * pointIndex;
+    sourcePoints->InsertNextPoint(vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM));
+    collinearPoints->InsertNextPoint(5.0 + position, -3.0 + 2.0 * position, 1.0 + 3.0 * position + (pointIndex % 2) * 1e-3);
+  }
+  vtkNew<vtkIncrementalLandmarkRegistration> collinearRegistration;
+  collinearRegistration->SetLandmarks(sourcePoints.GetPointer(), collinearPoints.GetPointer());
+  if (collinearRegistration->IsSourceCollinear(EIGENVALUE_THRESHOLD) || !collinearRegistration->IsTargetCollinear(EIGENVALUE_THRESHOLD))
+  {
+    std::cerr << "Collinearity of the target points is not detected" << std::endl;
+    success = false;
+  }
+  collinearRegistration->SetLandmarks(collinearPoints.GetPointer(), sourcePoints.GetPointer());
+  if (!collinearRegistration->IsSourceCollinear(EIGENVALUE_THRESHOLD) || collinearRegistration->IsTargetCollinear(EIGENVALUE_THRESHOLD))
+  {
+    std::cerr << "Collinearity of the source points is not detected" << std::endl;
+    success = false;
+  }
+
+  if (!success)
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "vtkIncrementalLandmarkRegistration results match vtkLandmarkTransform" << std::endl;
+  return EXIT_SUCCESS;
+}
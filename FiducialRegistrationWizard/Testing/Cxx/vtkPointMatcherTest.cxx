@@ -0,0 +1,386 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks that the branch-and-bound search of vtkPointMatcher finds the same matching as a
+// brute-force search over all subsets and orderings of the points, for small point lists:
+// moved, shuffled and noisy copies with extra and missing points, and unrelated point lists
+// (where no matching is within tolerance). The single- and multithreaded searches are checked,
+// and so is the update after a point is appended to one of the lists.
+
+// FiducialRegistrationWizard includes
+#include "vtkPointMatcher.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double POINT_RANGE_MM = 100.0;
+const double TOLERABLE_ROOT_MEAN_SQUARE_DISTANCE_ERROR_MM = 10.0;
+const double AMBIGUITY_THRESHOLD_DISTANCE_MM = 5.0;
+const unsigned int MAXIMUM_DIFFERENCE_IN_NUMBER_OF_POINTS = 2;
+const int MINIMUM_NUMBER_OF_POINTS_TO_MATCH = 3;
+// the matcher and the brute-force search sum the squared errors in different order
+const double ERROR_COMPARISON_TOLERANCE_MM = 1e-9;
+
+//----------------------------------------------------------------------------
+// Best and second best matchings, in the same form as they are stored by the matcher:
+// list 1 indices in increasing order, with the corresponding list 2 indices
+struct BruteForceResult
+{
+  double BestRootMeanSquareDistanceErrorMm;
+  double SecondBestRootMeanSquareDistanceErrorMm;
+  std::vector<int> BestPointList1Indices;
+  std::vector<int> BestPointList2Indices;
+};
+
+//----------------------------------------------------------------------------
+// Distances between all pairs of points of the list, row-major
+void ComputeDistances(vtkPoints* points, std::vector<double>& distances)
+{
+  int numberOfPoints = points->GetNumberOfPoints();
+  distances.resize(numberOfPoints * numberOfPoints);
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    for (int otherPointIndex = 0; otherPointIndex < numberOfPoints; otherPointIndex++)
+    {
+      double point[3];
+      double otherPoint[3];
+      points->GetPoint(pointIndex, point);
+      points->GetPoint(otherPointIndex, otherPoint);
+      distances[pointIndex * numberOfPoints + otherPointIndex] = sqrt(vtkMath::Distance2BetweenPoints(point, otherPoint));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Same error metric as vtkPointMatcher: root mean square difference of the point to point
+// distances within the two lists, over all ordered pairs of the matched points
+double ComputeRootMeanSquareDistanceErrorMm(const std::vector<double>& pointList1Distances, int pointList1Size,
+  const std::vector<double>& pointList2Distances, int pointList2Size,
+  const std::vector<int>& pointList1Indices, const std::vector<int>& pointList2Indices)
+{
+  size_t numberOfMatchedPoints = pointList1Indices.size();
+  double sumOfSquaredDistanceErrors = 0.0;
+  for (size_t matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++)
+  {
+    for (size_t otherMatchedIndex = 0; otherMatchedIndex < numberOfMatchedPoints; otherMatchedIndex++)
+    {
+      double distance1 = pointList1Distances[pointList1Indices[matchedIndex] * pointList1Size + pointList1Indices[otherMatchedIndex]];
+      double distance2 = pointList2Distances[pointList2Indices[matchedIndex] * pointList2Size + pointList2Indices[otherMatchedIndex]];
+      sumOfSquaredDistanceErrors += (distance1 - distance2) * (distance1 - distance2);
+    }
+  }
+  return sqrt(sumOfSquaredDistanceErrors / (numberOfMatchedPoints * numberOfMatchedPoints));
+}
+
+//----------------------------------------------------------------------------
+void UpdateBruteForceResult(BruteForceResult& result, double rootMeanSquareDistanceErrorMm,
+  const std::vector<int>& pointList1Indices, const std::vector<int>& pointList2Indices)
+{
+  if (rootMeanSquareDistanceErrorMm < result.BestRootMeanSquareDistanceErrorMm)
+  {
+    result.SecondBestRootMeanSquareDistanceErrorMm = result.BestRootMeanSquareDistanceErrorMm;
+    result.BestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+    result.BestPointList1Indices = pointList1Indices;
+    result.BestPointList2Indices = pointList2Indices;
+  }
+  else if (rootMeanSquareDistanceErrorMm < result.SecondBestRootMeanSquareDistanceErrorMm)
+  {
+    result.SecondBestRootMeanSquareDistanceErrorMm = rootMeanSquareDistanceErrorMm;
+  }
+}
+
+//----------------------------------------------------------------------------
+// All matchings of the given size: each subset of list 1 (in increasing index order)
+// with each ordered selection of the same number of list 2 points
+void BruteForceMatchingsOfSize(vtkPoints* pointList1, vtkPoints* pointList2, int sizeOfSubset, BruteForceResult& result)
+{
+  int pointList1Size = pointList1->GetNumberOfPoints();
+  int pointList2Size = pointList2->GetNumberOfPoints();
+  std::vector<double> pointList1Distances;
+  std::vector<double> pointList2Distances;
+  ComputeDistances(pointList1, pointList1Distances);
+  ComputeDistances(pointList2, pointList2Distances);
+
+  std::vector<int> pointList1Selected(pointList1Size, 0);
+  std::fill(pointList1Selected.begin(), pointList1Selected.begin() + sizeOfSubset, 1);
+  do
+  {
+    std::vector<int> pointList1Indices;
+    for (int pointList1Index = 0; pointList1Index < pointList1Size; pointList1Index++)
+    {
+      if (pointList1Selected[pointList1Index] != 0)
+      {
+        pointList1Indices.push_back(pointList1Index);
+      }
+    }
+
+    // all orderings of all subsets of list 2: permutations of all list 2 indices,
+    // only the first sizeOfSubset of which are used, each prefix is visited once
+    std::vector<int> pointList2Order(pointList2Size);
+    for (int pointList2Index = 0; pointList2Index < pointList2Size; pointList2Index++)
+    {
+      pointList2Order[pointList2Index] = pointList2Index;
+    }
+    do
+    {
+      std::vector<int> pointList2Indices(pointList2Order.begin(), pointList2Order.begin() + sizeOfSubset);
+      double rootMeanSquareDistanceErrorMm = ComputeRootMeanSquareDistanceErrorMm(pointList1Distances, pointList1Size,
+        pointList2Distances, pointList2Size, pointList1Indices, pointList2Indices);
+      UpdateBruteForceResult(result, rootMeanSquareDistanceErrorMm, pointList1Indices, pointList2Indices);
+      // skip the orderings of the unused points, they have the same prefix
+      std::sort(pointList2Order.begin() + sizeOfSubset, pointList2Order.end());
+      std::reverse(pointList2Order.begin() + sizeOfSubset, pointList2Order.end());
+    }
+    while (std::next_permutation(pointList2Order.begin(), pointList2Order.end()));
+  }
+  // selected points first, so prev_permutation visits all subsets
+  while (std::prev_permutation(pointList1Selected.begin(), pointList1Selected.end()));
+}
+
+//----------------------------------------------------------------------------
+// Same search strategy as vtkPointMatcher::Update: decreasing subset sizes
+// until a matching within tolerance is found
+BruteForceResult BruteForceMatching(vtkPoints* pointList1, vtkPoints* pointList2)
+{
+  BruteForceResult result;
+  result.BestRootMeanSquareDistanceErrorMm = VTK_DOUBLE_MAX;
+  result.SecondBestRootMeanSquareDistanceErrorMm = VTK_DOUBLE_MAX;
+  int smallerPointListSize = std::min(pointList1->GetNumberOfPoints(), pointList2->GetNumberOfPoints());
+  int largerPointListSize = std::max(pointList1->GetNumberOfPoints(), pointList2->GetNumberOfPoints());
+  int minimumNumberOfPointsToMatch = std::max(largerPointListSize - static_cast<int>(MAXIMUM_DIFFERENCE_IN_NUMBER_OF_POINTS), MINIMUM_NUMBER_OF_POINTS_TO_MATCH);
+  for (int sizeOfSubset = smallerPointListSize; sizeOfSubset >= minimumNumberOfPointsToMatch; sizeOfSubset--)
+  {
+    BruteForceMatchingsOfSize(pointList1, pointList2, sizeOfSubset, result);
+    if (result.BestRootMeanSquareDistanceErrorMm <= TOLERABLE_ROOT_MEAN_SQUARE_DISTANCE_ERROR_MM)
+    {
+      break;
+    }
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void AddRandomPoints(vtkPoints* points, int numberOfPoints)
+{
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    points->InsertNextPoint(vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM), vtkMath::Random(0.0, POINT_RANGE_MM));
+  }
+}
+
+//----------------------------------------------------------------------------
+// List 2 is list 1 moved by a random rigid transform, with noise, in random order, with the
+// given number of list 1 points left out and the given number of random points added
+void CreateMovedPointList(vtkPoints* pointList1, int numberOfMissingPoints, int numberOfExtraPoints, double noiseMm, vtkPoints* pointList2)
+{
+  vtkNew<vtkTransform> list1ToList2Transform;
+  list1ToList2Transform->RotateWXYZ(vtkMath::Random(0.0, 360.0), vtkMath::Random(-1.0, 1.0), vtkMath::Random(-1.0, 1.0), vtkMath::Random(-1.0, 1.0));
+  list1ToList2Transform->Translate(vtkMath::Random(-50.0, 50.0), vtkMath::Random(-50.0, 50.0), vtkMath::Random(-50.0, 50.0));
+
+  vtkNew<vtkPoints> orderedPoints;
+  for (int pointList1Index = numberOfMissingPoints; pointList1Index < pointList1->GetNumberOfPoints(); pointList1Index++)
+  {
+    double point[3];
+    list1ToList2Transform->TransformPoint(pointList1->GetPoint(pointList1Index), point);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      point[axis] += vtkMath::Gaussian(0.0, noiseMm);
+    }
+    orderedPoints->InsertNextPoint(point);
+  }
+  AddRandomPoints(orderedPoints.GetPointer(), numberOfExtraPoints);
+
+  int numberOfPoints = orderedPoints->GetNumberOfPoints();
+  std::vector<int> order(numberOfPoints);
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    order[pointIndex] = pointIndex;
+  }
+  for (int pointIndex = numberOfPoints - 1; pointIndex > 0; pointIndex--)
+  {
+    std::swap(order[pointIndex], order[static_cast<int>(vtkMath::Random(0.0, pointIndex + 1.0)) % (pointIndex + 1)]);
+  }
+  pointList2->SetNumberOfPoints(numberOfPoints);
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    pointList2->SetPoint(pointIndex, orderedPoints->GetPoint(order[pointIndex]));
+  }
+}
+
+//----------------------------------------------------------------------------
+bool CheckMatcher(vtkPointMatcher* matcher, vtkPoints* pointList1, vtkPoints* pointList2, const char* description)
+{
+  BruteForceResult expected = BruteForceMatching(pointList1, pointList2);
+  bool expectedWithinTolerance = (expected.BestRootMeanSquareDistanceErrorMm <= TOLERABLE_ROOT_MEAN_SQUARE_DISTANCE_ERROR_MM);
+  bool expectedAmbiguous = (expected.SecondBestRootMeanSquareDistanceErrorMm - expected.BestRootMeanSquareDistanceErrorMm <= AMBIGUITY_THRESHOLD_DISTANCE_MM);
+
+  double errorMm = matcher->GetComputedRootMeanSquareDistanceErrorMm();
+  if (fabs(errorMm - expected.BestRootMeanSquareDistanceErrorMm) > ERROR_COMPARISON_TOLERANCE_MM)
+  {
+    std::cerr << description << ": error of the best matching is " << errorMm << "mm, expected " << expected.BestRootMeanSquareDistanceErrorMm << "mm" << std::endl;
+    return false;
+  }
+  if (matcher->IsMatchingWithinTolerance() != expectedWithinTolerance)
+  {
+    std::cerr << description << ": matching is " << (expectedWithinTolerance ? "not " : "") << "within tolerance, expected the opposite" << std::endl;
+    return false;
+  }
+  if (matcher->IsMatchingAmbiguous() != expectedAmbiguous)
+  {
+    std::cerr << description << ": matching is " << (expectedAmbiguous ? "not " : "") << "ambiguous, expected the opposite"
+      << " (best " << expected.BestRootMeanSquareDistanceErrorMm << "mm, second best " << expected.SecondBestRootMeanSquareDistanceErrorMm << "mm)" << std::endl;
+    return false;
+  }
+
+  // the output lists are the matched points in the order of the best matching
+  vtkPoints* outputPointList1 = matcher->GetOutputPointList1();
+  vtkPoints* outputPointList2 = matcher->GetOutputPointList2();
+  int numberOfMatchedPoints = static_cast<int>(expected.BestPointList1Indices.size());
+  if (outputPointList1->GetNumberOfPoints() != numberOfMatchedPoints || outputPointList2->GetNumberOfPoints() != numberOfMatchedPoints)
+  {
+    std::cerr << description << ": " << outputPointList1->GetNumberOfPoints() << " and " << outputPointList2->GetNumberOfPoints()
+      << " output points, expected " << numberOfMatchedPoints << std::endl;
+    return false;
+  }
+  for (int matchedIndex = 0; matchedIndex < numberOfMatchedPoints; matchedIndex++)
+  {
+    double outputPoint1[3];
+    double outputPoint2[3];
+    outputPointList1->GetPoint(matchedIndex, outputPoint1);
+    outputPointList2->GetPoint(matchedIndex, outputPoint2);
+    double expectedPoint1[3];
+    double expectedPoint2[3];
+    pointList1->GetPoint(expected.BestPointList1Indices[matchedIndex], expectedPoint1);
+    pointList2->GetPoint(expected.BestPointList2Indices[matchedIndex], expectedPoint2);
+    if (vtkMath::Distance2BetweenPoints(outputPoint1, expectedPoint1) != 0.0
+      || vtkMath::Distance2BetweenPoints(outputPoint2, expectedPoint2) != 0.0)
+    {
+      std::cerr << description << ": output pair " << matchedIndex << " is not the pair of the best matching" << std::endl;
+      return false;
+    }
+  }
+
+  std::vector<int> pointList1Indices;
+  std::vector<int> pointList2Indices;
+  bool matchedIndicesStored = matcher->GetLastMatchedPointIndices(pointList1Indices, pointList2Indices);
+  if (matchedIndicesStored != (expectedWithinTolerance && !expectedAmbiguous)
+    || (matchedIndicesStored && (pointList1Indices != expected.BestPointList1Indices || pointList2Indices != expected.BestPointList2Indices)))
+  {
+    std::cerr << description << ": last matched point indices do not match the best matching" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPointMatcher> CreateMatcher(vtkPoints* pointList1, vtkPoints* pointList2, bool useMultithreading)
+{
+  vtkSmartPointer<vtkPointMatcher> matcher = vtkSmartPointer<vtkPointMatcher>::New();
+  matcher->SetInputPointList1(pointList1);
+  matcher->SetInputPointList2(pointList2);
+  matcher->SetMaximumDifferenceInNumberOfPoints(MAXIMUM_DIFFERENCE_IN_NUMBER_OF_POINTS);
+  matcher->SetTolerableRootMeanSquareDistanceErrorMm(TOLERABLE_ROOT_MEAN_SQUARE_DISTANCE_ERROR_MM);
+  matcher->SetAmbiguityThresholdDistanceMm(AMBIGUITY_THRESHOLD_DISTANCE_MM);
+  matcher->SetUseMultithreading(useMultithreading);
+  return matcher;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkPointMatcherTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // the brute-force search visits all matchings, so the point lists are kept small
+  const int minimumNumberOfPoints = 3;
+  const int maximumNumberOfPoints = 7;
+  const int numberOfTrials = 5;
+  const double noiseMm = 0.5;
+  bool success = true;
+
+  vtkMath::RandomSeed(42);
+  for (int numberOfPoints = minimumNumberOfPoints; numberOfPoints <= maximumNumberOfPoints; numberOfPoints++)
+  {
+    for (int trialIndex = 0; trialIndex < numberOfTrials; trialIndex++)
+    {
+      vtkNew<vtkPoints> pointList1;
+      AddRandomPoints(pointList1.GetPointer(), numberOfPoints);
+
+      // moved copies with up to 2 missing and extra points, and an unrelated point list
+      std::vector< vtkSmartPointer<vtkPoints> > pointLists2;
+      for (int numberOfMissingPoints = 0; numberOfMissingPoints <= 1; numberOfMissingPoints++)
+      {
+        for (int numberOfExtraPoints = 0; numberOfExtraPoints <= 1; numberOfExtraPoints++)
+        {
+          if (numberOfPoints - numberOfMissingPoints + numberOfExtraPoints < minimumNumberOfPoints)
+          {
+            continue;
+          }
+          vtkSmartPointer<vtkPoints> pointList2 = vtkSmartPointer<vtkPoints>::New();
+          CreateMovedPointList(pointList1.GetPointer(), numberOfMissingPoints, numberOfExtraPoints, noiseMm, pointList2);
+          pointLists2.push_back(pointList2);
+        }
+      }
+      vtkSmartPointer<vtkPoints> unrelatedPointList = vtkSmartPointer<vtkPoints>::New();
+      AddRandomPoints(unrelatedPointList, numberOfPoints);
+      pointLists2.push_back(unrelatedPointList);
+
+      for (size_t pointList2Index = 0; pointList2Index < pointLists2.size(); pointList2Index++)
+      {
+        vtkPoints* pointList2 = pointLists2[pointList2Index];
+        success &= CheckMatcher(CreateMatcher(pointList1.GetPointer(), pointList2, false), pointList1.GetPointer(), pointList2, "Single-threaded matching");
+        success &= CheckMatcher(CreateMatcher(pointList1.GetPointer(), pointList2, true), pointList1.GetPointer(), pointList2, "Multithreaded matching");
+      }
+
+      // the point of list 2 that had no partner is added to list 1 after a successful matching
+      // (as when the user places one more fiducial): the previous matching is extended with it
+      if (numberOfPoints < maximumNumberOfPoints)
+      {
+        vtkNew<vtkPoints> grownPointList1;
+        grownPointList1->DeepCopy(pointList1.GetPointer());
+        AddRandomPoints(grownPointList1.GetPointer(), 1);
+        vtkNew<vtkPoints> pointList2;
+        CreateMovedPointList(grownPointList1.GetPointer(), 0, 0, noiseMm, pointList2.GetPointer());
+        vtkSmartPointer<vtkPointMatcher> matcher = CreateMatcher(pointList1.GetPointer(), pointList2.GetPointer(), false);
+        success &= CheckMatcher(matcher, pointList1.GetPointer(), pointList2.GetPointer(), "Matching before a point is added");
+        // the logic sets a new point list for each update
+        matcher->SetInputPointList1(grownPointList1.GetPointer());
+        success &= CheckMatcher(matcher, grownPointList1.GetPointer(), pointList2.GetPointer(), "Matching after a point is added");
+      }
+    }
+  }
+
+  if (!success)
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "vtkPointMatcher results match the brute-force search" << std::endl;
+  return EXIT_SUCCESS;
+}
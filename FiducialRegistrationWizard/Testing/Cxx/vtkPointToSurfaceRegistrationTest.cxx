@@ -0,0 +1,601 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks vtkPointToSurfaceRegistration on the points of an ellipsoid surface that are moved away from it
+// by a known transform:
+// - rigid (point-to-plane and point-to-point) and similarity registration recover the transform,
+//   with the same result on a single thread and on multiple threads
+// - distances computed by the multithreaded search are the same as the distances found by a single
+//   vtkCellLocator, also after the target surface is modified (the cached locators have to be rebuilt)
+// - registration in multiple resolution levels gives the same result as registration on all points,
+//   the number of levels is limited by MinimumNumberOfLevelPoints, and each level performs at most
+//   MaximumNumberOfIterations iterations (exactly that many if the convergence tolerance is 0)
+// - iterations stop early when the convergence tolerance is reached
+// - point distances are reported in the order of the source points, although the points are shuffled
+// - with global initialization, points that are moved by a large rotation (where registration from the
+//   identity transform is not expected to find the surface) are registered onto the surface, by the
+//   expected transform up to a symmetry of the ellipsoid, and not worse than without global initialization
+// - when every fifth point on one side of the ellipsoid (about a tenth of all points) is an outlier, displaced
+//   from the surface along the surface normal, trimmed registration (TrimmedFraction) recovers the transform,
+//   while registration of all points is biased by the outliers; the distance of each point is 0 for the inliers
+//   and the displacement for the outliers
+
+// FiducialRegistrationWizard includes
+#include "vtkPointToSurfaceRegistration.h"
+
+// VTK includes
+#include <vtkCellLocator.h>
+#include <vtkGenericCell.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double RADII_MM[3] = { 40.0, 25.0, 15.0 };
+// the source points are vertices of the target surface, so they can be registered exactly
+const double REGISTRATION_TOLERANCE_MM = 1e-3;
+// point-to-point iterations converge slowly when the points slide along the surface
+const double POINT_TO_POINT_REGISTRATION_TOLERANCE_MM = 0.1;
+const double DISTANCE_COMPARISON_TOLERANCE_MM = 1e-9;
+// coarse-to-fine registration needs enough points for at least 3 resolution levels
+const int MULTIRESOLUTION_ELLIPSOID_RESOLUTION = 100;
+const int MINIMUM_NUMBER_OF_LEVEL_POINTS = 200;
+const int OUTLIER_INTERVAL = 5;
+const double OUTLIER_DISPLACEMENT_MM = 20.0;
+const double TRIMMED_FRACTION = 0.15;
+// the outliers are displaced along the normal of the ellipsoid, not of the polygonal surface
+const double OUTLIER_DISTANCE_TOLERANCE_MM = 0.5;
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> CreateEllipsoid(int resolution)
+{
+  vtkNew<vtkSphereSource> sphereSource;
+  sphereSource->SetRadius(1.0);
+  sphereSource->SetThetaResolution(resolution);
+  sphereSource->SetPhiResolution(resolution);
+  vtkNew<vtkTransform> scaling;
+  scaling->Scale(RADII_MM[0], RADII_MM[1], RADII_MM[2]);
+  vtkNew<vtkTransformPolyDataFilter> scalingFilter;
+  scalingFilter->SetInputConnection(sphereSource->GetOutputPort());
+  scalingFilter->SetTransform(scaling.GetPointer());
+  scalingFilter->Update();
+  vtkSmartPointer<vtkPolyData> ellipsoid = vtkSmartPointer<vtkPolyData>::New();
+  ellipsoid->DeepCopy(scalingFilter->GetOutput());
+  return ellipsoid;
+}
+
+//----------------------------------------------------------------------------
+// Source points are the target surface points moved by the inverse of the expected source to target transform
+void CreateSourcePoints(vtkPolyData* targetSurface, vtkTransform* sourceToTargetTransform, vtkPoints* sourcePoints)
+{
+  sourceToTargetTransform->GetLinearInverse()->TransformPoints(targetSurface->GetPoints(), sourcePoints);
+}
+
+//----------------------------------------------------------------------------
+// Same as CreateSourcePoints, but outliers are first displaced outwards along the normal of the ellipsoid.
+// Outliers are all on the positive x side, so that they bias registration that does not ignore them.
+void CreateSourcePointsWithOutliers(vtkPolyData* targetSurface, vtkTransform* sourceToTargetTransform, vtkPoints* sourcePoints,
+  std::vector<bool>& outliers)
+{
+  vtkNew<vtkPoints> displacedTargetPoints;
+  displacedTargetPoints->DeepCopy(targetSurface->GetPoints());
+  outliers.assign(displacedTargetPoints->GetNumberOfPoints(), false);
+  for (int pointIndex = 0; pointIndex < displacedTargetPoints->GetNumberOfPoints(); pointIndex++)
+  {
+    double point[3];
+    displacedTargetPoints->GetPoint(pointIndex, point);
+    if (point[0] <= 0.0 || pointIndex % OUTLIER_INTERVAL != 0)
+    {
+      continue;
+    }
+    outliers[pointIndex] = true;
+    double normal[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 3; i++)
+    {
+      normal[i] = point[i] / (RADII_MM[i] * RADII_MM[i]);
+    }
+    vtkMath::Normalize(normal);
+    for (int i = 0; i < 3; i++)
+    {
+      point[i] += OUTLIER_DISPLACEMENT_MM * normal[i];
+    }
+    displacedTargetPoints->SetPoint(pointIndex, point);
+  }
+  sourceToTargetTransform->GetLinearInverse()->TransformPoints(displacedTargetPoints.GetPointer(), sourcePoints);
+}
+
+//----------------------------------------------------------------------------
+bool CheckMatrix(vtkMatrix4x4* matrix, vtkMatrix4x4* expectedMatrix, double toleranceMm, const char* description)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      // rotation elements are compared at the scale of the surface
+      double tolerance = (j < 3 ? toleranceMm / RADII_MM[2] : toleranceMm);
+      if (fabs(matrix->GetElement(i, j) - expectedMatrix->GetElement(i, j)) > tolerance)
+      {
+        std::cerr << description << ": matrix element (" << i << ", " << j << ") is " << matrix->GetElement(i, j)
+          << ", expected " << expectedMatrix->GetElement(i, j) << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// The ellipsoid is symmetric to its principal planes, so the registration result may differ from the
+// expected transform by a rotation of 180 degrees about a principal axis: the result multiplied by the
+// inverse of the expected transform must be diagonal, with +/-1 elements.
+bool CheckMatrixUpToSymmetry(vtkMatrix4x4* matrix, vtkMatrix4x4* expectedMatrix, const char* description)
+{
+  vtkNew<vtkMatrix4x4> expectedMatrixInverse;
+  vtkMatrix4x4::Invert(expectedMatrix, expectedMatrixInverse.GetPointer());
+  vtkNew<vtkMatrix4x4> symmetry;
+  vtkMatrix4x4::Multiply4x4(matrix, expectedMatrixInverse.GetPointer(), symmetry.GetPointer());
+  vtkNew<vtkMatrix4x4> symmetryMagnitudes;
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      symmetryMagnitudes->SetElement(i, j, fabs(symmetry->GetElement(i, j)));
+    }
+  }
+  vtkNew<vtkMatrix4x4> identityMatrix;
+  if (!CheckMatrix(symmetryMagnitudes.GetPointer(), identityMatrix.GetPointer(), REGISTRATION_TOLERANCE_MM, description))
+  {
+    std::cerr << description << ": result differs from the expected transform by a transform that is not a symmetry of the ellipsoid" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool CheckRegistration(vtkPointToSurfaceRegistration* registration, vtkMatrix4x4* expectedMatrix, double toleranceMm, const char* description)
+{
+  if (!registration->Update())
+  {
+    std::cerr << description << ": registration failed" << std::endl;
+    return false;
+  }
+  if (registration->GetRootMeanSquareDistance() > toleranceMm)
+  {
+    std::cerr << description << ": RMS distance after registration is " << registration->GetRootMeanSquareDistance() << "mm" << std::endl;
+    return false;
+  }
+  return CheckMatrix(registration->GetSourceToTargetMatrix(), expectedMatrix, toleranceMm, description);
+}
+
+//----------------------------------------------------------------------------
+bool CheckNumberOfIterations(vtkPointToSurfaceRegistration* registration, int expectedNumberOfIterations, const char* description)
+{
+  if (!registration->Update())
+  {
+    std::cerr << description << ": registration failed" << std::endl;
+    return false;
+  }
+  if (registration->GetNumberOfIterations() != expectedNumberOfIterations)
+  {
+    std::cerr << description << ": " << registration->GetNumberOfIterations() << " iterations, expected " << expectedNumberOfIterations << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Compare the current distance of each point with the distance found by a single cell locator
+bool CheckPointDistances(vtkPointToSurfaceRegistration* registration, vtkMatrix4x4* sourceToTarget, const char* description)
+{
+  vtkNew<vtkCellLocator> locator;
+  locator->SetDataSet(registration->GetTargetSurface());
+  locator->BuildLocator();
+  vtkNew<vtkGenericCell> cell;
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->SetMatrix(sourceToTarget);
+
+  vtkPoints* sourcePoints = registration->GetSourcePoints();
+  vtkDoubleArray* pointDistances = registration->GetPointDistances();
+  if (pointDistances->GetNumberOfTuples() != sourcePoints->GetNumberOfPoints())
+  {
+    std::cerr << description << ": " << pointDistances->GetNumberOfTuples() << " point distances, expected " << sourcePoints->GetNumberOfPoints() << std::endl;
+    return false;
+  }
+  double sumDistance = 0.0;
+  double sumDistance2 = 0.0;
+  double maximumDistance = 0.0;
+  for (int pointIndex = 0; pointIndex < sourcePoints->GetNumberOfPoints(); pointIndex++)
+  {
+    double sourcePoint[3];
+    sourcePoints->GetPoint(pointIndex, sourcePoint);
+    double transformedPoint[3];
+    sourceToTargetTransform->TransformPoint(sourcePoint, transformedPoint);
+    double closestPoint[3];
+    vtkIdType cellId = -1;
+    int subId = 0;
+    double distance2 = 0.0;
+    locator->FindClosestPoint(transformedPoint, closestPoint, cell.GetPointer(), cellId, subId, distance2);
+    double distance = sqrt(distance2);
+    if (fabs(pointDistances->GetValue(pointIndex) - distance) > DISTANCE_COMPARISON_TOLERANCE_MM)
+    {
+      std::cerr << description << ": distance of point " << pointIndex << " is " << pointDistances->GetValue(pointIndex)
+        << "mm, expected " << distance << "mm" << std::endl;
+      return false;
+    }
+    sumDistance += distance;
+    sumDistance2 += distance2;
+    maximumDistance = std::max(maximumDistance, distance);
+  }
+  int numberOfPoints = sourcePoints->GetNumberOfPoints();
+  if (fabs(registration->GetMeanDistance() - sumDistance / numberOfPoints) > DISTANCE_COMPARISON_TOLERANCE_MM
+    || fabs(registration->GetRootMeanSquareDistance() - sqrt(sumDistance2 / numberOfPoints)) > DISTANCE_COMPARISON_TOLERANCE_MM
+    || fabs(registration->GetMaximumDistance() - maximumDistance) > DISTANCE_COMPARISON_TOLERANCE_MM)
+  {
+    std::cerr << description << ": distance statistics do not match the point distances" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool CheckDistances(vtkPointToSurfaceRegistration* registration, vtkMatrix4x4* sourceToTarget, const char* description)
+{
+  if (!registration->ComputeDistanceStatistics(sourceToTarget))
+  {
+    std::cerr << description << ": distance computation failed" << std::endl;
+    return false;
+  }
+  return CheckPointDistances(registration, sourceToTarget, description);
+}
+
+//----------------------------------------------------------------------------
+// Largest distance of an inlier from the surface
+double GetMaximumInlierDistance(vtkPointToSurfaceRegistration* registration, const std::vector<bool>& outliers)
+{
+  vtkDoubleArray* pointDistances = registration->GetPointDistances();
+  double maximumInlierDistance = 0.0;
+  for (int pointIndex = 0; pointIndex < pointDistances->GetNumberOfTuples(); pointIndex++)
+  {
+    if (!outliers[pointIndex] && pointDistances->GetValue(pointIndex) > maximumInlierDistance)
+    {
+      maximumInlierDistance = pointDistances->GetValue(pointIndex);
+    }
+  }
+  return maximumInlierDistance;
+}
+
+//----------------------------------------------------------------------------
+// Inliers are on the surface, outliers are at the displacement from it
+bool CheckOutlierDistances(vtkPointToSurfaceRegistration* registration, const std::vector<bool>& outliers, const char* description)
+{
+  vtkDoubleArray* pointDistances = registration->GetPointDistances();
+  if (pointDistances->GetNumberOfTuples() != registration->GetSourcePoints()->GetNumberOfPoints())
+  {
+    std::cerr << description << ": " << pointDistances->GetNumberOfTuples() << " point distances, expected "
+      << registration->GetSourcePoints()->GetNumberOfPoints() << std::endl;
+    return false;
+  }
+  for (int pointIndex = 0; pointIndex < pointDistances->GetNumberOfTuples(); pointIndex++)
+  {
+    double expectedDistance = (outliers[pointIndex] ? OUTLIER_DISPLACEMENT_MM : 0.0);
+    double tolerance = (outliers[pointIndex] ? OUTLIER_DISTANCE_TOLERANCE_MM : REGISTRATION_TOLERANCE_MM);
+    if (fabs(pointDistances->GetValue(pointIndex) - expectedDistance) > tolerance)
+    {
+      std::cerr << description << ": distance of point " << pointIndex << " is " << pointDistances->GetValue(pointIndex)
+        << "mm, expected " << expectedDistance << "mm" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Coarse-to-fine registration and the convergence check
+bool TestCoarseToFineRegistration()
+{
+  bool success = true;
+
+  vtkSmartPointer<vtkPolyData> targetSurface = CreateEllipsoid(MULTIRESOLUTION_ELLIPSOID_RESOLUTION);
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->Translate(3.0, -5.0, 2.0);
+  sourceToTargetTransform->RotateWXYZ(10.0, 1.0, 1.0, 1.0);
+  vtkNew<vtkPoints> sourcePoints;
+  CreateSourcePoints(targetSurface, sourceToTargetTransform.GetPointer(), sourcePoints.GetPointer());
+
+  // number of resolution levels that have at least the minimum number of points (in addition to the level of all points)
+  int numberOfLevels = 1;
+  for (int numberOfLevelPoints = sourcePoints->GetNumberOfPoints() / 4; numberOfLevelPoints >= MINIMUM_NUMBER_OF_LEVEL_POINTS; numberOfLevelPoints /= 4)
+  {
+    numberOfLevels++;
+  }
+  if (numberOfLevels < 3)
+  {
+    std::cerr << "Test surface has too few points for 3 resolution levels" << std::endl;
+    return false;
+  }
+
+  vtkNew<vtkPointToSurfaceRegistration> registration;
+  registration->SetSourcePoints(sourcePoints.GetPointer());
+  registration->SetTargetSurface(targetSurface);
+  registration->SetModeToRigidBody();
+  registration->SetMinimumNumberOfLevelPoints(MINIMUM_NUMBER_OF_LEVEL_POINTS);
+
+  // Single level registration
+  registration->SetNumberOfResolutionLevels(1);
+  success &= CheckRegistration(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), REGISTRATION_TOLERANCE_MM,
+    "Single level registration");
+  int singleLevelNumberOfIterations = registration->GetNumberOfIterations();
+
+  // Coarse-to-fine registration gives the same result, the last level is on all points
+  registration->SetNumberOfResolutionLevels(numberOfLevels + 2);
+  success &= CheckRegistration(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), REGISTRATION_TOLERANCE_MM,
+    "Coarse-to-fine registration");
+  success &= CheckPointDistances(registration.GetPointer(), registration->GetSourceToTargetMatrix(), "Coarse-to-fine registration");
+
+  // Iterations stop at the convergence tolerance
+  if (singleLevelNumberOfIterations >= registration->GetMaximumNumberOfIterations()
+    || registration->GetNumberOfIterations() >= numberOfLevels * registration->GetMaximumNumberOfIterations())
+  {
+    std::cerr << "Registration did not stop at the convergence tolerance: " << singleLevelNumberOfIterations << " iterations on a single level, "
+      << registration->GetNumberOfIterations() << " iterations on " << numberOfLevels << " levels" << std::endl;
+    success = false;
+  }
+
+  // Without convergence tolerance all iterations are performed on each level
+  const int maximumNumberOfIterations = 5;
+  registration->SetConvergenceTolerance(0.0);
+  registration->SetMaximumNumberOfIterations(maximumNumberOfIterations);
+  success &= CheckNumberOfIterations(registration.GetPointer(), numberOfLevels * maximumNumberOfIterations, "Coarse-to-fine iterations");
+  registration->SetNumberOfResolutionLevels(1);
+  success &= CheckNumberOfIterations(registration.GetPointer(), maximumNumberOfIterations, "Single level iterations");
+  // levels with fewer points than the minimum are skipped
+  registration->SetNumberOfResolutionLevels(numberOfLevels);
+  registration->SetMinimumNumberOfLevelPoints(sourcePoints->GetNumberOfPoints() / 4 + 1);
+  success &= CheckNumberOfIterations(registration.GetPointer(), maximumNumberOfIterations, "Iterations with large minimum level size");
+
+  return success;
+}
+
+//----------------------------------------------------------------------------
+// Global initialization recovers a large rotation
+bool TestGlobalInitialization()
+{
+  bool success = true;
+
+  vtkSmartPointer<vtkPolyData> targetSurface = CreateEllipsoid(40);
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->Translate(20.0, -10.0, 5.0);
+  sourceToTargetTransform->RotateWXYZ(150.0, 1.0, 2.0, 3.0);
+  vtkNew<vtkPoints> sourcePoints;
+  CreateSourcePoints(targetSurface, sourceToTargetTransform.GetPointer(), sourcePoints.GetPointer());
+
+  vtkNew<vtkPointToSurfaceRegistration> registration;
+  registration->SetSourcePoints(sourcePoints.GetPointer());
+  registration->SetTargetSurface(targetSurface);
+  registration->SetModeToRigidBody();
+
+  // Registration from the identity transform
+  registration->UseGlobalInitializationOff();
+  if (!registration->Update())
+  {
+    std::cerr << "Registration without global initialization failed" << std::endl;
+    return false;
+  }
+  double localRootMeanSquareDistance = registration->GetRootMeanSquareDistance();
+
+  // Registration from the best initial poses
+  registration->UseGlobalInitializationOn();
+  if (!registration->Update())
+  {
+    std::cerr << "Registration with global initialization failed" << std::endl;
+    return false;
+  }
+  if (registration->GetRootMeanSquareDistance() > REGISTRATION_TOLERANCE_MM)
+  {
+    std::cerr << "Global initialization: RMS distance after registration is " << registration->GetRootMeanSquareDistance() << "mm" << std::endl;
+    success = false;
+  }
+  if (registration->GetRootMeanSquareDistance() > localRootMeanSquareDistance)
+  {
+    std::cerr << "Global initialization: RMS distance after registration is " << registration->GetRootMeanSquareDistance()
+      << "mm, larger than without global initialization (" << localRootMeanSquareDistance << "mm)" << std::endl;
+    success = false;
+  }
+  success &= CheckMatrixUpToSymmetry(registration->GetSourceToTargetMatrix(), sourceToTargetTransform->GetMatrix(), "Global initialization");
+
+  // Same result from fewer candidates, with a single refined initialization
+  registration->SetInitialRotationStepDegrees(90.0);
+  registration->SetNumberOfRefinedInitializations(1);
+  if (!registration->Update() || registration->GetRootMeanSquareDistance() > REGISTRATION_TOLERANCE_MM)
+  {
+    std::cerr << "Global initialization with a single refined candidate: RMS distance after registration is "
+      << registration->GetRootMeanSquareDistance() << "mm" << std::endl;
+    success = false;
+  }
+  success &= CheckMatrixUpToSymmetry(registration->GetSourceToTargetMatrix(), sourceToTargetTransform->GetMatrix(),
+    "Global initialization with a single refined candidate");
+
+  return success;
+}
+
+//----------------------------------------------------------------------------
+// Trimmed registration ignores the outliers
+bool TestTrimmedRegistration()
+{
+  bool success = true;
+
+  vtkSmartPointer<vtkPolyData> targetSurface = CreateEllipsoid(40);
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->Translate(3.0, -5.0, 2.0);
+  sourceToTargetTransform->RotateWXYZ(10.0, 1.0, 1.0, 1.0);
+  vtkNew<vtkPoints> sourcePoints;
+  std::vector<bool> outliers;
+  CreateSourcePointsWithOutliers(targetSurface, sourceToTargetTransform.GetPointer(), sourcePoints.GetPointer(), outliers);
+
+  vtkNew<vtkPointToSurfaceRegistration> registration;
+  registration->SetSourcePoints(sourcePoints.GetPointer());
+  registration->SetTargetSurface(targetSurface);
+  registration->SetModeToRigidBody();
+  registration->SetConvergenceTolerance(0.0);
+
+  // Registration of all points
+  if (!registration->Update())
+  {
+    std::cerr << "Registration without trimming failed" << std::endl;
+    return false;
+  }
+  double untrimmedMaximumInlierDistance = GetMaximumInlierDistance(registration.GetPointer(), outliers);
+
+  // Trimmed registration
+  registration->SetTrimmedFraction(TRIMMED_FRACTION);
+  if (!registration->Update())
+  {
+    std::cerr << "Trimmed registration failed" << std::endl;
+    return false;
+  }
+  success &= CheckMatrix(registration->GetSourceToTargetMatrix(), sourceToTargetTransform->GetMatrix(), REGISTRATION_TOLERANCE_MM,
+    "Trimmed registration");
+  success &= CheckOutlierDistances(registration.GetPointer(), outliers, "Trimmed registration");
+  double trimmedMaximumInlierDistance = GetMaximumInlierDistance(registration.GetPointer(), outliers);
+  if (trimmedMaximumInlierDistance >= untrimmedMaximumInlierDistance)
+  {
+    std::cerr << "Trimmed registration: largest inlier distance is " << trimmedMaximumInlierDistance
+      << "mm, not smaller than without trimming (" << untrimmedMaximumInlierDistance << "mm)" << std::endl;
+    success = false;
+  }
+
+  // Same with point-to-point registration
+  registration->UsePointToPlaneOff();
+  registration->SetMaximumNumberOfIterations(500);
+  if (!registration->Update())
+  {
+    std::cerr << "Trimmed point-to-point registration failed" << std::endl;
+    return false;
+  }
+  trimmedMaximumInlierDistance = GetMaximumInlierDistance(registration.GetPointer(), outliers);
+  if (trimmedMaximumInlierDistance >= untrimmedMaximumInlierDistance)
+  {
+    std::cerr << "Trimmed point-to-point registration: largest inlier distance is " << trimmedMaximumInlierDistance
+      << "mm, not smaller than without trimming (" << untrimmedMaximumInlierDistance << "mm)" << std::endl;
+    success = false;
+  }
+
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkPointToSurfaceRegistrationTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool success = true;
+
+  vtkSmartPointer<vtkPolyData> targetSurface = CreateEllipsoid(40);
+  vtkNew<vtkTransform> sourceToTargetTransform;
+  sourceToTargetTransform->Translate(3.0, -5.0, 2.0);
+  sourceToTargetTransform->RotateWXYZ(10.0, 1.0, 1.0, 1.0);
+  vtkNew<vtkPoints> sourcePoints;
+  CreateSourcePoints(targetSurface, sourceToTargetTransform.GetPointer(), sourcePoints.GetPointer());
+
+  vtkNew<vtkPointToSurfaceRegistration> registration;
+  registration->SetSourcePoints(sourcePoints.GetPointer());
+  registration->SetTargetSurface(targetSurface);
+  registration->SetModeToRigidBody();
+  registration->SetConvergenceTolerance(0.0);
+
+  // Rigid registration, point-to-plane and point-to-point
+  success &= CheckRegistration(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), REGISTRATION_TOLERANCE_MM,
+    "Rigid point-to-plane registration");
+  vtkNew<vtkMatrix4x4> multithreadedMatrix;
+  multithreadedMatrix->DeepCopy(registration->GetSourceToTargetMatrix());
+  registration->SetNumberOfThreads(1);
+  registration->Update();
+  for (int i = 0; i < 3 && success; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      if (registration->GetSourceToTargetMatrix()->GetElement(i, j) != multithreadedMatrix->GetElement(i, j))
+      {
+        std::cerr << "Rigid point-to-plane registration: single-threaded result differs from the multithreaded result" << std::endl;
+        success = false;
+        break;
+      }
+    }
+  }
+  registration->SetNumberOfThreads(4);
+  registration->UsePointToPlaneOff();
+  registration->SetMaximumNumberOfIterations(500);
+  success &= CheckRegistration(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), POINT_TO_POINT_REGISTRATION_TOLERANCE_MM,
+    "Rigid point-to-point registration");
+
+  // Similarity registration recovers the scaling, too
+  vtkNew<vtkTransform> scaledSourceToTargetTransform;
+  scaledSourceToTargetTransform->DeepCopy(sourceToTargetTransform.GetPointer());
+  scaledSourceToTargetTransform->Scale(1.1, 1.1, 1.1);
+  vtkNew<vtkPoints> scaledSourcePoints;
+  CreateSourcePoints(targetSurface, scaledSourceToTargetTransform.GetPointer(), scaledSourcePoints.GetPointer());
+  registration->SetSourcePoints(scaledSourcePoints.GetPointer());
+  registration->SetModeToSimilarity();
+  success &= CheckRegistration(registration.GetPointer(), scaledSourceToTargetTransform->GetMatrix(), POINT_TO_POINT_REGISTRATION_TOLERANCE_MM,
+    "Similarity registration");
+
+  // Distances of the points that are not on the surface
+  registration->SetSourcePoints(sourcePoints.GetPointer());
+  vtkNew<vtkMatrix4x4> identityMatrix;
+  success &= CheckDistances(registration.GetPointer(), identityMatrix.GetPointer(), "Distances");
+  success &= CheckDistances(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), "Distances after registration");
+
+  // Locators are rebuilt when the target surface is modified
+  vtkNew<vtkTransform> targetSurfaceShift;
+  targetSurfaceShift->Translate(0.0, 0.0, 10.0);
+  vtkNew<vtkPoints> shiftedTargetPoints;
+  targetSurfaceShift->TransformPoints(targetSurface->GetPoints(), shiftedTargetPoints.GetPointer());
+  targetSurface->GetPoints()->DeepCopy(shiftedTargetPoints.GetPointer());
+  targetSurface->Modified();
+  success &= CheckDistances(registration.GetPointer(), sourceToTargetTransform->GetMatrix(), "Distances from the modified surface");
+  if (registration->GetMaximumDistance() < 1.0)
+  {
+    std::cerr << "Distances from the modified surface: points are still on the surface, the locators were not rebuilt" << std::endl;
+    success = false;
+  }
+
+  success &= TestCoarseToFineRegistration();
+  success &= TestGlobalInitialization();
+  success &= TestTrimmedRegistration();
+
+  if (!success)
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "vtkPointToSurfaceRegistration recovered the transforms" << std::endl;
+  return EXIT_SUCCESS;
+}
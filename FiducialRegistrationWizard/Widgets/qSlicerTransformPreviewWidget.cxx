@@ -24,6 +24,10 @@
 
 #include <QtGui>
 
+// MRML includes
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLVolumeNode.h"
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_CreateModels
 class qSlicerTransformPreviewWidgetPrivate
@@ -40,11 +44,14 @@ public:
 
   vtkWeakPointer<vtkMRMLTransformNode> CurrentTransformNode;
   std::vector< vtkSmartPointer< vtkMRMLTransformableNode > > PreviewNodes;
+  std::vector< vtkSmartPointer< vtkMRMLDisplayNode > > PreviewDisplayNodes;
+  bool SharePreviewData;
 };
 
 // --------------------------------------------------------------------------
 qSlicerTransformPreviewWidgetPrivate::qSlicerTransformPreviewWidgetPrivate( qSlicerTransformPreviewWidget& object) : q_ptr(&object)
 , CurrentTransformNode(NULL)
+, SharePreviewData(true)
 {
 }
 
@@ -127,6 +134,25 @@ void qSlicerTransformPreviewWidget::setCurrentNode( vtkMRMLNode* newNode )
   this->updateWidget();
 }
 
+//-----------------------------------------------------------------------------
+bool qSlicerTransformPreviewWidget::sharePreviewData()
+{
+  Q_D(qSlicerTransformPreviewWidget);
+  return d->SharePreviewData;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerTransformPreviewWidget::setSharePreviewData( bool share )
+{
+  Q_D(qSlicerTransformPreviewWidget);
+  if ( d->SharePreviewData == share )
+  {
+    return;
+  }
+  d->SharePreviewData = share;
+  this->onCheckedNodesChanged(); // Recreate the preview nodes
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerTransformPreviewWidget::onCheckedNodesChanged()
 {
@@ -284,7 +310,28 @@ void qSlicerTransformPreviewWidget::createAndAddPreviewNode( vtkMRMLNode* baseNo
   // Create a preview node, apply the transform and add to the vector of preview nodes
   vtkSmartPointer< vtkMRMLTransformableNode > previewNode;
   previewNode.TakeReference( vtkMRMLTransformableNode::SafeDownCast( this->mrmlScene()->CreateNodeByClass( baseNode->GetClassName() ) ) );
-  previewNode->Copy( baseNode );
+
+  // Models and volumes can be large, so the preview node displays the data object of the original node
+  // instead of a copy (the transform is applied by the displayable managers, the data is not modified)
+  vtkMRMLModelNode* baseModelNode = vtkMRMLModelNode::SafeDownCast( baseNode );
+  vtkMRMLVolumeNode* baseVolumeNode = vtkMRMLVolumeNode::SafeDownCast( baseNode );
+  if ( d->SharePreviewData && baseModelNode != NULL )
+  {
+    vtkMRMLModelNode::SafeDownCast( previewNode )->SetAndObservePolyData( baseModelNode->GetPolyData() );
+  }
+  else if ( d->SharePreviewData && baseVolumeNode != NULL )
+  {
+    vtkMRMLVolumeNode* previewVolumeNode = vtkMRMLVolumeNode::SafeDownCast( previewNode );
+    previewVolumeNode->CopyOrientation( baseVolumeNode );
+    previewVolumeNode->SetAndObserveImageData( baseVolumeNode->GetImageData() );
+  }
+  else
+  {
+    previewNode->Copy( baseNode );
+  }
+  // Preview nodes are only for display
+  previewNode->SetHideFromEditors( true );
+  previewNode->SetSaveWithScene( false );
 
   QString copyName;
   copyName.append( baseNode->GetName() ); copyName.append( "_Copy" );
@@ -295,18 +342,22 @@ void qSlicerTransformPreviewWidget::createAndAddPreviewNode( vtkMRMLNode* baseNo
 
   previewNode->SetAndObserveTransformNodeID( d->CurrentTransformNode->GetID() );
 
-  // In case the preview node is a displayable node, then copy its display node
+  // In case the preview node is a displayable node, then copy the display node of the original node
   vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast( previewNode );
-  if ( displayableNode != NULL && displayableNode->GetDisplayNode() != NULL)
+  vtkMRMLDisplayableNode* baseDisplayableNode = vtkMRMLDisplayableNode::SafeDownCast( baseNode );
+  if ( displayableNode != NULL && baseDisplayableNode != NULL && baseDisplayableNode->GetDisplayNode() != NULL)
   {
     vtkSmartPointer< vtkMRMLDisplayNode > displayNode;
-    displayNode.TakeReference( vtkMRMLDisplayNode::SafeDownCast( this->mrmlScene()->CreateNodeByClass( displayableNode->GetDisplayNode()->GetClassName() ) ) );
-    displayNode->Copy( displayableNode->GetDisplayNode() );
+    displayNode.TakeReference( vtkMRMLDisplayNode::SafeDownCast( this->mrmlScene()->CreateNodeByClass( baseDisplayableNode->GetDisplayNode()->GetClassName() ) ) );
+    displayNode->Copy( baseDisplayableNode->GetDisplayNode() );
+    displayNode->SetHideFromEditors( true );
+    displayNode->SetSaveWithScene( false );
 
     displayNode->SetScene( this->mrmlScene() );
     this->mrmlScene()->AddNode( displayNode );
 
     displayableNode->SetAndObserveDisplayNodeID( displayNode->GetID() );
+    d->PreviewDisplayNodes.push_back( displayNode );
   }
 
   d->PreviewNodes.push_back( previewNode );
@@ -321,7 +372,12 @@ void qSlicerTransformPreviewWidget::clearPreviewNodes()
   {
     this->mrmlScene()->RemoveNode( d->PreviewNodes.at(i) );
   }
-  d->PreviewNodes.clear(); // Smart pointers will take care of deleting objects
+  d->PreviewNodes.clear();
+  for ( size_t i = 0; i < d->PreviewDisplayNodes.size(); i++ )
+  {
+    this->mrmlScene()->RemoveNode( d->PreviewDisplayNodes.at(i) );
+  }
+  d->PreviewDisplayNodes.clear(); // Smart pointers will take care of deleting objects
 }
 
 //------------------------------------------------------------------------------
@@ -56,6 +56,12 @@ public:
 
   void setMRMLScene(vtkMRMLScene* scene);
 
+  /// If enabled (this is the default) then model and volume preview nodes display
+  /// the polydata or image data of the original nodes, without copying them.
+  /// If disabled then the preview nodes contain a full copy of the original nodes.
+  bool sharePreviewData();
+  void setSharePreviewData( bool share );
+
 protected slots:
 
   void onCheckedNodesChanged();
@@ -19,6 +19,7 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QTimer>
 #include <QtPlugin>
 
 // FiducialRegistrationWizard Logic includes
@@ -40,6 +41,9 @@ class qSlicerFiducialRegistrationWizardModulePrivate
 {
 public:
   qSlicerFiducialRegistrationWizardModulePrivate();
+
+  vtkSlicerFiducialRegistrationWizardLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
+  QTimer ProcessPendingUpdatesTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -47,6 +51,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerFiducialRegistrationWizardModulePrivate::qSlicerFiducialRegistrationWizardModulePrivate()
+: ObservedLogic(NULL)
 {
 }
 
@@ -75,6 +80,10 @@ QStringList qSlicerFiducialRegistrationWizardModule::dependencies() const
 //-----------------------------------------------------------------------------
 qSlicerFiducialRegistrationWizardModule::~qSlicerFiducialRegistrationWizardModule()
 {
+  Q_D(qSlicerFiducialRegistrationWizardModule);
+  disconnect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -108,9 +117,16 @@ QIcon qSlicerFiducialRegistrationWizardModule::icon()const
 //-----------------------------------------------------------------------------
 void qSlicerFiducialRegistrationWizardModule::setup()
 {
+  Q_D(qSlicerFiducialRegistrationWizardModule);
   this->Superclass::setup();
 
   vtkSlicerFiducialRegistrationWizardLogic* fiducialRegistrationWizardLogic = vtkSlicerFiducialRegistrationWizardLogic::SafeDownCast( this->logic() );
+  this->qvtkReconnect(d->ObservedLogic, fiducialRegistrationWizardLogic, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = fiducialRegistrationWizardLogic;
+
+  // Full updates that were postponed by the live preview are performed on the main thread
+  d->ProcessPendingUpdatesTimer.setInterval(50);
+  connect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
   
   qSlicerAbstractCoreModule* markupsModule = qSlicerCoreApplication::application()->moduleManager()->module("Markups");
   if (markupsModule)
@@ -135,3 +151,29 @@ vtkMRMLAbstractLogic* qSlicerFiducialRegistrationWizardModule::createLogic()
 {
   return vtkSlicerFiducialRegistrationWizardLogic::New();
 }
+
+//------------------------------------------------------------------------------
+void qSlicerFiducialRegistrationWizardModule::updatePendingUpdatesProcessing()
+{
+  Q_D(qSlicerFiducialRegistrationWizardModule);
+  bool pendingUpdates = (d->ObservedLogic!=NULL && d->ObservedLogic->HasPendingUpdates());
+  if (pendingUpdates && !d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.start();
+  }
+  else if (!pendingUpdates && d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.stop();
+  }
+}
+
+//------------------------------------------------------------------------------
+void qSlicerFiducialRegistrationWizardModule::processPendingUpdates()
+{
+  Q_D(qSlicerFiducialRegistrationWizardModule);
+  if (d->ObservedLogic==NULL)
+  {
+    return;
+  }
+  d->ObservedLogic->ProcessPendingUpdates();
+}
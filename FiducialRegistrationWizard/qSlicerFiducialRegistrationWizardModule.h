@@ -26,6 +26,8 @@
 #include "qSlicerCoreApplication.h"
 #include "qSlicerModuleManager.h"
 
+#include <ctkVTKObject.h>
+
 #include "qSlicerFiducialRegistrationWizardModuleExport.h"
 
 class qSlicerFiducialRegistrationWizardModulePrivate;
@@ -35,6 +37,7 @@ class Q_SLICER_QTMODULES_FIDUCIALREGISTRATIONWIZARD_EXPORT qSlicerFiducialRegist
   public qSlicerLoadableModule
 {
   Q_OBJECT
+  QVTK_OBJECT
 #ifdef Slicer_HAVE_QT5
   Q_PLUGIN_METADATA(IID "org.slicer.modules.loadable.qSlicerLoadableModule/1.0");
 #endif
@@ -66,6 +69,10 @@ public:
   /// Return the dependencies for the module  
   virtual QStringList dependencies() const;
 
+public slots:
+  void updatePendingUpdatesProcessing();
+  void processPendingUpdates();
+
 protected:
 
   /// Initialize the module. Register the volumes reader/writer
@@ -13,7 +13,7 @@ class FiducialsToModelRegistration(ScriptedLoadableModule):
     ScriptedLoadableModule.__init__(self, parent)
     self.parent.title = "Fiducials-Model Registration" # TODO make this more human readable by adding spaces
     self.parent.categories = ["IGT"]
-    self.parent.dependencies = []
+    self.parent.dependencies = ["FiducialRegistrationWizard"]
     self.parent.contributors = ["Tamas Ungi (Queen's University"] # replace with "Firstname Lastname (Organization)"
     self.parent.helpText = """
     This module applies Iterative Closest Points registration from a fiducial list to a model surface.
@@ -159,6 +159,18 @@ class FiducialsToModelRegistrationWidget(ScriptedLoadableModuleWidget):
     self.iterationSpin.setValue( 100 )
     advancedFormLayout.addRow("Number of iterations:", self.iterationSpin)
 
+    #
+    # Trimming selector
+    #
+    self.trimmedPercentSpin = qt.QDoubleSpinBox()
+    self.trimmedPercentSpin.setMinimum( 0.0 )
+    self.trimmedPercentSpin.setMaximum( 90.0 )
+    self.trimmedPercentSpin.setSingleStep( 5.0 )
+    self.trimmedPercentSpin.setValue( 0.0 )
+    self.trimmedPercentSpin.setSuffix( " %" )
+    self.trimmedPercentSpin.setToolTip( "Percentage of fiducials farthest from the model that are ignored at each iteration. Use it to make the registration robust to misplaced fiducials." )
+    advancedFormLayout.addRow("Trimmed fiducials:", self.trimmedPercentSpin)
+
     # connections
     self.applyButton.connect('clicked(bool)', self.onApplyButton)
     self.inputModelSelector.connect("currentNodeChanged(vtkMRMLNode*)", self.onSelect)
@@ -168,6 +180,9 @@ class FiducialsToModelRegistrationWidget(ScriptedLoadableModuleWidget):
     # Add vertical spacer
     self.layout.addStretch(1)
 
+    # Logic is kept, so that the target surface locators are not rebuilt for each registration
+    self.logic = FiducialsToModelRegistrationLogic()
+
 
   def cleanup(self):
     pass
@@ -176,13 +191,14 @@ class FiducialsToModelRegistrationWidget(ScriptedLoadableModuleWidget):
     self.applyButton.enabled = self.inputModelSelector.currentNode() and self.outputSelector.currentNode() and self.inputFiducialSelector.currentNode()
 
   def onApplyButton(self):
-    logic = FiducialsToModelRegistrationLogic()
+    logic = self.logic
 
     inputFiducials = self.inputFiducialSelector.currentNode()
     inputModel = self.inputModelSelector.currentNode()
     outputTransform = self.outputSelector.currentNode()
 
-    logic.run(inputFiducials, inputModel, outputTransform, self.typeSelector.currentIndex, self.iterationSpin.value )
+    logic.run(inputFiducials, inputModel, outputTransform, self.typeSelector.currentIndex, self.iterationSpin.value,
+      self.trimmedPercentSpin.value )
 
     self.outputLine.setText( logic.ComputeMeanDistance(inputFiducials, inputModel, outputTransform) )
 
@@ -198,57 +214,64 @@ class FiducialsToModelRegistrationLogic(ScriptedLoadableModuleLogic):
   requiring an instance of the Widget
   """
 
-  def run(self, inputFiducials, inputModel, outputTransform, transformType=0, numIterations=100 ):
+  def __init__(self, parent = None):
+    ScriptedLoadableModuleLogic.__init__(self, parent)
+    # Registration engine keeps the target surface locators between calls
+    self.pointToSurfaceRegistration = slicer.vtkPointToSurfaceRegistration()
+
+  def run(self, inputFiducials, inputModel, outputTransform, transformType=0, numIterations=100, trimmedPercent=0.0 ):
 
     self.delayDisplay('Running iterative closest point registration')
 
     fiducialsPolyData = vtk.vtkPolyData()
     self.FiducialsToPolyData(inputFiducials, fiducialsPolyData)
 
-    icpTransform = vtk.vtkIterativeClosestPointTransform()
-    icpTransform.SetSource( fiducialsPolyData )
-    icpTransform.SetTarget( inputModel.GetPolyData() )
-    icpTransform.GetLandmarkTransform().SetModeToRigidBody()
+    registration = self.pointToSurfaceRegistration
+    registration.SetSourcePoints( fiducialsPolyData.GetPoints() )
+    registration.SetTargetSurface( inputModel.GetPolyData() )
+    registration.SetModeToRigidBody()
     if transformType == 1:
-      icpTransform.GetLandmarkTransform().SetModeToSimilarity()
+      registration.SetModeToSimilarity()
     if transformType == 2:
-      icpTransform.GetLandmarkTransform().SetModeToAffine()
-    icpTransform.SetMaximumNumberOfIterations( numIterations )
-    icpTransform.Modified()
-    icpTransform.Update()
+      registration.SetModeToAffine()
+    registration.SetMaximumNumberOfIterations( numIterations )
+    registration.SetTrimmedFraction( trimmedPercent / 100.0 )
+    if not registration.Update():
+      return False
 
-    outputTransform.SetMatrixTransformToParent( icpTransform.GetMatrix() )
+    outputTransform.SetMatrixTransformToParent( registration.GetSourceToTargetMatrix() )
 
     return True
 
 
+  def ComputeDistanceStatistics(self, inputFiducials, inputModel, transform ):
+    """Computes the distances of the transformed fiducials from the model surface.
+    Returns False if the distances cannot be computed."""
+    fiducialsPolyData = vtk.vtkPolyData()
+    self.FiducialsToPolyData(inputFiducials, fiducialsPolyData)
+
+    registration = self.pointToSurfaceRegistration
+    registration.SetSourcePoints( fiducialsPolyData.GetPoints() )
+    registration.SetTargetSurface( inputModel.GetPolyData() )
+
+    sourceToTargetMatrix = vtk.vtkMatrix4x4()
+    transform.GetMatrixTransformToParent( sourceToTargetMatrix )
+    return registration.ComputeDistanceStatistics( sourceToTargetMatrix )
+
+
   def ComputeMeanDistance(self, inputFiducials, inputModel, transform ):
-    surfacePoints = vtk.vtkPoints()
-    cellId = vtk.mutable(0)
-    subId = vtk.mutable(0)
-    dist2 = vtk.mutable(0.0)
-    locator = vtk.vtkCellLocator()
-    locator.SetDataSet( inputModel.GetPolyData() )
-    locator.SetNumberOfCellsPerBucket( 1 )
-    locator.BuildLocator()
-    totalDistance = 0.0
-
-    n = inputFiducials.GetNumberOfFiducials()
-    m = vtk.vtkMath()
-    for fiducialIndex in range( 0, n ):
-      originalPoint = [0, 0, 0]
-      inputFiducials.GetNthFiducialPosition( fiducialIndex, originalPoint )
-      transformedPoint = [0, 0, 0, 1]
-      #transform.GetTransformToParent().TransformVector( originalPoint, transformedPoint )
-      originalPoint.append(1)
-      transform.GetTransformToParent().MultiplyPoint( originalPoint, transformedPoint )      
-      #transformedPoints.InsertNextPoint( transformedPoint )
-      surfacePoint = [0, 0, 0]
-      transformedPoint.pop()
-      locator.FindClosestPoint( transformedPoint, surfacePoint, cellId, subId, dist2 )
-      totalDistance = totalDistance + math.sqrt(dist2)
-
-    return ( totalDistance / n )
+    if not self.ComputeDistanceStatistics( inputFiducials, inputModel, transform ):
+      return 0.0
+    return self.pointToSurfaceRegistration.GetMeanDistance()
+
+
+  def ComputeFiducialDistances(self, inputFiducials, inputModel, transform ):
+    """Returns the distance of each transformed fiducial from the model surface"""
+    # a mean distance of 0.0 is a valid result, so the success of the computation is checked instead
+    if not self.ComputeDistanceStatistics( inputFiducials, inputModel, transform ):
+      return []
+    distances = self.pointToSurfaceRegistration.GetPointDistances()
+    return [ distances.GetValue( fiducialIndex ) for fiducialIndex in range( distances.GetNumberOfTuples() ) ]
 
 
   def FiducialsToPolyData(self, fiducials, polyData):
@@ -38,8 +38,20 @@ class Guidelet(object):
       logging.debug("Timeout. Command Id: {0}".format(commandId))
 
   @staticmethod
-  def showUltrasoundIn3dView(show):
+  def showUltrasoundIn3dView(show, liveUltrasoundNode=None):
     redNode = slicer.mrmlScene.GetNodeByID('vtkMRMLSliceNodeRed')
+    # If the live image node is known then it is shown on a live image plane, which does not reslice
+    # and re-upload the image for each frame, unlike the red slice in 3D
+    snapshotsLogic = None
+    if liveUltrasoundNode is not None and hasattr(slicer.modules, 'ultrasoundsnapshots'):
+      snapshotsLogic = slicer.modules.ultrasoundsnapshots.logic()
+    if snapshotsLogic:
+      redNode.SetSliceVisible(0)
+      if show:
+        snapshotsLogic.ShowLiveImagePlane(liveUltrasoundNode)
+      else:
+        snapshotsLogic.HideLiveImagePlane()
+      return
     if show:
       redNode.SetSliceVisible(1)
     else:
@@ -574,35 +586,36 @@ class Guidelet(object):
   def onViewSelect(self, layoutIndex):
     text = self.viewSelectorComboBox.currentText
     logging.debug('onViewSelect: {0}'.format(text))
+    liveUltrasoundNode = getattr(self.ultrasound, 'liveUltrasoundNode_Reference', None)
     if text == self.VIEW_ULTRASOUND:
       self.layoutManager.setLayout(slicer.vtkMRMLLayoutNode.SlicerLayoutOneUpRedSliceView)
       self.delayedFitUltrasoundImageToView()
-      self.showUltrasoundIn3dView(False)
+      self.showUltrasoundIn3dView(False, liveUltrasoundNode)
     elif text == self.VIEW_ULTRASOUND_3D:
       self.layoutManager.setLayout(self.red3dCustomLayoutId)
       self.delayedFitUltrasoundImageToView()
-      self.showUltrasoundIn3dView(True)
+      self.showUltrasoundIn3dView(True, liveUltrasoundNode)
     elif text == self.VIEW_ULTRASOUND_DUAL_3D:
       self.layoutManager.setLayout(self.redDual3dCustomLayoutId)
       self.delayedFitUltrasoundImageToView()
-      self.showUltrasoundIn3dView(True)
+      self.showUltrasoundIn3dView(True, liveUltrasoundNode)
     elif text == self.VIEW_3D:
       self.layoutManager.setLayout(slicer.vtkMRMLLayoutNode.SlicerLayoutOneUp3DView)
-      self.showUltrasoundIn3dView(True)
+      self.showUltrasoundIn3dView(True, liveUltrasoundNode)
     elif text == self.VIEW_DUAL_3D:
       self.layoutManager.setLayout(self.dual3dCustomLayoutId)
-      self.showUltrasoundIn3dView(False)
+      self.showUltrasoundIn3dView(False, liveUltrasoundNode)
     elif text == self.VIEW_TRIPLE_3D:
       self.layoutManager.setLayout(self.triple3dCustomLayoutId)
-      self.showUltrasoundIn3dView(False)
+      self.showUltrasoundIn3dView(False, liveUltrasoundNode)
     elif text == self.VIEW_ULTRASOUND_CAM_3D:
       self.layoutManager.setLayout(self.redyellow3dCustomLayoutId)
       self.delayedFitUltrasoundImageToView()
-      self.showUltrasoundIn3dView(True)
+      self.showUltrasoundIn3dView(True, liveUltrasoundNode)
     elif text == self.VIEW_3D_ULTRASOUND:
       self.layoutManager.setLayout(self.threedultrasoundCustomLayoutId)
       self.delayedFitUltrasoundImageToView()
-      self.showUltrasoundIn3dView(True)
+      self.showUltrasoundIn3dView(True, liveUltrasoundNode)
 
   def onUltrasoundPanelToggled(self, toggled):
     logging.debug('onUltrasoundPanelToggled: {0}'.format(toggled))
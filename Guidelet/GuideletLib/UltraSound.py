@@ -10,6 +10,7 @@ class UltraSound(object):
     self.guideletParent = guideletParent
     self.captureDeviceName = self.guideletParent.parameterNode.GetParameter('PLUSCaptureDeviceName')
     self.referenceToRas = None
+    self.localRecorder = None
 
     try:
       slicer.modules.plusremote
@@ -233,14 +234,52 @@ class UltraSound(object):
     self.startStopRecordingButton.setToolTip(statusTextUser)
 
   def cleanup(self):
+    if self.localRecorder and self.localRecorder.IsRecording():
+      self.stopLocalRecording()
     self.disconnect()
 
+  def isLocalRecordingEnabled(self):
+    return self.guideletParent.parameterNode.GetParameter('RecordingMode') == 'Local'
+
+  def startLocalRecording(self):
+    # Frames and poses are recorded in Slicer as they are received through the connector node,
+    # so the recording does not depend on the Plus server responding to commands.
+    # Copying a frame does not block the UI, compression and writing are done on a background thread.
+    if not self.localRecorder:
+      self.localRecorder = slicer.vtkImageStreamRecorder()
+    self.localRecorder.SetImageNode(self.liveUltrasoundNode_Reference)
+    recordDirectory = self.guideletParent.parameterNode.GetParameter('SavedScenesDirectory')
+    if not os.access(recordDirectory, os.F_OK):
+      os.makedirs(recordDirectory)
+    recordPrefix = self.guideletParent.parameterNode.GetParameter('RecordingFilenamePrefix')
+    self.recordingFileName = os.path.join(recordDirectory, recordPrefix + time.strftime("%Y%m%d-%H%M%S") + '.mhd')
+    logging.info("Starting local recording to: {0}".format(self.recordingFileName))
+    if self.localRecorder.StartRecording(self.recordingFileName):
+      self.startStopRecordingButton.setToolTip("Recording to {0}".format(self.recordingFileName))
+    else:
+      logging.error("Failed to start local recording to: {0}".format(self.recordingFileName))
+      self.startStopRecordingButton.setToolTip("Failed to start recording")
+
+  def stopLocalRecording(self):
+    if not self.localRecorder or not self.localRecorder.IsRecording():
+      return
+    success = self.localRecorder.StopRecording()
+    statusText = "Recorded {0} frames to {1}, {2} frames dropped".format(self.localRecorder.GetNumberOfRecordedFrames(),
+      self.recordingFileName, self.localRecorder.GetNumberOfDroppedFrames())
+    if success:
+      logging.info(statusText)
+    else:
+      logging.error("Local recording failed. " + statusText)
+    self.startStopRecordingButton.setToolTip(statusText)
+
   def onStartStopRecordingClicked(self):
     if self.startStopRecordingButton.isChecked():
       self.startStopRecordingButton.setText("  Stop Recording")
       self.startStopRecordingButton.setIcon(self.stopIcon)
       self.startStopRecordingButton.setToolTip("Recording is being started...")
-      if self.captureDeviceName  != '':
+      if self.isLocalRecordingEnabled():
+        self.startLocalRecording()
+      elif self.captureDeviceName  != '':
         # Important to save as .mhd because that does not require lengthy finalization (merging into a single file)
         recordPrefix = self.guideletParent.parameterNode.GetParameter('RecordingFilenamePrefix')
         recordExt = self.guideletParent.parameterNode.GetParameter('RecordingFilenameExtension')
@@ -256,7 +295,9 @@ class UltraSound(object):
       self.startStopRecordingButton.setText("  Start Recording")
       self.startStopRecordingButton.setIcon(self.recordIcon)
       self.startStopRecordingButton.setToolTip( "Recording is being stopped..." )
-      if self.captureDeviceName  != '':  
+      if self.isLocalRecordingEnabled():
+        self.stopLocalRecording()
+      elif self.captureDeviceName  != '':  
         logging.info("Stopping recording")  
         self.plusRemoteLogic.cmdStopRecording.SetCommandAttribute('CaptureDeviceId', self.captureDeviceName)
         self.guideletParent.executeCommand(self.plusRemoteLogic.cmdStopRecording, self.recordingCommandCompleted)
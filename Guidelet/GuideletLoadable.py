@@ -197,6 +197,7 @@ class GuideletLogic(ScriptedLoadableModuleLogic):
                    'SavedScenesDirectory' : defaultSavePath,
                    'UltrasoundBrightnessControl' : 'Buttons',
                    'RecordingEnabledWhenConnectorNodeDisconnected' : 'False',
+                   'RecordingMode' : 'Remote', # 'Remote': Plus server records, 'Local': Slicer records the received frames into SavedScenesDirectory
                    'PLUSCaptureDeviceName' : 'CaptureDevice', # If '', no PLUS recordings are saved.
                    'HasBorderInFullScreen' : 'False', # If True, allows certain Qt widgets to appear properly with Qt versions >= 5.
                    }
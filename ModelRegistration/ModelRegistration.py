@@ -13,7 +13,7 @@ class ModelRegistration(ScriptedLoadableModule):
     ScriptedLoadableModule.__init__(self, parent)
     self.parent.title = "Model Registration"
     self.parent.categories = ["IGT"]
-    self.parent.dependencies = []
+    self.parent.dependencies = ["FiducialRegistrationWizard"]
     self.parent.contributors = ["Andras Lasso, Tamas Ungi (PerkLab, Queen's University"]
     self.parent.helpText = """
     This module applies Iterative Closest Points registration between two surface models.
@@ -138,7 +138,36 @@ class ModelRegistrationWidget(ScriptedLoadableModuleWidget):
     self.iterationSpin = qt.QSpinBox()
     self.iterationSpin.setMaximum( 1000 )
     self.iterationSpin.setValue( 100 )
-    advancedFormLayout.addRow("Number of iterations:", self.iterationSpin)
+    self.iterationSpin.setToolTip( "Maximum number of iterations at each resolution level." )
+    advancedFormLayout.addRow("Maximum number of iterations:", self.iterationSpin)
+
+    #
+    # Resolution levels selector
+    #
+    self.resolutionLevelsSpin = qt.QSpinBox()
+    self.resolutionLevelsSpin.setMinimum( 1 )
+    self.resolutionLevelsSpin.setMaximum( 5 )
+    self.resolutionLevelsSpin.setValue( 3 )
+    self.resolutionLevelsSpin.setToolTip( "Registration starts on a random subset of the moving model points and is refined on larger subsets. Each level uses four times more points than the previous one, the last level uses all points." )
+    advancedFormLayout.addRow("Resolution levels:", self.resolutionLevelsSpin)
+
+    #
+    # Convergence tolerance selector
+    #
+    self.convergenceToleranceSpin = qt.QDoubleSpinBox()
+    self.convergenceToleranceSpin.setDecimals( 4 )
+    self.convergenceToleranceSpin.setMinimum( 0.0 )
+    self.convergenceToleranceSpin.setMaximum( 10.0 )
+    self.convergenceToleranceSpin.setSingleStep( 0.001 )
+    self.convergenceToleranceSpin.setValue( 0.001 )
+    self.convergenceToleranceSpin.setSuffix( " mm" )
+    self.convergenceToleranceSpin.setToolTip( "Iterations at a resolution level stop when the moving model is moved less than this distance. If 0 then the maximum number of iterations is performed." )
+    advancedFormLayout.addRow("Convergence tolerance:", self.convergenceToleranceSpin)
+
+    self.globalInitializationCheckBox = qt.QCheckBox()
+    self.globalInitializationCheckBox.checked = False
+    self.globalInitializationCheckBox.setToolTip( "Try many initial orientations of the moving model (aligned by principal axes) and refine the best few. Use when the models are not roughly aligned before registration." )
+    advancedFormLayout.addRow("Global initialization:", self.globalInitializationCheckBox)
 
     # connections
     self.applyButton.connect('clicked(bool)', self.onApplyButton)
@@ -149,6 +178,9 @@ class ModelRegistrationWidget(ScriptedLoadableModuleWidget):
     # Add vertical spacer
     self.layout.addStretch(1)
 
+    # Logic is kept, so that the target surface locators are not rebuilt for each registration
+    self.logic = ModelRegistrationLogic()
+
 
   def cleanup(self):
     pass
@@ -157,13 +189,14 @@ class ModelRegistrationWidget(ScriptedLoadableModuleWidget):
     self.applyButton.enabled = self.inputTargetModelSelector.currentNode() and self.outputSourceToTargetTransformSelector.currentNode() and self.inputSourceModelSelector.currentNode()
 
   def onApplyButton(self):
-    logic = ModelRegistrationLogic()
+    logic = self.logic
 
     inputSourceModel = self.inputSourceModelSelector.currentNode()
     inputTargetModel = self.inputTargetModelSelector.currentNode()
     outputSourceToTargetTransform = self.outputSourceToTargetTransformSelector.currentNode()
 
-    logic.run(inputSourceModel, inputTargetModel, outputSourceToTargetTransform, self.typeSelector.currentIndex, self.iterationSpin.value )
+    logic.run(inputSourceModel, inputTargetModel, outputSourceToTargetTransform, self.typeSelector.currentIndex, self.iterationSpin.value,
+      self.resolutionLevelsSpin.value, self.convergenceToleranceSpin.value, self.globalInitializationCheckBox.checked )
 
     self.outputLine.setText( logic.ComputeMeanDistance(inputSourceModel, inputTargetModel, outputSourceToTargetTransform) )
 
@@ -179,58 +212,47 @@ class ModelRegistrationLogic(ScriptedLoadableModuleLogic):
   requiring an instance of the Widget
   """
 
-  def run(self, inputSourceModel, inputTargetModel, outputSourceToTargetTransform, transformType=0, numIterations=100 ):
+  def __init__(self, parent = None):
+    ScriptedLoadableModuleLogic.__init__(self, parent)
+    # Registration engine keeps the target surface locators between calls
+    self.pointToSurfaceRegistration = slicer.vtkPointToSurfaceRegistration()
+
+  def run(self, inputSourceModel, inputTargetModel, outputSourceToTargetTransform, transformType=0, numIterations=100,
+    numResolutionLevels=1, convergenceTolerance=0.001, globalInitialization=False ):
 
     self.delayDisplay('Running iterative closest point registration')
 
-    icpTransform = vtk.vtkIterativeClosestPointTransform()
-    icpTransform.SetSource( inputSourceModel.GetPolyData() )
-    icpTransform.SetTarget( inputTargetModel.GetPolyData() )
-    icpTransform.GetLandmarkTransform().SetModeToRigidBody()
+    registration = self.pointToSurfaceRegistration
+    registration.SetSourcePoints( inputSourceModel.GetPolyData().GetPoints() )
+    registration.SetTargetSurface( inputTargetModel.GetPolyData() )
+    registration.SetModeToRigidBody()
     if transformType == 1:
-      icpTransform.GetLandmarkTransform().SetModeToSimilarity()
+      registration.SetModeToSimilarity()
     if transformType == 2:
-      icpTransform.GetLandmarkTransform().SetModeToAffine()
-    icpTransform.SetMaximumNumberOfIterations( numIterations )
-    icpTransform.Modified()
-    icpTransform.Update()
+      registration.SetModeToAffine()
+    registration.SetMaximumNumberOfIterations( numIterations )
+    registration.SetNumberOfResolutionLevels( numResolutionLevels )
+    registration.SetConvergenceTolerance( convergenceTolerance )
+    registration.SetUseGlobalInitialization( globalInitialization )
+    if not registration.Update():
+      return False
 
-    outputSourceToTargetTransform.SetMatrixTransformToParent( icpTransform.GetMatrix() )
+    outputSourceToTargetTransform.SetMatrixTransformToParent( registration.GetSourceToTargetMatrix() )
 
     return True
 
 
   def ComputeMeanDistance(self, inputSourceModel, inputTargetModel, transform ):
-    sourcePolyData = inputSourceModel.GetPolyData()
-    targetPolyData = inputTargetModel.GetPolyData()
-
-    cellId = vtk.mutable(0)
-    subId = vtk.mutable(0)
-    dist2 = vtk.mutable(0.0)
-    locator = vtk.vtkCellLocator()
-    locator.SetDataSet( targetPolyData )
-    locator.SetNumberOfCellsPerBucket( 1 )
-    locator.BuildLocator()
-    
-    totalDistance = 0.0
-
-    sourcePoints = sourcePolyData.GetPoints()
-    n = sourcePoints.GetNumberOfPoints()
-    m = vtk.vtkMath()
-    for sourcePointIndex in xrange(n):
-      sourcePointPos = [0, 0, 0]
-      sourcePoints.GetPoint( sourcePointIndex, sourcePointPos )
-      transformedSourcePointPos = [0, 0, 0, 1]
-      #transform.GetTransformToParent().TransformVector( sourcePointPos, transformedSourcePointPos )
-      sourcePointPos.append(1)
-      transform.GetTransformToParent().MultiplyPoint( sourcePointPos, transformedSourcePointPos )      
-      #transformedPoints.InsertNextPoint( transformedSourcePointPos )
-      surfacePoint = [0, 0, 0]
-      transformedSourcePointPos.pop()
-      locator.FindClosestPoint( transformedSourcePointPos, surfacePoint, cellId, subId, dist2 )
-      totalDistance = totalDistance + math.sqrt(dist2)
-
-    return ( totalDistance / n )
+    registration = self.pointToSurfaceRegistration
+    registration.SetSourcePoints( inputSourceModel.GetPolyData().GetPoints() )
+    registration.SetTargetSurface( inputTargetModel.GetPolyData() )
+
+    sourceToTargetMatrix = vtk.vtkMatrix4x4()
+    transform.GetMatrixTransformToParent( sourceToTargetMatrix )
+    if not registration.ComputeDistanceStatistics( sourceToTargetMatrix ):
+      return 0.0
+
+    return registration.GetMeanDistance()
 
 class ModelRegistrationTest(ScriptedLoadableModuleTest):
   """
@@ -18,15 +18,67 @@
 // PathExplorer Logic includes
 #include "vtkSlicerPathExplorerLogic.h"
 
+#include "vtkTrajectorySpatialIndex.h"
+#include "vtkTriangleBoundingVolumeHierarchy.h"
+
 // MRML includes
+#include "vtkMRMLAnnotationRulerNode.h"
+#include "vtkMRMLMarkupsFiducialNode.h"
+#include "vtkMRMLModelNode.h"
 #include "vtkMRMLPathPlannerTrajectoryNode.h"
+#include "vtkMRMLPathPlannerTrajectorySetNode.h"
+#include "vtkMRMLPathPlannerTrajectorySetStorageNode.h"
+#include "vtkMRMLSliceNode.h"
+#include "vtkMRMLTransformNode.h"
 
 // VTK includes
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
+#include <vtkGeneralTransform.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkStringArray.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Trajectories and results of a clearance computation, shared between the worker threads.
+// Each thread computes a contiguous range of the entry/target pairs.
+struct TrajectoryClearanceJob
+{
+  vtkTriangleBoundingVolumeHierarchy* CriticalStructures;
+  std::vector<double> EntryPoints;
+  std::vector<double> TargetPoints;
+  std::vector<double> Clearances;
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE ComputeTrajectoryClearancesThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  TrajectoryClearanceJob* job = static_cast<TrajectoryClearanceJob*>(threadInfo->UserData);
+  int numberOfTargets = static_cast<int>(job->TargetPoints.size() / 3);
+  int numberOfPairs = static_cast<int>(job->Clearances.size());
+  int firstPair = numberOfPairs * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int lastPair = numberOfPairs * (threadInfo->ThreadID + 1) / threadInfo->NumberOfThreads;
+  for (int pairIndex = firstPair; pairIndex < lastPair; ++pairIndex)
+    {
+    const double* entry = &job->EntryPoints[3 * (pairIndex / numberOfTargets)];
+    const double* target = &job->TargetPoints[3 * (pairIndex % numberOfTargets)];
+    job->Clearances[pairIndex] = job->CriticalStructures->ComputeSegmentDistance(entry, target);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerPathExplorerLogic);
@@ -34,6 +86,7 @@ vtkStandardNewMacro(vtkSlicerPathExplorerLogic);
 //----------------------------------------------------------------------------
 vtkSlicerPathExplorerLogic::vtkSlicerPathExplorerLogic()
 {
+  this->TrajectoryIndex = vtkSmartPointer<vtkTrajectorySpatialIndex>::New();
 }
 
 //----------------------------------------------------------------------------
@@ -65,23 +118,456 @@ void vtkSlicerPathExplorerLogic::RegisterNodes()
   vtkSmartPointer<vtkMRMLPathPlannerTrajectoryNode> trajectoryNode
     = vtkSmartPointer<vtkMRMLPathPlannerTrajectoryNode>::New();
   this->GetMRMLScene()->RegisterNodeClass(trajectoryNode.GetPointer());
+
+  vtkNew<vtkMRMLPathPlannerTrajectorySetNode> trajectorySetNode;
+  this->GetMRMLScene()->RegisterNodeClass(trajectorySetNode.GetPointer());
+  vtkNew<vtkMRMLPathPlannerTrajectorySetStorageNode> trajectorySetStorageNode;
+  this->GetMRMLScene()->RegisterNodeClass(trajectorySetStorageNode.GetPointer());
+}
+
+//---------------------------------------------------------------------------
+vtkTrajectorySpatialIndex* vtkSlicerPathExplorerLogic::GetTrajectoryIndex()
+{
+  return this->TrajectoryIndex;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::FindTrajectoriesNearPoint(const double point[3], double distance, vtkCollection* foundRulerNodes)
+{
+  if (!foundRulerNodes)
+    {
+    vtkErrorMacro("FindTrajectoriesNearPoint: Invalid output collection");
+    return;
+    }
+  foundRulerNodes->RemoveAllItems();
+  if (!this->GetMRMLScene())
+    {
+    return;
+    }
+
+  vtkNew<vtkStringArray> rulerNodeIds;
+  this->TrajectoryIndex->FindTrajectoriesWithinDistance(point, distance, rulerNodeIds.GetPointer());
+  for (vtkIdType i = 0; i < rulerNodeIds->GetNumberOfValues(); ++i)
+    {
+    vtkMRMLNode* rulerNode = this->GetMRMLScene()->GetNodeByID(rulerNodeIds->GetValue(i).c_str());
+    if (rulerNode)
+      {
+      foundRulerNodes->AddItem(rulerNode);
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::UpdateTrajectoryInIndex(vtkMRMLAnnotationRulerNode* rulerNode)
+{
+  if (!rulerNode || !rulerNode->GetID())
+    {
+    return;
+    }
+  double entry[3] = {0.0, 0.0, 0.0};
+  double target[3] = {0.0, 0.0, 0.0};
+  rulerNode->GetPosition1(entry);
+  rulerNode->GetPosition2(target);
+  this->TrajectoryIndex->SetTrajectory(rulerNode->GetID(), entry, target);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::ComputeTrajectoryClearances(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+  vtkCollection* criticalStructureModelNodes, vtkDoubleArray* clearances)
+{
+  if (!entryNode || !targetNode || !criticalStructureModelNodes || !clearances)
+    {
+    vtkErrorMacro("ComputeTrajectoryClearances: Invalid input or output");
+    return;
+    }
+
+  // One hierarchy of all critical structures, in RAS coordinate system
+  vtkNew<vtkTriangleBoundingVolumeHierarchy> criticalStructures;
+  for (int i = 0; i < criticalStructureModelNodes->GetNumberOfItems(); ++i)
+    {
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(criticalStructureModelNodes->GetItemAsObject(i));
+    if (!modelNode || !modelNode->GetPolyData())
+      {
+      vtkWarningMacro("ComputeTrajectoryClearances: Critical structure " << i << " is not a valid model, ignored");
+      continue;
+      }
+    vtkSmartPointer<vtkGeneralTransform> modelToRasTransform;
+    if (modelNode->GetParentTransformNode())
+      {
+      modelToRasTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+      modelNode->GetParentTransformNode()->GetTransformToWorld(modelToRasTransform);
+      }
+    criticalStructures->AddSurface(modelNode->GetPolyData(), modelToRasTransform);
+    }
+  criticalStructures->Build();
+
+  // Markup positions are used in the same coordinate system as trajectory rulers are created from them
+  TrajectoryClearanceJob job;
+  job.CriticalStructures = criticalStructures.GetPointer();
+  int numberOfEntries = entryNode->GetNumberOfMarkups();
+  int numberOfTargets = targetNode->GetNumberOfMarkups();
+  job.EntryPoints.resize(3 * numberOfEntries);
+  for (int i = 0; i < numberOfEntries; ++i)
+    {
+    entryNode->GetNthFiducialPosition(i, &job.EntryPoints[3 * i]);
+    }
+  job.TargetPoints.resize(3 * numberOfTargets);
+  for (int i = 0; i < numberOfTargets; ++i)
+    {
+    targetNode->GetNthFiducialPosition(i, &job.TargetPoints[3 * i]);
+    }
+  job.Clearances.resize(numberOfEntries * numberOfTargets, VTK_DOUBLE_MAX);
+
+  if (!job.Clearances.empty())
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(std::min(threader->GetNumberOfThreads(), static_cast<int>(job.Clearances.size())));
+    threader->SetSingleMethod(ComputeTrajectoryClearancesThreadFunction, &job);
+    threader->SingleMethodExecute();
+    }
+
+  clearances->SetNumberOfComponents(1);
+  clearances->SetNumberOfTuples(static_cast<vtkIdType>(job.Clearances.size()));
+  for (vtkIdType i = 0; i < static_cast<vtkIdType>(job.Clearances.size()); ++i)
+    {
+    clearances->SetValue(i, job.Clearances[i]);
+    }
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerPathExplorerLogic::CreateBestTrajectories(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+  vtkCollection* criticalStructureModelNodes, int numberOfTrajectories)
+{
+  if (!this->GetMRMLScene() || !entryNode || !targetNode || numberOfTrajectories <= 0)
+    {
+    vtkErrorMacro("CreateBestTrajectories: Invalid scene or input");
+    return 0;
+    }
+
+  vtkNew<vtkDoubleArray> clearances;
+  this->ComputeTrajectoryClearances(entryNode, targetNode, criticalStructureModelNodes, clearances.GetPointer());
+
+  // Only the best trajectories are sorted
+  std::vector< std::pair<double, int> > rankedTrajectories;
+  rankedTrajectories.reserve(clearances->GetNumberOfTuples());
+  for (vtkIdType i = 0; i < clearances->GetNumberOfTuples(); ++i)
+    {
+    rankedTrajectories.push_back(std::make_pair(clearances->GetValue(i), static_cast<int>(i)));
+    }
+  numberOfTrajectories = std::min(numberOfTrajectories, static_cast<int>(rankedTrajectories.size()));
+  std::partial_sort(rankedTrajectories.begin(), rankedTrajectories.begin() + numberOfTrajectories,
+    rankedTrajectories.end(), std::greater< std::pair<double, int> >());
+
+  int numberOfTargets = targetNode->GetNumberOfMarkups();
+  this->GetMRMLScene()->StartState(vtkMRMLScene::BatchProcessState);
+  for (int i = 0; i < numberOfTrajectories; ++i)
+    {
+    int entryIndex = rankedTrajectories[i].second / numberOfTargets;
+    int targetIndex = rankedTrajectories[i].second % numberOfTargets;
+    double entryPosition[3] = {0.0, 0.0, 0.0};
+    entryNode->GetNthFiducialPosition(entryIndex, entryPosition);
+    double targetPosition[3] = {0.0, 0.0, 0.0};
+    targetNode->GetNthFiducialPosition(targetIndex, targetPosition);
+
+    vtkNew<vtkMRMLAnnotationRulerNode> ruler;
+    std::string rulerName = entryNode->GetNthMarkupLabel(entryIndex) + "-" + targetNode->GetNthMarkupLabel(targetIndex);
+    ruler->SetName(rulerName.c_str());
+    ruler->SetPosition1(entryPosition);
+    ruler->SetPosition2(targetPosition);
+    std::ostringstream clearance;
+    clearance << rankedTrajectories[i].first;
+    ruler->SetAttribute("PathExplorer.Clearance", clearance.str().c_str());
+    ruler->Initialize(this->GetMRMLScene());
+    }
+  this->GetMRMLScene()->EndState(vtkMRMLScene::BatchProcessState);
+
+  return numberOfTrajectories;
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerPathExplorerLogic::CreateTrajectorySet(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+  vtkCollection* criticalStructureModelNodes, vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode)
+{
+  if (!entryNode || !targetNode || !trajectorySetNode)
+    {
+    vtkErrorMacro("CreateTrajectorySet: Invalid input or output");
+    return 0;
+    }
+
+  vtkNew<vtkDoubleArray> clearanceArray;
+  if (criticalStructureModelNodes)
+    {
+    this->ComputeTrajectoryClearances(entryNode, targetNode, criticalStructureModelNodes, clearanceArray.GetPointer());
+    }
+
+  int numberOfEntries = entryNode->GetNumberOfMarkups();
+  int numberOfTargets = targetNode->GetNumberOfMarkups();
+  int numberOfTrajectories = numberOfEntries * numberOfTargets;
+  std::vector<double> entryPositions(3 * numberOfTrajectories);
+  std::vector<double> targetPositions(3 * numberOfTrajectories);
+  std::vector<std::string> names(numberOfTrajectories);
+  std::vector<double> clearances(numberOfTrajectories, VTK_DOUBLE_MAX);
+  for (int entryIndex = 0; entryIndex < numberOfEntries; ++entryIndex)
+    {
+    double entryPosition[3] = {0.0, 0.0, 0.0};
+    entryNode->GetNthFiducialPosition(entryIndex, entryPosition);
+    std::string entryLabel = entryNode->GetNthMarkupLabel(entryIndex);
+    for (int targetIndex = 0; targetIndex < numberOfTargets; ++targetIndex)
+      {
+      // Same order as the clearances of ComputeTrajectoryClearances
+      int trajectoryIndex = entryIndex * numberOfTargets + targetIndex;
+      std::copy(entryPosition, entryPosition + 3, entryPositions.begin() + 3 * trajectoryIndex);
+      targetNode->GetNthFiducialPosition(targetIndex, &targetPositions[3 * trajectoryIndex]);
+      names[trajectoryIndex] = entryLabel + "-" + targetNode->GetNthMarkupLabel(targetIndex);
+      if (trajectoryIndex < clearanceArray->GetNumberOfTuples())
+        {
+        clearances[trajectoryIndex] = clearanceArray->GetValue(trajectoryIndex);
+        }
+      }
+    }
+
+  trajectorySetNode->SetTrajectories(entryPositions, targetPositions, names, clearances);
+  return numberOfTrajectories;
+}
+
+//---------------------------------------------------------------------------
+vtkMRMLAnnotationRulerNode* vtkSlicerPathExplorerLogic::CreateTrajectoryRuler(vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode,
+  int trajectoryIndex)
+{
+  if (!this->GetMRMLScene() || !trajectorySetNode || !trajectorySetNode->GetID()
+    || trajectoryIndex < 0 || trajectoryIndex >= trajectorySetNode->GetNumberOfTrajectories())
+    {
+    vtkErrorMacro("CreateTrajectoryRuler: Invalid scene, trajectory set, or trajectory index");
+    return NULL;
+    }
+
+  std::ostringstream trajectoryIndexString;
+  trajectoryIndexString << trajectoryIndex;
+
+  // Reuse the ruler if the trajectory is selected again
+  std::vector<vtkMRMLNode*> rulerNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLAnnotationRulerNode", rulerNodes);
+  for (std::vector<vtkMRMLNode*>::iterator rulerNodeIt = rulerNodes.begin(); rulerNodeIt != rulerNodes.end(); ++rulerNodeIt)
+    {
+    const char* setNodeId = (*rulerNodeIt)->GetAttribute("PathExplorer.TrajectorySetNodeID");
+    const char* index = (*rulerNodeIt)->GetAttribute("PathExplorer.TrajectoryIndex");
+    if (setNodeId && index && trajectoryIndexString.str() == index && strcmp(setNodeId, trajectorySetNode->GetID()) == 0)
+      {
+      return vtkMRMLAnnotationRulerNode::SafeDownCast(*rulerNodeIt);
+      }
+    }
+
+  double entryPosition[3] = {0.0, 0.0, 0.0};
+  double targetPosition[3] = {0.0, 0.0, 0.0};
+  trajectorySetNode->GetEntryPosition(trajectoryIndex, entryPosition);
+  trajectorySetNode->GetTargetPosition(trajectoryIndex, targetPosition);
+
+  vtkNew<vtkMRMLAnnotationRulerNode> ruler;
+  ruler->SetName(trajectorySetNode->GetTrajectoryName(trajectoryIndex));
+  ruler->SetPosition1(entryPosition);
+  ruler->SetPosition2(targetPosition);
+  ruler->SetAttribute("PathExplorer.TrajectorySetNodeID", trajectorySetNode->GetID());
+  ruler->SetAttribute("PathExplorer.TrajectoryIndex", trajectoryIndexString.str().c_str());
+  std::ostringstream clearance;
+  clearance << trajectorySetNode->GetClearance(trajectoryIndex);
+  ruler->SetAttribute("PathExplorer.Clearance", clearance.str().c_str());
+  ruler->Initialize(this->GetMRMLScene());
+  return ruler.GetPointer();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::ComputeResliceMatrix(const double entry[3], const double target[3], bool perpendicular, double resliceValue,
+  vtkMatrix4x4* sliceToRas)
+{
+  if (!sliceToRas)
+    {
+    return;
+    }
+
+  double trajectory[3] = {target[0] - entry[0], target[1] - entry[1], target[2] - entry[2]};
+  double normal[3] = {0.0, 0.0, 1.0};
+  double transverse[3] = {1.0, 0.0, 0.0};
+  double position[3] = {target[0], target[1], target[2]};
+  if (perpendicular)
+    {
+    // Trajectory is the slice normal, reslice at the chosen position
+    for (int i = 0; i < 3; ++i)
+      {
+      position[i] = entry[i] + trajectory[i] * resliceValue / 100.0;
+      normal[i] = trajectory[i];
+      }
+    if (vtkMath::Normalize(normal) == 0.0)
+      {
+      normal[0] = 0.0;
+      normal[1] = 0.0;
+      normal[2] = 1.0;
+      }
+    vtkMath::Perpendiculars(normal, transverse, NULL, 0);
+    }
+  else
+    {
+    // Trajectory is in the slice plane, the slice is rotated around it by the chosen angle
+    for (int i = 0; i < 3; ++i)
+      {
+      transverse[i] = trajectory[i];
+      }
+    if (vtkMath::Normalize(transverse) == 0.0)
+      {
+      transverse[0] = 1.0;
+      transverse[1] = 0.0;
+      transverse[2] = 0.0;
+      }
+    vtkMath::Perpendiculars(transverse, normal, NULL, vtkMath::RadiansFromDegrees(resliceValue));
+    }
+
+  // Same axes as vtkMRMLSliceNode::SetSliceToRASByNTP with axial orientation:
+  // slice X is the transverse vector, slice Z is the normal.
+  double sliceY[3] = {0.0, 0.0, 0.0};
+  vtkMath::Cross(normal, transverse, sliceY);
+  sliceToRas->Identity();
+  for (int i = 0; i < 3; ++i)
+    {
+    sliceToRas->SetElement(i, 0, transverse[i]);
+    sliceToRas->SetElement(i, 1, sliceY[i]);
+    sliceToRas->SetElement(i, 2, normal[i]);
+    sliceToRas->SetElement(i, 3, position[i]);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::ResliceAlongTrajectory(vtkMRMLAnnotationRulerNode* ruler, vtkMRMLSliceNode* sliceNode,
+  bool perpendicular, double resliceValue)
+{
+  if (!ruler || !sliceNode)
+    {
+    return;
+    }
+
+  double entry[4] = {0.0, 0.0, 0.0, 1.0};
+  double target[4] = {0.0, 0.0, 0.0, 1.0};
+  ruler->GetPositionWorldCoordinates1(entry);
+  ruler->GetPositionWorldCoordinates2(target);
+
+  vtkNew<vtkMatrix4x4> sliceToRas;
+  ComputeResliceMatrix(entry, target, perpendicular, resliceValue, sliceToRas.GetPointer());
+  SetSliceToRAS(sliceNode, sliceToRas.GetPointer());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic::SetSliceToRAS(vtkMRMLSliceNode* sliceNode, vtkMatrix4x4* sliceToRas)
+{
+  if (!sliceNode || !sliceToRas)
+    {
+    return;
+    }
+
+  vtkMatrix4x4* currentSliceToRas = sliceNode->GetSliceToRAS();
+  bool changed = false;
+  for (int row = 0; row < 3 && !changed; ++row)
+    {
+    for (int column = 0; column < 4; ++column)
+      {
+      if (currentSliceToRas->GetElement(row, column) != sliceToRas->GetElement(row, column))
+        {
+        changed = true;
+        break;
+        }
+      }
+    }
+  if (!changed)
+    {
+    return;
+    }
+  currentSliceToRas->DeepCopy(sliceToRas);
+  sliceNode->UpdateMatrices();
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerPathExplorerLogic::ComputeFlyThroughMatrices(vtkMRMLAnnotationRulerNode* ruler, double startPosition, double endPosition,
+  double frameSpacing, vtkCollection* sliceToRasMatrices)
+{
+  if (!ruler || !sliceToRasMatrices)
+    {
+    return 0;
+    }
+  sliceToRasMatrices->RemoveAllItems();
+  if (frameSpacing <= 0.0)
+    {
+    vtkGenericWarningMacro("ComputeFlyThroughMatrices: Frame spacing must be positive");
+    return 0;
+    }
+
+  double entry[4] = {0.0, 0.0, 0.0, 1.0};
+  double target[4] = {0.0, 0.0, 0.0, 1.0};
+  ruler->GetPositionWorldCoordinates1(entry);
+  ruler->GetPositionWorldCoordinates2(target);
+
+  double flyThroughLength = sqrt(vtkMath::Distance2BetweenPoints(entry, target)) * fabs(endPosition - startPosition) / 100.0;
+  int numberOfSteps = std::max(1, static_cast<int>(ceil(flyThroughLength / frameSpacing)));
+  for (int step = 0; step <= numberOfSteps; ++step)
+    {
+    double position = startPosition + (endPosition - startPosition) * step / numberOfSteps;
+    vtkNew<vtkMatrix4x4> sliceToRas;
+    ComputeResliceMatrix(entry, target, true, position, sliceToRas.GetPointer());
+    sliceToRasMatrices->AddItem(sliceToRas.GetPointer());
+    }
+  return numberOfSteps + 1;
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPathExplorerLogic::UpdateFromMRMLScene()
 {
   assert(this->GetMRMLScene() != 0);
+
+  // Index rulers that were added while the logic was not observing the scene
+  std::vector<vtkMRMLNode*> rulerNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLAnnotationRulerNode", rulerNodes);
+  for (std::vector<vtkMRMLNode*>::iterator rulerNodeIt = rulerNodes.begin(); rulerNodeIt != rulerNodes.end(); ++rulerNodeIt)
+    {
+    if (!this->TrajectoryIndex->HasTrajectory((*rulerNodeIt)->GetID()))
+      {
+      vtkObserveMRMLNodeMacro(*rulerNodeIt);
+      }
+    this->UpdateTrajectoryInIndex(vtkMRMLAnnotationRulerNode::SafeDownCast(*rulerNodeIt));
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPathExplorerLogic
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  vtkMRMLAnnotationRulerNode* rulerNode = vtkMRMLAnnotationRulerNode::SafeDownCast(node);
+  if (!rulerNode || this->TrajectoryIndex->HasTrajectory(rulerNode->GetID()))
+    {
+    return;
+    }
+  vtkObserveMRMLNodeMacro(rulerNode);
+  this->UpdateTrajectoryInIndex(rulerNode);
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPathExplorerLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
 {
+  vtkMRMLAnnotationRulerNode* rulerNode = vtkMRMLAnnotationRulerNode::SafeDownCast(node);
+  if (!rulerNode)
+    {
+    return;
+    }
+  vtkUnObserveMRMLNodeMacro(rulerNode);
+  this->TrajectoryIndex->RemoveTrajectory(rulerNode->GetID());
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPathExplorerLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData)
 {
+  vtkMRMLAnnotationRulerNode* rulerNode = vtkMRMLAnnotationRulerNode::SafeDownCast(caller);
+  if (rulerNode && event == vtkCommand::ModifiedEvent)
+    {
+    this->UpdateTrajectoryInIndex(rulerNode);
+    return;
+    }
+  this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
 }
 
@@ -30,11 +30,23 @@
 // MRML includes
 #include "vtkMRMLScene.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
 // STD includes
 #include <cstdlib>
 
 #include "vtkSlicerPathExplorerModuleLogicExport.h"
 
+class vtkCollection;
+class vtkDoubleArray;
+class vtkMatrix4x4;
+class vtkMRMLAnnotationRulerNode;
+class vtkMRMLMarkupsFiducialNode;
+class vtkMRMLPathPlannerTrajectorySetNode;
+class vtkMRMLSliceNode;
+class vtkTrajectorySpatialIndex;
+
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_PATHEXPLORER_MODULE_LOGIC_EXPORT vtkSlicerPathExplorerLogic :
@@ -46,14 +58,66 @@ public:
   vtkTypeMacro(vtkSlicerPathExplorerLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  // Spatial index of all ruler nodes in the scene, kept up to date when rulers are added, moved, or removed.
+  // Trajectories are identified by the ruler node ID.
+  vtkTrajectorySpatialIndex* GetTrajectoryIndex();
+
+  // Get all ruler nodes that pass within distance (in mm) of the point
+  void FindTrajectoriesNearPoint(const double point[3], double distance, vtkCollection* foundRulerNodes);
+
+  // Compute the clearance of all trajectories between the entry and target markups: the minimum distance between
+  // the straight trajectory and the surface of the critical structure models (0 if the trajectory crosses a surface).
+  // Trajectories are processed on multiple threads, using one bounding volume hierarchy of all the critical structures.
+  // Clearance of trajectory from entry i to target j is stored in clearances at index i * (number of targets) + j.
+  void ComputeTrajectoryClearances(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+    vtkCollection* criticalStructureModelNodes, vtkDoubleArray* clearances);
+
+  // Create ruler nodes for the numberOfTrajectories trajectories that have the largest clearance.
+  // The rulers are added to the scene in one batch (to the active annotation hierarchy),
+  // their clearance is stored in the "PathExplorer.Clearance" node attribute.
+  // Returns the number of created rulers.
+  int CreateBestTrajectories(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+    vtkCollection* criticalStructureModelNodes, int numberOfTrajectories);
+
+  // Store all trajectories between the entry and target markups, with their clearance, in the trajectory set node
+  // (replacing its previous trajectories). Unlike CreateBestTrajectories, no ruler nodes are created,
+  // therefore thousands of candidates can be kept in the scene; use CreateTrajectoryRuler for the selected ones.
+  // Returns the number of stored trajectories.
+  int CreateTrajectorySet(vtkMRMLMarkupsFiducialNode* entryNode, vtkMRMLMarkupsFiducialNode* targetNode,
+    vtkCollection* criticalStructureModelNodes, vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode);
+
+  // Create a ruler node for trajectory trajectoryIndex of the set (e.g., when the user selects it).
+  // If a ruler was already created for this trajectory then that ruler is returned.
+  // The ruler refers to the trajectory in the "PathExplorer.TrajectorySetNodeID" and "PathExplorer.TrajectoryIndex"
+  // node attributes, its clearance is stored in the "PathExplorer.Clearance" node attribute.
+  vtkMRMLAnnotationRulerNode* CreateTrajectoryRuler(vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode, int trajectoryIndex);
+
+  // Compute slice to RAS matrix for reslicing along the trajectory from entry to target.
+  // If perpendicular then the slice is perpendicular to the trajectory, at resliceValue percent
+  // of the distance from entry (0) to target (100). Otherwise the slice contains the trajectory,
+  // rotated around it by resliceValue degrees, centered at the target.
+  static void ComputeResliceMatrix(const double entry[3], const double target[3], bool perpendicular, double resliceValue,
+    vtkMatrix4x4* sliceToRas);
+
+  // Reslice the slice view along the ruler (see ComputeResliceMatrix).
+  // The slice node is only modified if the slice position or orientation is changed.
+  static void ResliceAlongTrajectory(vtkMRMLAnnotationRulerNode* ruler, vtkMRMLSliceNode* sliceNode, bool perpendicular, double resliceValue);
+
+  // Set the slice to RAS matrix of the slice node. The slice node is only modified if the matrix is changed.
+  static void SetSliceToRAS(vtkMRMLSliceNode* sliceNode, vtkMatrix4x4* sliceToRas);
+
+  // Compute perpendicular reslice matrices (vtkMatrix4x4) for flying through the ruler trajectory,
+  // from startPosition to endPosition (percent of the trajectory length, 0 = entry, 100 = target),
+  // with frames at most frameSpacing mm apart. Returns the number of frames.
+  static int ComputeFlyThroughMatrices(vtkMRMLAnnotationRulerNode* ruler, double startPosition, double endPosition,
+    double frameSpacing, vtkCollection* sliceToRasMatrices);
+
   // TODO: Add new entry
 
   // TODO: Add new target
 
   // TODO: Add new trajectory
 
-  // TODO: Reslice
-
 protected:
   vtkSlicerPathExplorerLogic();
   virtual ~vtkSlicerPathExplorerLogic();
@@ -64,7 +128,13 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData);
+
+  void UpdateTrajectoryInIndex(vtkMRMLAnnotationRulerNode* rulerNode);
+
 private:
+  vtkSmartPointer<vtkTrajectorySpatialIndex> TrajectoryIndex;
+
 
   vtkSlicerPathExplorerLogic(const vtkSlicerPathExplorerLogic&); // Not implemented
   void operator=(const vtkSlicerPathExplorerLogic&);               // Not implemented
@@ -0,0 +1,322 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkTrajectorySpatialIndex.h"
+
+// VTK includes
+#include <vtkLine.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkStringArray.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkTrajectorySpatialIndex);
+
+//----------------------------------------------------------------------------
+bool vtkTrajectorySpatialIndex::GridIndex::operator<(const GridIndex& other) const
+{
+  if (this->Index[0] != other.Index[0])
+    {
+    return this->Index[0] < other.Index[0];
+    }
+  if (this->Index[1] != other.Index[1])
+    {
+    return this->Index[1] < other.Index[1];
+    }
+  return this->Index[2] < other.Index[2];
+}
+
+//----------------------------------------------------------------------------
+vtkTrajectorySpatialIndex::vtkTrajectorySpatialIndex()
+: CellSize(10.0)
+, QueryIndex(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkTrajectorySpatialIndex::~vtkTrajectorySpatialIndex()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "CellSize: " << this->CellSize << std::endl;
+  os << indent << "NumberOfTrajectories: " << this->GetNumberOfTrajectories() << std::endl;
+  os << indent << "NumberOfCells: " << this->Cells.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::SetCellSize(double cellSize)
+{
+  if (cellSize <= 0.0)
+    {
+    vtkErrorMacro("SetCellSize: Cell size must be positive");
+    return;
+    }
+  if (cellSize == this->CellSize)
+    {
+    return;
+    }
+  this->CellSize = cellSize;
+
+  // Re-index all trajectories
+  this->Cells.clear();
+  for (int slot = 0; slot < static_cast<int>(this->Trajectories.size()); ++slot)
+    {
+    if (!this->Trajectories[slot].Cells.empty())
+      {
+      this->Trajectories[slot].Cells.clear();
+      this->AddToCells(slot);
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::SetTrajectory(const char* trajectoryId, const double entry[3], const double target[3])
+{
+  if (!trajectoryId)
+    {
+    vtkErrorMacro("SetTrajectory: Invalid trajectory ID");
+    return;
+    }
+
+  int slot = -1;
+  std::map<std::string, int>::iterator slotIt = this->TrajectorySlots.find(trajectoryId);
+  if (slotIt != this->TrajectorySlots.end())
+    {
+    slot = slotIt->second;
+    this->RemoveFromCells(slot);
+    }
+  else if (!this->UnusedSlots.empty())
+    {
+    slot = this->UnusedSlots.back();
+    this->UnusedSlots.pop_back();
+    }
+  else
+    {
+    slot = static_cast<int>(this->Trajectories.size());
+    this->Trajectories.push_back(Trajectory());
+    this->Trajectories[slot].LastQueryIndex = this->QueryIndex;
+    }
+
+  Trajectory& trajectory = this->Trajectories[slot];
+  trajectory.Id = trajectoryId;
+  for (int i = 0; i < 3; ++i)
+    {
+    trajectory.Entry[i] = entry[i];
+    trajectory.Target[i] = target[i];
+    }
+  this->TrajectorySlots[trajectory.Id] = slot;
+  this->AddToCells(slot);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::RemoveTrajectory(const char* trajectoryId)
+{
+  if (!trajectoryId)
+    {
+    return;
+    }
+  std::map<std::string, int>::iterator slotIt = this->TrajectorySlots.find(trajectoryId);
+  if (slotIt == this->TrajectorySlots.end())
+    {
+    return;
+    }
+  int slot = slotIt->second;
+  this->RemoveFromCells(slot);
+  this->Trajectories[slot].Id.clear();
+  this->UnusedSlots.push_back(slot);
+  this->TrajectorySlots.erase(slotIt);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::RemoveAllTrajectories()
+{
+  this->Trajectories.clear();
+  this->UnusedSlots.clear();
+  this->TrajectorySlots.clear();
+  this->Cells.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkTrajectorySpatialIndex::HasTrajectory(const char* trajectoryId)
+{
+  if (!trajectoryId)
+    {
+    return false;
+    }
+  return this->TrajectorySlots.find(trajectoryId) != this->TrajectorySlots.end();
+}
+
+//----------------------------------------------------------------------------
+int vtkTrajectorySpatialIndex::GetNumberOfTrajectories()
+{
+  return static_cast<int>(this->TrajectorySlots.size());
+}
+
+//----------------------------------------------------------------------------
+vtkTrajectorySpatialIndex::GridIndex vtkTrajectorySpatialIndex::GetCellIndex(const double position[3])
+{
+  GridIndex index;
+  for (int i = 0; i < 3; ++i)
+    {
+    index.Index[i] = static_cast<int>(floor(position[i] / this->CellSize));
+    }
+  return index;
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::AddToCells(int slot)
+{
+  Trajectory& trajectory = this->Trajectories[slot];
+
+  // Sample the segment with a step of at most half cell size. Each point of the segment is then
+  // in the same or in a neighbor cell of a sample, which is taken into account in queries.
+  double length = sqrt(vtkMath::Distance2BetweenPoints(trajectory.Entry, trajectory.Target));
+  int numberOfSteps = static_cast<int>(ceil(length / (this->CellSize / 2.0)));
+  for (int step = 0; step <= numberOfSteps; ++step)
+    {
+    double t = (numberOfSteps > 0 ? static_cast<double>(step) / numberOfSteps : 0.0);
+    double position[3];
+    for (int i = 0; i < 3; ++i)
+      {
+      position[i] = trajectory.Entry[i] + t * (trajectory.Target[i] - trajectory.Entry[i]);
+      }
+    GridIndex cellIndex = this->GetCellIndex(position);
+    std::vector<int>& cellSlots = this->Cells[cellIndex];
+    // Consecutive samples are often in the same cell
+    if (!cellSlots.empty() && cellSlots.back() == slot)
+      {
+      continue;
+      }
+    cellSlots.push_back(slot);
+    trajectory.Cells.push_back(cellIndex);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::RemoveFromCells(int slot)
+{
+  Trajectory& trajectory = this->Trajectories[slot];
+  for (std::vector<GridIndex>::iterator cellIndexIt = trajectory.Cells.begin();
+       cellIndexIt != trajectory.Cells.end(); ++cellIndexIt)
+    {
+    std::map<GridIndex, std::vector<int> >::iterator cellIt = this->Cells.find(*cellIndexIt);
+    if (cellIt == this->Cells.end())
+      {
+      // already removed (the segment returned to the same cell)
+      continue;
+      }
+    std::vector<int>& cellSlots = cellIt->second;
+    cellSlots.erase(std::remove(cellSlots.begin(), cellSlots.end(), slot), cellSlots.end());
+    if (cellSlots.empty())
+      {
+      this->Cells.erase(cellIt);
+      }
+    }
+  trajectory.Cells.clear();
+}
+
+//----------------------------------------------------------------------------
+bool vtkTrajectorySpatialIndex::IsWithinDistance(int slot, const double point[3], double distance)
+{
+  Trajectory& trajectory = this->Trajectories[slot];
+  double x[3] = {point[0], point[1], point[2]};
+  double t = 0.0;
+  double closestPoint[3] = {0.0, 0.0, 0.0};
+  // Distance from the segment (not the infinite line)
+  double distance2 = vtkLine::DistanceToLine(x, trajectory.Entry, trajectory.Target, t, closestPoint);
+  return distance2 <= distance * distance;
+}
+
+//----------------------------------------------------------------------------
+void vtkTrajectorySpatialIndex::FindTrajectoriesWithinDistance(const double point[3], double distance, vtkStringArray* foundTrajectoryIds)
+{
+  if (!foundTrajectoryIds)
+    {
+    vtkErrorMacro("FindTrajectoriesWithinDistance: Invalid output array");
+    return;
+    }
+  foundTrajectoryIds->Reset();
+
+  // Query cells in the box around the point, extended by one cell (see AddToCells)
+  double minimumPosition[3] = {point[0] - distance, point[1] - distance, point[2] - distance};
+  double maximumPosition[3] = {point[0] + distance, point[1] + distance, point[2] + distance};
+  GridIndex minimumIndex = this->GetCellIndex(minimumPosition);
+  GridIndex maximumIndex = this->GetCellIndex(maximumPosition);
+  double numberOfQueryCells = 1.0;
+  for (int i = 0; i < 3; ++i)
+    {
+    minimumIndex.Index[i] -= 1;
+    maximumIndex.Index[i] += 1;
+    numberOfQueryCells *= (maximumIndex.Index[i] - minimumIndex.Index[i] + 1);
+    }
+
+  if (numberOfQueryCells > this->Cells.size())
+    {
+    // Distance is large compared to the cell size, it is faster to check all trajectories
+    for (std::map<std::string, int>::iterator slotIt = this->TrajectorySlots.begin();
+         slotIt != this->TrajectorySlots.end(); ++slotIt)
+      {
+      if (this->IsWithinDistance(slotIt->second, point, distance))
+        {
+        foundTrajectoryIds->InsertNextValue(slotIt->first);
+        }
+      }
+    return;
+    }
+
+  this->QueryIndex++;
+  GridIndex cellIndex;
+  for (cellIndex.Index[2] = minimumIndex.Index[2]; cellIndex.Index[2] <= maximumIndex.Index[2]; ++cellIndex.Index[2])
+    {
+    for (cellIndex.Index[1] = minimumIndex.Index[1]; cellIndex.Index[1] <= maximumIndex.Index[1]; ++cellIndex.Index[1])
+      {
+      for (cellIndex.Index[0] = minimumIndex.Index[0]; cellIndex.Index[0] <= maximumIndex.Index[0]; ++cellIndex.Index[0])
+        {
+        std::map<GridIndex, std::vector<int> >::iterator cellIt = this->Cells.find(cellIndex);
+        if (cellIt == this->Cells.end())
+          {
+          continue;
+          }
+        for (std::vector<int>::iterator slotIt = cellIt->second.begin(); slotIt != cellIt->second.end(); ++slotIt)
+          {
+          Trajectory& trajectory = this->Trajectories[*slotIt];
+          if (trajectory.LastQueryIndex == this->QueryIndex)
+            {
+            continue;
+            }
+          trajectory.LastQueryIndex = this->QueryIndex;
+          if (this->IsWithinDistance(*slotIt, point, distance))
+            {
+            foundTrajectoryIds->InsertNextValue(trajectory.Id);
+            }
+          }
+        }
+      }
+    }
+}
@@ -0,0 +1,107 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkTrajectorySpatialIndex - fast lookup of straight trajectories near a point
+// .SECTION Description
+// Stores line segments (entry and target point of each trajectory), identified by a string
+// (typically the ID of the ruler node that represents the trajectory).
+// Each segment is registered in the cells of a uniform grid that it passes through,
+// so finding the trajectories that pass within a distance of a point only requires
+// checking the segments in the grid cells around the point, instead of all trajectories.
+
+#ifndef __vtkTrajectorySpatialIndex_h
+#define __vtkTrajectorySpatialIndex_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathExplorerModuleLogicExport.h"
+
+class vtkStringArray;
+
+class VTK_SLICER_PATHEXPLORER_MODULE_LOGIC_EXPORT vtkTrajectorySpatialIndex : public vtkObject
+{
+public:
+  static vtkTrajectorySpatialIndex *New();
+  vtkTypeMacro(vtkTrajectorySpatialIndex, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Size of the grid cells, in mm. Should be about the typical query distance.
+  // Changing it re-indexes all trajectories.
+  void SetCellSize(double cellSize);
+  vtkGetMacro(CellSize, double);
+
+  // Add a trajectory. If a trajectory already exists with the same ID then its position is updated.
+  void SetTrajectory(const char* trajectoryId, const double entry[3], const double target[3]);
+  void RemoveTrajectory(const char* trajectoryId);
+  void RemoveAllTrajectories();
+  bool HasTrajectory(const char* trajectoryId);
+  int GetNumberOfTrajectories();
+
+  // Get IDs of all trajectories that have a point closer than distance to the given point
+  void FindTrajectoriesWithinDistance(const double point[3], double distance, vtkStringArray* foundTrajectoryIds);
+
+protected:
+  vtkTrajectorySpatialIndex();
+  virtual ~vtkTrajectorySpatialIndex();
+
+private:
+  struct GridIndex
+  {
+    int Index[3];
+    bool operator<(const GridIndex& other) const;
+  };
+
+  struct Trajectory
+  {
+    std::string Id;
+    double Entry[3];
+    double Target[3];
+    // Grid cells that the trajectory is registered in. Empty if the slot is not used.
+    std::vector<GridIndex> Cells;
+    // Index of the last query that checked this trajectory, to check each trajectory only once per query
+    unsigned int LastQueryIndex;
+  };
+
+  GridIndex GetCellIndex(const double position[3]);
+  void AddToCells(int slot);
+  void RemoveFromCells(int slot);
+  // Returns true if the trajectory is within distance of the point
+  bool IsWithinDistance(int slot, const double point[3], double distance);
+
+  double CellSize;
+
+  // Trajectory slots. Slots of removed trajectories are reused.
+  std::vector<Trajectory> Trajectories;
+  std::vector<int> UnusedSlots;
+  std::map<std::string, int> TrajectorySlots;
+
+  // Grid cells that contain trajectories, and the slots of the trajectories in each
+  std::map<GridIndex, std::vector<int> > Cells;
+
+  unsigned int QueryIndex;
+
+  vtkTrajectorySpatialIndex(const vtkTrajectorySpatialIndex&); // Not implemented
+  void operator=(const vtkTrajectorySpatialIndex&);             // Not implemented
+};
+
+#endif
@@ -0,0 +1,428 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkTriangleBoundingVolumeHierarchy.h"
+
+// VTK includes
+#include <vtkAbstractTransform.h>
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkTriangleFilter.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+// Maximum number of triangles in a leaf node
+static const int MAXIMUM_LEAF_SIZE = 8;
+
+//----------------------------------------------------------------------------
+// Geometric helper functions (see C. Ericson, Real-Time Collision Detection, 2005)
+
+//----------------------------------------------------------------------------
+static double Clamp01(double value)
+{
+  return value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
+}
+
+//----------------------------------------------------------------------------
+static double PointSegmentDistance2(const double p[3], const double a[3], const double b[3])
+{
+  double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  double ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+  double abLength2 = vtkMath::Dot(ab, ab);
+  double t = (abLength2 > 0.0) ? Clamp01(vtkMath::Dot(ap, ab) / abLength2) : 0.0;
+  double closest[3] = {a[0] + t * ab[0], a[1] + t * ab[1], a[2] + t * ab[2]};
+  return vtkMath::Distance2BetweenPoints(p, closest);
+}
+
+//----------------------------------------------------------------------------
+static double SegmentSegmentDistance2(const double p1[3], const double q1[3], const double p2[3], const double q2[3])
+{
+  double d1[3] = {q1[0] - p1[0], q1[1] - p1[1], q1[2] - p1[2]};
+  double d2[3] = {q2[0] - p2[0], q2[1] - p2[1], q2[2] - p2[2]};
+  double r[3] = {p1[0] - p2[0], p1[1] - p2[1], p1[2] - p2[2]};
+  double a = vtkMath::Dot(d1, d1);
+  double e = vtkMath::Dot(d2, d2);
+  double f = vtkMath::Dot(d2, r);
+  double s = 0.0;
+  double t = 0.0;
+  const double epsilon = 1e-12;
+  if (a <= epsilon && e <= epsilon)
+    {
+    return vtkMath::Distance2BetweenPoints(p1, p2);
+    }
+  if (a <= epsilon)
+    {
+    t = Clamp01(f / e);
+    }
+  else
+    {
+    double c = vtkMath::Dot(d1, r);
+    if (e <= epsilon)
+      {
+      s = Clamp01(-c / a);
+      }
+    else
+      {
+      double b = vtkMath::Dot(d1, d2);
+      double denom = a * e - b * b;
+      s = (denom != 0.0) ? Clamp01((b * f - c * e) / denom) : 0.0;
+      t = (b * s + f) / e;
+      if (t < 0.0)
+        {
+        t = 0.0;
+        s = Clamp01(-c / a);
+        }
+      else if (t > 1.0)
+        {
+        t = 1.0;
+        s = Clamp01((b - c) / a);
+        }
+      }
+    }
+  double c1[3] = {p1[0] + d1[0] * s, p1[1] + d1[1] * s, p1[2] + d1[2] * s};
+  double c2[3] = {p2[0] + d2[0] * t, p2[1] + d2[1] * t, p2[2] + d2[2] * t};
+  return vtkMath::Distance2BetweenPoints(c1, c2);
+}
+
+//----------------------------------------------------------------------------
+static double PointTriangleDistance2(const double p[3], const double a[3], const double b[3], const double c[3])
+{
+  double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  double normal[3] = {0.0, 0.0, 0.0};
+  vtkMath::Cross(ab, ac, normal);
+  double normalLength2 = vtkMath::Dot(normal, normal);
+  if (normalLength2 > 0.0)
+    {
+    // If the projection of the point is inside the triangle then the closest point is the projection
+    double ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+    double bp[3] = {p[0] - b[0], p[1] - b[1], p[2] - b[2]};
+    double cp[3] = {p[0] - c[0], p[1] - c[1], p[2] - c[2]};
+    double bc[3] = {c[0] - b[0], c[1] - b[1], c[2] - b[2]};
+    double ca[3] = {a[0] - c[0], a[1] - c[1], a[2] - c[2]};
+    double n1[3], n2[3], n3[3];
+    vtkMath::Cross(ab, ap, n1);
+    vtkMath::Cross(bc, bp, n2);
+    vtkMath::Cross(ca, cp, n3);
+    if (vtkMath::Dot(n1, normal) >= 0.0 && vtkMath::Dot(n2, normal) >= 0.0 && vtkMath::Dot(n3, normal) >= 0.0)
+      {
+      double distanceFromPlane = vtkMath::Dot(ap, normal);
+      return distanceFromPlane * distanceFromPlane / normalLength2;
+      }
+    }
+  // Otherwise the closest point is on an edge
+  return std::min(PointSegmentDistance2(p, a, b), std::min(PointSegmentDistance2(p, b, c), PointSegmentDistance2(p, c, a)));
+}
+
+//----------------------------------------------------------------------------
+static bool SegmentIntersectsTriangle(const double p[3], const double q[3], const double a[3], const double b[3], const double c[3])
+{
+  double direction[3] = {q[0] - p[0], q[1] - p[1], q[2] - p[2]};
+  double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  double pvec[3] = {0.0, 0.0, 0.0};
+  vtkMath::Cross(direction, ac, pvec);
+  double det = vtkMath::Dot(ab, pvec);
+  if (fabs(det) < 1e-12)
+    {
+    // Parallel to the triangle plane, distance is computed from the edges and endpoints
+    return false;
+    }
+  double tvec[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+  double u = vtkMath::Dot(tvec, pvec) / det;
+  if (u < 0.0 || u > 1.0)
+    {
+    return false;
+    }
+  double qvec[3] = {0.0, 0.0, 0.0};
+  vtkMath::Cross(tvec, ab, qvec);
+  double v = vtkMath::Dot(direction, qvec) / det;
+  if (v < 0.0 || u + v > 1.0)
+    {
+    return false;
+    }
+  double t = vtkMath::Dot(ac, qvec) / det;
+  return t >= 0.0 && t <= 1.0;
+}
+
+//----------------------------------------------------------------------------
+static double SegmentTriangleDistance2(const double p[3], const double q[3], const double* triangle)
+{
+  const double* a = triangle;
+  const double* b = triangle + 3;
+  const double* c = triangle + 6;
+  if (SegmentIntersectsTriangle(p, q, a, b, c))
+    {
+    return 0.0;
+    }
+  // If the segment does not intersect the triangle then the closest points are
+  // at one of the segment endpoints or on one of the triangle edges
+  double distance2 = std::min(PointTriangleDistance2(p, a, b, c), PointTriangleDistance2(q, a, b, c));
+  distance2 = std::min(distance2, SegmentSegmentDistance2(p, q, a, b));
+  distance2 = std::min(distance2, SegmentSegmentDistance2(p, q, b, c));
+  distance2 = std::min(distance2, SegmentSegmentDistance2(p, q, c, a));
+  return distance2;
+}
+
+//----------------------------------------------------------------------------
+// Orders triangles by their centroid coordinate along an axis
+class TriangleCentroidLess
+{
+public:
+  TriangleCentroidLess(const std::vector<double>& triangles, int axis) : Triangles(triangles), Axis(axis) {}
+  bool operator()(int triangle1, int triangle2) const
+  {
+    return this->GetCentroidSum(triangle1) < this->GetCentroidSum(triangle2);
+  }
+private:
+  double GetCentroidSum(int triangle) const
+  {
+    const double* vertices = &this->Triangles[9 * triangle];
+    return vertices[this->Axis] + vertices[3 + this->Axis] + vertices[6 + this->Axis];
+  }
+  const std::vector<double>& Triangles;
+  int Axis;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkTriangleBoundingVolumeHierarchy);
+
+//----------------------------------------------------------------------------
+vtkTriangleBoundingVolumeHierarchy::vtkTriangleBoundingVolumeHierarchy()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkTriangleBoundingVolumeHierarchy::~vtkTriangleBoundingVolumeHierarchy()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkTriangleBoundingVolumeHierarchy::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfTriangles: " << this->GetNumberOfTriangles() << std::endl;
+  os << indent << "NumberOfNodes: " << this->Nodes.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkTriangleBoundingVolumeHierarchy::AddSurface(vtkPolyData* surface, vtkAbstractTransform* transform /*=NULL*/)
+{
+  if (!surface)
+    {
+    vtkErrorMacro("AddSurface: Invalid surface");
+    return;
+    }
+
+  vtkNew<vtkTriangleFilter> triangleFilter;
+#if (VTK_MAJOR_VERSION <= 5)
+  triangleFilter->SetInput(surface);
+#else
+  triangleFilter->SetInputData(surface);
+#endif
+  triangleFilter->PassVertsOff();
+  triangleFilter->PassLinesOff();
+  triangleFilter->Update();
+  vtkPolyData* triangles = triangleFilter->GetOutput();
+
+  vtkCellArray* polys = triangles->GetPolys();
+  this->Triangles.reserve(this->Triangles.size() + 9 * polys->GetNumberOfCells());
+  vtkIdType numberOfPoints = 0;
+  vtkIdType* pointIds = NULL;
+  polys->InitTraversal();
+  while (polys->GetNextCell(numberOfPoints, pointIds))
+    {
+    if (numberOfPoints != 3)
+      {
+      continue;
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      double point[3] = {0.0, 0.0, 0.0};
+      triangles->GetPoint(pointIds[i], point);
+      if (transform)
+        {
+        transform->TransformPoint(point, point);
+        }
+      this->Triangles.push_back(point[0]);
+      this->Triangles.push_back(point[1]);
+      this->Triangles.push_back(point[2]);
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkTriangleBoundingVolumeHierarchy::Reset()
+{
+  this->Triangles.clear();
+  this->TriangleOrder.clear();
+  this->Nodes.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkTriangleBoundingVolumeHierarchy::Build()
+{
+  int numberOfTriangles = this->GetNumberOfTriangles();
+  this->TriangleOrder.resize(numberOfTriangles);
+  for (int i = 0; i < numberOfTriangles; ++i)
+    {
+    this->TriangleOrder[i] = i;
+    }
+  this->Nodes.clear();
+  if (numberOfTriangles > 0)
+    {
+    this->Nodes.reserve(2 * numberOfTriangles / MAXIMUM_LEAF_SIZE + 1);
+    this->BuildNode(0, numberOfTriangles);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkTriangleBoundingVolumeHierarchy::BuildNode(int first, int count)
+{
+  // Bounding box of the vertices, the bounding sphere is centered at the center of the box
+  double bounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+  for (int i = first; i < first + count; ++i)
+    {
+    const double* vertices = &this->Triangles[9 * this->TriangleOrder[i]];
+    for (int vertex = 0; vertex < 3; ++vertex)
+      {
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        bounds[2 * axis] = std::min(bounds[2 * axis], vertices[3 * vertex + axis]);
+        bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], vertices[3 * vertex + axis]);
+        }
+      }
+    }
+
+  Node node;
+  double radius2 = 0.0;
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    node.Center[axis] = (bounds[2 * axis] + bounds[2 * axis + 1]) / 2.0;
+    }
+  for (int i = first; i < first + count; ++i)
+    {
+    const double* vertices = &this->Triangles[9 * this->TriangleOrder[i]];
+    for (int vertex = 0; vertex < 3; ++vertex)
+      {
+      radius2 = std::max(radius2, vtkMath::Distance2BetweenPoints(node.Center, vertices + 3 * vertex));
+      }
+    }
+  node.Radius = sqrt(radius2);
+  node.Children[0] = -1;
+  node.Children[1] = -1;
+  node.FirstTriangle = first;
+  node.NumberOfTriangles = count;
+
+  int nodeIndex = static_cast<int>(this->Nodes.size());
+  this->Nodes.push_back(node);
+  if (count <= MAXIMUM_LEAF_SIZE)
+    {
+    return nodeIndex;
+    }
+
+  // Split at the median along the longest axis of the bounding box
+  int splitAxis = 0;
+  for (int axis = 1; axis < 3; ++axis)
+    {
+    if (bounds[2 * axis + 1] - bounds[2 * axis] > bounds[2 * splitAxis + 1] - bounds[2 * splitAxis])
+      {
+      splitAxis = axis;
+      }
+    }
+  int leftCount = count / 2;
+  std::nth_element(this->TriangleOrder.begin() + first, this->TriangleOrder.begin() + first + leftCount,
+    this->TriangleOrder.begin() + first + count, TriangleCentroidLess(this->Triangles, splitAxis));
+
+  // Nodes may be reallocated while building the children, so they are not accessed by reference
+  int leftChild = this->BuildNode(first, leftCount);
+  int rightChild = this->BuildNode(first + leftCount, count - leftCount);
+  this->Nodes[nodeIndex].Children[0] = leftChild;
+  this->Nodes[nodeIndex].Children[1] = rightChild;
+  this->Nodes[nodeIndex].NumberOfTriangles = 0;
+  return nodeIndex;
+}
+
+//----------------------------------------------------------------------------
+double vtkTriangleBoundingVolumeHierarchy::GetNodeDistanceLowerBound(int nodeIndex, const double segmentStart[3], const double segmentEnd[3]) const
+{
+  const Node& node = this->Nodes[nodeIndex];
+  double centerDistance = sqrt(PointSegmentDistance2(node.Center, segmentStart, segmentEnd));
+  return std::max(0.0, centerDistance - node.Radius);
+}
+
+//----------------------------------------------------------------------------
+double vtkTriangleBoundingVolumeHierarchy::ComputeSegmentDistance(const double segmentStart[3], const double segmentEnd[3]) const
+{
+  if (this->Nodes.empty())
+    {
+    return VTK_DOUBLE_MAX;
+    }
+
+  // Depth-first traversal, visiting the closer child first and skipping nodes that cannot contain a closer triangle
+  double closestDistance2 = VTK_DOUBLE_MAX;
+  std::vector<int> nodeStack;
+  nodeStack.push_back(0);
+  while (!nodeStack.empty())
+    {
+    int nodeIndex = nodeStack.back();
+    nodeStack.pop_back();
+    double lowerBound = this->GetNodeDistanceLowerBound(nodeIndex, segmentStart, segmentEnd);
+    if (lowerBound * lowerBound >= closestDistance2)
+      {
+      continue;
+      }
+    const Node& node = this->Nodes[nodeIndex];
+    if (node.Children[0] < 0)
+      {
+      for (int i = node.FirstTriangle; i < node.FirstTriangle + node.NumberOfTriangles; ++i)
+        {
+        double distance2 = SegmentTriangleDistance2(segmentStart, segmentEnd, &this->Triangles[9 * this->TriangleOrder[i]]);
+        if (distance2 < closestDistance2)
+          {
+          closestDistance2 = distance2;
+          }
+        }
+      if (closestDistance2 == 0.0)
+        {
+        break;
+        }
+      continue;
+      }
+    double childLowerBound0 = this->GetNodeDistanceLowerBound(node.Children[0], segmentStart, segmentEnd);
+    double childLowerBound1 = this->GetNodeDistanceLowerBound(node.Children[1], segmentStart, segmentEnd);
+    // The node pushed last is visited first
+    if (childLowerBound0 < childLowerBound1)
+      {
+      nodeStack.push_back(node.Children[1]);
+      nodeStack.push_back(node.Children[0]);
+      }
+    else
+      {
+      nodeStack.push_back(node.Children[0]);
+      nodeStack.push_back(node.Children[1]);
+      }
+    }
+  return sqrt(closestDistance2);
+}
@@ -0,0 +1,95 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkTriangleBoundingVolumeHierarchy - distance queries between line segments and surfaces
+// .SECTION Description
+// Bounding volume hierarchy of the triangles of one or more surfaces, for computing the exact
+// minimum distance between a line segment (e.g., a needle trajectory) and the surfaces.
+// After Build() the hierarchy is not modified by queries, therefore, unlike VTK locators,
+// the same hierarchy can be queried from multiple threads at the same time.
+
+#ifndef __vtkTriangleBoundingVolumeHierarchy_h
+#define __vtkTriangleBoundingVolumeHierarchy_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerPathExplorerModuleLogicExport.h"
+
+class vtkAbstractTransform;
+class vtkPolyData;
+
+class VTK_SLICER_PATHEXPLORER_MODULE_LOGIC_EXPORT vtkTriangleBoundingVolumeHierarchy : public vtkObject
+{
+public:
+  static vtkTriangleBoundingVolumeHierarchy *New();
+  vtkTypeMacro(vtkTriangleBoundingVolumeHierarchy, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Add the triangles of a surface (polygons and triangle strips are triangulated).
+  // If transform is specified then the points are transformed by it.
+  // Build() must be called after all surfaces are added.
+  void AddSurface(vtkPolyData* surface, vtkAbstractTransform* transform = NULL);
+
+  // Remove all triangles
+  void Reset();
+
+  // Build the hierarchy from the added triangles
+  void Build();
+
+  int GetNumberOfTriangles() const { return static_cast<int>(this->Triangles.size() / 9); };
+
+  // Minimum distance between the line segment and the triangles (0 if the segment intersects a triangle).
+  // Returns VTK_DOUBLE_MAX if there are no triangles. Can be called from multiple threads.
+  double ComputeSegmentDistance(const double segmentStart[3], const double segmentEnd[3]) const;
+
+protected:
+  vtkTriangleBoundingVolumeHierarchy();
+  virtual ~vtkTriangleBoundingVolumeHierarchy();
+
+private:
+  struct Node
+  {
+    // Bounding sphere of the triangles in the node
+    double Center[3];
+    double Radius;
+    // Child nodes (-1 for leaf nodes)
+    int Children[2];
+    // Range of triangles in TriangleOrder (only for leaf nodes)
+    int FirstTriangle;
+    int NumberOfTriangles;
+  };
+
+  // Builds the node for the triangles TriangleOrder[first, first+count), returns the index of the node
+  int BuildNode(int first, int count);
+  // Lower bound of the distance between the segment and the triangles of the node
+  double GetNodeDistanceLowerBound(int nodeIndex, const double segmentStart[3], const double segmentEnd[3]) const;
+
+  // Vertex coordinates of the triangles (9 values for each triangle)
+  std::vector<double> Triangles;
+  // Triangle indices, reordered so that triangles of each node are contiguous
+  std::vector<int> TriangleOrder;
+  std::vector<Node> Nodes;
+
+  vtkTriangleBoundingVolumeHierarchy(const vtkTriangleBoundingVolumeHierarchy&); // Not implemented
+  void operator=(const vtkTriangleBoundingVolumeHierarchy&);                     // Not implemented
+};
+
+#endif
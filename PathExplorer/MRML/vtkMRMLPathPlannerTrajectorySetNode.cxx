@@ -0,0 +1,229 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkMRMLPathPlannerTrajectorySetNode.h"
+#include "vtkMRMLPathPlannerTrajectorySetStorageNode.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLPathPlannerTrajectorySetNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLPathPlannerTrajectorySetNode::vtkMRMLPathPlannerTrajectorySetNode()
+{
+  this->HideFromEditors = false;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLPathPlannerTrajectorySetNode::~vtkMRMLPathPlannerTrajectorySetNode()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetNode::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfTrajectories: " << this->GetNumberOfTrajectories() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetNode::Copy(vtkMRMLNode *anode)
+{
+  int wasModifying = this->StartModify();
+  Superclass::Copy(anode);
+  vtkMRMLPathPlannerTrajectorySetNode* node = vtkMRMLPathPlannerTrajectorySetNode::SafeDownCast(anode);
+  if (node)
+    {
+    this->EntryPositions = node->EntryPositions;
+    this->TargetPositions = node->TargetPositions;
+    this->Names = node->Names;
+    this->Clearances = node->Clearances;
+    this->StorableModified();
+    this->Modified();
+    }
+  this->EndModify(wasModifying);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLStorageNode* vtkMRMLPathPlannerTrajectorySetNode::CreateDefaultStorageNode()
+{
+  return vtkMRMLPathPlannerTrajectorySetStorageNode::New();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectorySetNode::AddTrajectory(const char* name, const double entry[3], const double target[3], double clearance)
+{
+  if (!entry || !target)
+    {
+    vtkErrorMacro("AddTrajectory: Invalid position");
+    return -1;
+    }
+  int index = this->GetNumberOfTrajectories();
+  this->EntryPositions.insert(this->EntryPositions.end(), entry, entry + 3);
+  this->TargetPositions.insert(this->TargetPositions.end(), target, target + 3);
+  if (name)
+    {
+    this->Names.push_back(name);
+    }
+  else
+    {
+    std::ostringstream defaultName;
+    defaultName << index;
+    this->Names.push_back(defaultName.str());
+    }
+  this->Clearances.push_back(clearance);
+  this->StorableModified();
+  this->Modified();
+  return index;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetNode::Allocate(int numberOfTrajectories)
+{
+  if (numberOfTrajectories <= 0)
+    {
+    return;
+    }
+  this->EntryPositions.reserve(3 * numberOfTrajectories);
+  this->TargetPositions.reserve(3 * numberOfTrajectories);
+  this->Names.reserve(numberOfTrajectories);
+  this->Clearances.reserve(numberOfTrajectories);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetNode::RemoveAllTrajectories()
+{
+  if (this->Clearances.empty())
+    {
+    return;
+    }
+  this->EntryPositions.clear();
+  this->TargetPositions.clear();
+  this->Names.clear();
+  this->Clearances.clear();
+  this->StorableModified();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectorySetNode::GetNumberOfTrajectories()
+{
+  return static_cast<int>(this->Clearances.size());
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLPathPlannerTrajectorySetNode::GetEntryPosition(int i, double entry[3])
+{
+  if (i < 0 || i >= this->GetNumberOfTrajectories())
+    {
+    vtkErrorMacro("GetEntryPosition: Invalid trajectory index " << i);
+    return false;
+    }
+  std::copy(this->EntryPositions.begin() + 3 * i, this->EntryPositions.begin() + 3 * i + 3, entry);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLPathPlannerTrajectorySetNode::GetTargetPosition(int i, double target[3])
+{
+  if (i < 0 || i >= this->GetNumberOfTrajectories())
+    {
+    vtkErrorMacro("GetTargetPosition: Invalid trajectory index " << i);
+    return false;
+    }
+  std::copy(this->TargetPositions.begin() + 3 * i, this->TargetPositions.begin() + 3 * i + 3, target);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+const char* vtkMRMLPathPlannerTrajectorySetNode::GetTrajectoryName(int i)
+{
+  if (i < 0 || i >= this->GetNumberOfTrajectories())
+    {
+    vtkErrorMacro("GetTrajectoryName: Invalid trajectory index " << i);
+    return NULL;
+    }
+  return this->Names[i].c_str();
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLPathPlannerTrajectorySetNode::GetClearance(int i)
+{
+  if (i < 0 || i >= this->GetNumberOfTrajectories())
+    {
+    vtkErrorMacro("GetClearance: Invalid trajectory index " << i);
+    return VTK_DOUBLE_MAX;
+    }
+  return this->Clearances[i];
+}
+
+//----------------------------------------------------------------------------
+const double* vtkMRMLPathPlannerTrajectorySetNode::GetEntryPositions()
+{
+  return this->EntryPositions.empty() ? NULL : &this->EntryPositions[0];
+}
+
+//----------------------------------------------------------------------------
+const double* vtkMRMLPathPlannerTrajectorySetNode::GetTargetPositions()
+{
+  return this->TargetPositions.empty() ? NULL : &this->TargetPositions[0];
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetNode::SetTrajectories(std::vector<double>& entryPositions, std::vector<double>& targetPositions,
+  std::vector<std::string>& names, std::vector<double>& clearances)
+{
+  size_t numberOfTrajectories = entryPositions.size() / 3;
+  if (entryPositions.size() != 3 * numberOfTrajectories || targetPositions.size() != entryPositions.size()
+    || (!names.empty() && names.size() != numberOfTrajectories)
+    || (!clearances.empty() && clearances.size() != numberOfTrajectories))
+    {
+    vtkErrorMacro("SetTrajectories: Inconsistent number of positions, names, or clearances");
+    return;
+    }
+  if (names.empty())
+    {
+    names.resize(numberOfTrajectories);
+    for (size_t i = 0; i < numberOfTrajectories; ++i)
+      {
+      std::ostringstream defaultName;
+      defaultName << i;
+      names[i] = defaultName.str();
+      }
+    }
+  if (clearances.empty())
+    {
+    clearances.resize(numberOfTrajectories, VTK_DOUBLE_MAX);
+    }
+
+  this->EntryPositions.swap(entryPositions);
+  this->TargetPositions.swap(targetPositions);
+  this->Names.swap(names);
+  this->Clearances.swap(clearances);
+  entryPositions.clear();
+  targetPositions.clear();
+  names.clear();
+  clearances.clear();
+  this->StorableModified();
+  this->Modified();
+}
@@ -0,0 +1,113 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkMRMLPathPlannerTrajectorySetNode - compact set of candidate trajectories
+// .SECTION Description
+// Stores a large number of straight trajectories (e.g., all entry/target combinations of a
+// planning study) in contiguous arrays, in a single MRML node, instead of one ruler and two
+// fiducial nodes per trajectory as in vtkMRMLPathPlannerTrajectoryNode.
+// Entry and target positions of trajectory i are at index 3*i of the position arrays.
+// The trajectories are saved in a single binary file (see vtkMRMLPathPlannerTrajectorySetStorageNode).
+// Ruler nodes are only created for the trajectories that the user selects
+// (see vtkSlicerPathExplorerLogic::CreateTrajectoryRuler).
+
+#ifndef __vtkMRMLPathPlannerTrajectorySetNode_h
+#define __vtkMRMLPathPlannerTrajectorySetNode_h
+
+#include "vtkSlicerPathExplorerModuleMRMLExport.h"
+#include "vtkMRMLStorableNode.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+class VTK_SLICER_PATHEXPLORER_MODULE_MRML_EXPORT vtkMRMLPathPlannerTrajectorySetNode : public vtkMRMLStorableNode
+{
+public:
+  static vtkMRMLPathPlannerTrajectorySetNode *New();
+  vtkTypeMacro(vtkMRMLPathPlannerTrajectorySetNode, vtkMRMLStorableNode);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  //--------------------------------------------------------------------------
+  // MRMLNode methods
+  //--------------------------------------------------------------------------
+
+  virtual vtkMRMLNode* CreateNodeInstance();
+  // Description:
+  // Get node XML tag name (like Volume, Model)
+  virtual const char* GetNodeTagName() {return "PathPlannerTrajectorySet";};
+
+  virtual const char* GetIcon() {return ":/Icons/PathPlannerTrajectory.png";};
+
+  // Description:
+  // Copy the node's attributes and trajectories to this object
+  virtual void Copy(vtkMRMLNode *node);
+
+  // Description:
+  // Create a vtkMRMLPathPlannerTrajectorySetStorageNode
+  virtual vtkMRMLStorageNode* CreateDefaultStorageNode();
+
+  //--------------------------------------------------------------------------
+  // Trajectories
+  //--------------------------------------------------------------------------
+
+  // Description:
+  // Add a trajectory. Clearance is the minimum distance from critical structures
+  // (VTK_DOUBLE_MAX if unknown). Returns the index of the new trajectory.
+  int AddTrajectory(const char* name, const double entry[3], const double target[3], double clearance);
+
+  // Description:
+  // Preallocate memory for the given number of trajectories, to avoid reallocations when adding many trajectories.
+  void Allocate(int numberOfTrajectories);
+
+  void RemoveAllTrajectories();
+  int GetNumberOfTrajectories();
+
+  // Description:
+  // Get properties of trajectory i. Return false (and leave the output unchanged) if the index is invalid.
+  bool GetEntryPosition(int i, double entry[3]);
+  bool GetTargetPosition(int i, double target[3]);
+  const char* GetTrajectoryName(int i);
+  double GetClearance(int i);
+
+  // Description:
+  // Contiguous position arrays (3 values per trajectory), for reading all trajectories
+  // without copying. Invalidated when trajectories are added or removed.
+  const double* GetEntryPositions();
+  const double* GetTargetPositions();
+
+  // Description:
+  // Replace all trajectories. Positions contain 3 values per trajectory, names and clearances
+  // may be empty (then names are set to the trajectory index and clearances to VTK_DOUBLE_MAX).
+  // The content of the input vectors is swapped into the node (without copying), the inputs are left empty.
+  // Used by the storage node for setting the trajectories in one step.
+  void SetTrajectories(std::vector<double>& entryPositions, std::vector<double>& targetPositions,
+    std::vector<std::string>& names, std::vector<double>& clearances);
+
+protected:
+  vtkMRMLPathPlannerTrajectorySetNode();
+  ~vtkMRMLPathPlannerTrajectorySetNode();
+  vtkMRMLPathPlannerTrajectorySetNode(const vtkMRMLPathPlannerTrajectorySetNode&);
+  void operator=(const vtkMRMLPathPlannerTrajectorySetNode&);
+
+  std::vector<double> EntryPositions;
+  std::vector<double> TargetPositions;
+  std::vector<std::string> Names;
+  std::vector<double> Clearances;
+};
+
+#endif
@@ -0,0 +1,250 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkMRMLPathPlannerTrajectorySetStorageNode.h"
+#include "vtkMRMLPathPlannerTrajectorySetNode.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkObjectFactory.h>
+#include <vtkStringArray.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static const char TRAJECTORY_SET_SIGNATURE[] = "PTRAJSET";
+static const int TRAJECTORY_SET_SIGNATURE_LENGTH = 8;
+static const vtkTypeInt32 TRAJECTORY_SET_FORMAT_VERSION = 1;
+// entry and target position, clearance, and name length
+static const size_t TRAJECTORY_SET_MINIMUM_BYTES_PER_TRAJECTORY = 7 * sizeof(double) + sizeof(vtkTypeInt32);
+
+//----------------------------------------------------------------------------
+// Number of bytes from the current read position to the end of the file.
+// Used for checking sizes read from the file before allocating memory for them.
+static size_t GetNumberOfRemainingBytes(std::istream& file)
+{
+  std::streampos currentPosition = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streampos endPosition = file.tellg();
+  file.seekg(currentPosition);
+  if (file.fail() || endPosition < currentPosition)
+    {
+    return 0;
+    }
+  return static_cast<size_t>(endPosition - currentPosition);
+}
+
+//----------------------------------------------------------------------------
+static bool ReadInt32(std::istream& file, vtkTypeInt32& value)
+{
+  file.read(reinterpret_cast<char*>(&value), sizeof(value));
+  vtkByteSwap::Swap4LE(&value);
+  return !file.fail();
+}
+
+//----------------------------------------------------------------------------
+static bool ReadDoubles(std::istream& file, std::vector<double>& values, size_t numberOfValues)
+{
+  values.resize(numberOfValues);
+  if (numberOfValues == 0)
+    {
+    return true;
+    }
+  file.read(reinterpret_cast<char*>(&values[0]), numberOfValues * sizeof(double));
+  vtkByteSwap::Swap8LERange(&values[0], numberOfValues);
+  return !file.fail();
+}
+
+//----------------------------------------------------------------------------
+static void WriteInt32(std::ostream& file, vtkTypeInt32 value)
+{
+  vtkByteSwap::SwapWrite4LE(&value, &file);
+}
+
+//----------------------------------------------------------------------------
+static void WriteDoubles(std::ostream& file, const double* values, size_t numberOfValues)
+{
+  if (numberOfValues > 0)
+    {
+    vtkByteSwap::SwapWrite8LERange(values, numberOfValues, &file);
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLPathPlannerTrajectorySetStorageNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLPathPlannerTrajectorySetStorageNode::vtkMRMLPathPlannerTrajectorySetStorageNode()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLPathPlannerTrajectorySetStorageNode::~vtkMRMLPathPlannerTrajectorySetStorageNode()
+{
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLPathPlannerTrajectorySetStorageNode::CanReadInReferenceNode(vtkMRMLNode *refNode)
+{
+  return refNode && refNode->IsA("vtkMRMLPathPlannerTrajectorySetNode");
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetStorageNode::InitializeSupportedReadFileTypes()
+{
+  this->SupportedReadFileTypes->InsertNextValue("Path Planner Trajectory Set (.ptset)");
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectorySetStorageNode::InitializeSupportedWriteFileTypes()
+{
+  this->SupportedWriteFileTypes->InsertNextValue("Path Planner Trajectory Set (.ptset)");
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectorySetStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
+{
+  vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode = vtkMRMLPathPlannerTrajectorySetNode::SafeDownCast(refNode);
+  if (!trajectorySetNode)
+    {
+    vtkErrorMacro("ReadDataInternal: Invalid trajectory set node");
+    return 0;
+    }
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName.empty())
+    {
+    vtkErrorMacro("ReadDataInternal: File name not specified");
+    return 0;
+    }
+  std::ifstream file(fullName.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    {
+    vtkErrorMacro("ReadDataInternal: Cannot open file " << fullName);
+    return 0;
+    }
+
+  char signature[TRAJECTORY_SET_SIGNATURE_LENGTH];
+  file.read(signature, TRAJECTORY_SET_SIGNATURE_LENGTH);
+  vtkTypeInt32 version = 0;
+  vtkTypeInt32 numberOfTrajectories = 0;
+  if (file.fail() || strncmp(signature, TRAJECTORY_SET_SIGNATURE, TRAJECTORY_SET_SIGNATURE_LENGTH) != 0
+    || !ReadInt32(file, version) || !ReadInt32(file, numberOfTrajectories))
+    {
+    vtkErrorMacro("ReadDataInternal: " << fullName << " is not a trajectory set file");
+    return 0;
+    }
+  if (version > TRAJECTORY_SET_FORMAT_VERSION || numberOfTrajectories < 0)
+    {
+    vtkErrorMacro("ReadDataInternal: Unsupported trajectory set file version " << version << " in " << fullName);
+    return 0;
+    }
+  if (static_cast<size_t>(numberOfTrajectories) > GetNumberOfRemainingBytes(file) / TRAJECTORY_SET_MINIMUM_BYTES_PER_TRAJECTORY)
+    {
+    vtkErrorMacro("ReadDataInternal: " << fullName << " is too short for " << numberOfTrajectories << " trajectories");
+    return 0;
+    }
+
+  std::vector<double> entryPositions;
+  std::vector<double> targetPositions;
+  std::vector<double> clearances;
+  if (!ReadDoubles(file, entryPositions, 3 * static_cast<size_t>(numberOfTrajectories))
+    || !ReadDoubles(file, targetPositions, 3 * static_cast<size_t>(numberOfTrajectories))
+    || !ReadDoubles(file, clearances, static_cast<size_t>(numberOfTrajectories)))
+    {
+    vtkErrorMacro("ReadDataInternal: Failed to read trajectory positions from " << fullName);
+    return 0;
+    }
+  std::vector<std::string> names(numberOfTrajectories);
+  for (vtkTypeInt32 i = 0; i < numberOfTrajectories; ++i)
+    {
+    vtkTypeInt32 nameLength = 0;
+    if (!ReadInt32(file, nameLength) || nameLength < 0
+      || static_cast<size_t>(nameLength) > GetNumberOfRemainingBytes(file))
+      {
+      vtkErrorMacro("ReadDataInternal: Failed to read trajectory names from " << fullName);
+      return 0;
+      }
+    names[i].resize(nameLength);
+    if (nameLength > 0)
+      {
+      file.read(&names[i][0], nameLength);
+      }
+    if (file.fail())
+      {
+      vtkErrorMacro("ReadDataInternal: Failed to read trajectory names from " << fullName);
+      return 0;
+      }
+    }
+
+  trajectorySetNode->SetTrajectories(entryPositions, targetPositions, names, clearances);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectorySetStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
+{
+  vtkMRMLPathPlannerTrajectorySetNode* trajectorySetNode = vtkMRMLPathPlannerTrajectorySetNode::SafeDownCast(refNode);
+  if (!trajectorySetNode)
+    {
+    vtkErrorMacro("WriteDataInternal: Invalid trajectory set node");
+    return 0;
+    }
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName.empty())
+    {
+    vtkErrorMacro("WriteDataInternal: File name not specified");
+    return 0;
+    }
+  std::ofstream file(fullName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+    {
+    vtkErrorMacro("WriteDataInternal: Cannot open file " << fullName << " for writing");
+    return 0;
+    }
+
+  int numberOfTrajectories = trajectorySetNode->GetNumberOfTrajectories();
+  file.write(TRAJECTORY_SET_SIGNATURE, TRAJECTORY_SET_SIGNATURE_LENGTH);
+  WriteInt32(file, TRAJECTORY_SET_FORMAT_VERSION);
+  WriteInt32(file, numberOfTrajectories);
+  WriteDoubles(file, trajectorySetNode->GetEntryPositions(), 3 * static_cast<size_t>(numberOfTrajectories));
+  WriteDoubles(file, trajectorySetNode->GetTargetPositions(), 3 * static_cast<size_t>(numberOfTrajectories));
+  std::vector<double> clearances(numberOfTrajectories);
+  for (int i = 0; i < numberOfTrajectories; ++i)
+    {
+    clearances[i] = trajectorySetNode->GetClearance(i);
+    }
+  WriteDoubles(file, clearances.empty() ? NULL : &clearances[0], clearances.size());
+  for (int i = 0; i < numberOfTrajectories; ++i)
+    {
+    const char* name = trajectorySetNode->GetTrajectoryName(i);
+    vtkTypeInt32 nameLength = static_cast<vtkTypeInt32>(strlen(name));
+    WriteInt32(file, nameLength);
+    file.write(name, nameLength);
+    }
+
+  file.close();
+  if (file.fail())
+    {
+    vtkErrorMacro("WriteDataInternal: Failed to write " << fullName);
+    return 0;
+    }
+  return 1;
+}
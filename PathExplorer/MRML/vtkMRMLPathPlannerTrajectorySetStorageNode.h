@@ -0,0 +1,63 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkMRMLPathPlannerTrajectorySetStorageNode - binary storage of trajectory sets
+// .SECTION Description
+// Reads and writes all trajectories of a vtkMRMLPathPlannerTrajectorySetNode in a single binary file (.ptset).
+// The file contains the "PTRAJSET" signature, the format version and the number of trajectories (32-bit integers),
+// the entry positions, the target positions and the clearances (contiguous 64-bit floating point arrays),
+// then the names (32-bit length followed by the characters). All numbers are little-endian.
+// The position arrays are read and written in one block, without per-trajectory parsing.
+
+#ifndef __vtkMRMLPathPlannerTrajectorySetStorageNode_h
+#define __vtkMRMLPathPlannerTrajectorySetStorageNode_h
+
+#include "vtkSlicerPathExplorerModuleMRMLExport.h"
+#include "vtkMRMLStorageNode.h"
+
+class VTK_SLICER_PATHEXPLORER_MODULE_MRML_EXPORT vtkMRMLPathPlannerTrajectorySetStorageNode : public vtkMRMLStorageNode
+{
+public:
+  static vtkMRMLPathPlannerTrajectorySetStorageNode *New();
+  vtkTypeMacro(vtkMRMLPathPlannerTrajectorySetStorageNode, vtkMRMLStorageNode);
+
+  virtual vtkMRMLNode* CreateNodeInstance();
+
+  // Description:
+  // Get node XML tag name (like Storage, Model)
+  virtual const char* GetNodeTagName() {return "PathPlannerTrajectorySetStorage";};
+
+  // Description:
+  // Return true if the node can be read in
+  virtual bool CanReadInReferenceNode(vtkMRMLNode* refNode);
+
+  virtual const char* GetDefaultWriteFileExtension() {return "ptset";};
+
+protected:
+  vtkMRMLPathPlannerTrajectorySetStorageNode();
+  ~vtkMRMLPathPlannerTrajectorySetStorageNode();
+  vtkMRMLPathPlannerTrajectorySetStorageNode(const vtkMRMLPathPlannerTrajectorySetStorageNode&);
+  void operator=(const vtkMRMLPathPlannerTrajectorySetStorageNode&);
+
+  virtual void InitializeSupportedReadFileTypes();
+  virtual void InitializeSupportedWriteFileTypes();
+
+  virtual int ReadDataInternal(vtkMRMLNode *refNode);
+  virtual int WriteDataInternal(vtkMRMLNode *refNode);
+};
+
+#endif
@@ -31,6 +31,14 @@
 #include "vtkMRMLScene.h"
 #include "vtkMRMLSelectionNode.h"
 
+// Qt includes
+#include <QTimer>
+
+// Control point interaction events are available since Slicer 4.11
+#if Slicer_VERSION_MAJOR > 4 || (Slicer_VERSION_MAJOR == 4 && Slicer_VERSION_MINOR >= 11)
+#define PATHEXPLORER_HAS_MARKUP_INTERACTION_EVENTS
+#endif
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_PathExplorer
 class Q_SLICER_MODULE_PATHEXPLORER_WIDGETS_EXPORT qSlicerPathExplorerMarkupsTableWidgetPrivate
@@ -48,6 +56,10 @@ class Q_SLICER_MODULE_PATHEXPLORER_WIDGETS_EXPORT qSlicerPathExplorerMarkupsTabl
   vtkMRMLMarkupsFiducialNode* FiducialNode;
   int CurrentMarkupSelected;
   double RGBA[3];
+  // A full refresh is requested but not done yet, rows may not match the markups until then
+  bool RefreshPending;
+  // A control point is being dragged
+  bool Interacting;
 };
 
 //-----------------------------------------------------------------------------
@@ -61,6 +73,8 @@ qSlicerPathExplorerMarkupsTableWidgetPrivate
   this->RGBA[0] = 1.0;
   this->RGBA[1] = 0.5;
   this->RGBA[2] = 0.5;
+  this->RefreshPending = false;
+  this->Interacting = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -133,16 +147,13 @@ void qSlicerPathExplorerMarkupsTableWidget
   if (d->FiducialNode)
     {
     // Disconnect signals
-    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::NthMarkupModifiedEvent,
-                         this, SLOT(onMarkupModified(vtkObject*, void*)));
-    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::PointModifiedEvent,
-                         this, SLOT(onMarkupModified(vtkObject*, void*)));
-    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::MarkupRemovedEvent,
-                         this, SLOT(refreshMarkupTable()));
+    this->connectMarkupEvents(false);
     }
 
   // Update FiducialNode with new markup list
   d->FiducialNode = markupList;
+  d->RefreshPending = false;
+  d->Interacting = false;
 
   // Populate table with existing markups
   this->populateTableWidget(markupList);
@@ -158,12 +169,45 @@ void qSlicerPathExplorerMarkupsTableWidget
     }
 
   // Connect signals to new node
-  this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::NthMarkupModifiedEvent,
-                    this, SLOT(onMarkupModified(vtkObject*, void*)));
-  this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::PointModifiedEvent,
-                    this, SLOT(onMarkupModified(vtkObject*, void*)));
-  this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::MarkupRemovedEvent,
-                    this, SLOT(refreshMarkupTable()));
+  this->connectMarkupEvents(true);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerMarkupsTableWidget
+::connectMarkupEvents(bool connect)
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+
+  if (connect)
+    {
+    this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::NthMarkupModifiedEvent,
+                      this, SLOT(onMarkupModified(vtkObject*, void*)));
+    this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::PointModifiedEvent,
+                      this, SLOT(onMarkupModified(vtkObject*, void*)));
+    this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::MarkupRemovedEvent,
+                      this, SLOT(requestMarkupTableRefresh()));
+#ifdef PATHEXPLORER_HAS_MARKUP_INTERACTION_EVENTS
+    this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::PointStartInteractionEvent,
+                      this, SLOT(onMarkupInteractionStarted()));
+    this->qvtkConnect(d->FiducialNode, vtkMRMLMarkupsNode::PointEndInteractionEvent,
+                      this, SLOT(onMarkupInteractionEnded()));
+#endif
+    }
+  else
+    {
+    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::NthMarkupModifiedEvent,
+                         this, SLOT(onMarkupModified(vtkObject*, void*)));
+    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::PointModifiedEvent,
+                         this, SLOT(onMarkupModified(vtkObject*, void*)));
+    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::MarkupRemovedEvent,
+                         this, SLOT(requestMarkupTableRefresh()));
+#ifdef PATHEXPLORER_HAS_MARKUP_INTERACTION_EVENTS
+    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::PointStartInteractionEvent,
+                         this, SLOT(onMarkupInteractionStarted()));
+    this->qvtkDisconnect(d->FiducialNode, vtkMRMLMarkupsNode::PointEndInteractionEvent,
+                         this, SLOT(onMarkupInteractionEnded()));
+#endif
+    }
 }
 
 
@@ -203,6 +247,8 @@ void qSlicerPathExplorerMarkupsTableWidget
 
   d->TableWidget->setRowCount(0);
   d->TableWidget->clearContents();
+  d->RefreshPending = false;
+  d->Interacting = false;
 
   this->qvtkDisconnectAll();
 }
@@ -402,28 +448,24 @@ void qSlicerPathExplorerMarkupsTableWidget
     markupIndex = *nPtr;
     }
 
-  // Update or add markup if doesn't exists in the widget
+  if (d->RefreshPending)
+    {
+    // Rows are rebuilt from the markups anyway
+    return;
+    }
+
+  // Update or add markup if doesn't exists in the widget.
+  // Only the row of the modified markup is patched, the rest of the table is not touched.
   if (d->FiducialNode->MarkupExists(markupIndex))
     {
-    Markup* modifiedMarkup = d->FiducialNode->GetNthMarkup(markupIndex);
-    if (modifiedMarkup)
+    int row = this->rowOfMarkup(markupIndex);
+    if (row < 0)
       {
-      // Check if node already in table
-      QAbstractItemModel* model = d->TableWidget->model();
-      if (model)
-	{
-	QModelIndexList found = model->match(model->index(0,Self::Name),
-					     Self::MarkupIndex, markupIndex, 
-					     1, Qt::MatchExactly);
-	if (found.isEmpty())
-	  {
-	  this->addMarkupInTable(d->FiducialNode, markupIndex);
-	  }
-	else
-	  {
-	  this->updateMarkupInTable(d->FiducialNode, markupIndex, found[0]);
-	  }
-	}
+      this->addMarkupInTable(d->FiducialNode, markupIndex);
+      }
+    else
+      {
+      this->updateMarkupInTable(d->FiducialNode, markupIndex, d->TableWidget->model()->index(row, Self::Name));
       }
     }
 }
@@ -442,9 +484,91 @@ void qSlicerPathExplorerMarkupsTableWidget
   // ISSUE: This slot is executed after markup is externally removed
   // It's not possible to get markup id or index before it gets removed
   // Require to clean and repopulate the table widget
+  d->RefreshPending = false;
   this->populateTableWidget(d->FiducialNode);
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerMarkupsTableWidget
+::requestMarkupTableRefresh()
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+
+  if (d->RefreshPending)
+    {
+    return;
+    }
+  // Removing many markups fires an event for each, the table is only rebuilt once
+  d->RefreshPending = true;
+  if (!d->Interacting)
+    {
+    QTimer::singleShot(0, this, SLOT(onDeferredRefresh()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerMarkupsTableWidget
+::onDeferredRefresh()
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+
+  if (!d->RefreshPending || d->Interacting)
+    {
+    return;
+    }
+  this->refreshMarkupTable();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerMarkupsTableWidget
+::onMarkupInteractionStarted()
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+  d->Interacting = true;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerMarkupsTableWidget
+::onMarkupInteractionEnded()
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+
+  d->Interacting = false;
+  if (d->RefreshPending)
+    {
+    this->refreshMarkupTable();
+    }
+}
+
+//-----------------------------------------------------------------------------
+int qSlicerPathExplorerMarkupsTableWidget
+::rowOfMarkup(int markupIndex)
+{
+  Q_D(qSlicerPathExplorerMarkupsTableWidget);
+
+  if (!d->TableWidget)
+    {
+    return -1;
+    }
+
+  // Rows are in markup order, so the row is usually the markup index
+  QTableWidgetItem* item = d->TableWidget->item(markupIndex, Self::Name);
+  if (item && item->data(Self::MarkupIndex).toInt() == markupIndex)
+    {
+    return markupIndex;
+    }
+
+  QAbstractItemModel* model = d->TableWidget->model();
+  if (!model)
+    {
+    return -1;
+    }
+  QModelIndexList found = model->match(model->index(0,Self::Name),
+                                       Self::MarkupIndex, markupIndex,
+                                       1, Qt::MatchExactly);
+  return found.isEmpty() ? -1 : found[0].row();
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerPathExplorerMarkupsTableWidget
 ::addMarkupInTable(vtkMRMLMarkupsFiducialNode* fNode, int markupIndex)
@@ -529,15 +653,31 @@ void qSlicerPathExplorerMarkupsTableWidget
   d->FiducialNode->GetNthFiducialPosition(markupIndex, ras);
 
 
+  // Both the point and the markup modified events are fired for a moved point,
+  // only items that actually change are set, and only a change is reported
   int row = index.row();
-  d->TableWidget->item(row, Self::Name)->setText(QString(markupName.c_str()));
-  d->TableWidget->item(row, Self::R)->setText(QString::number(ras[0],'f',2));
-  d->TableWidget->item(row, Self::A)->setText(QString::number(ras[1],'f',2));
-  d->TableWidget->item(row, Self::S)->setText(QString::number(ras[2],'f',2));
+  QString texts[4] = { QString(markupName.c_str()),
+                       QString::number(ras[0],'f',2),
+                       QString::number(ras[1],'f',2),
+                       QString::number(ras[2],'f',2) };
+  int columns[4] = { Self::Name, Self::R, Self::A, Self::S };
+  bool changed = false;
+  for (int i = 0; i < 4; ++i)
+    {
+    QTableWidgetItem* item = d->TableWidget->item(row, columns[i]);
+    if (item && item->text() != texts[i])
+      {
+      item->setText(texts[i]);
+      changed = true;
+      }
+    }
 
   d->TableWidget->blockSignals(state);
 
-  emit markupModified(d->FiducialNode, markupIndex);
+  if (changed)
+    {
+    emit markupModified(d->FiducialNode, markupIndex);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -82,6 +82,14 @@ public slots:
   // MarkupFiducialNode
   void onMarkupModified(vtkObject* /*caller*/, void* callData);
   void refreshMarkupTable();
+  // Coalesce full refreshes: the table is rebuilt once when control returns to the event loop,
+  // or when the interaction with a control point ends
+  void requestMarkupTableRefresh();
+  void onMarkupInteractionStarted();
+  void onMarkupInteractionEnded();
+
+protected slots:
+  void onDeferredRefresh();
 
 protected:
   QScopedPointer<qSlicerPathExplorerMarkupsTableWidgetPrivate> d_ptr;
@@ -89,6 +97,9 @@ protected:
   void addMarkupInTable(vtkMRMLMarkupsFiducialNode* fNode, int markupIndex);
   void updateMarkupInTable(vtkMRMLMarkupsFiducialNode* fNode, int markupIndex, QModelIndex index);
   void populateTableWidget(vtkMRMLMarkupsFiducialNode* markupList);  
+  // Returns the row of the markup, -1 if it is not in the table
+  int rowOfMarkup(int markupIndex);
+  void connectMarkupEvents(bool connect);
 
   enum ColumnType
   {
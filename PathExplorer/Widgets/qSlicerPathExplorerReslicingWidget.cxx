@@ -24,17 +24,28 @@
 #include "qSlicerPathExplorerReslicingWidget.h"
 #include "ui_qSlicerPathExplorerReslicingWidget.h"
 
+// PathExplorer Logic includes
+#include "vtkSlicerPathExplorerLogic.h"
+
 #include <vtkMRMLAnnotationLineDisplayNode.h>
 #include <vtkMRMLAnnotationRulerNode.h>
 #include <vtkMRMLSliceNode.h>
 
 #include "ctkPopupWidget.h"
 
+// Qt includes
+#include <QTimer>
+
 // VTK includes
-#include "vtkMath.h"
-#include "vtkNew.h"
+#include "vtkCollection.h"
+#include "vtkMatrix4x4.h"
 #include "vtkSmartPointer.h"
 
+// Minimum time between two reslicing of the slice view (about the render rate)
+static const int RESLICE_UPDATE_INTERVAL_MSEC = 16;
+// Maximum distance between two fly through frames
+static const double FLYTHROUGH_FRAME_SPACING_MM = 0.5;
+
 class qSlicerPathExplorerReslicingWidget;
 
 //-----------------------------------------------------------------------------
@@ -54,6 +65,16 @@ class Q_SLICER_MODULE_PATHEXPLORER_WIDGETS_EXPORT qSlicerPathExplorerReslicingWi
   void saveAttributesToViewer();
   void updateWidget();
 
+  // Reslice now if no reslicing happened recently, otherwise reslice
+  // with the latest values when the update interval is elapsed
+  void requestReslice();
+  void reslice();
+
+  // Fly through playback
+  void startPlayback();
+  void stopPlayback();
+  void updateFlyThroughMatrices();
+
  protected:
   qSlicerPathExplorerReslicingWidget * const   q_ptr;
   vtkMRMLSliceNode*                             SliceNode;
@@ -63,6 +84,12 @@ class Q_SLICER_MODULE_PATHEXPLORER_WIDGETS_EXPORT qSlicerPathExplorerReslicingWi
   double                                        ResliceAngle;
   double                                        ReslicePosition;
   bool                                          ReslicePerpendicular;
+  QTimer                                        ResliceTimer;
+  bool                                          ReslicePending;
+  QTimer                                        PlaybackTimer;
+  vtkSmartPointer<vtkCollection>                FlyThroughMatrices;
+  double                                        FlyThroughStartPosition;
+  int                                           FlyThroughFrame;
 };
 
 //-----------------------------------------------------------------------------
@@ -78,6 +105,10 @@ qSlicerPathExplorerReslicingWidgetPrivate
   this->ResliceAngle         = 0.0;
   this->ReslicePosition      = 0.0;
   this->ReslicePerpendicular = true;
+  this->ReslicePending       = false;
+  this->FlyThroughMatrices   = vtkSmartPointer<vtkCollection>::New();
+  this->FlyThroughStartPosition = 0.0;
+  this->FlyThroughFrame      = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -91,6 +122,76 @@ void qSlicerPathExplorerReslicingWidgetPrivate
 ::setupUi(qSlicerPathExplorerReslicingWidget* widget)
 {
   this->Ui_qSlicerPathExplorerReslicingWidget::setupUi(widget);
+  this->ResliceTimer.setSingleShot(true);
+  this->ResliceTimer.setInterval(RESLICE_UPDATE_INTERVAL_MSEC);
+  this->PlaybackTimer.setInterval(1000 / this->FrameRateSpinBox->value());
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidgetPrivate
+::startPlayback()
+{
+  if (!this->SliceNode || !this->ReslicingRulerNode || !this->ReslicePerpendicular)
+    {
+    this->stopPlayback();
+    return;
+    }
+
+  // Start from the current position, or from the entry if already at the target
+  this->FlyThroughStartPosition = this->ReslicePosition < 100.0 ? this->ReslicePosition : 0.0;
+  this->FlyThroughFrame = 0;
+  this->updateFlyThroughMatrices();
+  this->PlaybackTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidgetPrivate
+::stopPlayback()
+{
+  this->PlaybackTimer.stop();
+  this->FlyThroughMatrices->RemoveAllItems();
+  bool oldState = this->PlayButton->blockSignals(true);
+  this->PlayButton->setChecked(false);
+  this->PlayButton->blockSignals(oldState);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidgetPrivate
+::updateFlyThroughMatrices()
+{
+  // All frames are computed before playback, so that at each frame only the slice node has to be updated
+  vtkSlicerPathExplorerLogic::ComputeFlyThroughMatrices(this->ReslicingRulerNode,
+                                                       this->FlyThroughStartPosition, 100.0,
+                                                       FLYTHROUGH_FRAME_SPACING_MM,
+                                                       this->FlyThroughMatrices);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidgetPrivate
+::requestReslice()
+{
+  if (this->ResliceTimer.isActive())
+    {
+    this->ReslicePending = true;
+    return;
+    }
+  this->reslice();
+  this->ResliceTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidgetPrivate
+::reslice()
+{
+  this->ReslicePending = false;
+  if (!this->SliceNode || !this->ReslicingRulerNode)
+    {
+    return;
+    }
+  vtkSlicerPathExplorerLogic::ResliceAlongTrajectory(this->ReslicingRulerNode,
+                                                    this->SliceNode,
+                                                    this->ReslicePerpendicular,
+                                                    this->ReslicePerpendicular ? this->ReslicePosition : this->ResliceAngle);
 }
 
 //-----------------------------------------------------------------------------
@@ -202,6 +303,7 @@ void qSlicerPathExplorerReslicingWidgetPrivate
   this->ResliceSlider->setEnabled(enabled);
   this->ReslicePerpendicularRadioButton->setEnabled(enabled);
   this->ResliceInPlaneRadioButton->setEnabled(enabled);
+  this->PlayButton->setEnabled(enabled && this->ReslicePerpendicular);
 
   // Update slider
   this->ResliceSlider->setMinimum(sliderMinimum);
@@ -289,6 +391,16 @@ qSlicerPathExplorerReslicingWidget
   connect(d->ReslicePerpendicularRadioButton, SIGNAL(toggled(bool)),
           this, SLOT(onPerpendicularToggled(bool)));
 
+  connect(d->PlayButton, SIGNAL(toggled(bool)),
+          this, SLOT(onPlayToggled(bool)));
+  connect(d->FrameRateSpinBox, SIGNAL(valueChanged(int)),
+          this, SLOT(onFrameRateChanged(int)));
+
+  connect(&d->ResliceTimer, SIGNAL(timeout()),
+          this, SLOT(onResliceTimeout()));
+  connect(&d->PlaybackTimer, SIGNAL(timeout()),
+          this, SLOT(onPlaybackTimeout()));
+
   connect(this, SIGNAL(mrmlSceneChanged(vtkMRMLScene*)),
 	  this, SLOT(onMRMLSceneChanged(vtkMRMLScene*)));
 }
@@ -314,6 +426,8 @@ void qSlicerPathExplorerReslicingWidget
     return;
     }
 
+  d->stopPlayback();
+
   if (d->ReslicingRulerNode)
     {
     // If previous trajectory, save values as attributes before changing it
@@ -355,6 +469,7 @@ void qSlicerPathExplorerReslicingWidget
 
   if (callData == d->ReslicingRulerNode)
     {
+    d->stopPlayback();
     d->ReslicingRulerNode = NULL;
     }
 }
@@ -370,10 +485,15 @@ void qSlicerPathExplorerReslicingWidget
     return;
     }
 
-  this->resliceWithRuler(d->ReslicingRulerNode,
-			 d->SliceNode,
-			 d->ReslicePerpendicular,
-			 d->ReslicePerpendicular ? d->ReslicePosition : d->ResliceAngle);
+  if (d->PlaybackTimer.isActive())
+    {
+    // Continue playback along the modified trajectory
+    d->updateFlyThroughMatrices();
+    return;
+    }
+
+  // Ruler points may be moved interactively, reslice at most at render rate
+  d->requestReslice();
 }
 
 //-----------------------------------------------------------------------------
@@ -400,10 +520,7 @@ void qSlicerPathExplorerReslicingWidget
     d->SliceNode->SetAttribute("PathExplorer.DrivingPathName",d->ReslicingRulerNode->GetName());
     d->updateWidget();
 
-    this->resliceWithRuler(d->ReslicingRulerNode,
-                           d->SliceNode,
-                           d->ReslicePerpendicular,
-                           d->ReslicePerpendicular ? d->ReslicePosition : d->ResliceAngle);
+    d->reslice();
 
     this->qvtkConnect(d->ReslicingRulerNode, vtkCommand::ModifiedEvent,
 		      this, SLOT(onRulerModified()));
@@ -414,9 +531,13 @@ void qSlicerPathExplorerReslicingWidget
     d->ResliceSlider->setEnabled(0);
     d->ReslicePerpendicularRadioButton->setEnabled(0);
     d->ResliceInPlaneRadioButton->setEnabled(0);
+    d->PlayButton->setEnabled(0);
+    d->stopPlayback();
 
     this->qvtkDisconnect(d->ReslicingRulerNode, vtkCommand::ModifiedEvent,
 			 this, SLOT(onRulerModified()));
+    d->ResliceTimer.stop();
+    d->ReslicePending = false;
     }
 }
 
@@ -432,12 +553,14 @@ void qSlicerPathExplorerReslicingWidget
     }
 
   d->ReslicePerpendicular = status;
+  if (!status)
+    {
+    // Fly through is only available with perpendicular reslicing
+    d->stopPlayback();
+    }
   d->updateWidget();
 
-  this->resliceWithRuler(d->ReslicingRulerNode,
-                         d->SliceNode,
-                         d->ReslicePerpendicular,
-                         d->ReslicePerpendicular ? d->ReslicePosition : d->ResliceAngle);
+  d->reslice();
 }
 
 //-----------------------------------------------------------------------------
@@ -451,6 +574,9 @@ void qSlicerPathExplorerReslicingWidget
     return;
     }
 
+  // Moving the slider manually ends playback
+  d->stopPlayback();
+
   if (d->ReslicePerpendicular)
     {
     d->ReslicePosition = resliceValue;
@@ -467,88 +593,102 @@ void qSlicerPathExplorerReslicingWidget
 
   if (d->ResliceButton->isChecked())
     {
-    this->resliceWithRuler(d->ReslicingRulerNode,
-                           d->SliceNode,
-                           d->ReslicePerpendicular,
-                           d->ReslicePerpendicular ? d->ReslicePosition : d->ResliceAngle);
+    // Slider may be dragged faster than the slice view can be rendered
+    d->requestReslice();
     }
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerPathExplorerReslicingWidget
-::resliceWithRuler(vtkMRMLAnnotationRulerNode* ruler,
-                   vtkMRMLSliceNode* viewer,
-                   bool perpendicular,
-                   double resliceValue)
+::onResliceTimeout()
 {
-  if (!ruler || !viewer)
+  Q_D(qSlicerPathExplorerReslicingWidget);
+
+  if (!d->ReslicePending)
     {
     return;
     }
+  if (!d->ResliceButton->isChecked())
+    {
+    d->ReslicePending = false;
+    return;
+    }
+  // Apply the latest values and wait again, to keep coalescing while values are changing
+  d->reslice();
+  d->ResliceTimer.start();
+}
 
-  // Get ruler points
-  double point1[4] = {0,0,0,0};
-  double point2[4] = {0,0,0,0};
-  ruler->GetPositionWorldCoordinates1(point1);
-  ruler->GetPositionWorldCoordinates2(point2);
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidget
+::onPlayToggled(bool play)
+{
+  Q_D(qSlicerPathExplorerReslicingWidget);
 
-  // Compute vectors
-  double t[3];
-  double n[3];
-  double pos[3];
-  if (perpendicular)
+  if (play)
     {
-    // Ruler vector is normal vector
-    n[0] = point2[0] - point1[0];
-    n[1] = point2[1] - point1[1];
-    n[2] = point2[2] - point1[2];
-
-    // Reslice at chosen position
-    pos[0] = point1[0] + n[0] * resliceValue / 100;
-    pos[1] = point1[1] + n[1] * resliceValue / 100;
-    pos[2] = point1[2] + n[2] * resliceValue / 100;
+    d->startPlayback();
+    }
+  else
+    {
+    d->stopPlayback();
+    }
+}
 
-    // Normalize
-    double nlen = vtkMath::Normalize(n);
-    n[0] /= nlen;
-    n[1] /= nlen;
-    n[2] /= nlen;
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidget
+::onFrameRateChanged(int framesPerSecond)
+{
+  Q_D(qSlicerPathExplorerReslicingWidget);
 
-    // angle in radian
-    vtkMath::Perpendiculars(n, t, NULL, 0);
+  if (framesPerSecond <= 0)
+    {
+    return;
     }
-  else
+  // Takes effect immediately if playing
+  d->PlaybackTimer.setInterval(1000 / framesPerSecond);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidget
+::onPlaybackTimeout()
+{
+  Q_D(qSlicerPathExplorerReslicingWidget);
+
+  int numberOfFrames = d->FlyThroughMatrices->GetNumberOfItems();
+  if (!d->SliceNode || !d->ReslicingRulerNode || d->FlyThroughFrame >= numberOfFrames)
     {
-    // Ruler vector is transverse vector
-    t[0] = point2[0] - point1[0];
-    t[1] = point2[1] - point1[1];
-    t[2] = point2[2] - point1[2];
-
-    // Reslice at target position
-    pos[0] = point2[0];
-    pos[1] = point2[1];
-    pos[2] = point2[2];
-
-    // Normalize
-    double tlen = vtkMath::Normalize(t);
-    t[0] /= tlen;
-    t[1] /= tlen;
-    t[2] /= tlen;
-
-    // angle in radian
-    vtkMath::Perpendiculars(t, n, NULL, resliceValue*vtkMath::Pi()/180);
-    }
-
-  double nx = n[0];
-  double ny = n[1];
-  double nz = n[2];
-  double tx = t[0];
-  double ty = t[1];
-  double tz = t[2];
-  double px = pos[0];
-  double py = pos[1];
-  double pz = pos[2];
-
-  viewer->SetSliceToRASByNTP(nx, ny, nz, tx, ty, tz, px, py, pz, 0);
+    d->stopPlayback();
+    return;
+    }
+
+  // Every frame is shown (frames are not skipped if rendering is slower than the frame rate)
+  vtkMatrix4x4* sliceToRas = vtkMatrix4x4::SafeDownCast(d->FlyThroughMatrices->GetItemAsObject(d->FlyThroughFrame));
+  vtkSlicerPathExplorerLogic::SetSliceToRAS(d->SliceNode, sliceToRas);
+
+  // Update slider and labels to show current position
+  d->ReslicePosition = numberOfFrames > 1 ?
+    d->FlyThroughStartPosition + (100.0 - d->FlyThroughStartPosition) * d->FlyThroughFrame / (numberOfFrames - 1) :
+    100.0;
+  bool sliderOldState = d->ResliceSlider->blockSignals(true);
+  d->ResliceSlider->setValue(static_cast<int>(d->ReslicePosition + 0.5));
+  d->ResliceSlider->blockSignals(sliderOldState);
+  double distanceValue = d->ReslicingRulerNode->GetDistanceMeasurement() * d->ReslicePosition / 100;
+  d->ResliceValueLabel->setText(QString::number(distanceValue, 'f', 2));
+
+  d->FlyThroughFrame++;
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerReslicingWidget
+::resliceWithRuler(vtkMRMLAnnotationRulerNode* ruler,
+                   vtkMRMLSliceNode* viewer,
+                   bool perpendicular,
+                   double resliceValue)
+{
+  if (!ruler || !viewer)
+    {
+    return;
+    }
+
+  vtkSlicerPathExplorerLogic::ResliceAlongTrajectory(ruler, viewer, perpendicular, resliceValue);
+}
@@ -59,11 +59,17 @@ class Q_SLICER_MODULE_PATHEXPLORER_WIDGETS_EXPORT qSlicerPathExplorerReslicingWi
   void onPerpendicularToggled(bool status);
   void onResliceValueChanged(int resliceValue);
   void onRulerModified();
+  void onPlayToggled(bool play);
+  void onFrameRateChanged(int framesPerSecond);
   void resliceWithRuler(vtkMRMLAnnotationRulerNode* ruler,
                         vtkMRMLSliceNode* viewer,
                         bool perpendicular,
                         double resliceValue);
 
+ protected slots:
+  void onResliceTimeout();
+  void onPlaybackTimeout();
+
  protected:
   QScopedPointer<qSlicerPathExplorerReslicingWidgetPrivate> d_ptr;
 
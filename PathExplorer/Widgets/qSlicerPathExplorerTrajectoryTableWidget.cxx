@@ -26,6 +26,11 @@
 #include "qSlicerPathExplorerTrajectoryTableWidget.h"
 #include "ui_qSlicerPathExplorerTrajectoryTableWidget.h"
 
+// Qt includes
+#include <QDebug>
+#include <QPair>
+#include <QSet>
+
 // VTK includes
 #include "vtkMRMLAnnotationHierarchyNode.h"
 #include "vtkMRMLInteractionNode.h"
@@ -157,34 +162,121 @@ void qSlicerPathExplorerTrajectoryTableWidget
     return;
     }
 
-  // Check if such trajectory already exists
-  QAbstractItemModel* model = d->TableWidget->model();
-  if (model)
+  if (this->trajectoryExists(d->SelectedEntryMarkupIndex, d->SelectedTargetMarkupIndex))
     {
-    QModelIndexList found = model->match(model->index(0,Self::EntryName),
-					 Self::EntryIndex, d->SelectedEntryMarkupIndex, 
-					 -1, Qt::MatchExactly);
+    // Found trajectory with same entry and target points
+    return;
+    }
 
-    for (int i = 0; i < found.count(); ++i)
+  // Add new trajectory
+  vtkMRMLAnnotationRulerNode* ruler = this->createTrajectoryRuler(d->SelectedEntryMarkupIndex, d->SelectedTargetMarkupIndex);
+
+  // Update TableWidget
+  int rowCount = d->TableWidget->rowCount();
+  d->TableWidget->insertRow(rowCount);
+  this->setTrajectoryRow(rowCount, ruler, d->SelectedEntryMarkupIndex, d->SelectedTargetMarkupIndex);
+  
+  d->TableWidget->selectRow(rowCount);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerTrajectoryTableWidget
+::addTrajectories(const QList<int>& entryMarkupIndices, const QList<int>& targetMarkupIndices)
+{
+  Q_D(qSlicerPathExplorerTrajectoryTableWidget);
+
+  if (!this->mrmlScene() || !d->TableWidget ||
+      !d->EntryNode || !d->TargetNode ||
+      !d->TrajectoryNode)
+    {
+    return;
+    }
+
+  if (entryMarkupIndices.count() != targetMarkupIndices.count())
+    {
+    qWarning() << Q_FUNC_INFO << ": number of entry and target markups must be the same";
+    return;
+    }
+
+  // Existing trajectories, to find duplicates without searching the table for each new pair
+  QSet< QPair<int,int> > trajectories;
+  for (int row = 0; row < d->TableWidget->rowCount(); ++row)
+    {
+    trajectories.insert(qMakePair(
+      d->TableWidget->item(row, Self::EntryName)->data(Self::EntryIndex).toInt(),
+      d->TableWidget->item(row, Self::TargetName)->data(Self::TargetIndex).toInt()));
+    }
+
+  QList< vtkMRMLAnnotationRulerNode* > newRulers;
+  QList< QPair<int,int> > newTrajectories;
+  this->mrmlScene()->StartState(vtkMRMLScene::BatchProcessState);
+  for (int i = 0; i < entryMarkupIndices.count(); ++i)
+    {
+    QPair<int,int> trajectory = qMakePair(entryMarkupIndices[i], targetMarkupIndices[i]);
+    if (!d->EntryNode->MarkupExists(trajectory.first) ||
+        !d->TargetNode->MarkupExists(trajectory.second) ||
+        trajectories.contains(trajectory))
       {
-      int row = found[i].row();
-      if (row >= 0)
+      continue;
+      }
+    trajectories.insert(trajectory);
+    newRulers << this->createTrajectoryRuler(trajectory.first, trajectory.second);
+    newTrajectories << trajectory;
+    }
+  this->mrmlScene()->EndState(vtkMRMLScene::BatchProcessState);
+
+  // Fill all new rows at once. Signals are blocked so that onCellChanged is not called for each item.
+  bool wasBlocked = d->TableWidget->blockSignals(true);
+  d->TableWidget->setUpdatesEnabled(false);
+  int firstNewRow = d->TableWidget->rowCount();
+  d->TableWidget->setRowCount(firstNewRow + newRulers.count());
+  for (int i = 0; i < newRulers.count(); ++i)
+    {
+    this->setTrajectoryRow(firstNewRow + i, newRulers[i], newTrajectories[i].first, newTrajectories[i].second);
+    }
+  d->TableWidget->setUpdatesEnabled(true);
+  d->TableWidget->blockSignals(wasBlocked);
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerPathExplorerTrajectoryTableWidget
+::trajectoryExists(int entryMarkupIndex, int targetMarkupIndex)
+{
+  Q_D(qSlicerPathExplorerTrajectoryTableWidget);
+
+  QAbstractItemModel* model = d->TableWidget->model();
+  if (!model)
+    {
+    return false;
+    }
+  QModelIndexList found = model->match(model->index(0,Self::EntryName),
+				       Self::EntryIndex, entryMarkupIndex, 
+				       -1, Qt::MatchExactly);
+  for (int i = 0; i < found.count(); ++i)
+    {
+    int row = found[i].row();
+    if (row >= 0)
+      {
+      int tmpTargetIndex = d->TableWidget->item(row, Self::TargetName)->data(Self::TargetIndex).toInt();
+      if (tmpTargetIndex == targetMarkupIndex)
 	{
-	int tmpTargetIndex = d->TableWidget->item(row, Self::TargetName)->data(Self::TargetIndex).toInt();
-	if (tmpTargetIndex == d->SelectedTargetMarkupIndex)
-	  {
-	  // Found trajectory with same entry and target points
-	  return;
-	  }
+	return true;
 	}
       }
     }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLAnnotationRulerNode* qSlicerPathExplorerTrajectoryTableWidget
+::createTrajectoryRuler(int entryMarkupIndex, int targetMarkupIndex)
+{
+  Q_D(qSlicerPathExplorerTrajectoryTableWidget);
 
-  // Add new trajectory
   double entryMarkupPosition[3];
-  d->EntryNode->GetNthFiducialPosition(d->SelectedEntryMarkupIndex, entryMarkupPosition);
+  d->EntryNode->GetNthFiducialPosition(entryMarkupIndex, entryMarkupPosition);
   double targetMarkupPosition[3];
-  d->TargetNode->GetNthFiducialPosition(d->SelectedTargetMarkupIndex, targetMarkupPosition);
+  d->TargetNode->GetNthFiducialPosition(targetMarkupIndex, targetMarkupPosition);
 
   vtkSmartPointer<vtkMRMLAnnotationRulerNode> ruler = 
     vtkSmartPointer<vtkMRMLAnnotationRulerNode>::New();
@@ -195,25 +287,29 @@ void qSlicerPathExplorerTrajectoryTableWidget
   this->qvtkConnect(ruler.GetPointer(), vtkCommand::ModifiedEvent,
 		    this, SLOT(onRulerModified(vtkObject*)));
 
-  // Update TableWidget
-  int rowCount = d->TableWidget->rowCount();
-  d->TableWidget->insertRow(rowCount);
-  
+  // The scene keeps a reference to the ruler
+  return ruler.GetPointer();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathExplorerTrajectoryTableWidget
+::setTrajectoryRow(int row, vtkMRMLAnnotationRulerNode* ruler, int entryMarkupIndex, int targetMarkupIndex)
+{
+  Q_D(qSlicerPathExplorerTrajectoryTableWidget);
+
   QTableWidgetItem* rulerItem  = new QTableWidgetItem(QString(ruler->GetName()));
-  QTableWidgetItem* entryItem  = new QTableWidgetItem(d->EntryNode->GetNthMarkupLabel(d->SelectedEntryMarkupIndex).c_str());
-  QTableWidgetItem* targetItem = new QTableWidgetItem(d->TargetNode->GetNthMarkupLabel(d->SelectedTargetMarkupIndex).c_str());
+  QTableWidgetItem* entryItem  = new QTableWidgetItem(d->EntryNode->GetNthMarkupLabel(entryMarkupIndex).c_str());
+  QTableWidgetItem* targetItem = new QTableWidgetItem(d->TargetNode->GetNthMarkupLabel(targetMarkupIndex).c_str());
   rulerItem->setData(Self::RulerID, ruler->GetID());
-  entryItem->setData(Self::EntryIndex, d->SelectedEntryMarkupIndex);
-  targetItem->setData(Self::TargetIndex, d->SelectedTargetMarkupIndex);
+  entryItem->setData(Self::EntryIndex, entryMarkupIndex);
+  targetItem->setData(Self::TargetIndex, targetMarkupIndex);
 
   entryItem->setFlags(entryItem->flags() & ~Qt::ItemIsEditable);
   targetItem->setFlags(targetItem->flags() & ~Qt::ItemIsEditable);
 
-  d->TableWidget->setItem(rowCount, Self::RulerName, rulerItem);
-  d->TableWidget->setItem(rowCount, Self::EntryName, entryItem);
-  d->TableWidget->setItem(rowCount, Self::TargetName, targetItem);
-  
-  d->TableWidget->selectRow(rowCount);
+  d->TableWidget->setItem(row, Self::RulerName, rulerItem);
+  d->TableWidget->setItem(row, Self::EntryName, entryItem);
+  d->TableWidget->setItem(row, Self::TargetName, targetItem);
 }
 
 //-----------------------------------------------------------------------------
@@ -310,6 +406,8 @@ void qSlicerPathExplorerTrajectoryTableWidget
      return;
      }
 
+   // Remove all rulers in one batch, so that the GUI is not updated after each removal
+   this->mrmlScene()->StartState(vtkMRMLScene::BatchProcessState);
    int rowCount = d->TableWidget->rowCount();
    for (int i = 0; i < rowCount; ++i)
      {
@@ -320,6 +418,7 @@ void qSlicerPathExplorerTrajectoryTableWidget
        this->mrmlScene()->RemoveNode(rulerNode);
        }
      }
+   this->mrmlScene()->EndState(vtkMRMLScene::BatchProcessState);
    d->TableWidget->setRowCount(0);
    d->TableWidget->clearContents();
 }
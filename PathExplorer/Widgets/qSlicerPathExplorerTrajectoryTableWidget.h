@@ -42,6 +42,7 @@
 #include "vtkSlicerAnnotationModuleLogic.h"
 
 // Qt includes
+#include <QList>
 #include <QTableWidget>
 #include <QTime>
 
@@ -74,6 +75,12 @@ public slots:
   void onMRMLSceneClosed();
   void onRulerModified(vtkObject* caller);
 
+  // Create one trajectory for each entry and target markup index pair (the lists must have the same length).
+  // Rulers are added to the scene in one batch and the table is filled at once,
+  // so hundreds of trajectories can be added without updating the GUI for each.
+  // Pairs that already have a trajectory are skipped.
+  void addTrajectories(const QList<int>& entryMarkupIndices, const QList<int>& targetMarkupIndices);
+
   // GUI
   void onAddButtonClicked();
   void onRemoveButtonClicked();
@@ -109,6 +116,13 @@ protected:
     TargetIndex
   };
 
+  // Create a ruler between the entry and target markups and add it to the scene
+  vtkMRMLAnnotationRulerNode* createTrajectoryRuler(int entryMarkupIndex, int targetMarkupIndex);
+  // Set the items of a row (the row must already exist)
+  void setTrajectoryRow(int row, vtkMRMLAnnotationRulerNode* ruler, int entryMarkupIndex, int targetMarkupIndex);
+  // Returns true if the table already contains a trajectory between the entry and target markups
+  bool trajectoryExists(int entryMarkupIndex, int targetMarkupIndex);
+
 private:
   Q_DECLARE_PRIVATE(qSlicerPathExplorerTrajectoryTableWidget);
   Q_DISABLE_COPY(qSlicerPathExplorerTrajectoryTableWidget);
@@ -25,14 +25,22 @@
 // VTK includes
 #include <vtkNew.h>
 #include <vtkSmartPointer.h>
+#include <vtkCollection.h>
 #include <vtkCommand.h>
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkObjectFactory.h>
+#include <vtkStringArray.h>
+#include <vtkTable.h>
 #include <vtkTransform.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <sstream>
 
 // VNL includes
 #include "vnl/algo/vnl_symmetric_eigensystem.h"
@@ -42,6 +50,21 @@
 
 
 static const double PARALLEL_ANGLE_THRESHOLD_DEGREES = 20.0;
+static const unsigned int MINIMUM_NUMBER_OF_CALIBRATION_MATRICES = 10;
+// Number of samples that can be recorded without reallocation (30 seconds at 100Hz)
+static const unsigned int INITIAL_TOOL_TO_REFERENCE_MATRIX_CAPACITY = 3000;
+// Singular values of the pivot calibration matrix below this value are discarded (the normal
+// matrix has the squares of the singular values, therefore the threshold is squared there)
+static const double PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD = 1e-1;
+// Robust calibration: maximum number of outlier rejection iterations
+static const int ROBUST_CALIBRATION_MAXIMUM_NUMBER_OF_ITERATIONS = 10;
+// Robust calibration: residuals below these values are never considered as outliers
+// (to avoid rejecting samples because of numerical noise on perfect data)
+static const double ROBUST_PIVOT_MINIMUM_OUTLIER_THRESHOLD_MM = 0.05;
+static const double ROBUST_SPIN_MINIMUM_OUTLIER_THRESHOLD = 1e-3;
+// Incremental spin calibration: the rotation axis is not determined if the two smallest eigenvalues
+// of the spin calibration normal matrix are closer than this value (e.g., the tool has not been rotated yet)
+static const double SPIN_CALIBRATION_MINIMUM_EIGENVALUE_GAP = 1e-6;
 // Note: If the needle orientation protocol changes, only the definitions of shaftAxis and secondaryAxes need to be changed
 // Define the shaft axis and the secondary shaft axis
 // Current needle orientation protocol dictates: shaft axis -z, orthogonal axis +x
@@ -50,6 +73,72 @@ static const double SHAFT_AXIS[ 3 ] = { 0, 0, -1 };
 static const double ORTHOGONAL_AXIS[ 3 ] = { 1, 0, 0 };
 static const double BACKUP_AXIS[ 3 ] = { 0, 1, 0 };
 
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Input and output of a single tool calibration in batch calibration
+  struct BatchCalibrationItem
+  {
+    vtkSmartPointer<vtkSlicerPivotCalibrationLogic> Calibrator;
+    vtkDoubleArray* ToolToReferenceMatrices;
+    bool PivotSucceeded;
+    bool SpinSucceeded;
+    std::string ErrorText;
+    BatchCalibrationItem() : ToolToReferenceMatrices(NULL), PivotSucceeded(false), SpinSucceeded(false) {}
+  };
+
+  struct BatchCalibrationJob
+  {
+    std::vector<BatchCalibrationItem> Items;
+    bool ComputePivot;
+    bool ComputeSpin;
+    bool SnapRotation;
+  };
+
+  //----------------------------------------------------------------------------
+  VTK_THREAD_RETURN_TYPE BatchCalibrationThreadFunction( void* ptr )
+  {
+    vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+    BatchCalibrationJob* job = static_cast< BatchCalibrationJob* >( threadInfo->UserData );
+    vtkNew<vtkMatrix4x4> toolToReferenceMatrix;
+    double toolToReferenceMatrixElements[ 16 ];
+    // Each thread processes every NumberOfThreads-th tool
+    for ( unsigned int itemIndex = threadInfo->ThreadID; itemIndex < job->Items.size(); itemIndex += threadInfo->NumberOfThreads )
+    {
+      BatchCalibrationItem& item = job->Items[ itemIndex ];
+      vtkIdType numberOfMatrices = item.ToolToReferenceMatrices->GetNumberOfTuples();
+      for ( vtkIdType matrixIndex = 0; matrixIndex < numberOfMatrices; matrixIndex++ )
+      {
+        // GetTuple with output buffer is used, as GetTuple( index ) may use the array's internal buffer
+        item.ToolToReferenceMatrices->GetTuple( matrixIndex, toolToReferenceMatrixElements );
+        toolToReferenceMatrix->DeepCopy( toolToReferenceMatrixElements );
+        item.Calibrator->AddToolToReferenceMatrix( toolToReferenceMatrix.GetPointer() );
+      }
+      if ( job->ComputePivot )
+      {
+        item.PivotSucceeded = item.Calibrator->ComputePivotCalibration();
+        if ( !item.PivotSucceeded )
+        {
+          item.ErrorText = "Pivot calibration failed: " + item.Calibrator->GetErrorText();
+        }
+      }
+      if ( job->ComputeSpin )
+      {
+        item.SpinSucceeded = item.Calibrator->ComputeSpinCalibration( job->SnapRotation );
+        if ( !item.SpinSucceeded )
+        {
+          if ( !item.ErrorText.empty() )
+          {
+            item.ErrorText += ". ";
+          }
+          item.ErrorText += "Spin calibration failed: " + item.Calibrator->GetErrorText();
+        }
+      }
+    }
+    return VTK_THREAD_RETURN_VALUE;
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerPivotCalibrationLogic);
 
@@ -57,15 +146,53 @@ vtkStandardNewMacro(vtkSlicerPivotCalibrationLogic);
 vtkSlicerPivotCalibrationLogic::vtkSlicerPivotCalibrationLogic()
 {
   this->ToolTipToToolMatrix = vtkMatrix4x4::New();
+  this->RecordedToolToReferenceMatrix = vtkMatrix4x4::New();
   this->ObservedTransformNode = NULL;
+  this->MaximumNumberOfToolToReferenceMatrices = 0;
+  this->NumberOfToolToReferenceMatrices = 0;
+  this->FirstToolToReferenceMatrixIndex = 0;
+  this->MaximumToolOrientationDifferenceDeg = 0;
+  this->MaximumToolOrientationDifferenceValid = true;
+  std::fill( this->OrientationReferenceRotation, this->OrientationReferenceRotation + 9, 0.0 );
+  this->OrientationReferenceValid = false;
+  this->MaximumOrientationDifferenceFromReferenceDeg = 0;
+  this->OrientationDifferenceWitnessStorageIndex = 0;
+  this->OrientationDifferenceWitnessValid = false;
+  this->ToolToReferenceRotations.reserve( 9 * INITIAL_TOOL_TO_REFERENCE_MATRIX_CAPACITY );
+  this->ToolToReferenceTranslations.reserve( 3 * INITIAL_TOOL_TO_REFERENCE_MATRIX_CAPACITY );
   this->MinimumOrientationDifferenceDeg = 15.0;
+  this->PivotNormalMatrix.set_size( 6, 6 );
+  this->PivotNormalMatrix.fill( 0 );
+  this->PivotNormalVector.set_size( 6 );
+  this->PivotNormalVector.fill( 0 );
+  this->PivotSumOfSquaredTranslations = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->IncrementalToolTipToToolTranslation[ i ] = 0;
+    this->IncrementalPivotPoint_Reference[ i ] = 0;
+  }
+  this->IncrementalPivotRMSE = 0;
+  this->IncrementalToolTipPositionUncertaintyMm = 0;
+  std::fill( this->SpinNormalMatrix, this->SpinNormalMatrix + 9, 0.0 );
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->IncrementalShaftAxis_ToolTip[ i ] = SHAFT_AXIS[ i ];
+  }
+  this->IncrementalSpinRMSE = 0;
+  this->AutoStopRecording = false;
+  this->AutoStopToolTipPositionUncertaintyThresholdMm = 0.1;
+  this->RobustCalibration = false;
+  this->OutlierRejectionFactor = 3.0;
+  this->NumberOfInlierSamples = 0;
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerPivotCalibrationLogic::~vtkSlicerPivotCalibrationLogic()
 {
+  this->RemoveAllTools();
   this->ClearToolToReferenceMatrices();
   this->ToolTipToToolMatrix->Delete();
+  this->RecordedToolToReferenceMatrix->Delete();
   this->SetAndObserveTransformNode( NULL ); // Remove the observer
 }
 
@@ -73,47 +200,487 @@ vtkSlicerPivotCalibrationLogic::~vtkSlicerPivotCalibrationLogic()
 void vtkSlicerPivotCalibrationLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf( os, indent );
+  os << indent << "RecordingState: " << this->RecordingState << std::endl;
+  os << indent << "NumberOfToolToReferenceMatrices: " << this->NumberOfToolToReferenceMatrices << std::endl;
+  os << indent << "NumberOfTools: " << this->ToolTransformNodes.size() << std::endl;
+  for ( std::vector< vtkMRMLLinearTransformNode* >::iterator toolIt = this->ToolTransformNodes.begin(); toolIt != this->ToolTransformNodes.end(); ++toolIt )
+  {
+    vtkSlicerPivotCalibrationLogic* calibrator = this->ToolCalibrators[ *toolIt ];
+    os << indent << " " << ( ( *toolIt )->GetName() ? ( *toolIt )->GetName() : "(unnamed)" ) << ": "
+      << calibrator->GetNumberOfToolToReferenceMatrices() << " transforms, recording: " << calibrator->GetRecordingState() << std::endl;
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::SetMRMLSceneInternal( vtkMRMLScene* newScene )
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkMRMLScene::NodeRemovedEvent );
+  this->SetAndObserveMRMLSceneEventsInternal( newScene, events.GetPointer() );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
+{
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast( node );
+  if ( transformNode == NULL )
+  {
+    return;
+  }
+  if ( this->ToolCalibrators.find( transformNode ) != this->ToolCalibrators.end() )
+  {
+    this->RemoveTool( transformNode );
+    this->Modified();
+  }
+  if ( transformNode == this->ObservedTransformNode )
+  {
+    this->SetAndObserveTransformNode( NULL );
+  }
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPivotCalibrationLogic::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* vtkNotUsed(callData))
 {
-  if (caller != NULL)
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(caller);
+  if ( transformNode == NULL || event != vtkMRMLLinearTransformNode::TransformModifiedEvent || !this->RecordingState )
   {
-    vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(caller);
-    if ( event == vtkMRMLLinearTransformNode::TransformModifiedEvent && this->RecordingState == true && strcmp( transformNode->GetID(), this->ObservedTransformNode->GetID() ) == 0 )
+    return;
+  }
+
+  if ( transformNode == this->ObservedTransformNode )
+  {
+    if ( this->RecordToolToReferenceTransform( transformNode ) )
+    {
+      this->InvokeEvent( RecordingAutoStoppedEvent );
+    }
+  }
+
+  std::map< vtkMRMLLinearTransformNode*, vtkSmartPointer< vtkSlicerPivotCalibrationLogic > >::iterator toolIt = this->ToolCalibrators.find( transformNode );
+  if ( toolIt == this->ToolCalibrators.end() || !toolIt->second->GetRecordingState() )
+  {
+    return;
+  }
+  if ( toolIt->second->RecordToolToReferenceTransform( transformNode ) )
+  {
+    this->InvokeEvent( ToolRecordingAutoStoppedEvent, transformNode );
+    for ( toolIt = this->ToolCalibrators.begin(); toolIt != this->ToolCalibrators.end(); ++toolIt )
     {
-      vtkMatrix4x4* matrixCopy = vtkMatrix4x4::New();
-      transformNode->GetMatrixTransformToParent(matrixCopy);      
-      this->AddToolToReferenceMatrix(matrixCopy);
+      if ( toolIt->second->GetRecordingState() )
+      {
+        // other tools are still recorded
+        return;
+      }
     }
+    this->SetRecordingState( false );
+    this->InvokeEvent( RecordingAutoStoppedEvent );
+  }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::RecordToolToReferenceTransform( vtkMRMLLinearTransformNode* transformNode )
+{
+  transformNode->GetMatrixTransformToParent(this->RecordedToolToReferenceMatrix);
+  this->AddToolToReferenceMatrix(this->RecordedToolToReferenceMatrix);
+  bool spinUpdated = this->ComputeIncrementalSpinCalibration();
+  bool pivotUpdated = this->ComputeIncrementalPivotCalibration();
+  if ( !pivotUpdated && !spinUpdated )
+  {
+    return false;
+  }
+  this->Modified(); // live estimate is updated
+  if ( pivotUpdated && this->AutoStopRecording
+    && this->IncrementalToolTipPositionUncertaintyMm < this->AutoStopToolTipPositionUncertaintyThresholdMm
+    && this->IsToolOrientationDifferenceSufficient() )
+  {
+    this->SetRecordingState( false );
+    return true;
   }
+  return false;
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPivotCalibrationLogic::SetAndObserveTransformNode( vtkMRMLLinearTransformNode* transformNode )
 {
+  vtkMRMLLinearTransformNode* previousTransformNode = this->ObservedTransformNode;
+  if ( transformNode != NULL && transformNode != previousTransformNode
+    && this->ToolCalibrators.find( transformNode ) != this->ToolCalibrators.end() )
+  {
+    // already observed as a tool, avoid receiving each event twice
+    vtkUnObserveMRMLNodeMacro( transformNode );
+  }
   vtkNew<vtkIntArray> events;
   events->InsertNextValue( vtkMRMLLinearTransformNode::TransformModifiedEvent );
   vtkSetAndObserveMRMLNodeEventsMacro( this->ObservedTransformNode, transformNode, events.GetPointer() );
+  if ( previousTransformNode != NULL && previousTransformNode != transformNode
+    && this->ToolCalibrators.find( previousTransformNode ) != this->ToolCalibrators.end() )
+  {
+    // the previous node is still observed as a tool of multi-tool calibration
+    vtkObserveMRMLNodeEventsMacro( previousTransformNode, events.GetPointer() );
+  }
+}
+
+//---------------------------------------------------------------------------
+vtkSlicerPivotCalibrationLogic* vtkSlicerPivotCalibrationLogic::AddTool( vtkMRMLLinearTransformNode* toolTransformNode )
+{
+  if ( toolTransformNode == NULL )
+  {
+    vtkErrorMacro( "AddTool: Invalid tool transform node" );
+    return NULL;
+  }
+  std::map< vtkMRMLLinearTransformNode*, vtkSmartPointer< vtkSlicerPivotCalibrationLogic > >::iterator toolIt = this->ToolCalibrators.find( toolTransformNode );
+  if ( toolIt != this->ToolCalibrators.end() )
+  {
+    return toolIt->second;
+  }
+  vtkSmartPointer< vtkSlicerPivotCalibrationLogic > calibrator = vtkSmartPointer< vtkSlicerPivotCalibrationLogic >::New();
+  calibrator->MinimumOrientationDifferenceDeg = this->MinimumOrientationDifferenceDeg;
+  calibrator->SetMaximumNumberOfToolToReferenceMatrices( this->MaximumNumberOfToolToReferenceMatrices );
+  calibrator->SetRobustCalibration( this->RobustCalibration );
+  calibrator->SetOutlierRejectionFactor( this->OutlierRejectionFactor );
+  calibrator->SetAutoStopRecording( this->AutoStopRecording );
+  calibrator->SetAutoStopToolTipPositionUncertaintyThresholdMm( this->AutoStopToolTipPositionUncertaintyThresholdMm );
+  // the recording state of the calibrator tells if the tool is still recorded, while the recording state of this logic is enabled
+  calibrator->SetRecordingState( true );
+  this->ToolCalibrators[ toolTransformNode ] = calibrator;
+  this->ToolTransformNodes.push_back( toolTransformNode );
+
+  if ( toolTransformNode != this->ObservedTransformNode )
+  {
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue( vtkMRMLLinearTransformNode::TransformModifiedEvent );
+    vtkObserveMRMLNodeEventsMacro( toolTransformNode, events.GetPointer() );
+  }
+  return calibrator;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::RemoveTool( vtkMRMLLinearTransformNode* toolTransformNode )
+{
+  if ( this->ToolCalibrators.erase( toolTransformNode ) == 0 )
+  {
+    return;
+  }
+  this->ToolTransformNodes.erase( std::find( this->ToolTransformNodes.begin(), this->ToolTransformNodes.end(), toolTransformNode ) );
+  if ( toolTransformNode != this->ObservedTransformNode )
+  {
+    vtkUnObserveMRMLNodeMacro( toolTransformNode );
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::RemoveAllTools()
+{
+  while ( !this->ToolTransformNodes.empty() )
+  {
+    this->RemoveTool( this->ToolTransformNodes.back() );
+  }
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerPivotCalibrationLogic::GetNumberOfTools()
+{
+  return static_cast< int >( this->ToolTransformNodes.size() );
+}
+
+//---------------------------------------------------------------------------
+vtkMRMLLinearTransformNode* vtkSlicerPivotCalibrationLogic::GetNthToolTransformNode( int toolIndex )
+{
+  if ( toolIndex < 0 || toolIndex >= this->GetNumberOfTools() )
+  {
+    vtkErrorMacro( "GetNthToolTransformNode: Invalid tool index " << toolIndex );
+    return NULL;
+  }
+  return this->ToolTransformNodes[ toolIndex ];
+}
+
+//---------------------------------------------------------------------------
+vtkSlicerPivotCalibrationLogic* vtkSlicerPivotCalibrationLogic::GetToolCalibrator( vtkMRMLLinearTransformNode* toolTransformNode )
+{
+  std::map< vtkMRMLLinearTransformNode*, vtkSmartPointer< vtkSlicerPivotCalibrationLogic > >::iterator toolIt = this->ToolCalibrators.find( toolTransformNode );
+  if ( toolIt == this->ToolCalibrators.end() )
+  {
+    return NULL;
+  }
+  return toolIt->second;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::ComputeAllToolsPivotCalibration( bool autoOrient /*=true*/ )
+{
+  bool success = true;
+  std::stringstream errorText;
+  for ( std::vector< vtkMRMLLinearTransformNode* >::iterator toolIt = this->ToolTransformNodes.begin(); toolIt != this->ToolTransformNodes.end(); ++toolIt )
+  {
+    vtkSlicerPivotCalibrationLogic* calibrator = this->ToolCalibrators[ *toolIt ];
+    if ( !calibrator->ComputePivotCalibration( autoOrient ) )
+    {
+      success = false;
+      errorText << ( ( *toolIt )->GetName() ? ( *toolIt )->GetName() : "(unnamed)" ) << ": " << calibrator->GetErrorText() << std::endl;
+    }
+  }
+  this->ErrorText = errorText.str();
+  return success;
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPivotCalibrationLogic::AddToolToReferenceMatrix(vtkMatrix4x4* transformMatrix)
 {
-  this->ToolToReferenceMatrices.push_back(transformMatrix);
+  if ( transformMatrix == NULL )
+  {
+    vtkErrorMacro( "AddToolToReferenceMatrix: Invalid transform matrix" );
+    return;
+  }
+
+  double rotation[ 9 ];
+  double translation[ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      rotation[ i * 3 + j ] = transformMatrix->GetElement( i, j );
+    }
+    translation[ i ] = transformMatrix->GetElement( i, 3 );
+  }
+
+  double orientationDifferenceFromReferenceDeg = 0;
+  if ( this->OrientationReferenceValid )
+  {
+    orientationDifferenceFromReferenceDeg = GetOrientationDifferenceDeg( this->OrientationReferenceRotation, rotation );
+    this->MaximumOrientationDifferenceFromReferenceDeg = std::max( this->MaximumOrientationDifferenceFromReferenceDeg, orientationDifferenceFromReferenceDeg );
+  }
+  else if ( this->NumberOfToolToReferenceMatrices == 0 )
+  {
+    // start of recording, the first sample is the reference
+    std::copy( rotation, rotation + 9, this->OrientationReferenceRotation );
+    this->OrientationReferenceValid = true;
+    this->MaximumOrientationDifferenceFromReferenceDeg = 0;
+  }
+
+  if ( this->MaximumNumberOfToolToReferenceMatrices > 0
+    && this->NumberOfToolToReferenceMatrices >= this->MaximumNumberOfToolToReferenceMatrices )
+  {
+    // Buffer is full, overwrite the oldest sample
+    unsigned int storageIndex = this->FirstToolToReferenceMatrixIndex;
+    if ( this->OrientationDifferenceWitnessValid && this->OrientationDifferenceWitnessStorageIndex == storageIndex )
+    {
+      this->OrientationDifferenceWitnessValid = false;
+    }
+    this->AccumulatePivotCalibrationSample( &this->ToolToReferenceRotations[ storageIndex * 9 ], &this->ToolToReferenceTranslations[ storageIndex * 3 ], -1.0 );
+    // the instantaneous rotation from the oldest sample is removed, the one to the new sample is added
+    double newestRotation[ 9 ];
+    const double* storedNewestRotation = this->GetToolToReferenceRotation( this->NumberOfToolToReferenceMatrices - 1 );
+    std::copy( storedNewestRotation, storedNewestRotation + 9, newestRotation );
+    if ( this->NumberOfToolToReferenceMatrices > 1 )
+    {
+      this->AccumulateSpinCalibrationPair( this->GetToolToReferenceRotation( 0 ), this->GetToolToReferenceRotation( 1 ), -1.0 );
+      this->AccumulateSpinCalibrationPair( newestRotation, rotation, 1.0 );
+    }
+    std::copy( rotation, rotation + 9, this->ToolToReferenceRotations.begin() + storageIndex * 9 );
+    std::copy( translation, translation + 3, this->ToolToReferenceTranslations.begin() + storageIndex * 3 );
+    this->FirstToolToReferenceMatrixIndex = ( this->FirstToolToReferenceMatrixIndex + 1 ) % this->MaximumNumberOfToolToReferenceMatrices;
+    // the first sample is discarded, the orientation differences have to be computed from the new first sample
+    this->MaximumToolOrientationDifferenceValid = false;
+  }
+  else
+  {
+    this->ToolToReferenceRotations.insert( this->ToolToReferenceRotations.end(), rotation, rotation + 9 );
+    this->ToolToReferenceTranslations.insert( this->ToolToReferenceTranslations.end(), translation, translation + 3 );
+    this->NumberOfToolToReferenceMatrices++;
+    if ( this->NumberOfToolToReferenceMatrices > 1 )
+    {
+      this->AccumulateSpinCalibrationPair( this->GetToolToReferenceRotation( this->NumberOfToolToReferenceMatrices - 2 ), rotation, 1.0 );
+    }
+    // While the first sample is unchanged it is the reference, so the difference is already computed
+    if ( this->MaximumToolOrientationDifferenceValid && this->NumberOfToolToReferenceMatrices > 1
+      && this->MaximumToolOrientationDifferenceDeg < orientationDifferenceFromReferenceDeg )
+    {
+      this->MaximumToolOrientationDifferenceDeg = orientationDifferenceFromReferenceDeg;
+      this->OrientationDifferenceWitnessStorageIndex = this->GetToolToReferenceStorageIndex( this->NumberOfToolToReferenceMatrices - 1 );
+      this->OrientationDifferenceWitnessValid = true;
+    }
+  }
+  this->AccumulatePivotCalibrationSample( rotation, translation, 1.0 );
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPivotCalibrationLogic::ClearToolToReferenceMatrices()
 {
-  std::vector<vtkMatrix4x4*>::const_iterator it;
-  std::vector<vtkMatrix4x4*>::const_iterator matricesEnd = this->ToolToReferenceMatrices.end();
-  for(it = this->ToolToReferenceMatrices.begin(); it != matricesEnd; it++)
+  for ( std::map< vtkMRMLLinearTransformNode*, vtkSmartPointer< vtkSlicerPivotCalibrationLogic > >::iterator toolIt = this->ToolCalibrators.begin();
+    toolIt != this->ToolCalibrators.end(); ++toolIt )
   {
-    (*it)->Delete();
+    toolIt->second->ClearToolToReferenceMatrices();
+    toolIt->second->SetRecordingState( true );
+  }
+  // Only the size is reset, the allocated memory is kept for the next recording
+  this->ToolToReferenceRotations.clear();
+  this->ToolToReferenceTranslations.clear();
+  this->NumberOfToolToReferenceMatrices = 0;
+  this->FirstToolToReferenceMatrixIndex = 0;
+  this->MaximumToolOrientationDifferenceDeg = 0;
+  this->MaximumToolOrientationDifferenceValid = true;
+  this->OrientationReferenceValid = false;
+  this->MaximumOrientationDifferenceFromReferenceDeg = 0;
+  this->OrientationDifferenceWitnessValid = false;
+  this->SampleResiduals.clear();
+  this->SampleInlierMask.clear();
+  this->NumberOfInlierSamples = 0;
+  this->PivotNormalMatrix.fill( 0 );
+  this->PivotNormalVector.fill( 0 );
+  this->PivotSumOfSquaredTranslations = 0;
+  std::fill( this->SpinNormalMatrix, this->SpinNormalMatrix + 9, 0.0 );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::SetMaximumNumberOfToolToReferenceMatrices( unsigned int maximumNumberOfMatrices )
+{
+  if ( this->MaximumNumberOfToolToReferenceMatrices == maximumNumberOfMatrices )
+  {
+    return;
+  }
+
+  // Keep the most recent samples, in chronological order
+  unsigned int numberOfKeptMatrices = this->NumberOfToolToReferenceMatrices;
+  if ( maximumNumberOfMatrices > 0 && numberOfKeptMatrices > maximumNumberOfMatrices )
+  {
+    numberOfKeptMatrices = maximumNumberOfMatrices;
+  }
+  std::vector< double > keptRotations;
+  std::vector< double > keptTranslations;
+  keptRotations.reserve( 9 * numberOfKeptMatrices );
+  keptTranslations.reserve( 3 * numberOfKeptMatrices );
+  for ( unsigned int sampleIndex = this->NumberOfToolToReferenceMatrices - numberOfKeptMatrices; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+  {
+    const double* rotation = this->GetToolToReferenceRotation( sampleIndex );
+    const double* translation = this->GetToolToReferenceTranslation( sampleIndex );
+    keptRotations.insert( keptRotations.end(), rotation, rotation + 9 );
+    keptTranslations.insert( keptTranslations.end(), translation, translation + 3 );
+  }
+
+  this->MaximumNumberOfToolToReferenceMatrices = maximumNumberOfMatrices;
+  this->ClearToolToReferenceMatrices();
+  this->ToolToReferenceRotations.swap( keptRotations );
+  this->ToolToReferenceTranslations.swap( keptTranslations );
+  // Preallocate the whole buffer to avoid reallocation during recording
+  unsigned int capacity = ( maximumNumberOfMatrices > 0 ? maximumNumberOfMatrices : INITIAL_TOOL_TO_REFERENCE_MATRIX_CAPACITY );
+  this->ToolToReferenceRotations.reserve( 9 * capacity );
+  this->ToolToReferenceTranslations.reserve( 3 * capacity );
+  this->NumberOfToolToReferenceMatrices = numberOfKeptMatrices;
+  for ( unsigned int sampleIndex = 0; sampleIndex < numberOfKeptMatrices; sampleIndex++ )
+  {
+    this->AccumulatePivotCalibrationSample( this->GetToolToReferenceRotation( sampleIndex ), this->GetToolToReferenceTranslation( sampleIndex ), 1.0 );
+    if ( sampleIndex > 0 )
+    {
+      this->AccumulateSpinCalibrationPair( this->GetToolToReferenceRotation( sampleIndex - 1 ), this->GetToolToReferenceRotation( sampleIndex ), 1.0 );
+    }
+  }
+  // recompute orientation difference if older samples were discarded
+  this->MaximumToolOrientationDifferenceValid = ( numberOfKeptMatrices == 0 );
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+const double* vtkSlicerPivotCalibrationLogic::GetToolToReferenceRotation( unsigned int sampleIndex )
+{
+  return &this->ToolToReferenceRotations[ this->GetToolToReferenceStorageIndex( sampleIndex ) * 9 ];
+}
+
+//---------------------------------------------------------------------------
+const double* vtkSlicerPivotCalibrationLogic::GetToolToReferenceTranslation( unsigned int sampleIndex )
+{
+  return &this->ToolToReferenceTranslations[ this->GetToolToReferenceStorageIndex( sampleIndex ) * 3 ];
+}
+
+//---------------------------------------------------------------------------
+unsigned int vtkSlicerPivotCalibrationLogic::GetToolToReferenceStorageIndex( unsigned int sampleIndex )
+{
+  if ( this->FirstToolToReferenceMatrixIndex == 0 )
+  {
+    // buffer has not wrapped around yet
+    return sampleIndex;
+  }
+  return ( this->FirstToolToReferenceMatrixIndex + sampleIndex ) % this->NumberOfToolToReferenceMatrices;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::AccumulatePivotCalibrationSample( const double* rotation, const double* translation, double weight )
+{
+  AddPivotCalibrationSampleToNormalEquations( rotation, translation, weight,
+    this->PivotNormalMatrix, this->PivotNormalVector, this->PivotSumOfSquaredTranslations );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::AddPivotCalibrationSampleToNormalEquations( const double* rotation, const double* translation, double weight,
+  vnl_matrix<double>& normalMatrix, vnl_vector<double>& normalVector, double& sumOfSquaredTranslations )
+{
+  // Each transform adds three rows to the system A*x = b, where A = [ R -I ], b = -t and
+  // x = [ toolTipToToolTranslation pivotPoint_Reference ]. Only A'*A, A'*b and b'*b are stored.
+  // Weight is +1 for adding and -1 for removing a transform.
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      // R'*R block
+      double rtr = 0;
+      for ( int k = 0; k < 3; k++ )
+      {
+        rtr += rotation[ k * 3 + i ] * rotation[ k * 3 + j ];
+      }
+      normalMatrix( i, j ) += weight * rtr;
+      // -R' and -R blocks
+      normalMatrix( i, j + 3 ) -= weight * rotation[ j * 3 + i ];
+      normalMatrix( i + 3, j ) -= weight * rotation[ i * 3 + j ];
+    }
+    // I block
+    normalMatrix( i + 3, i + 3 ) += weight;
+
+    // A'*b = [ -R'*t t ]
+    double rtt = 0;
+    for ( int k = 0; k < 3; k++ )
+    {
+      rtt += rotation[ k * 3 + i ] * translation[ k ];
+    }
+    normalVector( i ) -= weight * rtt;
+    normalVector( i + 3 ) += weight * translation[ i ];
+
+    sumOfSquaredTranslations += weight * translation[ i ] * translation[ i ];
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::AccumulateSpinCalibrationPair( const double* previousRotation, const double* currentRotation, double weight )
+{
+  double pairMatrix[ 9 ];
+  ComputeSpinCalibrationPairMatrix( previousRotation, currentRotation, pairMatrix );
+  for ( int i = 0; i < 9; i++ )
+  {
+    this->SpinNormalMatrix[ i ] += weight * pairMatrix[ i ];
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::ComputeSpinCalibrationPairMatrix( const double* previousRotation, const double* currentRotation, double* pairMatrix )
+{
+  // RI = current' * previous. Since RI is orthonormal: (RI-I)'*(RI-I) = 2*I - RI - RI'
+  double ri[ 9 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      double sum = 0;
+      for ( int k = 0; k < 3; k++ )
+      {
+        sum += currentRotation[ k * 3 + i ] * previousRotation[ k * 3 + j ];
+      }
+      ri[ i * 3 + j ] = sum;
+    }
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
+    {
+      pairMatrix[ i * 3 + j ] = ( i == j ? 2.0 : 0.0 ) - ri[ i * 3 + j ] - ri[ j * 3 + i ];
+    }
   }
-  this->ToolToReferenceMatrices.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -136,44 +703,96 @@ double vtkSlicerPivotCalibrationLogic::GetOrientationDifferenceDeg(vtkMatrix4x4*
   return vtkMath::DegreesFromRadians(normalizedAngleDiff_rad);
 }
 
+//----------------------------------------------------------------------------
+double vtkSlicerPivotCalibrationLogic::GetOrientationDifferenceDeg( const double* aRotation, const double* bRotation )
+{
+  // Rotation angle of A*inv(B) = A*B' is computed from its trace
+  // (trace(A*B') is the sum of element-wise products of A and B)
+  double trace = 0;
+  for ( int i = 0; i < 9; i++ )
+  {
+    trace += aRotation[ i ] * bRotation[ i ];
+  }
+  double cosAngle = ( trace - 1.0 ) / 2.0;
+  cosAngle = std::max( -1.0, std::min( 1.0, cosAngle ) );
+  return vtkMath::DegreesFromRadians( acos( cosAngle ) );
+}
+
 //---------------------------------------------------------------------------
 double vtkSlicerPivotCalibrationLogic::GetMaximumToolOrientationDifferenceDeg()
 {
+  if ( this->MaximumToolOrientationDifferenceValid )
+  {
+    return this->MaximumToolOrientationDifferenceDeg;
+  }
+
   // this will store the maximum difference in orientation between the first transform and all the other transforms
   double maximumOrientationDifferenceDeg = 0;
-  
-    std::vector<vtkMatrix4x4*>::const_iterator it;
-  std::vector<vtkMatrix4x4*>::const_iterator matricesEnd = this->ToolToReferenceMatrices.end();
-  unsigned int currentRow;
-  vtkMatrix4x4* referenceOrientationMatrix = this->ToolToReferenceMatrices.front();
-  for(currentRow = 0, it = this->ToolToReferenceMatrices.begin(); it != matricesEnd; it++, currentRow += 3)
+  if ( this->NumberOfToolToReferenceMatrices == 0 )
+  {
+    return maximumOrientationDifferenceDeg;
+  }
+
+  const double* referenceRotation = this->GetToolToReferenceRotation( 0 );
+  this->OrientationDifferenceWitnessValid = false;
+  for ( unsigned int sampleIndex = 1; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
   {
-    double orientationDifferenceDeg = GetOrientationDifferenceDeg(referenceOrientationMatrix, (*it));
+    double orientationDifferenceDeg = GetOrientationDifferenceDeg( referenceRotation, this->GetToolToReferenceRotation( sampleIndex ) );
     if (maximumOrientationDifferenceDeg < orientationDifferenceDeg)
     {
       maximumOrientationDifferenceDeg = orientationDifferenceDeg;    
+      this->OrientationDifferenceWitnessStorageIndex = this->GetToolToReferenceStorageIndex( sampleIndex );
+      this->OrientationDifferenceWitnessValid = true;
     }
   }
 
+  this->MaximumToolOrientationDifferenceDeg = maximumOrientationDifferenceDeg;
+  this->MaximumToolOrientationDifferenceValid = true;
+  // the current first sample is the new reference for the bounds
+  std::copy( referenceRotation, referenceRotation + 9, this->OrientationReferenceRotation );
+  this->OrientationReferenceValid = true;
+  this->MaximumOrientationDifferenceFromReferenceDeg = maximumOrientationDifferenceDeg;
   return maximumOrientationDifferenceDeg;
 }
 
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::IsToolOrientationDifferenceSufficient()
+{
+  if ( !this->MaximumToolOrientationDifferenceValid && this->NumberOfToolToReferenceMatrices > 0 )
+  {
+    const double* firstRotation = this->GetToolToReferenceRotation( 0 );
+    if ( this->OrientationDifferenceWitnessValid && GetOrientationDifferenceDeg( firstRotation,
+      &this->ToolToReferenceRotations[ this->OrientationDifferenceWitnessStorageIndex * 9 ] ) >= this->MinimumOrientationDifferenceDeg )
+    {
+      // a stored sample is different enough from the first one
+      return true;
+    }
+    if ( this->OrientationReferenceValid && GetOrientationDifferenceDeg( firstRotation, this->OrientationReferenceRotation )
+      + this->MaximumOrientationDifferenceFromReferenceDeg < this->MinimumOrientationDifferenceDeg )
+    {
+      // no stored sample can be different enough from the first one
+      return false;
+    }
+  }
+  return ( this->GetMaximumToolOrientationDifferenceDeg() >= this->MinimumOrientationDifferenceDeg );
+}
+
 //---------------------------------------------------------------------------
 bool vtkSlicerPivotCalibrationLogic::ComputePivotCalibration( bool autoOrient /*=true*/)
 {
-  if (this->ToolToReferenceMatrices.size() < 10)
+  if (this->NumberOfToolToReferenceMatrices < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES)
   {
     this->ErrorText = "Not enough input transforms are available";
     return false;
   }
 
-  if (this->GetMaximumToolOrientationDifferenceDeg() < this->MinimumOrientationDifferenceDeg)
+  if (!this->IsToolOrientationDifferenceSufficient())
   {
     this->ErrorText = "Not enough variation in the input transforms";
     return false;
   }
   
-  unsigned int rows = 3 * this->ToolToReferenceMatrices.size();
+  unsigned int rows = 3 * this->NumberOfToolToReferenceMatrices;
   unsigned int columns = 6;
 
   vnl_matrix<double> A(rows, columns);
@@ -188,36 +807,33 @@ bool vtkSlicerPivotCalibrationLogic::ComputePivotCalibration( bool autoOrient /*
   vnl_vector<double> x(columns);
   vnl_vector<double> t(3);
 
-  std::vector<vtkMatrix4x4*>::const_iterator it;
-  std::vector<vtkMatrix4x4*>::const_iterator matricesEnd = this->ToolToReferenceMatrices.end();
-  unsigned int currentRow;
-  for(currentRow = 0, it = this->ToolToReferenceMatrices.begin(); it != matricesEnd; it++, currentRow += 3)
+  unsigned int currentRow = 0;
+  for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++, currentRow += 3 )
   {    
-    for (int i = 0; i < 3; i++)
-    {
-      t(i) = (*it)->GetElement(i, 3);
-    }
+    t.copy_in( this->GetToolToReferenceTranslation( sampleIndex ) );
     t *= -1;
     b.update(t, currentRow);
 
-    for (int i = 0; i < 3; i++)
-    {
-      for (int j = 0; j < 3; j++ )
-      {
-        R(i, j) = (*it)->GetElement(i, j);
-      }
-    }
+    R.copy_in( this->GetToolToReferenceRotation( sampleIndex ) ); // row-major
     A.update(R, currentRow, 0);
     A.update( minusI, currentRow, 3 );    
   }
     
   vnl_svd<double> svdA(A);    
-  svdA.zero_out_absolute( 1e-1 );    
+  svdA.zero_out_absolute( PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD );    
   x = svdA.solve( b );
     
   //set the RMSE
   this->PivotRMSE = ( A * x - b ).rms();
 
+  this->ComputePivotCalibrationResiduals( x );
+  this->SampleInlierMask.assign( this->NumberOfToolToReferenceMatrices, 1 );
+  this->NumberOfInlierSamples = this->NumberOfToolToReferenceMatrices;
+  if ( this->RobustCalibration && !this->ComputeRobustPivotCalibration( x ) )
+  {
+    return false;
+  }
+
   //set the transformation
   this->ToolTipToToolMatrix->SetElement( 0, 3, x[ 0 ] );
   this->ToolTipToToolMatrix->SetElement( 1, 3, x[ 1 ] );
@@ -232,57 +848,272 @@ bool vtkSlicerPivotCalibrationLogic::ComputePivotCalibration( bool autoOrient /*
 }
 
 //---------------------------------------------------------------------------
-bool vtkSlicerPivotCalibrationLogic::ComputeSpinCalibration( bool snapRotation /*=false*/, bool autoOrient /*=true*/)
+bool vtkSlicerPivotCalibrationLogic::ComputeRobustPivotCalibration( vnl_vector<double>& x )
 {
-  if ( this->ToolToReferenceMatrices.size() < 10 )
+  // Iteratively reject samples with large residual and recompute the solution from the remaining
+  // samples until the set of inliers does not change anymore.
+  // Residuals of the current solution are already computed.
+  for ( int iteration = 0; iteration < ROBUST_CALIBRATION_MAXIMUM_NUMBER_OF_ITERATIONS; iteration++ )
+  {
+    double outlierThreshold = this->GetOutlierThreshold( ROBUST_PIVOT_MINIMUM_OUTLIER_THRESHOLD_MM );
+    if ( !this->UpdateSampleInlierMask( this->SampleResiduals, outlierThreshold ) )
+    {
+      // converged
+      break;
+    }
+    if ( this->NumberOfInlierSamples < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES )
+    {
+      this->ErrorText = "Not enough inlier transforms are available";
+      return false;
+    }
+
+    vnl_matrix<double> normalMatrix( 6, 6, 0.0 );
+    vnl_vector<double> normalVector( 6, 0.0 );
+    double sumOfSquaredTranslations = 0;
+    for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+    {
+      if ( this->SampleInlierMask[ sampleIndex ] )
+      {
+        AddPivotCalibrationSampleToNormalEquations( this->GetToolToReferenceRotation( sampleIndex ), this->GetToolToReferenceTranslation( sampleIndex ), 1.0,
+          normalMatrix, normalVector, sumOfSquaredTranslations );
+      }
+    }
+    vnl_svd<double> svdNormalMatrix( normalMatrix );
+    svdNormalMatrix.zero_out_absolute( PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD * PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD );
+    if ( svdNormalMatrix.rank() < 6 )
+    {
+      this->ErrorText = "Not enough variation in the inlier transforms";
+      return false;
+    }
+    x = svdNormalMatrix.solve( normalVector );
+    this->ComputePivotCalibrationResiduals( x );
+  }
+
+  // RMSE of the inliers (computed the same way as for all samples: RMS of the residual vector components)
+  double sumOfSquaredResiduals = 0;
+  for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+  {
+    if ( this->SampleInlierMask[ sampleIndex ] )
+    {
+      sumOfSquaredResiduals += this->SampleResiduals[ sampleIndex ] * this->SampleResiduals[ sampleIndex ];
+    }
+  }
+  this->PivotRMSE = sqrt( sumOfSquaredResiduals / ( 3 * this->NumberOfInlierSamples ) );
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::ComputePivotCalibrationResiduals( const vnl_vector<double>& x )
+{
+  // Residual is the distance between the pivot point and the tool tip position (in the reference coordinate system)
+  this->SampleResiduals.resize( this->NumberOfToolToReferenceMatrices );
+  for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+  {
+    const double* rotation = this->GetToolToReferenceRotation( sampleIndex );
+    const double* translation = this->GetToolToReferenceTranslation( sampleIndex );
+    double squaredDistance = 0;
+    for ( int i = 0; i < 3; i++ )
+    {
+      double difference = rotation[ i * 3 ] * x[ 0 ] + rotation[ i * 3 + 1 ] * x[ 1 ] + rotation[ i * 3 + 2 ] * x[ 2 ] + translation[ i ] - x[ i + 3 ];
+      squaredDistance += difference * difference;
+    }
+    this->SampleResiduals[ sampleIndex ] = sqrt( squaredDistance );
+  }
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerPivotCalibrationLogic::GetOutlierThreshold( double minimumThreshold )
+{
+  // Robust estimate of the standard deviation of the residuals: 1.4826 * median absolute deviation
+  if ( this->SampleResiduals.empty() )
+  {
+    return minimumThreshold;
+  }
+  std::vector<double> sortedResiduals( this->SampleResiduals );
+  std::vector<double>::iterator medianIt = sortedResiduals.begin() + sortedResiduals.size() / 2;
+  std::nth_element( sortedResiduals.begin(), medianIt, sortedResiduals.end() );
+  double threshold = this->OutlierRejectionFactor * 1.4826 * ( *medianIt );
+  return std::max( threshold, minimumThreshold );
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::UpdateSampleInlierMask( const std::vector<double>& residuals, double outlierThreshold )
+{
+  bool modified = false;
+  this->NumberOfInlierSamples = 0;
+  for ( unsigned int sampleIndex = 0; sampleIndex < residuals.size(); sampleIndex++ )
+  {
+    char inlier = ( residuals[ sampleIndex ] <= outlierThreshold ? 1 : 0 );
+    if ( this->SampleInlierMask[ sampleIndex ] != inlier )
+    {
+      this->SampleInlierMask[ sampleIndex ] = inlier;
+      modified = true;
+    }
+    if ( inlier )
+    {
+      this->NumberOfInlierSamples++;
+    }
+  }
+  return modified;
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerPivotCalibrationLogic::GetSampleResidual( unsigned int sampleIndex )
+{
+  if ( sampleIndex >= this->SampleResiduals.size() )
+  {
+    vtkErrorMacro( "GetSampleResidual: Invalid sample index " << sampleIndex );
+    return 0.0;
+  }
+  return this->SampleResiduals[ sampleIndex ];
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::GetSampleInlier( unsigned int sampleIndex )
+{
+  if ( sampleIndex >= this->SampleInlierMask.size() )
+  {
+    vtkErrorMacro( "GetSampleInlier: Invalid sample index " << sampleIndex );
+    return false;
+  }
+  return this->SampleInlierMask[ sampleIndex ] != 0;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::ComputeIncrementalPivotCalibration()
+{
+  if ( this->NumberOfToolToReferenceMatrices < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES )
   {
     this->ErrorText = "Not enough input transforms are available";
     return false;
   }
 
-  if (this->GetMaximumToolOrientationDifferenceDeg() < this->MinimumOrientationDifferenceDeg)
+  vnl_svd<double> svdNormalMatrix( this->PivotNormalMatrix );
+  svdNormalMatrix.zero_out_absolute( PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD * PIVOT_CALIBRATION_SINGULAR_VALUE_THRESHOLD );
+  if ( svdNormalMatrix.rank() < 6 )
   {
+    // Without enough rotation the tip position is not determined
     this->ErrorText = "Not enough variation in the input transforms";
     return false;
   }
-  
-  // Setup our system to find the axis of rotation
-  unsigned int rows = 3, columns = 3;
+  vnl_vector<double> x = svdNormalMatrix.solve( this->PivotNormalVector );
+
+  // |A*x-b|^2 = x'*A'*A*x - 2*x'*A'*b + b'*b
+  double sumOfSquaredResiduals = dot_product( x, this->PivotNormalMatrix * x )
+    - 2 * dot_product( x, this->PivotNormalVector ) + this->PivotSumOfSquaredTranslations;
+  if ( sumOfSquaredResiduals < 0 )
+  {
+    // may happen due to numerical errors if the residual is very small
+    sumOfSquaredResiduals = 0;
+  }
+  this->IncrementalPivotRMSE = sqrt( sumOfSquaredResiduals / ( 3 * this->NumberOfToolToReferenceMatrices ) );
 
-  vnl_matrix<double> A( rows, columns, 0);
+  // Covariance of the solution: sigma^2 * inv(A'*A), where sigma^2 is the residual variance
+  // (3 equations for each sample, 6 unknowns)
+  double residualVariance = sumOfSquaredResiduals / ( 3 * this->NumberOfToolToReferenceMatrices - 6 );
+  vnl_matrix<double> inverseNormalMatrix = svdNormalMatrix.inverse();
+  double toolTipPositionVariance = residualVariance * ( inverseNormalMatrix( 0, 0 ) + inverseNormalMatrix( 1, 1 ) + inverseNormalMatrix( 2, 2 ) );
+  this->IncrementalToolTipPositionUncertaintyMm = sqrt( std::max( 0.0, toolTipPositionVariance ) );
 
-  vnl_matrix<double> I( 3, 3, 0 );
-  I.set_identity();
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->IncrementalToolTipToToolTranslation[ i ] = x[ i ];
+    this->IncrementalPivotPoint_Reference[ i ] = x[ i + 3 ];
+  }
 
-  vnl_matrix<double> RI( rows, columns );
+  this->ErrorText.clear();
+  return true;
+}
 
-  std::vector< vtkMatrix4x4* >::const_iterator previt = this->ToolToReferenceMatrices.end();
-  for(std::vector< vtkMatrix4x4* >::const_iterator it = this->ToolToReferenceMatrices.begin(); it != this->ToolToReferenceMatrices.end(); it++ )
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::ComputeIncrementalSpinCalibration()
+{
+  if ( this->NumberOfToolToReferenceMatrices < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES )
   {
-    if ( previt == this->ToolToReferenceMatrices.end() )
-    {
-      previt = it;
-      continue; // No comparison to make for the first matrix
-    }
-    
-    vtkSmartPointer< vtkMatrix4x4 > itinverse = vtkSmartPointer< vtkMatrix4x4 >::New();
-    vtkMatrix4x4::Invert( (*it), itinverse );
+    this->ErrorText = "Not enough input transforms are available";
+    return false;
+  }
 
-    vtkSmartPointer< vtkMatrix4x4 > instRotation = vtkSmartPointer< vtkMatrix4x4 >::New();
-    vtkMatrix4x4::Multiply4x4( itinverse, (*previt), instRotation );
+  // The shaft axis is the eigenvector of the normal matrix that belongs to the smallest eigenvalue
+  const double* a = this->SpinNormalMatrix;
+  double eigenvalues[ 3 ];
+  vnl_symmetric_eigensystem_compute_eigenvals( a[ 0 ], a[ 1 ], a[ 2 ], a[ 4 ], a[ 5 ], a[ 8 ],
+    eigenvalues[ 0 ], eigenvalues[ 1 ], eigenvalues[ 2 ] ); // increasing order
+  if ( eigenvalues[ 1 ] - eigenvalues[ 0 ] < SPIN_CALIBRATION_MINIMUM_EIGENVALUE_GAP )
+  {
+    // Rotation axis is not determined (not enough rotation)
+    this->ErrorText = "Not enough variation in the input transforms";
+    return false;
+  }
 
-    for (int i = 0; i < 3; i++)
+  // Rows of (A - lambda*I) are orthogonal to the eigenvector, use the largest cross product of two rows
+  double rows[ 3 ][ 3 ];
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int j = 0; j < 3; j++ )
     {
-      for (int j = 0; j < 3; j++ )
-      {
-        RI(i, j) = instRotation->GetElement(i, j);
-      }
+      rows[ i ][ j ] = a[ i * 3 + j ] - ( i == j ? eigenvalues[ 0 ] : 0.0 );
     }
+  }
+  double axis[ 3 ] = { 0, 0, 0 };
+  double maximumSquaredNorm = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    const double* u = rows[ i ];
+    const double* v = rows[ ( i + 1 ) % 3 ];
+    double cross[ 3 ] = { u[ 1 ] * v[ 2 ] - u[ 2 ] * v[ 1 ], u[ 2 ] * v[ 0 ] - u[ 0 ] * v[ 2 ], u[ 0 ] * v[ 1 ] - u[ 1 ] * v[ 0 ] };
+    double squaredNorm = cross[ 0 ] * cross[ 0 ] + cross[ 1 ] * cross[ 1 ] + cross[ 2 ] * cross[ 2 ];
+    if ( squaredNorm > maximumSquaredNorm )
+    {
+      maximumSquaredNorm = squaredNorm;
+      std::copy( cross, cross + 3, axis );
+    }
+  }
+  if ( maximumSquaredNorm <= 0 )
+  {
+    this->ErrorText = "Not enough variation in the input transforms";
+    return false;
+  }
+  double norm = sqrt( maximumSquaredNorm );
+  for ( int i = 0; i < 3; i++ )
+  {
+    this->IncrementalShaftAxis_ToolTip[ i ] = axis[ i ] / norm;
+  }
+  this->IncrementalSpinRMSE = sqrt( std::max( 0.0, eigenvalues[ 0 ] ) / this->NumberOfToolToReferenceMatrices );
 
-    RI = RI - I;
-    A = A + RI.transpose() * RI;
+  this->ErrorText.clear();
+  return true;
+}
 
-    previt = it;
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::ComputeSpinCalibration( bool snapRotation /*=false*/, bool autoOrient /*=true*/)
+{
+  if ( this->NumberOfToolToReferenceMatrices < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES )
+  {
+    this->ErrorText = "Not enough input transforms are available";
+    return false;
+  }
+
+  if (!this->IsToolOrientationDifferenceSufficient())
+  {
+    this->ErrorText = "Not enough variation in the input transforms";
+    return false;
+  }
+  
+  // Setup our system to find the axis of rotation
+  unsigned int rows = 3, columns = 3;
+
+  // A is the sum of the contributions of all the instantaneous rotations, which is accumulated as samples are added
+  vnl_matrix<double> A( this->SpinNormalMatrix, rows, columns );
+
+  // Contribution of each instantaneous rotation (between consecutive samples) to A, stored row-major.
+  // Only needed for computing the residuals.
+  unsigned int numberOfRotationPairs = this->NumberOfToolToReferenceMatrices - 1;
+  std::vector<double> pairMatrices( 9 * numberOfRotationPairs );
+  for ( unsigned int pairIndex = 0; pairIndex < numberOfRotationPairs; pairIndex++ )
+  {
+    ComputeSpinCalibrationPairMatrix( this->GetToolToReferenceRotation( pairIndex ), this->GetToolToReferenceRotation( pairIndex + 1 ),
+      &pairMatrices[ 9 * pairIndex ] );
   }
 
   // Setup the axes
@@ -302,6 +1133,73 @@ bool vtkSlicerPivotCalibrationLogic::ComputeSpinCalibration( bool snapRotation /
   shaftAxis_ToolTip( 2 ) = eigenvectors( 2, 0 );
   shaftAxis_ToolTip.normalize();
 
+  std::vector<double> pairResiduals;
+  ComputeSpinCalibrationResiduals( pairMatrices, shaftAxis_ToolTip, pairResiduals );
+  std::vector<char> pairInlierMask( numberOfRotationPairs, 1 );
+  this->SampleInlierMask.assign( this->NumberOfToolToReferenceMatrices, 1 );
+  this->NumberOfInlierSamples = this->NumberOfToolToReferenceMatrices;
+  if ( this->RobustCalibration )
+  {
+    // Iteratively reject instantaneous rotations that are far from the current axis estimate
+    // and recompute the axis from the remaining ones, until the set of inliers does not change anymore.
+    for ( int iteration = 0; iteration < ROBUST_CALIBRATION_MAXIMUM_NUMBER_OF_ITERATIONS; iteration++ )
+    {
+      this->SampleResiduals = pairResiduals;
+      double outlierThreshold = this->GetOutlierThreshold( ROBUST_SPIN_MINIMUM_OUTLIER_THRESHOLD );
+      bool modified = false;
+      unsigned int numberOfInlierPairs = 0;
+      for ( unsigned int pairIndex = 0; pairIndex < numberOfRotationPairs; pairIndex++ )
+      {
+        char inlier = ( pairResiduals[ pairIndex ] <= outlierThreshold ? 1 : 0 );
+        modified = modified || ( pairInlierMask[ pairIndex ] != inlier );
+        pairInlierMask[ pairIndex ] = inlier;
+        numberOfInlierPairs += inlier;
+      }
+      if ( !modified )
+      {
+        break;
+      }
+      if ( numberOfInlierPairs + 1 < MINIMUM_NUMBER_OF_CALIBRATION_MATRICES )
+      {
+        this->ErrorText = "Not enough inlier transforms are available";
+        return false;
+      }
+      A.fill( 0 );
+      for ( unsigned int pairIndex = 0; pairIndex < numberOfRotationPairs; pairIndex++ )
+      {
+        if ( pairInlierMask[ pairIndex ] )
+        {
+          A += vnl_matrix<double>( &pairMatrices[ 9 * pairIndex ], 3, 3 );
+        }
+      }
+      vnl_symmetric_eigensystem_compute( A, eigenvectors, eigenvalues );
+      shaftAxis_ToolTip( 0 ) = eigenvectors( 0, 0 );
+      shaftAxis_ToolTip( 1 ) = eigenvectors( 1, 0 );
+      shaftAxis_ToolTip( 2 ) = eigenvectors( 2, 0 );
+      shaftAxis_ToolTip.normalize();
+      ComputeSpinCalibrationResiduals( pairMatrices, shaftAxis_ToolTip, pairResiduals );
+    }
+
+    // A bad pose spoils both instantaneous rotations that it is part of,
+    // so a sample is an outlier only if all its instantaneous rotations are outliers
+    this->NumberOfInlierSamples = 0;
+    for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+    {
+      bool previousPairInlier = ( sampleIndex > 0 && pairInlierMask[ sampleIndex - 1 ] );
+      bool nextPairInlier = ( sampleIndex < numberOfRotationPairs && pairInlierMask[ sampleIndex ] );
+      this->SampleInlierMask[ sampleIndex ] = ( ( previousPairInlier || nextPairInlier ) ? 1 : 0 );
+      this->NumberOfInlierSamples += this->SampleInlierMask[ sampleIndex ];
+    }
+  }
+
+  // Residual of a sample is the residual of the instantaneous rotation that ends at that sample
+  // (the first sample has the residual of the first instantaneous rotation)
+  this->SampleResiduals.resize( this->NumberOfToolToReferenceMatrices );
+  for ( unsigned int sampleIndex = 0; sampleIndex < this->NumberOfToolToReferenceMatrices; sampleIndex++ )
+  {
+    this->SampleResiduals[ sampleIndex ] = pairResiduals[ sampleIndex > 0 ? sampleIndex - 1 : 0 ];
+  }
+
   // Snap the direction vector to be exactly aligned with one of the coordinate axes
   // This is if the sensor is known to be parallel to one of the axis, just not which one
   if ( snapRotation )
@@ -312,7 +1210,7 @@ bool vtkSlicerPivotCalibrationLogic::ComputeSpinCalibration( bool snapRotation /
   }
 
   //set the RMSE
-  this->SpinRMSE = sqrt( eigenvalues( 0 ) / this->ToolToReferenceMatrices.size() );
+  this->SpinRMSE = sqrt( eigenvalues( 0 ) / this->NumberOfInlierSamples );
   // Note: This error is the RMS distance from the ideal axis of rotation to the axis of rotation for each instantaneous rotation
   // This RMS distance can be computed to an angle in the following way: angle = arccos( 1 - SpinRMSE^2 / 2 )
   // Here we elect to return the RMS distance because this is the quantity that was actually minimized in the calculation
@@ -382,6 +1280,111 @@ bool vtkSlicerPivotCalibrationLogic::ComputeSpinCalibration( bool snapRotation /
   return true;
 }
 
+//---------------------------------------------------------------------------
+void vtkSlicerPivotCalibrationLogic::ComputeSpinCalibrationResiduals( const std::vector<double>& pairMatrices,
+  const vnl_vector<double>& shaftAxis_ToolTip, std::vector<double>& pairResiduals )
+{
+  // Residual is the distance between the rotated and the original axis: sqrt( a' * (RI-I)' * (RI-I) * a )
+  unsigned int numberOfRotationPairs = pairMatrices.size() / 9;
+  pairResiduals.resize( numberOfRotationPairs );
+  for ( unsigned int pairIndex = 0; pairIndex < numberOfRotationPairs; pairIndex++ )
+  {
+    const double* pairMatrix = &pairMatrices[ 9 * pairIndex ];
+    double squaredDistance = 0;
+    for ( int i = 0; i < 3; i++ )
+    {
+      for ( int j = 0; j < 3; j++ )
+      {
+        squaredDistance += shaftAxis_ToolTip[ i ] * pairMatrix[ i * 3 + j ] * shaftAxis_ToolTip[ j ];
+      }
+    }
+    pairResiduals[ pairIndex ] = sqrt( std::max( 0.0, squaredDistance ) );
+  }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerPivotCalibrationLogic::ComputeBatchCalibration( vtkCollection* toolToReferenceMatrixArrays, vtkTable* outputTable,
+  bool computePivot /*=true*/, bool computeSpin /*=true*/, bool snapRotation /*=false*/ )
+{
+  if ( toolToReferenceMatrixArrays == NULL || outputTable == NULL )
+  {
+    vtkErrorMacro( "ComputeBatchCalibration: Invalid input or output" );
+    return false;
+  }
+
+  // Calibrators are created and configured on the main thread, the threads only compute
+  BatchCalibrationJob job;
+  job.ComputePivot = computePivot;
+  job.ComputeSpin = computeSpin;
+  job.SnapRotation = snapRotation;
+  job.Items.resize( toolToReferenceMatrixArrays->GetNumberOfItems() );
+  for ( int toolIndex = 0; toolIndex < toolToReferenceMatrixArrays->GetNumberOfItems(); toolIndex++ )
+  {
+    vtkDoubleArray* matrices = vtkDoubleArray::SafeDownCast( toolToReferenceMatrixArrays->GetItemAsObject( toolIndex ) );
+    if ( matrices == NULL || matrices->GetNumberOfComponents() != 16 )
+    {
+      vtkErrorMacro( "ComputeBatchCalibration: Input " << toolIndex << " is not a vtkDoubleArray with 16 components" );
+      return false;
+    }
+    BatchCalibrationItem& item = job.Items[ toolIndex ];
+    item.ToolToReferenceMatrices = matrices;
+    item.Calibrator = vtkSmartPointer<vtkSlicerPivotCalibrationLogic>::New();
+    item.Calibrator->MinimumOrientationDifferenceDeg = this->MinimumOrientationDifferenceDeg;
+    item.Calibrator->SetRobustCalibration( this->RobustCalibration );
+    item.Calibrator->SetOutlierRejectionFactor( this->OutlierRejectionFactor );
+  }
+
+  if ( !job.Items.empty() )
+  {
+    vtkNew<vtkMultiThreader> threader;
+    int numberOfThreads = std::min( static_cast<int>( job.Items.size() ), vtkMultiThreader::GetGlobalDefaultNumberOfThreads() );
+    threader->SetNumberOfThreads( std::max( 1, numberOfThreads ) );
+    threader->SetSingleMethod( BatchCalibrationThreadFunction, &job );
+    threader->SingleMethodExecute();
+  }
+
+  vtkNew<vtkIntArray> pivotSucceededArray;
+  pivotSucceededArray->SetName( "PivotCalibrationSucceeded" );
+  vtkNew<vtkDoubleArray> pivotRmseArray;
+  pivotRmseArray->SetName( "PivotRMSE" );
+  vtkNew<vtkIntArray> spinSucceededArray;
+  spinSucceededArray->SetName( "SpinCalibrationSucceeded" );
+  vtkNew<vtkDoubleArray> spinRmseArray;
+  spinRmseArray->SetName( "SpinRMSE" );
+  vtkNew<vtkDoubleArray> toolTipToToolArray;
+  toolTipToToolArray->SetName( "ToolTipToToolMatrix" );
+  toolTipToToolArray->SetNumberOfComponents( 16 );
+  vtkNew<vtkStringArray> errorTextArray;
+  errorTextArray->SetName( "ErrorText" );
+
+  bool allSucceeded = true;
+  vtkNew<vtkMatrix4x4> toolTipToToolMatrix;
+  for ( std::vector<BatchCalibrationItem>::iterator itemIt = job.Items.begin(); itemIt != job.Items.end(); ++itemIt )
+  {
+    if ( ( computePivot && !itemIt->PivotSucceeded ) || ( computeSpin && !itemIt->SpinSucceeded ) )
+    {
+      allSucceeded = false;
+    }
+    pivotSucceededArray->InsertNextValue( itemIt->PivotSucceeded ? 1 : 0 );
+    pivotRmseArray->InsertNextValue( itemIt->PivotSucceeded ? itemIt->Calibrator->GetPivotRMSE() : 0.0 );
+    spinSucceededArray->InsertNextValue( itemIt->SpinSucceeded ? 1 : 0 );
+    spinRmseArray->InsertNextValue( itemIt->SpinSucceeded ? itemIt->Calibrator->GetSpinRMSE() : 0.0 );
+    itemIt->Calibrator->GetToolTipToToolMatrix( toolTipToToolMatrix.GetPointer() );
+    toolTipToToolArray->InsertNextTuple( &toolTipToToolMatrix->Element[ 0 ][ 0 ] );
+    errorTextArray->InsertNextValue( itemIt->ErrorText );
+  }
+
+  outputTable->Initialize();
+  outputTable->AddColumn( pivotSucceededArray.GetPointer() );
+  outputTable->AddColumn( pivotRmseArray.GetPointer() );
+  outputTable->AddColumn( spinSucceededArray.GetPointer() );
+  outputTable->AddColumn( spinRmseArray.GetPointer() );
+  outputTable->AddColumn( toolTipToToolArray.GetPointer() );
+  outputTable->AddColumn( errorTextArray.GetPointer() );
+
+  return allSucceeded;
+}
+
 //---------------------------------------------------------------------------
 void vtkSlicerPivotCalibrationLogic::GetToolTipToToolTranslation( vtkMatrix4x4* translationMatrix )
 {
@@ -30,14 +30,23 @@
 // MRML includes
 #include "vtkMRMLLinearTransformNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <vector>
 
 // VNL includes
 #include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector.h"
 
 #include "vtkSlicerPivotCalibrationModuleLogicExport.h"
 
+class vtkCollection;
+class vtkTable;
+
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 /// Module for calibrating a tracked pointer/stylus device.
@@ -54,7 +63,17 @@ public:
   vtkTypeMacro(vtkSlicerPivotCalibrationLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
-  // Clears all previously acquired tool transforms.
+  enum Events
+  {
+    // Invoked when recording is stopped automatically because the pivot calibration solution converged
+    // (in multi-tool calibration: the solutions of all tools converged)
+    RecordingAutoStoppedEvent = 21101,
+    // Invoked in multi-tool calibration when the solution of a tool converged and its recording is stopped.
+    // Call data is the tool transform node.
+    ToolRecordingAutoStoppedEvent
+  };
+
+  // Clears all previously acquired tool transforms (of all tools in multi-tool calibration).
   // Call this before start adding transforms.
   void ClearToolToReferenceMatrices();
 
@@ -63,20 +82,105 @@ public:
   vtkSetMacro(RecordingState, bool);
   void SetAndObserveTransformNode( vtkMRMLLinearTransformNode* );
 
-  // Add a single tool transform manually
+  // Add a single tool transform manually. The matrix is copied.
   void AddToolToReferenceMatrix( vtkMatrix4x4* );
 
+  // Number of currently stored tool transforms
+  vtkGetMacro(NumberOfToolToReferenceMatrices, unsigned int);
+
+  // Returns the maximum orientation difference in degrees between the first tool transformation
+  // and all the others. Used for determining if there was enough variation in the input data.
+  // The value is updated as transforms are added, so it is cheap to call it for each new sample.
+  // It is only recomputed from all samples if the first sample is discarded (ring buffer overflow).
+  double GetMaximumToolOrientationDifferenceDeg();
+
+  // Returns true if GetMaximumToolOrientationDifferenceDeg() is at least MinimumOrientationDifferenceDeg.
+  // After ring buffer overflow the answer is usually decided from bounds in constant time, without
+  // recomputing the maximum from all samples (see OrientationReferenceRotation).
+  bool IsToolOrientationDifferenceSufficient();
+
+  // Maximum number of stored tool transforms. If more transforms are added then the oldest ones are discarded
+  // (the buffer is used as a ring buffer). 0 means there is no limit (default).
+  // When a limit is set, memory for all the transforms is allocated in advance. Most recent transforms are kept
+  // when the limit is decreased.
+  void SetMaximumNumberOfToolToReferenceMatrices( unsigned int maximumNumberOfMatrices );
+  vtkGetMacro(MaximumNumberOfToolToReferenceMatrices, unsigned int);
+
   // Computes calibration results.
   // By default, automatically flips the shaft direction to be consistent with the needle orientation protocol.
   // Returns with false on failure
   bool ComputePivotCalibration( bool autoOrient = true );
 
+  // Computes pivot calibration results from the normal equations that are accumulated as each tool transform is added.
+  // The computation time does not depend on the number of recorded transforms, therefore it can be used
+  // for showing a live tip position estimate during recording (it is called automatically for each recorded transform).
+  // Results are stored in the Incremental... members, the ToolTipToToolMatrix is not changed.
+  // Returns with false on failure
+  bool ComputeIncrementalPivotCalibration();
+
+  // Computes the shaft axis from the spin calibration normal matrix that is accumulated as each tool transform is added
+  // (same as ComputeSpinCalibration without robust outlier rejection, snapping, and orientation checks).
+  // Only 3x3 matrix operations are performed, without memory allocation, therefore it can be used for showing
+  // a live axis estimate during recording (it is called automatically for each recorded transform).
+  // Results are stored in the Incremental... members, the ToolTipToToolMatrix is not changed.
+  // Returns with false on failure
+  bool ComputeIncrementalSpinCalibration();
+
   // Computes calibration results.
   // By default, automatically flips the shaft direction to be consistent with the needle orientation protocol.
   // Optionally, snaps the rotation to be a 90 degree rotation about one of the coordinate axes.
   // Returns with false on failure
   bool ComputeSpinCalibration( bool snapRotation = false, bool autoOrient = true ); // Note: The neede orientation protocol assumes that the shaft of the tool lies along the negative z-axis
 
+  // Robust calibration mode. If enabled then ComputePivotCalibration and ComputeSpinCalibration iteratively
+  // reject samples that have residual larger than OutlierRejectionFactor times the robust estimate of the
+  // residual standard deviation (1.4826 * median residual) and recompute the result from the remaining samples.
+  // This prevents a few bad poses (e.g., due to tracker dropouts or partially occluded markers) from
+  // spoiling the calibration. Disabled by default.
+  vtkGetMacro(RobustCalibration, bool);
+  vtkSetMacro(RobustCalibration, bool);
+  vtkBooleanMacro(RobustCalibration, bool);
+  vtkGetMacro(OutlierRejectionFactor, double);
+  vtkSetMacro(OutlierRejectionFactor, double);
+
+  // Per-sample results of the last ComputePivotCalibration or ComputeSpinCalibration call
+  // (sampleIndex = 0 is the oldest stored sample). Residual is the tip position error for pivot calibration
+  // and the axis direction error of the instantaneous rotation for spin calibration.
+  // All samples are inliers if robust calibration is disabled.
+  double GetSampleResidual( unsigned int sampleIndex );
+  bool GetSampleInlier( unsigned int sampleIndex );
+  vtkGetMacro(NumberOfInlierSamples, unsigned int);
+
+  // Batch calibration of multiple tools from recorded tracking sequences, without using the recording state of this logic.
+  // Each item of toolToReferenceMatrixArrays is a vtkDoubleArray that contains all the recorded ToolToReference transforms
+  // of one tool (16 components per tuple: 4x4 homogeneous transformation matrix, in row-major order).
+  // Pivot and/or spin calibration is computed for each tool using the same methods and settings
+  // (minimum orientation difference, robust calibration) as this logic. Tools are processed in parallel.
+  // Results are written to outputTable, one row for each input array, with the following columns:
+  //   PivotCalibrationSucceeded, PivotRMSE, SpinCalibrationSucceeded, SpinRMSE,
+  //   ToolTipToToolMatrix (16 components, row-major), ErrorText.
+  // Returns with false if any of the calibrations failed.
+  bool ComputeBatchCalibration( vtkCollection* toolToReferenceMatrixArrays, vtkTable* outputTable,
+    bool computePivot = true, bool computeSpin = true, bool snapRotation = false );
+
+  // Multi-tool calibration: many tools can be calibrated in one pivoting pass (e.g., a tray of instruments).
+  // Each tool has its own calibrator (an instance of this class, with its own sample buffer and incremental
+  // pivot calibration), which is created with the current settings of this logic. All tool transforms are observed
+  // and recorded while RecordingState is enabled, independently from the transform set by SetAndObserveTransformNode.
+  // If AutoStopRecording is enabled then recording of each tool stops when its solution converges.
+  // Returns the calibrator of the tool, which provides the calibration methods and results for that tool.
+  // Tools are removed automatically when their transform node is removed from the scene of this logic.
+  vtkSlicerPivotCalibrationLogic* AddTool( vtkMRMLLinearTransformNode* toolTransformNode );
+  void RemoveTool( vtkMRMLLinearTransformNode* toolTransformNode );
+  void RemoveAllTools();
+  int GetNumberOfTools();
+  // Tools are listed in the order they were added
+  vtkMRMLLinearTransformNode* GetNthToolTransformNode( int toolIndex );
+  // Returns NULL if the transform node is not a calibrated tool
+  vtkSlicerPivotCalibrationLogic* GetToolCalibrator( vtkMRMLLinearTransformNode* toolTransformNode );
+  // Computes the pivot calibration of all tools. Returns with false if any of them failed (see ErrorText).
+  bool ComputeAllToolsPivotCalibration( bool autoOrient = true );
+
   // Flip the direction of the shaft axis
   void FlipShaftDirection();
 
@@ -88,6 +192,27 @@ public:
   vtkGetMacro(PivotRMSE, double);
   vtkGetMacro(SpinRMSE, double);
 
+  // Get incremental pivot calibration results (updated by ComputeIncrementalPivotCalibration)
+  vtkGetVector3Macro(IncrementalToolTipToToolTranslation, double);
+  vtkGetVector3Macro(IncrementalPivotPoint_Reference, double);
+  vtkGetMacro(IncrementalPivotRMSE, double);
+  // Standard deviation of the tool tip position estimate (square root of the trace of its covariance matrix), in mm
+  vtkGetMacro(IncrementalToolTipPositionUncertaintyMm, double);
+
+  // Get incremental spin calibration results (updated by ComputeIncrementalSpinCalibration)
+  // Unit vector of the shaft axis in the ToolTip (i.e., tool) coordinate system, sign is arbitrary
+  vtkGetVector3Macro(IncrementalShaftAxis_ToolTip, double);
+  vtkGetMacro(IncrementalSpinRMSE, double);
+
+  // If enabled, recording stops automatically (and RecordingAutoStoppedEvent is invoked) when the tool tip
+  // position uncertainty of the incremental pivot calibration falls below AutoStopToolTipPositionUncertaintyThresholdMm
+  // and the orientation variation of the recorded transforms is sufficient for calibration. Disabled by default.
+  vtkGetMacro(AutoStopRecording, bool);
+  vtkSetMacro(AutoStopRecording, bool);
+  vtkBooleanMacro(AutoStopRecording, bool);
+  vtkGetMacro(AutoStopToolTipPositionUncertaintyThresholdMm, double);
+  vtkSetMacro(AutoStopToolTipPositionUncertaintyThresholdMm, double);
+
   // Returns human-readable description of the error occurred (non-empty if ComputePivotCalibration returns with failure)
   vtkGetMacro(ErrorText, std::string);
   
@@ -97,18 +222,57 @@ protected:
   
   void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );
 
+  virtual void SetMRMLSceneInternal( vtkMRMLScene* newScene );
+  // Stop observing transform nodes that are removed from the scene, so that no deleted node is referenced
+  virtual void OnMRMLSceneNodeRemoved( vtkMRMLNode* node );
+
+  // Add the current transform of the node, update the live estimate, and stop recording if the solution converged.
+  // Returns true if recording is stopped automatically.
+  bool RecordToolToReferenceTransform( vtkMRMLLinearTransformNode* transformNode );
+
   // Returns the orientation difference in degrees between two 4x4 homogeneous transformation matrix, in degrees.
   double GetOrientationDifferenceDeg(vtkMatrix4x4* aMatrix, vtkMatrix4x4* bMatrix);
-  
-  // Computes the maximum orientation difference in degrees between the first tool transformation
-  // and all the others. Used for determining if there was enough variation in the input data.
-  double GetMaximumToolOrientationDifferenceDeg();
+  // Same as above, for 3x3 rotation matrices stored in row-major arrays
+  static double GetOrientationDifferenceDeg(const double* aRotation, const double* bRotation);
+
 
   // Verify whether the tool's shaft is in the same direction as the ToolTip to Tool vector.
   // Rotate the ToolTip coordinate frame by 180 degrees about the secondary axis to make the 
   // shaft in the same direction as the ToolTip to Tool vector, if this is not already the case.
   void UpdateShaftDirection();
 
+  // Add (weight = 1) or remove (weight = -1) the contribution of a tool transform to the pivot calibration normal equations
+  void AccumulatePivotCalibrationSample( const double* rotation, const double* translation, double weight );
+
+  // Add the contribution of a tool transform to the specified normal equations
+  static void AddPivotCalibrationSampleToNormalEquations( const double* rotation, const double* translation, double weight,
+    vnl_matrix<double>& normalMatrix, vnl_vector<double>& normalVector, double& sumOfSquaredTranslations );
+
+  // Add (weight = 1) or remove (weight = -1) the contribution of the instantaneous rotation between two
+  // consecutive tool transforms to the spin calibration normal matrix
+  void AccumulateSpinCalibrationPair( const double* previousRotation, const double* currentRotation, double weight );
+
+  // Compute (RI-I)'*(RI-I) (row-major) of the instantaneous rotation RI = inv(current) * previous
+  static void ComputeSpinCalibrationPairMatrix( const double* previousRotation, const double* currentRotation, double* pairMatrix );
+
+  // Iteratively reject outliers and recompute the pivot calibration solution x from the inliers
+  bool ComputeRobustPivotCalibration( vnl_vector<double>& x );
+  // Compute the tip position error of each sample for the pivot calibration solution x
+  void ComputePivotCalibrationResiduals( const vnl_vector<double>& x );
+  // Compute the axis direction error of each instantaneous rotation (RI-I)'*(RI-I) matrix, stored row-major
+  static void ComputeSpinCalibrationResiduals( const std::vector<double>& pairMatrices,
+    const vnl_vector<double>& shaftAxis_ToolTip, std::vector<double>& pairResiduals );
+  // Returns the outlier threshold computed from the current SampleResiduals
+  double GetOutlierThreshold( double minimumThreshold );
+  // Update SampleInlierMask from the residuals, returns true if the mask changed
+  bool UpdateSampleInlierMask( const std::vector<double>& residuals, double outlierThreshold );
+
+  // Access the stored tool transforms (sampleIndex = 0 is the oldest sample).
+  // Rotation is a row-major 3x3 matrix.
+  const double* GetToolToReferenceRotation( unsigned int sampleIndex );
+  const double* GetToolToReferenceTranslation( unsigned int sampleIndex );
+  unsigned int GetToolToReferenceStorageIndex( unsigned int sampleIndex );
+
   // Helper method to compute the secondary axis, given a shaft axis
   static vnl_vector< double > ComputeSecondaryAxis( vnl_vector< double > shaftAxis_ToolTip );
 
@@ -120,15 +284,73 @@ private:
 
   // Calibration inputs
   double MinimumOrientationDifferenceDeg;
-  std::vector< vtkMatrix4x4* > ToolToReferenceMatrices;
+  // Tool transforms are stored in contiguous arrays, without allocating an object for each sample:
+  // 9 rotation (row-major) and 3 translation components for each sample.
+  // If MaximumNumberOfToolToReferenceMatrices is set then the arrays are used as a ring buffer,
+  // FirstToolToReferenceMatrixIndex is the storage index of the oldest sample.
+  std::vector< double > ToolToReferenceRotations;
+  std::vector< double > ToolToReferenceTranslations;
+  unsigned int NumberOfToolToReferenceMatrices;
+  unsigned int MaximumNumberOfToolToReferenceMatrices;
+  unsigned int FirstToolToReferenceMatrixIndex;
+  // Running maximum of the orientation difference from the first stored sample
+  double MaximumToolOrientationDifferenceDeg;
+  // False if MaximumToolOrientationDifferenceDeg has to be recomputed because the first sample has changed
+  bool MaximumToolOrientationDifferenceValid;
+  // Bounds of the orientation difference after the first sample has changed. The orientation difference is a
+  // metric, so for any stored sample: difference(first, sample) <= difference(first, reference) + difference(reference, sample).
+  // The reference is the first sample at the last full computation (or at the start of recording), and
+  // MaximumOrientationDifferenceFromReferenceDeg is the maximum difference from it of all samples since then.
+  // The witness is a stored sample, its difference from the first sample is a lower bound of the maximum.
+  double OrientationReferenceRotation[9];
+  bool OrientationReferenceValid;
+  double MaximumOrientationDifferenceFromReferenceDeg;
+  unsigned int OrientationDifferenceWitnessStorageIndex;
+  bool OrientationDifferenceWitnessValid;
+  // Preallocated matrix for retrieving the observed transform
+  vtkMatrix4x4* RecordedToolToReferenceMatrix;
   vtkMRMLLinearTransformNode* ObservedTransformNode;
   bool RecordingState;
 
+  // Pivot calibration normal equations (A'*A, A'*b, b'*b) accumulated from all the input transforms
+  vnl_matrix<double> PivotNormalMatrix;
+  vnl_vector<double> PivotNormalVector;
+  double PivotSumOfSquaredTranslations;
+
+  // Spin calibration normal matrix (sum of (RI-I)'*(RI-I) of the instantaneous rotations, row-major)
+  // accumulated from consecutive input transforms
+  double SpinNormalMatrix[9];
+
   // Calibration results
   vtkMatrix4x4* ToolTipToToolMatrix;
   double PivotRMSE;
   double SpinRMSE; 
   std::string ErrorText;
+
+  // Robust calibration
+  bool RobustCalibration;
+  double OutlierRejectionFactor;
+  std::vector<double> SampleResiduals;
+  std::vector<char> SampleInlierMask;
+  unsigned int NumberOfInlierSamples;
+
+  // Incremental pivot calibration results
+  double IncrementalToolTipToToolTranslation[3];
+  double IncrementalPivotPoint_Reference[3];
+  double IncrementalPivotRMSE;
+  double IncrementalToolTipPositionUncertaintyMm;
+
+  // Incremental spin calibration results
+  double IncrementalShaftAxis_ToolTip[3];
+  double IncrementalSpinRMSE;
+
+  // Automatic stop of recording
+  bool AutoStopRecording;
+  double AutoStopToolTipPositionUncertaintyThresholdMm;
+
+  // Multi-tool calibration. Events of the observed nodes are dispatched to the calibrators through the map.
+  std::vector< vtkMRMLLinearTransformNode* > ToolTransformNodes;
+  std::map< vtkMRMLLinearTransformNode*, vtkSmartPointer< vtkSlicerPivotCalibrationLogic > > ToolCalibrators;
 };
 
 #endif
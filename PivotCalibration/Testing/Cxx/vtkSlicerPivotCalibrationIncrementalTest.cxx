@@ -0,0 +1,216 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks that the incremental pivot calibration (normal equations accumulated as transforms are added)
+// gives the same tool tip position and RMSE as the batch ComputePivotCalibration, after each added
+// transform, when the oldest transforms are discarded from the ring buffer, when the buffer size is
+// decreased, and after the transforms are cleared.
+
+// PivotCalibration includes
+#include "vtkSlicerPivotCalibrationLogic.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double MAXIMUM_PIVOT_ANGLE_DEG = 40.0;
+const double NOISE_MM = 0.2;
+// the batch computation solves the full system with SVD, the incremental one the normal equations
+const double COMPARISON_TOLERANCE_MM = 1e-6;
+// distance of the estimate from the ground truth, for the noise above
+const double GROUND_TRUTH_TOLERANCE_MM = 0.5;
+
+//----------------------------------------------------------------------------
+// Tool pivoting around the pivot point with the tool tip, with noise added to the tool position
+void CreateToolToReferenceMatrix( const double toolTip_Tool[ 3 ], const double pivotPoint_Reference[ 3 ], vtkMatrix4x4* toolToReferenceMatrix )
+{
+  vtkNew<vtkTransform> rotation;
+  rotation->RotateWXYZ( vtkMath::Random( -MAXIMUM_PIVOT_ANGLE_DEG, MAXIMUM_PIVOT_ANGLE_DEG ),
+    vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ) );
+  double toolTip_Reference[ 3 ];
+  rotation->TransformVector( toolTip_Tool, toolTip_Reference );
+  toolToReferenceMatrix->DeepCopy( rotation->GetMatrix() );
+  for ( int i = 0; i < 3; i++ )
+  {
+    toolToReferenceMatrix->SetElement( i, 3, pivotPoint_Reference[ i ] - toolTip_Reference[ i ] + vtkMath::Gaussian( 0.0, NOISE_MM ) );
+  }
+}
+
+//----------------------------------------------------------------------------
+bool CheckIncrementalResults( vtkSlicerPivotCalibrationLogic* logic, const char* description )
+{
+  if ( !logic->ComputeIncrementalPivotCalibration() )
+  {
+    std::cerr << description << ": incremental pivot calibration failed: " << logic->GetErrorText() << std::endl;
+    return false;
+  }
+  if ( !logic->ComputePivotCalibration( false ) )
+  {
+    std::cerr << description << ": pivot calibration failed: " << logic->GetErrorText() << std::endl;
+    return false;
+  }
+  vtkNew<vtkMatrix4x4> toolTipToToolTranslation;
+  logic->GetToolTipToToolTranslation( toolTipToToolTranslation.GetPointer() );
+  double* incrementalToolTipToToolTranslation = logic->GetIncrementalToolTipToToolTranslation();
+  for ( int i = 0; i < 3; i++ )
+  {
+    if ( fabs( incrementalToolTipToToolTranslation[ i ] - toolTipToToolTranslation->GetElement( i, 3 ) ) > COMPARISON_TOLERANCE_MM )
+    {
+      std::cerr << description << ": incremental tool tip position component " << i << " is " << incrementalToolTipToToolTranslation[ i ]
+        << ", pivot calibration result is " << toolTipToToolTranslation->GetElement( i, 3 ) << std::endl;
+      return false;
+    }
+  }
+  if ( fabs( logic->GetIncrementalPivotRMSE() - logic->GetPivotRMSE() ) > COMPARISON_TOLERANCE_MM )
+  {
+    std::cerr << description << ": incremental RMSE is " << logic->GetIncrementalPivotRMSE()
+      << ", pivot calibration RMSE is " << logic->GetPivotRMSE() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool CheckGroundTruth( vtkSlicerPivotCalibrationLogic* logic, const double toolTip_Tool[ 3 ], const double pivotPoint_Reference[ 3 ], const char* description )
+{
+  if ( !logic->ComputeIncrementalPivotCalibration() )
+  {
+    std::cerr << description << ": incremental pivot calibration failed: " << logic->GetErrorText() << std::endl;
+    return false;
+  }
+  double toolTipErrorMm = sqrt( vtkMath::Distance2BetweenPoints( logic->GetIncrementalToolTipToToolTranslation(), toolTip_Tool ) );
+  double pivotPointErrorMm = sqrt( vtkMath::Distance2BetweenPoints( logic->GetIncrementalPivotPoint_Reference(), pivotPoint_Reference ) );
+  if ( toolTipErrorMm > GROUND_TRUTH_TOLERANCE_MM || pivotPointErrorMm > GROUND_TRUTH_TOLERANCE_MM )
+  {
+    std::cerr << description << ": tool tip position error is " << toolTipErrorMm << "mm, pivot point error is " << pivotPointErrorMm << "mm" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerPivotCalibrationIncrementalTest( int vtkNotUsed(argc), char* vtkNotUsed(argv)[] )
+{
+  const unsigned int numberOfMatrices = 100;
+  const unsigned int maximumNumberOfMatrices = 30;
+  const double toolTip_Tool[ 3 ] = { 2.0, -3.0, 150.0 };
+  const double otherToolTip_Tool[ 3 ] = { -10.0, 5.0, 120.0 };
+  const double pivotPoint_Reference[ 3 ] = { 100.0, 50.0, -20.0 };
+  bool success = true;
+
+  vtkMath::RandomSeed( 42 );
+  vtkNew<vtkMatrix4x4> toolToReferenceMatrix;
+
+  // Incremental results are the same as batch results after each added transform
+  vtkNew<vtkSlicerPivotCalibrationLogic> logic;
+  for ( unsigned int matrixIndex = 0; matrixIndex < numberOfMatrices; matrixIndex++ )
+  {
+    CreateToolToReferenceMatrix( toolTip_Tool, pivotPoint_Reference, toolToReferenceMatrix.GetPointer() );
+    logic->AddToolToReferenceMatrix( toolToReferenceMatrix.GetPointer() );
+    if ( logic->GetNumberOfToolToReferenceMatrices() >= 10 )
+    {
+      success &= CheckIncrementalResults( logic.GetPointer(), "Added transforms" );
+    }
+  }
+  success &= CheckGroundTruth( logic.GetPointer(), toolTip_Tool, pivotPoint_Reference, "Added transforms" );
+
+  // Decreasing the buffer size keeps only the most recent transforms in the normal equations
+  logic->SetMaximumNumberOfToolToReferenceMatrices( maximumNumberOfMatrices );
+  success &= CheckIncrementalResults( logic.GetPointer(), "Decreased buffer size" );
+
+  // Clearing the transforms clears the normal equations
+  logic->ClearToolToReferenceMatrices();
+  if ( logic->ComputeIncrementalPivotCalibration() )
+  {
+    std::cerr << "Incremental pivot calibration succeeded without transforms" << std::endl;
+    success = false;
+  }
+  for ( unsigned int matrixIndex = 0; matrixIndex < 10; matrixIndex++ )
+  {
+    CreateToolToReferenceMatrix( otherToolTip_Tool, pivotPoint_Reference, toolToReferenceMatrix.GetPointer() );
+    logic->AddToolToReferenceMatrix( toolToReferenceMatrix.GetPointer() );
+  }
+  success &= CheckIncrementalResults( logic.GetPointer(), "Cleared transforms" );
+
+  // Contribution of the discarded transforms is removed when the ring buffer is full:
+  // transforms of a different tool tip position are added first, they must not affect the result at the end
+  vtkNew<vtkSlicerPivotCalibrationLogic> ringBufferLogic;
+  ringBufferLogic->SetMaximumNumberOfToolToReferenceMatrices( maximumNumberOfMatrices );
+  std::vector< vtkSmartPointer<vtkMatrix4x4> > recentMatrices;
+  for ( unsigned int matrixIndex = 0; matrixIndex < numberOfMatrices; matrixIndex++ )
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    CreateToolToReferenceMatrix( matrixIndex < numberOfMatrices / 2 ? otherToolTip_Tool : toolTip_Tool, pivotPoint_Reference, matrix );
+    ringBufferLogic->AddToolToReferenceMatrix( matrix );
+    if ( matrixIndex >= numberOfMatrices - maximumNumberOfMatrices )
+    {
+      recentMatrices.push_back( matrix );
+    }
+    if ( ringBufferLogic->GetNumberOfToolToReferenceMatrices() >= 10 )
+    {
+      success &= CheckIncrementalResults( ringBufferLogic.GetPointer(), "Ring buffer" );
+    }
+  }
+  success &= CheckGroundTruth( ringBufferLogic.GetPointer(), toolTip_Tool, pivotPoint_Reference, "Ring buffer" );
+
+  // Same result as calibration from only the transforms that are kept in the buffer
+  vtkNew<vtkSlicerPivotCalibrationLogic> recentMatricesLogic;
+  for ( unsigned int matrixIndex = 0; matrixIndex < recentMatrices.size(); matrixIndex++ )
+  {
+    recentMatricesLogic->AddToolToReferenceMatrix( recentMatrices[ matrixIndex ] );
+  }
+  if ( recentMatricesLogic->ComputePivotCalibration( false ) && ringBufferLogic->ComputeIncrementalPivotCalibration() )
+  {
+    vtkNew<vtkMatrix4x4> toolTipToToolTranslation;
+    recentMatricesLogic->GetToolTipToToolTranslation( toolTipToToolTranslation.GetPointer() );
+    for ( int i = 0; i < 3; i++ )
+    {
+      if ( fabs( ringBufferLogic->GetIncrementalToolTipToToolTranslation()[ i ] - toolTipToToolTranslation->GetElement( i, 3 ) ) > COMPARISON_TOLERANCE_MM )
+      {
+        std::cerr << "Ring buffer: result differs from the calibration of the kept transforms" << std::endl;
+        success = false;
+        break;
+      }
+    }
+  }
+  else
+  {
+    std::cerr << "Ring buffer: pivot calibration failed" << std::endl;
+    success = false;
+  }
+
+  if ( !success )
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "Incremental pivot calibration results match batch pivot calibration" << std::endl;
+  return EXIT_SUCCESS;
+}
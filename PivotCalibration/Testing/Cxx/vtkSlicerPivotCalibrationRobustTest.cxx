@@ -0,0 +1,256 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks robust pivot and spin calibration on simulated recordings with bad poses:
+// the bad poses are reported as outliers (and only those), the result is close to the ground truth
+// and closer than the result of the non-robust calibration. Without bad poses, robust calibration
+// keeps all samples and gives the same result as the non-robust calibration.
+
+// PivotCalibration includes
+#include "vtkSlicerPivotCalibrationLogic.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+const unsigned int NUMBER_OF_MATRICES = 100;
+// every OUTLIER_PERIOD-th sample is a bad pose
+const unsigned int OUTLIER_PERIOD = 10;
+const unsigned int OUTLIER_OFFSET = 5;
+const double MAXIMUM_PIVOT_ANGLE_DEG = 40.0;
+const double PIVOT_NOISE_MM = 0.2;
+const double PIVOT_OUTLIER_OFFSET_MM[ 3 ] = { 15.0, -10.0, 20.0 };
+const double PIVOT_TOLERANCE_MM = 0.5;
+const double SPIN_ANGLE_STEP_DEG = 3.0;
+const double SPIN_NOISE_DEG = 0.1;
+const double SPIN_OUTLIER_ANGLE_DEG = 30.0;
+const double SPIN_TOLERANCE_DEG = 0.5;
+const double COMPARISON_TOLERANCE = 1e-9;
+
+//----------------------------------------------------------------------------
+bool IsOutlierSample( unsigned int sampleIndex, bool withOutliers )
+{
+  return withOutliers && ( sampleIndex % OUTLIER_PERIOD == OUTLIER_OFFSET );
+}
+
+//----------------------------------------------------------------------------
+// Tool pivoting around the pivot point with the tool tip, with noise added to the tool position.
+// Outlier samples are displaced (e.g., the tool tip slipped from the pivot point).
+void AddPivotCalibrationSamples( vtkSlicerPivotCalibrationLogic* logic, const double toolTip_Tool[ 3 ], const double pivotPoint_Reference[ 3 ], bool withOutliers )
+{
+  vtkNew<vtkMatrix4x4> toolToReferenceMatrix;
+  for ( unsigned int sampleIndex = 0; sampleIndex < NUMBER_OF_MATRICES; sampleIndex++ )
+  {
+    vtkNew<vtkTransform> rotation;
+    rotation->RotateWXYZ( vtkMath::Random( -MAXIMUM_PIVOT_ANGLE_DEG, MAXIMUM_PIVOT_ANGLE_DEG ),
+      vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ) );
+    double toolTip_Reference[ 3 ];
+    rotation->TransformVector( toolTip_Tool, toolTip_Reference );
+    toolToReferenceMatrix->DeepCopy( rotation->GetMatrix() );
+    for ( int i = 0; i < 3; i++ )
+    {
+      double translation = pivotPoint_Reference[ i ] - toolTip_Reference[ i ] + vtkMath::Gaussian( 0.0, PIVOT_NOISE_MM );
+      if ( IsOutlierSample( sampleIndex, withOutliers ) )
+      {
+        translation += PIVOT_OUTLIER_OFFSET_MM[ i ];
+      }
+      toolToReferenceMatrix->SetElement( i, 3, translation );
+    }
+    logic->AddToolToReferenceMatrix( toolToReferenceMatrix.GetPointer() );
+  }
+}
+
+//----------------------------------------------------------------------------
+// Tool spinning around its shaft axis, with small rotation noise.
+// Outlier samples are rotated around a different axis (e.g., wrong marker pose).
+void AddSpinCalibrationSamples( vtkSlicerPivotCalibrationLogic* logic, const double shaftAxis_Tool[ 3 ], bool withOutliers )
+{
+  vtkNew<vtkTransform> toolToReferenceTransform;
+  for ( unsigned int sampleIndex = 0; sampleIndex < NUMBER_OF_MATRICES / 2; sampleIndex++ )
+  {
+    toolToReferenceTransform->Identity();
+    toolToReferenceTransform->Translate( 100.0, 50.0, -20.0 );
+    toolToReferenceTransform->RotateWXYZ( 20.0, 1.0, 1.0, 0.0 );
+    toolToReferenceTransform->RotateWXYZ( sampleIndex * SPIN_ANGLE_STEP_DEG, shaftAxis_Tool[ 0 ], shaftAxis_Tool[ 1 ], shaftAxis_Tool[ 2 ] );
+    toolToReferenceTransform->RotateWXYZ( vtkMath::Gaussian( 0.0, SPIN_NOISE_DEG ),
+      vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ) );
+    if ( IsOutlierSample( sampleIndex, withOutliers ) )
+    {
+      toolToReferenceTransform->RotateWXYZ( SPIN_OUTLIER_ANGLE_DEG, 1.0, 0.0, 0.0 );
+    }
+    logic->AddToolToReferenceMatrix( toolToReferenceTransform->GetMatrix() );
+  }
+}
+
+//----------------------------------------------------------------------------
+bool CheckInliers( vtkSlicerPivotCalibrationLogic* logic, bool withOutliers, const char* description )
+{
+  unsigned int expectedNumberOfInlierSamples = 0;
+  for ( unsigned int sampleIndex = 0; sampleIndex < logic->GetNumberOfToolToReferenceMatrices(); sampleIndex++ )
+  {
+    bool expectedInlier = !IsOutlierSample( sampleIndex, withOutliers );
+    if ( logic->GetSampleInlier( sampleIndex ) != expectedInlier )
+    {
+      std::cerr << description << ": sample " << sampleIndex << " (residual " << logic->GetSampleResidual( sampleIndex ) << ") is "
+        << ( expectedInlier ? "an outlier" : "an inlier" ) << ", expected the opposite" << std::endl;
+      return false;
+    }
+    if ( expectedInlier )
+    {
+      expectedNumberOfInlierSamples++;
+    }
+  }
+  if ( logic->GetNumberOfInlierSamples() != expectedNumberOfInlierSamples )
+  {
+    std::cerr << description << ": number of inlier samples is " << logic->GetNumberOfInlierSamples()
+      << ", expected " << expectedNumberOfInlierSamples << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Returns the tool tip position error in mm, or a negative value if the calibration failed
+double ComputePivotCalibrationError( vtkSlicerPivotCalibrationLogic* logic, const double toolTip_Tool[ 3 ], const char* description )
+{
+  if ( !logic->ComputePivotCalibration( false ) )
+  {
+    std::cerr << description << ": pivot calibration failed: " << logic->GetErrorText() << std::endl;
+    return -1.0;
+  }
+  vtkNew<vtkMatrix4x4> toolTipToToolMatrix;
+  logic->GetToolTipToToolTranslation( toolTipToToolMatrix.GetPointer() );
+  double toolTipErrorMm = 0.0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    toolTipErrorMm += ( toolTipToToolMatrix->GetElement( i, 3 ) - toolTip_Tool[ i ] ) * ( toolTipToToolMatrix->GetElement( i, 3 ) - toolTip_Tool[ i ] );
+  }
+  return sqrt( toolTipErrorMm );
+}
+
+//----------------------------------------------------------------------------
+// Returns the shaft axis direction error in degrees (regardless of the direction of the axis),
+// or a negative value if the calibration failed
+double ComputeSpinCalibrationError( vtkSlicerPivotCalibrationLogic* logic, const double shaftAxis_Tool[ 3 ], const char* description )
+{
+  if ( !logic->ComputeSpinCalibration( false, false ) )
+  {
+    std::cerr << description << ": spin calibration failed: " << logic->GetErrorText() << std::endl;
+    return -1.0;
+  }
+  // the shaft is along the -z axis of the tool tip coordinate system
+  vtkNew<vtkMatrix4x4> toolTipToToolRotation;
+  logic->GetToolTipToToolRotation( toolTipToToolRotation.GetPointer() );
+  double computedShaftAxis_Tool[ 3 ] = { 0.0, 0.0, 0.0 };
+  double normalizedShaftAxis_Tool[ 3 ] = { shaftAxis_Tool[ 0 ], shaftAxis_Tool[ 1 ], shaftAxis_Tool[ 2 ] };
+  vtkMath::Normalize( normalizedShaftAxis_Tool );
+  for ( int i = 0; i < 3; i++ )
+  {
+    computedShaftAxis_Tool[ i ] = -toolTipToToolRotation->GetElement( i, 2 );
+  }
+  double cosAngle = std::min( 1.0, fabs( vtkMath::Dot( computedShaftAxis_Tool, normalizedShaftAxis_Tool ) ) );
+  return vtkMath::DegreesFromRadians( acos( cosAngle ) );
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerPivotCalibrationRobustTest( int vtkNotUsed(argc), char* vtkNotUsed(argv)[] )
+{
+  const double toolTip_Tool[ 3 ] = { 2.0, -3.0, 150.0 };
+  const double pivotPoint_Reference[ 3 ] = { 100.0, 50.0, -20.0 };
+  const double shaftAxis_Tool[ 3 ] = { 0.2, -0.1, 1.0 };
+  bool success = true;
+
+  vtkMath::RandomSeed( 42 );
+
+  // Pivot calibration with bad poses
+  vtkNew<vtkSlicerPivotCalibrationLogic> pivotLogic;
+  AddPivotCalibrationSamples( pivotLogic.GetPointer(), toolTip_Tool, pivotPoint_Reference, true );
+  double nonRobustPivotErrorMm = ComputePivotCalibrationError( pivotLogic.GetPointer(), toolTip_Tool, "Non-robust pivot calibration" );
+  pivotLogic->RobustCalibrationOn();
+  double robustPivotErrorMm = ComputePivotCalibrationError( pivotLogic.GetPointer(), toolTip_Tool, "Robust pivot calibration" );
+  if ( robustPivotErrorMm < 0 || nonRobustPivotErrorMm < 0 || robustPivotErrorMm > PIVOT_TOLERANCE_MM || robustPivotErrorMm >= nonRobustPivotErrorMm )
+  {
+    std::cerr << "Robust pivot calibration: tool tip position error is " << robustPivotErrorMm << "mm, non-robust error is " << nonRobustPivotErrorMm << "mm" << std::endl;
+    success = false;
+  }
+  success &= CheckInliers( pivotLogic.GetPointer(), true, "Robust pivot calibration" );
+  if ( pivotLogic->GetPivotRMSE() > PIVOT_TOLERANCE_MM )
+  {
+    std::cerr << "Robust pivot calibration: RMSE of the inliers is " << pivotLogic->GetPivotRMSE() << "mm" << std::endl;
+    success = false;
+  }
+
+  // Pivot calibration without bad poses: all samples are kept
+  vtkNew<vtkSlicerPivotCalibrationLogic> cleanPivotLogic;
+  AddPivotCalibrationSamples( cleanPivotLogic.GetPointer(), toolTip_Tool, pivotPoint_Reference, false );
+  nonRobustPivotErrorMm = ComputePivotCalibrationError( cleanPivotLogic.GetPointer(), toolTip_Tool, "Non-robust pivot calibration" );
+  double nonRobustPivotRMSE = cleanPivotLogic->GetPivotRMSE();
+  cleanPivotLogic->RobustCalibrationOn();
+  robustPivotErrorMm = ComputePivotCalibrationError( cleanPivotLogic.GetPointer(), toolTip_Tool, "Robust pivot calibration" );
+  if ( fabs( robustPivotErrorMm - nonRobustPivotErrorMm ) > COMPARISON_TOLERANCE || fabs( cleanPivotLogic->GetPivotRMSE() - nonRobustPivotRMSE ) > COMPARISON_TOLERANCE )
+  {
+    std::cerr << "Robust pivot calibration without outliers: result differs from the non-robust result" << std::endl;
+    success = false;
+  }
+  success &= CheckInliers( cleanPivotLogic.GetPointer(), false, "Robust pivot calibration without outliers" );
+
+  // Spin calibration with bad poses
+  vtkNew<vtkSlicerPivotCalibrationLogic> spinLogic;
+  AddSpinCalibrationSamples( spinLogic.GetPointer(), shaftAxis_Tool, true );
+  double nonRobustSpinErrorDeg = ComputeSpinCalibrationError( spinLogic.GetPointer(), shaftAxis_Tool, "Non-robust spin calibration" );
+  spinLogic->RobustCalibrationOn();
+  double robustSpinErrorDeg = ComputeSpinCalibrationError( spinLogic.GetPointer(), shaftAxis_Tool, "Robust spin calibration" );
+  if ( robustSpinErrorDeg < 0 || nonRobustSpinErrorDeg < 0 || robustSpinErrorDeg > SPIN_TOLERANCE_DEG || robustSpinErrorDeg >= nonRobustSpinErrorDeg )
+  {
+    std::cerr << "Robust spin calibration: shaft axis error is " << robustSpinErrorDeg << "deg, non-robust error is " << nonRobustSpinErrorDeg << "deg" << std::endl;
+    success = false;
+  }
+  success &= CheckInliers( spinLogic.GetPointer(), true, "Robust spin calibration" );
+
+  // Spin calibration without bad poses: all samples are kept
+  vtkNew<vtkSlicerPivotCalibrationLogic> cleanSpinLogic;
+  AddSpinCalibrationSamples( cleanSpinLogic.GetPointer(), shaftAxis_Tool, false );
+  nonRobustSpinErrorDeg = ComputeSpinCalibrationError( cleanSpinLogic.GetPointer(), shaftAxis_Tool, "Non-robust spin calibration" );
+  cleanSpinLogic->RobustCalibrationOn();
+  robustSpinErrorDeg = ComputeSpinCalibrationError( cleanSpinLogic.GetPointer(), shaftAxis_Tool, "Robust spin calibration" );
+  if ( robustSpinErrorDeg < 0 || fabs( robustSpinErrorDeg - nonRobustSpinErrorDeg ) > COMPARISON_TOLERANCE )
+  {
+    std::cerr << "Robust spin calibration without outliers: result differs from the non-robust result" << std::endl;
+    success = false;
+  }
+  success &= CheckInliers( cleanSpinLogic.GetPointer(), false, "Robust spin calibration without outliers" );
+
+  if ( !success )
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "Robust pivot and spin calibration rejected the bad poses" << std::endl;
+  return EXIT_SUCCESS;
+}
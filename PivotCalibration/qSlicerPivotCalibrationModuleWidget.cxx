@@ -138,6 +138,8 @@ void qSlicerPivotCalibrationModuleWidget::setup()
   connect( d->durationTimerEdit, SIGNAL( valueChanged(double) ), this, SLOT( setSamplingDurationSec(double) ) );
 
   connect( d->flipButton, SIGNAL( clicked() ), this, SLOT( onFlipButtonClicked() ) );
+
+  qvtkConnect( d->logic(), vtkSlicerPivotCalibrationLogic::RecordingAutoStoppedEvent, this, SLOT( onRecordingAutoStopped() ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -190,6 +192,7 @@ void qSlicerPivotCalibrationModuleWidget::onPivotStartupTimeout()
     d->CountdownLabel->setText(ss2.str().c_str());
 
     this->pivotStartupTimer->stop();
+    d->logic()->SetAutoStopRecording( d->autoStopCheckBox->isChecked() );
     d->logic()->SetRecordingState(true);
     this->pivotSamplingTimer->start();
   }
@@ -237,6 +240,7 @@ void qSlicerPivotCalibrationModuleWidget::onSpinStartupTimeout()
     d->CountdownLabel->setText(ss2.str().c_str());
 
     this->spinStartupTimer->stop();
+    d->logic()->SetAutoStopRecording(false); // convergence is only checked for pivot calibration
     d->logic()->SetRecordingState(true);
     this->spinSamplingTimer->start();
   }
@@ -265,6 +269,20 @@ void qSlicerPivotCalibrationModuleWidget::onSpinSamplingTimeout()
 }
 
 
+//-----------------------------------------------------------------------------
+void qSlicerPivotCalibrationModuleWidget::onRecordingAutoStopped()
+{
+  Q_D(qSlicerPivotCalibrationModuleWidget);
+
+  if (!this->pivotSamplingTimer->isActive())
+  {
+    return;
+  }
+  this->pivotSamplingTimer->stop();
+  d->CountdownLabel->setText("Sampling complete (converged)");
+  this->onPivotStop();
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerPivotCalibrationModuleWidget::onPivotStop()
 {
@@ -60,6 +60,8 @@ protected slots:
   void onPivotSamplingTimeout();
   void onSpinStartupTimeout();
   void onSpinSamplingTimeout();
+
+  void onRecordingAutoStopped();
   
 protected:
   QScopedPointer<qSlicerPivotCalibrationModuleWidgetPrivate> d_ptr;
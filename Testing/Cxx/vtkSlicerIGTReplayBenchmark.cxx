@@ -0,0 +1,592 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Replays tracking streams (a tool moving relative to a tracked reference at 100Hz, and
+// optionally a live image at 30Hz) into a headless MRML scene and measures the performance
+// of the BreachWarning, VolumeResliceDriver, TransformProcessor, CollectPoints and Watchdog
+// logics. Each logic is measured alone, then all of them together.
+//
+// For each logic the throughput (updates per second), update time, latency distribution
+// (time from applying a sample to the update of the logic, see vtkLatencyInstrumentation)
+// and the number of memory allocations per replayed frame are reported.
+//
+// Allocations are counted if the tests are built with SLICERIGT_ENABLE_ALLOCATION_COUNTING
+// (operator new is replaced in this executable). Only the steady state is counted: the first
+// frames, which create the images and caches of the logics, are not included. The streams are
+// first replayed without any logic, and the allocations of this replay (updating the nodes and
+// invoking their events) are subtracted, so that only the allocations of the module are reported.
+// If an allocation budget is specified for a module and the allocations per frame of its scenario
+// exceed it then the benchmark fails, so hot paths that do not allocate memory are kept that way.
+//
+// Results are written as one JSON object per line (to the standard output or to the file
+// specified by the -o option), so that they can be collected and compared between builds.
+//
+// Usage: vtkSlicerIGTReplayBenchmark [--quick] [--realtime] [-o outputFile] [-d durationSec] [-i toolPosesFile]
+//          [--allocation-budget moduleName maximumAllocationsPerFrame]...
+//   --quick: short replay with small images (used when running as an automatic test)
+//   --realtime: replay at the rate of the streams instead of as fast as possible
+//   -i: replay recorded tool poses (see vtkTrackingStreamReplay::ReadPoseSamples) instead of synthetic motion
+//   --allocation-budget: fail if the single module scenario of the module allocates more per frame
+
+// IGTCommon includes
+#include "vtkLatencyInstrumentation.h"
+#include "vtkPerformanceCounters.h"
+#include "vtkTrackingStreamReplay.h"
+
+// SlicerIGT includes
+#include "vtkMRMLBreachWarningNode.h"
+#include "vtkMRMLCollectPointsNode.h"
+#include "vtkMRMLTransformProcessorNode.h"
+#include "vtkMRMLWatchdogNode.h"
+#include "vtkSlicerBreachWarningLogic.h"
+#include "vtkSlicerCollectPointsLogic.h"
+#include "vtkSlicerTransformProcessorLogic.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkSlicerWatchdogLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Allocation counting: all allocations of the test executable go through these operators.
+// The logics run on the main thread, so the counter is not synchronized.
+// Disabled by the SLICERIGT_ENABLE_ALLOCATION_COUNTING build option (e.g., for builds with
+// memory checkers that replace operator new themselves).
+static unsigned long NumberOfAllocations = 0;
+
+#ifdef SLICERIGT_ENABLE_ALLOCATION_COUNTING
+
+#if __cplusplus >= 201103L
+void* operator new(std::size_t size)
+#else
+void* operator new(std::size_t size) throw(std::bad_alloc)
+#endif
+{
+  NumberOfAllocations++;
+  void* memory = malloc(size > 0 ? size : 1);
+  if (memory == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+#if __cplusplus >= 201103L
+void operator delete(void* memory) noexcept
+#else
+void operator delete(void* memory) throw()
+#endif
+{
+  free(memory);
+}
+#endif
+
+namespace
+{
+
+const char* SCENARIO_ALL = "All";
+// Replay of the streams without any logic, to measure the allocations of the replay itself
+const char* SCENARIO_REPLAY_ONLY = "ReplayOnly";
+const char* SCENARIO_REPLAY_ONLY_WITH_IMAGE = "ReplayOnlyWithImage";
+const double POSE_RATE_HZ = 100.0;
+const double IMAGE_RATE_HZ = 30.0;
+// Frames replayed before allocations are counted (creation of images, caches, output arrays)
+const int NUMBER_OF_WARM_UP_FRAMES = 10;
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  bool RealTime;
+  double DurationSec;
+  int ImageWidth;
+  int ImageHeight;
+  const char* ToolPosesFileName;
+  // Maximum allocations per frame in the single module scenario, by module name
+  std::map<std::string, double> AllocationBudgets;
+};
+
+//----------------------------------------------------------------------------
+struct ReplayFrameObserverData
+{
+  vtkSlicerWatchdogLogic* WatchdogLogic;
+  // Time when the watchdog logic requested its next status check, -1 if none is scheduled
+  double WatchdogStatusCheckDueTimeSec;
+  unsigned long NumberOfAllocationsAtWarmUpEnd;
+};
+
+//----------------------------------------------------------------------------
+// Event loop hook of the watchdog logic: the replay loop plays the role of the application timer
+void WatchdogEventLoopHook(double timeUntilNextStatusCheckSec, void* clientData)
+{
+  ReplayFrameObserverData* data = static_cast<ReplayFrameObserverData*>(clientData);
+  data->WatchdogStatusCheckDueTimeSec = (timeUntilNextStatusCheckSec >= 0
+    ? vtkTimerLog::GetUniversalTime() + timeUntilNextStatusCheckSec : -1);
+}
+
+//----------------------------------------------------------------------------
+// Called after each replayed frame
+void ReplayFrameCallback(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eventId), void* clientData, void* callData)
+{
+  ReplayFrameObserverData* data = static_cast<ReplayFrameObserverData*>(clientData);
+  int frameIndex = *static_cast<int*>(callData);
+  if (frameIndex == NUMBER_OF_WARM_UP_FRAMES - 1)
+  {
+    // the first frames create the images and caches of the logics, they are not counted
+    data->NumberOfAllocationsAtWarmUpEnd = NumberOfAllocations;
+  }
+  if (data->WatchdogLogic != NULL && data->WatchdogStatusCheckDueTimeSec >= 0
+    && vtkTimerLog::GetUniversalTime() >= data->WatchdogStatusCheckDueTimeSec)
+  {
+    // the module calls this from its timer
+    data->WatchdogLogic->ProcessStatusChecks();
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Latency below which the given percentage of the samples are, estimated from the histogram
+/// (upper edge of the bin). Samples in the last, open-ended bin are reported as the maximum.
+double GetLatencyPercentileMs(const char* stageName, double percentile)
+{
+  vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+  int numberOfSamples = latencyInstrumentation->GetStageNumberOfSamples(stageName);
+  if (numberOfSamples == 0)
+  {
+    return 0.0;
+  }
+  int numberOfBins = latencyInstrumentation->GetNumberOfHistogramBins();
+  int cumulativeCount = 0;
+  for (int binIndex = 0; binIndex < numberOfBins - 1; binIndex++)
+  {
+    cumulativeCount += latencyInstrumentation->GetStageHistogramCount(stageName, binIndex);
+    if (cumulativeCount >= percentile / 100.0 * numberOfSamples)
+    {
+      return (binIndex + 1) * latencyInstrumentation->GetHistogramBinWidthSec() * 1000.0;
+    }
+  }
+  return latencyInstrumentation->GetStageMaximumLatencySec(stageName) * 1000.0;
+}
+
+//----------------------------------------------------------------------------
+void WriteResult(std::ostream& os, const std::string& scenario, vtkPerformanceCounters* counters,
+  vtkTrackingStreamReplay* replay, double allocationsPerFrame, double allocationBudget)
+{
+  vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+  const char* moduleName = counters->GetName();
+  double replayTimeSec = replay->GetReplayTimeSec();
+  os << "{\"benchmark\": \"IGTReplay\""
+    << ", \"scenario\": \"" << scenario << "\""
+    << ", \"module\": \"" << moduleName << "\""
+    << ", \"realTime\": " << (replay->GetRealTime() ? "true" : "false")
+    << ", \"frames\": " << replay->GetNumberOfReplayedFrames()
+    << ", \"framesPerSec\": " << replay->GetFramesPerSec()
+    << ", \"frameTimeMeanMs\": " << replay->GetMeanFrameProcessingTimeSec() * 1000.0
+    << ", \"frameTimeP99Ms\": " << replay->GetFrameProcessingTimePercentileSec(99.0) * 1000.0
+    << ", \"eventsReceived\": " << counters->GetNumberOfEventsReceived()
+    << ", \"updatesComputed\": " << counters->GetNumberOfUpdatesComputed()
+    << ", \"updatesSkipped\": " << counters->GetNumberOfUpdatesSkipped()
+    << ", \"updatesPerSec\": " << (replayTimeSec > 0 ? counters->GetNumberOfUpdatesComputed() / replayTimeSec : 0.0)
+    << ", \"updateTimeMeanMs\": " << counters->GetMeanUpdateTimeSec() * 1000.0
+    << ", \"updateTimeMaxMs\": " << counters->GetMaximumUpdateTimeSec() * 1000.0
+    << ", \"latencySamples\": " << latencyInstrumentation->GetStageNumberOfSamples(moduleName)
+    << ", \"latencyMeanMs\": " << latencyInstrumentation->GetStageMeanLatencySec(moduleName) * 1000.0
+    << ", \"latencyP50Ms\": " << GetLatencyPercentileMs(moduleName, 50.0)
+    << ", \"latencyP99Ms\": " << GetLatencyPercentileMs(moduleName, 99.0)
+    << ", \"latencyMaxMs\": " << latencyInstrumentation->GetStageMaximumLatencySec(moduleName) * 1000.0
+    << ", \"allocationsPerFrame\": " << allocationsPerFrame
+    << ", \"allocationBudget\": " << allocationBudget
+    << "}" << std::endl;
+}
+
+//----------------------------------------------------------------------------
+/// Returns true if the image stream is replayed in the scenario
+bool IsImageScenario(const std::string& scenario)
+{
+  return (scenario == SCENARIO_ALL || scenario == "VolumeResliceDriver" || scenario == SCENARIO_REPLAY_ONLY_WITH_IMAGE);
+}
+
+//----------------------------------------------------------------------------
+void WriteReplayOnlyResult(std::ostream& os, const std::string& scenario, vtkTrackingStreamReplay* replay, double allocationsPerFrame)
+{
+  os << "{\"benchmark\": \"IGTReplay\""
+    << ", \"scenario\": \"" << scenario << "\""
+    << ", \"realTime\": " << (replay->GetRealTime() ? "true" : "false")
+    << ", \"frames\": " << replay->GetNumberOfReplayedFrames()
+    << ", \"framesPerSec\": " << replay->GetFramesPerSec()
+    << ", \"frameTimeMeanMs\": " << replay->GetMeanFrameProcessingTimeSec() * 1000.0
+    << ", \"allocationsPerFrame\": " << allocationsPerFrame
+    << "}" << std::endl;
+}
+
+//----------------------------------------------------------------------------
+/// Replay the streams with the logic of the given module (or all logics) and write the results.
+/// Allocations per frame of the replay without logics (baselineAllocationsPerFrame) are subtracted
+/// from the allocations of the logics. The allocations per frame of the scenario are returned
+/// in allocationsPerFrame (-1 if not measured).
+/// Returns false if a logic did not compute any update or exceeded its allocation budget.
+bool RunScenario(const std::string& scenario, const BenchmarkOptions& options, double baselineAllocationsPerFrame,
+  std::ostream& os, double& allocationsPerFrame)
+{
+  bool allModules = (scenario == SCENARIO_ALL);
+  bool replayOnly = (scenario == SCENARIO_REPLAY_ONLY || scenario == SCENARIO_REPLAY_ONLY_WITH_IMAGE);
+  bool useImage = IsImageScenario(scenario);
+
+  vtkNew<vtkMRMLScene> scene;
+
+  vtkSmartPointer<vtkSlicerBreachWarningLogic> breachWarningLogic;
+  vtkSmartPointer<vtkSlicerCollectPointsLogic> collectPointsLogic;
+  vtkSmartPointer<vtkSlicerTransformProcessorLogic> transformProcessorLogic;
+  vtkSmartPointer<vtkSlicerVolumeResliceDriverLogic> volumeResliceDriverLogic;
+  vtkSmartPointer<vtkSlicerWatchdogLogic> watchdogLogic;
+  std::vector<vtkPerformanceCounters*> countersToReport;
+  if (allModules || scenario == "TransformProcessor")
+  {
+    transformProcessorLogic = vtkSmartPointer<vtkSlicerTransformProcessorLogic>::New();
+    transformProcessorLogic->SetMRMLScene(scene.GetPointer());
+    countersToReport.push_back(transformProcessorLogic->GetPerformanceCounters());
+  }
+  if (allModules || scenario == "VolumeResliceDriver")
+  {
+    volumeResliceDriverLogic = vtkSmartPointer<vtkSlicerVolumeResliceDriverLogic>::New();
+    volumeResliceDriverLogic->SetMRMLScene(scene.GetPointer());
+    // as in the module, image and transform changes of a frame are processed in one tick
+    volumeResliceDriverLogic->SetCoalesceUpdates(true);
+    countersToReport.push_back(volumeResliceDriverLogic->GetPerformanceCounters());
+  }
+  if (allModules || scenario == "BreachWarning")
+  {
+    breachWarningLogic = vtkSmartPointer<vtkSlicerBreachWarningLogic>::New();
+    breachWarningLogic->SetMRMLScene(scene.GetPointer());
+    countersToReport.push_back(breachWarningLogic->GetPerformanceCounters());
+  }
+  if (allModules || scenario == "CollectPoints")
+  {
+    collectPointsLogic = vtkSmartPointer<vtkSlicerCollectPointsLogic>::New();
+    collectPointsLogic->SetMRMLScene(scene.GetPointer());
+    countersToReport.push_back(collectPointsLogic->GetPerformanceCounters());
+  }
+  if (allModules || scenario == "Watchdog")
+  {
+    watchdogLogic = vtkSmartPointer<vtkSlicerWatchdogLogic>::New();
+    watchdogLogic->SetMRMLScene(scene.GetPointer());
+    countersToReport.push_back(watchdogLogic->GetPerformanceCounters());
+  }
+
+  // Tracked streams: Tool -> Reference -> RAS, and an image attached to the tool (tracked probe)
+  vtkNew<vtkMRMLLinearTransformNode> referenceToRasNode;
+  referenceToRasNode->SetName("ReferenceToRas");
+  scene->AddNode(referenceToRasNode.GetPointer());
+  vtkNew<vtkMRMLLinearTransformNode> toolToReferenceNode;
+  toolToReferenceNode->SetName("ToolToReference");
+  scene->AddNode(toolToReferenceNode.GetPointer());
+  toolToReferenceNode->SetAndObserveTransformNodeID(referenceToRasNode->GetID());
+  vtkNew<vtkMRMLScalarVolumeNode> imageNode;
+  if (useImage)
+  {
+    imageNode->SetName("Image");
+    scene->AddNode(imageNode.GetPointer());
+    imageNode->SetAndObserveTransformNodeID(toolToReferenceNode->GetID());
+  }
+
+  vtkNew<vtkTrackingStreamReplay> replay;
+  replay->SetRealTime(options.RealTime);
+  int toolStreamIndex = replay->AddPoseStream(toolToReferenceNode.GetPointer());
+  if (options.ToolPosesFileName != NULL)
+  {
+    if (!replay->ReadPoseSamples(toolStreamIndex, options.ToolPosesFileName))
+    {
+      std::cerr << "Failed to read tool poses from " << options.ToolPosesFileName << std::endl;
+      return false;
+    }
+  }
+  else
+  {
+    replay->GenerateSyntheticPoseSamples(toolStreamIndex, POSE_RATE_HZ, options.DurationSec);
+  }
+  // the reference moves slowly (e.g., patient breathing)
+  int referenceStreamIndex = replay->AddPoseStream(referenceToRasNode.GetPointer());
+  replay->GenerateSyntheticPoseSamples(referenceStreamIndex, POSE_RATE_HZ, options.DurationSec, 2.0);
+  if (useImage)
+  {
+    int imageStreamIndex = replay->AddImageStream(imageNode.GetPointer());
+    replay->GenerateSyntheticImageSamples(imageStreamIndex, IMAGE_RATE_HZ, options.DurationSec, options.ImageWidth, options.ImageHeight);
+  }
+
+  // Module setup
+  if (transformProcessorLogic != NULL)
+  {
+    vtkNew<vtkMRMLLinearTransformNode> referenceToToolNode;
+    referenceToToolNode->SetName("ReferenceToTool");
+    scene->AddNode(referenceToToolNode.GetPointer());
+    vtkNew<vtkMRMLTransformProcessorNode> processorNode;
+    scene->AddNode(processorNode.GetPointer());
+    processorNode->SetProcessingMode(vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_INVERSE);
+    processorNode->SetAndObserveInputForwardTransformNode(toolToReferenceNode.GetPointer());
+    processorNode->SetAndObserveOutputTransformNode(referenceToToolNode.GetPointer());
+    processorNode->SetUpdateModeToAuto();
+  }
+  if (volumeResliceDriverLogic != NULL)
+  {
+    vtkNew<vtkMRMLSliceNode> sliceNode;
+    sliceNode->SetLayoutName("Red");
+    scene->AddNode(sliceNode.GetPointer());
+    volumeResliceDriverLogic->SetDriverForSlice(imageNode->GetID(), sliceNode.GetPointer());
+    volumeResliceDriverLogic->SetModeForSlice(vtkSlicerVolumeResliceDriverLogic::MODE_INPLANE, sliceNode.GetPointer());
+  }
+  if (breachWarningLogic != NULL)
+  {
+    vtkNew<vtkSphereSource> sphere;
+    sphere->SetRadius(30.0);
+    sphere->SetThetaResolution(72);
+    sphere->SetPhiResolution(72);
+    sphere->Update();
+    vtkNew<vtkMRMLModelNode> watchedModelNode;
+    watchedModelNode->SetName("WatchedModel");
+    watchedModelNode->SetAndObservePolyData(sphere->GetOutput());
+    scene->AddNode(watchedModelNode.GetPointer());
+    vtkNew<vtkMRMLBreachWarningNode> bwNode;
+    scene->AddNode(bwNode.GetPointer());
+    bwNode->SetPlayWarningSound(false);
+    bwNode->SetAndObserveWatchedModelNodeID(watchedModelNode->GetID());
+    bwNode->SetAndObserveToolTransformNodeId(toolToReferenceNode->GetID());
+  }
+  if (collectPointsLogic != NULL)
+  {
+    vtkNew<vtkMRMLModelNode> collectedPointsNode;
+    collectedPointsNode->SetName("CollectedPoints");
+    scene->AddNode(collectedPointsNode.GetPointer());
+    vtkNew<vtkMRMLCollectPointsNode> collectPointsNode;
+    scene->AddNode(collectPointsNode.GetPointer());
+    collectPointsNode->SetOutputNodeID(collectedPointsNode->GetID());
+    collectPointsNode->SetAndObserveAnchorTransformNodeID(referenceToRasNode->GetID());
+    collectPointsNode->SetMinimumDistance(1.0);
+    collectPointsNode->SetAndObserveSamplingTransformNodeID(toolToReferenceNode->GetID());
+    collectPointsNode->SetCollectModeToAutomatic();
+  }
+  if (watchdogLogic != NULL)
+  {
+    vtkNew<vtkMRMLWatchdogNode> watchdogNode;
+    scene->AddNode(watchdogNode.GetPointer());
+    watchdogNode->AddWatchedNode(toolToReferenceNode.GetPointer(), "Tool is not tracked", 0.1);
+  }
+
+  ReplayFrameObserverData observerData;
+  observerData.WatchdogLogic = watchdogLogic;
+  observerData.WatchdogStatusCheckDueTimeSec = -1;
+  if (watchdogLogic != NULL)
+  {
+    watchdogLogic->SetEventLoopHook(WatchdogEventLoopHook, &observerData);
+  }
+  observerData.NumberOfAllocationsAtWarmUpEnd = 0;
+  vtkNew<vtkCallbackCommand> replayFrameCallback;
+  replayFrameCallback->SetCallback(ReplayFrameCallback);
+  replayFrameCallback->SetClientData(&observerData);
+  replay->AddObserver(vtkTrackingStreamReplay::ReplayFrameEvent, replayFrameCallback.GetPointer());
+
+  vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+  latencyInstrumentation->Reset();
+  latencyInstrumentation->SetEnabled(true);
+  bool replaySuccessful = replay->Replay();
+  unsigned long numberOfAllocationsAtLastFrame = NumberOfAllocations;
+  latencyInstrumentation->SetEnabled(false);
+  if (watchdogLogic != NULL)
+  {
+    watchdogLogic->SetEventLoopHook(NULL, NULL);
+  }
+  if (!replaySuccessful)
+  {
+    return false;
+  }
+
+  // -1 means not measured (allocation counting is disabled or the replay is too short)
+  int numberOfCountedFrames = replay->GetNumberOfReplayedFrames() - NUMBER_OF_WARM_UP_FRAMES;
+  allocationsPerFrame = -1.0;
+#ifdef SLICERIGT_ENABLE_ALLOCATION_COUNTING
+  if (numberOfCountedFrames > 0)
+  {
+    allocationsPerFrame = static_cast<double>(numberOfAllocationsAtLastFrame - observerData.NumberOfAllocationsAtWarmUpEnd) / numberOfCountedFrames;
+  }
+#else
+  (void)numberOfAllocationsAtLastFrame;
+#endif
+  if (replayOnly)
+  {
+    WriteReplayOnlyResult(os, scenario, replay.GetPointer(), allocationsPerFrame);
+    return true;
+  }
+  // allocations of the logics only
+  double moduleAllocationsPerFrame = allocationsPerFrame;
+  if (allocationsPerFrame >= 0 && baselineAllocationsPerFrame >= 0)
+  {
+    moduleAllocationsPerFrame = std::max(0.0, allocationsPerFrame - baselineAllocationsPerFrame);
+  }
+  bool success = true;
+  for (std::vector<vtkPerformanceCounters*>::iterator countersIt = countersToReport.begin(); countersIt != countersToReport.end(); ++countersIt)
+  {
+    const char* moduleName = (*countersIt)->GetName();
+    // allocations cannot be attributed to the modules when all of them are replayed together
+    double allocationBudget = -1.0;
+    std::map<std::string, double>::const_iterator budgetIt = options.AllocationBudgets.find(moduleName);
+    if (!allModules && budgetIt != options.AllocationBudgets.end())
+    {
+      allocationBudget = budgetIt->second;
+    }
+    WriteResult(os, scenario, *countersIt, replay.GetPointer(), moduleAllocationsPerFrame, allocationBudget);
+    if ((*countersIt)->GetNumberOfUpdatesComputed() == 0)
+    {
+      std::cerr << "Benchmark failed: " << moduleName << " did not compute any update (scenario: " << scenario << ")" << std::endl;
+      success = false;
+    }
+    if (allocationBudget >= 0 && moduleAllocationsPerFrame > allocationBudget)
+    {
+      std::cerr << "Benchmark failed: " << moduleName << " made " << moduleAllocationsPerFrame
+        << " allocations per frame, budget is " << allocationBudget << std::endl;
+      success = false;
+    }
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerIGTReplayBenchmark(int argc, char* argv[])
+{
+  bool quick = false;
+  const char* outputFileName = NULL;
+  BenchmarkOptions options;
+  options.RealTime = false;
+  options.DurationSec = 10.0;
+  options.ImageWidth = 640;
+  options.ImageHeight = 480;
+  options.ToolPosesFileName = NULL;
+  for (int argIndex = 1; argIndex < argc; argIndex++)
+  {
+    if (strcmp(argv[argIndex], "--quick") == 0)
+    {
+      quick = true;
+    }
+    else if (strcmp(argv[argIndex], "--realtime") == 0)
+    {
+      options.RealTime = true;
+    }
+    else if (strcmp(argv[argIndex], "-o") == 0 && argIndex + 1 < argc)
+    {
+      outputFileName = argv[++argIndex];
+    }
+    else if (strcmp(argv[argIndex], "-d") == 0 && argIndex + 1 < argc)
+    {
+      options.DurationSec = atof(argv[++argIndex]);
+    }
+    else if (strcmp(argv[argIndex], "-i") == 0 && argIndex + 1 < argc)
+    {
+      options.ToolPosesFileName = argv[++argIndex];
+    }
+    else if (strcmp(argv[argIndex], "--allocation-budget") == 0 && argIndex + 2 < argc)
+    {
+      const char* moduleName = argv[++argIndex];
+      options.AllocationBudgets[moduleName] = atof(argv[++argIndex]);
+    }
+    else
+    {
+      std::cerr << "Unknown argument: " << argv[argIndex] << std::endl;
+      std::cerr << "Usage: " << argv[0] << " [--quick] [--realtime] [-o outputFile] [-d durationSec] [-i toolPosesFile]"
+        << " [--allocation-budget moduleName maximumAllocationsPerFrame]..." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (quick)
+  {
+    options.DurationSec = std::min(options.DurationSec, 1.0);
+    options.ImageWidth = 64;
+    options.ImageHeight = 48;
+  }
+  if (options.DurationSec <= 0)
+  {
+    std::cerr << "Duration must be positive" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+#ifndef SLICERIGT_ENABLE_ALLOCATION_COUNTING
+  if (!options.AllocationBudgets.empty())
+  {
+    std::cerr << "Allocation counting is disabled in this build, allocation budgets are not checked" << std::endl;
+  }
+#endif
+
+  std::ofstream outputFile;
+  if (outputFileName != NULL)
+  {
+    outputFile.open(outputFileName);
+    if (!outputFile.is_open())
+    {
+      std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream& os = (outputFileName != NULL ? static_cast<std::ostream&>(outputFile) : std::cout);
+
+  // Allocations of the replay itself, with and without the image stream
+  double baselineAllocationsPerFrame = -1.0;
+  double baselineWithImageAllocationsPerFrame = -1.0;
+  if (!RunScenario(SCENARIO_REPLAY_ONLY, options, -1.0, os, baselineAllocationsPerFrame)
+    || !RunScenario(SCENARIO_REPLAY_ONLY_WITH_IMAGE, options, -1.0, os, baselineWithImageAllocationsPerFrame))
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> scenarios;
+  scenarios.push_back("TransformProcessor");
+  scenarios.push_back("VolumeResliceDriver");
+  scenarios.push_back("BreachWarning");
+  scenarios.push_back("CollectPoints");
+  scenarios.push_back("Watchdog");
+  scenarios.push_back(SCENARIO_ALL);
+  for (std::vector<std::string>::iterator scenarioIt = scenarios.begin(); scenarioIt != scenarios.end(); ++scenarioIt)
+  {
+    double allocationsPerFrame = -1.0;
+    if (!RunScenario(*scenarioIt, options, (IsImageScenario(*scenarioIt) ? baselineWithImageAllocationsPerFrame : baselineAllocationsPerFrame),
+      os, allocationsPerFrame))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
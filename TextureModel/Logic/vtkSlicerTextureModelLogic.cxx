@@ -0,0 +1,472 @@
+#include "vtkSlicerTextureModelLogic.h"
+
+// MRML includes
+#include <vtkMRMLModelDisplayNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLVolumeNode.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkImageFlip.h>
+#include <vtkIntArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// Inputs smaller than this are not split between more threads
+#define MINIMUM_NUMBER_OF_POINTS_PER_THREAD 10000
+
+static const char* COLOR_VECTOR_ARRAY_NAME = "Color";
+static const char* COLOR_ARRAY_NAMES[ 3 ] = { "ColorRed", "ColorGreen", "ColorBlue" };
+
+//------------------------------------------------------------------------------
+// Texture and cached pixel mapping of one model
+struct TexturedModel
+{
+  vtkWeakPointer< vtkMRMLVolumeNode > TextureImageNode;
+  // Created once, the display node is connected to its output
+  vtkSmartPointer< vtkImageFlip > TextureImageFlip;
+  bool AddColorAsPointAttribute;
+  bool ColorAsVector;
+
+  // The mapping is valid while these match the current texture coordinates and texture image
+  vtkWeakPointer< vtkDataArray > MappingTextureCoordinates;
+  unsigned long MappingTextureCoordinatesMTime;
+  vtkIdType MappingNumberOfPoints;
+  int MappingDimensions[ 2 ];
+  vtkIdType MappingIncrements[ 2 ];
+
+  // Offsets (in scalar values from the first pixel) and bilinear weights of the 4 pixels around each point
+  std::vector< vtkIdType > PixelOffsets;
+  std::vector< double > PixelWeights;
+
+  // Arrays are reused when the colors are updated. Only ColorArrays[ 0 ] is used if ColorAsVector is enabled.
+  vtkSmartPointer< vtkDoubleArray > ColorArrays[ 3 ];
+
+  TexturedModel()
+    : AddColorAsPointAttribute( false )
+    , ColorAsVector( false )
+    , MappingTextureCoordinatesMTime( 0 )
+    , MappingNumberOfPoints( 0 )
+  {
+    this->MappingDimensions[ 0 ] = 0;
+    this->MappingDimensions[ 1 ] = 0;
+    this->MappingIncrements[ 0 ] = 0;
+    this->MappingIncrements[ 1 ] = 0;
+  }
+};
+
+//------------------------------------------------------------------------------
+class vtkSlicerTextureModelLogic::vtkInternal
+{
+public:
+  std::map< vtkMRMLModelNode*, TexturedModel > TexturedModels;
+};
+
+//------------------------------------------------------------------------------
+// Data shared by the color update threads. Each thread processes a contiguous range of points.
+struct PointColorUpdateJob
+{
+  void* Scalars;
+  int ScalarType;
+  int NumberOfComponents;
+  const vtkIdType* PixelOffsets;
+  const double* PixelWeights;
+  vtkIdType NumberOfPoints;
+  // Output value of color channel c of point i is Colors[ c ][ i * ColorStride ]
+  double* Colors[ 3 ];
+  int ColorStride;
+  double ColorScale;
+};
+
+//------------------------------------------------------------------------------
+template< class T >
+static void UpdatePointColorsRange( PointColorUpdateJob* job, const T* scalars, vtkIdType firstPoint, vtkIdType lastPoint )
+{
+  const int numberOfComponents = job->NumberOfComponents;
+  for ( vtkIdType pointIndex = firstPoint; pointIndex < lastPoint; pointIndex++ )
+  {
+    const vtkIdType* offsets = job->PixelOffsets + 4 * pointIndex;
+    const double* weights = job->PixelWeights + 4 * pointIndex;
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      // single-component images are used as grayscale
+      int component = std::min( channel, numberOfComponents - 1 );
+      double value = weights[ 0 ] * scalars[ offsets[ 0 ] + component ] + weights[ 1 ] * scalars[ offsets[ 1 ] + component ]
+        + weights[ 2 ] * scalars[ offsets[ 2 ] + component ] + weights[ 3 ] * scalars[ offsets[ 3 ] + component ];
+      job->Colors[ channel ][ pointIndex * job->ColorStride ] = value * job->ColorScale;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE UpdatePointColorsThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  PointColorUpdateJob* job = static_cast< PointColorUpdateJob* >( threadInfo->UserData );
+  vtkIdType firstPoint = job->NumberOfPoints * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  vtkIdType lastPoint = job->NumberOfPoints * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  switch ( job->ScalarType )
+  {
+    vtkTemplateMacro( UpdatePointColorsRange( job, static_cast< const VTK_TT* >( job->Scalars ), firstPoint, lastPoint ) );
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+// Compute the pixel offsets and weights of each point, the same way as vtkTextureToPointColors samples the texture
+static void ComputePixelMapping( TexturedModel& texturedModel, vtkDataArray* textureCoordinates, vtkImageData* texture )
+{
+  int* dimensions = texture->GetDimensions();
+  vtkIdType* increments = texture->GetIncrements();
+  const int width = dimensions[ 0 ];
+  const int height = dimensions[ 1 ];
+  vtkIdType numberOfPoints = textureCoordinates->GetNumberOfTuples();
+  texturedModel.PixelOffsets.resize( 4 * numberOfPoints );
+  texturedModel.PixelWeights.resize( 4 * numberOfPoints );
+  double pointTextureCoordinates[ 3 ] = { 0.0, 0.0, 0.0 };
+  for ( vtkIdType pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+  {
+    textureCoordinates->GetTuple( pointIndex, pointTextureCoordinates );
+
+    // Texture coordinate (0,0) is the bottom-left corner of the image, (1,1) is the top-right corner,
+    // while image rows are stored from top to bottom. Pixel centers are at half pixels.
+    double x = std::max( 0.0, std::min( width - 1.0, pointTextureCoordinates[ 0 ] * width - 0.5 ) );
+    double y = std::max( 0.0, std::min( height - 1.0, ( 1.0 - pointTextureCoordinates[ 1 ] ) * height - 0.5 ) );
+    int x0 = static_cast< int >( x );
+    int y0 = static_cast< int >( y );
+    int x1 = std::min( x0 + 1, width - 1 );
+    int y1 = std::min( y0 + 1, height - 1 );
+    double fx = x - x0;
+    double fy = y - y0;
+
+    vtkIdType* offsets = &texturedModel.PixelOffsets[ 4 * pointIndex ];
+    offsets[ 0 ] = y0 * increments[ 1 ] + x0 * increments[ 0 ];
+    offsets[ 1 ] = y0 * increments[ 1 ] + x1 * increments[ 0 ];
+    offsets[ 2 ] = y1 * increments[ 1 ] + x0 * increments[ 0 ];
+    offsets[ 3 ] = y1 * increments[ 1 ] + x1 * increments[ 0 ];
+    double* weights = &texturedModel.PixelWeights[ 4 * pointIndex ];
+    weights[ 0 ] = ( 1.0 - fy ) * ( 1.0 - fx );
+    weights[ 1 ] = ( 1.0 - fy ) * fx;
+    weights[ 2 ] = fy * ( 1.0 - fx );
+    weights[ 3 ] = fy * fx;
+  }
+
+  texturedModel.MappingTextureCoordinates = textureCoordinates;
+  texturedModel.MappingTextureCoordinatesMTime = textureCoordinates->GetMTime();
+  texturedModel.MappingNumberOfPoints = numberOfPoints;
+  texturedModel.MappingDimensions[ 0 ] = width;
+  texturedModel.MappingDimensions[ 1 ] = height;
+  texturedModel.MappingIncrements[ 0 ] = increments[ 0 ];
+  texturedModel.MappingIncrements[ 1 ] = increments[ 1 ];
+}
+
+//------------------------------------------------------------------------------
+static bool IsPixelMappingValid( const TexturedModel& texturedModel, vtkDataArray* textureCoordinates, vtkImageData* texture )
+{
+  int* dimensions = texture->GetDimensions();
+  vtkIdType* increments = texture->GetIncrements();
+  return texturedModel.MappingTextureCoordinates.GetPointer() == textureCoordinates
+    && texturedModel.MappingTextureCoordinatesMTime == textureCoordinates->GetMTime()
+    && texturedModel.MappingNumberOfPoints == textureCoordinates->GetNumberOfTuples()
+    && texturedModel.MappingDimensions[ 0 ] == dimensions[ 0 ] && texturedModel.MappingDimensions[ 1 ] == dimensions[ 1 ]
+    && texturedModel.MappingIncrements[ 0 ] == increments[ 0 ] && texturedModel.MappingIncrements[ 1 ] == increments[ 1 ];
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkSlicerTextureModelLogic );
+
+//------------------------------------------------------------------------------
+vtkSlicerTextureModelLogic::vtkSlicerTextureModelLogic()
+{
+  this->Internal = new vtkInternal;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerTextureModelLogic::~vtkSlicerTextureModelLogic()
+{
+  this->RemoveAllModelTextures();
+  delete this->Internal;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfTexturedModels: " << this->GetNumberOfTexturedModels() << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::SetMRMLSceneInternal( vtkMRMLScene* newScene )
+{
+  vtkNew< vtkIntArray > events;
+  events->InsertNextValue( vtkMRMLScene::NodeRemovedEvent );
+  this->SetAndObserveMRMLSceneEventsInternal( newScene, events.GetPointer() );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
+{
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast( node );
+  if ( modelNode != NULL )
+  {
+    this->RemoveModelTexture( modelNode );
+    return;
+  }
+  vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast( node );
+  if ( volumeNode == NULL )
+  {
+    return;
+  }
+  std::map< vtkMRMLModelNode*, TexturedModel >::iterator texturedModelIt = this->Internal->TexturedModels.begin();
+  while ( texturedModelIt != this->Internal->TexturedModels.end() )
+  {
+    // only the removed item is erased, so the iterator is incremented before removal
+    vtkMRMLModelNode* texturedModelNode = texturedModelIt->first;
+    bool usesRemovedImage = ( texturedModelIt->second.TextureImageNode == volumeNode );
+    ++texturedModelIt;
+    if ( usesRemovedImage )
+    {
+      this->RemoveModelTexture( texturedModelNode );
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerTextureModelLogic::SetModelTexture( vtkMRMLModelNode* modelNode, vtkMRMLVolumeNode* textureImageNode,
+  bool addColorAsPointAttribute /* =false */, bool colorAsVector /* =false */ )
+{
+  if ( modelNode == NULL || textureImageNode == NULL )
+  {
+    vtkErrorMacro( "SetModelTexture: Invalid model or texture image node" );
+    return false;
+  }
+  vtkMRMLModelDisplayNode* modelDisplayNode = vtkMRMLModelDisplayNode::SafeDownCast( modelNode->GetDisplayNode() );
+  if ( modelDisplayNode == NULL )
+  {
+    vtkErrorMacro( "SetModelTexture: Model " << ( modelNode->GetName() ? modelNode->GetName() : "" ) << " does not have a display node" );
+    return false;
+  }
+
+  this->RemoveModelTexture( modelNode );
+
+  // The texture image node is observed once, even if it is used by several models
+  bool textureImageObserved = false;
+  for ( std::map< vtkMRMLModelNode*, TexturedModel >::iterator texturedModelIt = this->Internal->TexturedModels.begin();
+    texturedModelIt != this->Internal->TexturedModels.end(); ++texturedModelIt )
+  {
+    if ( texturedModelIt->second.TextureImageNode == textureImageNode )
+    {
+      textureImageObserved = true;
+      break;
+    }
+  }
+  if ( !textureImageObserved )
+  {
+    vtkNew< vtkIntArray > events;
+    events->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
+    vtkObserveMRMLNodeEventsMacro( textureImageNode, events.GetPointer() );
+  }
+
+  TexturedModel& texturedModel = this->Internal->TexturedModels[ modelNode ];
+  texturedModel.TextureImageNode = textureImageNode;
+  texturedModel.AddColorAsPointAttribute = addColorAsPointAttribute;
+  texturedModel.ColorAsVector = colorAsVector;
+
+  // VTK texture coordinate origin is the bottom-left corner, image rows are stored from the top
+  texturedModel.TextureImageFlip = vtkSmartPointer< vtkImageFlip >::New();
+  texturedModel.TextureImageFlip->SetFilteredAxis( 1 );
+  texturedModel.TextureImageFlip->SetInputConnection( textureImageNode->GetImageDataConnection() );
+  modelDisplayNode->SetBackfaceCulling( 0 );
+  modelDisplayNode->SetTextureImageDataConnection( texturedModel.TextureImageFlip->GetOutputPort() );
+
+  if ( addColorAsPointAttribute )
+  {
+    return this->UpdatePointColors( modelNode );
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::RemoveModelTexture( vtkMRMLModelNode* modelNode )
+{
+  std::map< vtkMRMLModelNode*, TexturedModel >::iterator texturedModelIt = this->Internal->TexturedModels.find( modelNode );
+  if ( texturedModelIt == this->Internal->TexturedModels.end() )
+  {
+    return;
+  }
+  vtkMRMLVolumeNode* textureImageNode = texturedModelIt->second.TextureImageNode;
+  this->Internal->TexturedModels.erase( texturedModelIt );
+  if ( textureImageNode == NULL )
+  {
+    return;
+  }
+  for ( texturedModelIt = this->Internal->TexturedModels.begin(); texturedModelIt != this->Internal->TexturedModels.end(); ++texturedModelIt )
+  {
+    if ( texturedModelIt->second.TextureImageNode == textureImageNode )
+    {
+      // still used by another model
+      return;
+    }
+  }
+  vtkUnObserveMRMLNodeMacro( textureImageNode );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::RemoveAllModelTextures()
+{
+  while ( !this->Internal->TexturedModels.empty() )
+  {
+    this->RemoveModelTexture( this->Internal->TexturedModels.begin()->first );
+  }
+}
+
+//------------------------------------------------------------------------------
+int vtkSlicerTextureModelLogic::GetNumberOfTexturedModels()
+{
+  return static_cast< int >( this->Internal->TexturedModels.size() );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerTextureModelLogic::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  vtkMRMLVolumeNode* textureImageNode = vtkMRMLVolumeNode::SafeDownCast( caller );
+  if ( textureImageNode == NULL || event != vtkMRMLVolumeNode::ImageDataModifiedEvent )
+  {
+    this->Superclass::ProcessMRMLNodesEvents( caller, event, callData );
+    return;
+  }
+  // The texture is updated by the display pipeline, only the point colors have to be computed
+  for ( std::map< vtkMRMLModelNode*, TexturedModel >::iterator texturedModelIt = this->Internal->TexturedModels.begin();
+    texturedModelIt != this->Internal->TexturedModels.end(); ++texturedModelIt )
+  {
+    if ( texturedModelIt->second.TextureImageNode == textureImageNode && texturedModelIt->second.AddColorAsPointAttribute )
+    {
+      this->UpdatePointColors( texturedModelIt->first );
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerTextureModelLogic::UpdatePointColors( vtkMRMLModelNode* modelNode )
+{
+  std::map< vtkMRMLModelNode*, TexturedModel >::iterator texturedModelIt = this->Internal->TexturedModels.find( modelNode );
+  if ( texturedModelIt == this->Internal->TexturedModels.end() )
+  {
+    vtkErrorMacro( "UpdatePointColors: Model does not have a texture" );
+    return false;
+  }
+  TexturedModel& texturedModel = texturedModelIt->second;
+  vtkPolyData* polyData = modelNode->GetPolyData();
+  vtkImageData* texture = ( texturedModel.TextureImageNode != NULL ? texturedModel.TextureImageNode->GetImageData() : NULL );
+  if ( polyData == NULL || texture == NULL )
+  {
+    vtkErrorMacro( "UpdatePointColors: Invalid model or texture image" );
+    return false;
+  }
+  vtkDataArray* textureCoordinates = polyData->GetPointData()->GetTCoords();
+  if ( textureCoordinates == NULL )
+  {
+    vtkErrorMacro( "UpdatePointColors: Surface does not contain texture coordinates" );
+    return false;
+  }
+  vtkIdType numberOfPoints = polyData->GetNumberOfPoints();
+  if ( textureCoordinates->GetNumberOfTuples() != numberOfPoints )
+  {
+    vtkErrorMacro( "UpdatePointColors: Number of texture coordinates does not equal number of points" );
+    return false;
+  }
+  int* dimensions = texture->GetDimensions();
+  if ( texture->GetPointData()->GetScalars() == NULL || dimensions[ 0 ] < 1 || dimensions[ 1 ] < 1 )
+  {
+    vtkErrorMacro( "UpdatePointColors: Texture image is empty" );
+    return false;
+  }
+
+  if ( !IsPixelMappingValid( texturedModel, textureCoordinates, texture ) )
+  {
+    ComputePixelMapping( texturedModel, textureCoordinates, texture );
+  }
+
+  // Color arrays are allocated once and added to the model again only if its polydata has been replaced
+  vtkPointData* pointData = polyData->GetPointData();
+  int numberOfColorArrays = ( texturedModel.ColorAsVector ? 1 : 3 );
+  for ( int arrayIndex = 0; arrayIndex < numberOfColorArrays; arrayIndex++ )
+  {
+    vtkSmartPointer< vtkDoubleArray >& colorArray = texturedModel.ColorArrays[ arrayIndex ];
+    if ( colorArray == NULL )
+    {
+      colorArray = vtkSmartPointer< vtkDoubleArray >::New();
+      colorArray->SetName( texturedModel.ColorAsVector ? COLOR_VECTOR_ARRAY_NAME : COLOR_ARRAY_NAMES[ arrayIndex ] );
+      colorArray->SetNumberOfComponents( texturedModel.ColorAsVector ? 3 : 1 );
+    }
+    if ( colorArray->GetNumberOfTuples() != numberOfPoints )
+    {
+      colorArray->SetNumberOfTuples( numberOfPoints );
+    }
+    if ( pointData->GetArray( colorArray->GetName() ) != colorArray.GetPointer() )
+    {
+      pointData->AddArray( colorArray );
+    }
+  }
+
+  PointColorUpdateJob job;
+  job.Scalars = texture->GetScalarPointer();
+  job.ScalarType = texture->GetScalarType();
+  job.NumberOfComponents = texture->GetNumberOfScalarComponents();
+  job.PixelOffsets = ( numberOfPoints > 0 ? &texturedModel.PixelOffsets[ 0 ] : NULL );
+  job.PixelWeights = ( numberOfPoints > 0 ? &texturedModel.PixelWeights[ 0 ] : NULL );
+  job.NumberOfPoints = numberOfPoints;
+  if ( texturedModel.ColorAsVector )
+  {
+    double* colors = texturedModel.ColorArrays[ 0 ]->GetPointer( 0 );
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      job.Colors[ channel ] = colors + channel;
+    }
+    job.ColorStride = 3;
+    job.ColorScale = 1.0 / 255.0;
+  }
+  else
+  {
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      job.Colors[ channel ] = texturedModel.ColorArrays[ channel ]->GetPointer( 0 );
+    }
+    job.ColorStride = 1;
+    job.ColorScale = 1.0;
+  }
+
+  if ( numberOfPoints > 0 )
+  {
+    vtkIdType maximumNumberOfThreads = ( numberOfPoints + MINIMUM_NUMBER_OF_POINTS_PER_THREAD - 1 ) / MINIMUM_NUMBER_OF_POINTS_PER_THREAD;
+    int numberOfThreads = static_cast< int >( std::max( vtkIdType( 1 ), std::min( vtkIdType( this->NumberOfThreads ), maximumNumberOfThreads ) ) );
+    vtkNew< vtkMultiThreader > threader;
+    threader->SetNumberOfThreads( numberOfThreads );
+    threader->SetSingleMethod( UpdatePointColorsThreadFunction, &job );
+    threader->SingleMethodExecute();
+  }
+
+  for ( int arrayIndex = 0; arrayIndex < numberOfColorArrays; arrayIndex++ )
+  {
+    texturedModel.ColorArrays[ arrayIndex ]->Modified();
+  }
+  // notifies the model node, so that the views are updated
+  polyData->Modified();
+  return true;
+}
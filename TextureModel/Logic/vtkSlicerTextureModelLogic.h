@@ -0,0 +1,66 @@
+#ifndef __vtkSlicerTextureModelLogic_h
+#define __vtkSlicerTextureModelLogic_h
+
+#include <vtkMRMLAbstractLogic.h>
+
+// export
+#include "vtkSlicerTextureModelModuleLogicExport.h"
+
+class vtkMRMLModelNode;
+class vtkMRMLVolumeNode;
+
+// Keeps textured models up to date when their texture image changes (e.g., live video
+// texture on a tracked surface). The texture pipeline of each model is created once and
+// the mapping from the texture coordinates of the points to texture image pixels (pixel
+// offsets and bilinear weights) is cached. When the texture image is modified, only the
+// texture and the point color arrays (if enabled) are updated.
+// The mapping is recomputed only if the texture coordinates or the image geometry change.
+// Point colors are the same as computed by vtkTextureToPointColors.
+class VTK_SLICER_TEXTUREMODEL_MODULE_LOGIC_EXPORT vtkSlicerTextureModelLogic : public vtkMRMLAbstractLogic
+{
+  public:
+    vtkTypeMacro( vtkSlicerTextureModelLogic, vtkMRMLAbstractLogic );
+    static vtkSlicerTextureModelLogic* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Show the texture image on the model and update it when the image is modified.
+    // If addColorAsPointAttribute is enabled then the colors are also stored as point data arrays
+    // of the model (see vtkTextureToPointColors::ColorAsVector for the array names).
+    // Returns false if the inputs are invalid.
+    bool SetModelTexture( vtkMRMLModelNode* modelNode, vtkMRMLVolumeNode* textureImageNode,
+      bool addColorAsPointAttribute = false, bool colorAsVector = false );
+
+    // Stop updating the model. The texture and color arrays are left on the model.
+    void RemoveModelTexture( vtkMRMLModelNode* modelNode );
+    void RemoveAllModelTextures();
+    int GetNumberOfTexturedModels();
+
+    // Update the point color arrays of the model from the current texture image.
+    // Called automatically when the texture image is modified.
+    bool UpdatePointColors( vtkMRMLModelNode* modelNode );
+
+    // Number of threads used for computing the point colors. Default is the number of processors.
+    vtkSetMacro( NumberOfThreads, int );
+    vtkGetMacro( NumberOfThreads, int );
+
+  protected:
+    vtkSlicerTextureModelLogic();
+    ~vtkSlicerTextureModelLogic();
+
+    void SetMRMLSceneInternal( vtkMRMLScene* newScene ) VTK_OVERRIDE;
+    void OnMRMLSceneNodeRemoved( vtkMRMLNode* node ) VTK_OVERRIDE;
+    void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData ) VTK_OVERRIDE;
+
+  private:
+    class vtkInternal;
+    vtkInternal* Internal;
+
+    int NumberOfThreads;
+
+    // Not implemented:
+    vtkSlicerTextureModelLogic( const vtkSlicerTextureModelLogic& );
+    void operator=( const vtkSlicerTextureModelLogic& );
+};
+
+#endif
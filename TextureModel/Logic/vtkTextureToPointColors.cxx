@@ -0,0 +1,224 @@
+#include "vtkTextureToPointColors.h"
+
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Inputs smaller than this are not split between more threads
+#define MINIMUM_NUMBER_OF_POINTS_PER_THREAD 10000
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkTextureToPointColors );
+
+//------------------------------------------------------------------------------
+// Data shared by the sampling threads. Each thread processes a contiguous range of points.
+struct TextureSamplingJob
+{
+  void* Scalars;
+  int ScalarType;
+  int NumberOfComponents;
+  int Dimensions[ 2 ];
+  vtkIdType Increments[ 2 ];
+  vtkDataArray* TextureCoordinates;
+  vtkIdType NumberOfPoints;
+  // Output value of color channel c of point i is Colors[ c ][ i * ColorStride ]
+  double* Colors[ 3 ];
+  int ColorStride;
+  double ColorScale;
+};
+
+//------------------------------------------------------------------------------
+template< class T >
+static void SampleTexture( TextureSamplingJob* job, const T* scalars, vtkIdType firstPoint, vtkIdType lastPoint )
+{
+  const int width = job->Dimensions[ 0 ];
+  const int height = job->Dimensions[ 1 ];
+  const int numberOfComponents = job->NumberOfComponents;
+  double textureCoordinates[ 3 ] = { 0.0, 0.0, 0.0 };
+  for ( vtkIdType pointIndex = firstPoint; pointIndex < lastPoint; pointIndex++ )
+  {
+    job->TextureCoordinates->GetTuple( pointIndex, textureCoordinates );
+
+    // Texture coordinate (0,0) is the bottom-left corner of the image, (1,1) is the top-right corner,
+    // while image rows are stored from top to bottom. Pixel centers are at half pixels.
+    double x = std::max( 0.0, std::min( width - 1.0, textureCoordinates[ 0 ] * width - 0.5 ) );
+    double y = std::max( 0.0, std::min( height - 1.0, ( 1.0 - textureCoordinates[ 1 ] ) * height - 0.5 ) );
+    int x0 = static_cast< int >( x );
+    int y0 = static_cast< int >( y );
+    int x1 = std::min( x0 + 1, width - 1 );
+    int y1 = std::min( y0 + 1, height - 1 );
+    double fx = x - x0;
+    double fy = y - y0;
+
+    const T* pixel00 = scalars + y0 * job->Increments[ 1 ] + x0 * job->Increments[ 0 ];
+    const T* pixel01 = scalars + y0 * job->Increments[ 1 ] + x1 * job->Increments[ 0 ];
+    const T* pixel10 = scalars + y1 * job->Increments[ 1 ] + x0 * job->Increments[ 0 ];
+    const T* pixel11 = scalars + y1 * job->Increments[ 1 ] + x1 * job->Increments[ 0 ];
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      // single-component images are used as grayscale
+      int component = std::min( channel, numberOfComponents - 1 );
+      double value = ( 1.0 - fy ) * ( ( 1.0 - fx ) * pixel00[ component ] + fx * pixel01[ component ] )
+        + fy * ( ( 1.0 - fx ) * pixel10[ component ] + fx * pixel11[ component ] );
+      job->Colors[ channel ][ pointIndex * job->ColorStride ] = value * job->ColorScale;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE SampleTextureThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  TextureSamplingJob* job = static_cast< TextureSamplingJob* >( threadInfo->UserData );
+  vtkIdType firstPoint = job->NumberOfPoints * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  vtkIdType lastPoint = job->NumberOfPoints * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  switch ( job->ScalarType )
+  {
+    vtkTemplateMacro( SampleTexture( job, static_cast< const VTK_TT* >( job->Scalars ), firstPoint, lastPoint ) );
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+vtkTextureToPointColors::vtkTextureToPointColors()
+{
+  this->ColorAsVector = false;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->SetNumberOfInputPorts( 2 );
+}
+
+//------------------------------------------------------------------------------
+vtkTextureToPointColors::~vtkTextureToPointColors()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkTextureToPointColors::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "ColorAsVector: " << this->ColorAsVector << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkTextureToPointColors::SetTextureImageData( vtkImageData* textureImage )
+{
+  this->SetInputData( 1, textureImage );
+}
+
+//------------------------------------------------------------------------------
+void vtkTextureToPointColors::SetTextureImageConnection( vtkAlgorithmOutput* textureImagePort )
+{
+  this->SetInputConnection( 1, textureImagePort );
+}
+
+//------------------------------------------------------------------------------
+int vtkTextureToPointColors::FillInputPortInformation( int port, vtkInformation* info )
+{
+  if ( port == 1 )
+  {
+    info->Set( vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData" );
+    return 1;
+  }
+  return this->Superclass::FillInputPortInformation( port, info );
+}
+
+//------------------------------------------------------------------------------
+int vtkTextureToPointColors::RequestData( vtkInformation* vtkNotUsed( request ), vtkInformationVector** inputVector, vtkInformationVector* outputVector )
+{
+  vtkPolyData* input = vtkPolyData::GetData( inputVector[ 0 ] );
+  vtkImageData* texture = vtkImageData::GetData( inputVector[ 1 ] );
+  vtkPolyData* output = vtkPolyData::GetData( outputVector );
+  if ( input == NULL || texture == NULL || output == NULL )
+  {
+    vtkErrorMacro( "RequestData: Invalid input or output" );
+    return 0;
+  }
+  output->ShallowCopy( input );
+
+  vtkDataArray* textureCoordinates = input->GetPointData()->GetTCoords();
+  if ( textureCoordinates == NULL )
+  {
+    vtkErrorMacro( "RequestData: Surface does not contain texture coordinates" );
+    return 0;
+  }
+  vtkIdType numberOfPoints = input->GetNumberOfPoints();
+  if ( textureCoordinates->GetNumberOfTuples() != numberOfPoints )
+  {
+    vtkErrorMacro( "RequestData: Number of texture coordinates does not equal number of points" );
+    return 0;
+  }
+  int* dimensions = texture->GetDimensions();
+  if ( texture->GetPointData()->GetScalars() == NULL || dimensions[ 0 ] < 1 || dimensions[ 1 ] < 1 )
+  {
+    vtkErrorMacro( "RequestData: Texture image is empty" );
+    return 0;
+  }
+
+  TextureSamplingJob job;
+  job.Scalars = texture->GetScalarPointer();
+  job.ScalarType = texture->GetScalarType();
+  job.NumberOfComponents = texture->GetNumberOfScalarComponents();
+  job.Dimensions[ 0 ] = dimensions[ 0 ];
+  job.Dimensions[ 1 ] = dimensions[ 1 ];
+  vtkIdType* increments = texture->GetIncrements();
+  job.Increments[ 0 ] = increments[ 0 ];
+  job.Increments[ 1 ] = increments[ 1 ];
+  job.TextureCoordinates = textureCoordinates;
+  job.NumberOfPoints = numberOfPoints;
+
+  vtkPointData* outputPointData = output->GetPointData();
+  if ( this->ColorAsVector )
+  {
+    vtkSmartPointer< vtkDoubleArray > colorArray = vtkSmartPointer< vtkDoubleArray >::New();
+    colorArray->SetName( "Color" );
+    colorArray->SetNumberOfComponents( 3 );
+    colorArray->SetNumberOfTuples( numberOfPoints );
+    double* colors = colorArray->GetPointer( 0 );
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      job.Colors[ channel ] = colors + channel;
+    }
+    job.ColorStride = 3;
+    job.ColorScale = 1.0 / 255.0;
+    outputPointData->AddArray( colorArray );
+  }
+  else
+  {
+    const char* arrayNames[ 3 ] = { "ColorRed", "ColorGreen", "ColorBlue" };
+    for ( int channel = 0; channel < 3; channel++ )
+    {
+      vtkSmartPointer< vtkDoubleArray > colorArray = vtkSmartPointer< vtkDoubleArray >::New();
+      colorArray->SetName( arrayNames[ channel ] );
+      colorArray->SetNumberOfTuples( numberOfPoints );
+      job.Colors[ channel ] = colorArray->GetPointer( 0 );
+      outputPointData->AddArray( colorArray );
+    }
+    job.ColorStride = 1;
+    job.ColorScale = 1.0;
+  }
+
+  if ( numberOfPoints == 0 )
+  {
+    return 1;
+  }
+  vtkIdType maximumNumberOfThreads = ( numberOfPoints + MINIMUM_NUMBER_OF_POINTS_PER_THREAD - 1 ) / MINIMUM_NUMBER_OF_POINTS_PER_THREAD;
+  int numberOfThreads = static_cast< int >( std::max( vtkIdType( 1 ), std::min( vtkIdType( this->NumberOfThreads ), maximumNumberOfThreads ) ) );
+
+  vtkSmartPointer< vtkMultiThreader > threader = vtkSmartPointer< vtkMultiThreader >::New();
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( SampleTextureThreadFunction, &job );
+  threader->SingleMethodExecute();
+
+  return 1;
+}
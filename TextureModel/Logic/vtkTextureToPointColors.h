@@ -0,0 +1,55 @@
+#ifndef __vtkTextureToPointColors_h
+#define __vtkTextureToPointColors_h
+
+#include <vtkPolyDataAlgorithm.h>
+
+// export
+#include "vtkSlicerTextureModelModuleLogicExport.h"
+
+class vtkImageData;
+
+// This filter samples a texture image at the texture coordinates of each point of
+// the input surface and stores the colors as point data arrays of the output.
+// Input 0 is the surface (with texture coordinates), input 1 is the texture image
+// (with the same orientation as it was read from file, i.e., not flipped vertically).
+// Colors are interpolated bilinearly. The points are processed on multiple threads.
+// The output contains either a single 3-component "Color" array (values divided by 255)
+// or three separate "ColorRed", "ColorGreen", "ColorBlue" arrays (original values).
+class VTK_SLICER_TEXTUREMODEL_MODULE_LOGIC_EXPORT vtkTextureToPointColors : public vtkPolyDataAlgorithm
+{
+  public:
+    vtkTypeMacro( vtkTextureToPointColors, vtkPolyDataAlgorithm );
+    static vtkTextureToPointColors* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Texture image (input 1)
+    void SetTextureImageData( vtkImageData* textureImage );
+    void SetTextureImageConnection( vtkAlgorithmOutput* textureImagePort );
+
+    // Store colors in a single 3-component array instead of one array for each color channel
+    vtkSetMacro( ColorAsVector, bool );
+    vtkGetMacro( ColorAsVector, bool );
+    vtkBooleanMacro( ColorAsVector, bool );
+
+    // Number of threads used for sampling. Default is the number of processors.
+    vtkSetMacro( NumberOfThreads, int );
+    vtkGetMacro( NumberOfThreads, int );
+
+  protected:
+    vtkTextureToPointColors();
+    ~vtkTextureToPointColors();
+
+    int FillInputPortInformation( int port, vtkInformation* info ) VTK_OVERRIDE;
+    int RequestData( vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector ) VTK_OVERRIDE;
+
+  private:
+    bool ColorAsVector;
+    int NumberOfThreads;
+
+    // Not implemented:
+    vtkTextureToPointColors( const vtkTextureToPointColors& );
+    void operator=( const vtkTextureToPointColors& );
+};
+
+#endif
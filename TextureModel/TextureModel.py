@@ -102,19 +102,21 @@ class TextureModelWidget(ScriptedLoadableModuleWidget):
     # Add vertical spacer
     self.layout.addStretch(1)
 
+    # The logic is kept, so that the textures are updated when the texture images change
+    self.logic = TextureModelLogic()
+
     # Refresh Apply button state
     self.onSelect()
 
   def cleanup(self):
-    pass
+    self.logic.removeAllTextures()
 
   def onSelect(self):
     self.applyButton.enabled = self.inputTextureSelector.currentNode() and self.inputModelSelector.currentNode()
 
   def onApplyButton(self):
     qt.QApplication.setOverrideCursor(qt.Qt.WaitCursor)
-    logic = TextureModelLogic()
-    logic.applyTexture(self.inputModelSelector.currentNode(), self.inputTextureSelector.currentNode(),
+    self.logic.applyTexture(self.inputModelSelector.currentNode(), self.inputTextureSelector.currentNode(),
       self.addColorAsPointAttributeComboBox.currentIndex > 0, self.addColorAsPointAttributeComboBox.currentIndex > 1)
     qt.QApplication.restoreOverrideCursor()
 
@@ -127,13 +129,26 @@ class TextureModelLogic(ScriptedLoadableModuleLogic):
   https://github.com/Slicer/Slicer/blob/master/Base/Python/slicer/ScriptedLoadableModule.py
   """
 
+  def __init__(self, parent = None):
+    ScriptedLoadableModuleLogic.__init__(self, parent)
+    # Keeps the texture pipeline and the texture coordinate to pixel mapping of each textured model,
+    # and updates only the texture and point colors when a texture image is modified (e.g., live video)
+    import vtkSlicerTextureModelModuleLogicPython
+    self.textureModelLogic = vtkSlicerTextureModelModuleLogicPython.vtkSlicerTextureModelLogic()
+    self.textureModelLogic.SetMRMLScene(slicer.mrmlScene)
+
   def applyTexture(self, modelNode, textureImageNode, addColorAsPointAttribute = False, colorAsVector = False):
     """
-    Apply texture to model node
+    Apply texture to model node. The texture (and the point colors, if enabled) are updated
+    when the texture image is modified, as long as this logic object exists.
+    """
+    self.textureModelLogic.SetModelTexture(modelNode, textureImageNode, addColorAsPointAttribute, colorAsVector)
+
+  def removeAllTextures(self):
+    """
+    Stop updating the textured models. The textures are left on the models.
     """
-    self.showTextureOnModel(modelNode, textureImageNode)
-    if addColorAsPointAttribute:
-      self.convertTextureToPointAttribute(modelNode, textureImageNode, colorAsVector)
+    self.textureModelLogic.RemoveAllModelTextures()
 
   # Show texture
   def showTextureOnModel(self, modelNode, textureImageNode):
@@ -146,71 +161,19 @@ class TextureModelLogic(ScriptedLoadableModuleLogic):
 
   # Add texture data to scalars
   def convertTextureToPointAttribute(self, modelNode, textureImageNode, colorAsVector):
+    import vtkSlicerTextureModelModuleLogicPython
     polyData = modelNode.GetPolyData()
-    textureImageFlipVert = vtk.vtkImageFlip()
-    textureImageFlipVert.SetFilteredAxis(1)
-    textureImageFlipVert.SetInputConnection(textureImageNode.GetImageDataConnection())
-    textureImageFlipVert.Update()
-    textureImageData = textureImageFlipVert.GetOutput()
+    textureToPointColors = vtkSlicerTextureModelModuleLogicPython.vtkTextureToPointColors()
+    textureToPointColors.SetInputData(polyData)
+    textureToPointColors.SetTextureImageConnection(textureImageNode.GetImageDataConnection())
+    textureToPointColors.SetColorAsVector(colorAsVector)
+    textureToPointColors.Update()
+
+    # Add the color arrays to the model (the points and cells of the output are shared with the input)
     pointData = polyData.GetPointData()
-    tcoords = pointData.GetTCoords()
-    numOfPoints = pointData.GetNumberOfTuples()
-    assert numOfPoints == tcoords.GetNumberOfTuples(), "Number of texture coordinates does not equal number of points"
-    textureSamplingPointsUv = vtk.vtkPoints()
-    textureSamplingPointsUv.SetNumberOfPoints(numOfPoints)
-    for pointIndex in xrange(numOfPoints):
-      uv = tcoords.GetTuple2(pointIndex)
-      textureSamplingPointsUv.SetPoint(pointIndex, uv[0], uv[1], 0)
-
-    textureSamplingPointDataUv = vtk.vtkPolyData()
-    uvToXyz = vtk.vtkTransform()
-    textureImageDataSpacingSpacing = textureImageData.GetSpacing()
-    textureImageDataSpacingOrigin = textureImageData.GetOrigin()
-    textureImageDataSpacingDimensions = textureImageData.GetDimensions()
-    uvToXyz.Scale(textureImageDataSpacingDimensions[0] / textureImageDataSpacingSpacing[0],
-                  textureImageDataSpacingDimensions[1] / textureImageDataSpacingSpacing[1], 1)
-    uvToXyz.Translate(textureImageDataSpacingOrigin)
-    textureSamplingPointDataUv.SetPoints(textureSamplingPointsUv)
-    transformPolyDataToXyz = vtk.vtkTransformPolyDataFilter()
-    transformPolyDataToXyz.SetInputData(textureSamplingPointDataUv)
-    transformPolyDataToXyz.SetTransform(uvToXyz)
-    probeFilter = vtk.vtkProbeFilter()
-    probeFilter.SetInputConnection(transformPolyDataToXyz.GetOutputPort())
-    probeFilter.SetSourceData(textureImageData)
-    probeFilter.Update()
-    rgbPoints = probeFilter.GetOutput().GetPointData().GetArray('ImageScalars')
-
-    if colorAsVector:
-      colorArray = vtk.vtkDoubleArray()
-      colorArray.SetName('Color')
-      colorArray.SetNumberOfComponents(3)
-      colorArray.SetNumberOfTuples(numOfPoints)
-      for pointIndex in range(numOfPoints):
-        rgb = rgbPoints.GetTuple3(pointIndex)
-        colorArray.SetTuple3(pointIndex, rgb[0]/255., rgb[1]/255., rgb[2]/255.)
-      colorArray.Modified()
-      pointData.AddArray(colorArray)
-    else:
-      colorArrayRed = vtk.vtkDoubleArray()
-      colorArrayRed.SetName('ColorRed')
-      colorArrayRed.SetNumberOfTuples(numOfPoints)
-      colorArrayGreen = vtk.vtkDoubleArray()
-      colorArrayGreen.SetName('ColorGreen')
-      colorArrayGreen.SetNumberOfTuples(numOfPoints)
-      colorArrayBlue = vtk.vtkDoubleArray()
-      colorArrayBlue.SetName('ColorBlue')
-      colorArrayBlue.SetNumberOfTuples(numOfPoints)
-      for pointIndex in range(numOfPoints):
-        rgb = rgbPoints.GetTuple3(pointIndex)
-        colorArrayRed.SetValue(pointIndex, rgb[0])
-        colorArrayGreen.SetValue(pointIndex, rgb[1])
-        colorArrayBlue.SetValue(pointIndex, rgb[2])
-      colorArrayRed.Modified()
-      colorArrayGreen.Modified()
-      colorArrayBlue.Modified()
-      pointData.AddArray(colorArrayRed)
-      pointData.AddArray(colorArrayGreen)
-      pointData.AddArray(colorArrayBlue)
+    arrayNames = ['Color'] if colorAsVector else ['ColorRed', 'ColorGreen', 'ColorBlue']
+    for arrayName in arrayNames:
+      pointData.AddArray(textureToPointColors.GetOutput().GetPointData().GetArray(arrayName))
 
     pointData.Modified()
     polyData.Modified()
@@ -18,14 +18,19 @@ limitations under the License.
 // Watchdog Logic includes
 #include "vtkSlicerWatchdogLogic.h"
 
+// IGTCommon includes
+#include "vtkLatencyInstrumentation.h"
+#include "vtkPerformanceCounters.h"
+#include "vtkTransformStreamRecorder.h"
+
 // MRML includes
 #include "vtkMRMLWatchdogNode.h"
 #include "vtkMRMLWatchdogDisplayNode.h"
+#include "vtkMRMLTransformNode.h"
 
 // VTK includes
 #include <vtkNew.h>
-#include <vtkCollection.h>
-#include <vtkCollectionIterator.h>
+#include <vtkTimerLog.h>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerWatchdogLogic);
@@ -33,6 +38,12 @@ vtkStandardNewMacro(vtkSlicerWatchdogLogic);
 //----------------------------------------------------------------------------
 vtkSlicerWatchdogLogic::vtkSlicerWatchdogLogic()
 {
+  this->PerformanceCounters = vtkSmartPointer<vtkPerformanceCounters>::New();
+  this->PerformanceCounters->SetName("Watchdog");
+  this->ClockFunction = NULL;
+  this->ClockClientData = NULL;
+  this->EventLoopHookFunction = NULL;
+  this->EventLoopHookClientData = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -44,6 +55,71 @@ vtkSlicerWatchdogLogic::~vtkSlicerWatchdogLogic()
 void vtkSlicerWatchdogLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfWatchdogNodes: " << this->WatchdogNodes.size() << std::endl;
+  os << indent << "TimeUntilNextStatusCheckSec: " << this->GetTimeUntilNextStatusCheckSec() << std::endl;
+  os << indent << "CustomClock: " << (this->ClockFunction != NULL ? "yes" : "no") << std::endl;
+  os << indent << "EventLoopHook: " << (this->EventLoopHookFunction != NULL ? "yes" : "no") << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::SetClock(ClockFunctionType clockFunction, void* clientData)
+{
+  this->ClockFunction = clockFunction;
+  this->ClockClientData = clientData;
+  // scheduled times are kept, but the time until they are due changes
+  this->NextStatusCheckTimeModified();
+}
+
+//-----------------------------------------------------------------------------
+double vtkSlicerWatchdogLogic::GetCurrentTimeSec()
+{
+  if (this->ClockFunction != NULL)
+  {
+    return this->ClockFunction(this->ClockClientData);
+  }
+  return vtkTimerLog::GetUniversalTime();
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::SetEventLoopHook(EventLoopHookFunctionType hookFunction, void* clientData)
+{
+  this->EventLoopHookFunction = hookFunction;
+  this->EventLoopHookClientData = clientData;
+  if (this->EventLoopHookFunction != NULL)
+  {
+    this->EventLoopHookFunction(this->GetTimeUntilNextStatusCheckSec(), this->EventLoopHookClientData);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::NextStatusCheckTimeModified()
+{
+  if (this->EventLoopHookFunction != NULL)
+  {
+    this->EventLoopHookFunction(this->GetTimeUntilNextStatusCheckSec(), this->EventLoopHookClientData);
+  }
+  this->InvokeEvent(NextStatusCheckTimeModifiedEvent);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::ProcessStatusChecks()
+{
+  bool watchedNodeBecomeUpToDateSound = false;
+  bool watchedNodeBecomeOutdatedSound = false;
+  this->UpdateAllWatchdogNodes(watchedNodeBecomeUpToDateSound, watchedNodeBecomeOutdatedSound);
+  if (watchedNodeBecomeUpToDateSound)
+  {
+    this->InvokeEvent(WatchedNodeBecomeUpToDateSoundEvent);
+  }
+  if (watchedNodeBecomeOutdatedSound)
+  {
+    this->InvokeEvent(WatchedNodeBecomeOutdatedSoundEvent);
+  }
+  if (this->EventLoopHookFunction != NULL)
+  {
+    // the timer of the event loop is single-shot, so it has to be armed again
+    this->EventLoopHookFunction(this->GetTimeUntilNextStatusCheckSec(), this->EventLoopHookClientData);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -63,6 +139,8 @@ void vtkSlicerWatchdogLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
 {
   vtkNew<vtkIntArray> events;
   events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
   this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
 }
 
@@ -71,25 +149,180 @@ void vtkSlicerWatchdogLogic::UpdateAllWatchdogNodes(bool &watchedNodeBecomeUpToD
 {
   watchedNodeBecomeUpToDateSound = false;
   watchedNodeBecomeOutdatedSound = false;
-  vtkMRMLScene* scene = this->GetMRMLScene();
-  if (scene==NULL)
+  double currentTimeSec = this->GetCurrentTimeSec();
+  while (!this->StatusChecks.empty() && this->StatusChecks.top().first <= currentTimeSec)
   {
-    return;
+    StatusCheckType statusCheck = this->StatusChecks.top();
+    this->StatusChecks.pop();
+    std::map<std::string, WatchdogNodeInfo>::iterator watchdogNodeIt = this->WatchdogNodes.find(statusCheck.second);
+    if (watchdogNodeIt == this->WatchdogNodes.end() || watchdogNodeIt->second.Node == NULL
+      || watchdogNodeIt->second.StatusCheckTimeSec != statusCheck.first)
+    {
+      // watchdog node is removed or its status check is rescheduled
+      continue;
+    }
+    vtkMRMLWatchdogNode* watchdogNode = watchdogNodeIt->second.Node;
+    watchdogNodeIt->second.StatusCheckTimeSec = -1;
+    double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+    watchdogNode->UpdateWatchedNodesStatus(watchedNodeBecomeUpToDateSound, watchedNodeBecomeOutdatedSound, currentTimeSec);
+    this->PerformanceCounters->EndUpdate(updateStartTimeSec);
+    if (vtkLatencyInstrumentation::GetInstance()->GetEnabled())
+    {
+      this->RecordWatchedNodesLatency(watchdogNode);
+    }
+    // observers of the watchdog node may have removed it or requested another check,
+    // so it is scheduled again through the map
+    watchdogNodeIt = this->WatchdogNodes.find(statusCheck.second);
+    if (watchdogNodeIt == this->WatchdogNodes.end() || watchdogNodeIt->second.StatusCheckTimeSec >= 0)
+    {
+      continue;
+    }
+    double nextStatusChangeTimeSec = watchdogNode->GetNextStatusChangeTimeSec(currentTimeSec);
+    if (nextStatusChangeTimeSec >= 0)
+    {
+      this->ScheduleStatusCheck(watchdogNode, nextStatusChangeTimeSec);
+    }
   }
-  vtkSmartPointer<vtkCollection> watchdogNodes = vtkSmartPointer<vtkCollection>::Take(scene->GetNodesByClass("vtkMRMLWatchdogNode"));
-  vtkSmartPointer<vtkCollectionIterator> watchdogNodeIt = vtkSmartPointer<vtkCollectionIterator>::New();
-  watchdogNodeIt->SetCollection( watchdogNodes );
-  for ( watchdogNodeIt->InitTraversal(); ! watchdogNodeIt->IsDoneWithTraversal(); watchdogNodeIt->GoToNextItem() )
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::RecordWatchedNodesLatency(vtkMRMLWatchdogNode* watchdogNode)
+{
+  vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+  for (int watchedNodeIndex = 0; watchedNodeIndex < watchdogNode->GetNumberOfWatchedNodes(); watchedNodeIndex++)
   {
-    vtkMRMLWatchdogNode* watchdogNode = vtkMRMLWatchdogNode::SafeDownCast( watchdogNodeIt->GetCurrentObject() );
-    if (watchdogNode==NULL)
+    vtkMRMLNode* watchedNode = watchdogNode->GetWatchedNode(watchedNodeIndex);
+    double sourceTimeSec = 0;
+    if (watchedNode == NULL || watchedNode->GetID() == NULL || !latencyInstrumentation->GetSourceTimeSec(watchedNode, sourceTimeSec))
     {
       continue;
     }
-    watchdogNode->UpdateWatchedNodesStatus(watchedNodeBecomeUpToDateSound, watchedNodeBecomeOutdatedSound);
+    std::map<std::string, double>::iterator recordedIt = this->LatencyRecordedSourceTimeSec.find(watchedNode->GetID());
+    if (recordedIt != this->LatencyRecordedSourceTimeSec.end() && recordedIt->second == sourceTimeSec)
+    {
+      // this update has been seen by a previous status check already
+      continue;
+    }
+    this->LatencyRecordedSourceTimeSec[watchedNode->GetID()] = sourceTimeSec;
+    latencyInstrumentation->RecordStageLatencySec("Watchdog", vtkTimerLog::GetUniversalTime() - sourceTimeSec);
+  }
+}
+
+//-----------------------------------------------------------------------------
+double vtkSlicerWatchdogLogic::GetNextStatusCheckTimeSec()
+{
+  // Remove outdated entries from the top of the heap
+  while (!this->StatusChecks.empty())
+  {
+    std::map<std::string, WatchdogNodeInfo>::iterator watchdogNodeIt = this->WatchdogNodes.find(this->StatusChecks.top().second);
+    if (watchdogNodeIt != this->WatchdogNodes.end() && watchdogNodeIt->second.Node != NULL
+      && watchdogNodeIt->second.StatusCheckTimeSec == this->StatusChecks.top().first)
+    {
+      return this->StatusChecks.top().first;
+    }
+    this->StatusChecks.pop();
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+double vtkSlicerWatchdogLogic::GetTimeUntilNextStatusCheckSec()
+{
+  double nextStatusCheckTimeSec = this->GetNextStatusCheckTimeSec();
+  if (nextStatusCheckTimeSec < 0)
+  {
+    return -1;
+  }
+  double timeUntilNextStatusCheckSec = nextStatusCheckTimeSec - this->GetCurrentTimeSec();
+  return (timeUntilNextStatusCheckSec > 0 ? timeUntilNextStatusCheckSec : 0);
+}
+
+//-----------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerWatchdogLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerWatchdogLogic::AddWatchedTransformsToRecorder(vtkMRMLWatchdogNode* watchdogNode, vtkTransformStreamRecorder* recorder)
+{
+  if (watchdogNode == NULL || recorder == NULL)
+  {
+    vtkErrorMacro("AddWatchedTransformsToRecorder failed: invalid watchdog node or recorder");
+    return 0;
+  }
+  int numberOfAddedStreams = 0;
+  for (int watchedNodeIndex = 0; watchedNodeIndex < watchdogNode->GetNumberOfWatchedNodes(); watchedNodeIndex++)
+  {
+    vtkMRMLTransformNode* transformNode = vtkMRMLTransformNode::SafeDownCast(watchdogNode->GetWatchedNode(watchedNodeIndex));
+    if (transformNode == NULL)
+    {
+      // only transforms are recorded (images are watched as well)
+      continue;
+    }
+    if (recorder->AddStream(transformNode) >= 0)
+    {
+      numberOfAddedStreams++;
+    }
+  }
+  return numberOfAddedStreams;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::ScheduleStatusCheck(vtkMRMLWatchdogNode* watchdogNode, double statusCheckTimeSec)
+{
+  if (watchdogNode == NULL || watchdogNode->GetID() == NULL)
+  {
+    return;
+  }
+  std::map<std::string, WatchdogNodeInfo>::iterator watchdogNodeIt = this->WatchdogNodes.find(watchdogNode->GetID());
+  if (watchdogNodeIt == this->WatchdogNodes.end())
+  {
+    return;
+  }
+  if (watchdogNodeIt->second.StatusCheckTimeSec >= 0 && watchdogNodeIt->second.StatusCheckTimeSec <= statusCheckTimeSec)
+  {
+    // an earlier check is already scheduled, the status will be rescheduled after that
+    this->PerformanceCounters->UpdateSkipped();
+    return;
+  }
+  double previousNextStatusCheckTimeSec = this->GetNextStatusCheckTimeSec();
+  watchdogNodeIt->second.StatusCheckTimeSec = statusCheckTimeSec;
+  this->StatusChecks.push(StatusCheckType(statusCheckTimeSec, watchdogNodeIt->first));
+  if (previousNextStatusCheckTimeSec < 0 || statusCheckTimeSec < previousNextStatusCheckTimeSec)
+  {
+    this->NextStatusCheckTimeModified();
   }
 }
 
+//---------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+  vtkMRMLWatchdogNode* watchdogNode = vtkMRMLWatchdogNode::SafeDownCast(caller);
+  if (watchdogNode != NULL && (event == vtkMRMLWatchdogNode::StatusCheckRequestedEvent
+    || event == vtkMRMLDisplayableNode::DisplayModifiedEvent))
+  {
+    // display node change may enable periodic refresh of displayed update rates
+    this->PerformanceCounters->EventReceived();
+    this->ScheduleStatusCheck(watchdogNode, this->GetCurrentTimeSec());
+    return;
+  }
+  this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  vtkMRMLWatchdogNode *watchdogNode = vtkMRMLWatchdogNode::SafeDownCast(node);
+  if (!watchdogNode || !watchdogNode->GetID())
+    {
+    return;
+    }
+  vtkUnObserveMRMLNodeMacro(watchdogNode);
+  // entries of the node in the status check heap are skipped when they get to the top
+  this->WatchdogNodes.erase(watchdogNode->GetID());
+}
+
 //---------------------------------------------------------------------------
 void vtkSlicerWatchdogLogic::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
 {
@@ -97,11 +330,48 @@ void vtkSlicerWatchdogLogic::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
     {
     return;
     }
-  vtkMRMLWatchdogNode *watchdogNode = vtkMRMLWatchdogNode::SafeDownCast(node);
-  if (!watchdogNode)
+  if (this->GetMRMLScene() && this->GetMRMLScene()->IsBatchProcessing())
+    {
+    return; // set up in OnMRMLSceneEndBatchProcess
+    }
+  this->InitializeWatchdogNode(vtkMRMLWatchdogNode::SafeDownCast(node));
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::OnMRMLSceneEndBatchProcess()
+{
+  if (!this->GetMRMLScene())
+    {
+    return;
+    }
+  std::vector<vtkMRMLNode*> watchdogNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLWatchdogNode", watchdogNodes);
+  for (std::vector<vtkMRMLNode*>::iterator nodeIt = watchdogNodes.begin(); nodeIt != watchdogNodes.end(); ++nodeIt)
+    {
+    this->InitializeWatchdogNode(vtkMRMLWatchdogNode::SafeDownCast(*nodeIt));
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerWatchdogLogic::InitializeWatchdogNode(vtkMRMLWatchdogNode* watchdogNode)
+{
+  if (!watchdogNode || !watchdogNode->GetID())
     {
     return;
     }
+
+  // Keep track of the watchdog node and check its status as soon as possible
+  WatchdogNodeInfo watchdogNodeInfo;
+  watchdogNodeInfo.Node = watchdogNode;
+  watchdogNodeInfo.StatusCheckTimeSec = -1;
+  this->WatchdogNodes[watchdogNode->GetID()] = watchdogNodeInfo;
+  vtkUnObserveMRMLNodeMacro(watchdogNode); // Remove previous observers.
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLWatchdogNode::StatusCheckRequestedEvent);
+  events->InsertNextValue(vtkMRMLDisplayableNode::DisplayModifiedEvent);
+  vtkObserveMRMLNodeEventsMacro(watchdogNode, events.GetPointer());
+  this->ScheduleStatusCheck(watchdogNode, this->GetCurrentTimeSec());
+
   if (watchdogNode->GetDisplayNode() == NULL)
     {
     // add a display node
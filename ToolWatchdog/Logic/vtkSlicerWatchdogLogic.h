@@ -18,8 +18,12 @@
 // .NAME vtkSlicerWatchdogLogic - slicer watchdog logic class for displayable nodes (tools)
 // .SECTION Description
 // This class manages the logic associated with displayable nodes watchdog. The watched nodes last time stamp is 
-// stored and compared with the current one every timer shot. If the last and current time stamps are different it 
-// has an updated status.
+// stored and compared with the current one when a status check is due. Status checks are scheduled for each
+// watchdog node at the time when any of its watched nodes could become outdated, or immediately when the
+// watchdog node requests it (e.g., an outdated watched node is updated), so idle watchdog nodes are not polled.
+// The logic owns the scheduling of all watchdog nodes, so the status is updated without the Qt module as well
+// (e.g., in console or slicelet applications, or in tests). The application only provides an event loop hook,
+// which arms a single-shot timer that calls ProcessStatusChecks, and optionally a clock.
 
 #ifndef __vtkSlicerWatchdogLogic_h
 #define __vtkSlicerWatchdogLogic_h
@@ -32,9 +36,23 @@
 #include "vtkMRMLNode.h"
 #include "vtkMRMLScene.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
 // For referencing own MRML node
 class vtkMRMLWatchdogNode;
 class vtkMRMLDisplayableNode;
+class vtkPerformanceCounters;
+class vtkTransformStreamRecorder;
 
 #include "vtkSlicerWatchdogModuleLogicExport.h"
 
@@ -47,9 +65,54 @@ public:
   vtkTypeMacro(vtkSlicerWatchdogLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
-  ///Every time the timer is reached this method updates the tools status and the elapsed time
+  enum Events
+  {
+    /// Invoked when a status check is scheduled earlier than the previous next status check time
+    NextStatusCheckTimeModifiedEvent = vtkCommand::UserEvent + 476,
+    /// Invoked by ProcessStatusChecks when a watched node that plays sound becomes up-to-date
+    WatchedNodeBecomeUpToDateSoundEvent,
+    /// Invoked by ProcessStatusChecks when a watched node that plays sound becomes outdated
+    WatchedNodeBecomeOutdatedSoundEvent
+  };
+
+  /// Returns the current time (universal time, in seconds)
+  typedef double (*ClockFunctionType)(void* clientData);
+  /// Called with the time until the next status check is due (in seconds), or -1 if no check is scheduled.
+  /// The event loop should call ProcessStatusChecks when the time is elapsed (replacing any earlier request).
+  typedef void (*EventLoopHookFunctionType)(double timeUntilNextStatusCheckSec, void* clientData);
+
+  /// Set the clock that the scheduler uses. If NULL (default) then vtkTimerLog::GetUniversalTime() is used.
+  /// The clock must return universal time, as watched node updates are time-stamped by the watchdog nodes.
+  void SetClock(ClockFunctionType clockFunction, void* clientData);
+  /// Returns the time of the scheduler clock
+  double GetCurrentTimeSec();
+
+  /// Set the function that the logic calls whenever the next status check time changes.
+  /// It is called immediately with the current schedule.
+  void SetEventLoopHook(EventLoopHookFunctionType hookFunction, void* clientData);
+
+  /// Updates the watchdog nodes that have a status check due, invokes the sound events if needed,
+  /// and reports the next status check time to the event loop hook.
+  /// Applications without event loop hook may call this method periodically.
+  void ProcessStatusChecks();
+
+  /// Updates the status of the watchdog nodes that have a status check due.
+  /// Should be called when the time returned by GetTimeUntilNextStatusCheckSec is elapsed.
   void UpdateAllWatchdogNodes(bool &watchedNodeBecomeUpToDateSound, bool &watchedNodeBecomeOutdatedSound);
 
+  /// Returns the time until the next status check is due (0 if it is already due).
+  /// Returns -1 if no status check is scheduled.
+  double GetTimeUntilNextStatusCheckSec();
+
+  /// Number of received status check requests, status checks computed and coalesced
+  /// with an already scheduled check, and the time spent in the status checks
+  vtkPerformanceCounters* GetPerformanceCounters();
+
+  /// Add the watched transform nodes of the watchdog node to the recorder as streams,
+  /// for recording the tracked tool poses at full rate. Must be called before the recording is started.
+  /// Returns the number of added streams.
+  int AddWatchedTransformsToRecorder(vtkMRMLWatchdogNode* watchdogNode, vtkTransformStreamRecorder* recorder);
+
   /// Create a new watchdog node and associated display node, adding both to
   /// the scene.
   /// On success, return the id, on failure return an empty string.
@@ -71,8 +134,49 @@ protected:
   /// Initialize listening to MRML events
   virtual void SetMRMLSceneInternal(vtkMRMLScene * newScene);
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
+  virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  /// Watchdog nodes added during batch processing (e.g., scene import) are set up here, in a single pass
+  virtual void OnMRMLSceneEndBatchProcess();
+  void InitializeWatchdogNode(vtkMRMLWatchdogNode* watchdogNode);
+  virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData);
+
+  /// Schedule status check of the watchdog node at the specified time (universal time)
+  void ScheduleStatusCheck(vtkMRMLWatchdogNode* watchdogNode, double statusCheckTimeSec);
+
+  /// Returns the time of the next status check, -1 if no status check is scheduled
+  double GetNextStatusCheckTimeSec();
+
+  /// Report the time until the next status check to the event loop hook and observers
+  void NextStatusCheckTimeModified();
 
 private:
+  struct WatchdogNodeInfo
+  {
+    vtkWeakPointer<vtkMRMLWatchdogNode> Node;
+    double StatusCheckTimeSec; // -1 if no status check is scheduled
+  };
+
+  // All watchdog nodes in the scene, by node ID
+  std::map<std::string, WatchdogNodeInfo> WatchdogNodes;
+
+  // Record the latency of the watched node updates that are seen by a status check for the first time
+  void RecordWatchedNodesLatency(vtkMRMLWatchdogNode* watchdogNode);
+  // Source time of the last watched node update that the latency is recorded for, by watched node ID
+  std::map<std::string, double> LatencyRecordedSourceTimeSec;
+
+  // Min-heap of scheduled status checks (time, watchdog node ID). When a status check is rescheduled, the previous
+  // entry is not removed from the heap but skipped, because its time does not match the watchdog node's StatusCheckTimeSec.
+  typedef std::pair<double, std::string> StatusCheckType;
+  std::priority_queue< StatusCheckType, std::vector<StatusCheckType>, std::greater<StatusCheckType> > StatusChecks;
+
+  vtkSmartPointer<vtkPerformanceCounters> PerformanceCounters;
+
+  ClockFunctionType ClockFunction;
+  void* ClockClientData;
+  EventLoopHookFunctionType EventLoopHookFunction;
+  void* EventLoopHookClientData;
+
+
   vtkSlicerWatchdogLogic(const vtkSlicerWatchdogLogic&); // Not implemented
   void operator=(const vtkSlicerWatchdogLogic&); // Not implemented
 };
@@ -46,6 +46,7 @@ vtkMRMLWatchdogDisplayNode::vtkMRMLWatchdogDisplayNode()
 {
   this->Position=POSITION_BOTTOM_LEFT;
   this->FontSize=18;
+  this->ShowUpdateRate=false;
   this->Color[0]=1;
   this->Color[1]=1;
   this->Color[2]=1;
@@ -67,6 +68,7 @@ void vtkMRMLWatchdogDisplayNode::WriteXML(ostream& of, int nIndent)
 
   of << indent << " position=\""<< ConvertPositionToString(this->Position) << "\"";
   of << indent << " fontSize=\""<< this->FontSize << "\"";
+  of << indent << " showUpdateRate=\""<< (this->ShowUpdateRate ? "true" : "false") << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -94,6 +96,11 @@ void vtkMRMLWatchdogDisplayNode::ReadXMLAttributes(const char** atts)
       ss >> this->FontSize;
       continue;
       }
+    else if (!strcmp(attName,"showUpdateRate"))
+      {
+      this->ShowUpdateRate = (strcmp(attValue,"true")==0);
+      continue;
+      }
     }
 
   this->Modified();
@@ -112,6 +119,7 @@ void vtkMRMLWatchdogDisplayNode::Copy(vtkMRMLNode *anode)
 
   this->SetPosition(node->Position);
   this->SetFontSize(node->FontSize);
+  this->SetShowUpdateRate(node->ShowUpdateRate);
 
   this->EndModify(disabledModify);
 }
@@ -122,6 +130,7 @@ void vtkMRMLWatchdogDisplayNode::PrintSelf(ostream& os, vtkIndent indent)
   Superclass::PrintSelf(os,indent);
   os << indent << "Position = "<< ConvertPositionToString(this->Position) << "\n";
   os << indent << "FontSize = "<< this->FontSize << "\n";
+  os << indent << "ShowUpdateRate = "<< (this->ShowUpdateRate ? "true" : "false") << "\n";
 }
 
 //----------------------------------------------------------------------------
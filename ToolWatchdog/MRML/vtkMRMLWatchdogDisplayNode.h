@@ -86,12 +86,20 @@ class VTK_SLICER_WATCHDOG_MODULE_MRML_EXPORT vtkMRMLWatchdogDisplayNode : public
   vtkSetMacro(FontSize, int);
   vtkGetMacro(FontSize, int);
 
+  /// If enabled then the update rate, jitter and maximum update gap of all watched nodes are displayed,
+  /// not just the warning messages of outdated nodes.
+  vtkSetMacro(ShowUpdateRate, bool);
+  vtkGetMacro(ShowUpdateRate, bool);
+  vtkBooleanMacro(ShowUpdateRate, bool);
+
 protected:
 
   int Position;
 
   int FontSize;
 
+  bool ShowUpdateRate;
+
  protected:
   vtkMRMLWatchdogDisplayNode ( );
   ~vtkMRMLWatchdogDisplayNode ( );
@@ -12,11 +12,19 @@
 #include <vtkObjectFactory.h>
 
 // Other includes
+#include <cmath>
+#include <cstdlib>
+#include <map>
 #include <sstream>
 #include <vector>
 
 static const char WATCHED_NODE_REFERENCE_ROLE_NAME[]="watchedNode";
 
+// Displayed update rates are refreshed at this period
+static const double UPDATE_RATE_REFRESH_PERIOD_SEC = 1.0;
+// Displayed update rates are only refreshed if the rate changed by more than this (relative to the displayed rate)
+static const double UPDATE_RATE_REFRESH_RELATIVE_CHANGE = 0.05;
+
 vtkMRMLNodeNewMacro(vtkMRMLWatchdogNode);
 
 //----------------------------------------------------------------------------
@@ -25,35 +33,215 @@ class vtkMRMLWatchdogNode::vtkInternal
 public:
   vtkInternal();
 
+  // Properties of a watched node that are not needed by the periodic status update
+  // (the ones that are needed are stored in the arrays of vtkInternal)
   struct WatchedNodeInfo
   {
     vtkWeakPointer<vtkMRMLNode> watchedNode; // it is only used for determining which item to remove when deleting a watched node
     std::string warningMessage;
-    double lastUpdateTimeSec; // time of the last update in universal time (UTC)
-    double updateTimeToleranceSec; // if no update is received for more than the tolerance value then the tool is reported as invalid
     bool playSound;
-    bool lastStateUpToDate; // true if the state was valid at the last update
+
+    // Update statistics. Updates are received in the main thread (in MRML node events),
+    // so the ring buffer is only accessed from one thread.
+    bool updateReceived; // true if the last update time is the time of an actual update (not just the time when the node is added)
+    double updateIntervalsSec[UPDATE_INTERVAL_HISTORY_SIZE]; // ring buffer of the time between the most recent updates
+    int numberOfUpdateIntervals;
+    int nextUpdateIntervalIndex;
+    double displayedUpdateRateHz; // update rate at the last Modified event, to detect noticeable changes
+
+    // Device timestamp mode
+    double lastDeviceTimestampSec; // device timestamp of the last update, -1 if not available
+    double transportDelaySec; // time between the device timestamp of the last update and its reception
 
     WatchedNodeInfo()
     {
-      lastUpdateTimeSec=vtkTimerLog::GetUniversalTime();
       playSound=false;
-      updateTimeToleranceSec=1.0;
-      lastStateUpToDate = true; // don't show anything by default (to prevent a warning popping up when adding a watched node until its first update)
+      updateReceived = false;
+      numberOfUpdateIntervals = 0;
+      nextUpdateIntervalIndex = 0;
+      displayedUpdateRateHz = 0;
+      lastDeviceTimestampSec = -1;
+      transportDelaySec = 0;
     }
   };
 
+  /// Add a watched node at the end of the list, with default status (up-to-date, last updated now)
+  void AddWatchedNodeEntry(const WatchedNodeInfo& info, double updateTimeToleranceSec);
+  void RemoveWatchedNodeEntry(int watchedNodeIndex);
+  /// Resize the list, new watched nodes have default properties
+  void ResizeWatchedNodes(int numberOfWatchedNodes);
+  int GetNumberOfWatchedNodes() { return static_cast<int>(this->WatchedNodes.size()); }
+  bool IsValidWatchedNodeIndex(int watchedNodeIndex) { return watchedNodeIndex >= 0 && watchedNodeIndex < this->GetNumberOfWatchedNodes(); }
+
+  /// Returns the index of the watched node, -1 if the node is not watched.
+  /// The index map is rebuilt from the node references if it was invalidated.
+  int FindWatchedNodeIndex(vtkMRMLNode* node);
+
+  /// Compute update rate, jitter, and max gap from the most recent update intervals
+  void GetUpdateStatistics(int watchedNodeIndex, double currentTimeSec, double& updateRateHz, double& jitterSec, double& maximumGapSec);
+
+  /// Returns true if update rates are displayed, so they have to be checked periodically
+  bool IsUpdateRateDisplayed();
+
+  /// Returns false if the node has no device timestamp
+  bool GetDeviceTimestampSec(vtkMRMLNode* node, double& timestampSec);
+
+  /// Returns true if the last update of the watched node was received too late after its device timestamp
+  bool IsTransportDelayExceeded(const WatchedNodeInfo& info);
+
   std::vector< WatchedNodeInfo > WatchedNodes;
+
+  // Properties that are accessed for all watched nodes by each status update and GetNextStatusChangeTimeSec
+  // are stored in separate contiguous arrays (indexed by the watched node index), so the periodic sweep
+  // does not have to load the rest of the watched node properties.
+  std::vector< double > LastUpdateTimesSec; // time of the last update in universal time (UTC)
+  std::vector< double > UpdateTimeTolerancesSec; // if no update is received for more than the tolerance value then the tool is reported as invalid
+  std::vector< char > LastStatesUpToDate; // true if the state was valid at the last update
+
+  // Watched node index for each watched node, for finding the watched node of a node event without a linear search.
+  // Invalidated when the node references change, rebuilt when it is needed.
+  std::map< vtkMRMLNode*, int > WatchedNodeIndices;
+  bool WatchedNodeIndicesValid;
+
+  vtkMRMLWatchdogNode* External;
 };
 
 vtkMRMLWatchdogNode::vtkInternal::vtkInternal()
+: WatchedNodeIndicesValid(false)
+, External(NULL)
 {
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::vtkInternal::AddWatchedNodeEntry(const WatchedNodeInfo& info, double updateTimeToleranceSec)
+{
+  this->WatchedNodes.push_back(info);
+  this->LastUpdateTimesSec.push_back(vtkTimerLog::GetUniversalTime());
+  this->UpdateTimeTolerancesSec.push_back(updateTimeToleranceSec);
+  // don't show anything by default (to prevent a warning popping up when adding a watched node until its first update)
+  this->LastStatesUpToDate.push_back(true);
+  this->WatchedNodeIndicesValid = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::vtkInternal::RemoveWatchedNodeEntry(int watchedNodeIndex)
+{
+  this->WatchedNodes.erase(this->WatchedNodes.begin() + watchedNodeIndex);
+  this->LastUpdateTimesSec.erase(this->LastUpdateTimesSec.begin() + watchedNodeIndex);
+  this->UpdateTimeTolerancesSec.erase(this->UpdateTimeTolerancesSec.begin() + watchedNodeIndex);
+  this->LastStatesUpToDate.erase(this->LastStatesUpToDate.begin() + watchedNodeIndex);
+  this->WatchedNodeIndicesValid = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::vtkInternal::ResizeWatchedNodes(int numberOfWatchedNodes)
+{
+  this->WatchedNodes.resize(numberOfWatchedNodes);
+  this->LastUpdateTimesSec.resize(numberOfWatchedNodes, vtkTimerLog::GetUniversalTime());
+  this->UpdateTimeTolerancesSec.resize(numberOfWatchedNodes, 1.0);
+  this->LastStatesUpToDate.resize(numberOfWatchedNodes, true);
+  this->WatchedNodeIndicesValid = false;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLWatchdogNode::vtkInternal::FindWatchedNodeIndex(vtkMRMLNode* node)
+{
+  if (!this->WatchedNodeIndicesValid)
+  {
+    this->WatchedNodeIndices.clear();
+    int numberOfWatchedNodes = this->External->GetNumberOfNodeReferences(WATCHED_NODE_REFERENCE_ROLE_NAME);
+    for (int watchedNodeIndex = 0; watchedNodeIndex < numberOfWatchedNodes; watchedNodeIndex++)
+    {
+      vtkMRMLNode* watchedNode = this->External->GetNthNodeReference(WATCHED_NODE_REFERENCE_ROLE_NAME, watchedNodeIndex);
+      if (watchedNode != NULL)
+      {
+        // if a node is watched multiple times then the first entry is used, as with the linear search
+        this->WatchedNodeIndices.insert(std::make_pair(watchedNode, watchedNodeIndex));
+      }
+    }
+    this->WatchedNodeIndicesValid = true;
+  }
+  std::map< vtkMRMLNode*, int >::iterator indexIt = this->WatchedNodeIndices.find(node);
+  if (indexIt == this->WatchedNodeIndices.end())
+  {
+    return -1;
+  }
+  return indexIt->second;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::vtkInternal::GetUpdateStatistics(int watchedNodeIndex, double currentTimeSec,
+  double& updateRateHz, double& jitterSec, double& maximumGapSec)
+{
+  const WatchedNodeInfo& info = this->WatchedNodes[watchedNodeIndex];
+  updateRateHz = 0;
+  jitterSec = 0;
+  maximumGapSec = (info.updateReceived ? currentTimeSec - this->LastUpdateTimesSec[watchedNodeIndex] : 0);
+  if (info.numberOfUpdateIntervals == 0)
+  {
+    return;
+  }
+  double sumIntervalsSec = 0;
+  double sumSquaredIntervalsSec = 0;
+  for (int i = 0; i < info.numberOfUpdateIntervals; i++)
+  {
+    double intervalSec = info.updateIntervalsSec[i];
+    sumIntervalsSec += intervalSec;
+    sumSquaredIntervalsSec += intervalSec * intervalSec;
+    if (intervalSec > maximumGapSec)
+    {
+      maximumGapSec = intervalSec;
+    }
+  }
+  double meanIntervalSec = sumIntervalsSec / info.numberOfUpdateIntervals;
+  if (meanIntervalSec > 0)
+  {
+    updateRateHz = 1.0 / meanIntervalSec;
+  }
+  double varianceSec2 = sumSquaredIntervalsSec / info.numberOfUpdateIntervals - meanIntervalSec * meanIntervalSec;
+  jitterSec = (varianceSec2 > 0 ? sqrt(varianceSec2) : 0);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLWatchdogNode::vtkInternal::IsUpdateRateDisplayed()
+{
+  vtkMRMLWatchdogDisplayNode* displayNode = vtkMRMLWatchdogDisplayNode::SafeDownCast(this->External->GetDisplayNode());
+  return (displayNode != NULL && displayNode->GetShowUpdateRate());
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLWatchdogNode::vtkInternal::GetDeviceTimestampSec(vtkMRMLNode* node, double& timestampSec)
+{
+  if (this->External->DeviceTimestampAttributeName == NULL)
+  {
+    return false;
+  }
+  const char* timestampString = node->GetAttribute(this->External->DeviceTimestampAttributeName);
+  if (timestampString == NULL || timestampString[0] == 0)
+  {
+    return false;
+  }
+  char* end = NULL;
+  timestampSec = strtod(timestampString, &end);
+  return (end != timestampString);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLWatchdogNode::vtkInternal::IsTransportDelayExceeded(const WatchedNodeInfo& info)
+{
+  return this->External->UseDeviceTimestamp && this->External->MaximumTransportDelaySec > 0
+    && info.lastDeviceTimestampSec >= 0 && info.transportDelaySec > this->External->MaximumTransportDelaySec;
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLWatchdogNode::vtkMRMLWatchdogNode()
 {
   this->Internal = new vtkInternal;
+  this->Internal->External = this;
+  this->UseDeviceTimestamp = false;
+  this->DeviceTimestampAttributeName = NULL;
+  this->SetDeviceTimestampAttributeName("SourceTimestamp");
+  this->MaximumTransportDelaySec = 0.5;
   this->HideFromEditorsOff();
   this->SetSaveWithScene( true );
 
@@ -68,6 +256,7 @@ vtkMRMLWatchdogNode::~vtkMRMLWatchdogNode()
 {
   delete this->Internal;
   this->Internal = NULL;
+  this->SetDeviceTimestampAttributeName(NULL);
 }
 
 //----------------------------------------------------------------------------
@@ -90,12 +279,15 @@ void vtkMRMLWatchdogNode::WriteXML( ostream& of, int nIndent )
     }
     warningMessagesAttribute << it->warningMessage;
     playSoundAttribute << (it->playSound ? "true" : "false");
-    updateTimeToleranceSecAttribute << it->updateTimeToleranceSec;
+    updateTimeToleranceSecAttribute << this->Internal->UpdateTimeTolerancesSec[it - this->Internal->WatchedNodes.begin()];
   }
 
   of << indent << " watchedNodeWarningMessage=\"" << warningMessagesAttribute.str() << "\"";
   of << indent << " watchedNodePlaySound=\"" << playSoundAttribute.str() << "\"";
   of << indent << " watchedNodeUpdateTimeToleranceSec=\"" << updateTimeToleranceSecAttribute.str() << "\"";
+  of << indent << " useDeviceTimestamp=\"" << (this->UseDeviceTimestamp ? "true" : "false") << "\"";
+  of << indent << " deviceTimestampAttributeName=\"" << (this->DeviceTimestampAttributeName ? this->DeviceTimestampAttributeName : "") << "\"";
+  of << indent << " maximumTransportDelaySec=\"" << this->MaximumTransportDelaySec << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -104,7 +296,7 @@ void vtkMRMLWatchdogNode::ReadXMLAttributes( const char** atts )
   Superclass::ReadXMLAttributes(atts); // This will take care of referenced nodes
 
   int numberOfWatchedNodes = this->GetNumberOfNodeReferences(WATCHED_NODE_REFERENCE_ROLE_NAME);
-  this->Internal->WatchedNodes.resize(numberOfWatchedNodes);
+  this->Internal->ResizeWatchedNodes(numberOfWatchedNodes);
 
   // Read all MRML node attributes from two arrays of names and values
   while (*atts != NULL)
@@ -145,10 +337,26 @@ void vtkMRMLWatchdogNode::ReadXMLAttributes( const char** atts )
         ss << attribute;
         double updateTimeToleranceSec=1.0;
         ss >> updateTimeToleranceSec;
-        this->Internal->WatchedNodes[watchedNodeIndex].updateTimeToleranceSec = updateTimeToleranceSec;
+        this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex] = updateTimeToleranceSec;
         watchedNodeIndex++;
       }
     }
+    else if (!strcmp(attName, "useDeviceTimestamp"))
+    {
+      this->UseDeviceTimestamp = (strcmp(attValue, "true") == 0);
+    }
+    else if (!strcmp(attName, "deviceTimestampAttributeName"))
+    {
+      this->SetDeviceTimestampAttributeName(attValue);
+    }
+    else if (!strcmp(attName, "maximumTransportDelaySec"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double maximumTransportDelaySec = 0.5;
+      ss >> maximumTransportDelaySec;
+      this->MaximumTransportDelaySec = maximumTransportDelaySec;
+    }
   }
   this->Modified();
 }
@@ -164,7 +372,15 @@ void vtkMRMLWatchdogNode::Copy( vtkMRMLNode *anode )
   }
   Superclass::Copy( anode ); // This will take care of referenced nodes
   this->Internal->WatchedNodes = srcNode->Internal->WatchedNodes;
+  this->Internal->LastUpdateTimesSec = srcNode->Internal->LastUpdateTimesSec;
+  this->Internal->UpdateTimeTolerancesSec = srcNode->Internal->UpdateTimeTolerancesSec;
+  this->Internal->LastStatesUpToDate = srcNode->Internal->LastStatesUpToDate;
+  this->Internal->WatchedNodeIndicesValid = false;
+  this->UseDeviceTimestamp = srcNode->UseDeviceTimestamp;
+  this->SetDeviceTimestampAttributeName(srcNode->DeviceTimestampAttributeName);
+  this->MaximumTransportDelaySec = srcNode->MaximumTransportDelaySec;
   this->Modified();
+  this->InvokeEvent(StatusCheckRequestedEvent);
 }
 
 //----------------------------------------------------------------------------
@@ -172,6 +388,10 @@ void vtkMRMLWatchdogNode::PrintSelf( ostream& os, vtkIndent indent )
 {
   vtkMRMLNode::PrintSelf(os,indent); // This will take care of referenced nodes
 
+  os << indent << "UseDeviceTimestamp: " << (this->UseDeviceTimestamp?"true":"false") << std::endl;
+  os << indent << "DeviceTimestampAttributeName: " << (this->DeviceTimestampAttributeName?this->DeviceTimestampAttributeName:"(none)") << std::endl;
+  os << indent << "MaximumTransportDelaySec: " << this->MaximumTransportDelaySec << std::endl;
+
   int watchedNodeIndex=0;
   for (std::vector<vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo>::iterator
     it = this->Internal->WatchedNodes.begin(); it != this->Internal->WatchedNodes.end(); ++it)
@@ -181,8 +401,17 @@ void vtkMRMLWatchdogNode::PrintSelf( ostream& os, vtkIndent indent )
     os << indent << " Node ID: " << (nodeId?nodeId:"(undefined)") << std::endl;
     os << indent << " WarningMessage: " << it->warningMessage << std::endl;
     os << indent << " PlaySound: " << (it->playSound?"true":"false") << std::endl;
-    os << indent << " UpdateTimeToleranceSec: " << it->updateTimeToleranceSec << std::endl;
-    os << indent << " LastStateUpToDate: " << it->lastStateUpToDate << std::endl;
+    os << indent << " UpdateTimeToleranceSec: " << this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex] << std::endl;
+    os << indent << " LastStateUpToDate: " << (this->Internal->LastStatesUpToDate[watchedNodeIndex] ? true : false) << std::endl;
+    double updateRateHz = 0;
+    double jitterSec = 0;
+    double maximumGapSec = 0;
+    this->Internal->GetUpdateStatistics(watchedNodeIndex, vtkTimerLog::GetUniversalTime(), updateRateHz, jitterSec, maximumGapSec);
+    os << indent << " UpdateRateHz: " << updateRateHz << std::endl;
+    os << indent << " UpdateJitterSec: " << jitterSec << std::endl;
+    os << indent << " MaximumUpdateGapSec: " << maximumGapSec << std::endl;
+    os << indent << " TransportDelaySec: " << it->transportDelaySec << std::endl;
+    watchedNodeIndex++;
   }
 }
 
@@ -211,19 +440,15 @@ int vtkMRMLWatchdogNode::AddWatchedNode(vtkMRMLNode *watchedNode, const char* wa
     }
   }
 
-  if (updateTimeToleranceSec>0)
-  {
-    newWatchedNodeInfo.updateTimeToleranceSec = updateTimeToleranceSec;
-  }
-
   newWatchedNodeInfo.playSound = playSound;
 
   newWatchedNodeInfo.watchedNode = watchedNode;
 
-  this->Internal->WatchedNodes.push_back(newWatchedNodeInfo);
-  int newNodeIndex = this->Internal->WatchedNodes.size()-1;
+  this->Internal->AddWatchedNodeEntry(newWatchedNodeInfo, updateTimeToleranceSec>0 ? updateTimeToleranceSec : 1.0);
+  int newNodeIndex = this->Internal->GetNumberOfWatchedNodes()-1;
 
   this->SetAndObserveNthNodeReferenceID(WATCHED_NODE_REFERENCE_ROLE_NAME, newNodeIndex, watchedNode->GetID());
+  this->InvokeEvent(StatusCheckRequestedEvent);
 
   return newNodeIndex;
 }
@@ -231,19 +456,19 @@ int vtkMRMLWatchdogNode::AddWatchedNode(vtkMRMLNode *watchedNode, const char* wa
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::RemoveWatchedNode(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::RemoveWatchedNode failed: invalid index "<<watchedNodeIndex);
     return;
   }
-  this->Internal->WatchedNodes.erase(this->Internal->WatchedNodes.begin()+watchedNodeIndex);
+  this->Internal->RemoveWatchedNodeEntry(watchedNodeIndex);
   this->RemoveNthNodeReferenceID(WATCHED_NODE_REFERENCE_ROLE_NAME, watchedNodeIndex);
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::RemoveAllWatchedNodes()
 {
-  this->Internal->WatchedNodes.clear();
+  this->Internal->ResizeWatchedNodes(0);
   this->RemoveNodeReferenceIDs(WATCHED_NODE_REFERENCE_ROLE_NAME);
 }
 
@@ -255,24 +480,14 @@ int vtkMRMLWatchdogNode::GetWatchedNodeIndex(vtkMRMLNode* watchedNode)
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeIndex: invalid input node");
     return -1;
   }
-  unsigned int numberOfWatchedNodes = this->GetNumberOfNodeReferences(WATCHED_NODE_REFERENCE_ROLE_NAME);
-  for (unsigned int watchedNodeIndex=0; watchedNodeIndex<numberOfWatchedNodes; watchedNodeIndex++)
-  {
-    vtkMRMLNode* watchedNodeFound = this->GetNthNodeReference(WATCHED_NODE_REFERENCE_ROLE_NAME, watchedNodeIndex);
-    if (watchedNode == watchedNodeFound)
-    {
-      return watchedNodeIndex;
-    }
-  }
-  // not found
-  return -1;
+  return this->Internal->FindWatchedNodeIndex(watchedNode);
 }
 
 
 //----------------------------------------------------------------------------
 vtkMRMLNode* vtkMRMLWatchdogNode::GetWatchedNode(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNode failed: invalid index "<<watchedNodeIndex);
     return NULL;
@@ -283,13 +498,13 @@ vtkMRMLNode* vtkMRMLWatchdogNode::GetWatchedNode(int watchedNodeIndex)
 //----------------------------------------------------------------------------
 int vtkMRMLWatchdogNode::GetNumberOfWatchedNodes()
 {
-  return this->Internal->WatchedNodes.size();
+  return this->Internal->GetNumberOfWatchedNodes();
 }
 
 //----------------------------------------------------------------------------
 const char* vtkMRMLWatchdogNode::GetWatchedNodeWarningMessage(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeWarningMessage failed: invalid index "<<watchedNodeIndex);
     return NULL;
@@ -300,7 +515,7 @@ const char* vtkMRMLWatchdogNode::GetWatchedNodeWarningMessage(int watchedNodeInd
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::SetWatchedNodeWarningMessage(int watchedNodeIndex, const char* warningMessage)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::WarningMessage failed: invalid index "<<watchedNodeIndex);
     return;
@@ -318,57 +533,138 @@ void vtkMRMLWatchdogNode::SetWatchedNodeWarningMessage(int watchedNodeIndex, con
 //----------------------------------------------------------------------------
 double vtkMRMLWatchdogNode::GetWatchedNodeUpdateTimeToleranceSec(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeUpdateTimeToleranceSec failed: invalid index "<<watchedNodeIndex);
     return 0.0;
   }
-  return this->Internal->WatchedNodes[watchedNodeIndex].updateTimeToleranceSec;
+  return this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex];
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::SetWatchedNodeUpdateTimeToleranceSec(int watchedNodeIndex, double updateTimeToleranceSec)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::SetWatchedNodeUpdateTimeToleranceSec failed: invalid index "<<watchedNodeIndex);
     return;
   }
-  if (fabs(this->Internal->WatchedNodes[watchedNodeIndex].updateTimeToleranceSec - updateTimeToleranceSec)<0.001)
+  if (fabs(this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex] - updateTimeToleranceSec)<0.001)
   {
     // no change
     return;
   }
-  this->Internal->WatchedNodes[watchedNodeIndex].updateTimeToleranceSec = updateTimeToleranceSec;
+  this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex] = updateTimeToleranceSec;
   this->Modified();
+  this->InvokeEvent(StatusCheckRequestedEvent);
 }
 
 //----------------------------------------------------------------------------
 bool vtkMRMLWatchdogNode::GetWatchedNodeUpToDate(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeUpToDate failed: invalid index "<<watchedNodeIndex);
     return true;
   }
-  return this->Internal->WatchedNodes[watchedNodeIndex].lastStateUpToDate;
+  return this->Internal->LastStatesUpToDate[watchedNodeIndex] != 0;
 }
 
 //----------------------------------------------------------------------------
 double vtkMRMLWatchdogNode::GetWatchedNodeElapsedTimeSinceLastUpdateSec(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeElapsedTimeSinceLastUpdateSec failed: invalid index "<<watchedNodeIndex);
     return 0;
   }
-  return this->Internal->WatchedNodes[watchedNodeIndex].lastUpdateTimeSec-vtkTimerLog::GetUniversalTime();
+  return this->Internal->LastUpdateTimesSec[watchedNodeIndex]-vtkTimerLog::GetUniversalTime();
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetWatchedNodeUpdateRateHz(int watchedNodeIndex)
+{
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeUpdateRateHz failed: invalid index "<<watchedNodeIndex);
+    return 0;
+  }
+  double updateRateHz = 0;
+  double jitterSec = 0;
+  double maximumGapSec = 0;
+  this->Internal->GetUpdateStatistics(watchedNodeIndex, vtkTimerLog::GetUniversalTime(),
+    updateRateHz, jitterSec, maximumGapSec);
+  return updateRateHz;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetWatchedNodeUpdateJitterSec(int watchedNodeIndex)
+{
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeUpdateJitterSec failed: invalid index "<<watchedNodeIndex);
+    return 0;
+  }
+  double updateRateHz = 0;
+  double jitterSec = 0;
+  double maximumGapSec = 0;
+  this->Internal->GetUpdateStatistics(watchedNodeIndex, vtkTimerLog::GetUniversalTime(),
+    updateRateHz, jitterSec, maximumGapSec);
+  return jitterSec;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetWatchedNodeMaximumUpdateGapSec(int watchedNodeIndex)
+{
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeMaximumUpdateGapSec failed: invalid index "<<watchedNodeIndex);
+    return 0;
+  }
+  double updateRateHz = 0;
+  double jitterSec = 0;
+  double maximumGapSec = 0;
+  this->Internal->GetUpdateStatistics(watchedNodeIndex, vtkTimerLog::GetUniversalTime(),
+    updateRateHz, jitterSec, maximumGapSec);
+  return maximumGapSec;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetWatchedNodeTransportDelaySec(int watchedNodeIndex)
+{
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodeTransportDelaySec failed: invalid index "<<watchedNodeIndex);
+    return 0;
+  }
+  const vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo& info = this->Internal->WatchedNodes[watchedNodeIndex];
+  if (!this->UseDeviceTimestamp || info.lastDeviceTimestampSec < 0)
+  {
+    return 0;
+  }
+  return info.transportDelaySec;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::ResetWatchedNodeUpdateStatistics(int watchedNodeIndex)
+{
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::ResetWatchedNodeUpdateStatistics failed: invalid index "<<watchedNodeIndex);
+    return;
+  }
+  vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo& info = this->Internal->WatchedNodes[watchedNodeIndex];
+  info.updateReceived = false;
+  info.numberOfUpdateIntervals = 0;
+  info.nextUpdateIntervalIndex = 0;
+  info.displayedUpdateRateHz = 0;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
 bool vtkMRMLWatchdogNode::GetWatchedNodePlaySound(int watchedNodeIndex)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::GetWatchedNodePlaySound failed: invalid index "<<watchedNodeIndex);
     return 0.0;
@@ -379,7 +675,7 @@ bool vtkMRMLWatchdogNode::GetWatchedNodePlaySound(int watchedNodeIndex)
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::SetWatchedNodePlaySound(int watchedNodeIndex, bool playSound)
 {
-  if(watchedNodeIndex<0 || static_cast<unsigned int>(watchedNodeIndex)>=this->Internal->WatchedNodes.size())
+  if(!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
   {
     vtkErrorMacro("vtkMRMLWatchdogNode::SetWatchedNodePlaySound failed: invalid index "<<watchedNodeIndex);
     return;
@@ -393,50 +689,135 @@ void vtkMRMLWatchdogNode::SetWatchedNodePlaySound(int watchedNodeIndex, bool pla
   this->Modified();
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::SetUseDeviceTimestamp(bool useDeviceTimestamp)
+{
+  if (this->UseDeviceTimestamp == useDeviceTimestamp)
+  {
+    // no change
+    return;
+  }
+  this->UseDeviceTimestamp = useDeviceTimestamp;
+  this->Modified();
+  this->InvokeEvent(StatusCheckRequestedEvent);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::SetMaximumTransportDelaySec(double maximumTransportDelaySec)
+{
+  if (this->MaximumTransportDelaySec == maximumTransportDelaySec)
+  {
+    // no change
+    return;
+  }
+  this->MaximumTransportDelaySec = maximumTransportDelaySec;
+  this->Modified();
+  this->InvokeEvent(StatusCheckRequestedEvent);
+}
+
 //---------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::ProcessMRMLEvents ( vtkObject *caller, unsigned long event, void *callData )
 {
   Superclass::ProcessMRMLEvents(caller, event, callData);
 
   vtkMRMLNode* callerNode = vtkMRMLNode::SafeDownCast(caller);
-  if (callerNode!=NULL)
+  if (callerNode==NULL || (event != vtkCommand::ModifiedEvent && event != vtkMRMLTransformableNode::TransformModifiedEvent))
+  {
+    return;
+  }
+  int watchedNodeIndex = this->Internal->FindWatchedNodeIndex(callerNode);
+  if (watchedNodeIndex<0)
+  {
+    // not a watched node (e.g., the display node)
+    return;
+  }
+  if (!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex))
+  {
+    vtkErrorMacro("vtkMRMLWatchdogNode::ProcessMRMLEvents failed: no watched node found for node reference "<<watchedNodeIndex);
+    return;
+  }
+  // we've found the watched node that has been just updated
+  vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo& info = this->Internal->WatchedNodes[watchedNodeIndex];
+  double& lastUpdateTimeSec = this->Internal->LastUpdateTimesSec[watchedNodeIndex];
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  double deviceTimestampSec = -1;
+  if (this->UseDeviceTimestamp && this->Internal->GetDeviceTimestampSec(callerNode, deviceTimestampSec))
   {
-    unsigned int numberOfWatchedNodes = this->GetNumberOfNodeReferences(WATCHED_NODE_REFERENCE_ROLE_NAME);
-    for (unsigned int watchedNodeIndex=0; watchedNodeIndex<numberOfWatchedNodes; watchedNodeIndex++)
+    if (deviceTimestampSec == info.lastDeviceTimestampSec)
     {
-      vtkMRMLNode* watchedNode = this->GetNthNodeReference(WATCHED_NODE_REFERENCE_ROLE_NAME, watchedNodeIndex);
-      if (watchedNode == NULL || watchedNode != callerNode
-        || (event != vtkCommand::ModifiedEvent && event != vtkMRMLTransformableNode::TransformModifiedEvent))
-      {
-        continue;
-      }
-      if(watchedNodeIndex>=this->Internal->WatchedNodes.size())
-      {
-        vtkErrorMacro("vtkMRMLWatchdogNode::ProcessMRMLEvents failed: no watched node found for node reference "<<watchedNodeIndex);
-        break;
-      }
-      // we've found the watched node that has been just updated
-      this->Internal->WatchedNodes[watchedNodeIndex].lastUpdateTimeSec=vtkTimerLog::GetUniversalTime();
-      break;
+      // the node is modified, but its content is not newer than the last update (e.g., stale pose re-sent)
+      return;
+    }
+    info.lastDeviceTimestampSec = deviceTimestampSec;
+    info.transportDelaySec = currentTimeSec - deviceTimestampSec;
+  }
+  else
+  {
+    info.lastDeviceTimestampSec = -1;
+    info.transportDelaySec = 0;
+  }
+  if (info.updateReceived)
+  {
+    info.updateIntervalsSec[info.nextUpdateIntervalIndex] = currentTimeSec - lastUpdateTimeSec;
+    info.nextUpdateIntervalIndex = (info.nextUpdateIntervalIndex + 1) % UPDATE_INTERVAL_HISTORY_SIZE;
+    if (info.numberOfUpdateIntervals < UPDATE_INTERVAL_HISTORY_SIZE)
+    {
+      info.numberOfUpdateIntervals++;
     }
   }
+  info.updateReceived = true;
+  lastUpdateTimeSec = currentTimeSec;
+  if (!this->Internal->LastStatesUpToDate[watchedNodeIndex] || this->Internal->IsTransportDelayExceeded(info))
+  {
+    // the node becomes up-to-date (or outdated because of the transport delay),
+    // there is no deadline for this, so request a status check
+    this->InvokeEvent(StatusCheckRequestedEvent);
+  }
 }
 
 //---------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::UpdateWatchedNodesStatus(bool &watchedNodeBecomeUpToDateSound, bool &watchedNodeBecomeOutdatedSound)
 {
-  bool watchedToolStateModified = false;
-  double currentTimeSec = vtkTimerLog::GetUniversalTime();
-  for (std::vector<vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo>::iterator
-    it = this->Internal->WatchedNodes.begin(); it != this->Internal->WatchedNodes.end(); ++it)
+  this->UpdateWatchedNodesStatus(watchedNodeBecomeUpToDateSound, watchedNodeBecomeOutdatedSound, vtkTimerLog::GetUniversalTime());
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::UpdateWatchedNodesStatus(bool &watchedNodeBecomeUpToDateSound, bool &watchedNodeBecomeOutdatedSound, double currentTimeSec)
+{
+  std::vector<int> modifiedWatchedNodeIndices;
+  bool updateRateDisplayed = this->Internal->IsUpdateRateDisplayed();
+  // transport delays only need to be checked (which needs the rest of the watched node properties) if they are used
+  bool transportDelayChecked = this->UseDeviceTimestamp && this->MaximumTransportDelaySec > 0;
+  int numberOfWatchedNodes = this->Internal->GetNumberOfWatchedNodes();
+  const double* lastUpdateTimesSec = numberOfWatchedNodes > 0 ? &this->Internal->LastUpdateTimesSec[0] : NULL;
+  const double* updateTimeTolerancesSec = numberOfWatchedNodes > 0 ? &this->Internal->UpdateTimeTolerancesSec[0] : NULL;
+  char* lastStatesUpToDate = numberOfWatchedNodes > 0 ? &this->Internal->LastStatesUpToDate[0] : NULL;
+  for (int watchedNodeIndex = 0; watchedNodeIndex < numberOfWatchedNodes; watchedNodeIndex++)
   {
-    double elapsedTimeSec = currentTimeSec - it->lastUpdateTimeSec;
-    bool upToDate = ( elapsedTimeSec <= it->updateTimeToleranceSec);
-    if (upToDate != it->lastStateUpToDate)
+    bool watchedToolStateModified = false;
+    if (updateRateDisplayed)
+    {
+      vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo& info = this->Internal->WatchedNodes[watchedNodeIndex];
+      double updateRateHz = 0;
+      double jitterSec = 0;
+      double maximumGapSec = 0;
+      this->Internal->GetUpdateStatistics(watchedNodeIndex, currentTimeSec, updateRateHz, jitterSec, maximumGapSec);
+      if (fabs(updateRateHz - info.displayedUpdateRateHz) > UPDATE_RATE_REFRESH_RELATIVE_CHANGE * info.displayedUpdateRateHz
+        || (updateRateHz == 0) != (info.displayedUpdateRateHz == 0))
+      {
+        info.displayedUpdateRateHz = updateRateHz;
+        watchedToolStateModified = true;
+      }
+    }
+
+    double elapsedTimeSec = currentTimeSec - lastUpdateTimesSec[watchedNodeIndex];
+    bool upToDate = ( elapsedTimeSec <= updateTimeTolerancesSec[watchedNodeIndex])
+      && !(transportDelayChecked && this->Internal->IsTransportDelayExceeded(this->Internal->WatchedNodes[watchedNodeIndex]));
+    if (upToDate != (lastStatesUpToDate[watchedNodeIndex] != 0))
     {
-      it->lastStateUpToDate = upToDate;
+      lastStatesUpToDate[watchedNodeIndex] = upToDate;
       watchedToolStateModified = true;
-      if (it->playSound)
+      if (this->Internal->WatchedNodes[watchedNodeIndex].playSound)
       {
         if (upToDate)
         {
@@ -448,11 +829,51 @@ void vtkMRMLWatchdogNode::UpdateWatchedNodesStatus(bool &watchedNodeBecomeUpToDa
         }
       }
     }
+    if (watchedToolStateModified)
+    {
+      modifiedWatchedNodeIndices.push_back(watchedNodeIndex);
+    }
+  }
+  // Events are invoked after all the statuses are updated, as observers may access any of the watched nodes
+  for (std::vector<int>::iterator indexIt = modifiedWatchedNodeIndices.begin(); indexIt != modifiedWatchedNodeIndices.end(); ++indexIt)
+  {
+    int watchedNodeIndex = *indexIt;
+    this->InvokeEvent(WatchedNodeStatusModifiedEvent, &watchedNodeIndex);
+  }
+}
+
+//---------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetNextStatusChangeTimeSec()
+{
+  return this->GetNextStatusChangeTimeSec(vtkTimerLog::GetUniversalTime());
+}
+
+//---------------------------------------------------------------------------
+double vtkMRMLWatchdogNode::GetNextStatusChangeTimeSec(double currentTimeSec)
+{
+  double nextStatusChangeTimeSec = -1;
+  int numberOfWatchedNodes = this->Internal->GetNumberOfWatchedNodes();
+  for (int watchedNodeIndex = 0; watchedNodeIndex < numberOfWatchedNodes; watchedNodeIndex++)
+  {
+    if (!this->Internal->LastStatesUpToDate[watchedNodeIndex])
+    {
+      continue;
+    }
+    double outdatedTimeSec = this->Internal->LastUpdateTimesSec[watchedNodeIndex] + this->Internal->UpdateTimeTolerancesSec[watchedNodeIndex];
+    if (nextStatusChangeTimeSec < 0 || outdatedTimeSec < nextStatusChangeTimeSec)
+    {
+      nextStatusChangeTimeSec = outdatedTimeSec;
+    }
   }
-  if (watchedToolStateModified)
+  if (!this->Internal->WatchedNodes.empty() && this->Internal->IsUpdateRateDisplayed())
   {
-    this->Modified();
+    double refreshTimeSec = currentTimeSec + UPDATE_RATE_REFRESH_PERIOD_SEC;
+    if (nextStatusChangeTimeSec < 0 || refreshTimeSec < nextStatusChangeTimeSec)
+    {
+      nextStatusChangeTimeSec = refreshTimeSec;
+    }
   }
+  return nextStatusChangeTimeSec;
 }
 
 //----------------------------------------------------------------------------
@@ -461,19 +882,50 @@ void vtkMRMLWatchdogNode::OnNodeReferenceRemoved(vtkMRMLNodeReference *reference
   if (std::string(reference->GetReferenceRole()) == WATCHED_NODE_REFERENCE_ROLE_NAME)
   {
     // A watched node is deleted from the scene. Remove the corresponding item from the list.
-    std::vector<vtkMRMLWatchdogNode::vtkInternal::WatchedNodeInfo>::iterator it = this->Internal->WatchedNodes.begin();
-    for (; it != this->Internal->WatchedNodes.end(); ++it)
+    // If the index map was built before the reference was removed then it still has the node.
+    int watchedNodeIndex = this->Internal->WatchedNodeIndicesValid ? this->Internal->FindWatchedNodeIndex(reference->GetReferencedNode()) : -1;
+    if (!this->Internal->IsValidWatchedNodeIndex(watchedNodeIndex)
+      || this->Internal->WatchedNodes[watchedNodeIndex].watchedNode != reference->GetReferencedNode())
     {
-      if (it->watchedNode == reference->GetReferencedNode())
+      watchedNodeIndex = -1;
+      for (int i = 0; i < this->Internal->GetNumberOfWatchedNodes(); i++)
       {
-        this->Internal->WatchedNodes.erase(it);
-        break;
+        if (this->Internal->WatchedNodes[i].watchedNode == reference->GetReferencedNode())
+        {
+          watchedNodeIndex = i;
+          break;
+        }
       }
     }
+    if (watchedNodeIndex >= 0)
+    {
+      this->Internal->RemoveWatchedNodeEntry(watchedNodeIndex);
+    }
+    this->Internal->WatchedNodeIndicesValid = false;
   }
   this->Superclass::OnNodeReferenceRemoved(reference);
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::OnNodeReferenceAdded(vtkMRMLNodeReference *reference)
+{
+  if (std::string(reference->GetReferenceRole()) == WATCHED_NODE_REFERENCE_ROLE_NAME)
+  {
+    this->Internal->WatchedNodeIndicesValid = false;
+  }
+  this->Superclass::OnNodeReferenceAdded(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWatchdogNode::OnNodeReferenceModified(vtkMRMLNodeReference *reference)
+{
+  if (std::string(reference->GetReferenceRole()) == WATCHED_NODE_REFERENCE_ROLE_NAME)
+  {
+    this->Internal->WatchedNodeIndicesValid = false;
+  }
+  this->Superclass::OnNodeReferenceModified(reference);
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLWatchdogNode::CreateDefaultDisplayNodes()
 {
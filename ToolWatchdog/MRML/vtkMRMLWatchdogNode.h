@@ -32,6 +32,20 @@
 class VTK_SLICER_WATCHDOG_MODULE_MRML_EXPORT vtkMRMLWatchdogNode : public vtkMRMLDisplayableNode
 {
 public:
+
+  enum Events
+  {
+    /// Invoked when the status of a watched node may change before the time returned by GetNextStatusChangeTimeSec(),
+    /// for example when an outdated watched node is updated or a new node is watched.
+    /// UpdateWatchedNodesStatus should be called soon after this event.
+    // vtkCommand::UserEvent + 475 is just a random value that is very unlikely to be used for anything else in this class
+    StatusCheckRequestedEvent = vtkCommand::UserEvent + 475,
+    /// Invoked by UpdateWatchedNodesStatus for each watched node whose up-to-date status (or displayed update rate) changed.
+    /// The watched node index is passed as call data (int*). The node itself is not modified, so observers can
+    /// update only the affected entry.
+    WatchedNodeStatusModifiedEvent
+  };
+
   static vtkMRMLWatchdogNode* New();
   vtkTypeMacro(vtkMRMLWatchdogNode, vtkMRMLDisplayableNode);
   void PrintSelf(ostream& os, vtkIndent indent);
@@ -81,11 +95,50 @@ public:
   /// Get time elapsed since the last update of the selected watched node
   double GetWatchedNodeElapsedTimeSinceLastUpdateSec(int watchedNodeIndex);
 
+  /// Get the update rate of the watched node, computed from the most recent updates (at most
+  /// UPDATE_INTERVAL_HISTORY_SIZE). Returns 0 if the node has not been updated at least twice.
+  double GetWatchedNodeUpdateRateHz(int watchedNodeIndex);
+
+  /// Get the standard deviation of the time between updates of the watched node (for the most recent updates)
+  double GetWatchedNodeUpdateJitterSec(int watchedNodeIndex);
+
+  /// Get the longest time between updates of the watched node (for the most recent updates),
+  /// including the time elapsed since the last update
+  double GetWatchedNodeMaximumUpdateGapSec(int watchedNodeIndex);
+
+  /// Get the delay between the device timestamp of the last update of the watched node and its reception.
+  /// Returns 0 if device timestamps are not used or the node has no device timestamp.
+  double GetWatchedNodeTransportDelaySec(int watchedNodeIndex);
+
+  /// Clear the update rate statistics of the watched node
+  void ResetWatchedNodeUpdateStatistics(int watchedNodeIndex);
+
+  /// Number of most recent updates that the update rate statistics are computed from
+  static const int UPDATE_INTERVAL_HISTORY_SIZE = 64;
+
   /// Get true if sound should be played when the watched node becomes outdated
   bool GetWatchedNodePlaySound(int watchedNodeIndex);
   /// Enable/disable playing a warning sound when the watched node becomes outdated
   void SetWatchedNodePlaySound(int watchedNodeIndex, bool playSound);
 
+  /// If enabled then updates of the watched nodes are identified by the device timestamp that the nodes carry
+  /// (stored in the node attribute DeviceTimestampAttributeName, e.g., by OpenIGTLink), instead of their Modified events.
+  /// A modification that has the same device timestamp as the previous update (stale data re-sent) is not an update,
+  /// so frozen streams become outdated. Nodes without device timestamp are handled as if the mode was disabled.
+  /// Device timestamps must be universal time, from a clock synchronized with this computer. Disabled by default.
+  vtkGetMacro(UseDeviceTimestamp, bool);
+  void SetUseDeviceTimestamp(bool useDeviceTimestamp);
+  vtkBooleanMacro(UseDeviceTimestamp, bool);
+
+  /// Name of the node attribute that contains the device timestamp (in seconds). Default is "SourceTimestamp".
+  vtkGetStringMacro(DeviceTimestampAttributeName);
+  vtkSetStringMacro(DeviceTimestampAttributeName);
+
+  /// If device timestamps are used then a watched node is outdated if its last update was received later than
+  /// this time after its device timestamp (excessive transport delay). Not checked if the value is not positive. Default is 0.5.
+  vtkGetMacro(MaximumTransportDelaySec, double);
+  void SetMaximumTransportDelaySec(double maximumTransportDelaySec);
+
   /// Add a node to be watched. Returns the watched node's index.
   int AddWatchedNode(vtkMRMLNode *watchedNode, const char* warningMessage=NULL, double updateTimeToleranceSec=-1, bool playSound=false);
 
@@ -107,9 +160,18 @@ public:
   virtual void ProcessMRMLEvents ( vtkObject * caller, unsigned long event, void * callData );
 
   /// Updates the up-to-date status of all watched nodes.
-  /// If any of the statuses change then a Modified event is invoked.
+  /// If a status changes then WatchedNodeStatusModifiedEvent is invoked for that watched node.
+  /// If the display node shows update rates then the event is invoked also when an update rate changes noticeably.
   /// A watched node's status is valid if the last update of the node happened not longer time than the update time tolerance.
   void UpdateWatchedNodesStatus(bool &watchedNodeBecomeUpToDateSound, bool &watchedNodeBecomeOutdatedSound);
+  /// Updates the status at the specified time (universal time), e.g., the time of the scheduler clock of the logic
+  void UpdateWatchedNodesStatus(bool &watchedNodeBecomeUpToDateSound, bool &watchedNodeBecomeOutdatedSound, double currentTimeSec);
+
+  /// Returns the earliest time (in universal time, as vtkTimerLog::GetUniversalTime) when an up-to-date watched node
+  /// becomes outdated if it is not updated. Returns -1 if there are no up-to-date watched nodes.
+  /// Outdated watched nodes become up-to-date only when they are updated, which is reported by StatusCheckRequestedEvent.
+  double GetNextStatusChangeTimeSec();
+  double GetNextStatusChangeTimeSec(double currentTimeSec);
 
 protected:
 
@@ -117,12 +179,21 @@ protected:
   /// Called after a node reference ID is removed (list size decreased).
   virtual void OnNodeReferenceRemoved(vtkMRMLNodeReference *reference);
 
+  ///
+  /// Called after a node reference ID is added or modified, the watched node index map is invalidated.
+  virtual void OnNodeReferenceAdded(vtkMRMLNodeReference *reference);
+  virtual void OnNodeReferenceModified(vtkMRMLNodeReference *reference);
+
   // Constructor/destructor methods
   vtkMRMLWatchdogNode();
   virtual ~vtkMRMLWatchdogNode();
   vtkMRMLWatchdogNode ( const vtkMRMLWatchdogNode& );
   void operator=( const vtkMRMLWatchdogNode& );
 
+  bool UseDeviceTimestamp;
+  char* DeviceTimestampAttributeName;
+  double MaximumTransportDelaySec;
+
 private:
   class vtkInternal;
   vtkInternal* Internal;
@@ -49,6 +49,11 @@ Ontario Ministry of Health and Long-Term Care.
 #include <vtkTextProperty.h>
 #include <vtkTriangleFilter.h>
 
+// STD includes
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
 const double TEXT_MARGIN_PERCENT=20; // margin around text, percentage of font size
 
 //---------------------------------------------------------------------------
@@ -64,12 +69,16 @@ public:
 
   struct Pipeline
   {
-    vtkSmartPointer<vtkTextActor> TextActor;
+    // One text actor for each watched node, so that a status change only updates one row
+    std::vector< vtkSmartPointer<vtkTextActor> > RowTextActors;
+    // Size of each row, computed when the text of the row changes
+    std::vector<double> RowWidths;
+    std::vector<double> RowHeights;
     vtkSmartPointer<vtkActor2D> BackgroundActor;
     vtkSmartPointer<vtkPoints> BackgroundCornerPoints;
   };
 
-  typedef std::map < vtkMRMLWatchdogDisplayNode*, const Pipeline* > PipelinesCacheType;
+  typedef std::map < vtkMRMLWatchdogDisplayNode*, Pipeline* > PipelinesCacheType;
   PipelinesCacheType DisplayPipelines;
 
   typedef std::map < vtkMRMLWatchdogNode*, std::set< vtkMRMLWatchdogDisplayNode* > > WatchdogToDisplayCacheType;
@@ -79,11 +88,17 @@ public:
   void AddWatchdogNode(vtkMRMLWatchdogNode* displayableNode);
   void RemoveWatchdogNode(vtkMRMLWatchdogNode* displayableNode);
   void UpdateDisplayableWatchdogs(vtkMRMLWatchdogNode *node);
+  void UpdateDisplayableWatchdogRow(vtkMRMLWatchdogNode *node, int watchedNodeIndex);
 
   // Display Nodes
   void AddDisplayNode(vtkMRMLWatchdogNode*, vtkMRMLWatchdogDisplayNode*);
   void UpdateDisplayNode(vtkMRMLWatchdogDisplayNode* displayNode);
-  void UpdateDisplayNodePipeline(vtkMRMLWatchdogDisplayNode*, const Pipeline*);
+  void UpdateDisplayNodePipeline(vtkMRMLWatchdogDisplayNode*, Pipeline*);
+  /// Update text of a single row. Returns true if the size or visibility of the row changed.
+  bool UpdateRow(vtkMRMLWatchdogDisplayNode* displayNode, vtkMRMLWatchdogNode* watchdogNode, Pipeline* pipeline, int watchedNodeIndex);
+  /// Stack visible rows and fit background around them
+  void UpdateRowsLayout(vtkMRMLWatchdogDisplayNode* displayNode, Pipeline* pipeline);
+  void SetNumberOfRows(Pipeline* pipeline, int numberOfRows);
   void RemoveDisplayNode(vtkMRMLWatchdogDisplayNode* displayNode);
 
   // Observations
@@ -209,6 +224,35 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayableWatchdogs(
   }
 }
 
+//---------------------------------------------------------------------------
+void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayableWatchdogRow(vtkMRMLWatchdogNode* mNode, int watchedNodeIndex)
+{
+  // Update only the changed row in the pipeline of all tracked DisplayableNode
+  PipelinesCacheType::iterator pipelinesIter;
+  std::set< vtkMRMLWatchdogDisplayNode* > displayNodes = this->WatchdogToDisplayNodes[mNode];
+  std::set< vtkMRMLWatchdogDisplayNode* >::iterator dnodesIter;
+  for ( dnodesIter = displayNodes.begin(); dnodesIter != displayNodes.end(); dnodesIter++ )
+  {
+    if ( ((pipelinesIter = this->DisplayPipelines.find(*dnodesIter)) == this->DisplayPipelines.end()) )
+    {
+      continue;
+    }
+    Pipeline* pipeline = pipelinesIter->second;
+    if ( !this->UseDisplayNode(pipelinesIter->first)
+      || static_cast<int>(pipeline->RowTextActors.size()) != mNode->GetNumberOfWatchedNodes()
+      || watchedNodeIndex < 0 || watchedNodeIndex >= static_cast<int>(pipeline->RowTextActors.size()) )
+    {
+      // rows are not up-to-date, rebuild all
+      this->UpdateDisplayNodePipeline(pipelinesIter->first, pipeline);
+      continue;
+    }
+    if (this->UpdateRow(pipelinesIter->first, mNode, pipeline, watchedNodeIndex))
+    {
+      this->UpdateRowsLayout(pipelinesIter->first, pipeline);
+    }
+  }
+}
+
 //---------------------------------------------------------------------------
 void vtkMRMLWatchdogDisplayableManager::vtkInternal::RemoveDisplayNode(vtkMRMLWatchdogDisplayNode* displayNode)
 {
@@ -217,8 +261,8 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::RemoveDisplayNode(vtkMRMLWa
   {
     return;
   }
-  const Pipeline* pipeline = actorsIt->second;
-  this->External->GetRenderer()->RemoveActor(pipeline->TextActor);
+  Pipeline* pipeline = actorsIt->second;
+  this->SetNumberOfRows(pipeline, 0);
   this->External->GetRenderer()->RemoveActor(pipeline->BackgroundActor);
   delete pipeline;
   this->DisplayPipelines.erase(actorsIt);
@@ -246,12 +290,6 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::AddDisplayNode(vtkMRMLWatch
   // Create pipeline
   Pipeline* pipeline = new Pipeline();
 
-  pipeline->TextActor = vtkSmartPointer<vtkTextActor>::New();
-  pipeline->TextActor->GetTextProperty()->SetColor(1, 1, 1);
-  pipeline->TextActor->GetTextProperty()->SetBold(1);
-  pipeline->TextActor->GetTextProperty()->SetShadow(1);
-  pipeline->TextActor->SetVisibility(false);
-
   pipeline->BackgroundActor = vtkSmartPointer<vtkActor2D>::New();
   vtkNew<vtkPolyDataMapper2D> mapper;
   pipeline->BackgroundActor->SetMapper(mapper.GetPointer());
@@ -283,8 +321,8 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::AddDisplayNode(vtkMRMLWatch
   mapper->SetInputConnection(triangleFilter->GetOutputPort());
 
   // Add actor to Renderer and local cache
+  // Row text actors are added when the pipeline is updated
   this->External->GetRenderer()->AddActor( pipeline->BackgroundActor );
-  this->External->GetRenderer()->AddActor( pipeline->TextActor );
 
   this->DisplayPipelines.insert( std::make_pair(displayNode, pipeline) );
 
@@ -314,59 +352,110 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayNode(vtkMRMLWa
 }
 
 //---------------------------------------------------------------------------
-void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayNodePipeline(vtkMRMLWatchdogDisplayNode* displayNode, const Pipeline* pipeline)
+void vtkMRMLWatchdogDisplayableManager::vtkInternal::SetNumberOfRows(Pipeline* pipeline, int numberOfRows)
 {
-  // Sets visibility, set pipeline polydata input, update color
-  //   calculate and set pipeline watchdogs.
-
-  if (!displayNode || !pipeline)
+  while (static_cast<int>(pipeline->RowTextActors.size()) > numberOfRows)
   {
-    return;
+    this->External->GetRenderer()->RemoveActor(pipeline->RowTextActors.back());
+    pipeline->RowTextActors.pop_back();
+  }
+  while (static_cast<int>(pipeline->RowTextActors.size()) < numberOfRows)
+  {
+    vtkSmartPointer<vtkTextActor> textActor = vtkSmartPointer<vtkTextActor>::New();
+    textActor->GetTextProperty()->SetColor(1, 1, 1);
+    textActor->GetTextProperty()->SetBold(1);
+    textActor->GetTextProperty()->SetShadow(1);
+    textActor->SetVisibility(false);
+    this->External->GetRenderer()->AddActor(textActor);
+    pipeline->RowTextActors.push_back(textActor);
   }
+  pipeline->RowWidths.resize(numberOfRows, 0.0);
+  pipeline->RowHeights.resize(numberOfRows, 0.0);
+}
+
+//---------------------------------------------------------------------------
+bool vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateRow(vtkMRMLWatchdogDisplayNode* displayNode,
+  vtkMRMLWatchdogNode* watchdogNode, Pipeline* pipeline, int watchedNodeIndex)
+{
+  vtkTextActor* textActor = pipeline->RowTextActors[watchedNodeIndex];
 
-  if ( !this->UseDisplayNode(displayNode) )
+  std::string displayedText;
+  if (!watchdogNode->GetWatchedNodeUpToDate(watchedNodeIndex))
   {
-    pipeline->TextActor->SetVisibility(false);
-    pipeline->BackgroundActor->SetVisibility(false);
-    return;
+    // Node outdated, show warning text
+    const char* warningMessage = watchdogNode->GetWatchedNodeWarningMessage(watchedNodeIndex);
+    displayedText = (warningMessage ? warningMessage : "");
+  }
+  else if (displayNode->GetShowUpdateRate())
+  {
+    // Node up-to-date, show update rate statistics
+    vtkMRMLNode* watchedNode = watchdogNode->GetWatchedNode(watchedNodeIndex);
+    std::ostringstream updateRateText;
+    updateRateText << std::fixed << std::setprecision(1)
+      << ((watchedNode && watchedNode->GetName()) ? watchedNode->GetName() : "(unknown)") << ": "
+      << watchdogNode->GetWatchedNodeUpdateRateHz(watchedNodeIndex) << " Hz, jitter "
+      << watchdogNode->GetWatchedNodeUpdateJitterSec(watchedNodeIndex) * 1000.0 << " ms, max gap "
+      << std::setprecision(0) << watchdogNode->GetWatchedNodeMaximumUpdateGapSec(watchedNodeIndex) * 1000.0 << " ms";
+    displayedText = updateRateText.str();
   }
 
-  vtkMRMLWatchdogNode* watchdogNode=vtkMRMLWatchdogNode::SafeDownCast(displayNode->GetDisplayableNode());
-  if (watchdogNode==NULL)
+  bool visible = !displayedText.empty() && this->IsVisible(displayNode);
+  bool wasVisible = (textActor->GetVisibility() != 0);
+  if (!visible)
   {
-    pipeline->TextActor->SetVisibility(false);
-    pipeline->BackgroundActor->SetVisibility(false);
-    return;
+    textActor->SetVisibility(false);
+    return wasVisible;
+  }
+  const char* previousText = textActor->GetInput();
+  if (wasVisible && previousText != NULL && displayedText == previousText)
+  {
+    // no change
+    return false;
   }
 
-  std::string displayedText;
-  int numberOfWatchedNodes = watchdogNode->GetNumberOfWatchedNodes();
-  for (int watchedNodeIndex = 0; watchedNodeIndex < numberOfWatchedNodes; watchedNodeIndex++ )
+  textActor->SetInput(displayedText.c_str());
+  textActor->SetVisibility(true);
+  double boundingBox[4]={0};
+  textActor->GetBoundingBox(this->External->GetRenderer(), boundingBox);
+  double width = boundingBox[1]-boundingBox[0];
+  double height = boundingBox[3]-boundingBox[2];
+  bool sizeChanged = !wasVisible || width != pipeline->RowWidths[watchedNodeIndex] || height != pipeline->RowHeights[watchedNodeIndex];
+  pipeline->RowWidths[watchedNodeIndex] = width;
+  pipeline->RowHeights[watchedNodeIndex] = height;
+  return sizeChanged;
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateRowsLayout(vtkMRMLWatchdogDisplayNode* displayNode, Pipeline* pipeline)
+{
+  // Rows are stacked upwards from the bottom-left corner, the first watched node is on top
+  int margin = TEXT_MARGIN_PERCENT/100.0*displayNode->GetFontSize();
+  double rowPositionY = margin;
+  double maximumRowWidth = 0;
+  bool anyRowVisible = false;
+  for (int rowIndex = static_cast<int>(pipeline->RowTextActors.size())-1; rowIndex >= 0; rowIndex--)
   {
-    if (!watchdogNode->GetWatchedNodeUpToDate(watchedNodeIndex))
+    vtkTextActor* textActor = pipeline->RowTextActors[rowIndex];
+    if (!textActor->GetVisibility())
+    {
+      continue;
+    }
+    textActor->SetPosition(margin, rowPositionY);
+    rowPositionY += pipeline->RowHeights[rowIndex];
+    if (pipeline->RowWidths[rowIndex] > maximumRowWidth)
     {
-      // Node outdated, add warning text
-      if (!displayedText.empty())
-      {
-        displayedText += "\n";
-      }
-      displayedText += watchdogNode->GetWatchedNodeWarningMessage(watchedNodeIndex);
+      maximumRowWidth = pipeline->RowWidths[rowIndex];
     }
+    anyRowVisible = true;
   }
-  if (displayedText.empty())
+
+  if (!anyRowVisible)
   {
-    pipeline->TextActor->SetVisibility(false);
     pipeline->BackgroundActor->SetVisibility(false);
     return;
   }
 
-  pipeline->TextActor->SetInput(displayedText.c_str());
-  pipeline->TextActor->GetTextProperty()->SetFontSize(displayNode->GetFontSize());
-  int margin = TEXT_MARGIN_PERCENT/100.0*displayNode->GetFontSize();
-  pipeline->TextActor->SetPosition(margin, margin);
-
-  double boundingBox[4]={0};
-  pipeline->TextActor->GetBoundingBox(this->External->GetRenderer(), boundingBox);
+  double boundingBox[4] = { static_cast<double>(margin), margin + maximumRowWidth, static_cast<double>(margin), rowPositionY };
   boundingBox[0]-=margin;
   boundingBox[1]+=margin*2;
   boundingBox[2]-=margin;
@@ -375,32 +464,55 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayNodePipeline(v
   pipeline->BackgroundCornerPoints->SetPoint(1,boundingBox[1],boundingBox[2],0);
   pipeline->BackgroundCornerPoints->SetPoint(2,boundingBox[1],boundingBox[3],0);
   pipeline->BackgroundCornerPoints->SetPoint(3,boundingBox[0],boundingBox[3],0);
+  pipeline->BackgroundCornerPoints->Modified();
+  pipeline->BackgroundActor->SetVisibility(true);
+}
 
-  // Update visibility
-  bool visible = this->IsVisible(displayNode);
-  pipeline->TextActor->SetVisibility(visible);
-  pipeline->BackgroundActor->SetVisibility(visible);
-  if (!visible)
+//---------------------------------------------------------------------------
+void vtkMRMLWatchdogDisplayableManager::vtkInternal::UpdateDisplayNodePipeline(vtkMRMLWatchdogDisplayNode* displayNode, Pipeline* pipeline)
+{
+  // Rebuilds all rows: sets visibility, text, and properties.
+  // A change of a single watched node's status is handled by UpdateDisplayableWatchdogRow instead.
+
+  if (!displayNode || !pipeline)
   {
     return;
   }
 
-  // Update properties
+  vtkMRMLWatchdogNode* watchdogNode=vtkMRMLWatchdogNode::SafeDownCast(displayNode->GetDisplayableNode());
+  if ( !this->UseDisplayNode(displayNode) || watchdogNode==NULL )
+  {
+    this->SetNumberOfRows(pipeline, 0);
+    pipeline->BackgroundActor->SetVisibility(false);
+    return;
+  }
 
+  int numberOfWatchedNodes = watchdogNode->GetNumberOfWatchedNodes();
+  this->SetNumberOfRows(pipeline, numberOfWatchedNodes);
+
+  // Update properties
+  for (int watchedNodeIndex = 0; watchedNodeIndex < numberOfWatchedNodes; watchedNodeIndex++ )
+  {
+    vtkTextProperty* textProperty = pipeline->RowTextActors[watchedNodeIndex]->GetTextProperty();
+    textProperty->SetFontSize(displayNode->GetFontSize());
+    if (displayNode->GetSelected())
+    {
+      textProperty->SetColor(displayNode->GetSelectedColor());
+    }
+    else
+    {
+      textProperty->SetColor(displayNode->GetColor());
+    }
+    // force recomputing the row size, as the font may have changed
+    pipeline->RowTextActors[watchedNodeIndex]->SetVisibility(false);
+    this->UpdateRow(displayNode, watchdogNode, pipeline, watchedNodeIndex);
+  }
   pipeline->BackgroundActor->GetProperty()->SetPointSize(displayNode->GetPointSize());
   pipeline->BackgroundActor->GetProperty()->SetLineWidth(displayNode->GetLineWidth());
   pipeline->BackgroundActor->GetProperty()->SetColor(displayNode->GetEdgeColor());
   pipeline->BackgroundActor->GetProperty()->SetOpacity(displayNode->GetOpacity());
-  if (displayNode->GetSelected())
-  {
-    pipeline->TextActor->GetTextProperty()->SetColor(displayNode->GetSelectedColor());
-  }
-  else
-  {
-    pipeline->TextActor->GetTextProperty()->SetColor(displayNode->GetColor());
-  }
-
 
+  this->UpdateRowsLayout(displayNode, pipeline);
 }
 
 //---------------------------------------------------------------------------
@@ -415,6 +527,10 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::AddObservations(vtkMRMLWatc
   {
     broker->AddObservation(node, vtkMRMLDisplayableNode::DisplayModifiedEvent, this->External, this->External->GetMRMLNodesCallbackCommand() );
   }
+  if (!broker->GetObservationExist(node, vtkMRMLWatchdogNode::WatchedNodeStatusModifiedEvent, this->External, this->External->GetMRMLNodesCallbackCommand() ))
+  {
+    broker->AddObservation(node, vtkMRMLWatchdogNode::WatchedNodeStatusModifiedEvent, this->External, this->External->GetMRMLNodesCallbackCommand() );
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -426,6 +542,8 @@ void vtkMRMLWatchdogDisplayableManager::vtkInternal::RemoveObservations(vtkMRMLW
   broker->RemoveObservations(observations);
   observations = broker->GetObservations(node, vtkMRMLDisplayableNode::DisplayModifiedEvent, this->External, this->External->GetMRMLNodesCallbackCommand() );
   broker->RemoveObservations(observations);
+  observations = broker->GetObservations(node, vtkMRMLWatchdogNode::WatchedNodeStatusModifiedEvent, this->External, this->External->GetMRMLNodesCallbackCommand() );
+  broker->RemoveObservations(observations);
 }
 
 //---------------------------------------------------------------------------
@@ -558,6 +676,12 @@ void vtkMRMLWatchdogDisplayableManager::ProcessMRMLNodesEvents(vtkObject* caller
       this->Internal->UpdateDisplayableWatchdogs(displayableNode);
       this->RequestRender();
     }
+    else if (event == vtkMRMLWatchdogNode::WatchedNodeStatusModifiedEvent && callData != NULL)
+    {
+      int watchedNodeIndex = *reinterpret_cast<int*>(callData);
+      this->Internal->UpdateDisplayableWatchdogRow(displayableNode, watchedNodeIndex);
+      this->RequestRender();
+    }
   }
   else
   {
@@ -39,7 +39,8 @@
 
 #include "vtkMRMLWatchdogNode.h"
 
-static const double UPDATE_WATCHDOG_NODES_PERIOD_SEC = 0.2;
+// STD includes
+#include <cmath>
 
 // DisplayableManager initialization
 #if Slicer_VERSION_MAJOR == 4 && Slicer_VERSION_MINOR >= 9
@@ -53,6 +54,14 @@ VTK_MODULE_INIT(vtkSlicerWatchdogModuleMRMLDisplayableManager)
 Q_EXPORT_PLUGIN2(qSlicerWatchdogModule, qSlicerWatchdogModule);
 #endif
 
+//-----------------------------------------------------------------------------
+// Event loop hook of the watchdog logic: the status checks are scheduled by the logic, the module only runs the timer
+static void WatchdogLogicEventLoopHook(double timeUntilNextStatusCheckSec, void* clientData)
+{
+  qSlicerWatchdogModule* module = static_cast<qSlicerWatchdogModule*>(clientData);
+  module->scheduleNextWatchdogNodesUpdate(timeUntilNextStatusCheckSec);
+}
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ToolWatchdog
 class qSlicerWatchdogModulePrivate
@@ -61,6 +70,7 @@ public:
   qSlicerWatchdogModulePrivate();
   ~qSlicerWatchdogModulePrivate();
   
+  vtkSlicerWatchdogLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
   QTimer UpdateAllWatchdogNodesTimer;
   QPointer<QSound> WatchedNodeBecomeUpToDateSound;
   QPointer<QSound> WatchedNodeBecomeOutdatedSound;
@@ -71,6 +81,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerWatchdogModulePrivate::qSlicerWatchdogModulePrivate()
+: ObservedLogic(NULL)
 {
 }
 
@@ -88,20 +99,23 @@ qSlicerWatchdogModule::qSlicerWatchdogModule(QObject* _parent)
   , d_ptr(new qSlicerWatchdogModulePrivate)
 {
   Q_D(qSlicerWatchdogModule);
+  // The timer is started through the event loop hook of the logic when a watchdog node status check is scheduled
+  d->UpdateAllWatchdogNodesTimer.setSingleShot(true);
   connect(&d->UpdateAllWatchdogNodesTimer, SIGNAL(timeout()), this, SLOT(updateAllWatchdogNodes()));
-  vtkMRMLScene * scene = qSlicerCoreApplication::application()->mrmlScene();
-  if (scene)
-    {
-    // Need to listen for any new watchdog nodes being added to start/stop timer
-    this->qvtkConnect(scene, vtkMRMLScene::NodeAddedEvent, this, SLOT(onNodeAddedEvent(vtkObject*,vtkObject*)));
-    this->qvtkConnect(scene, vtkMRMLScene::NodeRemovedEvent, this, SLOT(onNodeRemovedEvent(vtkObject*,vtkObject*)));
-    }
 }
 
 //-----------------------------------------------------------------------------
 qSlicerWatchdogModule::~qSlicerWatchdogModule()
 {
   Q_D(qSlicerWatchdogModule);
+  disconnect(&d->UpdateAllWatchdogNodesTimer, SIGNAL(timeout()), this, SLOT(updateAllWatchdogNodes()));
+  if (d->ObservedLogic)
+  {
+    d->ObservedLogic->SetEventLoopHook(NULL, NULL);
+  }
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkSlicerWatchdogLogic::WatchedNodeBecomeUpToDateSoundEvent, this, SLOT(playUpToDateSound()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkSlicerWatchdogLogic::WatchedNodeBecomeOutdatedSoundEvent, this, SLOT(playOutdatedSound()));
+  d->ObservedLogic = NULL;
   if (!d->WatchedNodeBecomeUpToDateSound.isNull())
   {
     d->WatchedNodeBecomeUpToDateSound->stop();
@@ -164,8 +178,12 @@ void qSlicerWatchdogModule::setup()
   connect(qSlicerApplication::application(), SIGNAL(lastWindowClosed()), this, SLOT(stopSound()));  
 
   vtkSlicerWatchdogLogic* watchdogLogic = vtkSlicerWatchdogLogic::SafeDownCast(this->logic());
+  this->qvtkReconnect(d->ObservedLogic, watchdogLogic, vtkSlicerWatchdogLogic::WatchedNodeBecomeUpToDateSoundEvent, this, SLOT(playUpToDateSound()));
+  this->qvtkReconnect(d->ObservedLogic, watchdogLogic, vtkSlicerWatchdogLogic::WatchedNodeBecomeOutdatedSoundEvent, this, SLOT(playOutdatedSound()));
+  d->ObservedLogic = watchdogLogic;
   if (watchdogLogic)
   {
+    watchdogLogic->SetEventLoopHook(WatchdogLogicEventLoopHook, this);
     if (d->WatchedNodeBecomeUpToDateSound == NULL)
     {
       d->WatchedNodeBecomeUpToDateSound = new QSound( QDir::toNativeSeparators( QString::fromStdString( watchdogLogic->GetModuleShareDirectory()+"/WatchedNodeUpToDate.wav" ) ) );
@@ -222,68 +240,46 @@ vtkMRMLAbstractLogic* qSlicerWatchdogModule::createLogic()
 }
 
 // --------------------------------------------------------------------------
-void qSlicerWatchdogModule::onNodeAddedEvent(vtkObject*, vtkObject* node)
+void qSlicerWatchdogModule::scheduleNextWatchdogNodesUpdate(double timeUntilNextStatusCheckSec)
 {
   Q_D(qSlicerWatchdogModule);
-
-  vtkMRMLWatchdogNode* watchdogNode = vtkMRMLWatchdogNode::SafeDownCast(node);
-  if (watchdogNode)
+  if (timeUntilNextStatusCheckSec < 0)
     {
-    // If the timer is not active
-    if (!d->UpdateAllWatchdogNodesTimer.isActive())
-      {
-      d->UpdateAllWatchdogNodesTimer.start(UPDATE_WATCHDOG_NODES_PERIOD_SEC*1000.0);
-      }
+    // no watched node can change status until a watchdog node requests a status check
+    d->UpdateAllWatchdogNodesTimer.stop();
+    return;
     }
+  // +1 msec so that the status check is not done a moment before the watched node becomes outdated
+  d->UpdateAllWatchdogNodesTimer.start(static_cast<int>(ceil(timeUntilNextStatusCheckSec*1000.0)) + 1);
 }
 
-// --------------------------------------------------------------------------
-void qSlicerWatchdogModule::onNodeRemovedEvent(vtkObject*, vtkObject* node)
+//-----------------------------------------------------------------------------
+void qSlicerWatchdogModule::updateAllWatchdogNodes()
 {
   Q_D(qSlicerWatchdogModule);
-
-  vtkMRMLWatchdogNode* watchdogNode = vtkMRMLWatchdogNode::SafeDownCast(node);
-  if (watchdogNode)
+  if (d->ObservedLogic == NULL)
     {
-    // If the timer is active
-    if (d->UpdateAllWatchdogNodesTimer.isActive())
-      {
-      // Check if there is any other sequence browser node left in the Scene
-      vtkMRMLScene * scene = qSlicerCoreApplication::application()->mrmlScene();
-      if (scene)
-        {
-        std::vector<vtkMRMLNode *> nodes;
-        this->mrmlScene()->GetNodesByClass("vtkMRMLWatchdogNode", nodes);
-        if (nodes.size() == 0)
-          {
-          // The last sequence browser was removed
-          d->UpdateAllWatchdogNodesTimer.stop();
-          }
-        }
-      }
+    return;
     }
+  // the logic plays sounds through events and schedules the next update through the event loop hook
+  d->ObservedLogic->ProcessStatusChecks();
 }
 
 //-----------------------------------------------------------------------------
-void qSlicerWatchdogModule::updateAllWatchdogNodes()
+void qSlicerWatchdogModule::playUpToDateSound()
 {
   Q_D(qSlicerWatchdogModule);
-  vtkSlicerWatchdogLogic* watchdogLogic = vtkSlicerWatchdogLogic::SafeDownCast(this->Superclass::logic());
-  if (!watchdogLogic)
-    {
-    return;
-    }
-
-  bool watchedNodeBecomeUpToDateSound=false;
-  bool watchedNodeBecomeOutdatedSound=false;
-  watchdogLogic->UpdateAllWatchdogNodes(watchedNodeBecomeUpToDateSound, watchedNodeBecomeOutdatedSound);
-
-  // Play connected/disconnected sounds
-  if (watchedNodeBecomeUpToDateSound && !d->WatchedNodeBecomeUpToDateSound.isNull())
+  if (!d->WatchedNodeBecomeUpToDateSound.isNull())
   {
     d->WatchedNodeBecomeUpToDateSound->play();
   }
-  if (watchedNodeBecomeOutdatedSound && !d->WatchedNodeBecomeOutdatedSound.isNull())
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerWatchdogModule::playOutdatedSound()
+{
+  Q_D(qSlicerWatchdogModule);
+  if (!d->WatchedNodeBecomeOutdatedSound.isNull())
   {
     d->WatchedNodeBecomeOutdatedSound->play();
   }
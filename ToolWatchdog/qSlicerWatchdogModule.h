@@ -69,9 +69,12 @@ protected:
 
 public slots:
   virtual void setMRMLScene(vtkMRMLScene*);
-  void onNodeAddedEvent(vtkObject*, vtkObject*);
-  void onNodeRemovedEvent(vtkObject*, vtkObject*);
+  /// Start the update timer so that it fires when the next watchdog node status check is due.
+  /// Called by the logic (through its event loop hook) when the next status check time changes.
+  void scheduleNextWatchdogNodesUpdate(double timeUntilNextStatusCheckSec);
   void updateAllWatchdogNodes();
+  void playUpToDateSound();
+  void playOutdatedSound();
   void stopSound();
 
 protected:
@@ -139,6 +139,7 @@ void qSlicerWatchdogModuleWidget::setup()
 
   QObject::connect(d->VisibilityCheckBox, SIGNAL(toggled(bool)), this, SLOT(setVisibility(bool)));
   QObject::connect(d->FontSizeSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setFontSize(int)));
+  QObject::connect(d->ShowUpdateRateCheckBox, SIGNAL(toggled(bool)), this, SLOT(setShowUpdateRate(bool)));
   QObject::connect(d->OpacitySliderWidget, SIGNAL(valueChanged(double)), this, SLOT(setOpacity(double)));
   QObject::connect(d->BackgroundColorPickerButton, SIGNAL(colorChanged(QColor)), this, SLOT(setBackgroundColor(QColor)));
   QObject::connect(d->TextColorPickerButton, SIGNAL(colorChanged(QColor)), this, SLOT(setTextColor(QColor)));
@@ -228,6 +229,7 @@ void qSlicerWatchdogModuleWidget::onWatchdogNodeSelectionChanged()
   Q_D( qSlicerWatchdogModuleWidget );
   vtkMRMLWatchdogNode* selectedWatchdogNode = vtkMRMLWatchdogNode::SafeDownCast( d->ModuleNodeComboBox->currentNode() );
   qvtkReconnect(d->WatchdogNode, selectedWatchdogNode, vtkCommand::ModifiedEvent, this, SLOT(onWatchdogNodeModified()));
+  qvtkReconnect(d->WatchdogNode, selectedWatchdogNode, vtkMRMLWatchdogNode::WatchedNodeStatusModifiedEvent, this, SLOT(onWatchedNodeStatusModified(vtkObject*, void*)));
   d->WatchdogNode = selectedWatchdogNode;
   this->updateFromMRMLNode();
 }
@@ -359,6 +361,7 @@ void qSlicerWatchdogModuleWidget::updateWidget()
     displayNode->GetEdgeColor(color);
     d->BackgroundColorPickerButton->setColor(QColor(color[0]*255, color[1]*255, color[2]*255));
     d->FontSizeSpinBox->setValue(displayNode->GetFontSize());
+    d->ShowUpdateRateCheckBox->setChecked(displayNode->GetShowUpdateRate());
   }
 
   vtkMRMLDisplayableNode* currentToolNode = vtkMRMLDisplayableNode::SafeDownCast( d->ToolComboBox->currentNode() );
@@ -451,20 +454,7 @@ void qSlicerWatchdogModuleWidget::updateWidget()
       pCheckBox->setAccessibleName(QString::number(watchedNodeIndex));
     }
 
-    QLabel* statusIcon = d->ToolsTableWidget->cellWidget( watchedNodeIndex, TOOL_STATUS_COLUMN)->findChild<QLabel*>("StatusIcon");
-    if (statusIcon)
-    {
-      if(d->WatchdogNode->GetWatchedNodeUpToDate(watchedNodeIndex))
-      {
-        statusIcon->setPixmap(QPixmap(":/Icons/NodeValid.png"));
-        statusIcon->setToolTip("valid");
-      }
-      else
-      {
-        statusIcon->setPixmap(QPixmap(":/Icons/NodeInvalid.png"));
-        statusIcon->setToolTip("invalid");
-      }
-    }
+    this->updateWatchedNodeStatusIcon(watchedNodeIndex);
   }
   d->ToolsTableWidget->resizeRowsToContents();
 
@@ -493,6 +483,46 @@ void qSlicerWatchdogModuleWidget::onWatchdogNodeModified()
   updateWidget();
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerWatchdogModuleWidget::onWatchedNodeStatusModified(vtkObject* caller, void* callData)
+{
+  Q_D(qSlicerWatchdogModuleWidget);
+  if (caller != d->WatchdogNode || callData == NULL)
+  {
+    return;
+  }
+  // Only the status of one watched node changed, no need to rebuild the table
+  int watchedNodeIndex = *reinterpret_cast<int*>(callData);
+  this->updateWatchedNodeStatusIcon(watchedNodeIndex);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerWatchdogModuleWidget::updateWatchedNodeStatusIcon(int watchedNodeIndex)
+{
+  Q_D(qSlicerWatchdogModuleWidget);
+  if (d->WatchdogNode == NULL || watchedNodeIndex < 0 || watchedNodeIndex >= d->ToolsTableWidget->rowCount()
+    || watchedNodeIndex >= d->WatchdogNode->GetNumberOfWatchedNodes())
+  {
+    return;
+  }
+  QWidget* statusWidget = d->ToolsTableWidget->cellWidget( watchedNodeIndex, TOOL_STATUS_COLUMN);
+  QLabel* statusIcon = statusWidget ? statusWidget->findChild<QLabel*>("StatusIcon") : NULL;
+  if (!statusIcon)
+  {
+    return;
+  }
+  if(d->WatchdogNode->GetWatchedNodeUpToDate(watchedNodeIndex))
+  {
+    statusIcon->setPixmap(QPixmap(":/Icons/NodeValid.png"));
+    statusIcon->setToolTip("valid");
+  }
+  else
+  {
+    statusIcon->setPixmap(QPixmap(":/Icons/NodeInvalid.png"));
+    statusIcon->setToolTip("invalid");
+  }
+}
+
 //------------------------------------------------------------------------------
 void qSlicerWatchdogModuleWidget::setVisibility(bool visible)
 {
@@ -533,6 +563,26 @@ int qSlicerWatchdogModuleWidget::fontSize()const
   return d->FontSizeSpinBox->value();
 }
 
+//------------------------------------------------------------------------------
+void qSlicerWatchdogModuleWidget::setShowUpdateRate(bool show)
+{
+  Q_D(qSlicerWatchdogModuleWidget);
+  vtkMRMLWatchdogDisplayNode* displayNode = d->displayNode();
+  if (!displayNode)
+    {
+    qWarning("qSlicerWatchdogModuleWidget::setShowUpdateRate failed: no display node is available");
+    return;
+    }
+  displayNode->SetShowUpdateRate(show);
+}
+
+//------------------------------------------------------------------------------
+bool qSlicerWatchdogModuleWidget::showUpdateRate()const
+{
+  Q_D(const qSlicerWatchdogModuleWidget);
+  return d->ShowUpdateRateCheckBox->isChecked();
+}
+
 //------------------------------------------------------------------------------
 void qSlicerWatchdogModuleWidget::setOpacity(double opacity)
 {
@@ -24,6 +24,7 @@
 
 class qSlicerWatchdogModuleWidgetPrivate;
 class vtkMRMLNode;
+class vtkObject;
 //class vtkMRMLWatchdogNode;
 
 /// \ingroup Slicer_QtModules_ToolWatchdog
@@ -39,6 +40,7 @@ public:
 
   bool visibility()const;
   int fontSize()const;
+  bool showUpdateRate()const;
   double opacity()const;
   QColor backgroundColor()const;
   QColor textColor()const;
@@ -52,6 +54,7 @@ public slots:
 
   void setVisibility(bool);
   void setFontSize(int);
+  void setShowUpdateRate(bool);
   void setOpacity(double);
   void setBackgroundColor(QColor);
   void setTextColor(QColor);
@@ -69,6 +72,8 @@ protected slots:
   void onWatchdogNodeSelectionChanged();
   /// Update the selection node from the combobox
   void onWatchdogNodeModified();
+  /// Update the status of a single watched node in the table
+  void onWatchedNodeStatusModified(vtkObject* caller, void* callData);
   /// When the label column is clicked it connects the cellChanged signal, to update the toolbar accordingly
   void onTableItemDoubleClicked();
   /// Updates the toolbar accordingly to the label changed on the table
@@ -91,6 +96,8 @@ protected:
   virtual void setup();
   /// Set up the GUI from mrml when entering
   virtual void enter();
+  /// Update the status icon of the watched node in the table
+  void updateWatchedNodeStatusIcon(int watchedNodeIndex);
 
 private:
   Q_DECLARE_PRIVATE(qSlicerWatchdogModuleWidget);
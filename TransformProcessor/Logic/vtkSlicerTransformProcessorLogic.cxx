@@ -23,34 +23,264 @@
 #include "vtkSlicerTransformProcessorLogic.h"
 #include "vtkMRMLTransformProcessorNode.h"
 
+// IGTCommon includes
+#include "vtkLatencyInstrumentation.h"
+#include "vtkPerformanceCounters.h"
+#include "vtkSlicerTrackingTickLogic.h"
+
 // MRML includes
 #include <vtkMRMLScene.h>
 #include "vtkMRMLLinearTransformNode.h"
 #include "vtkMRMLTransformNode.h"
 
 // VTK includes
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkMatrix4x4.h>
 #include <vtkMath.h>
+#include <vtkTimerLog.h>
 //#include <vtkQuaternionInterpolator.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
 const float EPSILON = 0.00001;
 
+//-----------------------------------------------------------------------------
+// Small fixed-size matrix kernels. All 4x4 matrices are given as 16 row-major
+// elements, the same layout as vtkMatrix4x4::Element, so they work on stack arrays
+// and vtkMatrix4x4 objects alike without allocating anything.
+
+//-----------------------------------------------------------------------------
+// Transform a direction vector by a 4x4 matrix (translation is ignored)
+static inline void TransformVectorWithMatrix( const double* matrixElements, const double* vector, double* transformedVector )
+{
+  for ( int row = 0; row < 3; row++ )
+  {
+    transformedVector[ row ] = matrixElements[ 4 * row + 0 ] * vector[ 0 ] +
+                               matrixElements[ 4 * row + 1 ] * vector[ 1 ] +
+                               matrixElements[ 4 * row + 2 ] * vector[ 2 ];
+  }
+}
+
+//-----------------------------------------------------------------------------
+static inline void SetIdentityMatrixElements( double* matrixElements )
+{
+  for ( int i = 0; i < 16; i++ )
+  {
+    matrixElements[ i ] = ( i % 5 == 0 ) ? 1.0 : 0.0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Copy the upper 3x3 part of the matrix, translation of the result is zero
+static inline void CopyRotationMatrixElements( const double* sourceElements, double* rotationElements )
+{
+  for ( int row = 0; row < 3; row++ )
+  {
+    for ( int column = 0; column < 3; column++ )
+    {
+      rotationElements[ 4 * row + column ] = sourceElements[ 4 * row + column ];
+    }
+    rotationElements[ 4 * row + 3 ] = 0.0;
+  }
+  rotationElements[ 12 ] = 0.0;
+  rotationElements[ 13 ] = 0.0;
+  rotationElements[ 14 ] = 0.0;
+  rotationElements[ 15 ] = 1.0;
+}
+
+//-----------------------------------------------------------------------------
+// Rotation about an axis (need not be normalized), same result as vtkTransform::RotateWXYZ applied to identity
+static inline void SetRotationMatrixElementsFromAxisAngle( double angleDegrees, const double* axis, double* rotationElements )
+{
+  SetIdentityMatrixElements( rotationElements );
+  double axisLength = vtkMath::Norm( axis );
+  if ( angleDegrees == 0.0 || axisLength == 0.0 )
+  {
+    return;
+  }
+  double halfAngleRadians = 0.5 * vtkMath::RadiansFromDegrees( angleDegrees );
+  double sinHalfAngle = sin( halfAngleRadians ) / axisLength;
+  double quaternion[ 4 ] = { cos( halfAngleRadians ), axis[ 0 ] * sinHalfAngle, axis[ 1 ] * sinHalfAngle, axis[ 2 ] * sinHalfAngle };
+  double rotationMatrix[ 3 ][ 3 ];
+  vtkMath::QuaternionToMatrix3x3( quaternion, rotationMatrix );
+  for ( int row = 0; row < 3; row++ )
+  {
+    for ( int column = 0; column < 3; column++ )
+    {
+      rotationElements[ 4 * row + column ] = rotationMatrix[ row ][ column ];
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Pure translation made of the selected translation components of the matrix
+static inline void SetTranslationMatrixElements( const double* sourceElements, const bool* copyComponents, double* translationElements )
+{
+  SetIdentityMatrixElements( translationElements );
+  for ( int dimension = 0; dimension < 3; dimension++ )
+  {
+    if ( copyComponents[ dimension ] )
+    {
+      translationElements[ 4 * dimension + 3 ] = sourceElements[ 4 * dimension + 3 ];
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Transform from the source to the target, both given relative to a common coordinate system
+static inline void GetRelativeMatrixElements( const double* sourceToCommonElements, const double* targetToCommonElements, double* sourceToTargetElements )
+{
+  double commonToTargetElements[ 16 ];
+  vtkMatrix4x4::Invert( targetToCommonElements, commonToTargetElements );
+  vtkMatrix4x4::Multiply4x4( commonToTargetElements, sourceToCommonElements, sourceToTargetElements );
+}
+
+//-----------------------------------------------------------------------------
+// Unit quaternion of the rotation part of the matrix
+static inline void GetQuaternionFromMatrixElements( const double* matrixElements, double* quaternion )
+{
+  double rotationMatrix[ 3 ][ 3 ];
+  for ( int row = 0; row < 3; row++ )
+  {
+    for ( int column = 0; column < 3; column++ )
+    {
+      rotationMatrix[ row ][ column ] = matrixElements[ 4 * row + column ];
+    }
+  }
+  vtkMath::Matrix3x3ToQuaternion( rotationMatrix, quaternion );
+}
+
+//-----------------------------------------------------------------------------
+// Set the matrix from the normalized sum of quaternions and the sum of translations of the given number of samples.
+// Returns false if the average orientation is undefined.
+static inline bool SetMatrixElementsFromSums( const double* quaternionSum, const double* translationSum, int numberOfSamples, double* matrixElements )
+{
+  double magnitude = sqrt( quaternionSum[ 0 ] * quaternionSum[ 0 ] + quaternionSum[ 1 ] * quaternionSum[ 1 ] +
+                           quaternionSum[ 2 ] * quaternionSum[ 2 ] + quaternionSum[ 3 ] * quaternionSum[ 3 ] );
+  if ( magnitude < EPSILON || numberOfSamples < 1 )
+  {
+    return false;
+  }
+  double averageQuaternion[ 4 ] = { quaternionSum[ 0 ] / magnitude, quaternionSum[ 1 ] / magnitude, quaternionSum[ 2 ] / magnitude, quaternionSum[ 3 ] / magnitude };
+  double averageRotationMatrix[ 3 ][ 3 ];
+  vtkMath::QuaternionToMatrix3x3( averageQuaternion, averageRotationMatrix );
+  SetIdentityMatrixElements( matrixElements );
+  for ( int row = 0; row < 3; row++ )
+  {
+    for ( int column = 0; column < 3; column++ )
+    {
+      matrixElements[ 4 * row + column ] = averageRotationMatrix[ row ][ column ];
+    }
+    matrixElements[ 4 * row + 3 ] = translationSum[ row ] / numberOfSamples;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Quaternions of the weighted average are processed in blocks of this size, stored on the stack
+static const int POSE_AVERAGE_BLOCK_SIZE = 64;
+
+//-----------------------------------------------------------------------------
+// Sum of weights[ i ] * a[ i ] * b[ i ]. Four independent partial sums are accumulated, so that
+// the compiler can vectorize the loop without reordering the floating-point additions.
+static inline double WeightedProductSum( const double* weights, const double* a, const double* b, int numberOfValues )
+{
+  double partialSums[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  int i = 0;
+  for ( ; i + 4 <= numberOfValues; i += 4 )
+  {
+    partialSums[ 0 ] += weights[ i ] * a[ i ] * b[ i ];
+    partialSums[ 1 ] += weights[ i + 1 ] * a[ i + 1 ] * b[ i + 1 ];
+    partialSums[ 2 ] += weights[ i + 2 ] * a[ i + 2 ] * b[ i + 2 ];
+    partialSums[ 3 ] += weights[ i + 3 ] * a[ i + 3 ] * b[ i + 3 ];
+  }
+  double sum = ( partialSums[ 0 ] + partialSums[ 1 ] ) + ( partialSums[ 2 ] + partialSums[ 3 ] );
+  for ( ; i < numberOfValues; i++ )
+  {
+    sum += weights[ i ] * a[ i ] * b[ i ];
+  }
+  return sum;
+}
+
+//-----------------------------------------------------------------------------
+// Unit vector of the axis label, returns false if the label is not recognized
+static bool GetAxisFromLabel( int axisLabel, double* axis )
+{
+  axis[ 0 ] = axis[ 1 ] = axis[ 2 ] = 0.0;
+  switch ( axisLabel )
+  {
+    case vtkMRMLTransformProcessorNode::AXIS_LABEL_X:
+      axis[ 0 ] = 1.0;
+      return true;
+    case vtkMRMLTransformProcessorNode::AXIS_LABEL_Y:
+      axis[ 1 ] = 1.0;
+      return true;
+    case vtkMRMLTransformProcessorNode::AXIS_LABEL_Z:
+      axis[ 2 ] = 1.0;
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Returns true if the node is the ancestor node or is under it in the transform hierarchy
+static bool IsTransformNodeUnder( vtkMRMLTransformNode* node, vtkMRMLTransformNode* ancestorNode )
+{
+  for ( vtkMRMLTransformNode* transformNode = node; transformNode != NULL; transformNode = transformNode->GetParentTransformNode() )
+  {
+    if ( transformNode == ancestorNode )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// All input transform nodes of the processor node (some of them may be NULL)
+static void GetInputTransformNodes( vtkMRMLTransformProcessorNode* paramNode, std::vector< vtkMRMLTransformNode* >& inputNodes )
+{
+  inputNodes.clear();
+  for ( int i = 0; i < paramNode->GetNumberOfInputCombineTransformNodes(); i++ )
+  {
+    inputNodes.push_back( paramNode->GetNthInputCombineTransformNode( i ) );
+  }
+  inputNodes.push_back( paramNode->GetInputFromTransformNode() );
+  inputNodes.push_back( paramNode->GetInputToTransformNode() );
+  inputNodes.push_back( paramNode->GetInputInitialTransformNode() );
+  inputNodes.push_back( paramNode->GetInputChangedTransformNode() );
+  inputNodes.push_back( paramNode->GetInputAnchorTransformNode() );
+  inputNodes.push_back( paramNode->GetInputForwardTransformNode() );
+}
+
 vtkStandardNewMacro( vtkSlicerTransformProcessorLogic );
 
 //-----------------------------------------------------------------------------
 vtkSlicerTransformProcessorLogic::vtkSlicerTransformProcessorLogic()
 {
+  this->ProcessorNodeOrderModified = true;
+  this->TemporalSmoothingMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->TransformPathNodeMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->InputMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->OutputMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PerformanceCounters = vtkSmartPointer< vtkPerformanceCounters >::New();
+  this->PerformanceCounters->SetName( "TransformProcessor" );
+
+  vtkSlicerTrackingTickLogic::GetInstance()->AddObserver( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand(), vtkSlicerTrackingTickLogic::GetProcessorStagePriority() );
 }
 
 //-----------------------------------------------------------------------------
 vtkSlicerTransformProcessorLogic::~vtkSlicerTransformProcessorLogic()
 {
+  vtkSlicerTrackingTickLogic::GetInstance()->RemoveObservers( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand() );
 }
 
 //-----------------------------------------------------------------------------
@@ -78,6 +308,7 @@ void vtkSlicerTransformProcessorLogic::SetMRMLSceneInternal( vtkMRMLScene * newS
   vtkNew<vtkIntArray> events;
   events->InsertNextValue( vtkMRMLScene::NodeAddedEvent );
   events->InsertNextValue( vtkMRMLScene::NodeRemovedEvent );
+  events->InsertNextValue( vtkMRMLScene::EndBatchProcessEvent );
   this->SetAndObserveMRMLSceneEventsInternal( newScene, events.GetPointer() );
 }
 
@@ -90,18 +321,53 @@ void vtkSlicerTransformProcessorLogic::OnMRMLSceneNodeAdded( vtkMRMLNode* node )
     return;
   }
 
+  if ( this->GetMRMLScene()->IsBatchProcessing() )
+  {
+    return; // set up in OnMRMLSceneEndBatchProcess
+  }
+
   vtkMRMLTransformProcessorNode* pNode = vtkMRMLTransformProcessorNode::SafeDownCast( node );
   if ( pNode )
   {
     vtkDebugMacro( "OnMRMLSceneNodeAdded: Module node added." );
-    vtkUnObserveMRMLNodeMacro( pNode ); // Remove previous observers.
-    vtkNew<vtkIntArray> events;
-    events->InsertNextValue( vtkCommand::ModifiedEvent );
-    events->InsertNextValue( vtkMRMLTransformProcessorNode::InputDataModifiedEvent );
-    vtkObserveMRMLNodeEventsMacro( pNode, events.GetPointer() );
+    this->InitializeModuleNode( pNode );
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::OnMRMLSceneEndBatchProcess()
+{
+  if ( this->GetMRMLScene() == NULL )
+  {
+    return;
+  }
+  std::vector< vtkMRMLNode* > processorNodes;
+  this->GetMRMLScene()->GetNodesByClass( "vtkMRMLTransformProcessorNode", processorNodes );
+  for ( std::vector< vtkMRMLNode* >::iterator nodeIt = processorNodes.begin(); nodeIt != processorNodes.end(); ++nodeIt )
+  {
+    this->InitializeModuleNode( vtkMRMLTransformProcessorNode::SafeDownCast( *nodeIt ) );
   }
 }
 
+//---------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::InitializeModuleNode( vtkMRMLTransformProcessorNode* pNode )
+{
+  if ( pNode == NULL )
+  {
+    return;
+  }
+  vtkUnObserveMRMLNodeMacro( pNode ); // Remove previous observers.
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  events->InsertNextValue( vtkMRMLTransformProcessorNode::InputDataModifiedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceAddedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceModifiedEvent );
+  events->InsertNextValue( vtkMRMLNode::ReferenceRemovedEvent );
+  vtkObserveMRMLNodeEventsMacro( pNode, events.GetPointer() );
+  this->ProcessorNodes.insert( pNode );
+  this->ProcessorNodeOrderModified = true;
+}
+
 //---------------------------------------------------------------------------
 void vtkSlicerTransformProcessorLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node )
 {
@@ -115,6 +381,22 @@ void vtkSlicerTransformProcessorLogic::OnMRMLSceneNodeRemoved( vtkMRMLNode* node
   {
     vtkDebugMacro( "OnMRMLSceneNodeRemoved" );
     vtkUnObserveMRMLNodeMacro( node );
+    vtkMRMLTransformProcessorNode* paramNode = vtkMRMLTransformProcessorNode::SafeDownCast( node );
+    this->ProcessorNodes.erase( paramNode );
+    this->ProcessorNodeOrderModified = true;
+    this->TemporalSmoothingStates.erase( paramNode );
+    this->LastUpdateTimeSec.erase( paramNode );
+    if ( this->PendingUpdateNodes.erase( paramNode ) > 0 && this->PendingUpdateNodes.empty() )
+    {
+      this->Modified();
+    }
+  }
+
+  if ( node->IsA( "vtkMRMLTransformNode" ) )
+  {
+    // cached paths and the processor node order may refer to the removed node, they will be computed again when needed
+    this->TransformPaths.clear();
+    this->ProcessorNodeOrderModified = true;
   }
 }
 
@@ -127,20 +409,370 @@ void vtkSlicerTransformProcessorLogic::ProcessMRMLNodesEvents( vtkObject* caller
     return;
   }
 
+  if ( event == vtkMRMLNode::ReferenceAddedEvent ||
+       event == vtkMRMLNode::ReferenceModifiedEvent ||
+       event == vtkMRMLNode::ReferenceRemovedEvent )
+  {
+    // inputs or output changed, dependencies between the processor nodes have to be computed again
+    this->ProcessorNodeOrderModified = true;
+    return;
+  }
+
+  this->PerformanceCounters->EventReceived();
+
+  if ( this->ScheduledNodes.find( paramNode ) != this->ScheduledNodes.end() )
+  {
+    // caused by the update of an upstream node, this node is updated in the same batch
+    this->PerformanceCounters->UpdateSkipped();
+    return;
+  }
+
   // these are the only two events that should be handled
   if ( event == vtkMRMLTransformProcessorNode::InputDataModifiedEvent ||
        event == vtkCommand::ModifiedEvent )
   {
+    vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+    if ( event == vtkMRMLTransformProcessorNode::InputDataModifiedEvent && latencyInstrumentation->GetEnabled() )
+    {
+      // the output may be updated later, so the time of the input modification is recorded now
+      std::vector< vtkMRMLTransformNode* > inputNodes;
+      GetInputTransformNodes( paramNode, inputNodes );
+      for ( std::vector< vtkMRMLTransformNode* >::iterator inputIt = inputNodes.begin(); inputIt != inputNodes.end(); ++inputIt )
+      {
+        latencyInstrumentation->SourceNodeModified( *inputIt );
+      }
+    }
     if ( paramNode->GetUpdateMode() == vtkMRMLTransformProcessorNode::UPDATE_MODE_AUTO )
     {
-      this->UpdateOutputTransform( paramNode );
+      this->RequestOutputTransformUpdate( paramNode );
     }
   }
 }
 
+//-----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( caller == vtkSlicerTrackingTickLogic::GetInstance() && event == vtkSlicerTrackingTickLogic::TrackingTickEvent )
+  {
+    this->ProcessPendingUpdates();
+    return;
+  }
+  this->Superclass::ProcessMRMLLogicsEvents( caller, event, callData );
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::RequestOutputTransformUpdate( vtkMRMLTransformProcessorNode* paramNode )
+{
+  // All changes are coalesced until the next tick, where the pending nodes and their dependents
+  // are evaluated together, each once, in dependency order (see ProcessPendingUpdates)
+  bool hadPendingUpdates = !this->PendingUpdateNodes.empty();
+  if ( !this->PendingUpdateNodes.insert( paramNode ).second )
+  {
+    this->PerformanceCounters->UpdateSkipped();
+  }
+  if ( !hadPendingUpdates )
+  {
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::ProcessPendingUpdates()
+{
+  if ( this->PendingUpdateNodes.empty() )
+  {
+    return;
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  // copy, as the set may be modified by the updates
+  std::set< vtkMRMLTransformProcessorNode* > pendingUpdateNodes = this->PendingUpdateNodes;
+  std::set< vtkMRMLTransformProcessorNode* > dueNodes;
+  for ( std::set< vtkMRMLTransformProcessorNode* >::iterator nodeIt = pendingUpdateNodes.begin(); nodeIt != pendingUpdateNodes.end(); ++nodeIt )
+  {
+    vtkMRMLTransformProcessorNode* paramNode = *nodeIt;
+    if ( paramNode->GetUpdateMode() != vtkMRMLTransformProcessorNode::UPDATE_MODE_AUTO )
+    {
+      // auto-update was turned off in the meantime
+      this->PendingUpdateNodes.erase( paramNode );
+      continue;
+    }
+    int updatesPerSecond = paramNode->GetUpdatesPerSecond();
+    if ( updatesPerSecond > 0 && currentTimeSec - this->LastUpdateTimeSec[ paramNode ] < 1.0 / updatesPerSecond )
+    {
+      // not due yet
+      continue;
+    }
+    this->LastUpdateTimeSec[ paramNode ] = currentTimeSec;
+    this->PendingUpdateNodes.erase( paramNode );
+    dueNodes.insert( paramNode );
+  }
+
+  if ( !dueNodes.empty() )
+  {
+    this->UpdateOutputTransformsWithDependents( dueNodes );
+  }
+
+  if ( this->PendingUpdateNodes.empty() )
+  {
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Processor nodes are often chained (the output of one is the input of another).
+// Instead of letting each output modification trigger the next node separately,
+// all affected nodes are updated once, in dependency order. Modified events of the
+// outputs are held back until all nodes are updated, so observers are notified
+// only once per batch.
+void vtkSlicerTransformProcessorLogic::UpdateOutputTransformsWithDependents( const std::set< vtkMRMLTransformProcessorNode* >& dirtyNodes )
+{
+  if ( this->ProcessorNodeOrderModified || !this->IsProcessorNodeOrderValid() )
+  {
+    this->UpdateProcessorNodeOrder();
+  }
+
+  // collect the dirty nodes and all auto-update nodes that depend on them, directly or indirectly
+  std::vector< vtkMRMLTransformProcessorNode* > scheduledNodes( dirtyNodes.begin(), dirtyNodes.end() );
+  std::set< vtkMRMLTransformProcessorNode* > scheduledNodeSet( dirtyNodes.begin(), dirtyNodes.end() );
+  for ( std::size_t scheduledIndex = 0; scheduledIndex < scheduledNodes.size(); scheduledIndex++ )
+  {
+    const std::vector< vtkMRMLTransformProcessorNode* >& dependentNodes = this->ProcessorNodeDependents[ scheduledNodes[ scheduledIndex ] ];
+    for ( std::vector< vtkMRMLTransformProcessorNode* >::const_iterator nodeIt = dependentNodes.begin(); nodeIt != dependentNodes.end(); ++nodeIt )
+    {
+      vtkMRMLTransformProcessorNode* candidateNode = *nodeIt;
+      if ( candidateNode->GetUpdateMode() != vtkMRMLTransformProcessorNode::UPDATE_MODE_AUTO ||
+           scheduledNodeSet.find( candidateNode ) != scheduledNodeSet.end() )
+      {
+        continue;
+      }
+      scheduledNodes.push_back( candidateNode );
+      scheduledNodeSet.insert( candidateNode );
+    }
+  }
+
+  // a node is updated only after all the scheduled nodes it depends on
+  std::vector< std::pair< int, vtkMRMLTransformProcessorNode* > > orderedNodes;
+  for ( std::vector< vtkMRMLTransformProcessorNode* >::iterator nodeIt = scheduledNodes.begin(); nodeIt != scheduledNodes.end(); ++nodeIt )
+  {
+    std::map< vtkMRMLTransformProcessorNode*, int >::iterator orderIt = this->ProcessorNodeOrder.find( *nodeIt );
+    int order = ( orderIt != this->ProcessorNodeOrder.end() ? orderIt->second : static_cast< int >( this->ProcessorNodeOrder.size() ) );
+    orderedNodes.push_back( std::make_pair( order, *nodeIt ) );
+  }
+  std::stable_sort( orderedNodes.begin(), orderedNodes.end() );
+  std::vector< vtkMRMLTransformProcessorNode* > sortedNodes;
+  for ( std::vector< std::pair< int, vtkMRMLTransformProcessorNode* > >::iterator nodeIt = orderedNodes.begin(); nodeIt != orderedNodes.end(); ++nodeIt )
+  {
+    sortedNodes.push_back( nodeIt->second );
+  }
+
+  // hold back modified events of all outputs until the whole batch is evaluated
+  this->ScheduledNodes = scheduledNodeSet;
+  std::vector< std::pair< vtkMRMLLinearTransformNode*, int > > outputNodesWasModifying;
+  std::set< vtkMRMLLinearTransformNode* > outputNodes;
+  for ( std::vector< vtkMRMLTransformProcessorNode* >::iterator nodeIt = sortedNodes.begin(); nodeIt != sortedNodes.end(); ++nodeIt )
+  {
+    vtkMRMLLinearTransformNode* outputNode = ( *nodeIt )->GetOutputTransformNode();
+    if ( outputNode != NULL && outputNodes.insert( outputNode ).second )
+    {
+      outputNodesWasModifying.push_back( std::make_pair( outputNode, outputNode->StartModify() ) );
+    }
+  }
+
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  for ( std::vector< vtkMRMLTransformProcessorNode* >::iterator nodeIt = sortedNodes.begin(); nodeIt != sortedNodes.end(); ++nodeIt )
+  {
+    if ( dirtyNodes.find( *nodeIt ) == dirtyNodes.end() )
+    {
+      // a downstream node, its own pending update is covered by this one
+      this->LastUpdateTimeSec[ *nodeIt ] = currentTimeSec;
+      if ( this->PendingUpdateNodes.erase( *nodeIt ) > 0 && this->PendingUpdateNodes.empty() )
+      {
+        this->Modified();
+      }
+    }
+    this->UpdateOutputTransform( *nodeIt );
+  }
+
+  for ( std::vector< std::pair< vtkMRMLLinearTransformNode*, int > >::iterator outputIt = outputNodesWasModifying.begin(); outputIt != outputNodesWasModifying.end(); ++outputIt )
+  {
+    outputIt->first->EndModify( outputIt->second );
+  }
+  this->ScheduledNodes.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Returns true if any input of the node is the output of the other node or is transformed by it
+bool vtkSlicerTransformProcessorLogic::IsProcessorNodeDependentOn( vtkMRMLTransformProcessorNode* node, vtkMRMLTransformProcessorNode* otherNode )
+{
+  vtkMRMLTransformNode* otherOutputNode = otherNode->GetOutputTransformNode();
+  if ( otherOutputNode == NULL )
+  {
+    return false;
+  }
+
+  for ( int i = 0; i < node->GetNumberOfInputCombineTransformNodes(); i++ )
+  {
+    if ( IsTransformNodeUnder( node->GetNthInputCombineTransformNode( i ), otherOutputNode ) )
+    {
+      return true;
+    }
+  }
+  // transforms that are children of the output node also change when the output changes
+  return ( IsTransformNodeUnder( node->GetInputFromTransformNode(), otherOutputNode ) ||
+           IsTransformNodeUnder( node->GetInputToTransformNode(), otherOutputNode ) ||
+           IsTransformNodeUnder( node->GetInputInitialTransformNode(), otherOutputNode ) ||
+           IsTransformNodeUnder( node->GetInputChangedTransformNode(), otherOutputNode ) ||
+           IsTransformNodeUnder( node->GetInputAnchorTransformNode(), otherOutputNode ) ||
+           IsTransformNodeUnder( node->GetInputForwardTransformNode(), otherOutputNode ) );
+}
+
+//-----------------------------------------------------------------------------
+// Input transforms of the processor node followed by all their parents, ended by NULL
+static void GetInputHierarchy( vtkMRMLTransformProcessorNode* paramNode, std::vector< vtkMRMLTransformNode* >& inputHierarchy )
+{
+  std::vector< vtkMRMLTransformNode* > inputNodes;
+  GetInputTransformNodes( paramNode, inputNodes );
+  for ( std::vector< vtkMRMLTransformNode* >::iterator inputIt = inputNodes.begin(); inputIt != inputNodes.end(); ++inputIt )
+  {
+    for ( vtkMRMLTransformNode* transformNode = *inputIt; transformNode != NULL; transformNode = transformNode->GetParentTransformNode() )
+    {
+      inputHierarchy.push_back( transformNode );
+    }
+    inputHierarchy.push_back( NULL );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::UpdateProcessorNodeOrder()
+{
+  this->ProcessorNodeOrder.clear();
+  this->ProcessorNodeDependents.clear();
+  this->ProcessorNodeOrderInputHierarchy.clear();
+
+  std::map< vtkMRMLTransformProcessorNode*, int > numberOfDependencies;
+  for ( std::set< vtkMRMLTransformProcessorNode* >::iterator nodeIt = this->ProcessorNodes.begin(); nodeIt != this->ProcessorNodes.end(); ++nodeIt )
+  {
+    GetInputHierarchy( *nodeIt, this->ProcessorNodeOrderInputHierarchy );
+    numberOfDependencies[ *nodeIt ] = 0;
+    for ( std::set< vtkMRMLTransformProcessorNode* >::iterator otherNodeIt = this->ProcessorNodes.begin(); otherNodeIt != this->ProcessorNodes.end(); ++otherNodeIt )
+    {
+      if ( otherNodeIt != nodeIt && this->IsProcessorNodeDependentOn( *nodeIt, *otherNodeIt ) )
+      {
+        this->ProcessorNodeDependents[ *otherNodeIt ].push_back( *nodeIt );
+        numberOfDependencies[ *nodeIt ]++;
+      }
+    }
+  }
+
+  // topological sort: nodes without unprocessed dependencies are added to the order first
+  std::vector< vtkMRMLTransformProcessorNode* > readyNodes;
+  for ( std::map< vtkMRMLTransformProcessorNode*, int >::iterator nodeIt = numberOfDependencies.begin(); nodeIt != numberOfDependencies.end(); ++nodeIt )
+  {
+    if ( nodeIt->second == 0 )
+    {
+      readyNodes.push_back( nodeIt->first );
+    }
+  }
+  for ( std::size_t readyIndex = 0; readyIndex < readyNodes.size(); readyIndex++ )
+  {
+    vtkMRMLTransformProcessorNode* readyNode = readyNodes[ readyIndex ];
+    this->ProcessorNodeOrder[ readyNode ] = static_cast< int >( readyIndex );
+    const std::vector< vtkMRMLTransformProcessorNode* >& dependentNodes = this->ProcessorNodeDependents[ readyNode ];
+    for ( std::vector< vtkMRMLTransformProcessorNode* >::const_iterator dependentIt = dependentNodes.begin(); dependentIt != dependentNodes.end(); ++dependentIt )
+    {
+      if ( --numberOfDependencies[ *dependentIt ] == 0 )
+      {
+        readyNodes.push_back( *dependentIt );
+      }
+    }
+  }
+  if ( readyNodes.size() < this->ProcessorNodes.size() )
+  {
+    vtkWarningMacro( "UpdateProcessorNodeOrder: Circular dependency between transform processor nodes. Remaining nodes are updated in arbitrary order." );
+    int order = static_cast< int >( readyNodes.size() );
+    for ( std::map< vtkMRMLTransformProcessorNode*, int >::iterator nodeIt = numberOfDependencies.begin(); nodeIt != numberOfDependencies.end(); ++nodeIt )
+    {
+      if ( nodeIt->second > 0 )
+      {
+        this->ProcessorNodeOrder[ nodeIt->first ] = order++;
+      }
+    }
+  }
+
+  this->ProcessorNodeOrderModified = false;
+}
+
+//-----------------------------------------------------------------------------
+// Dependencies also follow the transform hierarchy, which may be changed without
+// modifying the processor nodes, so the parents of the inputs are compared with the ones
+// that were used when the order was computed.
+bool vtkSlicerTransformProcessorLogic::IsProcessorNodeOrderValid()
+{
+  std::size_t hierarchyIndex = 0;
+  std::size_t hierarchySize = this->ProcessorNodeOrderInputHierarchy.size();
+  std::vector< vtkMRMLTransformNode* > inputNodes;
+  for ( std::set< vtkMRMLTransformProcessorNode* >::iterator nodeIt = this->ProcessorNodes.begin(); nodeIt != this->ProcessorNodes.end(); ++nodeIt )
+  {
+    GetInputTransformNodes( *nodeIt, inputNodes );
+    for ( std::vector< vtkMRMLTransformNode* >::iterator inputIt = inputNodes.begin(); inputIt != inputNodes.end(); ++inputIt )
+    {
+      for ( vtkMRMLTransformNode* transformNode = *inputIt; transformNode != NULL; transformNode = transformNode->GetParentTransformNode() )
+      {
+        if ( hierarchyIndex >= hierarchySize || this->ProcessorNodeOrderInputHierarchy[ hierarchyIndex++ ] != transformNode )
+        {
+          return false;
+        }
+      }
+      if ( hierarchyIndex >= hierarchySize || this->ProcessorNodeOrderInputHierarchy[ hierarchyIndex++ ] != NULL )
+      {
+        return false;
+      }
+    }
+  }
+  return ( hierarchyIndex == hierarchySize );
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTransformProcessorLogic::HasPendingUpdates()
+{
+  return !this->PendingUpdateNodes.empty();
+}
+
+//-----------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerTransformProcessorLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
 //-----------------------------------------------------------------------------
 void vtkSlicerTransformProcessorLogic::UpdateOutputTransform( vtkMRMLTransformProcessorNode* paramNode )
 {
+  double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+
+  vtkLatencyInstrumentation* latencyInstrumentation = vtkLatencyInstrumentation::GetInstance();
+  if ( latencyInstrumentation->GetEnabled() && paramNode->GetOutputTransformNode() != NULL )
+  {
+    // the output is as old as the newest input it is computed from
+    std::vector< vtkMRMLTransformNode* > inputNodes;
+    GetInputTransformNodes( paramNode, inputNodes );
+    bool sourceTimeFound = false;
+    double outputSourceTimeSec = 0.0;
+    for ( std::vector< vtkMRMLTransformNode* >::iterator inputIt = inputNodes.begin(); inputIt != inputNodes.end(); ++inputIt )
+    {
+      double inputSourceTimeSec = 0.0;
+      if ( latencyInstrumentation->GetSourceTimeSec( *inputIt, inputSourceTimeSec ) && ( !sourceTimeFound || inputSourceTimeSec > outputSourceTimeSec ) )
+      {
+        outputSourceTimeSec = inputSourceTimeSec;
+        sourceTimeFound = true;
+      }
+    }
+    if ( sourceTimeFound )
+    {
+      latencyInstrumentation->SetSourceTimeSec( paramNode->GetOutputTransformNode(), outputSourceTimeSec );
+    }
+  }
+
   int mode = paramNode->GetProcessingMode();
   if ( mode == vtkMRMLTransformProcessorNode::PROCESSING_MODE_QUATERNION_AVERAGE )
   {
@@ -166,13 +798,18 @@ void vtkSlicerTransformProcessorLogic::UpdateOutputTransform( vtkMRMLTransformPr
   {
     this->ComputeInverseTransform( paramNode );
   }
+  else if ( mode == vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING )
+  {
+    this->ComputeTemporalSmoothing( paramNode );
+  }
+
+  latencyInstrumentation->RecordStageLatency( "TransformProcessor", paramNode->GetOutputTransformNode() );
+  this->PerformanceCounters->EndUpdate( updateStartTimeSec );
 }
 
 //-----------------------------------------------------------------------------
-// Please note that the implementation in code below is not fully correct.
-// It does *seem* to approximate the average transform reasonably well,
-// but it is missing a technically correct implementation such as the
-// one found in this technical note:
+// Weighted average of the combine transforms (see ComputeWeightedAveragePose). The rotation is averaged
+// as described in this technical note:
 //   F. Landis Markley, Yang Cheng, John Lucas Crassidis, and Yaakov Oshman. 
 //   "Averaging Quaternions", Journal of Guidance, Control, and Dynamics, 
 //   Vol. 30, No. 4 (2007), pp. 1193-1197. 
@@ -192,77 +829,100 @@ void vtkSlicerTransformProcessorLogic::QuaternionAverage( vtkMRMLTransformProces
     return;
   }
 
-  // Average quaternion
-  vtkSmartPointer< vtkMatrix4x4 > resultMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  // Gather the inputs into contiguous arrays, which are only reallocated if the number of inputs grows
   int numberOfInputs = paramNode->GetNumberOfInputCombineTransformNodes();
   // numberOfInputs is greater than 1, as checked by IsTransformProcessingPossible
-  vtkSmartPointer< vtkMatrix4x4 > matrix4x4Pointer = vtkSmartPointer< vtkMatrix4x4 >::New();
-
-  float rotationMatrix[ 3 ][ 3 ] = { { 0 } };
-  float averageRotationMatrix[ 3 ][ 3 ] = { { 0 } };
-  float singleQuaternion[ 4 ] = { 0 };
-  float averageQuaternion[ 4 ] = { 0 };
-
+  this->CombinePoses.resize( 16 * numberOfInputs );
+  this->CombineWeights.resize( numberOfInputs );
+  vtkMatrix4x4* matrix4x4Pointer = this->InputMatrix;
   for ( int i = 0; i < numberOfInputs; i++ )
   {
-
     paramNode->GetNthInputCombineTransformNode( i )->GetMatrixTransformToParent( matrix4x4Pointer );
+    std::copy( &matrix4x4Pointer->Element[ 0 ][ 0 ], &matrix4x4Pointer->Element[ 0 ][ 0 ] + 16, this->CombinePoses.begin() + 16 * i );
+    this->CombineWeights[ i ] = paramNode->GetNthInputCombineTransformWeight( i );
+  }
 
-    for ( int row = 0; row < 3; row++ )
+  if ( !ComputeWeightedAveragePose( &this->CombinePoses[ 0 ], &this->CombineWeights[ 0 ], numberOfInputs, &this->OutputMatrix->Element[ 0 ][ 0 ] ) )
+  {
+    vtkWarningMacro( "QuaternionAverage: Average of the input transforms is undefined (check the input weights). Returning, no operation performed." );
+    return;
+  }
+  this->OutputMatrix->Modified();
+  outputNode->SetMatrixTransformToParent( this->OutputMatrix );
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTransformProcessorLogic::ComputeWeightedAveragePose( const double* poses, const double* weights, int numberOfPoses, double* averagePose )
+{
+  if ( poses == NULL || averagePose == NULL || numberOfPoses < 1 )
+  {
+    return false;
+  }
+
+  // Accumulate M = sum( w * q * q^T ) and the weighted sum of translations.
+  // Quaternions are converted one block at a time into separate component arrays,
+  // then each of the 10 distinct elements of the symmetric M is accumulated over the block in a separate loop.
+  double outerProductSum[ 4 ][ 4 ] = { { 0.0 } };
+  double translationSum[ 3 ] = { 0.0, 0.0, 0.0 };
+  double weightSum = 0.0;
+  double blockQuaternions[ 4 ][ POSE_AVERAGE_BLOCK_SIZE ];
+  double blockWeights[ POSE_AVERAGE_BLOCK_SIZE ];
+  for ( int blockStart = 0; blockStart < numberOfPoses; blockStart += POSE_AVERAGE_BLOCK_SIZE )
+  {
+    int blockSize = std::min( POSE_AVERAGE_BLOCK_SIZE, numberOfPoses - blockStart );
+    for ( int i = 0; i < blockSize; i++ )
+    {
+      const double* poseElements = poses + 16 * ( blockStart + i );
+      double weight = ( weights != NULL ) ? std::max( 0.0, weights[ blockStart + i ] ) : 1.0;
+      double quaternion[ 4 ];
+      GetQuaternionFromMatrixElements( poseElements, quaternion );
+      for ( int component = 0; component < 4; component++ )
+      {
+        blockQuaternions[ component ][ i ] = quaternion[ component ];
+      }
+      blockWeights[ i ] = weight;
+      for ( int row = 0; row < 3; row++ )
+      {
+        translationSum[ row ] += weight * poseElements[ 4 * row + 3 ];
+      }
+      weightSum += weight;
+    }
+    for ( int row = 0; row < 4; row++ )
     {
-      for ( int column = 0; column < 3; column++ )
-      { 
-        rotationMatrix[ row ][ column ] = matrix4x4Pointer->GetElement( row, column );
+      for ( int column = row; column < 4; column++ )
+      {
+        outerProductSum[ row ][ column ] += WeightedProductSum( blockWeights, blockQuaternions[ row ], blockQuaternions[ column ], blockSize );
       }
     }
-
-    vtkMath::Matrix3x3ToQuaternion( rotationMatrix, singleQuaternion );
-
-    averageQuaternion[ 0 ] = averageQuaternion[ 0 ] + singleQuaternion[ 0 ];
-    averageQuaternion[ 1 ] = averageQuaternion[ 1 ] + singleQuaternion[ 1 ];
-    averageQuaternion[ 2 ] = averageQuaternion[ 2 ] + singleQuaternion[ 2 ];
-    averageQuaternion[ 3 ] = averageQuaternion[ 3 ] + singleQuaternion[ 3 ];
   }
-
-  averageQuaternion[ 0 ] = averageQuaternion[ 0 ] / numberOfInputs;
-  averageQuaternion[ 1 ] = averageQuaternion[ 1 ] / numberOfInputs;
-  averageQuaternion[ 2 ] = averageQuaternion[ 2 ] / numberOfInputs;
-  averageQuaternion[ 3 ] = averageQuaternion[ 3 ] / numberOfInputs;
-
-  float magnitude = sqrt(averageQuaternion[ 0 ] * averageQuaternion[ 0 ] + 
-                         averageQuaternion[ 1 ] * averageQuaternion[ 1 ] + 
-                         averageQuaternion[ 2 ] * averageQuaternion[ 2 ] + 
-                         averageQuaternion[ 3 ] * averageQuaternion[ 3 ]);
-  averageQuaternion[ 0 ] = averageQuaternion[ 0 ] / magnitude;
-  averageQuaternion[ 1 ] = averageQuaternion[ 1 ] / magnitude;
-  averageQuaternion[ 2 ] = averageQuaternion[ 2 ] / magnitude;
-  averageQuaternion[ 3 ] = averageQuaternion[ 3 ] / magnitude;
-
-  vtkMath::QuaternionToMatrix3x3( averageQuaternion,averageRotationMatrix );
-  
-  for ( int row = 0; row < 3; row++ )
+  if ( weightSum < EPSILON )
   {
-    for ( int column = 0; column < 3; column++ )
-    { 
-      resultMatrix->SetElement( row, column, averageRotationMatrix[ row ][ column ] );
-    }
+    return false;
   }
 
-  // Average linear elements
-  double value = 0;
+  // The average quaternion is the eigenvector of the largest eigenvalue (JacobiN sorts them in decreasing order)
+  double matrix[ 4 ][ 4 ];
+  double eigenvectors[ 4 ][ 4 ];
+  double* matrixRows[ 4 ];
+  double* eigenvectorRows[ 4 ];
   for ( int row = 0; row < 4; row++ )
   {
-    for ( int i = 0; i < numberOfInputs; i++ )
+    for ( int column = 0; column < 4; column++ )
     {
-      paramNode->GetNthInputCombineTransformNode( i )->GetMatrixTransformToParent( matrix4x4Pointer );
-      value += matrix4x4Pointer->GetElement( row, 3 );
+      matrix[ row ][ column ] = ( column >= row ) ? outerProductSum[ row ][ column ] : outerProductSum[ column ][ row ];
     }
-    value = value / numberOfInputs;
-    resultMatrix->SetElement( row, 3 , value );
-    value = 0;
+    matrixRows[ row ] = matrix[ row ];
+    eigenvectorRows[ row ] = eigenvectors[ row ];
   }
-
-  outputNode->SetMatrixTransformToParent( resultMatrix );
+  double eigenvalues[ 4 ];
+  if ( !vtkMath::JacobiN( matrixRows, 4, eigenvalues, eigenvectorRows ) )
+  {
+    return false;
+  }
+  double averageQuaternion[ 4 ] = { eigenvectors[ 0 ][ 0 ], eigenvectors[ 1 ][ 0 ], eigenvectors[ 2 ][ 0 ], eigenvectors[ 3 ][ 0 ] };
+  double averageTranslation[ 3 ] = { translationSum[ 0 ] / weightSum, translationSum[ 1 ] / weightSum, translationSum[ 2 ] / weightSum };
+  // the eigenvector has unit length and the translation is already averaged: pass them as the sums of one sample
+  return SetMatrixElementsFromSums( averageQuaternion, averageTranslation, 1, averagePose );
 }
 
 //-----------------------------------------------------------------------------
@@ -285,37 +945,31 @@ void vtkSlicerTransformProcessorLogic::ComputeShaftPivotTransform( vtkMRMLTransf
   // first determine rotation components
   vtkMRMLLinearTransformNode* inputChangedNode = paramNode->GetInputChangedTransformNode();
   vtkMRMLLinearTransformNode* inputInitialNode = paramNode->GetInputInitialTransformNode();
-  vtkSmartPointer< vtkGeneralTransform > inputChangedToInputInitialTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( inputChangedNode, inputInitialNode, inputChangedToInputInitialTransform );
+  vtkMatrix4x4* inputChangedToInputInitialMatrix = this->GetMatrixBetweenNodes( inputChangedNode, inputInitialNode );
   double shaftDirection[ 3 ] = { 0.0, 0.0, -1.0 }; // conventional shaft direction in SlicerIGT
-  vtkSmartPointer< vtkTransform > adjustedToInputInitialRotationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetRotationSingleAxisWithPivotFromTransform( inputChangedToInputInitialTransform, shaftDirection, adjustedToInputInitialRotationOnlyTransform );
+  double adjustedToInputInitialRotationOnlyElements[ 16 ];
+  this->GetRotationSingleAxisWithPivotFromTransform( inputChangedToInputInitialMatrix, shaftDirection, adjustedToInputInitialRotationOnlyElements );
 
   vtkMRMLLinearTransformNode* inputAnchorNode = paramNode->GetInputAnchorTransformNode();
-  vtkSmartPointer< vtkGeneralTransform > inputInitialToInputAnchorTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( inputInitialNode, inputAnchorNode, inputInitialToInputAnchorTransform );
-  vtkSmartPointer< vtkTransform > inputInitialToInputAnchorRotationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetRotationAllAxesFromTransform( inputInitialToInputAnchorTransform, inputInitialToInputAnchorRotationOnlyTransform );
+  vtkMatrix4x4* inputInitialToInputAnchorMatrix = this->GetMatrixBetweenNodes( inputInitialNode, inputAnchorNode );
+  double inputInitialToInputAnchorRotationOnlyElements[ 16 ];
+  this->GetRotationAllAxesFromTransform( inputInitialToInputAnchorMatrix, inputInitialToInputAnchorRotationOnlyElements );
   
   // Translation is same as input translation, since they share the same origin
-  vtkSmartPointer< vtkGeneralTransform > inputChangedToInputAnchorTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( inputChangedNode, inputAnchorNode, inputChangedToInputAnchorTransform );
-  vtkSmartPointer< vtkTransform > inputChangedToInputAnchorTranslationTransform = vtkSmartPointer< vtkTransform >::New();
+  vtkMatrix4x4* inputChangedToInputAnchorMatrix = this->GetMatrixBetweenNodes( inputChangedNode, inputAnchorNode );
+  double inputChangedToInputAnchorTranslationElements[ 16 ];
   bool copyComponents[ 3 ] = { 1, 1, 1 }; // copy x, y, and z
-  this->GetTranslationOnlyFromTransform( inputChangedToInputAnchorTransform, copyComponents, inputChangedToInputAnchorTranslationTransform );
+  this->GetTranslationOnlyFromTransform( inputChangedToInputAnchorMatrix, copyComponents, inputChangedToInputAnchorTranslationElements );
 
-  // put it all together
-  vtkSmartPointer< vtkTransform > adjustedToInputAnchorTransform = vtkSmartPointer< vtkTransform >::New();
-  adjustedToInputAnchorTransform->PreMultiply();
-  adjustedToInputAnchorTransform->Identity();
-  adjustedToInputAnchorTransform->Concatenate( inputChangedToInputAnchorTranslationTransform );
-  adjustedToInputAnchorTransform->Concatenate( inputInitialToInputAnchorRotationOnlyTransform );
-  adjustedToInputAnchorTransform->Concatenate( adjustedToInputInitialRotationOnlyTransform );
-  adjustedToInputAnchorTransform->Update();
+  // put it all together: translation * anchor rotation * adjusted rotation
+  double inputInitialToInputAnchorElements[ 16 ];
+  vtkMatrix4x4::Multiply4x4( inputChangedToInputAnchorTranslationElements, inputInitialToInputAnchorRotationOnlyElements, inputInitialToInputAnchorElements );
+  vtkMatrix4x4::Multiply4x4( inputInitialToInputAnchorElements, adjustedToInputInitialRotationOnlyElements, &this->OutputMatrix->Element[ 0 ][ 0 ] );
+  this->OutputMatrix->Modified();
 
   vtkMRMLLinearTransformNode* outputNode = paramNode->GetOutputTransformNode();
   // the existence of outputNode is already checked in IsTransformProcessingPossible, no error check necessary
-  outputNode->SetMatrixTransformToParent( adjustedToInputAnchorTransform->GetMatrix() );
+  outputNode->SetMatrixTransformToParent( this->OutputMatrix );
 }
 
 //----------------------------------------------------------------------------
@@ -368,10 +1022,9 @@ void vtkSlicerTransformProcessorLogic::ComputeRotation( vtkMRMLTransformProcesso
       return;
   }
 
-  vtkSmartPointer< vtkGeneralTransform > fromToToGeneralTransform = vtkSmartPointer< vtkGeneralTransform >::New();
   vtkMRMLLinearTransformNode* fromTransformNode = paramNode->GetInputFromTransformNode();
   vtkMRMLLinearTransformNode* toTransformNode = paramNode->GetInputToTransformNode();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( fromTransformNode, toTransformNode, fromToToGeneralTransform );
+  vtkMatrix4x4* fromToToMatrix = this->GetMatrixBetweenNodes( fromTransformNode, toTransformNode );
 
   // if there are other modes that need to check and corrrect for duplicate axes, these should be added below:
   if ( paramNode->GetDependentAxesMode() == vtkMRMLTransformProcessorNode::DEPENDENT_AXES_MODE_FROM_SECONDARY_AXIS )
@@ -380,11 +1033,12 @@ void vtkSlicerTransformProcessorLogic::ComputeRotation( vtkMRMLTransformProcesso
   }
 
   // computation
-  vtkSmartPointer< vtkTransform > fromToToRotationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetRotationOnlyFromTransform( fromToToGeneralTransform, rotationMode, dependentAxesMode, primaryAxis, secondaryAxis, fromToToRotationOnlyTransform );
+  this->OutputMatrix->Identity();
+  this->GetRotationOnlyFromTransform( fromToToMatrix, rotationMode, dependentAxesMode, primaryAxis, secondaryAxis, &this->OutputMatrix->Element[ 0 ][ 0 ] );
+  this->OutputMatrix->Modified();
   vtkMRMLLinearTransformNode* outputNode = paramNode->GetOutputTransformNode();
   // the existence of outputNode is already checked in IsTransformProcessingPossible, no error check necessary
-  outputNode->SetMatrixTransformToParent( fromToToRotationOnlyTransform->GetMatrix() );
+  outputNode->SetMatrixTransformToParent( this->OutputMatrix );
 }
 
 //----------------------------------------------------------------------------
@@ -399,15 +1053,15 @@ void vtkSlicerTransformProcessorLogic::ComputeTranslation( vtkMRMLTransformProce
 
   // get parameters from parameter node
   const bool* copyComponents = paramNode->GetCopyTranslationComponents();
-  vtkSmartPointer< vtkGeneralTransform > fromToToGeneralTransform = vtkSmartPointer< vtkGeneralTransform >::New();
   vtkMRMLLinearTransformNode* fromTransformNode = paramNode->GetInputFromTransformNode();
   vtkMRMLLinearTransformNode* toTransformNode = paramNode->GetInputToTransformNode();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( fromTransformNode, toTransformNode, fromToToGeneralTransform );
-  vtkSmartPointer< vtkTransform > fromToToTranslationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetTranslationOnlyFromTransform( fromToToGeneralTransform, copyComponents, fromToToTranslationOnlyTransform );
+  vtkMatrix4x4* fromToToMatrix = this->GetMatrixBetweenNodes( fromTransformNode, toTransformNode );
+  this->OutputMatrix->Identity();
+  this->GetTranslationOnlyFromTransform( fromToToMatrix, copyComponents, &this->OutputMatrix->Element[ 0 ][ 0 ] );
+  this->OutputMatrix->Modified();
   vtkMRMLLinearTransformNode* outputNode = paramNode->GetOutputTransformNode();
   // the existence of outputNode is already checked in IsTransformProcessingPossible, no error check necessary
-  outputNode->SetMatrixTransformToParent( fromToToTranslationOnlyTransform->GetMatrix() );
+  outputNode->SetMatrixTransformToParent( this->OutputMatrix );
 }
 
 //----------------------------------------------------------------------------
@@ -420,28 +1074,13 @@ void vtkSlicerTransformProcessorLogic::ComputeFullTransform( vtkMRMLTransformPro
     return;
   }
 
-  vtkSmartPointer< vtkGeneralTransform > fromToToGeneralTransform = vtkSmartPointer< vtkGeneralTransform >::New();
   vtkMRMLLinearTransformNode* fromTransformNode = paramNode->GetInputFromTransformNode();
   vtkMRMLLinearTransformNode* toTransformNode = paramNode->GetInputToTransformNode();
-  vtkMRMLTransformNode::GetTransformBetweenNodes( fromTransformNode, toTransformNode, fromToToGeneralTransform );
-
-  // need to convert the general transform to a matrix. Decompose then concatenate the rotation and translation
-  vtkSmartPointer< vtkTransform > fromToToRotationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetRotationAllAxesFromTransform( fromToToGeneralTransform, fromToToRotationOnlyTransform );
-  bool copyComponents[ 3 ] = { 1, 1, 1 }; // copy x, y, and z
-  vtkSmartPointer< vtkTransform > fromToToTranslationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetTranslationOnlyFromTransform( fromToToGeneralTransform, copyComponents, fromToToTranslationOnlyTransform );
-  
-  vtkSmartPointer< vtkTransform > fromToToLinearTransformNode = vtkSmartPointer< vtkTransform >::New();
-  fromToToLinearTransformNode->PreMultiply();
-  fromToToLinearTransformNode->Identity();
-  fromToToLinearTransformNode->Concatenate( fromToToTranslationOnlyTransform );
-  fromToToLinearTransformNode->Concatenate( fromToToRotationOnlyTransform );
-  fromToToLinearTransformNode->Update();
+  vtkMatrix4x4* fromToToMatrix = this->GetMatrixBetweenNodes( fromTransformNode, toTransformNode );
 
   vtkMRMLLinearTransformNode* outputTransformNode = paramNode->GetOutputTransformNode();
   // the existence of outputTransformNode is already checked in IsTransformProcessingPossible, no error check necessary
-  outputTransformNode->SetAndObserveTransformToParent( fromToToLinearTransformNode );
+  outputTransformNode->SetMatrixTransformToParent( fromToToMatrix );
 }
 
 //----------------------------------------------------------------------------
@@ -456,7 +1095,7 @@ void vtkSlicerTransformProcessorLogic::ComputeInverseTransform( vtkMRMLTransform
 
   vtkMRMLLinearTransformNode* forwardTransformNode = paramNode->GetInputForwardTransformNode();
   // node stores the transform _to_ parent. Inverse will be the transform _from_ parent.
-  vtkSmartPointer< vtkMatrix4x4 > matrixTransformFromParent = vtkSmartPointer< vtkMatrix4x4 >::New(); 
+  vtkMatrix4x4* matrixTransformFromParent = this->OutputMatrix;
   forwardTransformNode->GetMatrixTransformFromParent( matrixTransformFromParent );
   vtkMRMLLinearTransformNode* outputTransformNode = paramNode->GetOutputTransformNode();
   // the existence of outputTransformNode is already checked in IsTransformProcessingPossible, no error check necessary
@@ -464,15 +1103,579 @@ void vtkSlicerTransformProcessorLogic::ComputeInverseTransform( vtkMRMLTransform
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerTransformProcessorLogic::GetRotationOnlyFromTransform( vtkGeneralTransform* sourceToTargetTransform, int rotationMode, int dependentAxesMode, const double* primaryAxis, const double* secondaryAxis, vtkTransform* rotationOnlyTransform )
+// Average the last SmoothingWindowSize samples of the 'From' transform.
+// Rotations are averaged as the normalized sum of sign-aligned quaternions (not by the
+// eigenvector method of QuaternionAverage), which allows updating the average in O(1) and
+// is a good approximation for the small differences between consecutive samples of a tracker stream.
+void vtkSlicerTransformProcessorLogic::ComputeTemporalSmoothing( vtkMRMLTransformProcessorNode* paramNode )
+{
+  bool verboseWarnings = true;
+  bool conditionsMetForProcessing = this->IsTransformProcessingPossible( paramNode, verboseWarnings );
+  if ( conditionsMetForProcessing == false )
+  {
+    return;
+  }
+
+  vtkMRMLLinearTransformNode* inputNode = paramNode->GetInputFromTransformNode();
+  std::string inputNodeID = ( inputNode->GetID() ? inputNode->GetID() : "" );
+  int windowSize = paramNode->GetSmoothingWindowSize();
+  TemporalSmoothingState& state = this->TemporalSmoothingStates[ paramNode ];
+  if ( state.InputNodeID != inputNodeID || (int)state.Translations.size() != 3 * windowSize )
+  {
+    // input or window size changed, previous samples are not relevant anymore
+    this->InitializeTemporalSmoothingState( state, inputNodeID, windowSize );
+  }
+
+  // Output is also recomputed when parameters change, only add a sample if the input has actually changed
+  unsigned long inputMTime = inputNode->GetTransformToParent()->GetMTime();
+  if ( state.NumberOfSamples == 0 || inputMTime != state.LastInputMTime )
+  {
+    state.LastInputMTime = inputMTime;
+    inputNode->GetMatrixTransformToParent( this->TemporalSmoothingMatrix );
+
+    double rotationMatrix[ 3 ][ 3 ] = { { 0 } };
+    for ( int row = 0; row < 3; row++ )
+    {
+      for ( int column = 0; column < 3; column++ )
+      {
+        rotationMatrix[ row ][ column ] = this->TemporalSmoothingMatrix->GetElement( row, column );
+      }
+    }
+    double quaternion[ 4 ] = { 0 };
+    vtkMath::Matrix3x3ToQuaternion( rotationMatrix, quaternion );
+
+    // q and -q represent the same rotation, flip the quaternion to the side of the running sum
+    // so that the samples do not cancel each other out
+    double dotProduct = 0.0;
+    for ( int i = 0; i < 4; i++ )
+    {
+      dotProduct += quaternion[ i ] * state.QuaternionSum[ i ];
+    }
+    if ( dotProduct < 0.0 )
+    {
+      for ( int i = 0; i < 4; i++ )
+      {
+        quaternion[ i ] = -quaternion[ i ];
+      }
+    }
+
+    int sampleIndex = 0;
+    if ( state.NumberOfSamples < windowSize )
+    {
+      sampleIndex = state.NumberOfSamples;
+      state.NumberOfSamples++;
+    }
+    else
+    {
+      // window is full, replace the oldest sample
+      sampleIndex = state.OldestSampleIndex;
+      state.OldestSampleIndex = ( state.OldestSampleIndex + 1 ) % windowSize;
+      for ( int i = 0; i < 4; i++ )
+      {
+        state.QuaternionSum[ i ] -= state.Quaternions[ 4 * sampleIndex + i ];
+      }
+      for ( int i = 0; i < 3; i++ )
+      {
+        state.TranslationSum[ i ] -= state.Translations[ 3 * sampleIndex + i ];
+      }
+    }
+
+    for ( int i = 0; i < 4; i++ )
+    {
+      state.Quaternions[ 4 * sampleIndex + i ] = quaternion[ i ];
+      state.QuaternionSum[ i ] += quaternion[ i ];
+    }
+    for ( int i = 0; i < 3; i++ )
+    {
+      state.Translations[ 3 * sampleIndex + i ] = this->TemporalSmoothingMatrix->GetElement( i, 3 );
+      state.TranslationSum[ i ] += state.Translations[ 3 * sampleIndex + i ];
+    }
+
+    if ( state.NumberOfSamples == windowSize && state.OldestSampleIndex == 0 )
+    {
+      // Recompute the sums once per window to prevent accumulation of round-off errors
+      // from the repeated subtractions. This keeps the amortized cost of an update O(1).
+      for ( int i = 0; i < 4; i++ )
+      {
+        state.QuaternionSum[ i ] = 0.0;
+      }
+      for ( int i = 0; i < 3; i++ )
+      {
+        state.TranslationSum[ i ] = 0.0;
+      }
+      for ( int sample = 0; sample < windowSize; sample++ )
+      {
+        for ( int i = 0; i < 4; i++ )
+        {
+          state.QuaternionSum[ i ] += state.Quaternions[ 4 * sample + i ];
+        }
+        for ( int i = 0; i < 3; i++ )
+        {
+          state.TranslationSum[ i ] += state.Translations[ 3 * sample + i ];
+        }
+      }
+    }
+  }
+
+  double averageQuaternion[ 4 ] = { state.QuaternionSum[ 0 ], state.QuaternionSum[ 1 ], state.QuaternionSum[ 2 ], state.QuaternionSum[ 3 ] };
+  double magnitude = sqrt( averageQuaternion[ 0 ] * averageQuaternion[ 0 ] +
+                           averageQuaternion[ 1 ] * averageQuaternion[ 1 ] +
+                           averageQuaternion[ 2 ] * averageQuaternion[ 2 ] +
+                           averageQuaternion[ 3 ] * averageQuaternion[ 3 ] );
+  if ( magnitude < EPSILON )
+  {
+    vtkWarningMacro( "ComputeTemporalSmoothing: Average orientation is undefined. Returning, no operation performed." );
+    return;
+  }
+  for ( int i = 0; i < 4; i++ )
+  {
+    averageQuaternion[ i ] = averageQuaternion[ i ] / magnitude;
+  }
+
+  double averageRotationMatrix[ 3 ][ 3 ] = { { 0 } };
+  vtkMath::QuaternionToMatrix3x3( averageQuaternion, averageRotationMatrix );
+  this->TemporalSmoothingMatrix->Identity();
+  for ( int row = 0; row < 3; row++ )
+  {
+    for ( int column = 0; column < 3; column++ )
+    {
+      this->TemporalSmoothingMatrix->SetElement( row, column, averageRotationMatrix[ row ][ column ] );
+    }
+    this->TemporalSmoothingMatrix->SetElement( row, 3, state.TranslationSum[ row ] / state.NumberOfSamples );
+  }
+
+  vtkMRMLLinearTransformNode* outputTransformNode = paramNode->GetOutputTransformNode();
+  // the existence of outputTransformNode is already checked in IsTransformProcessingPossible, no error check necessary
+  outputTransformNode->SetMatrixTransformToParent( this->TemporalSmoothingMatrix );
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerTransformProcessorLogic::ProcessPoseSequence( vtkMRMLTransformProcessorNode* paramNode, vtkCollection* inputPoseArrays, vtkDoubleArray* outputPoses )
+{
+  if ( paramNode == NULL || inputPoseArrays == NULL || outputPoses == NULL )
+  {
+    vtkErrorMacro( "ProcessPoseSequence: Invalid inputs. Returning, no operation performed." );
+    return false;
+  }
+
+  PoseSequenceJob job;
+  job.Self = this;
+  job.ProcessingMode = paramNode->GetProcessingMode();
+  job.RotationMode = paramNode->GetRotationMode();
+  job.DependentAxesMode = paramNode->GetDependentAxesMode();
+  job.SmoothingWindowSize = std::max( 1, paramNode->GetSmoothingWindowSize() );
+  const bool* copyComponents = paramNode->GetCopyTranslationComponents();
+  for ( int i = 0; i < 3; i++ )
+  {
+    job.CopyTranslationComponents[ i ] = copyComponents[ i ];
+  }
+  for ( int i = 0; i < inputPoseArrays->GetNumberOfItems(); i++ )
+  {
+    job.CombineWeights.push_back( paramNode->GetNthInputCombineTransformWeight( i ) );
+  }
+
+  int expectedNumberOfInputs = 0;
+  switch ( job.ProcessingMode )
+  {
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_QUATERNION_AVERAGE:
+      expectedNumberOfInputs = std::max( 2, inputPoseArrays->GetNumberOfItems() );
+      break;
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_SHAFT_PIVOT:
+      expectedNumberOfInputs = 3;
+      break;
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_ROTATION:
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_TRANSLATION:
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_FULL_TRANSFORM:
+      expectedNumberOfInputs = 2;
+      break;
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_INVERSE:
+    case vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING:
+      expectedNumberOfInputs = 1;
+      break;
+    default:
+      vtkErrorMacro( "ProcessPoseSequence: Unrecognized processing mode " << job.ProcessingMode << ". Returning, no operation performed." );
+      return false;
+  }
+  if ( inputPoseArrays->GetNumberOfItems() != expectedNumberOfInputs )
+  {
+    vtkErrorMacro( "ProcessPoseSequence: " << expectedNumberOfInputs << " input pose arrays are required for processing mode "
+      << vtkMRMLTransformProcessorNode::GetProcessingModeAsString( job.ProcessingMode ) << ", " << inputPoseArrays->GetNumberOfItems() << " were given." );
+    return false;
+  }
+
+  if ( job.ProcessingMode == vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_ROTATION )
+  {
+    // same correction of duplicate axes as in ComputeRotation, but applied to local copies
+    // so that processing a sequence does not modify the parameter node
+    int primaryAxisLabel = paramNode->GetPrimaryAxisLabel();
+    int secondaryAxisLabel = paramNode->GetSecondaryAxisLabel();
+    if ( job.DependentAxesMode == vtkMRMLTransformProcessorNode::DEPENDENT_AXES_MODE_FROM_SECONDARY_AXIS && primaryAxisLabel == secondaryAxisLabel )
+    {
+      if ( primaryAxisLabel == vtkMRMLTransformProcessorNode::AXIS_LABEL_Z )
+      {
+        secondaryAxisLabel = vtkMRMLTransformProcessorNode::AXIS_LABEL_Y;
+      }
+      else if ( primaryAxisLabel == vtkMRMLTransformProcessorNode::AXIS_LABEL_Y ||
+                primaryAxisLabel == vtkMRMLTransformProcessorNode::AXIS_LABEL_X )
+      {
+        secondaryAxisLabel = vtkMRMLTransformProcessorNode::AXIS_LABEL_Z;
+      }
+    }
+    if ( !GetAxisFromLabel( primaryAxisLabel, job.PrimaryAxis )
+      || !GetAxisFromLabel( secondaryAxisLabel, job.SecondaryAxis ) )
+    {
+      vtkErrorMacro( "ProcessPoseSequence: Unrecognized rotation axis. Returning, no operation performed." );
+      return false;
+    }
+  }
+
+  job.NumberOfFrames = -1;
+  for ( int inputIndex = 0; inputIndex < inputPoseArrays->GetNumberOfItems(); inputIndex++ )
+  {
+    vtkDoubleArray* inputPoses = vtkDoubleArray::SafeDownCast( inputPoseArrays->GetItemAsObject( inputIndex ) );
+    if ( inputPoses == NULL || inputPoses->GetNumberOfComponents() != 16 )
+    {
+      vtkErrorMacro( "ProcessPoseSequence: Input " << inputIndex << " is not a pose array (double array with 16 components). Returning, no operation performed." );
+      return false;
+    }
+    if ( job.NumberOfFrames >= 0 && inputPoses->GetNumberOfTuples() != job.NumberOfFrames )
+    {
+      vtkErrorMacro( "ProcessPoseSequence: Input " << inputIndex << " has " << inputPoses->GetNumberOfTuples() << " frames, "
+        << job.NumberOfFrames << " expected. Returning, no operation performed." );
+      return false;
+    }
+    job.NumberOfFrames = inputPoses->GetNumberOfTuples();
+    job.InputPoses.push_back( inputPoses->GetPointer( 0 ) );
+  }
+
+  outputPoses->SetNumberOfComponents( 16 );
+  outputPoses->SetNumberOfTuples( job.NumberOfFrames );
+  if ( job.NumberOfFrames == 0 )
+  {
+    return true;
+  }
+  job.OutputPoses = outputPoses->GetPointer( 0 );
+
+  vtkNew< vtkMultiThreader > threader;
+  vtkIdType numberOfThreads = std::min( static_cast< vtkIdType >( threader->GetNumberOfThreads() ), job.NumberOfFrames );
+  threader->SetNumberOfThreads( static_cast< int >( numberOfThreads ) );
+  threader->SetSingleMethod( ProcessPoseSequenceThreadFunction, &job );
+  threader->SingleMethodExecute();
+  outputPoses->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerTransformProcessorLogic::ProcessPoseSequenceThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  PoseSequenceJob* job = static_cast< PoseSequenceJob* >( threadInfo->UserData );
+  vtkIdType firstFrame = job->NumberOfFrames * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  vtkIdType lastFrame = job->NumberOfFrames * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  job->Self->ProcessPoseSequenceFrames( *job, firstFrame, lastFrame );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+// Computes the output poses of frames in [ firstFrame, lastFrame ). Only reads the job inputs and
+// writes the output poses of these frames, so ranges can be processed concurrently.
+void vtkSlicerTransformProcessorLogic::ProcessPoseSequenceFrames( PoseSequenceJob& job, vtkIdType firstFrame, vtkIdType lastFrame )
+{
+  // the rotation helpers take vtkMatrix4x4 inputs, each thread uses its own
+  vtkNew< vtkMatrix4x4 > sourceToTargetMatrix;
+  double* sourceToTargetElements = &sourceToTargetMatrix->Element[ 0 ][ 0 ];
+  // quaternion average inputs of the current frame, gathered into a contiguous array
+  std::vector< double > combinePoses( 16 * job.InputPoses.size() );
+  for ( vtkIdType frame = firstFrame; frame < lastFrame; frame++ )
+  {
+    double* outputElements = job.OutputPoses + 16 * frame;
+    SetIdentityMatrixElements( outputElements );
+    switch ( job.ProcessingMode )
+    {
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_QUATERNION_AVERAGE:
+      {
+        // same computation as QuaternionAverage
+        int numberOfInputs = static_cast< int >( job.InputPoses.size() );
+        for ( int inputIndex = 0; inputIndex < numberOfInputs; inputIndex++ )
+        {
+          const double* inputElements = job.InputPoses[ inputIndex ] + 16 * frame;
+          std::copy( inputElements, inputElements + 16, combinePoses.begin() + 16 * inputIndex );
+        }
+        ComputeWeightedAveragePose( &combinePoses[ 0 ], &job.CombineWeights[ 0 ], numberOfInputs, outputElements );
+        break;
+      }
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_SHAFT_PIVOT:
+      {
+        // same computation as ComputeShaftPivotTransform
+        const double* changedElements = job.InputPoses[ 0 ] + 16 * frame;
+        const double* initialElements = job.InputPoses[ 1 ] + 16 * frame;
+        const double* anchorElements = job.InputPoses[ 2 ] + 16 * frame;
+        double shaftDirection[ 3 ] = { 0.0, 0.0, -1.0 }; // conventional shaft direction in SlicerIGT
+        GetRelativeMatrixElements( changedElements, initialElements, sourceToTargetElements );
+        double adjustedToInputInitialRotationOnlyElements[ 16 ];
+        this->GetRotationSingleAxisWithPivotFromTransform( sourceToTargetMatrix.GetPointer(), shaftDirection, adjustedToInputInitialRotationOnlyElements );
+        double inputInitialToInputAnchorElements[ 16 ];
+        GetRelativeMatrixElements( initialElements, anchorElements, inputInitialToInputAnchorElements );
+        double inputInitialToInputAnchorRotationOnlyElements[ 16 ];
+        CopyRotationMatrixElements( inputInitialToInputAnchorElements, inputInitialToInputAnchorRotationOnlyElements );
+        double inputChangedToInputAnchorElements[ 16 ];
+        GetRelativeMatrixElements( changedElements, anchorElements, inputChangedToInputAnchorElements );
+        double inputChangedToInputAnchorTranslationElements[ 16 ];
+        bool copyComponents[ 3 ] = { 1, 1, 1 };
+        SetTranslationMatrixElements( inputChangedToInputAnchorElements, copyComponents, inputChangedToInputAnchorTranslationElements );
+        vtkMatrix4x4::Multiply4x4( inputChangedToInputAnchorTranslationElements, inputInitialToInputAnchorRotationOnlyElements, inputInitialToInputAnchorElements );
+        vtkMatrix4x4::Multiply4x4( inputInitialToInputAnchorElements, adjustedToInputInitialRotationOnlyElements, outputElements );
+        break;
+      }
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_ROTATION:
+        GetRelativeMatrixElements( job.InputPoses[ 0 ] + 16 * frame, job.InputPoses[ 1 ] + 16 * frame, sourceToTargetElements );
+        this->GetRotationOnlyFromTransform( sourceToTargetMatrix.GetPointer(), job.RotationMode, job.DependentAxesMode, job.PrimaryAxis, job.SecondaryAxis, outputElements );
+        break;
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_TRANSLATION:
+        GetRelativeMatrixElements( job.InputPoses[ 0 ] + 16 * frame, job.InputPoses[ 1 ] + 16 * frame, sourceToTargetElements );
+        SetTranslationMatrixElements( sourceToTargetElements, job.CopyTranslationComponents, outputElements );
+        break;
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_FULL_TRANSFORM:
+        GetRelativeMatrixElements( job.InputPoses[ 0 ] + 16 * frame, job.InputPoses[ 1 ] + 16 * frame, outputElements );
+        break;
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_INVERSE:
+        vtkMatrix4x4::Invert( job.InputPoses[ 0 ] + 16 * frame, outputElements );
+        break;
+      case vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING:
+      {
+        // Average of the window ending at this frame. Each frame is computed independently,
+        // so that the frame ranges of the threads do not depend on each other.
+        vtkIdType firstSampleFrame = std::max( static_cast< vtkIdType >( 0 ), frame - job.SmoothingWindowSize + 1 );
+        double quaternionSum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+        double translationSum[ 3 ] = { 0.0, 0.0, 0.0 };
+        for ( vtkIdType sampleFrame = firstSampleFrame; sampleFrame <= frame; sampleFrame++ )
+        {
+          const double* inputElements = job.InputPoses[ 0 ] + 16 * sampleFrame;
+          double quaternion[ 4 ];
+          GetQuaternionFromMatrixElements( inputElements, quaternion );
+          // q and -q represent the same rotation, flip the quaternion to the side of the sum
+          double dotProduct = 0.0;
+          for ( int i = 0; i < 4; i++ )
+          {
+            dotProduct += quaternion[ i ] * quaternionSum[ i ];
+          }
+          double sign = ( dotProduct < 0.0 ) ? -1.0 : 1.0;
+          for ( int i = 0; i < 4; i++ )
+          {
+            quaternionSum[ i ] += sign * quaternion[ i ];
+          }
+          for ( int i = 0; i < 3; i++ )
+          {
+            translationSum[ i ] += inputElements[ 4 * i + 3 ];
+          }
+        }
+        SetMatrixElementsFromSums( quaternionSum, translationSum, static_cast< int >( frame - firstSampleFrame + 1 ), outputElements );
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::ResetTemporalSmoothing( vtkMRMLTransformProcessorNode* paramNode )
+{
+  this->TemporalSmoothingStates.erase( paramNode );
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::InitializeTemporalSmoothingState( TemporalSmoothingState& state, const std::string& inputNodeID, int windowSize )
+{
+  state.InputNodeID = inputNodeID;
+  state.LastInputMTime = 0;
+  state.NumberOfSamples = 0;
+  state.OldestSampleIndex = 0;
+  state.Quaternions.assign( 4 * windowSize, 0.0 );
+  state.Translations.assign( 3 * windowSize, 0.0 );
+  for ( int i = 0; i < 4; i++ )
+  {
+    state.QuaternionSum[ i ] = 0.0;
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    state.TranslationSum[ i ] = 0.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Returns the sourceToTarget matrix. The path between the nodes in the transform hierarchy
+// is resolved only on the first call (or when the hierarchy changes), after that the
+// result is re-evaluated by multiplying the matrices along the path, and only if
+// any of them has changed. The returned matrix is owned by the logic.
+vtkMatrix4x4* vtkSlicerTransformProcessorLogic::GetMatrixBetweenNodes( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode )
+{
+  TransformPath& path = this->TransformPaths[ TransformPathKey( sourceNode, targetNode ) ];
+  if ( path.SourceToTargetMatrix.GetPointer() == NULL )
+  {
+    path.SourceToTargetMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+    this->ResolveTransformPath( sourceNode, targetNode, path );
+  }
+  else if ( this->IsTransformPathValid( sourceNode, targetNode, path ) == false )
+  {
+    // the transform hierarchy has changed since the path was resolved
+    this->ResolveTransformPath( sourceNode, targetNode, path );
+  }
+
+  std::size_t numberOfSourceNodes = path.SourceToCommonAncestorNodes.size();
+  std::size_t numberOfNodes = numberOfSourceNodes + path.TargetToCommonAncestorNodes.size();
+  bool pathIsLinear = true;
+  bool pathIsModified = ( path.Evaluated == false );
+  for ( std::size_t i = 0; i < numberOfNodes; i++ )
+  {
+    vtkMRMLTransformNode* node = ( i < numberOfSourceNodes ? path.SourceToCommonAncestorNodes[ i ] : path.TargetToCommonAncestorNodes[ i - numberOfSourceNodes ] );
+    if ( node->IsLinear() == false || node->GetTransformToParent() == NULL )
+    {
+      pathIsLinear = false;
+      break;
+    }
+    unsigned long nodeMTime = node->GetTransformToParent()->GetMTime();
+    if ( path.NodeMTimes[ i ] != nodeMTime )
+    {
+      path.NodeMTimes[ i ] = nodeMTime;
+      pathIsModified = true;
+    }
+  }
+
+  if ( pathIsLinear == false )
+  {
+    // Cannot be computed by matrix multiplications, use the general transform and linearize it at the origin
+    vtkSmartPointer< vtkGeneralTransform > sourceToTargetTransform = vtkSmartPointer< vtkGeneralTransform >::New();
+    vtkMRMLTransformNode::GetTransformBetweenNodes( sourceNode, targetNode, sourceToTargetTransform );
+    double zeroVector3[ 3 ] = { 0.0, 0.0, 0.0 };
+    double translation[ 3 ] = { 0.0, 0.0, 0.0 };
+    sourceToTargetTransform->TransformPoint( zeroVector3, translation );
+    path.SourceToTargetMatrix->Identity();
+    for ( int column = 0; column < 3; column++ )
+    {
+      double axis[ 3 ] = { 0.0, 0.0, 0.0 };
+      axis[ column ] = 1.0;
+      double axisInTarget[ 3 ] = { 0.0, 0.0, 0.0 };
+      sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, axis, axisInTarget );
+      for ( int row = 0; row < 3; row++ )
+      {
+        path.SourceToTargetMatrix->SetElement( row, column, axisInTarget[ row ] );
+      }
+      path.SourceToTargetMatrix->SetElement( column, 3, translation[ column ] );
+    }
+    path.Evaluated = false; // non-linear transforms are not tracked, evaluate again next time
+    return path.SourceToTargetMatrix;
+  }
+
+  if ( pathIsModified == false )
+  {
+    return path.SourceToTargetMatrix;
+  }
+
+  // sourceToTarget = inverse( targetToCommonAncestor ) * sourceToCommonAncestor
+  double sourceToCommonAncestor[ 16 ];
+  double targetToCommonAncestor[ 16 ];
+  vtkMatrix4x4::Identity( sourceToCommonAncestor );
+  vtkMatrix4x4::Identity( targetToCommonAncestor );
+  double productElements[ 16 ];
+  for ( std::size_t i = 0; i < numberOfNodes; i++ )
+  {
+    bool isSourceNode = ( i < numberOfSourceNodes );
+    vtkMRMLTransformNode* node = ( isSourceNode ? path.SourceToCommonAncestorNodes[ i ] : path.TargetToCommonAncestorNodes[ i - numberOfSourceNodes ] );
+    node->GetMatrixTransformToParent( this->TransformPathNodeMatrix );
+    double* toCommonAncestor = ( isSourceNode ? sourceToCommonAncestor : targetToCommonAncestor );
+    // nodes are ordered from child to parent, so each matrix is multiplied from the left
+    vtkMatrix4x4::Multiply4x4( &this->TransformPathNodeMatrix->Element[ 0 ][ 0 ], toCommonAncestor, productElements );
+    std::copy( productElements, productElements + 16, toCommonAncestor );
+  }
+  double commonAncestorToTarget[ 16 ];
+  vtkMatrix4x4::Invert( targetToCommonAncestor, commonAncestorToTarget );
+  vtkMatrix4x4::Multiply4x4( commonAncestorToTarget, sourceToCommonAncestor, &path.SourceToTargetMatrix->Element[ 0 ][ 0 ] );
+  path.SourceToTargetMatrix->Modified();
+  path.Evaluated = true;
+
+  return path.SourceToTargetMatrix;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::ResolveTransformPath( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, TransformPath& path )
+{
+  path.SourceToCommonAncestorNodes.clear();
+  path.TargetToCommonAncestorNodes.clear();
+  path.CommonAncestorNode = NULL;
+
+  std::vector< vtkMRMLTransformNode* > targetAncestorNodes;
+  for ( vtkMRMLTransformNode* node = targetNode; node != NULL; node = node->GetParentTransformNode() )
+  {
+    targetAncestorNodes.push_back( node );
+  }
+
+  // walk up from the source until we reach a node that is also an ancestor of the target
+  for ( vtkMRMLTransformNode* node = sourceNode; node != NULL; node = node->GetParentTransformNode() )
+  {
+    if ( std::find( targetAncestorNodes.begin(), targetAncestorNodes.end(), node ) != targetAncestorNodes.end() )
+    {
+      path.CommonAncestorNode = node;
+      break;
+    }
+    path.SourceToCommonAncestorNodes.push_back( node );
+  }
+
+  for ( std::vector< vtkMRMLTransformNode* >::iterator nodeIt = targetAncestorNodes.begin(); nodeIt != targetAncestorNodes.end(); ++nodeIt )
+  {
+    if ( *nodeIt == path.CommonAncestorNode )
+    {
+      break;
+    }
+    path.TargetToCommonAncestorNodes.push_back( *nodeIt );
+  }
+
+  path.NodeMTimes.assign( path.SourceToCommonAncestorNodes.size() + path.TargetToCommonAncestorNodes.size(), 0 );
+  path.SourceToTargetMatrix->Identity();
+  path.Evaluated = false;
+}
+
+//----------------------------------------------------------------------------
+// Check that the cached path still matches the transform hierarchy.
+// Only the current parents of the nodes are dereferenced, cached pointers are just compared.
+bool vtkSlicerTransformProcessorLogic::IsTransformPathValid( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, const TransformPath& path )
+{
+  vtkMRMLTransformNode* node = sourceNode;
+  for ( std::vector< vtkMRMLTransformNode* >::const_iterator nodeIt = path.SourceToCommonAncestorNodes.begin(); nodeIt != path.SourceToCommonAncestorNodes.end(); ++nodeIt )
+  {
+    if ( node == NULL || node != *nodeIt )
+    {
+      return false;
+    }
+    node = node->GetParentTransformNode();
+  }
+  if ( node != path.CommonAncestorNode )
+  {
+    return false;
+  }
+
+  node = targetNode;
+  for ( std::vector< vtkMRMLTransformNode* >::const_iterator nodeIt = path.TargetToCommonAncestorNodes.begin(); nodeIt != path.TargetToCommonAncestorNodes.end(); ++nodeIt )
+  {
+    if ( node == NULL || node != *nodeIt )
+    {
+      return false;
+    }
+    node = node->GetParentTransformNode();
+  }
+  return ( node == path.CommonAncestorNode );
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTransformProcessorLogic::GetRotationOnlyFromTransform( vtkMatrix4x4* sourceToTargetMatrix, int rotationMode, int dependentAxesMode, const double* primaryAxis, const double* secondaryAxis, double* rotationOnlyElements )
 {
-  if ( rotationOnlyTransform == NULL )
+  if ( rotationOnlyElements == NULL )
   {
-    vtkErrorMacro( "GetRotationOnlyFromTransform: rotationOnlyTransform is null. Returning, but transform will remain null." );
+    vtkErrorMacro( "GetRotationOnlyFromTransform: rotationOnlyElements is null. Returning, no operation performed." );
     return;
   }
 
-  if ( sourceToTargetTransform == NULL )
+  if ( sourceToTargetMatrix == NULL )
   {
     vtkErrorMacro( "GetRotationOnlyFromTransform: inputFullTransform is null. Returning, but no operation performed." );
     return;
@@ -481,10 +1684,10 @@ void vtkSlicerTransformProcessorLogic::GetRotationOnlyFromTransform( vtkGeneralT
   switch ( rotationMode )
   {
     case vtkMRMLTransformProcessorNode::ROTATION_MODE_COPY_ALL_AXES:
-      this->GetRotationAllAxesFromTransform( sourceToTargetTransform, rotationOnlyTransform );
+      this->GetRotationAllAxesFromTransform( sourceToTargetMatrix, rotationOnlyElements );
       break;
     case vtkMRMLTransformProcessorNode::ROTATION_MODE_COPY_SINGLE_AXIS:
-      this->GetRotationSingleAxisFromTransform( sourceToTargetTransform, dependentAxesMode, primaryAxis, secondaryAxis, rotationOnlyTransform );
+      this->GetRotationSingleAxisFromTransform( sourceToTargetMatrix, dependentAxesMode, primaryAxis, secondaryAxis, rotationOnlyElements );
       break;
     default:
       vtkErrorMacro( "GetRotationOnlyFromTransform: rotationMode " << rotationMode << " is unrecognized. Returning, but no operation performed." );
@@ -496,49 +1699,34 @@ void vtkSlicerTransformProcessorLogic::GetRotationOnlyFromTransform( vtkGeneralT
 // Get the orientation transform from one transform to the other.
 // In other words, return the 3x3 matrix that is used to
 // rotate from one basis to another. Translation is not used here.
-void vtkSlicerTransformProcessorLogic::GetRotationAllAxesFromTransform ( vtkGeneralTransform* sourceToTargetTransform, vtkTransform* rotationOnlyTransform )
+void vtkSlicerTransformProcessorLogic::GetRotationAllAxesFromTransform ( vtkMatrix4x4* sourceToTargetMatrix, double* rotationOnlyElements )
 {
-  if ( rotationOnlyTransform == NULL )
+  if ( rotationOnlyElements == NULL )
   {
-    vtkErrorMacro( "GetRotationAllAxesFromTransform: rotationOnlyTransform is null. Returning, but transform will remain null." );
+    vtkErrorMacro( "GetRotationAllAxesFromTransform: rotationOnlyElements is null. Returning, no operation performed." );
     return;
   }
 
-  if ( sourceToTargetTransform == NULL )
+  if ( sourceToTargetMatrix == NULL )
   {
-    vtkErrorMacro( "GetRotationAllAxesFromTransform: sourceToTargetTransform is null. Returning, but no operation performed." );
+    vtkErrorMacro( "GetRotationAllAxesFromTransform: sourceToTargetMatrix is null. Returning, but no operation performed." );
     return;
   }
 
-  // Unfortunately, the vtkGeneralTransform class does not provide an easy way to copy the full transform
-  // and leave the translation component at zero. So we just have to do some manual vtk math here to find the axes
-  double zeroVector3[ 3 ] = { 0.0, 0.0, 0.0 };
-  double xAxisVector[ 3 ] = { 1.0, 0.0, 0.0 };
-  double xAxisInput[ 3 ];
-  sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, xAxisVector, xAxisInput );
-  double yAxisVector[ 3 ] = { 0.0, 1.0, 0.0 };
-  double yAxisInput[ 3 ];
-  sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, yAxisVector, yAxisInput );
-  double zAxisVector[ 3 ] = { 0.0, 0.0, 1.0 };
-  double zAxisInput[ 3 ];
-  sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, zAxisVector, zAxisInput );
-  
-  // set the matrix accordingly
-  vtkSmartPointer< vtkMatrix4x4 > rotationOnlyMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
-  this->GetRotationMatrixFromAxes( xAxisInput, yAxisInput, zAxisInput, rotationOnlyMatrix );
-  rotationOnlyTransform->SetMatrix( rotationOnlyMatrix );
+  // The axes of the rotation are the columns of the upper 3x3 part of the matrix
+  CopyRotationMatrixElements( &sourceToTargetMatrix->Element[ 0 ][ 0 ], rotationOnlyElements );
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisFromTransform( vtkGeneralTransform* sourceToTargetTransform, int dependentAxesMode, const double* primaryAxis, const double* secondaryAxis, vtkTransform* rotationOnlyTransform )
+void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisFromTransform( vtkMatrix4x4* sourceToTargetMatrix, int dependentAxesMode, const double* primaryAxis, const double* secondaryAxis, double* rotationOnlyElements )
 {
-  if ( rotationOnlyTransform == NULL )
+  if ( rotationOnlyElements == NULL )
   {
-    vtkErrorMacro( "GetRotationSingleAxisFromTransform: rotationOnlyTransform is null. Returning, but transform will remain null." );
+    vtkErrorMacro( "GetRotationSingleAxisFromTransform: rotationOnlyElements is null. Returning, no operation performed." );
     return;
   }
 
-  if ( sourceToTargetTransform == NULL )
+  if ( sourceToTargetMatrix == NULL )
   {
     vtkErrorMacro( "GetRotationSingleAxisFromTransform: inputFullTransform is null. Returning, but no operation performed." );
     return;
@@ -547,10 +1735,10 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisFromTransform( vtkGe
   switch ( dependentAxesMode )
   {
     case vtkMRMLTransformProcessorNode::DEPENDENT_AXES_MODE_FROM_PIVOT:
-      this->GetRotationSingleAxisWithPivotFromTransform( sourceToTargetTransform, primaryAxis, rotationOnlyTransform );
+      this->GetRotationSingleAxisWithPivotFromTransform( sourceToTargetMatrix, primaryAxis, rotationOnlyElements );
       break;
     case vtkMRMLTransformProcessorNode::DEPENDENT_AXES_MODE_FROM_SECONDARY_AXIS:
-      this->GetRotationSingleAxisWithSecondaryFromTransform( sourceToTargetTransform, primaryAxis, secondaryAxis, rotationOnlyTransform );
+      this->GetRotationSingleAxisWithSecondaryFromTransform( sourceToTargetMatrix, primaryAxis, secondaryAxis, rotationOnlyElements );
       break;
     default:
       vtkErrorMacro( "GetRotationSingleAxisFromTransform: dependentAxesMode " << dependentAxesMode << " is unrecognized. Returning, but no operation performed." );
@@ -562,7 +1750,7 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisFromTransform( vtkGe
 // Get the orientation transform *such that* the primary axis
 // the other axes are described using the smallest pivot rotation
 // from the source
-void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithPivotFromTransform( vtkGeneralTransform* sourceToTargetTransform, const double* primaryAxis, vtkTransform* rotationOnlyTransform )
+void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithPivotFromTransform( vtkMatrix4x4* sourceToTargetMatrix, const double* primaryAxis, double* rotationOnlyElements )
 {
   // Key point: We REFER to the Target transform, then
   // rotate between it and the Source. We use an axis-angle rotation,
@@ -571,9 +1759,8 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithPivotFromTransfo
   // two axes are aligned as closely as possible.
 
   // first determine the rotated primary axis
-  double zeroVector3[ 3 ] = { 0.0, 0.0, 0.0 };
   double primaryAxisRotated[ 3 ];
-  sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, primaryAxis, primaryAxisRotated );
+  TransformVectorWithMatrix( &sourceToTargetMatrix->Element[ 0 ][ 0 ], primaryAxis, primaryAxisRotated );
 
   // compute ROTATION axis and angle between primary axes (source vs target)
   double rotationAxisSourceToTarget[ 3 ];
@@ -607,23 +1794,20 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithPivotFromTransfo
     rotationDegreesSourceToTarget = 0.0;
   }
 
-  rotationOnlyTransform->Identity();
-  rotationOnlyTransform->RotateWXYZ( rotationDegreesSourceToTarget, rotationAxisSourceToTarget );
+  SetRotationMatrixElementsFromAxisAngle( rotationDegreesSourceToTarget, rotationAxisSourceToTarget, rotationOnlyElements );
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithSecondaryFromTransform( vtkGeneralTransform* sourceToTargetTransform, const double* primaryAxis, const double* secondaryAxis, vtkTransform* rotationOnlyTransform )
+void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithSecondaryFromTransform( vtkMatrix4x4* sourceToTargetMatrix, const double* primaryAxis, const double* secondaryAxis, double* rotationOnlyElements )
 {
-  // Rotate from the sourceToTargetTransform, such that the primary axis 
+  // Rotate from the sourceToTargetMatrix, such that the primary axis 
   // remains the same, but the secondary axis is as close as possible to the target.
 
   // first determine the rotated axes
-  double zeroVector3[ 3 ] = { 0.0, 0.0, 0.0 };
-
   const double* primarySourceAxisInSource = primaryAxis;
   
   double primarySourceAxisInTarget[ 3 ];
-  sourceToTargetTransform->TransformVectorAtPoint( zeroVector3, primaryAxis, primarySourceAxisInTarget );
+  TransformVectorWithMatrix( &sourceToTargetMatrix->Element[ 0 ][ 0 ], primaryAxis, primarySourceAxisInTarget );
 
   const double* secondaryTargetAxisInTarget = secondaryAxis;
 
@@ -642,11 +1826,10 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithSecondaryFromTra
   vtkMath::Cross( tertiaryResultAxisInTarget, primarySourceAxisInTarget, secondaryResultAxisInTarget );
   vtkMath::Normalize( secondaryResultAxisInTarget );
 
-  vtkSmartPointer< vtkGeneralTransform > targetToSourceTransform = vtkSmartPointer< vtkGeneralTransform >::New();
-  targetToSourceTransform->DeepCopy( sourceToTargetTransform );
-  targetToSourceTransform->Inverse();
+  double targetToSourceElements[ 16 ];
+  vtkMatrix4x4::Invert( &sourceToTargetMatrix->Element[ 0 ][ 0 ], targetToSourceElements );
   double secondaryResultAxisInSource[ 3 ];
-  targetToSourceTransform->TransformVectorAtPoint( zeroVector3, secondaryResultAxisInTarget, secondaryResultAxisInSource );
+  TransformVectorWithMatrix( targetToSourceElements, secondaryResultAxisInTarget, secondaryResultAxisInSource );
   
   const double* secondarySourceAxisInSource = secondaryAxis;
 
@@ -684,60 +1867,29 @@ void vtkSlicerTransformProcessorLogic::GetRotationSingleAxisWithSecondaryFromTra
     rotationDegreesTargetToResult = 180 - rotationDegreesTargetToResult;
   }
 
-  vtkSmartPointer< vtkTransform > sourceToTargetRotationOnlyTransform = vtkSmartPointer< vtkTransform >::New();
-  this->GetRotationAllAxesFromTransform( sourceToTargetTransform, sourceToTargetRotationOnlyTransform );
-  
-  rotationOnlyTransform->Identity();
-  rotationOnlyTransform->PreMultiply();
-  rotationOnlyTransform->Concatenate( sourceToTargetRotationOnlyTransform );
-  rotationOnlyTransform->RotateWXYZ( rotationDegreesTargetToResult, rotationAxisTargetToResult );
+  double sourceToTargetRotationOnlyElements[ 16 ];
+  this->GetRotationAllAxesFromTransform( sourceToTargetMatrix, sourceToTargetRotationOnlyElements );
+  double targetToResultRotationElements[ 16 ];
+  SetRotationMatrixElementsFromAxisAngle( rotationDegreesTargetToResult, rotationAxisTargetToResult, targetToResultRotationElements );
+  vtkMatrix4x4::Multiply4x4( sourceToTargetRotationOnlyElements, targetToResultRotationElements, rotationOnlyElements );
 }
 
 //----------------------------------------------------------------------------
-void vtkSlicerTransformProcessorLogic::GetTranslationOnlyFromTransform( vtkGeneralTransform* sourceToTargetTransform, const bool* copyComponents, vtkTransform* translationOnlyTransform )
+void vtkSlicerTransformProcessorLogic::GetTranslationOnlyFromTransform( vtkMatrix4x4* sourceToTargetMatrix, const bool* copyComponents, double* translationOnlyElements )
 {
-  if ( translationOnlyTransform == NULL )
+  if ( translationOnlyElements == NULL )
   {
-    vtkErrorMacro( "GetTranslationOnlyFromTransform: translationOnlyTransform is null. Returning, but transform will remain null." );
+    vtkErrorMacro( "GetTranslationOnlyFromTransform: translationOnlyElements is null. Returning, no operation performed." );
     return;
   }
 
-  if ( sourceToTargetTransform == NULL )
+  if ( sourceToTargetMatrix == NULL )
   {
     vtkErrorMacro( "GetTranslationOnlyFromTransform: inputFullTransform is null. Returning, but no operation performed." );
     return;
   }
 
-  double sourceToTargetTranslation[ 3 ] = { 0.0, 0.0, 0.0 };
-  double zeroVector3[ 3 ] = { 0.0, 0.0, 0.0 };
-  sourceToTargetTransform->TransformPoint( zeroVector3, sourceToTargetTranslation );
-  
-  for ( int dimension = 0; dimension < 3; dimension++ )
-  {
-    if ( copyComponents[ dimension ] == false )
-    {
-      sourceToTargetTranslation[ dimension ] = 0.0;
-    }
-  }
-  
-  // copy to the output
-  translationOnlyTransform->Identity();
-  translationOnlyTransform->Translate( sourceToTargetTranslation );
-}
-
-//----------------------------------------------------------------------------
-void vtkSlicerTransformProcessorLogic::GetRotationMatrixFromAxes( const double* xAxis, const double* yAxis, const double* zAxis, vtkMatrix4x4* rotationMatrix )
-{
-  rotationMatrix->Identity();
-  rotationMatrix->SetElement( 0, 0, xAxis[ 0 ] );
-  rotationMatrix->SetElement( 1, 0, xAxis[ 1 ] );
-  rotationMatrix->SetElement( 2, 0, xAxis[ 2 ] );
-  rotationMatrix->SetElement( 0, 1, yAxis[ 0 ] );
-  rotationMatrix->SetElement( 1, 1, yAxis[ 1 ] );
-  rotationMatrix->SetElement( 2, 1, yAxis[ 2 ] );
-  rotationMatrix->SetElement( 0, 2, zAxis[ 0 ] );
-  rotationMatrix->SetElement( 1, 2, zAxis[ 1 ] );
-  rotationMatrix->SetElement( 2, 2, zAxis[ 2 ] );
+  SetTranslationMatrixElements( &sourceToTargetMatrix->Element[ 0 ][ 0 ], copyComponents, translationOnlyElements );
 }
 
 //----------------------------------------------------------------------------
@@ -828,6 +1980,18 @@ bool vtkSlicerTransformProcessorLogic::IsTransformProcessingPossible( vtkMRMLTra
     }
   }
 
+  if ( mode == vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING )
+  {
+    if ( node->GetInputFromTransformNode() == NULL )
+    {
+      if ( verbose )
+      {
+        vtkWarningMacro( "IsTransformProcessingPossible: No \"From\" node provided for processing mode " << vtkMRMLTransformProcessorNode::GetProcessingModeAsString( mode ) );
+      }
+      result = false;
+    }
+  }
+
   if ( mode == vtkMRMLTransformProcessorNode::PROCESSING_MODE_QUATERNION_AVERAGE )
   {
     if ( node->GetNumberOfInputCombineTransformNodes() < 2 )
@@ -38,18 +38,27 @@
 
 class vtkMRMLTransformProcessorNode;
 class vtkMRMLLinearTransformNode;
+class vtkMRMLTransformNode;
+class vtkMatrix4x4;
+class vtkCollection;
+class vtkDoubleArray;
 
 
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
 
 // vtk includes
 #include "vtkGeneralTransform.h"
-#include "vtkTransform.h"
+#include "vtkMultiThreader.h"
 #include "vtkSmartPointer.h"
 
 #include "vtkSlicerTransformProcessorModuleLogicExport.h"
 
+class vtkPerformanceCounters;
+
 
 /// \ingroup Slicer_QtModules_TransformProcessor
 class VTK_SLICER_TRANSFORMPROCESSOR_MODULE_LOGIC_EXPORT vtkSlicerTransformProcessorLogic :
@@ -69,7 +78,45 @@ public:
   void ComputeTranslation( vtkMRMLTransformProcessorNode* );
   void ComputeFullTransform( vtkMRMLTransformProcessorNode* );
   void ComputeInverseTransform( vtkMRMLTransformProcessorNode* );
+  void ComputeTemporalSmoothing( vtkMRMLTransformProcessorNode* );
+  /// Discard the samples collected so far by the temporal smoothing mode
+  void ResetTemporalSmoothing( vtkMRMLTransformProcessorNode* );
   bool IsTransformProcessingPossible( vtkMRMLTransformProcessorNode*, bool verbose = false );
+
+  /// Apply the processing configured in the node to a recorded sequence of poses, without using the scene.
+  /// Only the processing parameters of the node are used, its input and output transform nodes are not accessed.
+  /// Poses are stored in vtkDoubleArray, one tuple per frame, each tuple is a 4x4 matrix as 16 row-major values.
+  /// Input pose arrays are expected in the order of the inputs of the processing mode:
+  ///   quaternion average: the combine transforms (at least 2)
+  ///   rotation, translation, full transform: From, To
+  ///   shaft pivot: Changed, Initial, Anchor
+  ///   inverse: Forward
+  ///   temporal smoothing: From (each frame is a new sample)
+  /// Inputs that are related to each other (From and To, shaft pivot inputs) must be given in a common
+  /// coordinate system, e.g. as transforms to world.
+  /// Frames are processed in parallel. Returns false if the input poses do not match the processing mode.
+  bool ProcessPoseSequence( vtkMRMLTransformProcessorNode* paramNode, vtkCollection* inputPoseArrays, vtkDoubleArray* outputPoses );
+
+  /// Weighted average of numberOfPoses poses, stored contiguously as 4x4 matrices (16 row-major values per pose).
+  /// The rotation is the quaternion average of Markley et al.: the eigenvector of the largest eigenvalue of the
+  /// weighted sum of quaternion outer products, which does not depend on the quaternion signs and remains
+  /// correct for large angular spread. The translation is the weighted mean.
+  /// If weights is NULL then all poses have the same weight. Does not allocate memory, so it can be used for each update.
+  /// Returns false if the poses have no positive weight or the average cannot be computed.
+  static bool ComputeWeightedAveragePose( const double* poses, const double* weights, int numberOfPoses, double* averagePose );
+
+  /// In auto-update mode input changes only mark the node as pending, and all pending nodes
+  /// are evaluated together when ProcessPendingUpdates() is called, regardless of UpdatesPerSecond.
+  /// If UpdatesPerSecond is positive then the output of a node is updated at most that many times
+  /// per second, changes that arrive sooner are coalesced into the next update.
+  /// The logic is modified when HasPendingUpdates() changes.
+  /// Pending updates are processed in the processor stage of the shared tracking tick
+  /// (see vtkSlicerTrackingTickLogic), before the logics that use the output transforms.
+  void ProcessPendingUpdates();
+  bool HasPendingUpdates();
+
+  /// Number of received input events, computed and coalesced output updates, and the time spent in the updates
+  vtkPerformanceCounters* GetPerformanceCounters();
   
 protected:
   vtkSlicerTransformProcessorLogic();
@@ -79,20 +126,113 @@ protected:
   virtual void SetMRMLSceneInternal( vtkMRMLScene * newScene );
   virtual void OnMRMLSceneNodeAdded( vtkMRMLNode* node );
   virtual void OnMRMLSceneNodeRemoved( vtkMRMLNode* node );
+  /// Module nodes added during batch processing (e.g., scene import) are set up here, in a single pass
+  virtual void OnMRMLSceneEndBatchProcess();
+  void InitializeModuleNode( vtkMRMLTransformProcessorNode* pNode );
   void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );;
+  void ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void* callData );
   
 private:
   vtkSlicerTransformProcessorLogic( const vtkSlicerTransformProcessorLogic& );// Not implemented
   void operator=( const vtkSlicerTransformProcessorLogic& );// Not implemented
   
   // these helper functions should only be used by processing modes themselves, and are therefore private
-  void GetRotationOnlyFromTransform( vtkGeneralTransform*, int, int, const double*, const double*, vtkTransform* );
-  void GetRotationAllAxesFromTransform ( vtkGeneralTransform*, vtkTransform* );
-  void GetRotationSingleAxisFromTransform( vtkGeneralTransform*, int, const double*, const double*, vtkTransform* );
-  void GetRotationSingleAxisWithPivotFromTransform( vtkGeneralTransform*, const double*, vtkTransform* );
-  void GetRotationSingleAxisWithSecondaryFromTransform( vtkGeneralTransform*, const double*, const double*, vtkTransform* );
-  void GetTranslationOnlyFromTransform( vtkGeneralTransform*, const bool*, vtkTransform* );
-  void GetRotationMatrixFromAxes( const double*, const double*, const double*, vtkMatrix4x4* );
+  vtkMatrix4x4* GetMatrixBetweenNodes( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode );
+  // results are written to 16 row-major matrix elements (same layout as vtkMatrix4x4::Element)
+  void GetRotationOnlyFromTransform( vtkMatrix4x4*, int, int, const double*, const double*, double* );
+  void GetRotationAllAxesFromTransform ( vtkMatrix4x4*, double* );
+  void GetRotationSingleAxisFromTransform( vtkMatrix4x4*, int, const double*, const double*, double* );
+  void GetRotationSingleAxisWithPivotFromTransform( vtkMatrix4x4*, const double*, double* );
+  void GetRotationSingleAxisWithSecondaryFromTransform( vtkMatrix4x4*, const double*, const double*, double* );
+  void GetTranslationOnlyFromTransform( vtkMatrix4x4*, const bool*, double* );
+
+  // Parameters of ProcessPoseSequence, shared by the threads. Each thread processes a range of frames.
+  struct PoseSequenceJob
+  {
+    vtkSlicerTransformProcessorLogic* Self;
+    int ProcessingMode;
+    int RotationMode;
+    int DependentAxesMode;
+    double PrimaryAxis[ 3 ];
+    double SecondaryAxis[ 3 ];
+    bool CopyTranslationComponents[ 3 ];
+    int SmoothingWindowSize;
+    std::vector< double > CombineWeights; // weight of each input in quaternion average mode
+    std::vector< const double* > InputPoses; // 16 values per frame for each input
+    double* OutputPoses;
+    vtkIdType NumberOfFrames;
+  };
+  static VTK_THREAD_RETURN_TYPE ProcessPoseSequenceThreadFunction( void* arg );
+  void ProcessPoseSequenceFrames( PoseSequenceJob& job, vtkIdType firstFrame, vtkIdType lastFrame );
+
+  /// Mark the node as pending, it is evaluated in the next ProcessPendingUpdates() call
+  void RequestOutputTransformUpdate( vtkMRMLTransformProcessorNode* );
+
+  /// Update the nodes and all auto-update nodes downstream of them, each exactly once, in dependency order
+  void UpdateOutputTransformsWithDependents( const std::set< vtkMRMLTransformProcessorNode* >& dirtyNodes );
+  bool IsProcessorNodeDependentOn( vtkMRMLTransformProcessorNode* node, vtkMRMLTransformProcessorNode* otherNode );
+
+  /// Dependency order and direct dependents of all processor nodes. They are computed only when
+  /// the processor nodes, their references or the transform hierarchy above their inputs change.
+  void UpdateProcessorNodeOrder();
+  bool IsProcessorNodeOrderValid();
+
+  std::map< vtkMRMLTransformProcessorNode*, double > LastUpdateTimeSec;
+  std::set< vtkMRMLTransformProcessorNode* > PendingUpdateNodes;
+  std::set< vtkMRMLTransformProcessorNode* > ProcessorNodes; // all processor nodes in the scene
+  std::set< vtkMRMLTransformProcessorNode* > ScheduledNodes; // nodes in the batch that is being updated
+
+  bool ProcessorNodeOrderModified; // set when processor nodes are added or removed or their references change
+  std::map< vtkMRMLTransformProcessorNode*, int > ProcessorNodeOrder; // index of each node in dependency order
+  std::map< vtkMRMLTransformProcessorNode*, std::vector< vtkMRMLTransformProcessorNode* > > ProcessorNodeDependents;
+  // input transforms of all processor nodes and their parents at the time the order was computed, each chain ended by NULL
+  std::vector< vtkMRMLTransformNode* > ProcessorNodeOrderInputHierarchy;
+
+  // Samples of the input stream used by the temporal smoothing mode.
+  // Samples are stored in a ring buffer and the running sums are updated
+  // by adding the newest and subtracting the oldest sample, so each update is O(1).
+  struct TemporalSmoothingState
+  {
+    std::string InputNodeID;
+    unsigned long LastInputMTime;
+    int NumberOfSamples;
+    int OldestSampleIndex;
+    std::vector< double > Quaternions; // 4 values per sample, signs aligned with the running sum
+    std::vector< double > Translations; // 3 values per sample
+    double QuaternionSum[ 4 ];
+    double TranslationSum[ 3 ];
+  };
+  void InitializeTemporalSmoothingState( TemporalSmoothingState&, const std::string& inputNodeID, int windowSize );
+
+  std::map< vtkMRMLTransformProcessorNode*, TemporalSmoothingState > TemporalSmoothingStates;
+  vtkSmartPointer< vtkMatrix4x4 > TemporalSmoothingMatrix;
+
+  // Path between two nodes in the transform hierarchy. Nodes are listed from the
+  // source (or target) up to, but not including, the closest common ancestor.
+  struct TransformPath
+  {
+    std::vector< vtkMRMLTransformNode* > SourceToCommonAncestorNodes;
+    std::vector< vtkMRMLTransformNode* > TargetToCommonAncestorNodes;
+    vtkMRMLTransformNode* CommonAncestorNode; // NULL if the common ancestor is the world
+    std::vector< unsigned long > NodeMTimes; // source nodes followed by target nodes, at the last evaluation
+    bool Evaluated;
+    vtkSmartPointer< vtkMatrix4x4 > SourceToTargetMatrix;
+  };
+  typedef std::pair< vtkMRMLTransformNode*, vtkMRMLTransformNode* > TransformPathKey;
+  void ResolveTransformPath( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, TransformPath& );
+  bool IsTransformPathValid( vtkMRMLTransformNode* sourceNode, vtkMRMLTransformNode* targetNode, const TransformPath& );
+
+  std::map< TransformPathKey, TransformPath > TransformPaths;
+  vtkSmartPointer< vtkMatrix4x4 > TransformPathNodeMatrix;
+
+  // reused by the processing modes, so that an update does not allocate matrices
+  vtkSmartPointer< vtkMatrix4x4 > InputMatrix;
+  vtkSmartPointer< vtkMatrix4x4 > OutputMatrix;
+  // poses (16 values each) and weights of the combine transforms, reused by the quaternion average mode
+  std::vector< double > CombinePoses;
+  std::vector< double > CombineWeights;
+
+  vtkSmartPointer< vtkPerformanceCounters > PerformanceCounters;
 
 };
 
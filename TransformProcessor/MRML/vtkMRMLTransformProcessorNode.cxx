@@ -75,6 +75,7 @@ vtkMRMLTransformProcessorNode::vtkMRMLTransformProcessorNode()
   this->PrimaryAxisLabel = AXIS_LABEL_Z;
   this->DependentAxesMode = DEPENDENT_AXES_MODE_FROM_PIVOT;
   this->SecondaryAxisLabel = AXIS_LABEL_Y;
+  this->SmoothingWindowSize = 10;
 }
 
 //----------------------------------------------------------------------------
@@ -194,6 +195,32 @@ void vtkMRMLTransformProcessorNode::ReadXMLAttributes( const char** atts )
       bool isTrue = !strcmp( attValue, "true" );
       this->SetCopyTranslationZ( isTrue );
     }
+    else if ( strcmp( attName, "SmoothingWindowSize" ) == 0 )
+    {
+      std::stringstream ss;
+      ss << attValue;
+      int windowSize = 0;
+      ss >> windowSize;
+      if ( windowSize >= 1 )
+      {
+        this->SmoothingWindowSize = windowSize;
+      }
+      else
+      {
+        vtkWarningMacro("Invalid smoothing window size read from MRML node: " << attValue << ". Keeping " << this->SmoothingWindowSize << ".")
+      }
+    }
+    else if ( strcmp( attName, "InputCombineTransformWeights" ) == 0 )
+    {
+      this->InputCombineTransformWeights.clear();
+      std::stringstream ss;
+      ss << attValue;
+      double weight = 1.0;
+      while ( ss >> weight )
+      {
+        this->InputCombineTransformWeights.push_back( weight >= 0.0 ? weight : 1.0 );
+      }
+    }
   }
 
   this->Modified();
@@ -214,6 +241,16 @@ void vtkMRMLTransformProcessorNode::WriteXML( ostream& of, int nIndent )
   of << indent << " CopyTranslationX=\"" << ( this->CopyTranslationComponents[ 0 ] ? "true" : "false" ) << "\"";
   of << indent << " CopyTranslationY=\"" << ( this->CopyTranslationComponents[ 1 ] ? "true" : "false" ) << "\"";
   of << indent << " CopyTranslationZ=\"" << ( this->CopyTranslationComponents[ 2 ] ? "true" : "false" ) << "\"";
+  of << indent << " SmoothingWindowSize=\"" << this->SmoothingWindowSize << "\"";
+  if ( !this->InputCombineTransformWeights.empty() )
+  {
+    of << indent << " InputCombineTransformWeights=\"";
+    for ( size_t i = 0; i < this->InputCombineTransformWeights.size(); i++ )
+    {
+      of << ( i > 0 ? " " : "" ) << this->InputCombineTransformWeights[ i ];
+    }
+    of << "\"";
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -230,6 +267,13 @@ void vtkMRMLTransformProcessorNode::PrintSelf( ostream& os, vtkIndent indent )
   os << indent << " CopyTranslationX = " << ( this->CopyTranslationComponents[ 0 ] ? "true" : "false" ) << "\n";
   os << indent << " CopyTranslationY = " << ( this->CopyTranslationComponents[ 1 ] ? "true" : "false" ) << "\n";
   os << indent << " CopyTranslationZ = " << ( this->CopyTranslationComponents[ 2 ] ? "true" : "false" ) << "\n";
+  os << indent << " SmoothingWindowSize = " << this->SmoothingWindowSize << "\n";
+  os << indent << " InputCombineTransformWeights =";
+  for ( int i = 0; i < this->GetNumberOfInputCombineTransformNodes(); i++ )
+  {
+    os << " " << this->GetNthInputCombineTransformWeight( i );
+  }
+  os << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -249,6 +293,8 @@ void vtkMRMLTransformProcessorNode::Copy( vtkMRMLNode *anode )
   this->CopyTranslationComponents[0] = node->CopyTranslationComponents[0];
   this->CopyTranslationComponents[1] = node->CopyTranslationComponents[1];
   this->CopyTranslationComponents[2] = node->CopyTranslationComponents[2];
+  this->SmoothingWindowSize = node->SmoothingWindowSize;
+  this->InputCombineTransformWeights = node->InputCombineTransformWeights;
 
   node->EndModify( wasModifying );
 }
@@ -477,6 +523,25 @@ void vtkMRMLTransformProcessorNode::SetSecondaryAxisLabel( int newAxisLabel )
   this->InvokeCustomModifiedEvent( InputDataModifiedEvent );
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLTransformProcessorNode::SetSmoothingWindowSize( int newWindowSize )
+{
+  if ( newWindowSize < 1 )
+  {
+    vtkWarningMacro( "Input smoothing window size " << newWindowSize << " is not valid, it must be at least 1. No change will be done." )
+    return;
+  }
+
+  if ( this->SmoothingWindowSize == newWindowSize )
+  {
+    // no change
+    return;
+  }
+  this->SmoothingWindowSize = newWindowSize;
+  this->Modified();
+  this->InvokeCustomModifiedEvent( InputDataModifiedEvent );
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLTransformProcessorNode::CheckAndCorrectForDuplicateAxes()
 {
@@ -596,6 +661,11 @@ void vtkMRMLTransformProcessorNode::AddAndObserveInputCombineTransformNode( vtkM
 //----------------------------------------------------------------------------
 void vtkMRMLTransformProcessorNode::RemoveNthInputCombineTransformNode( int n )
 {
+  // keep the weights of the remaining inputs
+  if ( n >= 0 && n < (int)this->InputCombineTransformWeights.size() && n < this->GetNumberOfInputCombineTransformNodes() )
+  {
+    this->InputCombineTransformWeights.erase( this->InputCombineTransformWeights.begin() + n );
+  }
   this->RemoveNthTransformNodeInRole( ROLE_INPUT_COMBINE_TRANSFORM, n );
 }
 
@@ -605,6 +675,38 @@ int vtkMRMLTransformProcessorNode::GetNumberOfInputCombineTransformNodes()
   return this->GetNumberOfTransformNodesInRole( ROLE_INPUT_COMBINE_TRANSFORM );
 }
 
+//----------------------------------------------------------------------------
+double vtkMRMLTransformProcessorNode::GetNthInputCombineTransformWeight( int n )
+{
+  if ( n < 0 || n >= (int)this->InputCombineTransformWeights.size() )
+  {
+    return 1.0;
+  }
+  return this->InputCombineTransformWeights[ n ];
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformProcessorNode::SetNthInputCombineTransformWeight( int n, double weight )
+{
+  if ( n < 0 || weight < 0.0 )
+  {
+    vtkWarningMacro( "Invalid combine transform weight " << weight << " at index " << n << ". No change will be done." )
+    return;
+  }
+  if ( this->GetNthInputCombineTransformWeight( n ) == weight )
+  {
+    // no change
+    return;
+  }
+  if ( n >= (int)this->InputCombineTransformWeights.size() )
+  {
+    this->InputCombineTransformWeights.resize( n + 1, 1.0 );
+  }
+  this->InputCombineTransformWeights[ n ] = weight;
+  this->Modified();
+  this->InvokeCustomModifiedEvent( InputDataModifiedEvent );
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLLinearTransformNode* vtkMRMLTransformProcessorNode::GetInputFromTransformNode()
 {
@@ -706,6 +808,8 @@ std::string vtkMRMLTransformProcessorNode::GetProcessingModeAsString( int mode )
     return "Compute Full Transform";
   case PROCESSING_MODE_COMPUTE_INVERSE:
     return "Compute Inverse";
+  case PROCESSING_MODE_TEMPORAL_SMOOTHING:
+    return "Temporal Smoothing";
   default:
     vtkGenericWarningMacro("Unknown processing mode provided as input to GetProcessingModeAsString: " << mode << ". Returning \"Unknown Processing Mode\"");
     return "Unknown Processing Mode";
@@ -29,6 +29,8 @@
 #include <vtkMRMLNode.h>
 #include <vtkMRMLLinearTransformNode.h>
 
+#include <vector>
+
 #include "vtkSlicerTransformProcessorModuleMRMLExport.h"
 
 /// \ingroup Slicer_QtModules_TransformProcessor
@@ -63,6 +65,7 @@ public:
     PROCESSING_MODE_COMPUTE_TRANSLATION,
     PROCESSING_MODE_COMPUTE_FULL_TRANSFORM,
     PROCESSING_MODE_COMPUTE_INVERSE,
+    PROCESSING_MODE_TEMPORAL_SMOOTHING,
     PROCESSING_MODE_LAST // do not set to this type, insert valid types above this line
   };
 
@@ -103,6 +106,10 @@ public:
   void AddAndObserveInputCombineTransformNode( vtkMRMLLinearTransformNode* node );
   void RemoveNthInputCombineTransformNode( int n );
   int GetNumberOfInputCombineTransformNodes();
+  /// Weight of the n-th combine transform in the quaternion average (default: 1.0).
+  /// Negative weights are not allowed.
+  double GetNthInputCombineTransformWeight( int n );
+  void SetNthInputCombineTransformWeight( int n, double weight );
 
   vtkMRMLLinearTransformNode* GetInputFromTransformNode();
   void SetAndObserveInputFromTransformNode( vtkMRMLLinearTransformNode* node );
@@ -163,6 +170,10 @@ public:
 
   void CheckAndCorrectForDuplicateAxes();
 
+  /// Number of most recent samples of the 'From' transform that are averaged in temporal smoothing mode
+  vtkGetMacro( SmoothingWindowSize, int );
+  void SetSmoothingWindowSize( int );
+
   static std::string GetProcessingModeAsString( int );
   static int GetProcessingModeFromString( std::string );
 
@@ -206,6 +217,9 @@ protected:
   int  DependentAxesMode;
   int  PrimaryAxisLabel;
   int  SecondaryAxisLabel;
+  int  SmoothingWindowSize;
+  // Weights of the combine transforms, in the same order. Missing values are 1.0.
+  std::vector< double > InputCombineTransformWeights;
 };
 
 #endif
@@ -0,0 +1,185 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Checks the weighted quaternion average of vtkSlicerTransformProcessorLogic::ComputeWeightedAveragePose
+// against averages that are known in closed form:
+// - two rotations about the same axis: the average rotation angle is atan2( w2 * sin( a ), w1 + w2 * cos( a ) ),
+//   where a is the angle between the rotations and w1, w2 are the weights
+// - rotations of +170 and -170 degrees, whose quaternions computed from the matrices have opposite signs
+//   (averaging the quaternions without sign alignment would give the identity)
+// - many poses (more than one block of the computation) in symmetric pairs around a known pose
+// - translation is the weighted mean, negative weights are ignored, zero total weight is an error
+
+// TransformProcessor includes
+#include "vtkSlicerTransformProcessorLogic.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const double COMPARISON_TOLERANCE = 1e-9;
+
+//----------------------------------------------------------------------------
+// Append the 16 elements of the transform matrix to the poses
+void AppendPose( vtkTransform* transform, std::vector< double >& poses )
+{
+  vtkMatrix4x4* matrix = transform->GetMatrix();
+  poses.insert( poses.end(), &matrix->Element[ 0 ][ 0 ], &matrix->Element[ 0 ][ 0 ] + 16 );
+}
+
+//----------------------------------------------------------------------------
+bool CheckAveragePose( const std::vector< double >& poses, const double* weights, vtkTransform* expectedTransform, const char* description )
+{
+  double averagePose[ 16 ];
+  int numberOfPoses = static_cast< int >( poses.size() / 16 );
+  if ( !vtkSlicerTransformProcessorLogic::ComputeWeightedAveragePose( &poses[ 0 ], weights, numberOfPoses, averagePose ) )
+  {
+    std::cerr << description << ": average pose computation failed" << std::endl;
+    return false;
+  }
+  vtkMatrix4x4* expectedMatrix = expectedTransform->GetMatrix();
+  for ( int i = 0; i < 4; i++ )
+  {
+    for ( int j = 0; j < 4; j++ )
+    {
+      if ( fabs( averagePose[ 4 * i + j ] - expectedMatrix->GetElement( i, j ) ) > COMPARISON_TOLERANCE )
+      {
+        std::cerr << description << ": average pose element (" << i << ", " << j << ") is " << averagePose[ 4 * i + j ]
+          << ", expected " << expectedMatrix->GetElement( i, j ) << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Average of two rotations about the same axis, with translations
+bool CheckTwoRotations( double angleDeg, double weight1, double weight2, const char* description )
+{
+  const double axis[ 3 ] = { 1.0, -2.0, 0.5 };
+  const double translation1[ 3 ] = { 10.0, 20.0, -30.0 };
+  const double translation2[ 3 ] = { -6.0, 4.0, 2.0 };
+  std::vector< double > poses;
+  vtkNew<vtkTransform> transform;
+  transform->Translate( translation1 );
+  AppendPose( transform.GetPointer(), poses );
+  transform->Identity();
+  transform->Translate( translation2 );
+  transform->RotateWXYZ( angleDeg, axis );
+  AppendPose( transform.GetPointer(), poses );
+
+  const double weights[ 2 ] = { weight1, weight2 };
+  double angleRad = vtkMath::RadiansFromDegrees( angleDeg );
+  double averageAngleDeg = vtkMath::DegreesFromRadians( atan2( weight2 * sin( angleRad ), weight1 + weight2 * cos( angleRad ) ) );
+  vtkNew<vtkTransform> expectedTransform;
+  double weightSum = weight1 + weight2;
+  expectedTransform->Translate( ( weight1 * translation1[ 0 ] + weight2 * translation2[ 0 ] ) / weightSum,
+    ( weight1 * translation1[ 1 ] + weight2 * translation2[ 1 ] ) / weightSum,
+    ( weight1 * translation1[ 2 ] + weight2 * translation2[ 2 ] ) / weightSum );
+  expectedTransform->RotateWXYZ( averageAngleDeg, axis );
+  return CheckAveragePose( poses, weights, expectedTransform.GetPointer(), description );
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerTransformProcessorQuaternionAverageTest( int vtkNotUsed(argc), char* vtkNotUsed(argv)[] )
+{
+  bool success = true;
+
+  // Two rotations with equal and with different weights
+  success &= CheckTwoRotations( 90.0, 1.0, 1.0, "Equal weights" );
+  success &= CheckTwoRotations( 90.0, 3.0, 1.0, "Weights 3:1" );
+  success &= CheckTwoRotations( 120.0, 2.0, 1.0, "Weights 2:1" );
+  success &= CheckTwoRotations( 60.0, 0.0, 1.0, "Zero weight" );
+
+  // Result does not depend on the quaternion signs: the average of +170 and -170 degrees is 180 degrees
+  std::vector< double > poses;
+  vtkNew<vtkTransform> transform;
+  transform->RotateZ( 170.0 );
+  AppendPose( transform.GetPointer(), poses );
+  transform->Identity();
+  transform->RotateZ( -170.0 );
+  AppendPose( transform.GetPointer(), poses );
+  vtkNew<vtkTransform> expectedTransform;
+  expectedTransform->RotateZ( 180.0 );
+  success &= CheckAveragePose( poses, NULL, expectedTransform.GetPointer(), "Rotations of +170 and -170 degrees" );
+
+  // Negative weights are ignored
+  const double negativeWeights[ 2 ] = { 1.0, -1.0 };
+  transform->Identity();
+  transform->RotateZ( 170.0 );
+  success &= CheckAveragePose( poses, negativeWeights, transform.GetPointer(), "Negative weight" );
+
+  // Pairs of poses rotated by the same angle in opposite directions from a known pose average to the known pose,
+  // the number of poses is more than a block of the computation and not a multiple of the block size
+  const int numberOfPairs = 100;
+  expectedTransform->Identity();
+  expectedTransform->Translate( 5.0, -15.0, 25.0 );
+  expectedTransform->RotateWXYZ( 35.0, 0.3, 0.4, -0.5 );
+  poses.clear();
+  std::vector< double > weights;
+  vtkMath::RandomSeed( 42 );
+  for ( int pairIndex = 0; pairIndex < numberOfPairs; pairIndex++ )
+  {
+    double axis[ 3 ] = { vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ), vtkMath::Random( -1.0, 1.0 ) };
+    double angleDeg = vtkMath::Random( 1.0, 60.0 );
+    double offset[ 3 ] = { vtkMath::Random( -5.0, 5.0 ), vtkMath::Random( -5.0, 5.0 ), vtkMath::Random( -5.0, 5.0 ) };
+    double weight = vtkMath::Random( 0.5, 2.0 );
+    for ( int direction = -1; direction <= 1; direction += 2 )
+    {
+      transform->Identity();
+      transform->Translate( direction * offset[ 0 ], direction * offset[ 1 ], direction * offset[ 2 ] );
+      transform->Concatenate( expectedTransform->GetMatrix() );
+      transform->RotateWXYZ( direction * angleDeg, axis );
+      AppendPose( transform.GetPointer(), poses );
+      weights.push_back( weight );
+    }
+  }
+  AppendPose( expectedTransform.GetPointer(), poses );
+  weights.push_back( 1.0 );
+  success &= CheckAveragePose( poses, &weights[ 0 ], expectedTransform.GetPointer(), "Symmetric poses" );
+
+  // Average is undefined if no pose has a positive weight
+  std::fill( weights.begin(), weights.end(), 0.0 );
+  double averagePose[ 16 ];
+  if ( vtkSlicerTransformProcessorLogic::ComputeWeightedAveragePose( &poses[ 0 ], &weights[ 0 ], static_cast< int >( weights.size() ), averagePose ) )
+  {
+    std::cerr << "Average pose computation succeeded with zero weights" << std::endl;
+    success = false;
+  }
+
+  if ( !success )
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "Weighted quaternion averages match the expected poses" << std::endl;
+  return EXIT_SUCCESS;
+}
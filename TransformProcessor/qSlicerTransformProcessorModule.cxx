@@ -16,10 +16,12 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QTimer>
 #include <QtPlugin>
 
 // TransformProcessor Logic includes
 #include <vtkSlicerTransformProcessorLogic.h>
+#include <vtkSlicerTrackingTickLogic.h>
 
 // TransformProcessor includes
 #include "qSlicerTransformProcessorModule.h"
@@ -37,6 +39,9 @@ class qSlicerTransformProcessorModulePrivate
 {
 public:
   qSlicerTransformProcessorModulePrivate();
+
+  vtkSlicerTransformProcessorLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
+  QTimer ProcessPendingUpdatesTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -44,6 +49,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerTransformProcessorModulePrivate::qSlicerTransformProcessorModulePrivate()
+: ObservedLogic(NULL)
 {
 }
 
@@ -66,6 +72,10 @@ QStringList qSlicerTransformProcessorModule::categories()const
 //-----------------------------------------------------------------------------
 qSlicerTransformProcessorModule::~qSlicerTransformProcessorModule()
 {
+  Q_D(qSlicerTransformProcessorModule);
+  disconnect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -99,7 +109,16 @@ QIcon qSlicerTransformProcessorModule::icon()const
 //-----------------------------------------------------------------------------
 void qSlicerTransformProcessorModule::setup()
 {
+  Q_D(qSlicerTransformProcessorModule);
   this->Superclass::setup();
+
+  vtkSlicerTransformProcessorLogic* moduleLogic = vtkSlicerTransformProcessorLogic::SafeDownCast(logic());
+  this->qvtkReconnect(d->ObservedLogic, moduleLogic, vtkCommand::ModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = moduleLogic;
+
+  // Rate-limited auto-updates that were postponed by the logic are performed on the main thread
+  d->ProcessPendingUpdatesTimer.setInterval(5);
+  connect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
 }
 
 //-----------------------------------------------------------------------------
@@ -113,3 +132,30 @@ vtkMRMLAbstractLogic* qSlicerTransformProcessorModule::createLogic()
 {
   return vtkSlicerTransformProcessorLogic::New();
 }
+
+//------------------------------------------------------------------------------
+void qSlicerTransformProcessorModule::updatePendingUpdatesProcessing()
+{
+  Q_D(qSlicerTransformProcessorModule);
+  bool pendingUpdates = (d->ObservedLogic!=NULL && d->ObservedLogic->HasPendingUpdates());
+  if (pendingUpdates && !d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.start();
+  }
+  else if (!pendingUpdates && d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.stop();
+  }
+}
+
+//------------------------------------------------------------------------------
+void qSlicerTransformProcessorModule::processPendingUpdates()
+{
+  Q_D(qSlicerTransformProcessorModule);
+  if (d->ObservedLogic==NULL)
+  {
+    return;
+  }
+  // Pending updates of all tracking logics are processed together, in dependency order
+  vtkSlicerTrackingTickLogic::GetInstance()->ProcessTick();
+}
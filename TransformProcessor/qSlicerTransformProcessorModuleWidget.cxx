@@ -103,6 +103,8 @@ void qSlicerTransformProcessorModuleWidget::setup()
   d->processingModeComboBox->setItemData( 4, "Compute the inverse of transform to parent, and store it in another node.", Qt::ToolTipRole );
   d->processingModeComboBox->addItem( vtkMRMLTransformProcessorNode::GetProcessingModeAsString( vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_SHAFT_PIVOT ).c_str() );
   d->processingModeComboBox->setItemData( 5, "Compute a constrained version of an Source transform, the translation and z direction are preserved but the other axes resemble the Target coordinate system.", Qt::ToolTipRole );
+  d->processingModeComboBox->addItem( vtkMRMLTransformProcessorNode::GetProcessingModeAsString( vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING ).c_str() );
+  d->processingModeComboBox->setItemData( 6, "Compute the average of the most recent samples of the From transform to reduce jitter.", Qt::ToolTipRole );
 
   d->advancedRotationModeComboBox->addItem( vtkMRMLTransformProcessorNode::GetRotationModeAsString( vtkMRMLTransformProcessorNode::ROTATION_MODE_COPY_ALL_AXES ).c_str() );
   d->advancedRotationModeComboBox->addItem( vtkMRMLTransformProcessorNode::GetRotationModeAsString( vtkMRMLTransformProcessorNode::ROTATION_MODE_COPY_SINGLE_AXIS ).c_str() );
@@ -144,6 +146,8 @@ void qSlicerTransformProcessorModuleWidget::setup()
   connect( d->advancedTranslationCopyYCheckbox, SIGNAL( clicked() ), this, SLOT( onCopyTranslationChanged( ) ) );
   connect( d->advancedTranslationCopyZCheckbox, SIGNAL( clicked() ), this, SLOT( onCopyTranslationChanged( ) ) );
 
+  connect( d->smoothingWindowSizeSpinBox, SIGNAL( valueChanged( int ) ), this, SLOT( onSmoothingWindowSizeChanged( int ) ) );
+
   connect( d->updateButton, SIGNAL( clicked() ), this, SLOT( onUpdateButtonPressed() ) );
   connect( d->updateButton, SIGNAL( checkBoxToggled( bool ) ), this, SLOT( onUpdateButtonCheckboxToggled( bool ) ) );
 }
@@ -206,6 +210,7 @@ void qSlicerTransformProcessorModuleWidget::setSignalsBlocked( bool newBlock )
   d->advancedTranslationCopyXCheckbox->blockSignals( newBlock );
   d->advancedTranslationCopyYCheckbox->blockSignals( newBlock );
   d->advancedTranslationCopyZCheckbox->blockSignals( newBlock );
+  d->smoothingWindowSizeSpinBox->blockSignals( newBlock );
   d->updateButton->blockSignals( newBlock );
 }
 
@@ -232,6 +237,7 @@ bool qSlicerTransformProcessorModuleWidget::getSignalsBlocked()
        parameterNodeBlocked == d->advancedTranslationCopyXCheckbox->signalsBlocked() &&
        parameterNodeBlocked == d->advancedTranslationCopyYCheckbox->signalsBlocked() &&
        parameterNodeBlocked == d->advancedTranslationCopyZCheckbox->signalsBlocked() &&
+       parameterNodeBlocked == d->smoothingWindowSizeSpinBox->signalsBlocked() &&
        parameterNodeBlocked == d->updateButton->signalsBlocked() )
   {
     return parameterNodeBlocked;
@@ -277,6 +283,8 @@ void qSlicerTransformProcessorModuleWidget::updateGUIFromMRML()
   d->advancedTranslationCopyYCheckbox->setChecked( pNode->GetCopyTranslationY() );
   d->advancedTranslationCopyZCheckbox->setChecked( pNode->GetCopyTranslationZ() );
 
+  d->smoothingWindowSizeSpinBox->setValue( pNode->GetSmoothingWindowSize() );
+
   int processingComboBoxIndex = d->processingModeComboBox->findText( QString( vtkMRMLTransformProcessorNode::GetProcessingModeAsString( pNode->GetProcessingMode() ).c_str() ) );
   if ( processingComboBoxIndex < 0 )
   {
@@ -320,8 +328,10 @@ void qSlicerTransformProcessorModuleWidget::updateGUIFromMRML()
   bool showFromToTransform = ( pNode->GetProcessingMode() == vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_ROTATION ||
                                pNode->GetProcessingMode() == vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_TRANSLATION ||
                                pNode->GetProcessingMode() == vtkMRMLTransformProcessorNode::PROCESSING_MODE_COMPUTE_FULL_TRANSFORM );
-  d->inputFromTransformLabel->setVisible( showFromToTransform );
-  d->inputFromTransformComboBox->setVisible( showFromToTransform );
+  bool showFromTransform = ( showFromToTransform ||
+                             pNode->GetProcessingMode() == vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING );
+  d->inputFromTransformLabel->setVisible( showFromTransform );
+  d->inputFromTransformComboBox->setVisible( showFromTransform );
   d->inputToTransformLabel->setVisible( showFromToTransform );
   d->inputToTransformComboBox->setVisible( showFromToTransform );
 
@@ -359,6 +369,10 @@ void qSlicerTransformProcessorModuleWidget::updateGUIFromMRML()
   d->inputForwardTransformLabel->setVisible( showForwardTransform );
   d->inputForwardTransformComboBox->setVisible( showForwardTransform );
 
+  bool showSmoothingWindowSize = ( pNode->GetProcessingMode() == vtkMRMLTransformProcessorNode::PROCESSING_MODE_TEMPORAL_SMOOTHING );
+  d->smoothingWindowSizeLabel->setVisible( showSmoothingWindowSize );
+  d->smoothingWindowSizeSpinBox->setVisible( showSmoothingWindowSize );
+
   d->outputTransformLabel->setVisible( true ); // always visible
   d->outputTransformComboBox->setVisible( true );
 
@@ -740,6 +754,20 @@ void qSlicerTransformProcessorModuleWidget::onCopyTranslationChanged()
   pNode->SetCopyTranslationZ( copyZ );
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerTransformProcessorModuleWidget::onSmoothingWindowSizeChanged( int windowSize )
+{
+  Q_D( qSlicerTransformProcessorModuleWidget );
+  vtkMRMLTransformProcessorNode* pNode = vtkMRMLTransformProcessorNode::SafeDownCast( d->parameterNodeComboBox->currentNode() );
+  if ( pNode == NULL || this->mrmlScene() == NULL )
+  {
+    qCritical( "Error: Failed to change smoothing window size, no parameter node/scene found." );
+    return;
+  }
+
+  pNode->SetSmoothingWindowSize( windowSize );
+}
+
 //-----------------------------------------------------------------------------
 bool qSlicerTransformProcessorModuleWidget::eventFilter( QObject * obj, QEvent *event )
 {
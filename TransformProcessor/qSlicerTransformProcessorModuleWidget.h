@@ -69,6 +69,7 @@ protected slots:
   void onDependentAxesModeChanged( int );
   void onSecondaryAxisChanged( int );
   void onCopyTranslationChanged();
+  void onSmoothingWindowSizeChanged( int );
 
   void onUpdateButtonPressed();
   void onUpdateButtonCheckboxToggled( bool );
@@ -0,0 +1,312 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkFreehandVolumeCompounder.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+vtkStandardNewMacro( vtkFreehandVolumeCompounder );
+
+//------------------------------------------------------------------------------
+vtkFreehandVolumeCompounder::vtkFreehandVolumeCompounder()
+{
+  this->Dimensions[ 0 ] = 0;
+  this->Dimensions[ 1 ] = 0;
+  this->Dimensions[ 2 ] = 0;
+  vtkMatrix4x4::Identity( &( this->RASToIJKMatrix[ 0 ][ 0 ] ) );
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+  this->NumberOfCompoundedFrames = 0;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+//------------------------------------------------------------------------------
+vtkFreehandVolumeCompounder::~vtkFreehandVolumeCompounder()
+{
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+  os << indent << "Dimensions: " << this->Dimensions[ 0 ] << ", " << this->Dimensions[ 1 ] << ", " << this->Dimensions[ 2 ] << std::endl;
+  os << indent << "NumberOfCompoundedFrames: " << this->NumberOfCompoundedFrames << std::endl;
+  os << indent << "NumberOfPendingFrames: " << this->PendingFrames.size() << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::SetOutputGeometry( const int dimensions[ 3 ], vtkMatrix4x4* ijkToRASMatrix )
+{
+  if ( ijkToRASMatrix == NULL || dimensions[ 0 ] <= 0 || dimensions[ 1 ] <= 0 || dimensions[ 2 ] <= 0 )
+  {
+    vtkErrorMacro( "SetOutputGeometry: invalid dimensions or IJK to RAS matrix" );
+    return;
+  }
+  vtkNew< vtkMatrix4x4 > rasToIJKMatrix;
+  vtkMatrix4x4::Invert( ijkToRASMatrix, rasToIJKMatrix.GetPointer() );
+  for ( int row = 0; row < 4; row++ )
+  {
+    for ( int column = 0; column < 4; column++ )
+    {
+      this->RASToIJKMatrix[ row ][ column ] = rasToIJKMatrix->GetElement( row, column );
+    }
+  }
+  std::copy( dimensions, dimensions + 3, this->Dimensions );
+  this->Output->SetDimensions( this->Dimensions );
+  this->Output->SetOrigin( 0.0, 0.0, 0.0 );
+  this->Output->SetSpacing( 1.0, 1.0, 1.0 );
+  this->Output->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+  this->Reset();
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::Reset()
+{
+  size_t numberOfVoxels = ( size_t )this->Dimensions[ 0 ] * this->Dimensions[ 1 ] * this->Dimensions[ 2 ];
+  this->VoxelSums.assign( numberOfVoxels, 0.0f );
+  this->VoxelWeights.assign( numberOfVoxels, 0.0f );
+  this->PendingFrames.clear();
+  this->NumberOfCompoundedFrames = 0;
+  if ( numberOfVoxels > 0 )
+  {
+    memset( this->Output->GetScalarPointer(), 0, numberOfVoxels );
+  }
+  this->Output->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::AddFrame( const unsigned char* pixels, int width, int height, int rowStride, const double cornersRAS[ 4 ][ 3 ] )
+{
+  if ( pixels == NULL || width <= 0 || height <= 0 || rowStride < width )
+  {
+    vtkErrorMacro( "AddFrame: invalid frame" );
+    return;
+  }
+  if ( this->VoxelSums.empty() )
+  {
+    vtkErrorMacro( "AddFrame: output geometry is not set" );
+    return;
+  }
+
+  this->PendingFrames.push_back( Frame() );
+  Frame& frame = this->PendingFrames.back();
+  frame.Width = width;
+  frame.Height = height;
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    const double* m = this->RASToIJKMatrix[ axis ];
+    frame.OriginIJK[ axis ] = m[ 0 ] * cornersRAS[ 0 ][ 0 ] + m[ 1 ] * cornersRAS[ 0 ][ 1 ] + m[ 2 ] * cornersRAS[ 0 ][ 2 ] + m[ 3 ];
+    double rowEndIJK = m[ 0 ] * cornersRAS[ 1 ][ 0 ] + m[ 1 ] * cornersRAS[ 1 ][ 1 ] + m[ 2 ] * cornersRAS[ 1 ][ 2 ] + m[ 3 ];
+    double columnEndIJK = m[ 0 ] * cornersRAS[ 2 ][ 0 ] + m[ 1 ] * cornersRAS[ 2 ][ 1 ] + m[ 2 ] * cornersRAS[ 2 ][ 2 ] + m[ 3 ];
+    frame.RowStepIJK[ axis ] = ( rowEndIJK - frame.OriginIJK[ axis ] ) / width;
+    frame.ColumnStepIJK[ axis ] = ( columnEndIJK - frame.OriginIJK[ axis ] ) / height;
+    // the corners are at the pixel edges, pixels are scattered from their centers
+    frame.OriginIJK[ axis ] += 0.5 * ( frame.RowStepIJK[ axis ] + frame.ColumnStepIJK[ axis ] );
+  }
+  frame.Pixels.resize( ( size_t )width * height );
+  for ( int row = 0; row < height; row++ )
+  {
+    memcpy( &( frame.Pixels[ ( size_t )row * width ] ), pixels + ( size_t )row * rowStride, width );
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::Update()
+{
+  if ( this->PendingFrames.empty() )
+  {
+    return;
+  }
+  ThreadJob job;
+  job.Self = this;
+  job.HoleFillingRadiusVoxels = 0;
+  this->ExecuteThreads( job, ScatterThreadFunction );
+  this->NumberOfCompoundedFrames += ( int )this->PendingFrames.size();
+  this->PendingFrames.clear();
+  this->Output->Modified();
+}
+
+//------------------------------------------------------------------------------
+int vtkFreehandVolumeCompounder::FillHoles( int radiusVoxels )
+{
+  if ( this->VoxelSums.empty() || radiusVoxels < 1 )
+  {
+    return 0;
+  }
+  ThreadJob job;
+  job.Self = this;
+  job.HoleFillingRadiusVoxels = radiusVoxels;
+  this->ExecuteThreads( job, FillHolesThreadFunction );
+  int numberOfFilledVoxels = 0;
+  for ( size_t threadIndex = 0; threadIndex < job.NumberOfFilledVoxels.size(); threadIndex++ )
+  {
+    numberOfFilledVoxels += job.NumberOfFilledVoxels[ threadIndex ];
+  }
+  this->Output->Modified();
+  return numberOfFilledVoxels;
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::ExecuteThreads( ThreadJob& job, vtkThreadFunctionType threadFunction )
+{
+  int numberOfThreads = std::max( 1, std::min( this->NumberOfThreads, this->Dimensions[ 2 ] ) );
+  job.NumberOfFilledVoxels.assign( numberOfThreads, 0 );
+  vtkNew< vtkMultiThreader > threader;
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( threadFunction, &job );
+  threader->SingleMethodExecute();
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkFreehandVolumeCompounder::ScatterThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  ThreadJob* job = static_cast< ThreadJob* >( threadInfo->UserData );
+  int numberOfSlices = job->Self->Dimensions[ 2 ];
+  int firstSlice = numberOfSlices * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int lastSlice = numberOfSlices * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  job->Self->ScatterFramesIntoSlab( firstSlice, lastSlice );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkFreehandVolumeCompounder::FillHolesThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  ThreadJob* job = static_cast< ThreadJob* >( threadInfo->UserData );
+  int numberOfSlices = job->Self->Dimensions[ 2 ];
+  int firstSlice = numberOfSlices * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int lastSlice = numberOfSlices * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  job->NumberOfFilledVoxels[ threadInfo->ThreadID ] = job->Self->FillHolesInSlab( job->HoleFillingRadiusVoxels, firstSlice, lastSlice );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+void vtkFreehandVolumeCompounder::ScatterFramesIntoSlab( int firstSlice, int lastSlice )
+{
+  const int* dims = this->Dimensions;
+  unsigned char* outputPtr = static_cast< unsigned char* >( this->Output->GetScalarPointer() );
+  // Pixels go to the nearest voxel, so a voxel with index k gets the positions in [ k - 0.5, k + 0.5 )
+  double slabMinimumK = firstSlice - 0.5;
+  double slabMaximumK = lastSlice - 0.5;
+  for ( std::vector< Frame >::const_iterator frameIt = this->PendingFrames.begin(); frameIt != this->PendingFrames.end(); ++frameIt )
+  {
+    const Frame& frame = *frameIt;
+    for ( int row = 0; row < frame.Height; row++ )
+    {
+      double rowStartIJK[ 3 ] = {
+        frame.OriginIJK[ 0 ] + row * frame.ColumnStepIJK[ 0 ],
+        frame.OriginIJK[ 1 ] + row * frame.ColumnStepIJK[ 1 ],
+        frame.OriginIJK[ 2 ] + row * frame.ColumnStepIJK[ 2 ] };
+
+      // K changes linearly along the row, so only the pixels in the slab are visited
+      int firstPixel = 0;
+      int lastPixel = frame.Width - 1;
+      double stepK = frame.RowStepIJK[ 2 ];
+      if ( std::fabs( stepK ) < 1e-12 )
+      {
+        if ( rowStartIJK[ 2 ] < slabMinimumK || rowStartIJK[ 2 ] >= slabMaximumK )
+        {
+          continue;
+        }
+      }
+      else
+      {
+        double pixelAtMinimumK = ( slabMinimumK - rowStartIJK[ 2 ] ) / stepK;
+        double pixelAtMaximumK = ( slabMaximumK - rowStartIJK[ 2 ] ) / stepK;
+        // one more pixel on both ends, so that rounding errors cannot skip a pixel at the slab boundary
+        firstPixel = std::max( firstPixel, ( int )std::max( -1.0, std::ceil( std::min( pixelAtMinimumK, pixelAtMaximumK ) ) - 1.0 ) );
+        lastPixel = std::min( lastPixel, ( int )std::min( ( double )frame.Width, std::floor( std::max( pixelAtMinimumK, pixelAtMaximumK ) ) + 1.0 ) );
+      }
+
+      const unsigned char* pixels = &( frame.Pixels[ ( size_t )row * frame.Width ] );
+      for ( int pixel = firstPixel; pixel <= lastPixel; pixel++ )
+      {
+        int i = ( int )std::floor( rowStartIJK[ 0 ] + pixel * frame.RowStepIJK[ 0 ] + 0.5 );
+        int j = ( int )std::floor( rowStartIJK[ 1 ] + pixel * frame.RowStepIJK[ 1 ] + 0.5 );
+        int k = ( int )std::floor( rowStartIJK[ 2 ] + pixel * stepK + 0.5 );
+        if ( i < 0 || i >= dims[ 0 ] || j < 0 || j >= dims[ 1 ] || k < firstSlice || k >= lastSlice )
+        {
+          continue;
+        }
+        size_t voxelIndex = ( ( size_t )k * dims[ 1 ] + j ) * dims[ 0 ] + i;
+        float sum = ( this->VoxelSums[ voxelIndex ] += pixels[ pixel ] );
+        float weight = ( this->VoxelWeights[ voxelIndex ] += 1.0f );
+        outputPtr[ voxelIndex ] = ( unsigned char )( sum / weight + 0.5f );
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int vtkFreehandVolumeCompounder::FillHolesInSlab( int radiusVoxels, int firstSlice, int lastSlice )
+{
+  const int* dims = this->Dimensions;
+  unsigned char* outputPtr = static_cast< unsigned char* >( this->Output->GetScalarPointer() );
+  int numberOfFilledVoxels = 0;
+  // Only the output of voxels of this slab is written, the neighbors are read from the accumulated
+  // sums and weights, which are not changed, so the threads do not depend on each other.
+  for ( int k = firstSlice; k < lastSlice; k++ )
+  {
+    for ( int j = 0; j < dims[ 1 ]; j++ )
+    {
+      for ( int i = 0; i < dims[ 0 ]; i++ )
+      {
+        size_t voxelIndex = ( ( size_t )k * dims[ 1 ] + j ) * dims[ 0 ] + i;
+        if ( this->VoxelWeights[ voxelIndex ] > 0.0f )
+        {
+          continue;
+        }
+        float neighborSum = 0.0f;
+        int numberOfNeighbors = 0;
+        for ( int nk = std::max( 0, k - radiusVoxels ); nk <= std::min( dims[ 2 ] - 1, k + radiusVoxels ); nk++ )
+        {
+          for ( int nj = std::max( 0, j - radiusVoxels ); nj <= std::min( dims[ 1 ] - 1, j + radiusVoxels ); nj++ )
+          {
+            size_t neighborRowIndex = ( ( size_t )nk * dims[ 1 ] + nj ) * dims[ 0 ];
+            for ( int ni = std::max( 0, i - radiusVoxels ); ni <= std::min( dims[ 0 ] - 1, i + radiusVoxels ); ni++ )
+            {
+              float weight = this->VoxelWeights[ neighborRowIndex + ni ];
+              if ( weight > 0.0f )
+              {
+                neighborSum += this->VoxelSums[ neighborRowIndex + ni ] / weight;
+                numberOfNeighbors++;
+              }
+            }
+          }
+        }
+        if ( numberOfNeighbors > 0 )
+        {
+          outputPtr[ voxelIndex ] = ( unsigned char )( neighborSum / numberOfNeighbors + 0.5f );
+          numberOfFilledVoxels++;
+        }
+        else
+        {
+          outputPtr[ voxelIndex ] = 0;
+        }
+      }
+    }
+  }
+  return numberOfFilledVoxels;
+}
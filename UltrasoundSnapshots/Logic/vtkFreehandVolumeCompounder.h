@@ -0,0 +1,125 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreehandVolumeCompounder - volume from tracked 2D frames
+// .SECTION Description
+// Compounds 8-bit tracked 2D frames (e.g., ultrasound snapshots) into a voxel grid by
+// pixel nearest neighbor scattering: each pixel is added to the voxel that contains it,
+// and each voxel is the average of the pixels that fell into it.
+// Frames are added incrementally, Update() only scatters the frames that were added
+// since the last update. Scattering is multithreaded, each thread writes its own slab of
+// voxels, so no locking is needed.
+// Voxels that no pixel fell into remain empty (0) until FillHoles() is called, which is
+// a separate step because it visits the whole grid.
+
+#ifndef __vtkFreehandVolumeCompounder_h
+#define __vtkFreehandVolumeCompounder_h
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+// UltrasoundSnapshots includes
+#include "vtkSlicerUltrasoundSnapshotsModuleLogicExport.h"
+
+class vtkMatrix4x4;
+
+class VTK_SLICER_ULTRASOUNDSNAPSHOTS_MODULE_LOGIC_EXPORT vtkFreehandVolumeCompounder : public vtkObject
+{
+public:
+  static vtkFreehandVolumeCompounder* New();
+  vtkTypeMacro( vtkFreehandVolumeCompounder, vtkObject );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  // Set the voxel grid: dimensions and the IJK-to-RAS matrix of the voxels.
+  // The output is reallocated and the compounding is reset.
+  void SetOutputGeometry( const int dimensions[ 3 ], vtkMatrix4x4* ijkToRASMatrix );
+  // Remove all compounded and pending frames, all voxels become empty
+  void Reset();
+
+  // Queue a frame for compounding. The pixels are copied. The row stride is the distance of the rows
+  // in pixels, so that a frame can be taken from a larger image. Corners are in RAS, in vtkPlaneSource point order
+  // (origin, end of the first row, end of the first column, opposite corner), at pixel indices (0, 0), (width, 0) and (0, height).
+  // These are the outer edges of the frame, as in the texture mapping, so pixel (i, j) is at (i + 0.5, j + 0.5).
+  void AddFrame( const unsigned char* pixels, int width, int height, int rowStride, const double cornersRAS[ 4 ][ 3 ] );
+  int GetNumberOfPendingFrames() { return ( int )this->PendingFrames.size(); };
+
+  // Scatter the pending frames into the voxel grid. The output is modified only if there were pending frames.
+  void Update();
+
+  // Set each empty voxel to the average of the non-empty voxels within the given radius (in voxels).
+  // Only the output is changed, so frames can still be added afterwards, but then filling has to be requested again.
+  // Returns the number of filled voxels.
+  int FillHoles( int radiusVoxels );
+
+  // Unsigned char volume, with unit spacing and zero origin (the geometry is defined by the IJK-to-RAS matrix).
+  // The same object is updated by each Update() and FillHoles() call.
+  vtkImageData* GetOutput() { return this->Output; };
+
+  vtkGetMacro( NumberOfCompoundedFrames, int );
+  vtkGetMacro( NumberOfThreads, int );
+  vtkSetMacro( NumberOfThreads, int );
+
+protected:
+  vtkFreehandVolumeCompounder();
+  ~vtkFreehandVolumeCompounder();
+
+private:
+  struct Frame
+  {
+    int Width;
+    int Height;
+    double OriginIJK[ 3 ]; // voxel coordinates of the center of pixel (0, 0)
+    double RowStepIJK[ 3 ]; // change of voxel coordinates by moving one pixel along a row
+    double ColumnStepIJK[ 3 ]; // change of voxel coordinates by moving one pixel along a column
+    std::vector< unsigned char > Pixels;
+  };
+
+  // Each thread processes a slab of slices (voxels with K index in [ FirstSlice, LastSlice ) )
+  struct ThreadJob
+  {
+    vtkFreehandVolumeCompounder* Self;
+    int HoleFillingRadiusVoxels;
+    std::vector< int > NumberOfFilledVoxels; // for each thread
+  };
+  static VTK_THREAD_RETURN_TYPE ScatterThreadFunction( void* arg );
+  static VTK_THREAD_RETURN_TYPE FillHolesThreadFunction( void* arg );
+  void ExecuteThreads( ThreadJob& job, vtkThreadFunctionType threadFunction );
+  void ScatterFramesIntoSlab( int firstSlice, int lastSlice );
+  int FillHolesInSlab( int radiusVoxels, int firstSlice, int lastSlice );
+
+  int Dimensions[ 3 ];
+  double RASToIJKMatrix[ 4 ][ 4 ];
+
+  std::vector< Frame > PendingFrames;
+  // Sum of the pixel values and number of pixels that fell into each voxel
+  std::vector< float > VoxelSums;
+  std::vector< float > VoxelWeights;
+
+  vtkSmartPointer< vtkImageData > Output;
+  int NumberOfCompoundedFrames;
+  int NumberOfThreads;
+
+  vtkFreehandVolumeCompounder( const vtkFreehandVolumeCompounder& ); // Not implemented
+  void operator=( const vtkFreehandVolumeCompounder& ); // Not implemented
+};
+
+#endif
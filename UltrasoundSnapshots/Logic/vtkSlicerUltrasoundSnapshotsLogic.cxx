@@ -1,8 +1,10 @@
 
 // UltrasoundSnapshots Logic includes
 #include "vtkSlicerUltrasoundSnapshotsLogic.h"
+#include "vtkFreehandVolumeCompounder.h"
 
 // MRML includes
+#include "vtkMRMLCameraNode.h"
 #include "vtkMRMLModelDisplayNode.h"
 #include "vtkMRMLModelNode.h"
 #include "vtkMRMLScalarVolumeDisplayNode.h"
@@ -10,18 +12,213 @@
 #include "vtkMRMLScene.h"
 
 // VTK includes
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
 #include <vtkCollection.h>
 #include <vtkCollectionIterator.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
 #include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
 #include <vtkPlaneSource.h>
+#include <vtkPointData.h>
 #include <vtkSmartPointer.h>
 #include <vtkTransform.h>
-#include <vtkImageMapToWindowLevelColors.h>
 #include <vtkObjectFactory.h>
+#include <vtkTrivialProducer.h>
+#include <vtkZLibDataCompressor.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// Textures of removed snapshots are kept for reuse up to this number
+static const int MAXIMUM_TEXTURE_POOL_SIZE = 256;
+
+// Snapshot archive file layout (native byte order):
+//   8 bytes: ARCHIVE_MAGIC
+//   int32: number of frames
+//   for each frame: int32 width, int32 height, 12 double corner coordinates (RAS, in vtkPlaneSource point order),
+//                   uint64 offset of the compressed pixels from the beginning of the file, uint64 compressed size
+//   compressed 8-bit pixels of each frame
+static const char ARCHIVE_MAGIC[ 8 ] = { 'U', 'S', 'S', 'N', 'A', 'P', '0', '1' };
+static const int ARCHIVE_FRAME_RECORD_SIZE = 2 * sizeof( vtkTypeInt32 ) + 12 * sizeof( double ) + 2 * sizeof( vtkTypeUInt64 );
+
+
+
+//----------------------------------------------------------------------------
+/// Writes snapshot archives on a worker thread. The frames are copied on the main thread
+/// (they are 8-bit, so this is fast), compression and file output are done on the worker thread.
+class vtkSlicerUltrasoundSnapshotsLogic::vtkInternal
+{
+public:
+  vtkInternal();
+  ~vtkInternal();
+
+  struct Frame
+  {
+    int Dims[ 2 ];
+    double CornersRAS[ 12 ];
+    std::vector< unsigned char > Pixels;
+  };
+
+  // Starts writing the frames, which are taken over (the vector is emptied)
+  bool StartWrite( const std::string& fileName, std::vector< Frame >& frames );
+  bool IsWriteInProgress();
+  bool WaitForWrite();
+
+  static VTK_THREAD_RETURN_TYPE ThreadFunction( void* ptr );
+  bool WriteArchive();
+
+  vtkSmartPointer< vtkMultiThreader > Threader;
+  int ThreadId;
+
+  // Only accessed by the worker thread while it is running
+  std::string FileName;
+  std::vector< Frame > Frames;
+
+  // Protects WriteDone and WriteSuccess
+  vtkSmartPointer< vtkMutexLock > Mutex;
+  bool WriteDone;
+  bool WriteSuccess;
+};
+
+//----------------------------------------------------------------------------
+vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::vtkInternal()
+: Threader( vtkSmartPointer< vtkMultiThreader >::New() )
+, ThreadId( -1 )
+, Mutex( vtkSmartPointer< vtkMutexLock >::New() )
+, WriteDone( true )
+, WriteSuccess( true )
+{
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::~vtkInternal()
+{
+  this->WaitForWrite();
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::StartWrite( const std::string& fileName, std::vector< Frame >& frames )
+{
+  this->WaitForWrite();
+  this->FileName = fileName;
+  this->Frames.swap( frames );
+  frames.clear();
+  this->WriteDone = false;
+  this->WriteSuccess = false;
+  this->ThreadId = this->Threader->SpawnThread( ( vtkThreadFunctionType )&vtkInternal::ThreadFunction, this );
+  return this->ThreadId >= 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::IsWriteInProgress()
+{
+  if ( this->ThreadId < 0 )
+  {
+    return false;
+  }
+  this->Mutex->Lock();
+  bool writeDone = this->WriteDone;
+  this->Mutex->Unlock();
+  return !writeDone;
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::WaitForWrite()
+{
+  if ( this->ThreadId >= 0 )
+  {
+    this->Threader->TerminateThread( this->ThreadId ); // waits for the thread to finish
+    this->ThreadId = -1;
+    this->Frames.clear();
+  }
+  this->Mutex->Lock();
+  bool writeSuccess = this->WriteSuccess;
+  this->Mutex->Unlock();
+  return writeSuccess;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::ThreadFunction( void* ptr )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( ptr );
+  vtkInternal* self = static_cast< vtkInternal* >( threadInfo->UserData );
+  bool success = self->WriteArchive();
+  self->Mutex->Lock();
+  self->WriteSuccess = success;
+  self->WriteDone = true;
+  self->Mutex->Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerUltrasoundSnapshotsLogic::vtkInternal::WriteArchive()
+{
+  // Compress all frames first, the offsets of the frames are needed for the table
+  vtkNew< vtkZLibDataCompressor > compressor;
+  std::vector< std::vector< unsigned char > > compressedFrames( this->Frames.size() );
+  for ( size_t frameIndex = 0; frameIndex < this->Frames.size(); frameIndex++ )
+  {
+    std::vector< unsigned char >& pixels = this->Frames[ frameIndex ].Pixels;
+    std::vector< unsigned char >& compressedPixels = compressedFrames[ frameIndex ];
+    compressedPixels.resize( compressor->GetMaximumCompressionSpace( pixels.size() ) );
+    size_t compressedSize = pixels.empty() ? 0 : compressor->Compress( &( pixels[ 0 ] ), pixels.size(), &( compressedPixels[ 0 ] ), compressedPixels.size() );
+    if ( compressedSize == 0 && ! pixels.empty() )
+    {
+      return false;
+    }
+    compressedPixels.resize( compressedSize );
+    std::vector< unsigned char >().swap( pixels ); // release memory as soon as possible
+  }
+
+  // Write to a temporary file, so an existing archive is only replaced by a complete one
+  std::string temporaryFileName = this->FileName + ".tmp";
+  std::ofstream archiveFile( temporaryFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+  if ( ! archiveFile )
+  {
+    return false;
+  }
+  vtkTypeInt32 numberOfFrames = ( vtkTypeInt32 )this->Frames.size();
+  archiveFile.write( ARCHIVE_MAGIC, sizeof( ARCHIVE_MAGIC ) );
+  archiveFile.write( reinterpret_cast< const char* >( &numberOfFrames ), sizeof( numberOfFrames ) );
+  vtkTypeUInt64 offset = sizeof( ARCHIVE_MAGIC ) + sizeof( numberOfFrames ) + numberOfFrames * ARCHIVE_FRAME_RECORD_SIZE;
+  for ( size_t frameIndex = 0; frameIndex < this->Frames.size(); frameIndex++ )
+  {
+    Frame& frame = this->Frames[ frameIndex ];
+    vtkTypeInt32 dims[ 2 ] = { frame.Dims[ 0 ], frame.Dims[ 1 ] };
+    vtkTypeUInt64 compressedSize = compressedFrames[ frameIndex ].size();
+    archiveFile.write( reinterpret_cast< const char* >( dims ), sizeof( dims ) );
+    archiveFile.write( reinterpret_cast< const char* >( frame.CornersRAS ), sizeof( frame.CornersRAS ) );
+    archiveFile.write( reinterpret_cast< const char* >( &offset ), sizeof( offset ) );
+    archiveFile.write( reinterpret_cast< const char* >( &compressedSize ), sizeof( compressedSize ) );
+    offset += compressedSize;
+  }
+  for ( size_t frameIndex = 0; frameIndex < compressedFrames.size(); frameIndex++ )
+  {
+    if ( ! compressedFrames[ frameIndex ].empty() )
+    {
+      archiveFile.write( reinterpret_cast< const char* >( &( compressedFrames[ frameIndex ][ 0 ] ) ), compressedFrames[ frameIndex ].size() );
+    }
+  }
+  archiveFile.close();
+  if ( archiveFile.fail() )
+  {
+    std::remove( temporaryFileName.c_str() );
+    return false;
+  }
+
+  std::remove( this->FileName.c_str() );
+  return std::rename( temporaryFileName.c_str(), this->FileName.c_str() ) == 0;
+}
 
 
 
@@ -32,11 +229,25 @@ vtkStandardNewMacro(vtkSlicerUltrasoundSnapshotsLogic);
 vtkSlicerUltrasoundSnapshotsLogic::vtkSlicerUltrasoundSnapshotsLogic()
 {
   this->snapshotCounter = 1;
+  this->UseTextureAtlas = false;
+  this->TextureAtlasSize = 4096;
+  this->MaximumTextureLevel = 4;
+  this->MaximumNumberOfFullResolutionSnapshots = 0;
+  this->SweepMinimumDistanceMm = 5.0;
+  this->SweepMinimumAngleDeg = 5.0;
+  this->SweepMaximumNumberOfSnapshots = 100;
+  this->SweepPreserveWindowLevel = true;
+  this->SweepHasLastPose = false;
+  this->LiveImageTextureIsInputImage = false;
+  this->Compounder = vtkSmartPointer< vtkFreehandVolumeCompounder >::New();
+  this->Internal = new vtkInternal;
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerUltrasoundSnapshotsLogic::~vtkSlicerUltrasoundSnapshotsLogic()
 {
+  delete this->Internal; // waits for the archive write to finish
+  this->Internal = NULL;
 }
 
 
@@ -46,6 +257,20 @@ vtkSlicerUltrasoundSnapshotsLogic
 ::PrintSelf( ostream& os, vtkIndent indent )
 {
   this->Superclass::PrintSelf( os, indent );
+  os << indent << "UseTextureAtlas: " << this->UseTextureAtlas << std::endl;
+  os << indent << "TextureAtlasSize: " << this->TextureAtlasSize << std::endl;
+  os << indent << "NumberOfAtlasPages: " << this->AtlasPages.size() << std::endl;
+  os << indent << "NumberOfPooledTextures: " << this->TexturePool.size() << std::endl;
+  os << indent << "MaximumTextureLevel: " << this->MaximumTextureLevel << std::endl;
+  os << indent << "MaximumNumberOfFullResolutionSnapshots: " << this->MaximumNumberOfFullResolutionSnapshots << std::endl;
+  os << indent << "NumberOfFullResolutionSnapshots: " << this->FullResolutionSnapshotIDs.size() << std::endl;
+  os << indent << "SweepActive: " << this->IsSweepActive() << std::endl;
+  os << indent << "SweepMinimumDistanceMm: " << this->SweepMinimumDistanceMm << std::endl;
+  os << indent << "SweepMinimumAngleDeg: " << this->SweepMinimumAngleDeg << std::endl;
+  os << indent << "SweepMaximumNumberOfSnapshots: " << this->SweepMaximumNumberOfSnapshots << std::endl;
+  os << indent << "LiveImageInputNode: " << ( this->LiveImageInputNode.GetPointer() != NULL ? this->LiveImageInputNode->GetID() : "(none)" ) << std::endl;
+  os << indent << "CompoundingVolumeNode: " << ( this->CompoundingVolumeNode.GetPointer() != NULL ? this->CompoundingVolumeNode->GetID() : "(none)" ) << std::endl;
+  os << indent << "NumberOfCompoundedSnapshots: " << this->Compounder->GetNumberOfCompoundedFrames() << std::endl;
 }
 
 
@@ -118,23 +343,55 @@ void
 vtkSlicerUltrasoundSnapshotsLogic
 ::AddSnapshot( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel )
 {
-  if ( InputNode == NULL )
+  SnapshotLocation location;
+  this->AddSnapshotInternal( InputNode, preserveWindowLevel, location );
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::AddSnapshotInternal( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel, SnapshotLocation& location )
+{
+  if ( InputNode == NULL || InputNode->GetImageData() == NULL )
   {
-    return;
+    return false;
   }
   
+  int dims[ 3 ] = { 0, 0, 0 };
+  InputNode->GetImageData()->GetDimensions( dims );
+  if ( dims[ 0 ] == 0  &&  dims[ 1 ] == 0  && dims[ 2 ] == 0 )
+  {
+    return false;
+  }
   
-  vtkSmartPointer< vtkMRMLModelDisplayNode > snapshotDisp = vtkSmartPointer< vtkMRMLModelDisplayNode >::New();
-  this->GetMRMLScene()->AddNode( snapshotDisp );
-  snapshotDisp->SetScene( this->GetMRMLScene() );
-  snapshotDisp->SetDisableModifiedEvent( 1 );
-  snapshotDisp->SetOpacity( 1.0 );
-  snapshotDisp->SetColor( 1.0, 1.0, 1.0 );
-  snapshotDisp->SetAmbient( 1.0 );
-  snapshotDisp->SetBackfaceCulling( 0 );
-  snapshotDisp->SetDiffuse( 0.0 );
-  snapshotDisp->SetSaveWithScene( 1 );
-  snapshotDisp->SetDisableModifiedEvent( 0 );
+  double cornersRAS[ 4 ][ 3 ];
+  this->ComputeSnapshotCorners( InputNode, dims, cornersRAS );
+  double window = 0.0;
+  double level = 0.0;
+  this->ComputeSnapshotWindowLevel( InputNode, preserveWindowLevel, window, level );
+  
+  return this->AddSnapshotFromImage( InputNode->GetImageData(), cornersRAS, window, level, location );
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::AddSnapshotFromImage( vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level, SnapshotLocation& location )
+{
+  int dims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( dims );
+  
+  if ( this->UseTextureAtlas && this->AddSnapshotToAtlas( inputImage, cornersRAS, window, level, location ) )
+  {
+    this->CompoundSnapshot( this->AtlasPages[ location.AtlasPageIndex ].Texture.Image, location.AtlasOffset[ 0 ], location.AtlasOffset[ 1 ],
+      dims[ 0 ], dims[ 1 ], cornersRAS, true );
+    this->snapshotCounter++;
+    return true;
+  }
+  
+  vtkSmartPointer< vtkMRMLModelDisplayNode > snapshotDisp = this->CreateSnapshotDisplayNode();
   
   std::stringstream nameStream;
   nameStream << "UltrasoundSnapshots_Snapshot_";
@@ -147,23 +404,63 @@ vtkSlicerUltrasoundSnapshotsLogic
   snapshotModel->SetScene( this->GetMRMLScene() );
   snapshotModel->SetAndObserveDisplayNodeID( snapshotDisp->GetID() );
   snapshotModel->SetHideFromEditors( 0 );
-  snapshotModel->SetSaveWithScene( 1 );
-    
-  int dims[ 3 ] = { 0, 0, 0 };
-  InputNode->GetImageData()->GetDimensions( dims );
-  if ( dims[ 0 ] == 0  &&  dims[ 1 ] == 0  && dims[ 2 ] == 0 )
-  {
-    return;
-  }
+  snapshotModel->SetSaveWithScene( 0 );
   
   vtkSmartPointer< vtkPlaneSource > plane = vtkSmartPointer< vtkPlaneSource >::New();
   plane->Update();
   snapshotModel->SetAndObservePolyData( plane->GetOutput() );
   
-  vtkPolyData* slicePolyData = snapshotModel->GetPolyData();
-  vtkPoints* slicePoints = slicePolyData->GetPoints();
+    // Position of the PolyData of the new model node.
+  
+  vtkPoints* slicePoints = snapshotModel->GetPolyData()->GetPoints();
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+  {
+    slicePoints->SetPoint( cornerIndex, cornersRAS[ cornerIndex ] );
+  }
   
+    // Add image texture. The frame is mapped to 8 bits directly into a pooled texture buffer,
+    // so it is only copied once and no volume node is created for it.
   
+  SnapshotTexture texture = this->GetTextureFromPool( dims );
+  MapImageToTexture( inputImage, window, level, texture.Image, 0, 0 );
+  this->SnapshotTextures[ snapshotModel->GetID() ] = texture;
+  this->CompoundSnapshot( texture.Image, 0, 0, dims[ 0 ], dims[ 1 ], cornersRAS, true );
+  
+  snapshotDisp->SetTextureImageDataConnection( texture.Producer->GetOutputPort() );
+  
+  location.ModelNodeID = snapshotModel->GetID();
+  this->SnapshotModelNodeIDs.insert( snapshotModel->GetID() );
+  this->FullResolutionSnapshotIDs.push_back( snapshotModel->GetID() );
+  this->snapshotCounter++;  
+  return true;
+}
+
+
+
+vtkSmartPointer< vtkMRMLModelDisplayNode >
+vtkSlicerUltrasoundSnapshotsLogic
+::CreateSnapshotDisplayNode()
+{
+  vtkSmartPointer< vtkMRMLModelDisplayNode > snapshotDisp = vtkSmartPointer< vtkMRMLModelDisplayNode >::New();
+  this->GetMRMLScene()->AddNode( snapshotDisp );
+  snapshotDisp->SetScene( this->GetMRMLScene() );
+  snapshotDisp->SetDisableModifiedEvent( 1 );
+  snapshotDisp->SetOpacity( 1.0 );
+  snapshotDisp->SetColor( 1.0, 1.0, 1.0 );
+  snapshotDisp->SetAmbient( 1.0 );
+  snapshotDisp->SetBackfaceCulling( 0 );
+  snapshotDisp->SetDiffuse( 0.0 );
+  snapshotDisp->SetSaveWithScene( 0 ); // the texture is not a node, so it could not be restored with the scene
+  snapshotDisp->SetDisableModifiedEvent( 0 );
+  return snapshotDisp;
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ComputeSnapshotCorners( vtkMRMLScalarVolumeNode* InputNode, int dims[ 3 ], double cornersRAS[ 4 ][ 3 ] )
+{
   // If the image is placed on a parent transform, get a copy of that transform.
   
   vtkSmartPointer< vtkTransform > ParentTransform = vtkSmartPointer< vtkTransform >::New();
@@ -190,201 +487,1076 @@ vtkSlicerUltrasoundSnapshotsLogic
   tImageToRAS->Concatenate( ImageToParentTransform );
   tImageToRAS->Update();
   
-    // Four corners of the image in Image coordinate system.
+    // Four corners of the image in Image coordinate system, in the point order of vtkPlaneSource.
   
-  double point1Image[ 4 ] = { 0.0,                            0.0,                            0.0, 1.0 };
-  double point2Image[ 4 ] = { static_cast<double>(dims[ 0 ]), 0.0,                            0.0, 1.0 };
-  double point3Image[ 4 ] = { 0.0,                            static_cast<double>(dims[ 1 ]), 0.0, 1.0 };
-  double point4Image[ 4 ] = { static_cast<double>(dims[ 0 ]), static_cast<double>(dims[ 1 ]), 0.0, 1.0 };
+  double pointsImage[ 4 ][ 4 ] = {
+    { 0.0,                            0.0,                            0.0, 1.0 },
+    { static_cast<double>(dims[ 0 ]), 0.0,                            0.0, 1.0 },
+    { 0.0,                            static_cast<double>(dims[ 1 ]), 0.0, 1.0 },
+    { static_cast<double>(dims[ 0 ]), static_cast<double>(dims[ 1 ]), 0.0, 1.0 } };
   
     // Four corners of the image in RAS coordinate system.
   
-  double point1RAS[ 4 ] = { 0, 0, 0, 0 };
-  double point2RAS[ 4 ] = { 0, 0, 0, 0 }; 
-  double point3RAS[ 4 ] = { 0, 0, 0, 0 }; 
-  double point4RAS[ 4 ] = { 0, 0, 0, 0 };
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+  {
+    double pointRAS[ 4 ] = { 0, 0, 0, 0 };
+    tImageToRAS->MultiplyPoint( pointsImage[ cornerIndex ], pointRAS );
+    cornersRAS[ cornerIndex ][ 0 ] = pointRAS[ 0 ];
+    cornersRAS[ cornerIndex ][ 1 ] = pointRAS[ 1 ];
+    cornersRAS[ cornerIndex ][ 2 ] = pointRAS[ 2 ];
+  }
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ComputeSnapshotWindowLevel( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel, double& window, double& level )
+{
+  vtkImageData* inputImage = InputNode->GetImageData();
+  vtkMRMLScalarVolumeDisplayNode* inputDisplayNode = InputNode->GetScalarVolumeDisplayNode();
+  if ( preserveWindowLevel == true && inputDisplayNode != NULL )
+  {
+    window = inputDisplayNode->GetWindow();
+    level = inputDisplayNode->GetLevel();
+  }
+  else if ( inputImage->GetScalarType() == VTK_UNSIGNED_CHAR )
+  {
+    window = 255.0;
+    level = 127.5;
+  }
+  else
+  {
+    // Same appearance as texture mapping of the original scalars, which uses the full scalar range
+    double scalarRange[ 2 ] = { 0.0, 0.0 };
+    inputImage->GetScalarRange( scalarRange );
+    window = scalarRange[ 1 ] - scalarRange[ 0 ];
+    level = 0.5 * ( scalarRange[ 0 ] + scalarRange[ 1 ] );
+  }
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::AddSnapshotToAtlas( vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level, SnapshotLocation& location )
+{
+  int dims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( dims );
+  if ( dims[ 0 ] > this->TextureAtlasSize || dims[ 1 ] > this->TextureAtlasSize || dims[ 2 ] != 1 )
+  {
+    vtkWarningMacro( "AddSnapshotToAtlas: Image does not fit into the texture atlas, it is added as a separate snapshot model." );
+    return false;
+  }
+  
+  // Frames are packed into rows (shelves) from the bottom left corner of the atlas page.
+  // All frames of a recording usually have the same size, so there is little unused space.
+  AtlasPage* page = this->AtlasPages.empty() ? NULL : &( this->AtlasPages.back() );
+  if ( page != NULL && page->CursorX + dims[ 0 ] > this->TextureAtlasSize )
+  {
+    page->CursorX = 0;
+    page->CursorY += page->RowHeight;
+    page->RowHeight = 0;
+  }
+  if ( page == NULL || page->ModelNode == NULL || page->CursorY + dims[ 1 ] > this->TextureAtlasSize )
+  {
+    page = this->CreateAtlasPage();
+  }
   
-  tImageToRAS->MultiplyPoint( point1Image, point1RAS );
-  tImageToRAS->MultiplyPoint( point2Image, point2RAS );
-  tImageToRAS->MultiplyPoint( point3Image, point3RAS );
-  tImageToRAS->MultiplyPoint( point4Image, point4RAS );
+  int offsetX = page->CursorX;
+  int offsetY = page->CursorY;
+  page->CursorX += dims[ 0 ];
+  page->RowHeight = std::max( page->RowHeight, dims[ 1 ] );
   
-    // Position of the PolyData of the new model node.
+  MapImageToTexture( inputImage, window, level, page->Texture.Image, offsetX, offsetY );
+  UpdateTextureLevelsInRegion( page->Texture, offsetX, offsetY, dims[ 0 ], dims[ 1 ] );
+  page->QuadRegions.push_back( offsetX );
+  page->QuadRegions.push_back( offsetY );
+  page->QuadRegions.push_back( dims[ 0 ] );
+  page->QuadRegions.push_back( dims[ 1 ] );
   
-  slicePoints->SetPoint( 0, point1RAS );
-  slicePoints->SetPoint( 1, point2RAS );
-  slicePoints->SetPoint( 2, point3RAS );
-  slicePoints->SetPoint( 3, point4RAS );
+  // Texture coordinates are inset by half a texel so that neighboring frames do not bleed in
+  double atlasSize = this->TextureAtlasSize;
+  double u0 = ( offsetX + 0.5 ) / atlasSize;
+  double u1 = ( offsetX + dims[ 0 ] - 0.5 ) / atlasSize;
+  double v0 = ( offsetY + 0.5 ) / atlasSize;
+  double v1 = ( offsetY + dims[ 1 ] - 0.5 ) / atlasSize;
+  double cornerTextureCoordinates[ 4 ][ 2 ] = { { u0, v0 }, { u1, v0 }, { u0, v1 }, { u1, v1 } };
   
-    // Add image texture.
-  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
-  image->DeepCopy(InputNode->GetImageData());
-
-  if ( preserveWindowLevel == true )
+  vtkPolyData* polyData = page->ModelNode->GetPolyData();
+  vtkPoints* points = polyData->GetPoints();
+  vtkDataArray* textureCoordinates = polyData->GetPointData()->GetTCoords();
+  vtkIdType quadPointIds[ 4 ] = { 0, 0, 0, 0 };
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
   {
-    vtkSmartPointer< vtkImageMapToWindowLevelColors > mapToWindowLevelColors = vtkSmartPointer< vtkImageMapToWindowLevelColors >::New();
-    
-#if (VTK_MAJOR_VERSION <= 5)
-	mapToWindowLevelColors->SetInput( image );
-#else
-    mapToWindowLevelColors->SetInputData( image );
-#endif
-
-    mapToWindowLevelColors->SetOutputFormatToLuminance();
-    mapToWindowLevelColors->SetWindow( InputNode->GetScalarVolumeDisplayNode()->GetWindow() );
-    mapToWindowLevelColors->SetLevel( InputNode->GetScalarVolumeDisplayNode()->GetLevel() );
-    mapToWindowLevelColors->Update();
-    image->DeepCopy( mapToWindowLevelColors->GetOutput() );
-  }
-  
-  std::stringstream textureNameStream;
-  textureNameStream << "UltrasoundSnapshots_Texture_";
-  textureNameStream << this->snapshotCounter;
-  
-  vtkSmartPointer< vtkMRMLScalarVolumeNode > snapshotTexture = vtkSmartPointer< vtkMRMLScalarVolumeNode >::New();
-  this->GetMRMLScene()->AddNode( snapshotTexture );
-  snapshotTexture->SetName( textureNameStream.str().c_str() );
-  snapshotTexture->SetDescription( "Live Ultrasound Snapshot Texture" );
-  snapshotTexture->SetAndObserveImageData( image );
-  snapshotTexture->CopyOrientation( InputNode );
-  snapshotTexture->SetSpacing( InputNode->GetSpacing() );
-  snapshotTexture->SetOrigin( InputNode->GetOrigin() );
-  snapshotTexture->SetIJKToRASMatrix( tImageToRAS->GetMatrix() );
-  
-  std::stringstream textureDisplayNameStream;
-  textureDisplayNameStream << "UltrasoundSnapshots_TextureDisplay_";
-  textureDisplayNameStream << this->snapshotCounter;  
-  
-  vtkSmartPointer< vtkMRMLScalarVolumeDisplayNode > snapshotTextureDisplay = vtkSmartPointer< vtkMRMLScalarVolumeDisplayNode >::New();
-  this->GetMRMLScene()->AddNode( snapshotTextureDisplay );
-  snapshotTextureDisplay->SetName( textureDisplayNameStream.str().c_str() );
-  snapshotTextureDisplay->SetAutoWindowLevel(0);
-  snapshotTextureDisplay->SetWindow(256);
-  snapshotTextureDisplay->SetLevel(128);
-  snapshotTextureDisplay->SetDefaultColorMap();
-  
-  snapshotTexture->AddAndObserveDisplayNodeID( snapshotTextureDisplay->GetID() );   
-  
-  snapshotModel->SetAttribute( "TextureNodeID", snapshotTexture->GetID() );
-
-#if (VTK_MAJOR_VERSION <= 5)
-  snapshotModel->GetModelDisplayNode()->SetAndObserveTextureImageData( snapshotTexture->GetImageData() );
-#else
-  snapshotModel->GetDisplayNode()->SetTextureImageDataConnection( snapshotTexture->GetImageDataConnection() );
-#endif  
+    quadPointIds[ cornerIndex ] = points->InsertNextPoint( cornersRAS[ cornerIndex ] );
+    textureCoordinates->InsertNextTuple( cornerTextureCoordinates[ cornerIndex ] );
+  }
+  vtkIdType cellPointIds[ 4 ] = { quadPointIds[ 0 ], quadPointIds[ 1 ], quadPointIds[ 3 ], quadPointIds[ 2 ] };
+  vtkIdType quadIndex = polyData->GetPolys()->InsertNextCell( 4, cellPointIds );
   
-  this->snapshotCounter++;  
+  points->Modified();
+  textureCoordinates->Modified();
+  polyData->GetPolys()->Modified();
+  polyData->DeleteCells();
+  polyData->Modified();
+  
+  location.AtlasPageIndex = ( int )( page - &( this->AtlasPages[ 0 ] ) );
+  location.AtlasQuadIndex = ( int )quadIndex;
+  location.AtlasOffset[ 0 ] = offsetX;
+  location.AtlasOffset[ 1 ] = offsetY;
+  location.Dims[ 0 ] = dims[ 0 ];
+  location.Dims[ 1 ] = dims[ 1 ];
+  return true;
 }
 
 
 
-void
+bool
 vtkSlicerUltrasoundSnapshotsLogic
-::ClearSnapshots()
+::ReplaceAtlasSnapshot( const SnapshotLocation& location, vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level )
 {
-  vtkSmartPointer< vtkCollection > modelNodes = vtkSmartPointer< vtkCollection >::Take( this->GetMRMLScene()->GetNodesByClass( "vtkMRMLModelNode" ) );
-  vtkNew< vtkCollectionIterator > modelIt;
-  modelIt->SetCollection( modelNodes );
+  if ( location.AtlasPageIndex < 0 || location.AtlasPageIndex >= ( int )this->AtlasPages.size() )
+  {
+    return false;
+  }
+  AtlasPage& page = this->AtlasPages[ location.AtlasPageIndex ];
+  int dims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( dims );
+  if ( page.ModelNode == NULL || dims[ 0 ] != location.Dims[ 0 ] || dims[ 1 ] != location.Dims[ 1 ] || dims[ 2 ] != 1 )
+  {
+    return false;
+  }
+  vtkPolyData* polyData = page.ModelNode->GetPolyData();
+  vtkPoints* points = polyData->GetPoints();
+  if ( 4 * ( location.AtlasQuadIndex + 1 ) > points->GetNumberOfPoints() )
+  {
+    return false;
+  }
   
-  for ( modelIt->InitTraversal(); ! modelIt->IsDoneWithTraversal(); modelIt->GoToNextItem() )
+  MapImageToTexture( inputImage, window, level, page.Texture.Image, location.AtlasOffset[ 0 ], location.AtlasOffset[ 1 ] );
+  UpdateTextureLevelsInRegion( page.Texture, location.AtlasOffset[ 0 ], location.AtlasOffset[ 1 ], dims[ 0 ], dims[ 1 ] );
+  // The points of each quad are consecutive, and texture coordinates stay the same
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
   {
-    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( modelIt->GetCurrentObject() );
-    
-    if ( snapshotModel != NULL && std::string(snapshotModel->GetName()).find( "UltrasoundSnapshots_Snapshot_" ) != std::string::npos )
-    {
-      vtkMRMLScalarVolumeNode* snapshotTexture = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( snapshotModel->GetAttribute("TextureNodeID") ) );    
-      if ( snapshotTexture != NULL )
-      {
-        this->GetMRMLScene()->RemoveNode( snapshotTexture );
-        snapshotTexture = NULL;
-      }
-      this->GetMRMLScene()->RemoveNode( snapshotModel );
-      this->snapshotCounter--;
-    }
+    points->SetPoint( 4 * location.AtlasQuadIndex + cornerIndex, cornersRAS[ cornerIndex ] );
   }
+  points->Modified();
+  polyData->Modified();
+  // The compounded volume keeps the replaced frame, only the new one is added
+  this->CompoundSnapshot( page.Texture.Image, location.AtlasOffset[ 0 ], location.AtlasOffset[ 1 ], dims[ 0 ], dims[ 1 ], cornersRAS, true );
+  return true;
 }
 
 
 
-//---------------------------------------------------------------------------
-void vtkSlicerUltrasoundSnapshotsLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::RemoveSnapshotModel( const std::string& modelNodeID )
 {
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndImportEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  events->InsertNextValue(vtkMRMLScene::StartCloseEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( modelNodeID.c_str() ) );
+  if ( snapshotModel == NULL )
+  {
+    return; // already removed
+  }
+  if ( snapshotModel->GetDisplayNode() != NULL )
+  {
+    this->GetMRMLScene()->RemoveNode( snapshotModel->GetDisplayNode() );
+  }
+  this->GetMRMLScene()->RemoveNode( snapshotModel ); // the texture is returned to the pool in OnMRMLSceneNodeRemoved
+  this->snapshotCounter--;
 }
 
-//-----------------------------------------------------------------------------
-void vtkSlicerUltrasoundSnapshotsLogic::RegisterNodes()
-{
-  assert(this->GetMRMLScene() != 0);
-}
 
-//---------------------------------------------------------------------------
-void vtkSlicerUltrasoundSnapshotsLogic::UpdateFromMRMLScene()
-{
-  assert(this->GetMRMLScene() != 0);
-}
 
-//---------------------------------------------------------------------------
-void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneEndImport()
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::StartSweep( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel )
 {
-  assert(this->GetMRMLScene() != 0);
-
-  vtkCollection* snapshotNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLModelNode" );
-  vtkCollectionIterator* snapshotIt = vtkCollectionIterator::New();
-  snapshotIt->SetCollection( snapshotNodes );
-  
-  for ( snapshotIt->InitTraversal(); ! snapshotIt->IsDoneWithTraversal(); snapshotIt->GoToNextItem() )
+  this->StopSweep();
+  if ( InputNode == NULL )
   {
-    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( snapshotIt->GetCurrentObject() );
-    if ( snapshotModel != NULL && std::string(snapshotModel->GetName()).find( "UltrasoundSnapshots_Snapshot_" ) != std::string::npos )
-    {
-      vtkMRMLScalarVolumeNode* snapshotTexture = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( snapshotModel->GetAttribute("TextureNodeID") ) );
-      if ( snapshotTexture != NULL )
-      {
-
-#if (VTK_MAJOR_VERSION <= 5)
-        snapshotModel->GetModelDisplayNode()->SetAndObserveTextureImageData( snapshotTexture->GetImageData() );
-#else
-        snapshotModel->GetDisplayNode()->SetTextureImageDataConnection( snapshotTexture->GetImageDataConnection() );
-#endif  
-  
-        this->snapshotCounter++;
-      }        
-    }
+    vtkErrorMacro( "StartSweep: No input image. Sweep is not started." );
+    return;
   }
+  this->SweepInputNode = InputNode;
+  this->SweepPreserveWindowLevel = preserveWindowLevel;
+  this->SweepHasLastPose = false;
+  this->ObserveInputNodeEvents( InputNode );
   
-  snapshotIt->Delete();
-  snapshotNodes->Delete();
-  
+  // the current frame is the first snapshot of the sweep
+  this->ProcessSweepFrame();
   this->Modified();
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneStartClose()
-{
-  assert(this->GetMRMLScene() != 0);
 
-  vtkCollection* snapshotNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLModelNode" );
-  vtkCollectionIterator* snapshotIt = vtkCollectionIterator::New();
-  snapshotIt->SetCollection( snapshotNodes );
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::StopSweep()
+{
+  if ( this->SweepInputNode == NULL )
+  {
+    return;
+  }
+  vtkMRMLScalarVolumeNode* InputNode = this->SweepInputNode;
+  this->SweepInputNode = NULL;
+  vtkUnObserveMRMLNodeMacro( InputNode );
+  if ( InputNode == this->LiveImageInputNode.GetPointer() )
+  {
+    this->ObserveInputNodeEvents( InputNode );
+  }
+  this->SweepSnapshots.clear(); // snapshots are kept, but a new sweep has a new ring buffer
+  this->Modified();
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::IsSweepActive()
+{
+  return this->SweepInputNode != NULL;
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ObserveInputNodeEvents( vtkMRMLScalarVolumeNode* InputNode )
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  if ( InputNode == this->LiveImageInputNode.GetPointer() )
+  {
+    // the image pose is changed either by its parent transform or by its IJK to RAS matrix
+    events->InsertNextValue( vtkMRMLTransformableNode::TransformModifiedEvent );
+    events->InsertNextValue( vtkCommand::ModifiedEvent );
+  }
+  vtkObserveMRMLNodeEventsMacro( InputNode, events.GetPointer() );
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ShowLiveImagePlane( vtkMRMLScalarVolumeNode* InputNode )
+{
+  if ( InputNode == NULL )
+  {
+    vtkErrorMacro( "ShowLiveImagePlane: No input image." );
+    return;
+  }
+  if ( InputNode == this->LiveImageInputNode.GetPointer() && this->LiveImagePlaneModelNode != NULL )
+  {
+    return; // already shown
+  }
+  this->HideLiveImagePlane();
+  
+  vtkSmartPointer< vtkMRMLModelDisplayNode > planeDisp = this->CreateSnapshotDisplayNode();
+  vtkSmartPointer< vtkMRMLModelNode > planeModel = vtkSmartPointer< vtkMRMLModelNode >::New();
+  this->GetMRMLScene()->AddNode( planeModel );
+  planeModel->SetName( "UltrasoundSnapshots_LiveImagePlane" );
+  planeModel->SetScene( this->GetMRMLScene() );
+  planeModel->SetAndObserveDisplayNodeID( planeDisp->GetID() );
+  planeModel->SetHideFromEditors( 1 );
+  planeModel->SetSaveWithScene( 0 );
+  vtkSmartPointer< vtkPlaneSource > plane = vtkSmartPointer< vtkPlaneSource >::New();
+  plane->Update();
+  planeModel->SetAndObservePolyData( plane->GetOutput() );
+  
+  this->LiveImageInputNode = InputNode;
+  this->LiveImagePlaneModelNode = planeModel;
+  this->LiveImageTextureIsInputImage = false;
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+  {
+    std::fill( this->LiveImageCornersRAS[ cornerIndex ], this->LiveImageCornersRAS[ cornerIndex ] + 3, 0.0 );
+  }
+  this->ObserveInputNodeEvents( InputNode );
+  this->UpdateLiveImagePlane( true );
+  this->Modified();
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::HideLiveImagePlane()
+{
+  vtkMRMLScalarVolumeNode* InputNode = this->LiveImageInputNode;
+  vtkMRMLModelNode* planeModel = this->LiveImagePlaneModelNode;
+  if ( InputNode == NULL && planeModel == NULL )
+  {
+    return;
+  }
+  this->LiveImageInputNode = NULL;
+  this->LiveImagePlaneModelNode = NULL;
+  if ( InputNode != NULL )
+  {
+    vtkUnObserveMRMLNodeMacro( InputNode );
+    if ( InputNode == this->SweepInputNode.GetPointer() )
+    {
+      this->ObserveInputNodeEvents( InputNode );
+    }
+  }
+  if ( planeModel != NULL && this->GetMRMLScene() != NULL )
+  {
+    if ( planeModel->GetDisplayNode() != NULL )
+    {
+      this->GetMRMLScene()->RemoveNode( planeModel->GetDisplayNode() );
+    }
+    this->GetMRMLScene()->RemoveNode( planeModel );
+  }
+  if ( this->LiveImageTexture.Image != NULL )
+  {
+    this->ReleaseTextureToPool( this->LiveImageTexture );
+    this->LiveImageTexture = SnapshotTexture();
+  }
+  this->Modified();
+}
+
+
+
+vtkMRMLModelNode*
+vtkSlicerUltrasoundSnapshotsLogic
+::GetLiveImagePlaneModelNode()
+{
+  return this->LiveImagePlaneModelNode;
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::UpdateLiveImagePlane( bool imageModified )
+{
+  vtkMRMLScalarVolumeNode* InputNode = this->LiveImageInputNode;
+  vtkMRMLModelNode* planeModel = this->LiveImagePlaneModelNode;
+  if ( InputNode == NULL || InputNode->GetImageData() == NULL || planeModel == NULL || planeModel->GetModelDisplayNode() == NULL )
+  {
+    return;
+  }
+  vtkImageData* inputImage = InputNode->GetImageData();
+  int dims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( dims );
+  if ( dims[ 0 ] == 0 || dims[ 1 ] == 0 || dims[ 2 ] != 1 )
+  {
+    return; // only 2D frames are shown
+  }
+  
+  if ( imageModified )
+  {
+    vtkMRMLModelDisplayNode* planeDisp = planeModel->GetModelDisplayNode();
+    if ( inputImage->GetScalarType() == VTK_UNSIGNED_CHAR )
+    {
+      // The texture is connected to the image of the volume node, the renderer updates it when the image is modified
+      if ( ! this->LiveImageTextureIsInputImage )
+      {
+        planeDisp->SetTextureImageDataConnection( InputNode->GetImageDataConnection() );
+        this->LiveImageTextureIsInputImage = true;
+      }
+    }
+    else
+    {
+      int textureDims[ 3 ] = { 0, 0, 0 };
+      if ( this->LiveImageTexture.Image != NULL )
+      {
+        this->LiveImageTexture.Image->GetDimensions( textureDims );
+      }
+      bool textureChanged = ! std::equal( dims, dims + 3, textureDims );
+      if ( textureChanged )
+      {
+        if ( this->LiveImageTexture.Image != NULL )
+        {
+          this->ReleaseTextureToPool( this->LiveImageTexture );
+        }
+        this->LiveImageTexture = this->GetTextureFromPool( dims );
+      }
+      double window = 0.0;
+      double level = 0.0;
+      this->ComputeSnapshotWindowLevel( InputNode, true, window, level );
+      MapImageToTexture( inputImage, window, level, this->LiveImageTexture.Image, 0, 0 );
+      if ( textureChanged || this->LiveImageTextureIsInputImage )
+      {
+        planeDisp->SetTextureImageDataConnection( this->LiveImageTexture.Producer->GetOutputPort() );
+        this->LiveImageTextureIsInputImage = false;
+      }
+    }
+  }
+  
+  // Only modify the plane if it moved, so that a new frame at the same pose only updates the texture
+  double cornersRAS[ 4 ][ 3 ];
+  this->ComputeSnapshotCorners( InputNode, dims, cornersRAS );
+  bool moved = false;
+  for ( int cornerIndex = 0; cornerIndex < 4 && ! moved; cornerIndex++ )
+  {
+    moved = ! std::equal( cornersRAS[ cornerIndex ], cornersRAS[ cornerIndex ] + 3, this->LiveImageCornersRAS[ cornerIndex ] );
+  }
+  if ( ! moved )
+  {
+    return;
+  }
+  vtkPoints* planePoints = planeModel->GetPolyData()->GetPoints();
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+  {
+    planePoints->SetPoint( cornerIndex, cornersRAS[ cornerIndex ] );
+    std::copy( cornersRAS[ cornerIndex ], cornersRAS[ cornerIndex ] + 3, this->LiveImageCornersRAS[ cornerIndex ] );
+  }
+  planePoints->Modified();
+  planeModel->GetPolyData()->Modified();
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( caller != NULL && ( caller == this->SweepInputNode.GetPointer() || caller == this->LiveImageInputNode.GetPointer() ) )
+  {
+    // The live image plane is updated first, so that it shows the frame that a sweep snapshot is taken of
+    if ( caller == this->LiveImageInputNode.GetPointer() )
+    {
+      this->UpdateLiveImagePlane( event == vtkMRMLVolumeNode::ImageDataModifiedEvent );
+    }
+    if ( caller == this->SweepInputNode.GetPointer() && event == vtkMRMLVolumeNode::ImageDataModifiedEvent )
+    {
+      this->ProcessSweepFrame();
+    }
+    return;
+  }
+  this->Superclass::ProcessMRMLNodesEvents( caller, event, callData );
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ProcessSweepFrame()
+{
+  vtkMRMLScalarVolumeNode* InputNode = this->SweepInputNode;
+  if ( InputNode == NULL || InputNode->GetImageData() == NULL )
+  {
+    return;
+  }
+  int dims[ 3 ] = { 0, 0, 0 };
+  InputNode->GetImageData()->GetDimensions( dims );
+  if ( dims[ 0 ] == 0  &&  dims[ 1 ] == 0  && dims[ 2 ] == 0 )
+  {
+    return;
+  }
+  
+  // Decide from the pose only, so rejected frames cost a few matrix multiplications and are never copied
+  double cornersRAS[ 4 ][ 3 ];
+  this->ComputeSnapshotCorners( InputNode, dims, cornersRAS );
+  if ( this->SweepHasLastPose )
+  {
+    // Frame axes and center
+    double axes[ 2 ][ 3 ][ 3 ];
+    double centers[ 2 ][ 3 ];
+    double ( *corners[ 2 ] )[ 3 ] = { this->SweepLastCornersRAS, cornersRAS };
+    for ( int frame = 0; frame < 2; frame++ )
+    {
+      vtkMath::Subtract( corners[ frame ][ 1 ], corners[ frame ][ 0 ], axes[ frame ][ 0 ] );
+      vtkMath::Subtract( corners[ frame ][ 2 ], corners[ frame ][ 0 ], axes[ frame ][ 1 ] );
+      vtkMath::Normalize( axes[ frame ][ 0 ] );
+      vtkMath::Normalize( axes[ frame ][ 1 ] );
+      vtkMath::Cross( axes[ frame ][ 0 ], axes[ frame ][ 1 ], axes[ frame ][ 2 ] );
+      vtkMath::Normalize( axes[ frame ][ 2 ] );
+      for ( int i = 0; i < 3; i++ )
+      {
+        centers[ frame ][ i ] = 0.5 * ( corners[ frame ][ 0 ][ i ] + corners[ frame ][ 3 ][ i ] );
+      }
+    }
+    double distanceMm = sqrt( vtkMath::Distance2BetweenPoints( centers[ 0 ], centers[ 1 ] ) );
+    // trace of the relative rotation is the sum of the dot products of the corresponding axes
+    double trace = vtkMath::Dot( axes[ 0 ][ 0 ], axes[ 1 ][ 0 ] ) + vtkMath::Dot( axes[ 0 ][ 1 ], axes[ 1 ][ 1 ] ) + vtkMath::Dot( axes[ 0 ][ 2 ], axes[ 1 ][ 2 ] );
+    double cosAngle = std::max( -1.0, std::min( 1.0, 0.5 * ( trace - 1.0 ) ) );
+    double angleDeg = vtkMath::DegreesFromRadians( acos( cosAngle ) );
+    if ( distanceMm < this->SweepMinimumDistanceMm && angleDeg < this->SweepMinimumAngleDeg )
+    {
+      return;
+    }
+  }
+  
+  // Ring buffer: the oldest snapshot is replaced. Atlas snapshots are overwritten in place,
+  // separate snapshot models are removed, and their texture is reused from the pool.
+  bool added = false;
+  SnapshotLocation location;
+  if ( this->SweepMaximumNumberOfSnapshots > 0 && ( int )this->SweepSnapshots.size() >= this->SweepMaximumNumberOfSnapshots )
+  {
+    location = this->SweepSnapshots.front();
+    this->SweepSnapshots.pop_front();
+    if ( location.AtlasPageIndex >= 0 )
+    {
+      double window = 0.0;
+      double level = 0.0;
+      this->ComputeSnapshotWindowLevel( InputNode, this->SweepPreserveWindowLevel, window, level );
+      added = this->ReplaceAtlasSnapshot( location, InputNode->GetImageData(), cornersRAS, window, level );
+    }
+    else
+    {
+      this->RemoveSnapshotModel( location.ModelNodeID );
+    }
+  }
+  if ( ! added )
+  {
+    location = SnapshotLocation();
+    added = this->AddSnapshotInternal( InputNode, this->SweepPreserveWindowLevel, location );
+  }
+  if ( ! added )
+  {
+    return;
+  }
+  
+  this->SweepSnapshots.push_back( location );
+  this->SweepHasLastPose = true;
+  for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+  {
+    std::copy( cornersRAS[ cornerIndex ], cornersRAS[ cornerIndex ] + 3, this->SweepLastCornersRAS[ cornerIndex ] );
+  }
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::SetCompoundingVolumeNode( vtkMRMLScalarVolumeNode* volumeNode )
+{
+  this->CompoundingVolumeNode = volumeNode;
+  if ( volumeNode == NULL )
+  {
+    this->Compounder->Reset();
+    return;
+  }
+  int dims[ 3 ] = { 0, 0, 0 };
+  if ( volumeNode->GetImageData() != NULL )
+  {
+    volumeNode->GetImageData()->GetDimensions( dims );
+  }
+  if ( dims[ 0 ] <= 0 || dims[ 1 ] <= 0 || dims[ 2 ] <= 0 )
+  {
+    vtkErrorMacro( "SetCompoundingVolumeNode: The volume must have an image that defines the voxel grid." );
+    this->CompoundingVolumeNode = NULL;
+    return;
+  }
+  
+  // Snapshot corners are in world coordinates, so the voxel grid is defined in world coordinates as well
+  vtkSmartPointer< vtkMatrix4x4 > ijkToWorldMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  volumeNode->GetIJKToRASMatrix( ijkToWorldMatrix );
+  if ( volumeNode->GetParentTransformNode() != NULL )
+  {
+    vtkSmartPointer< vtkMatrix4x4 > parentToWorldMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+    volumeNode->GetParentTransformNode()->GetMatrixTransformToWorld( parentToWorldMatrix );
+    vtkMatrix4x4::Multiply4x4( parentToWorldMatrix, ijkToWorldMatrix, ijkToWorldMatrix );
+  }
+  this->Compounder->SetOutputGeometry( dims, ijkToWorldMatrix );
+  volumeNode->SetAndObserveImageData( this->Compounder->GetOutput() );
+  
+  // Compound the existing snapshots in a single multithreaded pass
+  for ( std::map< std::string, SnapshotTexture >::iterator textureIt = this->SnapshotTextures.begin(); textureIt != this->SnapshotTextures.end(); ++textureIt )
+  {
+    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( textureIt->first.c_str() ) );
+    if ( snapshotModel == NULL || snapshotModel->GetPolyData() == NULL || snapshotModel->GetPolyData()->GetNumberOfPoints() < 4 )
+    {
+      continue;
+    }
+    // the compounder copies the pixels, so compressed snapshots are only decompressed temporarily
+    vtkSmartPointer< vtkImageData > textureImage = GetFullResolutionImage( textureIt->second );
+    if ( textureImage == NULL )
+    {
+      continue;
+    }
+    int textureDims[ 3 ] = { 0, 0, 0 };
+    textureImage->GetDimensions( textureDims );
+    double cornersRAS[ 4 ][ 3 ];
+    for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+    {
+      snapshotModel->GetPolyData()->GetPoint( cornerIndex, cornersRAS[ cornerIndex ] );
+    }
+    this->CompoundSnapshot( textureImage, 0, 0, textureDims[ 0 ], textureDims[ 1 ], cornersRAS, false );
+  }
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
+  {
+    if ( pageIt->ModelNode == NULL )
+    {
+      continue;
+    }
+    vtkPoints* points = pageIt->ModelNode->GetPolyData()->GetPoints();
+    int numberOfQuads = ( int )pageIt->QuadRegions.size() / 4;
+    for ( int quadIndex = 0; quadIndex < numberOfQuads && 4 * ( quadIndex + 1 ) <= points->GetNumberOfPoints(); quadIndex++ )
+    {
+      const int* region = &( pageIt->QuadRegions[ 4 * quadIndex ] );
+      double cornersRAS[ 4 ][ 3 ];
+      for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+      {
+        points->GetPoint( 4 * quadIndex + cornerIndex, cornersRAS[ cornerIndex ] );
+      }
+      this->CompoundSnapshot( pageIt->Texture.Image, region[ 0 ], region[ 1 ], region[ 2 ], region[ 3 ], cornersRAS, false );
+    }
+  }
+  this->Compounder->Update();
+}
+
+
+
+vtkMRMLScalarVolumeNode*
+vtkSlicerUltrasoundSnapshotsLogic
+::GetCompoundingVolumeNode()
+{
+  return this->CompoundingVolumeNode;
+}
+
+
+
+int
+vtkSlicerUltrasoundSnapshotsLogic
+::FillCompoundingVolumeHoles( int radiusVoxels )
+{
+  if ( this->CompoundingVolumeNode == NULL )
+  {
+    vtkWarningMacro( "FillCompoundingVolumeHoles: No compounding volume is set." );
+    return 0;
+  }
+  return this->Compounder->FillHoles( radiusVoxels );
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::CompoundSnapshot( vtkImageData* textureImage, int offsetX, int offsetY, int width, int height, double cornersRAS[ 4 ][ 3 ], bool update )
+{
+  if ( this->CompoundingVolumeNode == NULL || textureImage == NULL )
+  {
+    return;
+  }
+  int textureDims[ 3 ] = { 0, 0, 0 };
+  textureImage->GetDimensions( textureDims );
+  const unsigned char* pixels = static_cast< unsigned char* >( textureImage->GetScalarPointer() ) + offsetY * textureDims[ 0 ] + offsetX;
+  this->Compounder->AddFrame( pixels, width, height, textureDims[ 0 ], cornersRAS );
+  if ( update )
+  {
+    this->Compounder->Update();
+  }
+}
+
+
+
+vtkSlicerUltrasoundSnapshotsLogic::AtlasPage*
+vtkSlicerUltrasoundSnapshotsLogic
+::CreateAtlasPage()
+{
+  AtlasPage page;
+  page.CursorX = 0;
+  page.CursorY = 0;
+  page.RowHeight = 0;
+  page.Texture.Image = vtkSmartPointer< vtkImageData >::New();
+  page.Texture.Image->SetDimensions( this->TextureAtlasSize, this->TextureAtlasSize, 1 );
+  page.Texture.Image->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+  memset( page.Texture.Image->GetScalarPointer(), 0, this->TextureAtlasSize * this->TextureAtlasSize );
+  page.Texture.Producer = vtkSmartPointer< vtkTrivialProducer >::New();
+  page.Texture.Producer->SetOutput( page.Texture.Image );
+  
+  vtkSmartPointer< vtkPolyData > polyData = vtkSmartPointer< vtkPolyData >::New();
+  polyData->SetPoints( vtkSmartPointer< vtkPoints >::New() );
+  polyData->SetPolys( vtkSmartPointer< vtkCellArray >::New() );
+  vtkSmartPointer< vtkFloatArray > textureCoordinates = vtkSmartPointer< vtkFloatArray >::New();
+  textureCoordinates->SetName( "TextureCoordinates" );
+  textureCoordinates->SetNumberOfComponents( 2 );
+  polyData->GetPointData()->SetTCoords( textureCoordinates );
+  
+  vtkSmartPointer< vtkMRMLModelDisplayNode > atlasDisp = this->CreateSnapshotDisplayNode();
+  
+  std::stringstream nameStream;
+  nameStream << "UltrasoundSnapshots_Atlas_";
+  nameStream << this->AtlasPages.size() + 1;
+  
+  vtkSmartPointer< vtkMRMLModelNode > atlasModel = vtkSmartPointer< vtkMRMLModelNode >::New();
+  this->GetMRMLScene()->AddNode( atlasModel );
+  atlasModel->SetName( nameStream.str().c_str() );
+  atlasModel->SetDescription( "Live Ultrasound Snapshots" );
+  atlasModel->SetScene( this->GetMRMLScene() );
+  atlasModel->SetAndObserveDisplayNodeID( atlasDisp->GetID() );
+  atlasModel->SetHideFromEditors( 0 );
+  atlasModel->SetSaveWithScene( 0 );
+  atlasModel->SetAndObservePolyData( polyData );
+  atlasDisp->SetTextureImageDataConnection( page.Texture.Producer->GetOutputPort() );
+  page.ModelNode = atlasModel;
+  
+  this->AtlasPages.push_back( page );
+  return &( this->AtlasPages.back() );
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ClearSnapshots()
+{
+  // Views and other observers are only updated once, after all snapshots are removed
+  this->GetMRMLScene()->StartState( vtkMRMLScene::BatchProcessState );
+  
+  // The registry is updated by OnMRMLSceneNodeRemoved, so iterate over a copy
+  std::set< std::string > snapshotModelNodeIDs;
+  snapshotModelNodeIDs.swap( this->SnapshotModelNodeIDs );
+  for ( std::set< std::string >::iterator snapshotIt = snapshotModelNodeIDs.begin(); snapshotIt != snapshotModelNodeIDs.end(); ++snapshotIt )
+  {
+    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( snapshotIt->c_str() ) );
+    if ( snapshotModel == NULL )
+    {
+      continue;
+    }
+    // snapshots of scenes saved before the textures were pooled have a texture volume node
+    vtkMRMLScalarVolumeNode* snapshotTexture = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( snapshotModel->GetAttribute("TextureNodeID") ) );    
+    if ( snapshotTexture != NULL )
+    {
+      this->GetMRMLScene()->RemoveNode( snapshotTexture );
+      snapshotTexture = NULL;
+    }
+    if ( snapshotModel->GetDisplayNode() != NULL )
+    {
+      this->GetMRMLScene()->RemoveNode( snapshotModel->GetDisplayNode() );
+    }
+    this->GetMRMLScene()->RemoveNode( snapshotModel ); // the texture is returned to the pool in OnMRMLSceneNodeRemoved
+    this->snapshotCounter--;
+  }
+  
+  // Atlas pages hold many snapshots each
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
+  {
+    vtkMRMLModelNode* atlasModel = pageIt->ModelNode;
+    if ( atlasModel == NULL )
+    {
+      continue;
+    }
+    this->snapshotCounter -= atlasModel->GetPolyData()->GetNumberOfPolys();
+    if ( atlasModel->GetDisplayNode() != NULL )
+    {
+      this->GetMRMLScene()->RemoveNode( atlasModel->GetDisplayNode() );
+    }
+    this->GetMRMLScene()->RemoveNode( atlasModel );
+  }
+  this->AtlasPages.clear();
+  this->SweepSnapshots.clear();
+  
+  this->GetMRMLScene()->EndState( vtkMRMLScene::BatchProcessState );
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::SaveSnapshotArchive( const char* fileName )
+{
+  if ( fileName == NULL )
+  {
+    vtkErrorMacro( "SaveSnapshotArchive: Invalid file name." );
+    return false;
+  }
+  
+  // Copy the frames and corners, so snapshots can be modified while the archive is written
+  std::vector< vtkInternal::Frame > frames;
+  for ( std::map< std::string, SnapshotTexture >::iterator textureIt = this->SnapshotTextures.begin(); textureIt != this->SnapshotTextures.end(); ++textureIt )
+  {
+    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( textureIt->first.c_str() ) );
+    if ( snapshotModel == NULL || snapshotModel->GetPolyData() == NULL || snapshotModel->GetPolyData()->GetNumberOfPoints() < 4 )
+    {
+      continue;
+    }
+    vtkSmartPointer< vtkImageData > textureImage = GetFullResolutionImage( textureIt->second );
+    if ( textureImage == NULL )
+    {
+      vtkErrorMacro( "SaveSnapshotArchive: Failed to decompress snapshot " << textureIt->first << "." );
+      continue;
+    }
+    int dims[ 3 ] = { 0, 0, 0 };
+    textureImage->GetDimensions( dims );
+    vtkInternal::Frame frame;
+    frame.Dims[ 0 ] = dims[ 0 ];
+    frame.Dims[ 1 ] = dims[ 1 ] * dims[ 2 ];
+    for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+    {
+      snapshotModel->GetPolyData()->GetPoint( cornerIndex, frame.CornersRAS + 3 * cornerIndex );
+    }
+    unsigned char* pixels = static_cast< unsigned char* >( textureImage->GetScalarPointer() );
+    frame.Pixels.assign( pixels, pixels + frame.Dims[ 0 ] * frame.Dims[ 1 ] );
+    frames.push_back( frame );
+  }
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
+  {
+    if ( pageIt->ModelNode == NULL )
+    {
+      continue;
+    }
+    vtkPoints* points = pageIt->ModelNode->GetPolyData()->GetPoints();
+    unsigned char* atlasPixels = static_cast< unsigned char* >( pageIt->Texture.Image->GetScalarPointer() );
+    int numberOfQuads = ( int )( pageIt->QuadRegions.size() / 4 );
+    for ( int quadIndex = 0; quadIndex < numberOfQuads; quadIndex++ )
+    {
+      int* region = &( pageIt->QuadRegions[ 4 * quadIndex ] );
+      vtkInternal::Frame frame;
+      frame.Dims[ 0 ] = region[ 2 ];
+      frame.Dims[ 1 ] = region[ 3 ];
+      for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+      {
+        points->GetPoint( 4 * quadIndex + cornerIndex, frame.CornersRAS + 3 * cornerIndex );
+      }
+      frame.Pixels.resize( region[ 2 ] * region[ 3 ] );
+      for ( int row = 0; row < region[ 3 ]; row++ )
+      {
+        memcpy( &( frame.Pixels[ row * region[ 2 ] ] ), atlasPixels + ( region[ 1 ] + row ) * this->TextureAtlasSize + region[ 0 ], region[ 2 ] );
+      }
+      frames.push_back( frame );
+    }
+  }
+  
+  if ( ! this->Internal->StartWrite( fileName, frames ) )
+  {
+    vtkErrorMacro( "SaveSnapshotArchive: Failed to start writing " << fileName << "." );
+    return false;
+  }
+  return true;
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::IsSnapshotArchiveWriteInProgress()
+{
+  return this->Internal->IsWriteInProgress();
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::WaitForSnapshotArchiveWrite()
+{
+  return this->Internal->WaitForWrite();
+}
+
+
+
+int
+vtkSlicerUltrasoundSnapshotsLogic
+::LoadSnapshotArchive( const char* fileName )
+{
+  std::ifstream archiveFile( fileName, std::ios::in | std::ios::binary );
+  char magic[ sizeof( ARCHIVE_MAGIC ) ];
+  vtkTypeInt32 numberOfFrames = 0;
+  if ( ! archiveFile.read( magic, sizeof( magic ) ) || memcmp( magic, ARCHIVE_MAGIC, sizeof( magic ) ) != 0
+    || ! archiveFile.read( reinterpret_cast< char* >( &numberOfFrames ), sizeof( numberOfFrames ) ) || numberOfFrames < 0 )
+  {
+    vtkErrorMacro( "LoadSnapshotArchive: " << ( fileName ? fileName : "(null)" ) << " is not a snapshot archive." );
+    return 0;
+  }
+  
+  // Read the whole frame table first, then the frames in file order
+  std::vector< char > frameTable( numberOfFrames * ARCHIVE_FRAME_RECORD_SIZE );
+  if ( numberOfFrames > 0 && ! archiveFile.read( &( frameTable[ 0 ] ), frameTable.size() ) )
+  {
+    vtkErrorMacro( "LoadSnapshotArchive: Failed to read the frame table of " << fileName << "." );
+    return 0;
+  }
+  
+  this->GetMRMLScene()->StartState( vtkMRMLScene::BatchProcessState );
+  
+  // Frames are decompressed into a reused buffer and copied into the snapshot textures without conversion
+  vtkNew< vtkZLibDataCompressor > compressor;
+  vtkNew< vtkImageData > frameImage;
+  std::vector< unsigned char > compressedPixels;
+  int numberOfLoadedFrames = 0;
+  for ( int frameIndex = 0; frameIndex < numberOfFrames; frameIndex++ )
+  {
+    const char* record = &( frameTable[ frameIndex * ARCHIVE_FRAME_RECORD_SIZE ] );
+    vtkTypeInt32 dims[ 2 ] = { 0, 0 };
+    double cornersRAS[ 4 ][ 3 ];
+    vtkTypeUInt64 offset = 0;
+    vtkTypeUInt64 compressedSize = 0;
+    memcpy( dims, record, sizeof( dims ) );
+    memcpy( cornersRAS, record + sizeof( dims ), sizeof( cornersRAS ) );
+    memcpy( &offset, record + sizeof( dims ) + sizeof( cornersRAS ), sizeof( offset ) );
+    memcpy( &compressedSize, record + sizeof( dims ) + sizeof( cornersRAS ) + sizeof( offset ), sizeof( compressedSize ) );
+    if ( dims[ 0 ] <= 0 || dims[ 1 ] <= 0 || compressedSize == 0 )
+    {
+      continue;
+    }
+    
+    compressedPixels.resize( compressedSize );
+    archiveFile.seekg( offset );
+    if ( ! archiveFile.read( reinterpret_cast< char* >( &( compressedPixels[ 0 ] ) ), compressedSize ) )
+    {
+      vtkErrorMacro( "LoadSnapshotArchive: " << fileName << " is truncated, only " << numberOfLoadedFrames << " snapshots are loaded." );
+      break;
+    }
+    int frameDims[ 3 ] = { 0, 0, 0 };
+    frameImage->GetDimensions( frameDims );
+    if ( frameDims[ 0 ] != dims[ 0 ] || frameDims[ 1 ] != dims[ 1 ] || frameImage->GetPointData()->GetScalars() == NULL )
+    {
+      frameImage->SetDimensions( dims[ 0 ], dims[ 1 ], 1 );
+      frameImage->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+    }
+    size_t frameSize = ( size_t )dims[ 0 ] * dims[ 1 ];
+    if ( compressor->Uncompress( &( compressedPixels[ 0 ] ), compressedSize, static_cast< unsigned char* >( frameImage->GetScalarPointer() ), frameSize ) != frameSize )
+    {
+      vtkErrorMacro( "LoadSnapshotArchive: Failed to decompress frame " << frameIndex << " of " << fileName << "." );
+      continue;
+    }
+    
+    SnapshotLocation location;
+    if ( this->AddSnapshotFromImage( frameImage.GetPointer(), cornersRAS, 255.0, 127.5, location ) ) // identity window/level
+    {
+      numberOfLoadedFrames++;
+    }
+  }
+  
+  this->GetMRMLScene()->EndState( vtkMRMLScene::BatchProcessState );
+  return numberOfLoadedFrames;
+}
+
+
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndImportEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  events->InsertNextValue(vtkMRMLScene::StartCloseEvent);
+  events->InsertNextValue(vtkMRMLScene::StartSaveEvent);
+  events->InsertNextValue(vtkMRMLScene::EndSaveEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::RegisterNodes()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::UpdateFromMRMLScene()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneEndImport()
+{
+  assert(this->GetMRMLScene() != 0);
+
+  vtkCollection* snapshotNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLModelNode" );
+  vtkCollectionIterator* snapshotIt = vtkCollectionIterator::New();
+  snapshotIt->SetCollection( snapshotNodes );
+  
+  for ( snapshotIt->InitTraversal(); ! snapshotIt->IsDoneWithTraversal(); snapshotIt->GoToNextItem() )
+  {
+    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( snapshotIt->GetCurrentObject() );
+    if ( snapshotModel != NULL && std::string(snapshotModel->GetName()).find( "UltrasoundSnapshots_Snapshot_" ) != std::string::npos )
+    {
+      // Snapshots of the imported scene are registered once here, so they are cleared like new ones
+      vtkMRMLScalarVolumeNode* snapshotTexture = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( snapshotModel->GetAttribute("TextureNodeID") ) );
+      if ( snapshotTexture != NULL )
+      {
+        this->SnapshotModelNodeIDs.insert( snapshotModel->GetID() );
+
+#if (VTK_MAJOR_VERSION <= 5)
+        snapshotModel->GetModelDisplayNode()->SetAndObserveTextureImageData( snapshotTexture->GetImageData() );
+#else
+        snapshotModel->GetDisplayNode()->SetTextureImageDataConnection( snapshotTexture->GetImageDataConnection() );
+#endif  
+  
+        this->snapshotCounter++;
+      }        
+    }
+  }
+  
+  snapshotIt->Delete();
+  snapshotNodes->Delete();
+  
+  // Snapshots that were saved with the scene
+  if ( this->GetMRMLScene()->GetRootDirectory() != NULL )
+  {
+    std::string archiveFileName = std::string( this->GetMRMLScene()->GetRootDirectory() ) + "/" + GetSceneSnapshotArchiveFileName();
+    std::ifstream archiveFile( archiveFileName.c_str() );
+    if ( archiveFile.good() )
+    {
+      archiveFile.close();
+      this->LoadSnapshotArchive( archiveFileName.c_str() );
+    }
+  }
+  
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::ProcessMRMLSceneEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( event == vtkMRMLScene::StartSaveEvent )
+  {
+    this->OnMRMLSceneStartSave();
+  }
+  else if ( event == vtkMRMLScene::EndSaveEvent )
+  {
+    this->OnMRMLSceneEndSave();
+  }
+  this->Superclass::ProcessMRMLSceneEvents( caller, event, callData );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneStartSave()
+{
+  if ( this->GetMRMLScene() == NULL || this->GetMRMLScene()->GetRootDirectory() == NULL )
+  {
+    return;
+  }
+  std::string archiveFileName = std::string( this->GetMRMLScene()->GetRootDirectory() ) + "/" + GetSceneSnapshotArchiveFileName();
+  if ( this->SnapshotTextures.empty() && this->AtlasPages.empty() )
+  {
+    // do not leave the snapshots of a previous save in the scene directory
+    this->Internal->WaitForWrite();
+    std::remove( archiveFileName.c_str() );
+    return;
+  }
+  // The archive is compressed while the rest of the scene is written
+  this->SaveSnapshotArchive( archiveFileName.c_str() );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneEndSave()
+{
+  // The scene directory may be packed into a bundle right after saving, so the archive must be complete
+  if ( ! this->WaitForSnapshotArchiveWrite() )
+  {
+    vtkErrorMacro( "OnMRMLSceneEndSave: Failed to write the snapshot archive." );
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerUltrasoundSnapshotsLogic::OnMRMLSceneStartClose()
+{
+  assert(this->GetMRMLScene() != 0);
+  this->StopSweep();
+  this->LiveImagePlaneModelNode = NULL; // removed with the scene
+  this->HideLiveImagePlane();
+
+  this->snapshotCounter -= ( int )this->SnapshotModelNodeIDs.size();
+  this->SnapshotModelNodeIDs.clear();
+  this->FullResolutionSnapshotIDs.clear();
   
-  for ( snapshotIt->InitTraversal(); ! snapshotIt->IsDoneWithTraversal(); snapshotIt->GoToNextItem() )
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
   {
-    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( snapshotIt->GetCurrentObject() );
-    if ( snapshotModel != NULL && std::string(snapshotModel->GetName()).find( "UltrasoundSnapshots_Snapshot_" ) != std::string::npos )
+    if ( pageIt->ModelNode != NULL && pageIt->ModelNode->GetPolyData() != NULL )
     {
-      this->snapshotCounter--;
+      this->snapshotCounter -= pageIt->ModelNode->GetPolyData()->GetNumberOfPolys();
     }
   }
-  
-  snapshotIt->Delete();
-  snapshotNodes->Delete();
+  this->AtlasPages.clear();
+  this->SweepSnapshots.clear();
   
   this->Modified();
 }
@@ -397,7 +1569,534 @@ void vtkSlicerUltrasoundSnapshotsLogic
 
 //---------------------------------------------------------------------------
 void vtkSlicerUltrasoundSnapshotsLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  if ( node == NULL || node->GetID() == NULL )
+  {
+    return;
+  }
+  if ( node == this->SweepInputNode.GetPointer() )
+  {
+    this->StopSweep();
+  }
+  if ( node == this->LiveImagePlaneModelNode.GetPointer() )
+  {
+    this->LiveImagePlaneModelNode = NULL; // it is being removed already
+    this->HideLiveImagePlane();
+  }
+  else if ( node == this->LiveImageInputNode.GetPointer() )
+  {
+    this->HideLiveImagePlane();
+  }
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
+  {
+    if ( pageIt->ModelNode.GetPointer() == node )
+    {
+      // the page is not used anymore, new snapshots go to a new page
+      pageIt->ModelNode = NULL;
+    }
+  }
+  this->SnapshotModelNodeIDs.erase( node->GetID() );
+  std::deque< std::string >::iterator fullResolutionIt = std::find( this->FullResolutionSnapshotIDs.begin(), this->FullResolutionSnapshotIDs.end(), node->GetID() );
+  if ( fullResolutionIt != this->FullResolutionSnapshotIDs.end() )
+  {
+    this->FullResolutionSnapshotIDs.erase( fullResolutionIt );
+  }
+  std::map< std::string, SnapshotTexture >::iterator textureIt = this->SnapshotTextures.find( node->GetID() );
+  if ( textureIt == this->SnapshotTextures.end() )
+  {
+    return;
+  }
+  this->ReleaseTextureToPool( textureIt->second );
+  this->SnapshotTextures.erase( textureIt );
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::PreallocateSnapshotTextures( vtkMRMLScalarVolumeNode* InputNode, int numberOfSnapshots )
+{
+  if ( InputNode == NULL || InputNode->GetImageData() == NULL )
+  {
+    vtkErrorMacro( "PreallocateSnapshotTextures: No input image. Will not allocate textures." );
+    return;
+  }
+  int dims[ 3 ] = { 0, 0, 0 };
+  InputNode->GetImageData()->GetDimensions( dims );
+  numberOfSnapshots = std::min( numberOfSnapshots, MAXIMUM_TEXTURE_POOL_SIZE );
+  
+  int numberOfMatchingTextures = 0;
+  for ( std::vector< SnapshotTexture >::iterator textureIt = this->TexturePool.begin(); textureIt != this->TexturePool.end(); ++textureIt )
+  {
+    int textureDims[ 3 ] = { 0, 0, 0 };
+    textureIt->Image->GetDimensions( textureDims );
+    if ( std::equal( dims, dims + 3, textureDims ) )
+    {
+      numberOfMatchingTextures++;
+    }
+  }
+  for ( int i = numberOfMatchingTextures; i < numberOfSnapshots; i++ )
+  {
+    SnapshotTexture texture;
+    texture.Image = vtkSmartPointer< vtkImageData >::New();
+    texture.Image->SetDimensions( dims );
+    texture.Image->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+    texture.Producer = vtkSmartPointer< vtkTrivialProducer >::New();
+    texture.Producer->SetOutput( texture.Image );
+    this->ReleaseTextureToPool( texture );
+  }
+}
+
+
+
+vtkSlicerUltrasoundSnapshotsLogic::SnapshotTexture
+vtkSlicerUltrasoundSnapshotsLogic
+::GetTextureFromPool( int dims[ 3 ] )
+{
+  SnapshotTexture texture;
+  
+  // Prefer a texture of the same size, which does not need to be reallocated
+  std::vector< SnapshotTexture >::iterator reusedTextureIt = this->TexturePool.end();
+  for ( std::vector< SnapshotTexture >::iterator textureIt = this->TexturePool.begin(); textureIt != this->TexturePool.end(); ++textureIt )
+  {
+    int textureDims[ 3 ] = { 0, 0, 0 };
+    textureIt->Image->GetDimensions( textureDims );
+    if ( std::equal( dims, dims + 3, textureDims ) )
+    {
+      reusedTextureIt = textureIt;
+      break;
+    }
+  }
+  if ( reusedTextureIt == this->TexturePool.end() && ! this->TexturePool.empty() )
+  {
+    reusedTextureIt = this->TexturePool.end() - 1;
+  }
+  
+  if ( reusedTextureIt != this->TexturePool.end() )
+  {
+    texture = *reusedTextureIt;
+    this->TexturePool.erase( reusedTextureIt );
+  }
+  else
+  {
+    texture.Image = vtkSmartPointer< vtkImageData >::New();
+    texture.Producer = vtkSmartPointer< vtkTrivialProducer >::New();
+    texture.Producer->SetOutput( texture.Image );
+  }
+  
+  int textureDims[ 3 ] = { 0, 0, 0 };
+  texture.Image->GetDimensions( textureDims );
+  if ( ! std::equal( dims, dims + 3, textureDims ) || texture.Image->GetPointData()->GetScalars() == NULL )
+  {
+    texture.Image->SetDimensions( dims );
+    texture.Image->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+  }
+  return texture;
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::ReleaseTextureToPool( const SnapshotTexture& texture )
+{
+  if ( (int)this->TexturePool.size() >= MAXIMUM_TEXTURE_POOL_SIZE )
+  {
+    return; // the texture is freed
+  }
+  // Only the full resolution buffer is reused, it is reallocated if its pixels were compressed
+  SnapshotTexture pooledTexture;
+  pooledTexture.Image = texture.Image;
+  pooledTexture.Producer = texture.Producer;
+  pooledTexture.Producer->SetOutput( pooledTexture.Image );
+  this->TexturePool.push_back( pooledTexture );
+}
+
+
+
+namespace
+{
+template< class T >
+void MapImageToTextureTemplate( T* inputPtr, int numberOfComponents, int rowLength, int numberOfRows,
+                                double window, double level, unsigned char* outputPtr, int outputRowLength )
+{
+  // Same mapping as vtkImageMapToWindowLevelColors with luminance output
+  double lower = level - 0.5 * std::fabs( window );
+  double scale = ( window != 0.0 ) ? 255.0 / std::fabs( window ) : 0.0;
+  for ( int row = 0; row < numberOfRows; row++, outputPtr += outputRowLength )
+  {
+    for ( int i = 0; i < rowLength; i++, inputPtr += numberOfComponents )
+    {
+      double value = ( window != 0.0 ) ? ( ( double )( *inputPtr ) - lower ) * scale : ( ( double )( *inputPtr ) < level ? 0.0 : 255.0 );
+      outputPtr[ i ] = ( unsigned char )( value <= 0.0 ? 0 : ( value >= 255.0 ? 255 : value + 0.5 ) );
+    }
+  }
+}
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::MapImageToTexture( vtkImageData* inputImage, double window, double level, vtkImageData* textureImage, int offsetX, int offsetY )
+{
+  int inputDims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( inputDims );
+  int textureDims[ 3 ] = { 0, 0, 0 };
+  textureImage->GetDimensions( textureDims );
+  if ( offsetX + inputDims[ 0 ] > textureDims[ 0 ] || offsetY + inputDims[ 1 ] * inputDims[ 2 ] > textureDims[ 1 ] * textureDims[ 2 ] )
+  {
+    vtkGenericWarningMacro( "MapImageToTexture: Image does not fit into the texture." );
+    return;
+  }
+  
+  unsigned char* outputPtr = static_cast< unsigned char* >( textureImage->GetScalarPointer() ) + offsetY * textureDims[ 0 ] + offsetX;
+  int numberOfRows = inputDims[ 1 ] * inputDims[ 2 ];
+  int numberOfComponents = inputImage->GetNumberOfScalarComponents();
+  
+  if ( inputImage->GetScalarType() == VTK_UNSIGNED_CHAR && numberOfComponents == 1 && window == 255.0 && level == 127.5 )
+  {
+    // identity mapping
+    unsigned char* inputPtr = static_cast< unsigned char* >( inputImage->GetScalarPointer() );
+    if ( inputDims[ 0 ] == textureDims[ 0 ] )
+    {
+      memcpy( outputPtr, inputPtr, inputDims[ 0 ] * numberOfRows );
+    }
+    else
+    {
+      for ( int row = 0; row < numberOfRows; row++, inputPtr += inputDims[ 0 ], outputPtr += textureDims[ 0 ] )
+      {
+        memcpy( outputPtr, inputPtr, inputDims[ 0 ] );
+      }
+    }
+  }
+  else
+  {
+    switch ( inputImage->GetScalarType() )
+    {
+      vtkTemplateMacro( MapImageToTextureTemplate( static_cast< VTK_TT* >( inputImage->GetScalarPointer() ),
+        numberOfComponents, inputDims[ 0 ], numberOfRows, window, level, outputPtr, textureDims[ 0 ] ) );
+    default:
+      vtkGenericWarningMacro( "MapImageToTexture: Unsupported scalar type." );
+      return;
+    }
+  }
+  textureImage->Modified();
+}
+
+
+
+namespace
+{
+// Each pixel of the output region is the average of a 2x2 block of input pixels.
+// Blocks at the right and top edges of an input image of odd size are clamped to the image.
+void DownsampleTextureRegion( vtkImageData* inputImage, vtkImageData* outputImage, int x0, int y0, int x1, int y1 )
+{
+  int inputDims[ 3 ] = { 0, 0, 0 };
+  inputImage->GetDimensions( inputDims );
+  int outputDims[ 3 ] = { 0, 0, 0 };
+  outputImage->GetDimensions( outputDims );
+  int inputRowLength = inputDims[ 0 ];
+  int numberOfInputRows = inputDims[ 1 ] * inputDims[ 2 ];
+  x1 = std::min( x1, outputDims[ 0 ] );
+  y1 = std::min( y1, outputDims[ 1 ] );
+  const unsigned char* inputPtr = static_cast< const unsigned char* >( inputImage->GetScalarPointer() );
+  unsigned char* outputPtr = static_cast< unsigned char* >( outputImage->GetScalarPointer() );
+  for ( int y = y0; y < y1; y++ )
+  {
+    const unsigned char* row0 = inputPtr + 2 * y * inputRowLength;
+    const unsigned char* row1 = inputPtr + std::min( 2 * y + 1, numberOfInputRows - 1 ) * inputRowLength;
+    unsigned char* outputRow = outputPtr + y * outputDims[ 0 ];
+    for ( int x = x0; x < x1; x++ )
+    {
+      int i0 = 2 * x;
+      int i1 = std::min( 2 * x + 1, inputRowLength - 1 );
+      outputRow[ x ] = ( unsigned char )( ( row0[ i0 ] + row0[ i1 ] + row1[ i0 ] + row1[ i1 ] + 2 ) / 4 );
+    }
+  }
+}
+
+bool UncompressTexturePixels( const std::vector< unsigned char >& compressedPixels, vtkImageData* textureImage )
+{
+  textureImage->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+  vtkIdType numberOfPixels = textureImage->GetNumberOfPoints();
+  vtkNew< vtkZLibDataCompressor > compressor;
+  return compressor->Uncompress( &( compressedPixels[ 0 ] ), compressedPixels.size(),
+    static_cast< unsigned char* >( textureImage->GetScalarPointer() ), numberOfPixels ) == ( size_t )numberOfPixels;
+}
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::UpdateTextureLevelsOfDetail( vtkMRMLCameraNode* cameraNode, int viewHeightPixels )
+{
+  if ( cameraNode == NULL || cameraNode->GetCamera() == NULL || viewHeightPixels <= 0 )
+  {
+    vtkErrorMacro( "UpdateTextureLevelsOfDetail: Invalid camera or view size." );
+    return;
+  }
+  vtkCamera* camera = cameraNode->GetCamera();
+  
+  for ( std::map< std::string, SnapshotTexture >::iterator textureIt = this->SnapshotTextures.begin(); textureIt != this->SnapshotTextures.end(); ++textureIt )
+  {
+    vtkMRMLModelNode* snapshotModel = vtkMRMLModelNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( textureIt->first.c_str() ) );
+    if ( snapshotModel == NULL || snapshotModel->GetPolyData() == NULL || snapshotModel->GetPolyData()->GetNumberOfPoints() < 4 )
+    {
+      continue;
+    }
+    double cornersRAS[ 4 ][ 3 ];
+    for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+    {
+      snapshotModel->GetPolyData()->GetPoint( cornerIndex, cornersRAS[ cornerIndex ] );
+    }
+    int dims[ 3 ] = { 0, 0, 0 };
+    textureIt->second.Image->GetDimensions( dims );
+    bool compressed = ! textureIt->second.CompressedPixels.empty();
+    this->SetTextureLevel( textureIt->second, this->ComputeTextureLevel( camera, viewHeightPixels, cornersRAS, dims[ 0 ], dims[ 1 ] ) );
+    if ( compressed && textureIt->second.CompressedPixels.empty() )
+    {
+      this->FullResolutionSnapshotIDs.push_back( textureIt->first );
+    }
+  }
+  
+  // All snapshots of an atlas page share its texture, the largest one in the view determines the level
+  for ( std::vector< AtlasPage >::iterator pageIt = this->AtlasPages.begin(); pageIt != this->AtlasPages.end(); ++pageIt )
+  {
+    if ( pageIt->ModelNode == NULL || pageIt->QuadRegions.empty() )
+    {
+      continue;
+    }
+    vtkPoints* points = pageIt->ModelNode->GetPolyData()->GetPoints();
+    int numberOfQuads = ( int )pageIt->QuadRegions.size() / 4;
+    int pageLevel = this->MaximumTextureLevel;
+    for ( int quadIndex = 0; quadIndex < numberOfQuads && 4 * ( quadIndex + 1 ) <= points->GetNumberOfPoints() && pageLevel > 0; quadIndex++ )
+    {
+      const int* region = &( pageIt->QuadRegions[ 4 * quadIndex ] );
+      double cornersRAS[ 4 ][ 3 ];
+      for ( int cornerIndex = 0; cornerIndex < 4; cornerIndex++ )
+      {
+        points->GetPoint( 4 * quadIndex + cornerIndex, cornersRAS[ cornerIndex ] );
+      }
+      pageLevel = std::min( pageLevel, this->ComputeTextureLevel( camera, viewHeightPixels, cornersRAS, region[ 2 ], region[ 3 ] ) );
+    }
+    this->SetTextureLevel( pageIt->Texture, pageLevel );
+  }
+  
+  this->CompressOldSnapshotTextures();
+}
+
+
+
+int
+vtkSlicerUltrasoundSnapshotsLogic
+::ComputeTextureLevel( vtkCamera* camera, int viewHeightPixels, const double cornersRAS[ 4 ][ 3 ], int width, int height )
+{
+  // Size of a millimeter in view pixels at the quad. Foreshortening is ignored and the nearest point
+  // of the quad is used, so the size is never underestimated, which would make the texture blurry.
+  double pixelsPerMm = 0.0;
+  if ( camera->GetParallelProjection() )
+  {
+    if ( camera->GetParallelScale() <= 0.0 )
+    {
+      return 0;
+    }
+    pixelsPerMm = viewHeightPixels / ( 2.0 * camera->GetParallelScale() );
+  }
+  else
+  {
+    double centerRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+    for ( int i = 0; i < 3; i++ )
+    {
+      centerRAS[ i ] = 0.5 * ( cornersRAS[ 0 ][ i ] + cornersRAS[ 3 ][ i ] );
+    }
+    double cameraPosition[ 3 ] = { 0.0, 0.0, 0.0 };
+    camera->GetPosition( cameraPosition );
+    double directionOfProjection[ 3 ] = { 0.0, 0.0, 1.0 };
+    camera->GetDirectionOfProjection( directionOfProjection );
+    double cameraToCenter[ 3 ] = { 0.0, 0.0, 0.0 };
+    vtkMath::Subtract( centerRAS, cameraPosition, cameraToCenter );
+    double distance = vtkMath::Dot( cameraToCenter, directionOfProjection )
+      - 0.5 * sqrt( vtkMath::Distance2BetweenPoints( cornersRAS[ 0 ], cornersRAS[ 3 ] ) );
+    double viewHalfAngleTangent = tan( vtkMath::RadiansFromDegrees( 0.5 * camera->GetViewAngle() ) );
+    if ( distance <= 0.0 || viewHalfAngleTangent <= 0.0 )
+    {
+      return 0; // the quad may be very close to the camera
+    }
+    pixelsPerMm = viewHeightPixels / ( 2.0 * distance * viewHalfAngleTangent );
+  }
+  
+  double widthPixels = sqrt( vtkMath::Distance2BetweenPoints( cornersRAS[ 0 ], cornersRAS[ 1 ] ) ) * pixelsPerMm;
+  double heightPixels = sqrt( vtkMath::Distance2BetweenPoints( cornersRAS[ 0 ], cornersRAS[ 2 ] ) ) * pixelsPerMm;
+  if ( widthPixels <= 0.0 || heightPixels <= 0.0 )
+  {
+    return 0;
+  }
+  // Each level halves the texels per view pixel, the texture is not downscaled below one texel per pixel
+  double texelsPerPixel = std::min( width / widthPixels, height / heightPixels );
+  int level = 0;
+  while ( level < this->MaximumTextureLevel && texelsPerPixel >= 2.0 )
+  {
+    level++;
+    texelsPerPixel *= 0.5;
+  }
+  return level;
+}
+
+
+
+int
+vtkSlicerUltrasoundSnapshotsLogic
+::SetTextureLevel( SnapshotTexture& texture, int level )
+{
+  if ( level <= 0 )
+  {
+    level = 0;
+    if ( ! texture.CompressedPixels.empty() && ! DecompressTexture( texture ) )
+    {
+      vtkErrorMacro( "SetTextureLevel: Failed to decompress snapshot texture." );
+      return texture.ShownLevel;
+    }
+  }
+  
+  // Missing levels are created from the previous level. A compressed texture always has level 1 already.
+  while ( ( int )texture.Levels.size() < level )
+  {
+    vtkImageData* previousImage = texture.Levels.empty() ? texture.Image.GetPointer() : texture.Levels.back().GetPointer();
+    int previousDims[ 3 ] = { 0, 0, 0 };
+    previousImage->GetDimensions( previousDims );
+    previousDims[ 1 ] *= previousDims[ 2 ];
+    if ( previousDims[ 0 ] < 2 && previousDims[ 1 ] < 2 )
+    {
+      break;
+    }
+    vtkSmartPointer< vtkImageData > levelImage = vtkSmartPointer< vtkImageData >::New();
+    levelImage->SetDimensions( ( previousDims[ 0 ] + 1 ) / 2, ( previousDims[ 1 ] + 1 ) / 2, 1 );
+    levelImage->AllocateScalars( VTK_UNSIGNED_CHAR, 1 );
+    DownsampleTextureRegion( previousImage, levelImage, 0, 0, ( previousDims[ 0 ] + 1 ) / 2, ( previousDims[ 1 ] + 1 ) / 2 );
+    texture.Levels.push_back( levelImage );
+  }
+  level = std::min( level, ( int )texture.Levels.size() );
+  
+  if ( level != texture.ShownLevel )
+  {
+    // The display node is connected to the producer, so only the producer output is changed
+    texture.Producer->SetOutput( level == 0 ? texture.Image.GetPointer() : texture.Levels[ level - 1 ].GetPointer() );
+    texture.ShownLevel = level;
+  }
+  return level;
+}
+
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::UpdateTextureLevelsInRegion( SnapshotTexture& texture, int offsetX, int offsetY, int width, int height )
+{
+  int x0 = offsetX;
+  int y0 = offsetY;
+  int x1 = offsetX + width;
+  int y1 = offsetY + height;
+  for ( size_t levelIndex = 0; levelIndex < texture.Levels.size(); levelIndex++ )
+  {
+    x0 /= 2;
+    y0 /= 2;
+    x1 = ( x1 + 1 ) / 2;
+    y1 = ( y1 + 1 ) / 2;
+    vtkImageData* previousImage = ( levelIndex == 0 ) ? texture.Image.GetPointer() : texture.Levels[ levelIndex - 1 ].GetPointer();
+    DownsampleTextureRegion( previousImage, texture.Levels[ levelIndex ], x0, y0, x1, y1 );
+    texture.Levels[ levelIndex ]->Modified();
+  }
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::CompressTexture( SnapshotTexture& texture )
+{
+  vtkDataArray* scalars = texture.Image->GetPointData()->GetScalars();
+  if ( texture.ShownLevel == 0 || ! texture.CompressedPixels.empty() || scalars == NULL || scalars->GetNumberOfTuples() == 0 )
+  {
+    return false;
+  }
+  size_t numberOfPixels = scalars->GetNumberOfTuples();
+  vtkNew< vtkZLibDataCompressor > compressor;
+  std::vector< unsigned char > compressedPixels( compressor->GetMaximumCompressionSpace( numberOfPixels ) );
+  size_t compressedSize = compressor->Compress( static_cast< unsigned char* >( scalars->GetVoidPointer( 0 ) ), numberOfPixels,
+    &( compressedPixels[ 0 ] ), compressedPixels.size() );
+  if ( compressedSize == 0 )
+  {
+    return false;
+  }
+  texture.CompressedPixels.assign( compressedPixels.begin(), compressedPixels.begin() + compressedSize );
+  // The dimensions are kept, only the pixels are released
+  texture.Image->GetPointData()->Initialize();
+  return true;
+}
+
+
+
+bool
+vtkSlicerUltrasoundSnapshotsLogic
+::DecompressTexture( SnapshotTexture& texture )
+{
+  if ( texture.CompressedPixels.empty() )
+  {
+    return true;
+  }
+  if ( ! UncompressTexturePixels( texture.CompressedPixels, texture.Image ) )
+  {
+    return false;
+  }
+  std::vector< unsigned char >().swap( texture.CompressedPixels );
+  texture.Image->Modified();
+  return true;
+}
+
+
+
+vtkSmartPointer< vtkImageData >
+vtkSlicerUltrasoundSnapshotsLogic
+::GetFullResolutionImage( const SnapshotTexture& texture )
 {
+  if ( texture.CompressedPixels.empty() )
+  {
+    return texture.Image;
+  }
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetDimensions( texture.Image->GetDimensions() );
+  if ( ! UncompressTexturePixels( texture.CompressedPixels, image ) )
+  {
+    return vtkSmartPointer< vtkImageData >();
+  }
+  return image;
 }
 
+
+
+void
+vtkSlicerUltrasoundSnapshotsLogic
+::CompressOldSnapshotTextures()
+{
+  if ( this->MaximumNumberOfFullResolutionSnapshots <= 0 )
+  {
+    return;
+  }
+  // Snapshots that are shown at full resolution are skipped, so more may remain
+  std::deque< std::string >::iterator idIt = this->FullResolutionSnapshotIDs.begin();
+  while ( ( int )this->FullResolutionSnapshotIDs.size() > this->MaximumNumberOfFullResolutionSnapshots && idIt != this->FullResolutionSnapshotIDs.end() )
+  {
+    std::map< std::string, SnapshotTexture >::iterator textureIt = this->SnapshotTextures.find( *idIt );
+    if ( textureIt == this->SnapshotTextures.end() || CompressTexture( textureIt->second ) )
+    {
+      idIt = this->FullResolutionSnapshotIDs.erase( idIt );
+    }
+    else
+    {
+      ++idIt;
+    }
+  }
+}
@@ -28,10 +28,27 @@
 #include "vtkSlicerModuleLogic.h"
 
 // MRML includes
+#include "vtkMRMLModelDisplayNode.h"
+#include "vtkMRMLModelNode.h"
 #include "vtkMRMLScalarVolumeNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class vtkCamera;
+class vtkFreehandVolumeCompounder;
+class vtkImageData;
+class vtkMRMLCameraNode;
+class vtkTrivialProducer;
 
 #include "vtkSlicerUltrasoundSnapshotsModuleLogicExport.h"
 
@@ -50,6 +67,80 @@ public:
   vtkMRMLScalarVolumeNode* GetInputVolumeNode();
   void AddSnapshot( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel );
   void ClearSnapshots();
+
+  /// Allocate 8-bit texture buffers for the given number of snapshots of the input image in advance,
+  /// so that taking the snapshots does not allocate memory. Textures of removed snapshots are reused as well.
+  void PreallocateSnapshotTextures( vtkMRMLScalarVolumeNode* InputNode, int numberOfSnapshots );
+
+  /// If enabled then new snapshots are packed into a few large textures ("atlas pages"), and the snapshots
+  /// of each page are rendered from a single model, which requires much fewer draw calls and texture uploads.
+  vtkGetMacro( UseTextureAtlas, bool );
+  vtkSetMacro( UseTextureAtlas, bool );
+  vtkBooleanMacro( UseTextureAtlas, bool );
+  /// Width and height of the atlas pages in pixels. Only applies to pages that are created afterwards.
+  vtkGetMacro( TextureAtlasSize, int );
+  vtkSetMacro( TextureAtlasSize, int );
+
+  /// Texture level of detail: snapshots (and atlas pages) that are small in the view are shown with downscaled
+  /// copies of their texture (each level halves the width and height), so that hundreds of snapshots do not keep
+  /// full resolution textures in GPU memory. The level of each texture is chosen from the size of its snapshots
+  /// in the view of the given camera, which is viewHeightPixels high. If there are multiple views then the camera
+  /// of the one that shows the snapshots the largest should be used. Levels are only changed when this is called.
+  void UpdateTextureLevelsOfDetail( vtkMRMLCameraNode* cameraNode, int viewHeightPixels );
+  /// Highest level of detail that may be shown (default 4, 0 means always full resolution)
+  vtkGetMacro( MaximumTextureLevel, int );
+  vtkSetClampMacro( MaximumTextureLevel, int, 0, 16 );
+  /// If positive then the full resolution pixels of separate snapshots are zlib-compressed in memory when they are
+  /// shown downscaled and there are more than this many full resolution snapshots, oldest first.
+  /// They are decompressed when they are shown at full resolution again. Default 0 (no compression).
+  vtkGetMacro( MaximumNumberOfFullResolutionSnapshots, int );
+  vtkSetMacro( MaximumNumberOfFullResolutionSnapshots, int );
+
+  /// Sweep mode: a snapshot is taken automatically for each new frame of the input image
+  /// if the image pose changed by more than SweepMinimumDistanceMm or SweepMinimumAngleDeg
+  /// since the last accepted frame. Rejected frames are not copied.
+  void StartSweep( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel );
+  void StopSweep();
+  bool IsSweepActive();
+  vtkGetMacro( SweepMinimumDistanceMm, double );
+  vtkSetMacro( SweepMinimumDistanceMm, double );
+  vtkGetMacro( SweepMinimumAngleDeg, double );
+  vtkSetMacro( SweepMinimumAngleDeg, double );
+  /// If positive then at most this many sweep snapshots are kept, each new one replaces the oldest.
+  vtkGetMacro( SweepMaximumNumberOfSnapshots, int );
+  vtkSetMacro( SweepMaximumNumberOfSnapshots, int );
+
+  /// Live image plane: the input image is shown in 3D views on a textured plane that follows the pose of the image.
+  /// Unlike showing a slice in 3D, the image is not resliced: 8-bit images are used as texture directly (no copy),
+  /// other images are mapped with their display window/level into a reused 8-bit buffer in a single pass.
+  /// The plane model and its texture are kept while the plane is shown, only the texture content is updated for new frames.
+  void ShowLiveImagePlane( vtkMRMLScalarVolumeNode* InputNode );
+  void HideLiveImagePlane();
+  vtkMRMLModelNode* GetLiveImagePlaneModelNode();
+
+  virtual void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData );
+
+  /// Snapshot archive: a single file that contains all snapshots as zlib-compressed 8-bit frames
+  /// and a table of their corner positions. Snapshots are not saved as scene nodes, instead the archive
+  /// is written into the scene directory when the scene is saved, and loaded when the scene is imported.
+  /// The archive is compressed and written on a background thread. Returns false if it could not be started.
+  bool SaveSnapshotArchive( const char* fileName );
+  bool IsSnapshotArchiveWriteInProgress();
+  /// Wait for the archive write to finish. Returns true if the archive was written successfully.
+  bool WaitForSnapshotArchiveWrite();
+  /// Add the snapshots of the archive to the scene. Returns the number of added snapshots.
+  int LoadSnapshotArchive( const char* fileName );
+  static const char* GetSceneSnapshotArchiveFileName() { return "UltrasoundSnapshots.ussnap"; };
+
+  /// Freehand volume compounding: the pixels of the snapshots are scattered into the voxel grid of the given volume
+  /// (its dimensions and IJK-to-RAS matrix, including its parent transform, at the time it is set). The image of the volume
+  /// is replaced by the 8-bit compounded image. All existing snapshots are compounded when the volume is set,
+  /// and each new snapshot is compounded as it is taken, on multiple threads. Set NULL to stop compounding.
+  void SetCompoundingVolumeNode( vtkMRMLScalarVolumeNode* volumeNode );
+  vtkMRMLScalarVolumeNode* GetCompoundingVolumeNode();
+  /// Empty voxels of the compounded volume are only filled when requested, from the voxels within the given radius.
+  /// Returns the number of filled voxels.
+  int FillCompoundingVolumeHoles( int radiusVoxels );
   
   
 protected:
@@ -57,6 +148,13 @@ protected:
   virtual ~vtkSlicerUltrasoundSnapshotsLogic();
   
   int snapshotCounter; // This is only used to ensure unique MRML node names.
+  bool UseTextureAtlas;
+  int TextureAtlasSize;
+  int MaximumTextureLevel;
+  int MaximumNumberOfFullResolutionSnapshots;
+  double SweepMinimumDistanceMm;
+  double SweepMinimumAngleDeg;
+  int SweepMaximumNumberOfSnapshots;
 
   virtual void SetMRMLSceneInternal(vtkMRMLScene* newScene);
   /// Register MRML Node classes to Scene. Gets called automatically when the MRMLScene is attached to this logic class.
@@ -66,8 +164,119 @@ protected:
   virtual void OnMRMLSceneStartClose();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  virtual void ProcessMRMLSceneEvents( vtkObject* caller, unsigned long event, void* callData );
+  void OnMRMLSceneStartSave();
+  void OnMRMLSceneEndSave();
+
+  // Snapshot textures are 8-bit luminance images that are only referenced by the model display node,
+  // they are not stored in volume nodes.
+  struct SnapshotTexture
+  {
+    SnapshotTexture() : ShownLevel( 0 ) {}
+    vtkSmartPointer< vtkImageData > Image;
+    vtkSmartPointer< vtkTrivialProducer > Producer;
+    // Downscaled copies of Image, Levels[ i ] is level i + 1. They are created when they are first shown,
+    // the shown level is the output of Producer.
+    std::vector< vtkSmartPointer< vtkImageData > > Levels;
+    int ShownLevel;
+    // Compressed full resolution pixels. Image has no scalars while they are compressed.
+    std::vector< unsigned char > CompressedPixels;
+  };
+  // Returns a texture buffer of the requested size, reusing a released one if possible
+  SnapshotTexture GetTextureFromPool( int dims[ 3 ] );
+  void ReleaseTextureToPool( const SnapshotTexture& texture );
+  // Map the first component of the image to 8 bits with the given window and level into the texture, in a single pass.
+  // The image is written at the given pixel offset, so that it can be placed into an atlas page.
+  static void MapImageToTexture( vtkImageData* inputImage, double window, double level, vtkImageData* textureImage, int offsetX, int offsetY );
+
+  // Show the given level of detail of the texture, the missing levels are created. Returns the shown level,
+  // which is lower than requested if the texture is too small. Level 0 decompresses the full resolution pixels.
+  int SetTextureLevel( SnapshotTexture& texture, int level );
+  // Update the existing downscaled levels of a texture from a modified region of its full resolution image
+  static void UpdateTextureLevelsInRegion( SnapshotTexture& texture, int offsetX, int offsetY, int width, int height );
+  // Level of detail for a textured quad (corners in vtkPlaneSource point order) of the given size in texels
+  int ComputeTextureLevel( vtkCamera* camera, int viewHeightPixels, const double cornersRAS[ 4 ][ 3 ], int width, int height );
+  static bool CompressTexture( SnapshotTexture& texture );
+  static bool DecompressTexture( SnapshotTexture& texture );
+  // Returns the full resolution image of the texture, decompressed into a temporary image if needed. NULL on failure.
+  static vtkSmartPointer< vtkImageData > GetFullResolutionImage( const SnapshotTexture& texture );
+  // Compress the oldest separate snapshots that are shown downscaled, so that at most
+  // MaximumNumberOfFullResolutionSnapshots remain at full resolution (if possible)
+  void CompressOldSnapshotTextures();
+
+  vtkSmartPointer< vtkMRMLModelDisplayNode > CreateSnapshotDisplayNode();
+  void ComputeSnapshotCorners( vtkMRMLScalarVolumeNode* InputNode, int dims[ 3 ], double cornersRAS[ 4 ][ 3 ] );
+  void ComputeSnapshotWindowLevel( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel, double& window, double& level );
+
+  // Atlas page: one large texture and one model with a textured quad for each snapshot in it
+  struct AtlasPage
+  {
+    SnapshotTexture Texture;
+    vtkWeakPointer< vtkMRMLModelNode > ModelNode;
+    int CursorX; // position of the next frame in the current row
+    int CursorY; // bottom of the current row
+    int RowHeight;
+    std::vector< int > QuadRegions; // x, y, width, height of the frame of each quad in the texture
+  };
+  // Where a snapshot is stored: either a separate model node, or a quad in an atlas page
+  struct SnapshotLocation
+  {
+    SnapshotLocation() : AtlasPageIndex( -1 ), AtlasQuadIndex( -1 ) {}
+    std::string ModelNodeID; // separate snapshot model
+    int AtlasPageIndex;
+    int AtlasQuadIndex;
+    int AtlasOffset[ 2 ]; // position of the frame in the atlas page, in pixels
+    int Dims[ 2 ];
+  };
+  // Add a snapshot and get its location
+  bool AddSnapshotInternal( vtkMRMLScalarVolumeNode* InputNode, bool preserveWindowLevel, SnapshotLocation& location );
+  bool AddSnapshotFromImage( vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level, SnapshotLocation& location );
+  // Returns false if the frame does not fit into an atlas page
+  bool AddSnapshotToAtlas( vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level, SnapshotLocation& location );
+  // Overwrite an existing atlas snapshot in place. Returns false if it is not possible (e.g., the image size is different).
+  bool ReplaceAtlasSnapshot( const SnapshotLocation& location, vtkImageData* inputImage, double cornersRAS[ 4 ][ 3 ], double window, double level );
+  AtlasPage* CreateAtlasPage();
+  // Remove a snapshot model node and its display node, the texture is returned to the pool
+  void RemoveSnapshotModel( const std::string& modelNodeID );
+
+  // Take a sweep snapshot if the pose of the input image changed enough
+  void ProcessSweepFrame();
+
+  // Update the texture and the corners of the live image plane from the current frame
+  void UpdateLiveImagePlane( bool imageModified );
+  // Observe the events of a node that is used both as sweep and live image plane input
+  void ObserveInputNodeEvents( vtkMRMLScalarVolumeNode* InputNode );
+
+  // Queue a snapshot for compounding from its texture, and scatter it right away if requested
+  void CompoundSnapshot( vtkImageData* textureImage, int offsetX, int offsetY, int width, int height, double cornersRAS[ 4 ][ 3 ], bool update );
+
+  // IDs of the separate snapshot model nodes, so they can be cleared without searching the scene
+  std::set< std::string > SnapshotModelNodeIDs;
+  std::map< std::string, SnapshotTexture > SnapshotTextures; // key: snapshot model node ID
+  std::vector< SnapshotTexture > TexturePool; // textures of removed snapshots, ready for reuse
+  std::vector< AtlasPage > AtlasPages;
+  std::deque< std::string > FullResolutionSnapshotIDs; // separate snapshots that are not compressed, oldest first
+
+  vtkWeakPointer< vtkMRMLScalarVolumeNode > SweepInputNode;
+  bool SweepPreserveWindowLevel;
+  bool SweepHasLastPose;
+  double SweepLastCornersRAS[ 4 ][ 3 ]; // corners of the last accepted frame
+  std::deque< SnapshotLocation > SweepSnapshots; // oldest first
+
+  vtkWeakPointer< vtkMRMLScalarVolumeNode > LiveImageInputNode;
+  vtkWeakPointer< vtkMRMLModelNode > LiveImagePlaneModelNode;
+  SnapshotTexture LiveImageTexture; // only used for images that cannot be used as texture directly
+  bool LiveImageTextureIsInputImage;
+  double LiveImageCornersRAS[ 4 ][ 3 ];
+
+  vtkWeakPointer< vtkMRMLScalarVolumeNode > CompoundingVolumeNode;
+  vtkSmartPointer< vtkFreehandVolumeCompounder > Compounder;
+
 private:
 
+  class vtkInternal;
+  vtkInternal* Internal;
+
   vtkSlicerUltrasoundSnapshotsLogic(const vtkSlicerUltrasoundSnapshotsLogic&); // Not implemented
   void operator=(const vtkSlicerUltrasoundSnapshotsLogic&);               // Not implemented
 };
@@ -77,6 +77,7 @@ qSlicerUltrasoundSnapshotsModuleWidget
   
   if ( currentNode == NULL )
   {
+    d->SweepCheckBox->setChecked( false );
     return;
   }
   
@@ -87,6 +88,12 @@ qSlicerUltrasoundSnapshotsModuleWidget
   }
   
   d->logic()->SetInputVolumeNode( volumeNode );
+  
+  // the sweep follows the selected image
+  if ( d->SweepCheckBox->isChecked() )
+  {
+    d->logic()->StartSweep( volumeNode, d->WindowLevelCheckBox->isChecked() );
+  }
 }
 
 
@@ -106,12 +113,37 @@ qSlicerUltrasoundSnapshotsModuleWidget
   
   if ( vnode != NULL )
   {
+    d->logic()->SetUseTextureAtlas( d->TextureAtlasCheckBox->isChecked() );
     d->logic()->AddSnapshot( vnode, d->WindowLevelCheckBox->isChecked() );
   }
 }
 
 
 
+void
+qSlicerUltrasoundSnapshotsModuleWidget
+::OnSweepToggled( bool enabled )
+{
+  Q_D(qSlicerUltrasoundSnapshotsModuleWidget);
+  
+  if ( ! enabled )
+  {
+    d->logic()->StopSweep();
+    return;
+  }
+  
+  vtkMRMLScalarVolumeNode* vnode = vtkMRMLScalarVolumeNode::SafeDownCast( d->UltrasoundImageComboBox->currentNode() );
+  if ( vnode == NULL )
+  {
+    d->SweepCheckBox->setChecked( false );
+    return;
+  }
+  d->logic()->SetUseTextureAtlas( d->TextureAtlasCheckBox->isChecked() );
+  d->logic()->StartSweep( vnode, d->WindowLevelCheckBox->isChecked() );
+}
+
+
+
 void
 qSlicerUltrasoundSnapshotsModuleWidget
 ::OnClearSnapshotsClicked()
@@ -163,5 +195,6 @@ qSlicerUltrasoundSnapshotsModuleWidget
   connect( d->UltrasoundImageComboBox, SIGNAL( currentNodeChanged( vtkMRMLNode* ) ), this, SLOT( OnInputSelectionChanged( vtkMRMLNode* ) ) );
   connect( d->AddSnapshotButton, SIGNAL( clicked() ), this, SLOT( OnAddSnapshotClicked() ) );
   connect( d->ClearSnapshotsButton, SIGNAL( clicked() ), this, SLOT( OnClearSnapshotsClicked() ) );
+  connect( d->SweepCheckBox, SIGNAL( toggled( bool ) ), this, SLOT( OnSweepToggled( bool ) ) );
 }
 
@@ -43,6 +43,7 @@ public slots:
   void OnInputSelectionChanged( vtkMRMLNode* currentNode );
   void OnAddSnapshotClicked();
   void OnClearSnapshotsClicked();
+  void OnSweepToggled( bool enabled );
   
 
 protected:
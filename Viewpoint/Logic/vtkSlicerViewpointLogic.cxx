@@ -0,0 +1,622 @@
+#include "vtkSlicerViewpointLogic.h"
+
+// VolumeResliceDriver includes
+#include <vtkTransformPredictor.h>
+
+// IGTCommon includes
+#include <vtkPerformanceCounters.h>
+
+// MRML includes
+#include <vtkMRMLCameraNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLTransformNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkCamera.h>
+#include <vtkCommand.h>
+#include <vtkGeneralTransform.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h> //for vtkStandardNewMacro() macro
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+
+// Distance of the focal point from the camera along the tool -z axis (if there is no forced target)
+static const double BULLSEYE_FOCAL_POINT_DISTANCE_MM = 200.0;
+static const double BULLSEYE_EPSILON = 0.0001;
+static const double AUTO_CENTER_EPSILON = 1e-12;
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro( vtkSlicerViewpointLogic );
+
+//------------------------------------------------------------------------------
+vtkSlicerViewpointLogic::vtkSlicerViewpointLogic()
+{
+  this->RendererCallbackCommand = vtkSmartPointer< vtkCallbackCommand >::New();
+  this->RendererCallbackCommand->SetClientData( this );
+  this->RendererCallbackCommand->SetCallback( vtkSlicerViewpointLogic::RendererCallback );
+  this->RendererObserverTag = 0;
+
+  this->BullseyeTransformNode = NULL;
+  this->BullseyeCameraPositionMm[ 0 ] = 0.0;
+  this->BullseyeCameraPositionMm[ 1 ] = 0.0;
+  this->BullseyeCameraPositionMm[ 2 ] = 0.0;
+  this->BullseyeForcedUpDirection = false;
+  this->BullseyeUpDirectionRAS[ 0 ] = 0.0;
+  this->BullseyeUpDirectionRAS[ 1 ] = 1.0;
+  this->BullseyeUpDirectionRAS[ 2 ] = 0.0;
+  this->BullseyeForcedTarget = false;
+  this->BullseyeTargetPositionRAS[ 0 ] = 0.0;
+  this->BullseyeTargetPositionRAS[ 1 ] = 0.0;
+  this->BullseyeTargetPositionRAS[ 2 ] = 0.0;
+  this->BullseyeCameraParallelProjection = false;
+  this->BullseyeCameraViewAngleDeg = 30.0;
+  this->BullseyeCameraParallelScale = 1.0;
+
+  this->BullseyeActive = false;
+  this->BullseyeCameraUpdatePending = false;
+
+  this->ToolToRASTransform = vtkSmartPointer< vtkGeneralTransform >::New();
+  this->ToolToRASMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ToolPosePredictor = vtkSmartPointer< vtkTransformPredictor >::New();
+  this->PerformanceCounters = vtkSmartPointer< vtkPerformanceCounters >::New();
+  this->PerformanceCounters->SetName( "Viewpoint" );
+
+  this->AutoCenterSafeZoneNormalizedViewport[ 0 ] = -1.0;
+  this->AutoCenterSafeZoneNormalizedViewport[ 1 ] = 1.0;
+  this->AutoCenterSafeZoneNormalizedViewport[ 2 ] = -1.0;
+  this->AutoCenterSafeZoneNormalizedViewport[ 3 ] = 1.0;
+  this->AutoCenterSafeZoneNormalizedViewport[ 4 ] = -1.0;
+  this->AutoCenterSafeZoneNormalizedViewport[ 5 ] = 1.0;
+  this->AutoCenterAdjustX = true;
+  this->AutoCenterAdjustY = true;
+  this->AutoCenterAdjustZ = false;
+  this->AutoCenterSpherePolyDataMTime = 0;
+  this->AutoCenterSphereCenterModel[ 0 ] = 0.0;
+  this->AutoCenterSphereCenterModel[ 1 ] = 0.0;
+  this->AutoCenterSphereCenterModel[ 2 ] = 0.0;
+  this->AutoCenterSphereRadiusModel = 0.0;
+  this->ModelToRASMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ModelToViewMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+}
+
+//------------------------------------------------------------------------------
+vtkSlicerViewpointLogic::~vtkSlicerViewpointLogic()
+{
+  this->SetRenderer( NULL );
+  this->SetAndObserveBullseyeTransformNode( NULL );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::PrintSelf( std::ostream &os, vtkIndent indent )
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "CameraNode: " << this->CameraNode.GetPointer() << std::endl;
+  os << indent << "Renderer: " << this->Renderer.GetPointer() << std::endl;
+  os << indent << "BullseyeTransformNode: " << this->BullseyeTransformNode << std::endl;
+  os << indent << "BullseyeCameraPositionMm: " << this->BullseyeCameraPositionMm[ 0 ] << " "
+    << this->BullseyeCameraPositionMm[ 1 ] << " " << this->BullseyeCameraPositionMm[ 2 ] << std::endl;
+  os << indent << "BullseyeForcedUpDirection: " << this->BullseyeForcedUpDirection << std::endl;
+  os << indent << "BullseyeUpDirectionRAS: " << this->BullseyeUpDirectionRAS[ 0 ] << " "
+    << this->BullseyeUpDirectionRAS[ 1 ] << " " << this->BullseyeUpDirectionRAS[ 2 ] << std::endl;
+  os << indent << "BullseyeForcedTarget: " << this->BullseyeForcedTarget << std::endl;
+  os << indent << "BullseyeTargetPositionRAS: " << this->BullseyeTargetPositionRAS[ 0 ] << " "
+    << this->BullseyeTargetPositionRAS[ 1 ] << " " << this->BullseyeTargetPositionRAS[ 2 ] << std::endl;
+  os << indent << "BullseyeCameraParallelProjection: " << this->BullseyeCameraParallelProjection << std::endl;
+  os << indent << "BullseyeCameraViewAngleDeg: " << this->BullseyeCameraViewAngleDeg << std::endl;
+  os << indent << "BullseyeCameraParallelScale: " << this->BullseyeCameraParallelScale << std::endl;
+  os << indent << "BullseyeLatencyCompensationSec: " << this->GetBullseyeLatencyCompensationSec() << std::endl;
+  os << indent << "BullseyeActive: " << this->BullseyeActive << std::endl;
+  os << indent << "AutoCenterModelNode: " << this->AutoCenterModelNode.GetPointer() << std::endl;
+  os << indent << "AutoCenterSafeZoneNormalizedViewport:";
+  for ( int i = 0; i < 6; i++ )
+  {
+    os << " " << this->AutoCenterSafeZoneNormalizedViewport[ i ];
+  }
+  os << std::endl;
+  os << indent << "AutoCenterAdjust: " << this->AutoCenterAdjustX << " " << this->AutoCenterAdjustY << " " << this->AutoCenterAdjustZ << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::SetCameraNode( vtkMRMLCameraNode* cameraNode )
+{
+  if ( this->CameraNode == cameraNode )
+  {
+    return;
+  }
+  this->CameraNode = cameraNode;
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLCameraNode* vtkSlicerViewpointLogic::GetCameraNode()
+{
+  return this->CameraNode;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::SetRenderer( vtkRenderer* renderer )
+{
+  if ( this->Renderer == renderer )
+  {
+    return;
+  }
+  if ( this->Renderer != NULL )
+  {
+    this->Renderer->RemoveObserver( this->RendererObserverTag );
+    this->RendererObserverTag = 0;
+  }
+  this->Renderer = renderer;
+  if ( this->Renderer != NULL )
+  {
+    this->RendererObserverTag = this->Renderer->AddObserver( vtkCommand::StartEvent, this->RendererCallbackCommand );
+  }
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkRenderer* vtkSlicerViewpointLogic::GetRenderer()
+{
+  return this->Renderer;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::SetAndObserveBullseyeTransformNode( vtkMRMLTransformNode* transformNode )
+{
+  // Transform nodes invoke TransformModifiedEvent when any of their parent transforms
+  // is modified, too, therefore the parents do not have to be observed.
+  vtkNew< vtkIntArray > events;
+  events->InsertNextValue( vtkMRMLTransformNode::TransformModifiedEvent );
+  vtkSetAndObserveMRMLNodeEventsMacro( this->BullseyeTransformNode, transformNode, events.GetPointer() );
+  // poses of the previous tool must not be used for extrapolation
+  this->ToolPosePredictor->Reset();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::SetBullseyeLatencyCompensationSec( double latencySec )
+{
+  if ( this->ToolPosePredictor->GetLatencySec() == latencySec )
+  {
+    return;
+  }
+  this->ToolPosePredictor->SetLatencySec( latencySec );
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+double vtkSlicerViewpointLogic::GetBullseyeLatencyCompensationSec()
+{
+  return this->ToolPosePredictor->GetLatencySec();
+}
+
+//------------------------------------------------------------------------------
+vtkPerformanceCounters* vtkSlicerViewpointLogic::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::StartBullseye()
+{
+  this->BullseyeActive = true;
+  this->UpdateBullseyeCamera();
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::StopBullseye()
+{
+  this->BullseyeActive = false;
+  this->BullseyeCameraUpdatePending = false;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::UpdateBullseyeCamera()
+{
+  this->ApplyBullseyeCamera( true );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData )
+{
+  if ( caller == NULL || caller != this->BullseyeTransformNode || event != vtkMRMLTransformNode::TransformModifiedEvent )
+  {
+    this->Superclass::ProcessMRMLNodesEvents( caller, event, callData );
+    return;
+  }
+  if ( !this->BullseyeActive )
+  {
+    return;
+  }
+  this->PerformanceCounters->EventReceived();
+  if ( this->GetBullseyeLatencyCompensationSec() > 0.0 && this->BullseyeTransformNode->IsTransformToWorldLinear() )
+  {
+    // the pose is recorded when it is received, the camera may be updated later
+    this->BullseyeTransformNode->GetMatrixTransformToWorld( this->ToolToRASMatrix );
+    this->ToolPosePredictor->AddPose( this->ToolToRASMatrix );
+  }
+  if ( this->Renderer == NULL )
+  {
+    this->ApplyBullseyeCamera( true );
+    return;
+  }
+  if ( this->BullseyeCameraUpdatePending )
+  {
+    // a render has already been requested, the camera will be set from the latest transform then
+    this->PerformanceCounters->UpdateSkipped();
+    return;
+  }
+  this->BullseyeCameraUpdatePending = true;
+  if ( this->CameraNode != NULL )
+  {
+    // request a render of the view
+    this->CameraNode->Modified();
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::RendererCallback( vtkObject* vtkNotUsed( caller ), unsigned long event, void* clientData, void* vtkNotUsed( callData ) )
+{
+  vtkSlicerViewpointLogic* self = reinterpret_cast< vtkSlicerViewpointLogic* >( clientData );
+  if ( self == NULL || event != vtkCommand::StartEvent )
+  {
+    return;
+  }
+  if ( self->BullseyeActive && self->BullseyeCameraUpdatePending )
+  {
+    // The view is being rendered already, no need to request another render
+    self->ApplyBullseyeCamera( false );
+  }
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerViewpointLogic::ComputeBullseyeCameraPose( double positionRAS[ 3 ], double focalPointRAS[ 3 ], double viewUpRAS[ 3 ] )
+{
+  if ( this->BullseyeTransformNode == NULL )
+  {
+    return false;
+  }
+  if ( this->GetBullseyeLatencyCompensationSec() > 0.0 && this->BullseyeTransformNode->IsTransformToWorldLinear()
+    && this->ToolPosePredictor->GetPredictedPose( this->ToolToRASMatrix ) )
+  {
+    this->ToolToRASTransform->Identity();
+    this->ToolToRASTransform->Concatenate( this->ToolToRASMatrix );
+  }
+  else
+  {
+    this->BullseyeTransformNode->GetTransformToWorld( this->ToolToRASTransform );
+  }
+
+  this->ToolToRASTransform->TransformPoint( this->BullseyeCameraPositionMm, positionRAS );
+
+  if ( this->BullseyeForcedTarget )
+  {
+    focalPointRAS[ 0 ] = this->BullseyeTargetPositionRAS[ 0 ];
+    focalPointRAS[ 1 ] = this->BullseyeTargetPositionRAS[ 1 ];
+    focalPointRAS[ 2 ] = this->BullseyeTargetPositionRAS[ 2 ];
+  }
+  else
+  {
+    double focalPointInToolMm[ 3 ] = { this->BullseyeCameraPositionMm[ 0 ], this->BullseyeCameraPositionMm[ 1 ],
+      this->BullseyeCameraPositionMm[ 2 ] - BULLSEYE_FOCAL_POINT_DISTANCE_MM };
+    this->ToolToRASTransform->TransformPoint( focalPointInToolMm, focalPointRAS );
+  }
+
+  if ( this->BullseyeForcedUpDirection )
+  {
+    double forwardDirectionRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+    vtkMath::Subtract( focalPointRAS, positionRAS, forwardDirectionRAS );
+    if ( vtkMath::Normalize( forwardDirectionRAS ) < BULLSEYE_EPSILON )
+    {
+      vtkWarningMacro( "ComputeBullseyeCameraPose: Camera position and focal point are the same. Check target model? Using [0,0,-1] as target direction." );
+      forwardDirectionRAS[ 0 ] = 0.0;
+      forwardDirectionRAS[ 1 ] = 0.0;
+      forwardDirectionRAS[ 2 ] = -1.0;
+    }
+    // cross product of the forward direction with the up direction is the right direction
+    double upDirectionRAS[ 3 ] = { this->BullseyeUpDirectionRAS[ 0 ], this->BullseyeUpDirectionRAS[ 1 ], this->BullseyeUpDirectionRAS[ 2 ] };
+    double rightDirectionRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+    vtkMath::Cross( forwardDirectionRAS, upDirectionRAS, rightDirectionRAS );
+    if ( vtkMath::Norm( rightDirectionRAS ) < BULLSEYE_EPSILON )
+    {
+      // forward direction is parallel to the up direction, this one cannot be parallel to it then
+      vtkWarningMacro( "ComputeBullseyeCameraPose: Camera is pointing in the up direction. Workaround used." );
+      upDirectionRAS[ 0 ] = 1.0;
+      upDirectionRAS[ 1 ] = 1.0;
+      upDirectionRAS[ 2 ] = 1.0;
+      vtkMath::Normalize( upDirectionRAS );
+      vtkMath::Cross( forwardDirectionRAS, upDirectionRAS, rightDirectionRAS );
+    }
+    vtkMath::Normalize( rightDirectionRAS );
+    // corrected up direction is orthogonal to the forward direction
+    vtkMath::Cross( rightDirectionRAS, forwardDirectionRAS, viewUpRAS );
+    vtkMath::Normalize( viewUpRAS );
+  }
+  else
+  {
+    double toolOriginMm[ 3 ] = { 0.0, 0.0, 0.0 };
+    double upDirectionInTool[ 3 ] = { 0.0, 1.0, 0.0 }; // standard up direction in OpenGL
+    this->ToolToRASTransform->TransformVectorAtPoint( toolOriginMm, upDirectionInTool, viewUpRAS );
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::ApplyBullseyeCamera( bool invokeCameraModified )
+{
+  this->BullseyeCameraUpdatePending = false;
+  if ( this->CameraNode == NULL || this->CameraNode->GetCamera() == NULL )
+  {
+    vtkErrorMacro( "ApplyBullseyeCamera: Camera node is invalid" );
+    return;
+  }
+  double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+  double positionRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+  double focalPointRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+  double viewUpRAS[ 3 ] = { 0.0, 0.0, 0.0 };
+  if ( !this->ComputeBullseyeCameraPose( positionRAS, focalPointRAS, viewUpRAS ) )
+  {
+    return;
+  }
+
+  // Camera node invokes modified event for each change of the camera. All the changes are
+  // done at once, so one event is enough, and none is needed if the view is being rendered.
+  int wasModifying = this->CameraNode->StartModify();
+
+  vtkCamera* camera = this->CameraNode->GetCamera();
+  if ( this->BullseyeCameraParallelProjection )
+  {
+    camera->SetParallelScale( this->BullseyeCameraParallelScale );
+  }
+  else
+  {
+    camera->SetViewAngle( this->BullseyeCameraViewAngleDeg );
+  }
+  camera->SetRoll( 180 ); // appears to be the default value for a camera in Slicer
+  camera->SetPosition( positionRAS );
+  camera->SetFocalPoint( focalPointRAS );
+  camera->SetViewUp( viewUpRAS );
+
+  if ( this->Renderer != NULL )
+  {
+    // without this some objects do not appear in the 3D view
+    this->Renderer->ResetCameraClippingRange();
+  }
+
+  if ( invokeCameraModified )
+  {
+    this->CameraNode->EndModify( wasModifying );
+  }
+  else
+  {
+    // restore the previous state without invoking the pending modified event
+    this->CameraNode->SetDisableModifiedEvent( wasModifying );
+  }
+  this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+}
+
+//------------------------------------------------------------------------------
+void vtkSlicerViewpointLogic::SetAutoCenterModelNode( vtkMRMLModelNode* modelNode )
+{
+  if ( this->AutoCenterModelNode == modelNode )
+  {
+    return;
+  }
+  this->AutoCenterModelNode = modelNode;
+  this->Modified();
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLModelNode* vtkSlicerViewpointLogic::GetAutoCenterModelNode()
+{
+  return this->AutoCenterModelNode;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerViewpointLogic::GetAutoCenterModelBoundingSphere( double centerModel[ 3 ], double& radiusModel, vtkMatrix4x4* modelToRASMatrix )
+{
+  if ( this->AutoCenterModelNode == NULL )
+  {
+    return false;
+  }
+
+  vtkMRMLTransformNode* parentTransformNode = this->AutoCenterModelNode->GetParentTransformNode();
+  if ( parentTransformNode != NULL && !parentTransformNode->IsTransformToWorldLinear() )
+  {
+    // the model is warped, the sphere cannot be transformed by a matrix
+    double boundsRAS[ 6 ] = { 1.0, -1.0, 1.0, -1.0, 1.0, -1.0 };
+    this->AutoCenterModelNode->GetRASBounds( boundsRAS );
+    if ( boundsRAS[ 0 ] > boundsRAS[ 1 ] )
+    {
+      return false;
+    }
+    double diagonalLength2 = 0.0;
+    for ( int i = 0; i < 3; i++ )
+    {
+      centerModel[ i ] = ( boundsRAS[ 2 * i ] + boundsRAS[ 2 * i + 1 ] ) / 2.0;
+      diagonalLength2 += ( boundsRAS[ 2 * i + 1 ] - boundsRAS[ 2 * i ] ) * ( boundsRAS[ 2 * i + 1 ] - boundsRAS[ 2 * i ] );
+    }
+    radiusModel = sqrt( diagonalLength2 ) / 2.0;
+    modelToRASMatrix->Identity();
+    return true;
+  }
+
+  vtkPolyData* polyData = this->AutoCenterModelNode->GetPolyData();
+  if ( polyData == NULL || polyData->GetPoints() == NULL || polyData->GetNumberOfPoints() == 0 )
+  {
+    return false;
+  }
+  if ( polyData != this->AutoCenterSpherePolyData || polyData->GetMTime() != this->AutoCenterSpherePolyDataMTime )
+  {
+    // The sphere is centered at the middle of the bounding box and contains all points.
+    // Computed only when the model is changed, not in each update.
+    vtkPoints* points = polyData->GetPoints();
+    double bounds[ 6 ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    points->GetBounds( bounds );
+    this->AutoCenterSphereCenterModel[ 0 ] = ( bounds[ 0 ] + bounds[ 1 ] ) / 2.0;
+    this->AutoCenterSphereCenterModel[ 1 ] = ( bounds[ 2 ] + bounds[ 3 ] ) / 2.0;
+    this->AutoCenterSphereCenterModel[ 2 ] = ( bounds[ 4 ] + bounds[ 5 ] ) / 2.0;
+    double maximumDistance2 = 0.0;
+    vtkIdType numberOfPoints = points->GetNumberOfPoints();
+    for ( vtkIdType pointIndex = 0; pointIndex < numberOfPoints; pointIndex++ )
+    {
+      double point[ 3 ] = { 0.0, 0.0, 0.0 };
+      points->GetPoint( pointIndex, point );
+      double distance2 = vtkMath::Distance2BetweenPoints( point, this->AutoCenterSphereCenterModel );
+      if ( distance2 > maximumDistance2 )
+      {
+        maximumDistance2 = distance2;
+      }
+    }
+    this->AutoCenterSphereRadiusModel = sqrt( maximumDistance2 );
+    this->AutoCenterSpherePolyData = polyData;
+    this->AutoCenterSpherePolyDataMTime = polyData->GetMTime();
+  }
+  centerModel[ 0 ] = this->AutoCenterSphereCenterModel[ 0 ];
+  centerModel[ 1 ] = this->AutoCenterSphereCenterModel[ 1 ];
+  centerModel[ 2 ] = this->AutoCenterSphereCenterModel[ 2 ];
+  radiusModel = this->AutoCenterSphereRadiusModel;
+
+  if ( parentTransformNode != NULL )
+  {
+    parentTransformNode->GetMatrixTransformToWorld( modelToRASMatrix );
+  }
+  else
+  {
+    modelToRASMatrix->Identity();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerViewpointLogic::UpdateAutoCenterModelToViewMatrix( double centerModel[ 3 ], double& radiusModel )
+{
+  if ( this->CameraNode == NULL || this->CameraNode->GetCamera() == NULL )
+  {
+    vtkErrorMacro( "UpdateAutoCenterModelToViewMatrix: Camera node is invalid" );
+    return false;
+  }
+  if ( !this->GetAutoCenterModelBoundingSphere( centerModel, radiusModel, this->ModelToRASMatrix ) )
+  {
+    return false;
+  }
+  // same projection as in vtkRenderer::WorldToView
+  double aspectRatio = ( this->Renderer != NULL ? this->Renderer->GetTiledAspectRatio() : 1.0 );
+  vtkMatrix4x4* rasToViewMatrix = this->CameraNode->GetCamera()->GetCompositeProjectionTransformMatrix( aspectRatio, 0, 1 );
+  vtkMatrix4x4::Multiply4x4( rasToViewMatrix, this->ModelToRASMatrix, this->ModelToViewMatrix );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerViewpointLogic::IsAutoCenterModelInSafeZone()
+{
+  double centerModel[ 3 ] = { 0.0, 0.0, 0.0 };
+  double radiusModel = 0.0;
+  if ( !this->UpdateAutoCenterModelToViewMatrix( centerModel, radiusModel ) )
+  {
+    return true;
+  }
+
+  // The normalized view coordinate along an axis is (row[axis] * p) / (row[3] * p), where p is a homogeneous point
+  // in the model coordinate system and row is a row of the model to view matrix. Each limit of the safe zone is
+  // therefore a plane in the model coordinate system, and the sphere is inside the limit if its center
+  // is at least one radius away from the plane on the inner side.
+  // Points behind the camera cannot be inside both limits of an axis.
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    for ( int side = 0; side < 2; side++ )
+    {
+      double limit = this->AutoCenterSafeZoneNormalizedViewport[ 2 * axis + side ];
+      double sign = ( side == 0 ? -1.0 : 1.0 ); // outer side of the plane is positive
+      double plane[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+      for ( int i = 0; i < 4; i++ )
+      {
+        plane[ i ] = sign * ( this->ModelToViewMatrix->GetElement( axis, i ) - limit * this->ModelToViewMatrix->GetElement( 3, i ) );
+      }
+      double signedDistance = vtkMath::Dot( plane, centerModel ) + plane[ 3 ];
+      double normalLength = vtkMath::Norm( plane );
+      if ( normalLength < AUTO_CENTER_EPSILON )
+      {
+        // degenerate projection, the limit does not depend on the position
+        if ( signedDistance > 0.0 )
+        {
+          return false;
+        }
+        continue;
+      }
+      if ( signedDistance / normalLength > -radiusModel )
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkSlicerViewpointLogic::ComputeAutoCenterCameraTranslation( double translationRAS[ 3 ] )
+{
+  translationRAS[ 0 ] = 0.0;
+  translationRAS[ 1 ] = 0.0;
+  translationRAS[ 2 ] = 0.0;
+  double centerModel[ 3 ] = { 0.0, 0.0, 0.0 };
+  double radiusModel = 0.0;
+  if ( !this->UpdateAutoCenterModelToViewMatrix( centerModel, radiusModel ) )
+  {
+    return false;
+  }
+
+  // center of the safe zone in the model coordinate system
+  vtkNew< vtkMatrix4x4 > viewToModelMatrix;
+  vtkMatrix4x4::Invert( this->ModelToViewMatrix, viewToModelMatrix.GetPointer() );
+  double targetView[ 4 ] = { 0.0, 0.0, 0.0, 1.0 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    targetView[ axis ] = ( this->AutoCenterSafeZoneNormalizedViewport[ 2 * axis ] + this->AutoCenterSafeZoneNormalizedViewport[ 2 * axis + 1 ] ) / 2.0;
+  }
+  double targetModel[ 4 ] = { 0.0, 0.0, 0.0, 1.0 };
+  viewToModelMatrix->MultiplyPoint( targetView, targetModel );
+  if ( fabs( targetModel[ 3 ] ) < AUTO_CENTER_EPSILON )
+  {
+    vtkErrorMacro( "ComputeAutoCenterCameraTranslation: Center of the safe zone cannot be computed" );
+    return false;
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    targetModel[ i ] /= targetModel[ 3 ];
+  }
+  targetModel[ 3 ] = 1.0;
+
+  // difference of the model center and the target in the camera coordinate system
+  vtkMatrix4x4* rasToCameraMatrix = this->CameraNode->GetCamera()->GetViewTransformMatrix();
+  vtkNew< vtkMatrix4x4 > modelToCameraMatrix;
+  vtkMatrix4x4::Multiply4x4( rasToCameraMatrix, this->ModelToRASMatrix, modelToCameraMatrix.GetPointer() );
+  double centerModelHomogeneous[ 4 ] = { centerModel[ 0 ], centerModel[ 1 ], centerModel[ 2 ], 1.0 };
+  double centerCamera[ 4 ] = { 0.0, 0.0, 0.0, 1.0 };
+  double targetCamera[ 4 ] = { 0.0, 0.0, 0.0, 1.0 };
+  modelToCameraMatrix->MultiplyPoint( centerModelHomogeneous, centerCamera );
+  modelToCameraMatrix->MultiplyPoint( targetModel, targetCamera );
+  bool adjust[ 3 ] = { this->AutoCenterAdjustX, this->AutoCenterAdjustY, this->AutoCenterAdjustZ };
+  double translationCamera[ 3 ] = { 0.0, 0.0, 0.0 };
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    if ( adjust[ axis ] )
+    {
+      translationCamera[ axis ] = centerCamera[ axis ] - targetCamera[ axis ];
+    }
+  }
+
+  // the camera view transform is rigid, its inverse rotation is the transpose
+  for ( int i = 0; i < 3; i++ )
+  {
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+      translationRAS[ i ] += rasToCameraMatrix->GetElement( axis, i ) * translationCamera[ axis ];
+    }
+  }
+  return true;
+}
@@ -0,0 +1,200 @@
+#ifndef __vtkSlicerViewpointLogic_h
+#define __vtkSlicerViewpointLogic_h
+
+#include <vtkMRMLAbstractLogic.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+// export
+#include "vtkSlicerViewpointModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkGeneralTransform;
+class vtkMatrix4x4;
+class vtkMRMLCameraNode;
+class vtkMRMLModelNode;
+class vtkMRMLTransformNode;
+class vtkPerformanceCounters;
+class vtkPolyData;
+class vtkRenderer;
+class vtkTransformPredictor;
+
+// Camera control of one 3D view for the Viewpoint module.
+// In bullseye mode the camera is attached to a tracked tool: camera position, focal point
+// and view up direction are computed from the tool transform each time it is modified.
+// Tool transform changes may come much more frequently than the view is rendered
+// (e.g., a 100Hz tracker), therefore the camera is not updated on each change. The first
+// change only requests a render and the camera is set from the latest tool transform
+// when rendering of the view starts, so there is at most one camera update per rendered frame.
+// If no renderer is set then the camera is updated immediately on each change.
+// Optionally, the tool pose is extrapolated to compensate for the tracking and display latency.
+// In auto-center mode the model is represented by its bounding sphere, which is computed in the
+// model coordinate system and cached until the model's polydata changes. The safe zone of the view
+// is converted to planes in the model coordinate system using one matrix product per update,
+// so the safe zone test does not transform any model points.
+class VTK_SLICER_VIEWPOINT_MODULE_LOGIC_EXPORT vtkSlicerViewpointLogic : public vtkMRMLAbstractLogic
+{
+  public:
+    vtkTypeMacro( vtkSlicerViewpointLogic, vtkMRMLAbstractLogic );
+    static vtkSlicerViewpointLogic* New();
+
+    void PrintSelf( ostream &os, vtkIndent indent ) VTK_OVERRIDE;
+
+    // Camera of the controlled view
+    void SetCameraNode( vtkMRMLCameraNode* cameraNode );
+    vtkMRMLCameraNode* GetCameraNode();
+
+    // Renderer of the controlled view. Pending camera updates are applied when it starts rendering.
+    void SetRenderer( vtkRenderer* renderer );
+    vtkRenderer* GetRenderer();
+
+    // Tool transform that the camera is attached to in bullseye mode
+    void SetAndObserveBullseyeTransformNode( vtkMRMLTransformNode* transformNode );
+    vtkGetObjectMacro( BullseyeTransformNode, vtkMRMLTransformNode );
+
+    // Camera position in the tool coordinate system (mm). The camera looks along the -z axis of the tool.
+    vtkSetVector3Macro( BullseyeCameraPositionMm, double );
+    vtkGetVector3Macro( BullseyeCameraPositionMm, double );
+
+    // If enabled then the camera up direction is kept close to BullseyeUpDirectionRAS,
+    // otherwise it is the y axis of the tool.
+    vtkSetMacro( BullseyeForcedUpDirection, bool );
+    vtkGetMacro( BullseyeForcedUpDirection, bool );
+    vtkSetVector3Macro( BullseyeUpDirectionRAS, double );
+    vtkGetVector3Macro( BullseyeUpDirectionRAS, double );
+
+    // If enabled then the camera points to BullseyeTargetPositionRAS,
+    // otherwise in the direction the tool is pointing.
+    vtkSetMacro( BullseyeForcedTarget, bool );
+    vtkGetMacro( BullseyeForcedTarget, bool );
+    vtkSetVector3Macro( BullseyeTargetPositionRAS, double );
+    vtkGetVector3Macro( BullseyeTargetPositionRAS, double );
+
+    // View angle is used in perspective projection, parallel scale in parallel projection.
+    // The projection mode itself is stored in the view node, it is not changed by this class.
+    vtkSetMacro( BullseyeCameraParallelProjection, bool );
+    vtkGetMacro( BullseyeCameraParallelProjection, bool );
+    vtkSetMacro( BullseyeCameraViewAngleDeg, double );
+    vtkGetMacro( BullseyeCameraViewAngleDeg, double );
+    vtkSetMacro( BullseyeCameraParallelScale, double );
+    vtkGetMacro( BullseyeCameraParallelScale, double );
+
+    // Time (in seconds) from receiving a tool pose to its display. If set then the tool pose is
+    // extrapolated to the time when the rendered frame is displayed (see vtkTransformPredictor).
+    // Only linear tool transforms are extrapolated. 0 means no extrapolation (default).
+    void SetBullseyeLatencyCompensationSec( double latencySec );
+    double GetBullseyeLatencyCompensationSec();
+
+    // Start/stop following the tool transform
+    void StartBullseye();
+    void StopBullseye();
+    vtkGetMacro( BullseyeActive, bool );
+
+    // Set the camera from the current tool transform immediately (e.g., after the parameters are changed)
+    void UpdateBullseyeCamera();
+
+    // Compute the camera pose from the current tool transform and parameters.
+    // Returns false if there is no tool transform.
+    bool ComputeBullseyeCameraPose( double positionRAS[ 3 ], double focalPointRAS[ 3 ], double viewUpRAS[ 3 ] );
+
+    // Number of received tool transform changes, camera updates computed and coalesced
+    // into an already requested render, and the time spent in the camera updates
+    vtkPerformanceCounters* GetPerformanceCounters();
+
+    // Model that is kept in the safe zone of the view in auto-center mode
+    void SetAutoCenterModelNode( vtkMRMLModelNode* modelNode );
+    vtkMRMLModelNode* GetAutoCenterModelNode();
+
+    // Safe zone in normalized view coordinates: x minimum, x maximum, y minimum, y maximum (range -1..1),
+    // z minimum, z maximum (depth, 0 at the near and 1 at the far clipping plane).
+    // The model is moved to the center of the safe zone when it is re-centered.
+    vtkSetVector6Macro( AutoCenterSafeZoneNormalizedViewport, double );
+    vtkGetVector6Macro( AutoCenterSafeZoneNormalizedViewport, double );
+
+    // Enable camera translation along the camera x (right), y (up), z (backward) axes when re-centering
+    vtkSetMacro( AutoCenterAdjustX, bool );
+    vtkGetMacro( AutoCenterAdjustX, bool );
+    vtkSetMacro( AutoCenterAdjustY, bool );
+    vtkGetMacro( AutoCenterAdjustY, bool );
+    vtkSetMacro( AutoCenterAdjustZ, bool );
+    vtkGetMacro( AutoCenterAdjustZ, bool );
+
+    // Returns true if the bounding sphere of the model is completely inside the safe zone of the view.
+    // Returns true if there is no model to keep in the view.
+    bool IsAutoCenterModelInSafeZone();
+
+    // Compute the camera translation that moves the center of the model's bounding sphere to the center of the safe zone.
+    // Translation along disabled axes is zero. Returns false if the translation cannot be computed.
+    bool ComputeAutoCenterCameraTranslation( double translationRAS[ 3 ] );
+
+  protected:
+    vtkSlicerViewpointLogic();
+    ~vtkSlicerViewpointLogic();
+
+    void ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* callData ) VTK_OVERRIDE;
+
+    static void RendererCallback( vtkObject* caller, unsigned long event, void* clientData, void* callData );
+
+  private:
+    // Set the camera pose. If invokeCameraModified is false then the camera node does not
+    // invoke modified event (used when the view is already being rendered).
+    void ApplyBullseyeCamera( bool invokeCameraModified );
+
+    // Get the bounding sphere of the auto-center model and the transform from its coordinate system to RAS.
+    // The sphere is recomputed only if the polydata has been modified. If the model is under a non-linear
+    // transform then the sphere of the transformed bounding box is returned in RAS with an identity transform.
+    bool GetAutoCenterModelBoundingSphere( double centerModel[ 3 ], double& radiusModel, vtkMatrix4x4* modelToRASMatrix );
+
+    // Update ModelToViewMatrix from the model transform and the current camera and renderer
+    bool UpdateAutoCenterModelToViewMatrix( double centerModel[ 3 ], double& radiusModel );
+
+    vtkSmartPointer< vtkMRMLCameraNode > CameraNode;
+    vtkSmartPointer< vtkRenderer > Renderer;
+    vtkSmartPointer< vtkCallbackCommand > RendererCallbackCommand;
+    unsigned long RendererObserverTag;
+
+    vtkMRMLTransformNode* BullseyeTransformNode;
+    double BullseyeCameraPositionMm[ 3 ];
+    bool BullseyeForcedUpDirection;
+    double BullseyeUpDirectionRAS[ 3 ];
+    bool BullseyeForcedTarget;
+    double BullseyeTargetPositionRAS[ 3 ];
+    bool BullseyeCameraParallelProjection;
+    double BullseyeCameraViewAngleDeg;
+    double BullseyeCameraParallelScale;
+
+    bool BullseyeActive;
+    // Tool transform has changed since the camera was last updated
+    bool BullseyeCameraUpdatePending;
+
+    // Reused for each camera update
+    vtkSmartPointer< vtkGeneralTransform > ToolToRASTransform;
+    vtkSmartPointer< vtkMatrix4x4 > ToolToRASMatrix;
+
+    // Extrapolates the tool pose for latency compensation
+    vtkSmartPointer< vtkTransformPredictor > ToolPosePredictor;
+
+    vtkSmartPointer< vtkPerformanceCounters > PerformanceCounters;
+
+    vtkWeakPointer< vtkMRMLModelNode > AutoCenterModelNode;
+    double AutoCenterSafeZoneNormalizedViewport[ 6 ];
+    bool AutoCenterAdjustX;
+    bool AutoCenterAdjustY;
+    bool AutoCenterAdjustZ;
+
+    // Cached bounding sphere of the model polydata, valid while the polydata is not modified
+    vtkWeakPointer< vtkPolyData > AutoCenterSpherePolyData;
+    unsigned long AutoCenterSpherePolyDataMTime;
+    double AutoCenterSphereCenterModel[ 3 ];
+    double AutoCenterSphereRadiusModel;
+
+    // Reused for each auto-center update
+    vtkSmartPointer< vtkMatrix4x4 > ModelToRASMatrix;
+    vtkSmartPointer< vtkMatrix4x4 > ModelToViewMatrix;
+
+    // Not implemented:
+    vtkSlicerViewpointLogic( const vtkSlicerViewpointLogic& );
+    void operator=( const vtkSlicerViewpointLogic& );
+};
+
+#endif
@@ -805,7 +805,10 @@ class ViewpointInstance:
 
     # BULLSEYE
     self.bullseyeTransformNode = None
-    self.bullseyeTransformNodeObserverTags = []
+    # Camera poses are computed and applied in C++, at most once per rendered frame.
+    # The same logic performs the safe zone test and the re-centering computation in auto-center mode.
+    import vtkSlicerViewpointModuleLogicPython
+    self.bullseyeLogic = vtkSlicerViewpointModuleLogicPython.vtkSlicerViewpointLogic()
     self.bullseyeCameraXPosMm =  0.0
     self.bullseyeCameraYPosMm =  0.0
     self.bullseyeCameraZPosMm =  0.0
@@ -831,6 +834,8 @@ class ViewpointInstance:
     self.bullseyeCameraViewAngleDeg  =  30.0
     self.bullseyeCameraParallelScale = 1.0
 
+    self.bullseyeLatencyCompensationSec = 0.0 # the tool pose is extrapolated by this time if > 0
+
     # AUTO-CENTER
     #inputs
     self.autoCenterSafeXMinimumNormalizedViewport = -1.0
@@ -865,8 +870,6 @@ class ViewpointInstance:
     self.autoCenterBaseCameraFocalPointRas = [0,0,0]
     self.autoCenterModelInSafeZone = True
 
-    self.autoCenterModelTargetPositionViewport = [0,0,0]
-
   def setViewNode(self, node):
     self.viewNode = node
 
@@ -890,55 +893,6 @@ class ViewpointInstance:
     camera = camerasLogic.GetViewActiveCameraNode(slicer.util.getNode(viewName))
     return camera
 
-  def convertRasToViewport(self, positionRas):
-    """Computes normalized view coordinates from RAS coordinates
-    Normalized view coordinates origin is in bottom-left corner, range is [-1,+1]
-    """
-    x = vtk.mutable(positionRas[0])
-    y = vtk.mutable(positionRas[1])
-    z = vtk.mutable(positionRas[2])
-    view = slicer.app.layoutManager().threeDWidget(self.getThreeDWidgetIndex()).threeDView()
-    renderer = view.renderWindow().GetRenderers().GetItemAsObject(0)
-    renderer.WorldToView(x,y,z)
-    return [x.get(), y.get(), z.get()]
-
-  def convertViewportToRas(self, positionViewport):
-    x = vtk.mutable(positionViewport[0])
-    y = vtk.mutable(positionViewport[1])
-    z = vtk.mutable(positionViewport[2])
-    view = slicer.app.layoutManager().threeDWidget(self.getThreeDWidgetIndex()).threeDView()
-    renderer = view.renderWindow().GetRenderers().GetItemAsObject(0)
-    renderer.ViewToWorld(x,y,z)
-    return [x.get(), y.get(), z.get()]
-
-  def convertPointRasToCamera(self, positionRas):
-    viewName = self.viewNode.GetName()
-    cameraNode = self.getCameraNode(viewName)
-    cameraObj = cameraNode.GetCamera()
-    modelViewTransform = cameraObj.GetModelViewTransformObject()
-    positionRasHomog = [positionRas[0], positionRas[1], positionRas[2], 1] # convert to homogeneous
-    positionCamHomog = [0,0,0,1] # to be filled in
-    modelViewTransform.MultiplyPoint(positionRasHomog, positionCamHomog)
-    positionCam = [positionCamHomog[0], positionCamHomog[1], positionCamHomog[2]] # convert from homogeneous
-    return positionCam
-
-  def convertVectorCameraToRas(self, positionCam):
-    viewName = self.viewNode.GetName()
-    cameraNode = self.getCameraNode(viewName)
-    cameraObj = cameraNode.GetCamera()
-    modelViewTransform = cameraObj.GetModelViewTransformObject()
-    modelViewMatrix = modelViewTransform.GetMatrix()
-    modelViewInverseMatrix = vtk.vtkMatrix4x4()
-    vtk.vtkMatrix4x4.Invert(modelViewMatrix, modelViewInverseMatrix)
-    modelViewInverseTransform = vtk.vtkTransform()
-    modelViewInverseTransform.DeepCopy(modelViewTransform)
-    modelViewInverseTransform.SetMatrix(modelViewInverseMatrix)
-    positionCamHomog = [positionCam[0], positionCam[1], positionCam[2], 0] # convert to homogeneous
-    positionRasHomog = [0,0,0,0] # to be filled in
-    modelViewInverseTransform.MultiplyPoint(positionCamHomog, positionRasHomog)
-    positionRas = [positionRasHomog[0], positionRasHomog[1], positionRasHomog[2]] # convert from homogeneous
-    return positionRas
-
   def resetCameraClippingRange(self):
     view = slicer.app.layoutManager().threeDWidget(self.getThreeDWidgetIndex()).threeDView()
     renderer = view.renderWindow().GetRenderers().GetItemAsObject(0)
@@ -977,8 +931,13 @@ class ViewpointInstance:
       return
 
     self.currentMode = self.currentModeBULLSEYE
-    self.bullseyeAddObservers()
-    self.bullseyeUpdate()
+    viewName = self.viewNode.GetName()
+    view = slicer.app.layoutManager().threeDWidget(self.getThreeDWidgetIndex()).threeDView()
+    self.bullseyeLogic.SetCameraNode(self.getCameraNode(viewName))
+    self.bullseyeLogic.SetRenderer(view.renderWindow().GetRenderers().GetItemAsObject(0))
+    self.bullseyeLogic.SetAndObserveBullseyeTransformNode(self.bullseyeTransformNode)
+    self.bullseyeUpdateLogicParameters()
+    self.bullseyeLogic.StartBullseye()
 
   def bullseyeStop(self):
     logging.debug("Stop Viewpoint Mode")
@@ -986,40 +945,32 @@ class ViewpointInstance:
       logging.error("bullseyeStop was called, but viewpoint mode is not BULLSEYE. No action performed.")
       return
     self.currentMode = self.currentModeOFF
-    self.bullseyeRemoveObservers();
+    self.bullseyeLogic.StopBullseye()
+    self.bullseyeLogic.SetAndObserveBullseyeTransformNode(None)
+    self.bullseyeLogic.SetRenderer(None)
 
   def bullseyeUpdate(self):
-    # no logging - it slows Slicer down a *lot*
-
-    # Need to set camera attributes according to the concatenated transform
-    toolCameraToRASTransform = vtk.vtkGeneralTransform()
-    self.bullseyeTransformNode.GetTransformToWorld(toolCameraToRASTransform)
-
-    cameraOriginInRASMm = self.bullseyeComputeCameraOriginInRASMm(toolCameraToRASTransform)
-    focalPointInRASMm = self.bullseyeComputeCameraFocalPointInRASMm(toolCameraToRASTransform)
-    upDirectionInRAS = self.bullseyeComputeCameraUpDirectionInRAS(toolCameraToRASTransform,cameraOriginInRASMm,focalPointInRASMm)
-
-    self.bullseyeSetCameraParameters(cameraOriginInRASMm,focalPointInRASMm,upDirectionInRAS)
-
-  def bullseyeAddObservers(self): # mostly copied from PositionErrorMapping.py in PLUS
-    logging.debug("Adding observers...")
-    transformModifiedEvent = 15000
-    transformNode = self.bullseyeTransformNode
-    while transformNode:
-      logging.debug("Add observer to {0}".format(transformNode.GetName()))
-      self.bullseyeTransformNodeObserverTags.append([transformNode, transformNode.AddObserver(transformModifiedEvent, self.bullseyeOnTransformModified)])
-      transformNode = transformNode.GetParentTransformNode()
-    logging.debug("Done adding observers")
-
-  def bullseyeRemoveObservers(self):
-    logging.debug("Removing observers...")
-    for nodeTagPair in self.bullseyeTransformNodeObserverTags:
-      nodeTagPair[0].RemoveObserver(nodeTagPair[1])
-    logging.debug("Done removing observers")
-
-  def bullseyeOnTransformModified(self, observer, eventid):
-    # no logging - it slows Slicer down a *lot*
-    self.bullseyeUpdate()
+    # Tool transform changes are processed by the C++ logic, this is only needed when parameters are changed
+    self.bullseyeUpdateLogicParameters()
+    self.bullseyeLogic.UpdateBullseyeCamera()
+
+  def bullseyeUpdateLogicParameters(self):
+    self.bullseyeLogic.SetBullseyeCameraPositionMm(self.bullseyeCameraXPosMm,self.bullseyeCameraYPosMm,self.bullseyeCameraZPosMm)
+    self.bullseyeLogic.SetBullseyeForcedUpDirection(self.bullseyeForcedUpDirection)
+    self.bullseyeLogic.SetBullseyeUpDirectionRAS(self.bullseyeUpDirectionRAS)
+    self.bullseyeLogic.SetBullseyeForcedTarget(self.bullseyeForcedTarget)
+    self.bullseyeLogic.SetBullseyeTargetPositionRAS(self.bullseyeTargetModelMiddleInRASMm)
+    self.bullseyeLogic.SetBullseyeCameraParallelProjection(self.bullseyeCameraParallelProjection)
+    self.bullseyeLogic.SetBullseyeCameraViewAngleDeg(self.bullseyeCameraViewAngleDeg)
+    self.bullseyeLogic.SetBullseyeCameraParallelScale(self.bullseyeCameraParallelScale)
+    self.bullseyeLogic.SetBullseyeLatencyCompensationSec(self.bullseyeLatencyCompensationSec)
+    # Parallel (a.k.a. orthographic) / perspective projection mode is stored in the view node.
+    # Change it in the view node instead of directly in the camera VTK object
+    # (if we changed the projection mode in the camera VTK object then the next time the camera is updated from the view node
+    # the rendering mode is reset to the value stored in the view node).
+    viewNodeParallelProjection = (self.viewNode.GetRenderMode() == slicer.vtkMRMLViewNode.Orthographic)
+    if viewNodeParallelProjection != self.bullseyeCameraParallelProjection:
+      self.viewNode.SetRenderMode(slicer.vtkMRMLViewNode.Orthographic if self.bullseyeCameraParallelProjection else slicer.vtkMRMLViewNode.Perspective)
 
   def bullseyeSetTransformNode(self, transformNode):
     self.bullseyeTransformNode = transformNode
@@ -1095,99 +1046,18 @@ class ViewpointInstance:
     if (self.currentMode == self.currentModeBULLSEYE):
       self.bullseyeUpdate()
 
+  def bullseyeSetLatencyCompensationSec(self,valueSec):
+    logging.debug("bullseyeSetLatencyCompensationSec")
+    self.bullseyeLatencyCompensationSec = valueSec
+    if (self.currentMode == self.currentModeBULLSEYE):
+      self.bullseyeUpdate()
+
   def bullseyeSetUpDirectionRAS(self,vectorInRAS):
     logging.debug("bullseyeSetUpDirectionRAS")
     self.bullseyeUpDirectionRAS = vectorInRAS
     if (self.currentMode == self.currentModeBULLSEYE):
       self.bullseyeUpdate()
 
-  def bullseyeComputeCameraOriginInRASMm(self, toolCameraToRASTransform):
-    # Need to get camera origin and axes from camera coordinates into Slicer RAS coordinates
-    cameraOriginInToolCameraMm = [self.bullseyeCameraXPosMm,self.bullseyeCameraYPosMm,self.bullseyeCameraZPosMm]
-    cameraOriginInRASMm = [0,0,0] # placeholder values
-    toolCameraToRASTransform.TransformPoint(cameraOriginInToolCameraMm,cameraOriginInRASMm)
-    return cameraOriginInRASMm
-
-  def bullseyeComputeCameraFocalPointInRASMm(self, toolCameraToRASTransform):
-    focalPointInRASMm = [0,0,0]; # placeholder values
-    if (self.bullseyeForcedTarget == True):
-      focalPointInRASMm = self.bullseyeTargetModelMiddleInRASMm
-    else:
-      # camera distance depends on slider, but lies in -z (which is the direction that the camera is facing)
-      focalPointInToolCameraMm = [self.bullseyeCameraXPosMm,self.bullseyeCameraYPosMm,self.bullseyeCameraZPosMm-200] # The number 200 mm is arbitrary. TODO: Change so that this is the camera-tumor distance
-      focalPointInRASMm = [0,0,0] # placeholder values
-      toolCameraToRASTransform.TransformPoint(focalPointInToolCameraMm,focalPointInRASMm)
-    return focalPointInRASMm
-
-  def bullseyeComputeCameraProjectionDirectionInRAS(self, cameraOriginInRASMm, focalPointInRASMm):
-    math = vtk.vtkMath()
-    directionFromOriginToFocalPointRAS = [0,0,0] # placeholder values
-    math.Subtract(focalPointInRASMm,cameraOriginInRASMm,directionFromOriginToFocalPointRAS)
-    math.Normalize(directionFromOriginToFocalPointRAS)
-    numberDimensions = 3;
-    lengthMm = math.Norm(directionFromOriginToFocalPointRAS,numberDimensions)
-    epsilon = 0.0001
-    if (lengthMm < epsilon):
-      logging.warning("Warning: bullseyeComputeCameraProjectionDirectionInRAS() is computing a zero vector. Check target model? Using [0,0,-1] as target direction.")
-      directionFromOriginToFocalPointRAS = [0,0,-1];
-    return directionFromOriginToFocalPointRAS
-
-  def bullseyeComputeCameraUpDirectionInRAS(self, toolCameraToRASTransform, cameraOriginInRASMm, focalPointInRASMm):
-    upDirectionInRAS = [0,0,0] # placeholder values
-    if (self.bullseyeForcedUpDirection == True):
-      math = vtk.vtkMath()
-      # cross product of forwardDirectionInRAS vector with upInRAS vector is the rightDirectionInRAS vector
-      upInRAS = self.bullseyeUpDirectionRAS
-      forwardDirectionInRAS = self.bullseyeComputeCameraProjectionDirectionInRAS(cameraOriginInRASMm, focalPointInRASMm)
-      rightDirectionInRAS = [0,0,0] # placeholder values
-      math.Cross(forwardDirectionInRAS,upInRAS,rightDirectionInRAS)
-      numberDimensions = 3;
-      lengthMm = math.Norm(rightDirectionInRAS,numberDimensions)
-      epsilon = 0.0001
-      if (lengthMm < epsilon): # must check for this case
-        logging.warning("Warning: length of cross product in bullseyeComputeCameraUpDirectionInRAS is zero. Workaround used")
-        backupUpDirectionInRAS = [1,1,1] # if the previous cross product was zero, then this shouldn't be
-        math.Normalize(backupUpDirectionInRAS)
-        upInRAS = backupUpDirectionInRAS
-        math.Cross(forwardDirectionInRAS,upInRAS,rightDirectionInRAS)
-      math.Normalize(rightDirectionInRAS)
-      # now compute the cross product between the rightDirectionInRAS and forwardDirectionInRAS directions to get a corrected up vector
-      upDirectionInRAS = [0,0,0] # placeholder values
-      math.Cross(rightDirectionInRAS,forwardDirectionInRAS,upDirectionInRAS)
-      math.Normalize(upDirectionInRAS)
-    else:
-      upDirectionInToolCamera = [0,1,0] # standard up direction in OpenGL
-      dummyPoint = [0,0,0] # Needed by the TransformVectorAtPoint function
-      toolCameraToRASTransform.TransformVectorAtPoint(dummyPoint,upDirectionInToolCamera,upDirectionInRAS)
-    return upDirectionInRAS
-
-  def bullseyeSetCameraParameters(self,cameraOriginInRASMm,focalPointInRASMm,upDirectionInRAS):
-    viewName = self.viewNode.GetName()
-    cameraNode = self.getCameraNode(viewName)
-    camera = cameraNode.GetCamera()
-    if (self.bullseyeCameraParallelProjection == False):
-      camera.SetViewAngle(self.bullseyeCameraViewAngleDeg)
-    elif (self.bullseyeCameraParallelProjection == True):
-      camera.SetParallelScale(self.bullseyeCameraParallelScale)
-    else:
-      logging.error("Error in Viewpoint: cameraParallelProjection is not 0 or 1. No projection mode has been set! No updates are being performed.")
-      return
-    # Parallel (a.k.a. orthographic) / perspective projection mode is stored in the view node.
-    # Change it in the view node instead of directly in the camera VTK object
-    # (if we changed the projection mode in the camera VTK object then the next time the camera is updated from the view node
-    # the rendering mode is reset to the value stored in the view node).
-    viewNode = slicer.mrmlScene.GetNodeByID(cameraNode.GetActiveTag())
-    viewNodeParallelProjection = (viewNode.GetRenderMode() == slicer.vtkMRMLViewNode.Orthographic)
-    if viewNodeParallelProjection != self.bullseyeCameraParallelProjection:
-      viewNode.SetRenderMode(slicer.vtkMRMLViewNode.Orthographic if self.bullseyeCameraParallelProjection else slicer.vtkMRMLViewNode.Perspective)
-
-    camera.SetRoll(180) # appears to be the default value for a camera in Slicer
-    camera.SetPosition(cameraOriginInRASMm)
-    camera.SetFocalPoint(focalPointInRASMm)
-    camera.SetViewUp(upDirectionInRAS)
-
-    self.resetCameraClippingRange() # without this line, some objects do not appear in the 3D view
-
   # AUTO-CENTER
 
   def autoCenterStart(self):
@@ -1200,7 +1070,11 @@ class ViewpointInstance:
     if not self.autoCenterModelNode:
       logging.warning("Model node not set. Will not proceed until model node is selected.")
       return
-    self.autoCenterSetModelTargetPositionViewport()
+    viewName = self.viewNode.GetName()
+    view = slicer.app.layoutManager().threeDWidget(self.getThreeDWidgetIndex()).threeDView()
+    self.bullseyeLogic.SetCameraNode(self.getCameraNode(viewName))
+    self.bullseyeLogic.SetRenderer(view.renderWindow().GetRenderers().GetItemAsObject(0))
+    self.autoCenterUpdateLogicParameters()
     self.autoCenterSystemTimeAtLastUpdateSeconds = time.time()
     nextUpdateTimerMilliseconds = self.autoCenterUpdateRateSeconds * 1000
     qt.QTimer.singleShot(nextUpdateTimerMilliseconds ,self.autoCenterUpdate)
@@ -1213,6 +1087,8 @@ class ViewpointInstance:
       logging.error("autoCenterStop was called, but viewpoint mode is not AUTOCENTER. No action performed.")
       return
     self.currentMode = self.currentModeOFF
+    self.bullseyeLogic.SetAutoCenterModelNode(None)
+    self.bullseyeLogic.SetRenderer(None)
 
   def autoCenterUpdate(self):
     if (self.currentMode != self.currentModeAUTOCENTER):
@@ -1253,28 +1129,19 @@ class ViewpointInstance:
     if (self.autoCenterState == self.autoCenterStateADJUST or
         self.autoCenterState == self.autoCenterStateREST):
       return
-    pointsRas = self.autoCenterGetModelCurrentBoundingBoxPointsRas()
-    # Assume we are safe, until shown otherwise
-    foundSafe = True
-    for pointRas in pointsRas:
-      coordsNormalizedViewport = self.convertRasToViewport(pointRas)
-      XNormalizedViewport = coordsNormalizedViewport[0]
-      YNormalizedViewport = coordsNormalizedViewport[1]
-      ZNormalizedViewport = coordsNormalizedViewport[2]
-      if ( XNormalizedViewport > self.autoCenterSafeXMaximumNormalizedViewport or
-           XNormalizedViewport < self.autoCenterSafeXMinimumNormalizedViewport or
-           YNormalizedViewport > self.autoCenterSafeYMaximumNormalizedViewport or
-           YNormalizedViewport < self.autoCenterSafeYMinimumNormalizedViewport or
-           ZNormalizedViewport > self.autoCenterSafeZMaximumNormalizedViewport or
-           ZNormalizedViewport < self.autoCenterSafeZMinimumNormalizedViewport ):
-        foundSafe = False
-        break
-    self.autoCenterModelInSafeZone = foundSafe
-
-  def autoCenterSetModelTargetPositionViewport(self):
-    self.autoCenterModelTargetPositionViewport = [(self.autoCenterSafeXMinimumNormalizedViewport + self.autoCenterSafeXMaximumNormalizedViewport)/2.0,
-                                        (self.autoCenterSafeYMinimumNormalizedViewport + self.autoCenterSafeYMaximumNormalizedViewport)/2.0,
-                                        (self.autoCenterSafeZMinimumNormalizedViewport + self.autoCenterSafeZMaximumNormalizedViewport)/2.0]
+    # The model's bounding sphere is cached in the logic, this only costs one matrix product
+    self.autoCenterUpdateLogicParameters()
+    self.autoCenterModelInSafeZone = self.bullseyeLogic.IsAutoCenterModelInSafeZone()
+
+  def autoCenterUpdateLogicParameters(self):
+    self.bullseyeLogic.SetAutoCenterModelNode(self.autoCenterModelNode)
+    self.bullseyeLogic.SetAutoCenterSafeZoneNormalizedViewport(
+      self.autoCenterSafeXMinimumNormalizedViewport, self.autoCenterSafeXMaximumNormalizedViewport,
+      self.autoCenterSafeYMinimumNormalizedViewport, self.autoCenterSafeYMaximumNormalizedViewport,
+      self.autoCenterSafeZMinimumNormalizedViewport, self.autoCenterSafeZMaximumNormalizedViewport)
+    self.bullseyeLogic.SetAutoCenterAdjustX(self.autoCenterAdjustX)
+    self.bullseyeLogic.SetAutoCenterAdjustY(self.autoCenterAdjustY)
+    self.bullseyeLogic.SetAutoCenterAdjustZ(self.autoCenterAdjustZ)
 
   def autoCenterSetCameraTranslationParameters(self):
     viewName = self.viewNode.GetName()
@@ -1286,17 +1153,10 @@ class ViewpointInstance:
     cameraNode.GetFocalPoint(cameraFocRas)
     self.autoCenterBaseCameraFocalPointRas = cameraFocRas
 
-    # find the translation in RAS
-    modelCurrentPositionCamera = self.autoCenterGetModelCurrentCenterCamera()
-    modelTargetPositionCamera = self.autoCenterGetModelTargetPositionCamera()
-    cameraTranslationCamera = [0,0,0]
-    if self.autoCenterAdjustX:
-      cameraTranslationCamera[0] = modelCurrentPositionCamera[0] - modelTargetPositionCamera[0]
-    if self.autoCenterAdjustY:
-      cameraTranslationCamera[1] = modelCurrentPositionCamera[1] - modelTargetPositionCamera[1]
-    if self.autoCenterAdjustZ:
-      cameraTranslationCamera[2] = modelCurrentPositionCamera[2] - modelTargetPositionCamera[2]
-    self.autoCenterBaseCameraTranslationRas = self.convertVectorCameraToRas(cameraTranslationCamera)
+    # translation that moves the model center to the center of the safe zone
+    cameraTranslationRas = [0,0,0]
+    self.bullseyeLogic.ComputeAutoCenterCameraTranslation(cameraTranslationRas)
+    self.autoCenterBaseCameraTranslationRas = cameraTranslationRas
 
   def autoCenterTranslateCamera(self):
     # linear interpolation between base and target positions, based on the timer
@@ -1317,43 +1177,6 @@ class ViewpointInstance:
     cameraNode.SetFocalPoint(cameraNewFocalPointRas)
     self.resetCameraClippingRange()
 
-  def autoCenterGetModelCurrentCenterRas(self):
-    modelBoundsRas = [0,0,0,0,0,0]
-    self.autoCenterModelNode.GetRASBounds(modelBoundsRas)
-    modelCenterX = (modelBoundsRas[0] + modelBoundsRas[1]) / 2
-    modelCenterY = (modelBoundsRas[2] + modelBoundsRas[3]) / 2
-    modelCenterZ = (modelBoundsRas[4] + modelBoundsRas[5]) / 2
-    modelPosRas = [modelCenterX, modelCenterY, modelCenterZ]
-    return modelPosRas
-
-  def autoCenterGetModelCurrentCenterCamera(self):
-    modelCenterRas = self.autoCenterGetModelCurrentCenterRas()
-    modelCenterCamera = self.convertPointRasToCamera(modelCenterRas)
-    return modelCenterCamera
-
-  def autoCenterGetModelCurrentBoundingBoxPointsRas(self):
-    pointsRas = []
-    boundsRas = [0,0,0,0,0,0]
-    self.autoCenterModelNode.GetRASBounds(boundsRas)
-    # permute through the different combinations of x,y,z; min,max
-    for x in [0,1]:
-      for y in [0,1]:
-        for z in [0,1]:
-          pointRas = []
-          pointRas.append(boundsRas[0+x])
-          pointRas.append(boundsRas[2+y])
-          pointRas.append(boundsRas[4+z])
-          pointsRas.append(pointRas)
-    return pointsRas
-
-  def autoCenterGetModelTargetPositionRas(self):
-    return self.convertViewportToRas(self.autoCenterModelTargetPositionViewport)
-
-  def autoCenterGetModelTargetPositionCamera(self):
-    modelTargetPositionRas = self.autoCenterGetModelTargetPositionRas()
-    modelTargetPositionCamera = self.convertPointRasToCamera(modelTargetPositionRas)
-    return modelTargetPositionCamera
-
   def autoCenterSetSafeXMinimum(self, val):
     self.autoCenterSafeXMinimumNormalizedViewport = val
 
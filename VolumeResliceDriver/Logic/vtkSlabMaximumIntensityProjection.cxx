@@ -0,0 +1,215 @@
+// VolumeResliceDriver includes
+#include "vtkSlabMaximumIntensityProjection.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+vtkStandardNewMacro(vtkSlabMaximumIntensityProjection);
+
+
+// Data shared by the projection threads. Each thread processes a contiguous range of output rows.
+struct SlabProjectionJob
+{
+  void* InputScalars;
+  void* OutputScalars;
+  int ScalarType;
+  int InputDimensions[ 3 ];
+  vtkIdType InputIncrements[ 3 ];
+  int OutputDimensions[ 2 ];
+  int NumberOfPlanes;
+  // Input voxel coordinates of output pixel (0, 0) on the first plane
+  double FirstPlaneOrigin[ 3 ];
+  // Change of the input voxel coordinates by moving one pixel along a row, one row, and one plane
+  double ColumnStep[ 3 ];
+  double RowStep[ 3 ];
+  double PlaneStep[ 3 ];
+};
+
+
+
+template< class T >
+static void ProjectRows( SlabProjectionJob* job, const T* input, T* output, int firstRow, int lastRow )
+{
+  const int width = job->OutputDimensions[ 0 ];
+  std::vector< T > samples( width );
+  std::vector< T > maxima( width );
+  for ( int row = firstRow; row < lastRow; ++ row )
+    {
+    for ( int plane = 0; plane < job->NumberOfPlanes; ++ plane )
+      {
+      double rowStart[ 3 ];
+      for ( int axis = 0; axis < 3; ++ axis )
+        {
+        rowStart[ axis ] = job->FirstPlaneOrigin[ axis ] + row * job->RowStep[ axis ] + plane * job->PlaneStep[ axis ];
+        }
+
+      // Gather the nearest voxel of each pixel
+      for ( int column = 0; column < width; ++ column )
+        {
+        T value = 0;
+        double x = rowStart[ 0 ] + column * job->ColumnStep[ 0 ];
+        double y = rowStart[ 1 ] + column * job->ColumnStep[ 1 ];
+        double z = rowStart[ 2 ] + column * job->ColumnStep[ 2 ];
+        if ( x > -0.5 && y > -0.5 && z > -0.5
+          && x < job->InputDimensions[ 0 ] - 0.5 && y < job->InputDimensions[ 1 ] - 0.5 && z < job->InputDimensions[ 2 ] - 0.5 )
+          {
+          value = input[ static_cast< int >( x + 0.5 ) * job->InputIncrements[ 0 ]
+            + static_cast< int >( y + 0.5 ) * job->InputIncrements[ 1 ]
+            + static_cast< int >( z + 0.5 ) * job->InputIncrements[ 2 ] ];
+          }
+        samples[ column ] = value;
+        }
+
+      // Running maximum, in a separate branch-free loop so that it is vectorized
+      if ( plane == 0 )
+        {
+        std::copy( samples.begin(), samples.end(), maxima.begin() );
+        }
+      else
+        {
+        T* maximum = &maxima[ 0 ];
+        const T* sample = &samples[ 0 ];
+        for ( int column = 0; column < width; ++ column )
+          {
+          maximum[ column ] = std::max( maximum[ column ], sample[ column ] );
+          }
+        }
+      }
+    std::copy( maxima.begin(), maxima.end(), output + static_cast< vtkIdType >( row ) * width );
+    }
+}
+
+
+
+static VTK_THREAD_RETURN_TYPE ProjectRowsThreadFunction( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  SlabProjectionJob* job = static_cast< SlabProjectionJob* >( threadInfo->UserData );
+  int numberOfRows = job->OutputDimensions[ 1 ];
+  int firstRow = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int lastRow = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  switch ( job->ScalarType )
+    {
+    vtkTemplateMacro( ProjectRows( job, static_cast< const VTK_TT* >( job->InputScalars ),
+      static_cast< VTK_TT* >( job->OutputScalars ), firstRow, lastRow ) );
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+vtkSlabMaximumIntensityProjection
+::vtkSlabMaximumIntensityProjection()
+: NumberOfPlanes( 10 )
+, PlaneSpacing( 1.0 )
+{
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+}
+
+
+
+vtkSlabMaximumIntensityProjection
+::~vtkSlabMaximumIntensityProjection()
+{
+}
+
+
+
+void vtkSlabMaximumIntensityProjection
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "NumberOfPlanes: " << this->NumberOfPlanes << std::endl;
+  os << indent << "PlaneSpacing: " << this->PlaneSpacing << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+}
+
+
+
+bool vtkSlabMaximumIntensityProjection
+::Project( vtkImageData* inputImage, vtkMatrix4x4* inputIJKToRASMatrix,
+  vtkMatrix4x4* outputIJKToRASMatrix, const int outputDimensions[ 2 ] )
+{
+  if ( inputImage == NULL || inputImage->GetPointData()->GetScalars() == NULL
+    || inputIJKToRASMatrix == NULL || outputIJKToRASMatrix == NULL )
+    {
+    vtkErrorMacro( "Project: Invalid input" );
+    return false;
+    }
+  if ( outputDimensions[ 0 ] < 1 || outputDimensions[ 1 ] < 1 )
+    {
+    vtkErrorMacro( "Project: Invalid output dimensions" );
+    return false;
+    }
+
+  // All sampling is done in input voxel coordinates: output IJK -> RAS -> input IJK
+  vtkNew< vtkMatrix4x4 > rasToInputIJKMatrix;
+  vtkMatrix4x4::Invert( inputIJKToRASMatrix, rasToInputIJKMatrix.GetPointer() );
+  vtkNew< vtkMatrix4x4 > outputToInputIJKMatrix;
+  vtkMatrix4x4::Multiply4x4( rasToInputIJKMatrix.GetPointer(), outputIJKToRASMatrix, outputToInputIJKMatrix.GetPointer() );
+
+  SlabProjectionJob job;
+  job.NumberOfPlanes = this->NumberOfPlanes;
+  job.OutputDimensions[ 0 ] = outputDimensions[ 0 ];
+  job.OutputDimensions[ 1 ] = outputDimensions[ 1 ];
+  inputImage->GetDimensions( job.InputDimensions );
+  vtkIdType increments[ 3 ];
+  inputImage->GetIncrements( increments );
+  for ( int axis = 0; axis < 3; ++ axis )
+    {
+    job.InputIncrements[ axis ] = increments[ axis ];
+    }
+
+  // Plane step in RAS is PlaneSpacing along the normalized projection direction
+  double normal_RAS[ 3 ] = { outputIJKToRASMatrix->GetElement( 0, 2 ), outputIJKToRASMatrix->GetElement( 1, 2 ), outputIJKToRASMatrix->GetElement( 2, 2 ) };
+  if ( vtkMath::Normalize( normal_RAS ) == 0.0 )
+    {
+    vtkErrorMacro( "Project: Invalid output plane orientation" );
+    return false;
+    }
+  // the planes are centered on the output plane
+  double firstPlaneIndex = -0.5 * ( this->NumberOfPlanes - 1 );
+  for ( int axis = 0; axis < 3; ++ axis )
+    {
+    job.ColumnStep[ axis ] = outputToInputIJKMatrix->GetElement( axis, 0 );
+    job.RowStep[ axis ] = outputToInputIJKMatrix->GetElement( axis, 1 );
+    job.PlaneStep[ axis ] = 0.0;
+    for ( int rasAxis = 0; rasAxis < 3; ++ rasAxis )
+      {
+      job.PlaneStep[ axis ] += rasToInputIJKMatrix->GetElement( axis, rasAxis ) * normal_RAS[ rasAxis ] * this->PlaneSpacing;
+      }
+    job.FirstPlaneOrigin[ axis ] = outputToInputIJKMatrix->GetElement( axis, 3 ) + job.PlaneStep[ axis ] * firstPlaneIndex;
+    }
+
+  int scalarType = inputImage->GetScalarType();
+  if ( this->Output->GetScalarType() != scalarType || this->Output->GetPointData()->GetScalars() == NULL
+    || this->Output->GetDimensions()[ 0 ] != outputDimensions[ 0 ] || this->Output->GetDimensions()[ 1 ] != outputDimensions[ 1 ] )
+    {
+    this->Output->SetDimensions( outputDimensions[ 0 ], outputDimensions[ 1 ], 1 );
+    this->Output->AllocateScalars( scalarType, 1 );
+    }
+  job.ScalarType = scalarType;
+  // only the first component is projected, the increment of the first axis skips the others
+  job.InputScalars = inputImage->GetScalarPointer();
+  job.OutputScalars = this->Output->GetScalarPointer();
+
+  vtkNew< vtkMultiThreader > threader;
+  threader->SetNumberOfThreads( std::max( 1, std::min( this->NumberOfThreads, outputDimensions[ 1 ] ) ) );
+  threader->SetSingleMethod( ProjectRowsThreadFunction, &job );
+  threader->SingleMethodExecute();
+
+  this->Output->Modified();
+  return true;
+}
@@ -0,0 +1,75 @@
+// .NAME vtkSlabMaximumIntensityProjection - thick-slab maximum intensity projection of a volume
+// .SECTION Description
+// Samples a volume on a stack of parallel planes around an output plane and keeps the maximum
+// of each pixel (e.g., to show vessels around a needle in a slice that follows the needle).
+// The output plane is defined by its IJK-to-RAS matrix: pixel (i, j) is at (i, j, 0), and the
+// third column of the matrix is the projection direction. Planes are PlaneSpacing apart along this
+// direction, centered on the output plane. Samples are taken by nearest neighbor interpolation,
+// samples outside the volume are 0.
+// Output rows are distributed between threads. Each row is sampled plane by plane into a
+// contiguous buffer and the running maximum is computed in a separate loop over the buffer,
+// which the compiler can vectorize.
+
+
+#ifndef __vtkSlabMaximumIntensityProjection_h
+#define __vtkSlabMaximumIntensityProjection_h
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkMatrix4x4;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkSlabMaximumIntensityProjection
+  : public vtkObject
+{
+public:
+
+  static vtkSlabMaximumIntensityProjection *New();
+  vtkTypeMacro(vtkSlabMaximumIntensityProjection,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Number of sampled planes (default 10)
+  vtkSetClampMacro( NumberOfPlanes, int, 1, VTK_INT_MAX );
+  vtkGetMacro( NumberOfPlanes, int );
+
+  /// Distance between the sampled planes, in the units of the output matrix (typically mm, default 1.0)
+  vtkSetMacro( PlaneSpacing, double );
+  vtkGetMacro( PlaneSpacing, double );
+
+  vtkSetMacro( NumberOfThreads, int );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Compute the projection of the first component of the input volume.
+  /// Returns false if the input is invalid.
+  bool Project( vtkImageData* inputImage, vtkMatrix4x4* inputIJKToRASMatrix,
+    vtkMatrix4x4* outputIJKToRASMatrix, const int outputDimensions[ 2 ] );
+
+  /// Single slice image of the input scalar type, with unit spacing and zero origin
+  /// (the geometry is defined by the output IJK-to-RAS matrix). The same object is updated by each projection.
+  vtkImageData* GetOutput() { return this->Output; };
+
+protected:
+
+  vtkSlabMaximumIntensityProjection();
+  virtual ~vtkSlabMaximumIntensityProjection();
+
+  int NumberOfPlanes;
+  double PlaneSpacing;
+  int NumberOfThreads;
+
+  vtkSmartPointer< vtkImageData > Output;
+
+private:
+
+  vtkSlabMaximumIntensityProjection(const vtkSlabMaximumIntensityProjection&); // Not implemented
+  void operator=(const vtkSlabMaximumIntensityProjection&);                    // Not implemented
+};
+
+#endif
@@ -17,6 +17,14 @@
 
 // VolumeResliceDriver includes
 #include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkSlabMaximumIntensityProjection.h"
+#include "vtkTransformPredictor.h"
+
+// IGTCommon includes
+#include "vtkLatencyInstrumentation.h"
+#include "vtkPerformanceCounters.h"
+#include "vtkSlicerTrackingTickLogic.h"
+#include "vtkTransformToWorldCache.h"
 
 // MRML includes
 #include "vtkMRMLLinearTransformNode.h"
@@ -35,6 +43,9 @@
 #include <vtkTransform.h>
 #include <vtkObjectFactory.h>
 
+// STD includes
+#include <algorithm>
+
 
 vtkStandardNewMacro(vtkSlicerVolumeResliceDriverLogic);
 
@@ -42,7 +53,13 @@ vtkStandardNewMacro(vtkSlicerVolumeResliceDriverLogic);
 
 vtkSlicerVolumeResliceDriverLogic
 ::vtkSlicerVolumeResliceDriverLogic()
+: CoalesceUpdates( false )
+, LatencyCompensationSec( 0.0 )
 {
+  this->PerformanceCounters = vtkSmartPointer< vtkPerformanceCounters >::New();
+  this->PerformanceCounters->SetName( "VolumeResliceDriver" );
+  vtkSlicerTrackingTickLogic::GetInstance()->AddObserver( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand(), vtkSlicerTrackingTickLogic::GetConsumerStagePriority() );
 }
 
 
@@ -50,6 +67,8 @@ vtkSlicerVolumeResliceDriverLogic
 vtkSlicerVolumeResliceDriverLogic
 ::~vtkSlicerVolumeResliceDriverLogic()
 {
+  vtkSlicerTrackingTickLogic::GetInstance()->RemoveObservers( vtkSlicerTrackingTickLogic::TrackingTickEvent,
+    this->GetMRMLLogicsCallbackCommand() );
   this->ClearObservedNodes();
 }
 
@@ -69,6 +88,9 @@ void vtkSlicerVolumeResliceDriverLogic
     }
 
   os << std::endl;
+  os << indent << "CoalesceUpdates: " << this->CoalesceUpdates << std::endl;
+  os << indent << "Number of pending driver updates: " << this->PendingDriverNodes.size() << std::endl;
+  os << indent << "LatencyCompensationSec: " << this->LatencyCompensationSec << std::endl;
 }
 
 
@@ -80,6 +102,7 @@ void vtkSlicerVolumeResliceDriverLogic
   if ( node == NULL )
     {
     sliceNode->RemoveAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    this->UpdateSliceDriverIndex( sliceNode );
     return;
     }
 
@@ -87,11 +110,12 @@ void vtkSlicerVolumeResliceDriverLogic
   if ( tnode == NULL )
     {
     sliceNode->RemoveAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    this->UpdateSliceDriverIndex( sliceNode );
     return;
     }
 
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE, nodeID.c_str() );
-  this->AddObservedNode( tnode );
+  this->UpdateSliceDriverIndex( sliceNode );
 
   this->UpdateSliceIfObserved( sliceNode );
 }
@@ -108,6 +132,7 @@ void vtkSlicerVolumeResliceDriverLogic
   std::stringstream modeSS;
   modeSS << mode;
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_MODE_ATTRIBUTE, modeSS.str().c_str() );
+  this->UpdateSliceParameters( sliceNode );
 
   this->UpdateSliceIfObserved( sliceNode );
 }
@@ -124,6 +149,7 @@ void vtkSlicerVolumeResliceDriverLogic
   std::stringstream rotationSs;
   rotationSs << rotation;
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_ROTATION_ATTRIBUTE, rotationSs.str().c_str() );
+  this->UpdateSliceParameters( sliceNode );
 
   this->UpdateSliceIfObserved( sliceNode );
 }
@@ -140,6 +166,50 @@ void vtkSlicerVolumeResliceDriverLogic
   std::stringstream flipSs;
   flipSs << flip;
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_FLIP_ATTRIBUTE, flipSs.str().c_str() );
+  this->UpdateSliceParameters( sliceNode );
+
+  this->UpdateSliceIfObserved( sliceNode );
+}
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetSlabForSlice( int numberOfPlanes, double planeSpacing, vtkMRMLSliceNode* sliceNode )
+{
+  if ( sliceNode == NULL )
+    {
+    return;
+    }
+  if ( planeSpacing <= 0.0 )
+    {
+    vtkErrorMacro( "SetSlabForSlice: Plane spacing must be positive" );
+    return;
+    }
+
+  std::stringstream planesSs;
+  planesSs << numberOfPlanes;
+  sliceNode->SetAttribute( VOLUMERESLICEDRIVER_SLAB_PLANES_ATTRIBUTE, planesSs.str().c_str() );
+  std::stringstream spacingSs;
+  spacingSs << planeSpacing;
+  sliceNode->SetAttribute( VOLUMERESLICEDRIVER_SLAB_SPACING_ATTRIBUTE, spacingSs.str().c_str() );
+  this->UpdateSliceParameters( sliceNode );
+  // the projection has to be recomputed even if the slice does not move
+  this->SlabCache.erase( sliceNode );
+
+  this->UpdateSliceIfObserved( sliceNode );
+}
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetSlabVolumesForSlice( std::string inputVolumeID, std::string outputVolumeID, vtkMRMLSliceNode* sliceNode )
+{
+  if ( sliceNode == NULL )
+    {
+    return;
+    }
+
+  sliceNode->SetAttribute( VOLUMERESLICEDRIVER_SLAB_INPUT_ATTRIBUTE, inputVolumeID.c_str() );
+  sliceNode->SetAttribute( VOLUMERESLICEDRIVER_SLAB_OUTPUT_ATTRIBUTE, outputVolumeID.c_str() );
+  this->SlabCache.erase( sliceNode );
 
   this->UpdateSliceIfObserved( sliceNode );
 }
@@ -172,6 +242,40 @@ void vtkSlicerVolumeResliceDriverLogic
 
 
 
+void vtkSlicerVolumeResliceDriverLogic
+::RemoveObservedNode( vtkMRMLTransformableNode* node )
+{
+  for ( unsigned int i = 0; i < this->ObservedNodes.size(); ++ i )
+    {
+    if ( node == this->ObservedNodes[ i ] )
+      {
+      vtkSetAndObserveMRMLNodeMacro( this->ObservedNodes[ i ], 0 );
+      this->ObservedNodes.erase( this->ObservedNodes.begin() + i );
+      this->DriverPosePredictors.erase( node );
+      return;
+      }
+    }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::RemoveUnusedObservedNodes()
+{
+  // iterate backwards, as nodes are removed from the vector
+  for ( int i = static_cast< int >( this->ObservedNodes.size() ) - 1; i >= 0; -- i )
+    {
+    if ( this->SliceNodesByDriver.find( this->ObservedNodes[ i ] ) == this->SliceNodesByDriver.end() )
+      {
+      this->DriverPosePredictors.erase( this->ObservedNodes[ i ] );
+      vtkSetAndObserveMRMLNodeMacro( this->ObservedNodes[ i ], 0 );
+      this->ObservedNodes.erase( this->ObservedNodes.begin() + i );
+      }
+    }
+}
+
+
+
 void vtkSlicerVolumeResliceDriverLogic
 ::ClearObservedNodes()
 {
@@ -181,6 +285,152 @@ void vtkSlicerVolumeResliceDriverLogic
     }
 
   this->ObservedNodes.clear();
+  this->DriverPosePredictors.clear();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSliceDriverIndex( vtkMRMLSliceNode* sliceNode )
+{
+  if ( sliceNode == NULL )
+    {
+    return;
+    }
+
+  this->RemoveSliceFromDriverIndex( sliceNode );
+  this->AddSliceToDriverIndex( sliceNode );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::AddSliceToDriverIndex( vtkMRMLSliceNode* sliceNode )
+{
+  const char* driverCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+  if ( driverCC == NULL || this->GetMRMLScene() == NULL )
+    {
+    return;
+    }
+  vtkMRMLTransformableNode* driverNode = vtkMRMLTransformableNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( driverCC ) );
+  if ( driverNode == NULL )
+    {
+    // the driver may be added to the scene later (e.g., by OpenIGTLink)
+    this->SliceNodesByUnresolvedDriverID.insert( std::make_pair( std::string( driverCC ), sliceNode ) );
+    return;
+    }
+  this->AddObservedNode( driverNode );
+  this->SliceNodesByDriver.insert( std::make_pair( driverNode, sliceNode ) );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::RemoveSliceFromDriverIndex( vtkMRMLSliceNode* sliceNode )
+{
+  std::vector< vtkMRMLTransformableNode* > previousDriverNodes;
+  SliceNodesByDriverType::iterator it = this->SliceNodesByDriver.begin();
+  while ( it != this->SliceNodesByDriver.end() )
+    {
+    if ( it->second == sliceNode )
+      {
+      previousDriverNodes.push_back( it->first );
+      this->SliceNodesByDriver.erase( it++ );
+      }
+    else
+      {
+      ++ it;
+      }
+    }
+
+  std::multimap< std::string, vtkMRMLSliceNode* >::iterator unresolvedIt = this->SliceNodesByUnresolvedDriverID.begin();
+  while ( unresolvedIt != this->SliceNodesByUnresolvedDriverID.end() )
+    {
+    if ( unresolvedIt->second == sliceNode )
+      {
+      this->SliceNodesByUnresolvedDriverID.erase( unresolvedIt++ );
+      }
+    else
+      {
+      ++ unresolvedIt;
+      }
+    }
+
+  // stop observing drivers that no longer drive any slice
+  for ( unsigned int i = 0; i < previousDriverNodes.size(); ++ i )
+    {
+    if ( this->SliceNodesByDriver.find( previousDriverNodes[ i ] ) == this->SliceNodesByDriver.end() )
+      {
+      this->RemoveObservedNode( previousDriverNodes[ i ] );
+      }
+    }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSliceParameters( vtkMRMLSliceNode* sliceNode )
+{
+  // Default values determining the default SliceToDriver transform.
+  SliceParameters parameters;
+  parameters.Mode = MODE_NONE;
+  parameters.Rotation = 0;
+  parameters.Flip = 0;
+  parameters.SlabNumberOfPlanes = 0;
+  parameters.SlabPlaneSpacing = 1.0;
+
+  // Default values for SliceToDriver can be modified by driver node attributes. Read them.
+
+  const char* modeCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_MODE_ATTRIBUTE);
+  if (modeCC != NULL)
+  {
+    std::stringstream modeSS(modeCC);
+    modeSS >> parameters.Mode;
+  }
+
+  const char* rotationCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_ROTATION_ATTRIBUTE);
+  if (rotationCC != NULL)
+  {
+    std::stringstream rotationSS(rotationCC);
+    rotationSS >> parameters.Rotation;
+  }
+
+  const char* flipCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_FLIP_ATTRIBUTE);
+  if (flipCC != NULL)
+  {
+    std::stringstream flipSS(flipCC);
+    flipSS >> parameters.Flip;
+  }
+
+  const char* slabPlanesCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_SLAB_PLANES_ATTRIBUTE);
+  if (slabPlanesCC != NULL)
+  {
+    std::stringstream slabPlanesSS(slabPlanesCC);
+    slabPlanesSS >> parameters.SlabNumberOfPlanes;
+  }
+
+  const char* slabSpacingCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_SLAB_SPACING_ATTRIBUTE);
+  if (slabSpacingCC != NULL)
+  {
+    std::stringstream slabSpacingSS(slabSpacingCC);
+    slabSpacingSS >> parameters.SlabPlaneSpacing;
+  }
+
+  this->SliceParametersCache[ sliceNode ] = parameters;
+}
+
+
+
+const vtkSlicerVolumeResliceDriverLogic::SliceParameters& vtkSlicerVolumeResliceDriverLogic
+::GetSliceParameters( vtkMRMLSliceNode* sliceNode )
+{
+  std::map< vtkMRMLSliceNode*, SliceParameters >::iterator it = this->SliceParametersCache.find( sliceNode );
+  if ( it == this->SliceParametersCache.end() )
+    {
+    this->UpdateSliceParameters( sliceNode );
+    it = this->SliceParametersCache.find( sliceNode );
+    }
+  return it->second;
 }
 
 
@@ -213,6 +463,12 @@ void vtkSlicerVolumeResliceDriverLogic
 
   // Check if any of the slice nodes contain driver transforms that need to be observed.
 
+  this->SliceNodesByDriver.clear();
+  this->SliceNodesByUnresolvedDriverID.clear();
+  // attributes may have been changed by the scene import, parse them again when needed
+  this->SliceParametersCache.clear();
+  this->SlabCache.clear();
+
   vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
   vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
   sliceIt->SetCollection( sliceNodes );
@@ -223,39 +479,85 @@ void vtkSlicerVolumeResliceDriverLogic
       {
       continue;
       }
-    const char* driverCC = slice->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
-    if ( driverCC == NULL )
-      {
-      continue;
-      }
-    vtkMRMLNode* driverNode = this->GetMRMLScene()->GetNodeByID( driverCC );
-    if ( driverNode == NULL )
-      {
-      continue;
-      }
-    vtkMRMLTransformableNode* driverTransformable = vtkMRMLTransformableNode::SafeDownCast( driverNode );
-    if ( driverTransformable == NULL )
-      {
-      continue;
-      }
-    this->AddObservedNode( driverTransformable );
+    this->AddSliceToDriverIndex( slice );
     }
   sliceIt->Delete();
   sliceNodes->Delete();
 
+  // drivers that were observed before the batch but are not used anymore
+  this->RemoveUnusedObservedNodes();
+
   this->Modified();
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerVolumeResliceDriverLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
 {
+  // During batch processing (e.g., scene loading) the driver may not be in the scene yet.
+  // The index is rebuilt in UpdateFromMRMLScene at the end of the batch.
+  if ( this->GetMRMLScene() == NULL || this->GetMRMLScene()->IsBatchProcessing() )
+    {
+    return;
+    }
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( node );
+  if ( sliceNode != NULL )
+    {
+    this->UpdateSliceDriverIndex( sliceNode );
+    return;
+    }
+
+  // start observing the node if slices were already waiting for it
+  vtkMRMLTransformableNode* driverNode = vtkMRMLTransformableNode::SafeDownCast( node );
+  if ( driverNode == NULL || driverNode->GetID() == NULL )
+    {
+    return;
+    }
+  typedef std::multimap< std::string, vtkMRMLSliceNode* >::iterator UnresolvedIterator;
+  std::pair< UnresolvedIterator, UnresolvedIterator > waitingSlices = this->SliceNodesByUnresolvedDriverID.equal_range( driverNode->GetID() );
+  if ( waitingSlices.first == waitingSlices.second )
+    {
+    return;
+    }
+  for ( UnresolvedIterator it = waitingSlices.first; it != waitingSlices.second; ++ it )
+    {
+    this->SliceNodesByDriver.insert( std::make_pair( driverNode, it->second ) );
+    }
+  this->SliceNodesByUnresolvedDriverID.erase( waitingSlices.first, waitingSlices.second );
+  this->AddObservedNode( driverNode );
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerVolumeResliceDriverLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
 {
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( node );
+  if ( sliceNode != NULL )
+    {
+    this->RemoveSliceFromDriverIndex( sliceNode );
+    this->SliceParametersCache.erase( sliceNode );
+    this->SlabCache.erase( sliceNode );
+    return;
+    }
+  vtkMRMLTransformableNode* driverNode = vtkMRMLTransformableNode::SafeDownCast( node );
+  if ( driverNode != NULL )
+    {
+    // the slices keep the driver ID, they are driven again if a node with the same ID is added
+    std::pair< SliceNodesByDriverType::iterator, SliceNodesByDriverType::iterator > drivenSlices = this->SliceNodesByDriver.equal_range( driverNode );
+    if ( drivenSlices.first != drivenSlices.second && driverNode->GetID() != NULL )
+      {
+      for ( SliceNodesByDriverType::iterator it = drivenSlices.first; it != drivenSlices.second; ++ it )
+        {
+        this->SliceNodesByUnresolvedDriverID.insert( std::make_pair( std::string( driverNode->GetID() ), it->second ) );
+        }
+      }
+    this->SliceNodesByDriver.erase( driverNode );
+    this->RemoveObservedNode( driverNode );
+    if ( this->PendingDriverNodes.erase( driverNode ) > 0 && this->PendingDriverNodes.empty() )
+      {
+      this->InvokeEvent( PendingUpdatesModifiedEvent );
+      }
+    }
 }
 
 
@@ -288,34 +590,158 @@ void vtkSlicerVolumeResliceDriverLogic
     {
     return;
     }
+  this->PerformanceCounters->EventReceived();
 
-  std::string callerNodeID( callerNode->GetID() );
+  if ( event == vtkMRMLTransformableNode::TransformModifiedEvent || event == vtkMRMLVolumeNode::ImageDataModifiedEvent )
+    {
+    vtkLatencyInstrumentation::GetInstance()->SourceNodeModified( callerNode );
+    }
 
-  //vtkMRMLNode* node = 0;
-  std::vector< vtkMRMLSliceNode* > SlicesToDrive;
+  if ( event == vtkMRMLTransformableNode::TransformModifiedEvent && this->LatencyCompensationSec > 0.0 )
+    {
+    // the pose is recorded when it is received, even if the slice update is delayed
+    this->AddDriverPose( vtkMRMLLinearTransformNode::SafeDownCast( callerNode ) );
+    }
 
-  vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
-  vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
-  sliceIt->SetCollection( sliceNodes );
-  sliceIt->InitTraversal();
-  for ( int i = 0; i < sliceNodes->GetNumberOfItems(); ++ i )
-    {
-    vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( sliceIt->GetCurrentObject() );
-    sliceIt->GoToNextItem();
-    const char* driverCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
-    if (    sliceNode != NULL
-         && driverCC != NULL
-         && callerNodeID.compare( std::string( driverCC ) ) == 0 )
+  if ( this->CoalesceUpdates )
+    {
+    // A live image usually sends both image data and transform modified events for each frame.
+    // Only record the driver now, the slices are updated once in ProcessPendingUpdates.
+    if ( this->SliceNodesByDriver.find( callerNode ) == this->SliceNodesByDriver.end() )
+      {
+      return;
+      }
+    bool wasEmpty = this->PendingDriverNodes.empty();
+    if ( !this->PendingDriverNodes.insert( callerNode ).second )
+      {
+      // already pending, coalesced with the previous event
+      this->PerformanceCounters->UpdateSkipped();
+      }
+    if ( wasEmpty )
       {
-      SlicesToDrive.push_back( sliceNode );
+      this->InvokeEvent( PendingUpdatesModifiedEvent );
       }
+    return;
     }
-  sliceIt->Delete();
-  sliceNodes->Delete();
 
-  for ( unsigned int i = 0; i < SlicesToDrive.size(); ++ i )
+  this->UpdateSlicesByDriverNode( callerNode );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::ProcessMRMLLogicsEvents( vtkObject* caller, unsigned long event, void * callData )
+{
+  if ( caller == vtkSlicerTrackingTickLogic::GetInstance() && event == vtkSlicerTrackingTickLogic::TrackingTickEvent )
+    {
+    this->ProcessPendingUpdates();
+    return;
+    }
+  this->Superclass::ProcessMRMLLogicsEvents( caller, event, callData );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSlicesByDriverNode( vtkMRMLTransformableNode* driverNode )
+{
+  double updateStartTimeSec = this->PerformanceCounters->StartUpdate();
+  std::pair< SliceNodesByDriverType::iterator, SliceNodesByDriverType::iterator > slicesToDrive = this->SliceNodesByDriver.equal_range( driverNode );
+  for ( SliceNodesByDriverType::iterator it = slicesToDrive.first; it != slicesToDrive.second; ++ it )
+    {
+    this->UpdateSliceByTransformableNode( driverNode, it->second );
+    }
+  if ( slicesToDrive.first != slicesToDrive.second )
+    {
+    vtkLatencyInstrumentation::GetInstance()->RecordStageLatency( "VolumeResliceDriver", driverNode );
+    this->PerformanceCounters->EndUpdate( updateStartTimeSec );
+    }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::ProcessPendingUpdates()
+{
+  if ( this->PendingDriverNodes.empty() )
+    {
+    return;
+    }
+
+  // swap, as new events may arrive while the slices are updated
+  std::set< vtkMRMLTransformableNode* > pendingDriverNodes;
+  pendingDriverNodes.swap( this->PendingDriverNodes );
+  for ( std::set< vtkMRMLTransformableNode* >::iterator it = pendingDriverNodes.begin(); it != pendingDriverNodes.end(); ++ it )
+    {
+    this->UpdateSlicesByDriverNode( *it );
+    }
+
+  if ( this->PendingDriverNodes.empty() )
+    {
+    this->InvokeEvent( PendingUpdatesModifiedEvent );
+    }
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::HasPendingUpdates()
+{
+  return !this->PendingDriverNodes.empty();
+}
+
+
+
+vtkPerformanceCounters* vtkSlicerVolumeResliceDriverLogic
+::GetPerformanceCounters()
+{
+  return this->PerformanceCounters;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetLatencyCompensationSec( double latencySec )
+{
+  if ( this->LatencyCompensationSec == latencySec )
+    {
+    return;
+    }
+  this->LatencyCompensationSec = latencySec;
+  if ( this->LatencyCompensationSec > 0.0 )
+    {
+    std::map< vtkMRMLTransformableNode*, vtkSmartPointer< vtkTransformPredictor > >::iterator it;
+    for ( it = this->DriverPosePredictors.begin(); it != this->DriverPosePredictors.end(); ++ it )
+      {
+      it->second->SetLatencySec( this->LatencyCompensationSec );
+      }
+    }
+  else
     {
-    this->UpdateSliceByTransformableNode( callerNode, SlicesToDrive[ i ] );
+    this->DriverPosePredictors.clear();
+    }
+  this->Modified();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::AddDriverPose( vtkMRMLLinearTransformNode* driverNode )
+{
+  if ( driverNode == NULL || this->SliceNodesByDriver.find( driverNode ) == this->SliceNodesByDriver.end() )
+    {
+    return;
+    }
+  vtkSmartPointer< vtkTransformPredictor >& predictor = this->DriverPosePredictors[ driverNode ];
+  if ( predictor == NULL )
+    {
+    predictor = vtkSmartPointer< vtkTransformPredictor >::New();
+    predictor->SetLatencySec( this->LatencyCompensationSec );
+    }
+  vtkNew< vtkMatrix4x4 > driverToRASMatrix;
+  if ( vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( driverNode, driverToRASMatrix.GetPointer() ) )
+    {
+    predictor->AddPose( driverToRASMatrix.GetPointer() );
     }
 }
 
@@ -355,8 +781,18 @@ void vtkSlicerVolumeResliceDriverLogic
 
   vtkSmartPointer< vtkMatrix4x4 > transform = vtkSmartPointer< vtkMatrix4x4 >::New();
   transform->Identity();
-  int getTransf = tnode->GetMatrixTransformToWorld( transform );
-  if( getTransf != 0 )
+
+  if ( this->LatencyCompensationSec > 0.0 )
+    {
+    std::map< vtkMRMLTransformableNode*, vtkSmartPointer< vtkTransformPredictor > >::iterator predictorIt = this->DriverPosePredictors.find( tnode );
+    if ( predictorIt != this->DriverPosePredictors.end() && predictorIt->second->GetPredictedPose( transform ) )
+      {
+      this->UpdateSlice( transform, sliceNode );
+      return;
+      }
+    }
+
+  if ( vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( tnode, transform ) )
     {
     this->UpdateSlice( transform, sliceNode );
     }
@@ -447,8 +883,7 @@ void vtkSlicerVolumeResliceDriverLogic
     {
     vtkSmartPointer<vtkMatrix4x4> parentTransform = vtkSmartPointer<vtkMatrix4x4>::New();
     parentTransform->Identity();
-    int r = parentNode->GetMatrixTransformToWorld(parentTransform);
-    if (r)
+    if ( vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( parentNode, parentTransform ) )
       {
       vtkSmartPointer<vtkMatrix4x4> transform = vtkSmartPointer<vtkMatrix4x4>::New();
       vtkMatrix4x4::Multiply4x4(parentTransform, rtimgTransform,  transform);
@@ -563,34 +998,10 @@ void vtkSlicerVolumeResliceDriverLogic
 void vtkSlicerVolumeResliceDriverLogic
 ::UpdateSlice(vtkMatrix4x4* driverToRASMatrix, vtkMRMLSliceNode* sliceNode)
 {
-  // Default values determining the default SliceToDriver transform.
-  int mode = MODE_NONE;
-  int rotation = 0;
-  int flip = 0;
-
-
-  // Default values for SliceToDriver can be modified by driver node attributes. Read them.
-
-  const char* modeCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_MODE_ATTRIBUTE);
-  if (modeCC != NULL)
-  {
-    std::stringstream modeSS(modeCC);
-    modeSS >> mode;
-  }
-
-  const char* rotationCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_ROTATION_ATTRIBUTE);
-  if (rotationCC != NULL)
-  {
-    std::stringstream rotationSS(rotationCC);
-    rotationSS >> rotation;
-  }
-
-  const char* flipCC = sliceNode->GetAttribute(VOLUMERESLICEDRIVER_FLIP_ATTRIBUTE);
-  if (flipCC != NULL)
-  {
-    std::stringstream flipSS(flipCC);
-    flipSS >> flip;
-  }
+  const SliceParameters& parameters = this->GetSliceParameters( sliceNode );
+  int mode = parameters.Mode;
+  int rotation = parameters.Rotation;
+  int flip = parameters.Flip;
 
   // SliceToRAS orientation matrix part must be orthonormal
   vtkNew<vtkMatrix4x4> driverToRASMatrixOrthoNormalized;
@@ -715,11 +1126,104 @@ void vtkSlicerVolumeResliceDriverLogic
       break;
     };
 
-  sliceNode->GetSliceToRAS()->DeepCopy(sliceToRASTransform->GetMatrix());
+  if ( parameters.SlabNumberOfPlanes > 1 )
+    {
+    // before the unchanged pose check, as the input image may change without the slice moving
+    this->UpdateSlab( sliceNode, sliceToRASTransform->GetMatrix() );
+    }
+
+  // Reslicing the volumes is the most expensive part of driving a slice, it is triggered by UpdateMatrices.
+  // Trackers often keep sending the same pose (e.g., a probe lying still), skip the update in this case.
+  vtkMatrix4x4* sliceToRASMatrix = sliceNode->GetSliceToRAS();
+  const double* currentElements = &sliceToRASMatrix->Element[0][0];
+  const double* newElements = &sliceToRASTransform->GetMatrix()->Element[0][0];
+  if (std::equal(newElements, newElements + 16, currentElements))
+    {
+    return;
+    }
+
+  sliceToRASMatrix->DeepCopy(sliceToRASTransform->GetMatrix());
   sliceNode->UpdateMatrices();
 }
 
 
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSlab( vtkMRMLSliceNode* sliceNode, vtkMatrix4x4* sliceToRASMatrix )
+{
+  const char* inputVolumeID = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_SLAB_INPUT_ATTRIBUTE );
+  const char* outputVolumeID = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_SLAB_OUTPUT_ATTRIBUTE );
+  if ( inputVolumeID == NULL || outputVolumeID == NULL || this->GetMRMLScene() == NULL )
+    {
+    return;
+    }
+  vtkMRMLScalarVolumeNode* inputVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( inputVolumeID ) );
+  vtkMRMLScalarVolumeNode* outputVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( outputVolumeID ) );
+  if ( inputVolumeNode == NULL || inputVolumeNode->GetImageData() == NULL || outputVolumeNode == NULL || inputVolumeNode == outputVolumeNode )
+    {
+    return;
+    }
+
+  SlabCacheItem& cacheItem = this->SlabCache[ sliceNode ];
+  const double* newElements = &sliceToRASMatrix->Element[0][0];
+  if ( cacheItem.Projection.GetPointer() != NULL
+    && cacheItem.InputImageMTime == inputVolumeNode->GetImageData()->GetMTime()
+    && std::equal( newElements, newElements + 16, cacheItem.SliceToRAS ) )
+    {
+    return;
+    }
+
+  vtkNew< vtkMatrix4x4 > inputIJKToRASMatrix;
+  inputVolumeNode->GetIJKToRASMatrix( inputIJKToRASMatrix.GetPointer() );
+  if ( inputVolumeNode->GetParentTransformNode() != NULL )
+    {
+    vtkNew< vtkMatrix4x4 > parentToRASMatrix;
+    if ( !vtkTransformToWorldCache::GetInstance()->GetMatrixTransformToWorld( inputVolumeNode->GetParentTransformNode(), parentToRASMatrix.GetPointer() ) )
+      {
+      vtkWarningMacro( "UpdateSlab: Non-linear transform of the slab input volume is not supported" );
+      return;
+      }
+    vtkMatrix4x4::Multiply4x4( parentToRASMatrix.GetPointer(), inputIJKToRASMatrix.GetPointer(), inputIJKToRASMatrix.GetPointer() );
+    }
+
+  // One output pixel for each pixel of the slice view, centered in the field of view
+  double* fieldOfView = sliceNode->GetFieldOfView();
+  int* sliceDimensions = sliceNode->GetDimensions();
+  int outputDimensions[ 2 ] = { std::max( 1, sliceDimensions[ 0 ] ), std::max( 1, sliceDimensions[ 1 ] ) };
+  double pixelSpacing[ 2 ] = { fieldOfView[ 0 ] / outputDimensions[ 0 ], fieldOfView[ 1 ] / outputDimensions[ 1 ] };
+  vtkNew< vtkMatrix4x4 > outputIJKToSliceMatrix;
+  for ( int axis = 0; axis < 2; ++ axis )
+    {
+    outputIJKToSliceMatrix->SetElement( axis, axis, pixelSpacing[ axis ] );
+    outputIJKToSliceMatrix->SetElement( axis, 3, ( pixelSpacing[ axis ] - fieldOfView[ axis ] ) / 2.0 );
+    }
+  vtkNew< vtkMatrix4x4 > outputIJKToRASMatrix;
+  vtkMatrix4x4::Multiply4x4( sliceToRASMatrix, outputIJKToSliceMatrix.GetPointer(), outputIJKToRASMatrix.GetPointer() );
+
+  const SliceParameters& parameters = this->GetSliceParameters( sliceNode );
+  if ( cacheItem.Projection.GetPointer() == NULL )
+    {
+    cacheItem.Projection = vtkSmartPointer< vtkSlabMaximumIntensityProjection >::New();
+    }
+  cacheItem.Projection->SetNumberOfPlanes( parameters.SlabNumberOfPlanes );
+  cacheItem.Projection->SetPlaneSpacing( parameters.SlabPlaneSpacing );
+  if ( !cacheItem.Projection->Project( inputVolumeNode->GetImageData(), inputIJKToRASMatrix.GetPointer(),
+    outputIJKToRASMatrix.GetPointer(), outputDimensions ) )
+    {
+    return;
+    }
+  std::copy( newElements, newElements + 16, cacheItem.SliceToRAS );
+  cacheItem.InputImageMTime = inputVolumeNode->GetImageData()->GetMTime();
+
+  int wasModified = outputVolumeNode->StartModify();
+  outputVolumeNode->SetIJKToRASMatrix( outputIJKToRASMatrix.GetPointer() );
+  if ( outputVolumeNode->GetImageData() != cacheItem.Projection->GetOutput() )
+    {
+    outputVolumeNode->SetAndObserveImageData( cacheItem.Projection->GetOutput() );
+    }
+  outputVolumeNode->EndModify( wasModified );
+}
+
+
 void vtkSlicerVolumeResliceDriverLogic
 ::UpdateSliceIfObserved( vtkMRMLSliceNode* sliceNode )
 {
@@ -13,8 +13,15 @@
 // MRML includes
 #include "vtkMRMLTransformableNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
 
@@ -22,6 +29,9 @@ class vtkMRMLLinearTransformNode;
 class vtkMRMLScalarVolumeNode;
 class vtkMRMLAnnotationRulerNode;
 class vtkMRMLSliceNode;
+class vtkPerformanceCounters;
+class vtkSlabMaximumIntensityProjection;
+class vtkTransformPredictor;
 
 #define VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE "VolumeResliceDriver.Driver"
 //#define VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE "VolumeResliceDriver.Method"
@@ -29,6 +39,10 @@ class vtkMRMLSliceNode;
 #define VOLUMERESLICEDRIVER_MODE_ATTRIBUTE "VolumeResliceDriver.Mode"
 #define VOLUMERESLICEDRIVER_ROTATION_ATTRIBUTE "VolumeResliceDriver.Rotation"
 #define VOLUMERESLICEDRIVER_FLIP_ATTRIBUTE "VolumeResliceDriver.Flip"
+#define VOLUMERESLICEDRIVER_SLAB_PLANES_ATTRIBUTE "VolumeResliceDriver.SlabPlanes"
+#define VOLUMERESLICEDRIVER_SLAB_SPACING_ATTRIBUTE "VolumeResliceDriver.SlabSpacing"
+#define VOLUMERESLICEDRIVER_SLAB_INPUT_ATTRIBUTE "VolumeResliceDriver.SlabInput"
+#define VOLUMERESLICEDRIVER_SLAB_OUTPUT_ATTRIBUTE "VolumeResliceDriver.SlabOutput"
 
 
 
@@ -57,10 +71,52 @@ public:
   void SetModeForSlice( int mode, vtkMRMLSliceNode* sliceNode );
   void SetRotationForSlice( double rotation, vtkMRMLSliceNode* sliceNode );
   void SetFlipForSlice( bool flip, vtkMRMLSliceNode* sliceNode );
+
+  /// Thick-slab maximum intensity projection that follows the driver.
+  /// If the number of planes is more than 1 then, whenever the slice is driven, the maximum intensity
+  /// projection of the slab input volume over the planes along the slice normal (planeSpacing apart,
+  /// centered on the slice) is written into the slab output volume. The output volume is placed in the
+  /// slice plane and covers the field of view of the slice, so showing it in the slice view shows the slab.
+  void SetSlabForSlice( int numberOfPlanes, double planeSpacing, vtkMRMLSliceNode* sliceNode );
+  void SetSlabVolumesForSlice( std::string inputVolumeID, std::string outputVolumeID, vtkMRMLSliceNode* sliceNode );
+
+  enum Events
+  {
+    /// Invoked when HasPendingUpdates() changes
+    PendingUpdatesModifiedEvent = vtkCommand::UserEvent + 301
+  };
+
+  /// If enabled, driver events only mark the driver as pending and the driven
+  /// slices are updated once in ProcessPendingUpdates(). This avoids updating
+  /// the slices twice for each live image frame (image data and transform modified
+  /// events). The application must call ProcessPendingUpdates() in the next
+  /// event loop iteration, this is done by the module. Disabled by default.
+  vtkSetMacro( CoalesceUpdates, bool );
+  vtkGetMacro( CoalesceUpdates, bool );
+  vtkBooleanMacro( CoalesceUpdates, bool );
+
+  /// Update the slices of all drivers that sent events since the last call.
+  /// Called in the consumer stage of the shared tracking tick (see vtkSlicerTrackingTickLogic),
+  /// after the driver transforms are computed by the processor logics.
+  void ProcessPendingUpdates();
+  bool HasPendingUpdates();
+
+  /// Time (in seconds) from receiving a driver transform to the display of the resliced image.
+  /// If set then the pose of linear transform drivers is extrapolated by this time (constant
+  /// velocity model, see vtkTransformPredictor), so that the slices do not lag behind a fast
+  /// moving tool. 0 means the poses are not extrapolated (default).
+  void SetLatencyCompensationSec( double latencySec );
+  vtkGetMacro( LatencyCompensationSec, double );
+
+  /// Number of received driver events, slice updates computed and coalesced, and the time spent in the updates
+  vtkPerformanceCounters* GetPerformanceCounters();
   
 protected:
   
   void AddObservedNode( vtkMRMLTransformableNode* node );
+  void RemoveObservedNode( vtkMRMLTransformableNode* node );
+  /// Stop observing nodes that do not drive any slice
+  void RemoveUnusedObservedNodes();
   void ClearObservedNodes();
   
   vtkSlicerVolumeResliceDriverLogic();
@@ -75,15 +131,65 @@ protected:
   virtual void OnMRMLNodeModified( vtkMRMLNode* node );
   
   virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void * callData);
+  virtual void ProcessMRMLLogicsEvents(vtkObject* caller, unsigned long event, void * callData);
   
+  void UpdateSlicesByDriverNode( vtkMRMLTransformableNode* driverNode );
   void UpdateSliceByTransformableNode( vtkMRMLTransformableNode* tnode, vtkMRMLSliceNode* sliceNode );
   void UpdateSliceByTransformNode( vtkMRMLLinearTransformNode* tnode, vtkMRMLSliceNode* sliceNode );
   void UpdateSliceByImageNode( vtkMRMLScalarVolumeNode* inode, vtkMRMLSliceNode* sliceNode );
   void UpdateSliceByRulerNode( vtkMRMLAnnotationRulerNode* rnode, vtkMRMLSliceNode* sliceNode );
   void UpdateSlice( vtkMatrix4x4* driverToRASMatrix, vtkMRMLSliceNode* sliceNode );
   void UpdateSliceIfObserved( vtkMRMLSliceNode* sliceNode );
+  /// Compute the slab projection of the slice with the new SliceToRAS matrix (if the slab is enabled for the slice)
+  void UpdateSlab( vtkMRMLSliceNode* sliceNode, vtkMatrix4x4* sliceToRASMatrix );
+
+  /// Record the current pose of a driver transform for latency compensation
+  void AddDriverPose( vtkMRMLLinearTransformNode* driverNode );
   
   std::vector< vtkMRMLTransformableNode* > ObservedNodes;
+
+  /// Keep the driver of the slice node up-to-date in SliceNodesByDriver (called when the driver attribute changes)
+  void UpdateSliceDriverIndex( vtkMRMLSliceNode* sliceNode );
+  void AddSliceToDriverIndex( vtkMRMLSliceNode* sliceNode );
+  void RemoveSliceFromDriverIndex( vtkMRMLSliceNode* sliceNode );
+
+  /// Slice nodes driven by each driver node, so driver events need not search all slice nodes
+  typedef std::multimap< vtkMRMLTransformableNode*, vtkMRMLSliceNode* > SliceNodesByDriverType;
+  SliceNodesByDriverType SliceNodesByDriver;
+  /// Slice nodes whose driver ID is not (yet) in the scene
+  std::multimap< std::string, vtkMRMLSliceNode* > SliceNodesByUnresolvedDriverID;
+
+  /// Reslice parameters of a slice node, parsed from the slice node attributes
+  struct SliceParameters
+  {
+    int Mode;
+    int Rotation;
+    int Flip;
+    int SlabNumberOfPlanes;
+    double SlabPlaneSpacing;
+  };
+  /// Parse the attributes of the slice node again (called when the mode, rotation or flip attribute changes)
+  void UpdateSliceParameters( vtkMRMLSliceNode* sliceNode );
+  const SliceParameters& GetSliceParameters( vtkMRMLSliceNode* sliceNode );
+  std::map< vtkMRMLSliceNode*, SliceParameters > SliceParametersCache;
+
+  /// Slab projection of a slice node and the inputs of its last computation, to skip recomputing
+  /// the projection if neither the slice pose nor the input image changed
+  struct SlabCacheItem
+  {
+    vtkSmartPointer< vtkSlabMaximumIntensityProjection > Projection;
+    double SliceToRAS[ 16 ];
+    unsigned long InputImageMTime;
+  };
+  std::map< vtkMRMLSliceNode*, SlabCacheItem > SlabCache;
+
+  bool CoalesceUpdates;
+  std::set< vtkMRMLTransformableNode* > PendingDriverNodes;
+
+  double LatencyCompensationSec;
+  std::map< vtkMRMLTransformableNode*, vtkSmartPointer< vtkTransformPredictor > > DriverPosePredictors;
+
+  vtkSmartPointer< vtkPerformanceCounters > PerformanceCounters;
   
 private:
 
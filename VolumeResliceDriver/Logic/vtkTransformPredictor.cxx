@@ -0,0 +1,248 @@
+// VolumeResliceDriver includes
+#include "vtkTransformPredictor.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+
+vtkStandardNewMacro(vtkTransformPredictor);
+
+
+
+vtkTransformPredictor
+::vtkTransformPredictor()
+: LatencySec( 0.0 )
+, MaximumPredictionTimeSec( 0.2 )
+, VelocitySmoothingFactor( 0.5 )
+, MaximumPoseIntervalSec( 0.5 )
+, LastPoseTimestampSec( 0.0 )
+, LastPoseValid( false )
+, VelocityValid( false )
+{
+  this->LastPose = vtkSmartPointer< vtkMatrix4x4 >::New();
+  for ( int i = 0; i < 3; ++ i )
+    {
+    for ( int j = 0; j < 3; ++ j )
+      {
+      this->LastRotation[ i ][ j ] = ( i == j ) ? 1.0 : 0.0;
+      }
+    this->LinearVelocity[ i ] = 0.0;
+    this->AngularVelocity[ i ] = 0.0;
+    }
+}
+
+
+
+vtkTransformPredictor
+::~vtkTransformPredictor()
+{
+}
+
+
+
+void vtkTransformPredictor
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "LatencySec: " << this->LatencySec << std::endl;
+  os << indent << "MaximumPredictionTimeSec: " << this->MaximumPredictionTimeSec << std::endl;
+  os << indent << "VelocitySmoothingFactor: " << this->VelocitySmoothingFactor << std::endl;
+  os << indent << "MaximumPoseIntervalSec: " << this->MaximumPoseIntervalSec << std::endl;
+  os << indent << "LinearVelocity: " << this->LinearVelocity[ 0 ] << " " << this->LinearVelocity[ 1 ] << " " << this->LinearVelocity[ 2 ] << std::endl;
+  os << indent << "AngularVelocity: " << this->AngularVelocity[ 0 ] << " " << this->AngularVelocity[ 1 ] << " " << this->AngularVelocity[ 2 ] << std::endl;
+  os << indent << "VelocityValid: " << this->VelocityValid << std::endl;
+}
+
+
+
+double vtkTransformPredictor
+::GetCurrentTimeSec()
+{
+  return vtkTimerLog::GetUniversalTime();
+}
+
+
+
+void vtkTransformPredictor
+::AddPose( vtkMatrix4x4* toolToRASMatrix )
+{
+  this->AddPose( toolToRASMatrix, vtkTransformPredictor::GetCurrentTimeSec() );
+}
+
+
+
+void vtkTransformPredictor
+::AddPose( vtkMatrix4x4* toolToRASMatrix, double timestampSec )
+{
+  if ( toolToRASMatrix == NULL )
+    {
+    vtkErrorMacro( "AddPose: Invalid matrix" );
+    return;
+    }
+
+  double rotation[3][3];
+  for ( int i = 0; i < 3; ++ i )
+    {
+    for ( int j = 0; j < 3; ++ j )
+      {
+      rotation[ i ][ j ] = toolToRASMatrix->GetElement( i, j );
+      }
+    }
+  vtkMath::Orthogonalize3x3( rotation, rotation );
+
+  if ( this->LastPoseValid )
+    {
+    double timeDifferenceSec = timestampSec - this->LastPoseTimestampSec;
+    if ( timeDifferenceSec <= 0.0 )
+      {
+      // same sample reported again (e.g., by several events), velocity cannot be computed from it
+      this->LastPose->DeepCopy( toolToRASMatrix );
+      std::copy( &rotation[0][0], &rotation[0][0] + 9, &this->LastRotation[0][0] );
+      return;
+      }
+    if ( timeDifferenceSec > this->MaximumPoseIntervalSec )
+      {
+      // tracking was interrupted, the previous pose is not used for velocity estimation
+      this->VelocityValid = false;
+      }
+    else
+      {
+      double linearVelocity[3] = { 0.0, 0.0, 0.0 };
+      for ( int i = 0; i < 3; ++ i )
+        {
+        linearVelocity[ i ] = ( toolToRASMatrix->GetElement( i, 3 ) - this->LastPose->GetElement( i, 3 ) ) / timeDifferenceSec;
+        }
+
+      // rotation since the last pose: rotation * lastRotation^T, as rotation vector
+      double lastRotationTransposed[3][3];
+      vtkMath::Transpose3x3( this->LastRotation, lastRotationTransposed );
+      double rotationDifference[3][3];
+      vtkMath::Multiply3x3( rotation, lastRotationTransposed, rotationDifference );
+      double quaternion[4] = { 1.0, 0.0, 0.0, 0.0 };
+      vtkMath::Matrix3x3ToQuaternion( rotationDifference, quaternion );
+      if ( quaternion[ 0 ] < 0.0 )
+        {
+        // shortest rotation
+        for ( int i = 0; i < 4; ++ i )
+          {
+          quaternion[ i ] = -quaternion[ i ];
+          }
+        }
+      double sinHalfAngle = sqrt( quaternion[ 1 ] * quaternion[ 1 ] + quaternion[ 2 ] * quaternion[ 2 ] + quaternion[ 3 ] * quaternion[ 3 ] );
+      double angularVelocity[3] = { 0.0, 0.0, 0.0 };
+      if ( sinHalfAngle > 1e-12 )
+        {
+        double angleRad = 2.0 * atan2( sinHalfAngle, quaternion[ 0 ] );
+        for ( int i = 0; i < 3; ++ i )
+          {
+          angularVelocity[ i ] = quaternion[ i + 1 ] / sinHalfAngle * angleRad / timeDifferenceSec;
+          }
+        }
+
+      double weight = this->VelocityValid ? this->VelocitySmoothingFactor : 1.0;
+      for ( int i = 0; i < 3; ++ i )
+        {
+        this->LinearVelocity[ i ] = weight * linearVelocity[ i ] + ( 1.0 - weight ) * this->LinearVelocity[ i ];
+        this->AngularVelocity[ i ] = weight * angularVelocity[ i ] + ( 1.0 - weight ) * this->AngularVelocity[ i ];
+        }
+      this->VelocityValid = true;
+      }
+    }
+
+  this->LastPose->DeepCopy( toolToRASMatrix );
+  std::copy( &rotation[0][0], &rotation[0][0] + 9, &this->LastRotation[0][0] );
+  this->LastPoseTimestampSec = timestampSec;
+  this->LastPoseValid = true;
+}
+
+
+
+void vtkTransformPredictor
+::Reset()
+{
+  this->LastPoseValid = false;
+  this->VelocityValid = false;
+  for ( int i = 0; i < 3; ++ i )
+    {
+    this->LinearVelocity[ i ] = 0.0;
+    this->AngularVelocity[ i ] = 0.0;
+    }
+}
+
+
+
+bool vtkTransformPredictor
+::GetPredictedPose( vtkMatrix4x4* predictedToolToRASMatrix )
+{
+  return this->GetPredictedPose( predictedToolToRASMatrix, vtkTransformPredictor::GetCurrentTimeSec() );
+}
+
+
+
+bool vtkTransformPredictor
+::GetPredictedPose( vtkMatrix4x4* predictedToolToRASMatrix, double currentTimeSec )
+{
+  if ( predictedToolToRASMatrix == NULL )
+    {
+    vtkErrorMacro( "GetPredictedPose: Invalid matrix" );
+    return false;
+    }
+  if ( ! this->LastPoseValid )
+    {
+    return false;
+    }
+  predictedToolToRASMatrix->DeepCopy( this->LastPose );
+
+  double timeSinceLastPoseSec = currentTimeSec - this->LastPoseTimestampSec;
+  if ( this->LatencySec <= 0.0 || ! this->VelocityValid || timeSinceLastPoseSec > this->MaximumPoseIntervalSec )
+    {
+    return true;
+    }
+  double predictionTimeSec = std::max( 0.0, std::min( this->MaximumPredictionTimeSec, timeSinceLastPoseSec + this->LatencySec ) );
+
+  for ( int i = 0; i < 3; ++ i )
+    {
+    predictedToolToRASMatrix->SetElement( i, 3, this->LastPose->GetElement( i, 3 ) + this->LinearVelocity[ i ] * predictionTimeSec );
+    }
+
+  double rotationVector[3] = { this->AngularVelocity[ 0 ] * predictionTimeSec,
+    this->AngularVelocity[ 1 ] * predictionTimeSec, this->AngularVelocity[ 2 ] * predictionTimeSec };
+  double angleRad = vtkMath::Norm( rotationVector );
+  if ( angleRad < 1e-12 )
+    {
+    return true;
+    }
+  double sinHalfAngle = sin( angleRad / 2.0 );
+  double quaternion[4] = { cos( angleRad / 2.0 ), rotationVector[ 0 ] / angleRad * sinHalfAngle,
+    rotationVector[ 1 ] / angleRad * sinHalfAngle, rotationVector[ 2 ] / angleRad * sinHalfAngle };
+  double rotationChange[3][3];
+  vtkMath::QuaternionToMatrix3x3( quaternion, rotationChange );
+
+  // rotate the axes of the last pose (scaling is preserved)
+  double lastAxes[3][3];
+  double predictedAxes[3][3];
+  for ( int i = 0; i < 3; ++ i )
+    {
+    for ( int j = 0; j < 3; ++ j )
+      {
+      lastAxes[ i ][ j ] = this->LastPose->GetElement( i, j );
+      }
+    }
+  vtkMath::Multiply3x3( rotationChange, lastAxes, predictedAxes );
+  for ( int i = 0; i < 3; ++ i )
+    {
+    for ( int j = 0; j < 3; ++ j )
+      {
+      predictedToolToRASMatrix->SetElement( i, j, predictedAxes[ i ][ j ] );
+      }
+    }
+  return true;
+}
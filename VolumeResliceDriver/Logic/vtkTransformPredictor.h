@@ -0,0 +1,94 @@
+// .NAME vtkTransformPredictor - extrapolates a tracked pose to the time it is displayed
+// .SECTION Description
+// Tracked poses are displayed with a delay (tracking, transfer and rendering, typically 50-80ms),
+// therefore images that follow a fast moving tool visibly lag behind it.
+// This class estimates the linear and angular velocity of the tool from the recent poses
+// (constant velocity model, the velocity estimates are exponentially smoothed to suppress
+// tracking noise) and extrapolates the last pose by the latency.
+// Only the rotation and translation of the pose are extrapolated, scaling is preserved.
+
+
+#ifndef __vtkTransformPredictor_h
+#define __vtkTransformPredictor_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkMatrix4x4;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkTransformPredictor
+  : public vtkObject
+{
+public:
+
+  static vtkTransformPredictor *New();
+  vtkTypeMacro(vtkTransformPredictor,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Time from receiving a pose to its display (in seconds). If 0 (default) then poses are not extrapolated.
+  vtkSetMacro( LatencySec, double );
+  vtkGetMacro( LatencySec, double );
+
+  /// Poses are not extrapolated further than this (in seconds, default 0.2)
+  vtkSetMacro( MaximumPredictionTimeSec, double );
+  vtkGetMacro( MaximumPredictionTimeSec, double );
+
+  /// Weight of the velocity computed from the newest pose in the velocity estimate.
+  /// 1 means no smoothing. Default is 0.5.
+  vtkSetClampMacro( VelocitySmoothingFactor, double, 0.01, 1.0 );
+  vtkGetMacro( VelocitySmoothingFactor, double );
+
+  /// If no new pose is received for this long then the tool is assumed to be stationary
+  /// (in seconds, default 0.5)
+  vtkSetMacro( MaximumPoseIntervalSec, double );
+  vtkGetMacro( MaximumPoseIntervalSec, double );
+
+  /// Add a new pose of the tool. The matrix is copied.
+  /// If the timestamp is not specified then the current time is used.
+  void AddPose( vtkMatrix4x4* toolToRASMatrix );
+  void AddPose( vtkMatrix4x4* toolToRASMatrix, double timestampSec );
+
+  /// Forget all poses and velocities
+  void Reset();
+
+  /// Extrapolate the last pose to the given time (or the current time) plus the latency.
+  /// Returns false if no pose has been added yet.
+  bool GetPredictedPose( vtkMatrix4x4* predictedToolToRASMatrix );
+  bool GetPredictedPose( vtkMatrix4x4* predictedToolToRASMatrix, double currentTimeSec );
+
+  /// Current time in seconds, same time base as the poses added without timestamp
+  static double GetCurrentTimeSec();
+
+protected:
+
+  vtkTransformPredictor();
+  virtual ~vtkTransformPredictor();
+
+  double LatencySec;
+  double MaximumPredictionTimeSec;
+  double VelocitySmoothingFactor;
+  double MaximumPoseIntervalSec;
+
+  vtkSmartPointer< vtkMatrix4x4 > LastPose;
+  double LastPoseTimestampSec;
+  bool LastPoseValid;
+  /// Orthonormalized rotation part of the last pose
+  double LastRotation[3][3];
+
+  /// Velocity estimates, valid if at least two recent poses have been added
+  double LinearVelocity[3];
+  double AngularVelocity[3];
+  bool VelocityValid;
+
+private:
+
+  vtkTransformPredictor(const vtkTransformPredictor&); // Not implemented
+  void operator=(const vtkTransformPredictor&);        // Not implemented
+};
+
+#endif
@@ -16,10 +16,12 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QTimer>
 #include <QtPlugin>
 
 // VolumeResliceDriver Logic includes
 #include <vtkSlicerVolumeResliceDriverLogic.h>
+#include <vtkSlicerTrackingTickLogic.h>
 
 // VolumeResliceDriver includes
 #include "qSlicerVolumeResliceDriverModule.h"
@@ -37,6 +39,9 @@ class qSlicerVolumeResliceDriverModulePrivate
 {
 public:
   qSlicerVolumeResliceDriverModulePrivate();
+
+  vtkSlicerVolumeResliceDriverLogic* ObservedLogic; // should be the same as logic(), it is used for adding/removing observer safely
+  QTimer ProcessPendingUpdatesTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -44,6 +49,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerVolumeResliceDriverModulePrivate::qSlicerVolumeResliceDriverModulePrivate()
+: ObservedLogic(NULL)
 {
 }
 
@@ -66,6 +72,10 @@ QStringList qSlicerVolumeResliceDriverModule::categories()const
 //-----------------------------------------------------------------------------
 qSlicerVolumeResliceDriverModule::~qSlicerVolumeResliceDriverModule()
 {
+  Q_D(qSlicerVolumeResliceDriverModule);
+  disconnect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+  this->qvtkReconnect(d->ObservedLogic, NULL, vtkSlicerVolumeResliceDriverLogic::PendingUpdatesModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -103,7 +113,21 @@ QIcon qSlicerVolumeResliceDriverModule::icon()const
 //-----------------------------------------------------------------------------
 void qSlicerVolumeResliceDriverModule::setup()
 {
+  Q_D(qSlicerVolumeResliceDriverModule);
   this->Superclass::setup();
+
+  vtkSlicerVolumeResliceDriverLogic* moduleLogic = vtkSlicerVolumeResliceDriverLogic::SafeDownCast(logic());
+  this->qvtkReconnect(d->ObservedLogic, moduleLogic, vtkSlicerVolumeResliceDriverLogic::PendingUpdatesModifiedEvent, this, SLOT(updatePendingUpdatesProcessing()));
+  d->ObservedLogic = moduleLogic;
+
+  // Driver events received within one event loop iteration are processed together,
+  // so each driven slice is updated only once per live image frame
+  d->ProcessPendingUpdatesTimer.setInterval(0);
+  connect(&d->ProcessPendingUpdatesTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+  if (moduleLogic)
+  {
+    moduleLogic->CoalesceUpdatesOn();
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -117,3 +141,30 @@ vtkMRMLAbstractLogic* qSlicerVolumeResliceDriverModule::createLogic()
 {
   return vtkSlicerVolumeResliceDriverLogic::New();
 }
+
+//------------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModule::updatePendingUpdatesProcessing()
+{
+  Q_D(qSlicerVolumeResliceDriverModule);
+  bool pendingUpdates = (d->ObservedLogic!=NULL && d->ObservedLogic->HasPendingUpdates());
+  if (pendingUpdates && !d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.start();
+  }
+  else if (!pendingUpdates && d->ProcessPendingUpdatesTimer.isActive())
+  {
+    d->ProcessPendingUpdatesTimer.stop();
+  }
+}
+
+//------------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModule::processPendingUpdates()
+{
+  Q_D(qSlicerVolumeResliceDriverModule);
+  if (d->ObservedLogic==NULL)
+  {
+    return;
+  }
+  // Pending updates of all tracking logics are processed together, in dependency order
+  vtkSlicerTrackingTickLogic::GetInstance()->ProcessTick();
+}